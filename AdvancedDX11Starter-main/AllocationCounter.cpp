@@ -0,0 +1,172 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+static std::atomic<unsigned long long> heapAllocations(0);
+static thread_local unsigned long long threadHeapAllocations = 0;
+
+unsigned long long GetHeapAllocationCount()
+{
+	return heapAllocations.load(std::memory_order_relaxed);
+}
+
+unsigned long long GetThreadHeapAllocationCount()
+{
+	return threadHeapAllocations;
+}
+
+// --------------------------------------------------------
+// Replacement operator new and delete. Every form ends up
+// in these two, or the aligned pair further down, so the
+// count can't miss any of them
+// --------------------------------------------------------
+
+static void* CountedAllocate(size_t bytes)
+{
+	heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	threadHeapAllocations++;
+	return malloc(bytes > 0 ? bytes : 1);
+}
+
+void* operator new(size_t bytes)
+{
+	void* memory = CountedAllocate(bytes);
+	if (!memory)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](size_t bytes)
+{
+	return operator new(bytes);
+}
+
+void* operator new(size_t bytes, const std::nothrow_t&) noexcept
+{
+	return CountedAllocate(bytes);
+}
+
+void* operator new[](size_t bytes, const std::nothrow_t&) noexcept
+{
+	return CountedAllocate(bytes);
+}
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+	free(memory);
+}
+
+// --------------------------------------------------------
+// Over-aligned types, like SIMD members, get their own forms
+// from C++17 on. Their memory can't go back through free on
+// Windows, so they are freed in a pair of their own
+// --------------------------------------------------------
+
+#ifdef __cpp_aligned_new
+
+static void* CountedAllocateAligned(size_t bytes, std::align_val_t alignment)
+{
+	heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	threadHeapAllocations++;
+
+	size_t align = (size_t)alignment;
+#ifdef _MSC_VER
+	return _aligned_malloc(bytes > 0 ? bytes : 1, align);
+#else
+	void* memory = 0;
+	if (posix_memalign(&memory, align < sizeof(void*) ? sizeof(void*) : align, bytes > 0 ? bytes : 1) != 0)
+		return 0;
+	return memory;
+#endif
+}
+
+static void FreeAligned(void* memory)
+{
+#ifdef _MSC_VER
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif
+}
+
+void* operator new(size_t bytes, std::align_val_t alignment)
+{
+	void* memory = CountedAllocateAligned(bytes, alignment);
+	if (!memory)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](size_t bytes, std::align_val_t alignment)
+{
+	return operator new(bytes, alignment);
+}
+
+void* operator new(size_t bytes, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return CountedAllocateAligned(bytes, alignment);
+}
+
+void* operator new[](size_t bytes, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return CountedAllocateAligned(bytes, alignment);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+	FreeAligned(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept
+{
+	FreeAligned(memory);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept
+{
+	FreeAligned(memory);
+}
+
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept
+{
+	FreeAligned(memory);
+}
+
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	FreeAligned(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	FreeAligned(memory);
+}
+
+#endif
@@ -0,0 +1,14 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Count every heap allocation made through new, so
+//			per-frame allocations can be watched and driven to
+//			zero. Replaces the global operator new and delete;
+//			malloc on its own, like ImGui's, is not counted.
+
+/// <summary>
+/// Allocations made so far by every thread, and by the
+/// calling thread alone
+/// </summary>
+unsigned long long GetHeapAllocationCount();
+unsigned long long GetThreadHeapAllocationCount();
@@ -0,0 +1,58 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Asset IDs and handles on their own, so code that
+//			only refers to assets can do so without pulling
+//			in the registry and Direct3D with it.
+
+#include <type_traits>
+
+class Mesh;
+class SimpleVertexShader;
+class SimplePixelShader;
+struct RendMat;
+struct TextureAsset;
+
+typedef unsigned int AssetID;
+
+/// <summary>
+/// FNV-1a hash of an asset name. Usable at compile time, and
+/// narrow and wide names of the same ASCII text hash the same
+/// </summary>
+template<typename CharType>
+constexpr AssetID HashAssetName(const CharType* name)
+{
+	AssetID hash = 2166136261u;
+	while (*name)
+	{
+		hash ^= (AssetID)(typename std::make_unsigned<CharType>::type)*name++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// Forces the hash of a literal to happen at compile time
+#define ASSET_ID(name) (std::integral_constant<AssetID, HashAssetName(name)>::value)
+
+/// <summary>
+/// Index into an asset pool plus the generation of the slot
+/// when the handle was made. Generation 0 is never used so a
+/// default handle is always null
+/// </summary>
+template<typename T>
+struct AssetHandle
+{
+	unsigned int index;
+	unsigned int generation;
+
+	AssetHandle() : index(0), generation(0) {}
+	bool IsNull() const { return generation == 0; }
+	bool operator==(const AssetHandle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const AssetHandle& other) const { return !(*this == other); }
+};
+
+typedef AssetHandle<SimpleVertexShader>	VertexShaderHandle;
+typedef AssetHandle<SimplePixelShader>	PixelShaderHandle;
+typedef AssetHandle<Mesh>				MeshHandle;
+typedef AssetHandle<TextureAsset>		TextureHandle;
+typedef AssetHandle<RendMat>			MaterialHandle;
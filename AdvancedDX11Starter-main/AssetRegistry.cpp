@@ -0,0 +1,206 @@
+#include "AssetRegistry.h"
+#include "Helpers.h"
+#include "Mesh.h"
+#include "SimpleShader.h"
+#include "Material.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+
+// --------------------------------------------------------
+// Memory estimates
+//
+// Only what the GPU holds is counted. Sizes come from the
+// resources' own descriptions so they match what was made.
+// --------------------------------------------------------
+
+/// <summary>
+/// Bits per texel of the formats the game loads, with block
+/// compressed formats averaged over their 4x4 block
+/// </summary>
+static unsigned int BitsPerTexel(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC4_UNORM:
+	case DXGI_FORMAT_BC4_SNORM:
+		return 4;
+
+	case DXGI_FORMAT_BC2_UNORM:
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC5_SNORM:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+	case DXGI_FORMAT_R8_UNORM:
+		return 8;
+
+	case DXGI_FORMAT_R8G8_UNORM:
+	case DXGI_FORMAT_R16_FLOAT:
+		return 16;
+
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+	case DXGI_FORMAT_R32G32_FLOAT:
+		return 64;
+
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+		return 128;
+
+	default:
+		return 32;
+	}
+}
+
+size_t TextureBytes(ID3D11ShaderResourceView* srv)
+{
+	if (!srv)
+		return 0;
+
+	Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	srv->GetResource(resource.GetAddressOf());
+	if (FAILED(resource.As(&texture)))
+		return 0;
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	texture->GetDesc(&desc);
+
+	size_t bytes = 0;
+	unsigned int width = desc.Width;
+	unsigned int height = desc.Height;
+	for (unsigned int mip = 0; mip < desc.MipLevels; mip++)
+	{
+		bytes += (size_t)width * height * BitsPerTexel(desc.Format) / 8;
+		width = (std::max)(width / 2, 1u);
+		height = (std::max)(height / 2, 1u);
+	}
+	return bytes * desc.ArraySize;
+}
+
+static size_t BufferBytes(ID3D11Buffer* buffer)
+{
+	if (!buffer)
+		return 0;
+
+	D3D11_BUFFER_DESC desc = {};
+	buffer->GetDesc(&desc);
+	return desc.ByteWidth;
+}
+
+static size_t ShaderBytes(ISimpleShader* shader)
+{
+	size_t bytes = 0;
+	if (shader->GetShaderBlob())
+		bytes += shader->GetShaderBlob()->GetBufferSize();
+
+	for (unsigned int i = 0; i < shader->GetBufferCount(); i++)
+		bytes += shader->GetBufferSize(i);
+	return bytes;
+}
+
+static size_t MaterialBytes(RendMat* mat)
+{
+	size_t bytes = 0;
+	for (auto& cb : mat->vsBindings.constantBuffers) bytes += cb.data.size();
+	for (auto& cb : mat->psBindings.constantBuffers) bytes += cb.data.size();
+	return bytes;
+}
+
+
+// --------------------------------------------------------
+// Interning
+// --------------------------------------------------------
+
+AssetID AssetRegistry::Intern(const std::string& name)
+{
+	AssetID id = HashAssetName(name.c_str());
+
+	auto it = names.find(id);
+	if (it == names.end())
+		names[id] = name;
+	else if (it->second != name)
+	{
+		// Two names sharing an ID would silently alias each
+		// other's assets, so stop before that can ship. One of
+		// them needs renaming
+		char message[256];
+		sprintf_s(message, "Asset ID collision: %s and %s\n", it->second.c_str(), name.c_str());
+		OutputDebugStringA(message);
+		fprintf(stderr, "%s", message);
+		abort();
+	}
+
+	return id;
+}
+
+AssetID AssetRegistry::Intern(const std::wstring& name)
+{
+	return Intern(WideToNarrow(name));
+}
+
+const std::string& AssetRegistry::GetName(AssetID id) const
+{
+	static const std::string unknown = "(unknown)";
+	auto it = names.find(id);
+	return it == names.end() ? unknown : it->second;
+}
+
+
+// --------------------------------------------------------
+// Adding assets
+// --------------------------------------------------------
+
+VertexShaderHandle AssetRegistry::AddVertexShader(const std::wstring& name, std::shared_ptr<SimpleVertexShader> shader)
+{
+	return vertexShaders.Add(Intern(name), shader, ShaderBytes(shader.get()));
+}
+
+PixelShaderHandle AssetRegistry::AddPixelShader(const std::wstring& name, std::shared_ptr<SimplePixelShader> shader)
+{
+	return pixelShaders.Add(Intern(name), shader, ShaderBytes(shader.get()));
+}
+
+MeshHandle AssetRegistry::AddMesh(const std::wstring& name, std::shared_ptr<Mesh> mesh)
+{
+	size_t bytes = BufferBytes(mesh->GetVertexBuffer().Get()) + BufferBytes(mesh->GetIndexBuffer().Get());
+	return meshes.Add(Intern(name), mesh, bytes);
+}
+
+TextureHandle AssetRegistry::AddTexture(const std::string& name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+{
+	std::shared_ptr<TextureAsset> texture = std::make_shared<TextureAsset>();
+	texture->srv = srv;
+	return textures.Add(Intern(name), texture, TextureBytes(srv.Get()));
+}
+
+MaterialHandle AssetRegistry::AddMaterial(const std::wstring& name, std::shared_ptr<RendMat> material)
+{
+	return materials.Add(Intern(name), material, MaterialBytes(material.get()));
+}
+
+unsigned int AssetRegistry::UnloadUnreferenced()
+{
+	// Materials go first so the shaders and textures
+	// only they were using become unreferenced too
+	for (auto& slot : materials.GetSlots())
+	{
+		if (!slot.asset || slot.refCount > 0)
+			continue;
+
+		vertexShaders.Release(slot.asset->vs);
+		pixelShaders.Release(slot.asset->ps);
+		for (auto& t : slot.asset->textureHandles)
+			textures.Release(t);
+	}
+
+	return
+		materials.UnloadUnreferenced() +
+		vertexShaders.UnloadUnreferenced() +
+		pixelShaders.UnloadUnreferenced() +
+		meshes.UnloadUnreferenced() +
+		textures.UnloadUnreferenced();
+}
@@ -0,0 +1,250 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Own every loaded asset and hand out small handles
+//			to them. Assets are named by interned IDs that are
+//			hashed at compile time where the name is known, and
+//			handles carry a generation so a handle to an asset
+//			that was unloaded is caught instead of reading
+//			whatever reused its slot.
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <type_traits>
+
+#include "AssetHandle.h"
+
+/// <summary>
+/// A texture as the registry stores it
+/// </summary>
+struct TextureAsset
+{
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+
+	// Streamed textures have no view here since the one
+	// bound changes as mips come and go
+	int streamIndex = -1;
+};
+
+/// <summary>
+/// Totals for a single asset type
+/// </summary>
+struct AssetPoolStats
+{
+	unsigned int count;
+	unsigned int referenced;
+	size_t bytes;
+};
+
+/// <summary>
+/// Slots of one asset type. Looking up a handle is an array
+/// index and a generation compare, only finding an asset by
+/// ID goes through a hash map
+/// </summary>
+template<typename T>
+class AssetPool
+{
+public:
+
+	struct Slot
+	{
+		std::shared_ptr<T> asset;
+		AssetID id;
+		unsigned int generation;
+		unsigned int refCount;
+		size_t bytes;
+	};
+
+	/// <summary>
+	/// Stores an asset under an ID. An asset that is already
+	/// stored under the ID is kept and its handle returned
+	/// </summary>
+	AssetHandle<T> Add(AssetID id, std::shared_ptr<T> asset, size_t bytes)
+	{
+		AssetHandle<T> existing = Find(id);
+		if (!existing.IsNull())
+			return existing;
+
+		unsigned int index;
+		if (!freeSlots.empty())
+		{
+			index = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else
+		{
+			index = (unsigned int)slots.size();
+			Slot empty = {};
+			empty.generation = 1;
+			slots.push_back(empty);
+		}
+
+		Slot& slot = slots[index];
+		slot.asset = asset;
+		slot.id = id;
+		slot.refCount = 0;
+		slot.bytes = bytes;
+		idToSlot[id] = index;
+
+		return MakeHandle(index);
+	}
+
+	/// <summary>
+	/// Finds an asset by ID, null handle if it is not loaded
+	/// </summary>
+	AssetHandle<T> Find(AssetID id) const
+	{
+		auto it = idToSlot.find(id);
+		if (it == idToSlot.end())
+			return AssetHandle<T>();
+		return MakeHandle(it->second);
+	}
+
+	/// <summary>
+	/// Finds an asset and adds a reference to it
+	/// </summary>
+	AssetHandle<T> Acquire(AssetID id)
+	{
+		AssetHandle<T> handle = Find(id);
+		AddRef(handle);
+		return handle;
+	}
+
+	void AddRef(AssetHandle<T> handle)
+	{
+		if (IsAlive(handle))
+			slots[handle.index].refCount++;
+	}
+
+	void Release(AssetHandle<T> handle)
+	{
+		if (IsAlive(handle) && slots[handle.index].refCount > 0)
+			slots[handle.index].refCount--;
+	}
+
+	bool IsAlive(AssetHandle<T> handle) const
+	{
+		return !handle.IsNull() &&
+			handle.index < slots.size() &&
+			slots[handle.index].generation == handle.generation &&
+			slots[handle.index].asset;
+	}
+
+	/// <summary>
+	/// The asset behind a handle, or null for a stale handle
+	/// </summary>
+	const std::shared_ptr<T>& Get(AssetHandle<T> handle) const
+	{
+		static const std::shared_ptr<T> none;
+		return IsAlive(handle) ? slots[handle.index].asset : none;
+	}
+
+	const std::shared_ptr<T>& Get(AssetID id) const { return Get(Find(id)); }
+
+	/// <summary>
+	/// For assets whose memory changes after they are added
+	/// </summary>
+	void SetBytes(AssetHandle<T> handle, size_t bytes)
+	{
+		if (IsAlive(handle))
+			slots[handle.index].bytes = bytes;
+	}
+
+	/// <summary>
+	/// Drops every asset nothing holds a reference to. Their
+	/// slots move on a generation so old handles go stale
+	/// </summary>
+	unsigned int UnloadUnreferenced()
+	{
+		unsigned int unloaded = 0;
+		for (unsigned int i = 0; i < slots.size(); i++)
+		{
+			Slot& slot = slots[i];
+			if (!slot.asset || slot.refCount > 0)
+				continue;
+
+			idToSlot.erase(slot.id);
+			slot.asset.reset();
+			slot.bytes = 0;
+			slot.generation = slot.generation + 1 == 0 ? 1 : slot.generation + 1;
+			freeSlots.push_back(i);
+			unloaded++;
+		}
+		return unloaded;
+	}
+
+	AssetPoolStats GetStats() const
+	{
+		AssetPoolStats stats = {};
+		for (auto& slot : slots)
+		{
+			if (!slot.asset)
+				continue;
+
+			stats.count++;
+			stats.bytes += slot.bytes;
+			if (slot.refCount > 0)
+				stats.referenced++;
+		}
+		return stats;
+	}
+
+	const std::vector<Slot>& GetSlots() const { return slots; }
+
+private:
+
+	AssetHandle<T> MakeHandle(unsigned int index) const
+	{
+		AssetHandle<T> handle;
+		handle.index = index;
+		handle.generation = slots[index].generation;
+		return handle;
+	}
+
+	std::vector<Slot> slots;
+	std::vector<unsigned int> freeSlots;
+	std::unordered_map<AssetID, unsigned int> idToSlot;
+};
+
+/// <summary>
+/// Every pool the game uses plus the interned names. Adding
+/// assets is meant for loading time, it is not safe while the
+/// render thread is reading handles
+/// </summary>
+class AssetRegistry
+{
+public:
+
+	AssetPool<SimpleVertexShader> vertexShaders;
+	AssetPool<SimplePixelShader> pixelShaders;
+	AssetPool<Mesh> meshes;
+	AssetPool<TextureAsset> textures;
+	AssetPool<RendMat> materials;
+
+	// Interning
+	AssetID Intern(const std::string& name);
+	AssetID Intern(const std::wstring& name);
+	const std::string& GetName(AssetID id) const;
+
+	// Adding assets, which also works out their memory use
+	VertexShaderHandle AddVertexShader(const std::wstring& name, std::shared_ptr<SimpleVertexShader> shader);
+	PixelShaderHandle AddPixelShader(const std::wstring& name, std::shared_ptr<SimplePixelShader> shader);
+	MeshHandle AddMesh(const std::wstring& name, std::shared_ptr<Mesh> mesh);
+	TextureHandle AddTexture(const std::string& name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+	MaterialHandle AddMaterial(const std::wstring& name, std::shared_ptr<RendMat> material);
+
+	// Drops the material's own references before the
+	// unreferenced assets of every type are unloaded
+	unsigned int UnloadUnreferenced();
+
+private:
+
+	std::unordered_map<AssetID, std::string> names;
+};
+
+// Memory of every mip of the texture behind a view
+size_t TextureBytes(ID3D11ShaderResourceView* srv);
@@ -0,0 +1,829 @@
+#include "Collision.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdlib.h>
+#include <string>
+#include <sstream>
+
+namespace
+{
+	struct V3
+	{
+		float x, y, z;
+	};
+
+	V3 Load(const float* v) { V3 r = { v[0], v[1], v[2] }; return r; }
+	void Store(float* out, V3 v) { out[0] = v.x; out[1] = v.y; out[2] = v.z; }
+
+	V3 operator+(V3 a, V3 b) { V3 r = { a.x + b.x, a.y + b.y, a.z + b.z }; return r; }
+	V3 operator-(V3 a, V3 b) { V3 r = { a.x - b.x, a.y - b.y, a.z - b.z }; return r; }
+	V3 operator*(V3 a, float s) { V3 r = { a.x * s, a.y * s, a.z * s }; return r; }
+	float Dot(V3 a, V3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	V3 Cross(V3 a, V3 b) { V3 r = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; return r; }
+	float Clamp01(float v) { return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v); }
+
+	/// <summary>
+	/// Closest point to p on triangle abc, from Ericson's
+	/// Real-Time Collision Detection
+	/// </summary>
+	V3 ClosestPointOnTriangle(V3 p, V3 a, V3 b, V3 c)
+	{
+		V3 ab = b - a;
+		V3 ac = c - a;
+		V3 ap = p - a;
+		float d1 = Dot(ab, ap);
+		float d2 = Dot(ac, ap);
+		if (d1 <= 0.0f && d2 <= 0.0f)
+			return a;
+
+		V3 bp = p - b;
+		float d3 = Dot(ab, bp);
+		float d4 = Dot(ac, bp);
+		if (d3 >= 0.0f && d4 <= d3)
+			return b;
+
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+			return a + ab * (d1 / (d1 - d3));
+
+		V3 cp = p - c;
+		float d5 = Dot(ab, cp);
+		float d6 = Dot(ac, cp);
+		if (d6 >= 0.0f && d5 <= d6)
+			return c;
+
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+			return a + ac * (d2 / (d2 - d6));
+
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+			return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+		float denom = 1.0f / (va + vb + vc);
+		return a + ab * (vb * denom) + ac * (vc * denom);
+	}
+
+	/// <summary>
+	/// Closest points between segments p1q1 and p2q2
+	/// </summary>
+	void ClosestPointsOnSegments(V3 p1, V3 q1, V3 p2, V3 q2, V3* c1, V3* c2)
+	{
+		const float epsilon = 1e-8f;
+		V3 d1 = q1 - p1;
+		V3 d2 = q2 - p2;
+		V3 r = p1 - p2;
+		float a = Dot(d1, d1);
+		float e = Dot(d2, d2);
+		float f = Dot(d2, r);
+
+		float s = 0.0f;
+		float t = 0.0f;
+		if (a <= epsilon && e <= epsilon)
+		{
+		}
+		else if (a <= epsilon)
+		{
+			t = Clamp01(f / e);
+		}
+		else
+		{
+			float c = Dot(d1, r);
+			if (e <= epsilon)
+			{
+				s = Clamp01(-c / a);
+			}
+			else
+			{
+				float b = Dot(d1, d2);
+				float denom = a * e - b * b;
+				s = denom != 0.0f ? Clamp01((b * f - c * e) / denom) : 0.0f;
+				t = (b * s + f) / e;
+				if (t < 0.0f)
+				{
+					t = 0.0f;
+					s = Clamp01(-c / a);
+				}
+				else if (t > 1.0f)
+				{
+					t = 1.0f;
+					s = Clamp01((b - c) / a);
+				}
+			}
+		}
+
+		*c1 = p1 + d1 * s;
+		*c2 = p2 + d2 * t;
+	}
+
+	// Whether a node's box and the box lo to hi touch
+	bool Overlaps(const CollisionNode& node, V3 lo, V3 hi)
+	{
+		return lo.x <= node.max[0] && hi.x >= node.min[0] &&
+			lo.y <= node.max[1] && hi.y >= node.min[1] &&
+			lo.z <= node.max[2] && hi.z >= node.min[2];
+	}
+
+	// 1 / v, without dividing by zero
+	float SafeInverse(float v)
+	{
+		return fabsf(v) > 1e-12f ? 1.0f / v : (v >= 0.0f ? 1e30f : -1e30f);
+	}
+
+	// Whether the ray o + d * t, 0 <= t <= maxT, passes through
+	// the node's box grown by pad on every side. inverse is 1 / d
+	bool RayHitsBox(const CollisionNode& node, const float o[3], const float inverse[3], float pad, float maxT)
+	{
+		float tMin = 0.0f;
+		float tMax = maxT;
+		for (int c = 0; c < 3; c++)
+		{
+			float t1 = (node.min[c] - pad - o[c]) * inverse[c];
+			float t2 = (node.max[c] + pad - o[c]) * inverse[c];
+			tMin = (std::max)(tMin, (std::min)(t1, t2));
+			tMax = (std::min)(tMax, (std::max)(t1, t2));
+			if (tMin > tMax)
+				return false;
+		}
+		return true;
+	}
+
+	// First t >= 0 where o + d * t is within radius of center.
+	// The direction is normalized
+	bool RaySphere(V3 o, V3 d, V3 center, float radius, float* t)
+	{
+		V3 m = o - center;
+		float b = Dot(m, d);
+		float c = Dot(m, m) - radius * radius;
+		if (c > 0.0f && b > 0.0f)
+			return false;
+
+		float discriminant = b * b - c;
+		if (discriminant < 0.0f)
+			return false;
+
+		*t = (std::max)(-b - sqrtf(discriminant), 0.0f);
+		return true;
+	}
+
+	// First t >= 0 where o + d * t is within radius of segment
+	// pq somewhere between its ends, and how far along pq
+	bool RayCylinder(V3 o, V3 d, V3 p, V3 q, float radius, float* t, float* along)
+	{
+		V3 e = q - p;
+		V3 m = o - p;
+		float ee = Dot(e, e);
+		float me = Dot(m, e);
+		float de = Dot(d, e);
+		float c = ee * (Dot(m, m) - radius * radius) - me * me;
+
+		float s;
+		if (c <= 0.0f)
+		{
+			// Starts inside the infinite cylinder
+			*t = 0.0f;
+			s = me / ee;
+		}
+		else
+		{
+			float a = ee - de * de;
+			if (fabsf(a) < 1e-8f)
+				return false;
+
+			float b = ee * Dot(m, d) - de * me;
+			float discriminant = b * b - a * c;
+			if (discriminant < 0.0f)
+				return false;
+
+			*t = (-b - sqrtf(discriminant)) / a;
+			if (*t < 0.0f)
+				return false;
+			s = (me + *t * de) / ee;
+		}
+
+		if (s < 0.0f || s > 1.0f)
+			return false;
+		*along = s;
+		return true;
+	}
+
+	// Whether p, on the plane of abc, is inside it. n is the
+	// normal abc winds around
+	bool InsideTriangle(V3 p, V3 a, V3 b, V3 c, V3 n)
+	{
+		return Dot(Cross(b - a, p - a), n) >= 0.0f &&
+			Dot(Cross(c - b, p - b), n) >= 0.0f &&
+			Dot(Cross(a - c, p - c), n) >= 0.0f;
+	}
+}
+
+LevelCollision::LevelCollision() :
+	buildMS(0)
+{
+}
+
+/// <summary>
+/// Row vectors times the matrix, like DirectXMath
+/// </summary>
+void LevelCollision::AddTriangles(const float* source, size_t triangleCount, const float world[4][4], EntityId owner)
+{
+	triangles.reserve(triangles.size() + triangleCount * 9);
+	owners.insert(owners.end(), triangleCount, owner);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		const float* p = source + i * 3;
+		for (int c = 0; c < 3; c++)
+			triangles.push_back(p[0] * world[0][c] + p[1] * world[1][c] + p[2] * world[2][c] + world[3][c]);
+	}
+}
+
+void LevelCollision::Clear()
+{
+	triangles.clear();
+	normals.clear();
+	owners.clear();
+	nodes.clear();
+}
+
+/// <summary>
+/// Splits triangles at the median of their centers along
+/// the widest axis until leaves are small enough. Triangles
+/// with no area are dropped since they have no normal
+/// </summary>
+void LevelCollision::Build()
+{
+	auto buildStart = std::chrono::high_resolution_clock::now();
+
+	struct BuildTriangle
+	{
+		float center[3];
+		unsigned int index;
+	};
+
+	std::vector<BuildTriangle> order;
+	order.reserve(triangles.size() / 9);
+	for (size_t t = 0; t < triangles.size() / 9; t++)
+	{
+		const float* v = &triangles[t * 9];
+		V3 n = Cross(Load(v + 3) - Load(v), Load(v + 6) - Load(v));
+		if (Dot(n, n) < 1e-12f)
+			continue;
+
+		BuildTriangle b;
+		for (int c = 0; c < 3; c++)
+			b.center[c] = (v[c] + v[3 + c] + v[6 + c]) / 3.0f;
+		b.index = (unsigned int)t;
+		order.push_back(b);
+	}
+
+	nodes.clear();
+	nodes.reserve(order.size() * 2 + 1);
+	nodes.push_back(CollisionNode());
+	nodes[0].first = 0;
+	nodes[0].count = (unsigned int)order.size();
+
+	// Nodes waiting to be split, as leaves covering a range
+	std::vector<unsigned int> pending;
+	pending.push_back(0);
+	while (!pending.empty())
+	{
+		unsigned int nodeIndex = pending.back();
+		pending.pop_back();
+
+		unsigned int first = nodes[nodeIndex].first;
+		unsigned int count = nodes[nodeIndex].count;
+
+		// Bounds of the triangles and of their centers
+		float centerMin[3] = { 1e30f, 1e30f, 1e30f };
+		float centerMax[3] = { -1e30f, -1e30f, -1e30f };
+		CollisionNode& node = nodes[nodeIndex];
+		for (int c = 0; c < 3; c++)
+		{
+			node.min[c] = 1e30f;
+			node.max[c] = -1e30f;
+		}
+		for (unsigned int i = first; i < first + count; i++)
+		{
+			const float* v = &triangles[order[i].index * 9];
+			for (int c = 0; c < 3; c++)
+			{
+				node.min[c] = (std::min)(node.min[c], (std::min)(v[c], (std::min)(v[3 + c], v[6 + c])));
+				node.max[c] = (std::max)(node.max[c], (std::max)(v[c], (std::max)(v[3 + c], v[6 + c])));
+				centerMin[c] = (std::min)(centerMin[c], order[i].center[c]);
+				centerMax[c] = (std::max)(centerMax[c], order[i].center[c]);
+			}
+		}
+		if (count == 0)
+		{
+			for (int c = 0; c < 3; c++)
+				node.min[c] = node.max[c] = 0.0f;
+		}
+
+		if (count <= COLLISION_LEAF_TRIANGLES)
+			continue;
+
+		int axis = 0;
+		for (int c = 1; c < 3; c++)
+		{
+			if (centerMax[c] - centerMin[c] > centerMax[axis] - centerMin[axis])
+				axis = c;
+		}
+
+		unsigned int half = count / 2;
+		std::nth_element(
+			order.begin() + first,
+			order.begin() + first + half,
+			order.begin() + first + count,
+			[axis](const BuildTriangle& a, const BuildTriangle& b) { return a.center[axis] < b.center[axis]; });
+
+		unsigned int left = (unsigned int)nodes.size();
+		CollisionNode child = {};
+		child.first = first;
+		child.count = half;
+		nodes.push_back(child);
+		child.first = first + half;
+		child.count = count - half;
+		nodes.push_back(child);
+
+		nodes[nodeIndex].first = left;
+		nodes[nodeIndex].count = 0;
+		pending.push_back(left);
+		pending.push_back(left + 1);
+	}
+
+	// Lay the triangles out in leaf order with their normals
+	std::vector<float> sorted(order.size() * 9);
+	std::vector<EntityId> sortedOwners(order.size());
+	normals.resize(order.size() * 3);
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		const float* v = &triangles[order[i].index * 9];
+		std::copy(v, v + 9, &sorted[i * 9]);
+		sortedOwners[i] = owners[order[i].index];
+
+		V3 n = Cross(Load(v + 3) - Load(v), Load(v + 6) - Load(v));
+		Store(&normals[i * 3], n * (1.0f / sqrtf(Dot(n, n))));
+	}
+	triangles.swap(sorted);
+	owners.swap(sortedOwners);
+
+	buildMS = std::chrono::duration<float, std::milli>(
+		std::chrono::high_resolution_clock::now() - buildStart).count();
+}
+
+/// <summary>
+/// Finds the triangle pushing furthest into the capsule
+/// between bottom and top, and which way pushes it out
+/// </summary>
+bool LevelCollision::FindDeepestContact(const float bottomIn[3], const float topIn[3], float radius, Contact* contact) const
+{
+	// An empty level is a root with no triangles and no children
+	if (nodes.size() < 2 && (nodes.empty() || nodes[0].count == 0))
+		return false;
+
+	V3 bottom = Load(bottomIn);
+	V3 top = Load(topIn);
+	V3 lo = { bottom.x - radius, bottom.y - radius, bottom.z - radius };
+	V3 hi = { top.x + radius, top.y + radius, top.z + radius };
+
+	bool found = false;
+	contact->depth = 0.0f;
+
+	unsigned int stack[64];
+	unsigned int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const CollisionNode& node = nodes[stack[--stackSize]];
+		if (!Overlaps(node, lo, hi))
+			continue;
+
+		if (node.count == 0)
+		{
+			if (stackSize + 2 <= 64)
+			{
+				stack[stackSize++] = node.first;
+				stack[stackSize++] = node.first + 1;
+			}
+			continue;
+		}
+
+		for (unsigned int t = node.first; t < node.first + node.count; t++)
+		{
+			const float* v = &triangles[t * 9];
+			V3 a = Load(v);
+			V3 b = Load(v + 3);
+			V3 c = Load(v + 6);
+			V3 n = Load(&normals[t * 3]);
+
+			// Which side of the plane the capsule is on
+			float sideBottom = Dot(bottom - a, n);
+			float sideTop = Dot(top - a, n);
+
+			// Segment through the triangle: push out along the
+			// normal from the side most of the capsule is on
+			V3 onSegment;
+			V3 onTriangle;
+			float distance = -1.0f;
+			if (sideBottom * sideTop <= 0.0f && sideBottom != sideTop)
+			{
+				V3 crossing = bottom + (top - bottom) * (sideBottom / (sideBottom - sideTop));
+				V3 closest = ClosestPointOnTriangle(crossing, a, b, c);
+				V3 off = crossing - closest;
+				if (Dot(off, off) < 1e-10f)
+				{
+					if (sideBottom + sideTop < 0.0f)
+					{
+						n = n * -1.0f;
+						sideBottom = -sideBottom;
+						sideTop = -sideTop;
+					}
+					float depth = radius - (std::min)(sideBottom, sideTop);
+					if (depth > contact->depth)
+					{
+						Store(contact->normal, n);
+						contact->depth = depth;
+						found = true;
+					}
+					continue;
+				}
+			}
+
+			// Otherwise the closest pair is an end of the segment
+			// against the face, or the segment against an edge
+			V3 best = ClosestPointOnTriangle(bottom, a, b, c);
+			onSegment = bottom;
+			onTriangle = best;
+			distance = Dot(bottom - best, bottom - best);
+
+			V3 candidate = ClosestPointOnTriangle(top, a, b, c);
+			float d = Dot(top - candidate, top - candidate);
+			if (d < distance)
+			{
+				distance = d;
+				onSegment = top;
+				onTriangle = candidate;
+			}
+
+			V3 edges[3][2] = { { a, b }, { b, c }, { c, a } };
+			for (int e = 0; e < 3; e++)
+			{
+				V3 s;
+				V3 q;
+				ClosestPointsOnSegments(bottom, top, edges[e][0], edges[e][1], &s, &q);
+				d = Dot(s - q, s - q);
+				if (d < distance)
+				{
+					distance = d;
+					onSegment = s;
+					onTriangle = q;
+				}
+			}
+
+			if (distance >= radius * radius)
+				continue;
+
+			distance = sqrtf(distance);
+			float depth = radius - distance;
+			if (depth <= contact->depth)
+				continue;
+
+			V3 away = distance > 1e-6f ? (onSegment - onTriangle) * (1.0f / distance) : n;
+			Store(contact->normal, away);
+			contact->depth = depth;
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+/// <summary>
+/// Steps along the velocity, pushing the capsule out of
+/// anything it ends up in after each step. A push out also
+/// takes the part of the velocity going into the surface
+/// away, which is what makes the capsule slide
+/// </summary>
+void LevelCollision::MoveCapsule(
+	const CollisionCapsule& capsule,
+	float position[3],
+	float velocity[3],
+	float deltaTime,
+	CollisionMoveResult* result) const
+{
+	*result = CollisionMoveResult();
+
+	V3 pos = Load(position);
+	V3 vel = Load(velocity);
+	float up = (std::max)(capsule.height - capsule.radius * 2.0f, 0.0f);
+
+	float moveLength = sqrtf(Dot(vel, vel)) * deltaTime;
+	float stepLength = capsule.radius * COLLISION_STEP_FRACTION;
+	unsigned int steps = stepLength > 0.0f ? (unsigned int)ceilf(moveLength / stepLength) : 1;
+	steps = (std::max)(1u, (std::min)(steps, (unsigned int)COLLISION_MAX_STEPS));
+	float stepTime = deltaTime / steps;
+	if (moveLength > stepLength * COLLISION_MAX_STEPS)
+		stepTime = stepLength / (moveLength / deltaTime);
+
+	for (unsigned int s = 0; s < steps; s++)
+	{
+		pos = pos + vel * stepTime;
+
+		for (int i = 0; i < COLLISION_RESOLVE_ITERATIONS; i++)
+		{
+			float bottom[3] = { pos.x, pos.y + capsule.radius, pos.z };
+			float top[3] = { pos.x, pos.y + capsule.radius + up, pos.z };
+			Contact contact;
+			if (!FindDeepestContact(bottom, top, capsule.radius, &contact))
+				break;
+
+			// A hair further than needed so the next
+			// step doesn't start touching
+			V3 n = Load(contact.normal);
+			pos = pos + n * (contact.depth + 1e-4f);
+
+			float into = Dot(vel, n);
+			if (into < 0.0f)
+				vel = vel - n * into;
+
+			result->contacts++;
+			if (n.y >= capsule.groundCosine)
+			{
+				result->grounded = true;
+				Store(result->groundNormal, n);
+			}
+		}
+	}
+	result->steps = steps;
+
+	// Standing still on the ground touches nothing, so look
+	// a little below for something to stand on
+	if (!result->grounded && capsule.groundProbe > 0.0f)
+	{
+		float bottom[3] = { pos.x, pos.y + capsule.radius - capsule.groundProbe, pos.z };
+		float top[3] = { pos.x, pos.y + capsule.radius + up - capsule.groundProbe, pos.z };
+		Contact contact;
+		if (FindDeepestContact(bottom, top, capsule.radius, &contact) && contact.normal[1] >= capsule.groundCosine)
+		{
+			result->grounded = true;
+			Store(result->groundNormal, Load(contact.normal));
+		}
+	}
+
+	Store(position, pos);
+	Store(velocity, vel);
+}
+
+/// <summary>
+/// Each triangle is first tried as a plane, which gives the
+/// hit when the sphere lands on its face. Otherwise the sphere
+/// can only touch an edge or a corner, found as a ray against
+/// cylinders around the edges and spheres around the corners
+/// </summary>
+bool LevelCollision::CastSphere(
+	const float origin[3],
+	const float direction[3],
+	float radius,
+	float maxDistance,
+	LevelHit* hit) const
+{
+	if (nodes.size() < 2 && (nodes.empty() || nodes[0].count == 0))
+		return false;
+
+	V3 o = Load(origin);
+	V3 d = Load(direction);
+	float inverse[3] = { SafeInverse(d.x), SafeInverse(d.y), SafeInverse(d.z) };
+
+	// Anything further than the best hit so far is skipped
+	float best = maxDistance;
+	bool found = false;
+
+	unsigned int stack[64];
+	unsigned int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const CollisionNode& node = nodes[stack[--stackSize]];
+		if (!RayHitsBox(node, origin, inverse, radius, best))
+			continue;
+
+		if (node.count == 0)
+		{
+			if (stackSize + 2 <= 64)
+			{
+				stack[stackSize++] = node.first;
+				stack[stackSize++] = node.first + 1;
+			}
+			continue;
+		}
+
+		for (unsigned int tri = node.first; tri < node.first + node.count; tri++)
+		{
+			const float* v = &triangles[tri * 9];
+			V3 a = Load(v);
+			V3 b = Load(v + 3);
+			V3 c = Load(v + 6);
+			V3 n = Load(&normals[tri * 3]);
+
+			// The face, from whichever side the cast starts on
+			float side = Dot(o - a, n);
+			V3 facing = side >= 0.0f ? n : n * -1.0f;
+			float height = fabsf(side);
+			float approach = Dot(d, facing);
+
+			float t = -1.0f;
+			if (height <= radius)
+				t = 0.0f;
+			else if (approach < 0.0f)
+				t = (height - radius) / -approach;
+
+			if (t >= 0.0f && t <= best)
+			{
+				V3 center = o + d * t;
+				V3 p = center - facing * Dot(center - a, facing);
+				if (InsideTriangle(p, a, b, c, n))
+				{
+					best = t;
+					hit->distance = t;
+					Store(hit->point, p);
+					Store(hit->normal, facing);
+					hit->owner = owners[tri];
+					found = true;
+					continue;
+				}
+			}
+
+			// A ray can't touch an edge without touching the face
+			if (radius <= 0.0f)
+				continue;
+
+			V3 corners[3] = { a, b, c };
+			for (int e = 0; e < 3; e++)
+			{
+				V3 p = corners[e];
+				V3 q = corners[(e + 1) % 3];
+				float along;
+				V3 touch;
+				if (RayCylinder(o, d, p, q, radius, &t, &along) && t <= best)
+					touch = p + (q - p) * along;
+				else if (RaySphere(o, d, p, radius, &t) && t <= best)
+					touch = p;
+				else
+					continue;
+
+				V3 away = (o + d * t) - touch;
+				float length = sqrtf(Dot(away, away));
+				best = t;
+				hit->distance = t;
+				Store(hit->point, touch);
+				Store(hit->normal, length > 1e-6f ? away * (1.0f / length) : facing);
+				hit->owner = owners[tri];
+				found = true;
+			}
+		}
+	}
+
+	return found;
+}
+
+// --------------------------------------------------------
+// Loading
+// --------------------------------------------------------
+
+bool LoadCollisionOBJ(std::istream& obj, std::vector<float>& triangles)
+{
+	if (!obj.good())
+		return false;
+
+	std::vector<V3> positions;
+	std::vector<unsigned int> face;
+	std::string line;
+	while (std::getline(obj, line))
+	{
+		if (line.size() < 2)
+			continue;
+
+		if (line[0] == 'v' && line[1] == ' ')
+		{
+			V3 p = {};
+			std::istringstream in(line.substr(2));
+			in >> p.x >> p.y >> p.z;
+
+			// Left handed like Mesh
+			p.z = -p.z;
+			positions.push_back(p);
+		}
+		else if (line[0] == 'f' && line[1] == ' ')
+		{
+			// Only the position of each corner matters. Corners
+			// look like 1, 1/2, 1//3 or 1/2/3, and may count back
+			// from the end when negative
+			face.clear();
+			std::istringstream in(line.substr(2));
+			std::string corner;
+			while (in >> corner)
+			{
+				int index = atoi(corner.c_str());
+				if (index < 0)
+					index += (int)positions.size() + 1;
+				if (index < 1 || index > (int)positions.size())
+					return false;
+				face.push_back((unsigned int)index - 1);
+			}
+
+			// Fan, with the winding flipped like Mesh
+			for (size_t i = 1; i + 1 < face.size(); i++)
+			{
+				unsigned int corners[3] = { face[0], face[i + 1], face[i] };
+				for (unsigned int c : corners)
+				{
+					triangles.push_back(positions[c].x);
+					triangles.push_back(positions[c].y);
+					triangles.push_back(positions[c].z);
+				}
+			}
+		}
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Benchmark
+// --------------------------------------------------------
+
+CollisionBenchmark BenchmarkCapsuleMoves(const LevelCollision& level, unsigned int playerCount, unsigned int ticks)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	CollisionBenchmark result = {};
+	result.playerCount = playerCount;
+	result.ticks = ticks;
+
+	const float* boundsMin = level.GetBoundsMin();
+	const float* boundsMax = level.GetBoundsMax();
+	if (!boundsMin || playerCount == 0 || ticks == 0)
+		return result;
+
+	const float deltaTime = 1.0f / 60.0f;
+	const float gravity = 20.0f;
+	const float speed = 6.0f;
+
+	CollisionCapsule capsule = {};
+	capsule.radius = 0.4f;
+	capsule.height = 1.8f;
+	capsule.groundCosine = 0.7f;
+	capsule.groundProbe = 0.05f;
+
+	// Dropped from above anywhere over the middle 80% of
+	// the level, each walking its own way
+	std::vector<float> positions(playerCount * 3);
+	std::vector<float> velocities(playerCount * 3);
+	std::vector<float> headings(playerCount);
+	std::vector<bool> grounded(playerCount, false);
+	for (unsigned int p = 0; p < playerCount; p++)
+	{
+		for (int c = 0; c < 3; c += 2)
+		{
+			float t = 0.1f + 0.8f * (float)rand() / RAND_MAX;
+			positions[p * 3 + c] = boundsMin[c] + (boundsMax[c] - boundsMin[c]) * t;
+		}
+		positions[p * 3 + 1] = boundsMax[1] + 0.5f;
+		headings[p] = (float)rand() / RAND_MAX * 6.2831853f;
+	}
+
+	double seconds = 0;
+	for (unsigned int tick = 0; tick < ticks; tick++)
+	{
+		auto start = Clock::now();
+		for (unsigned int p = 0; p < playerCount; p++)
+		{
+			// Turn now and then, fall unless standing
+			if ((tick + p) % 90 == 0)
+				headings[p] += 1.3f;
+
+			float* v = &velocities[p * 3];
+			v[0] = cosf(headings[p]) * speed;
+			v[2] = sinf(headings[p]) * speed;
+			v[1] = grounded[p] ? 0.0f : v[1] - gravity * deltaTime;
+
+			CollisionMoveResult move;
+			level.MoveCapsule(capsule, &positions[p * 3], v, deltaTime, &move);
+			grounded[p] = move.grounded;
+		}
+		seconds += std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	for (unsigned int p = 0; p < playerCount; p++)
+	{
+		if (grounded[p])
+			result.groundedPlayers++;
+		if (positions[p * 3 + 1] < boundsMin[1] - 1.0f)
+			result.escapedPlayers++;
+	}
+
+	result.tickMS = (float)(seconds * 1000.0 / ticks);
+	result.movesPerMS = result.tickMS > 0.0f ? playerCount / result.tickMS : 0.0f;
+	return result;
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Keep players out of the level. Static geometry is
+//			baked into one triangle soup in world space with a
+//			bounding volume hierarchy over it, built once at
+//			load. Players are upright capsules that move in
+//			steps short enough not to pass through a triangle,
+//			get pushed back out of anything they end up in and
+//			slide along it. Queries only read the hierarchy so
+//			any number of threads can move players at once.
+//			Plain float math with no Direct3D so it can be
+//			checked and benchmarked headless.
+
+#include <istream>
+#include <vector>
+#include <stddef.h>
+
+#include "EntityStore.h"
+
+// Most triangles in one leaf of the hierarchy
+#define COLLISION_LEAF_TRIANGLES 4
+
+// A move never steps further than this much of the radius
+// at once, so thin walls can't be skipped over
+#define COLLISION_STEP_FRACTION 0.5f
+
+// Steps and push outs one move may take. A move longer than
+// the steps allow is cut short rather than risk tunneling
+#define COLLISION_MAX_STEPS 16
+#define COLLISION_RESOLVE_ITERATIONS 4
+
+/// <summary>
+/// An upright capsule standing on its position. The bottom
+/// of the bottom sphere is the position itself
+/// </summary>
+struct CollisionCapsule
+{
+	float radius;
+	float height;
+
+	// Surfaces at most this steep count as ground, as the
+	// cosine of the angle from straight up
+	float groundCosine;
+
+	// How far below the capsule ground is looked for when
+	// the move itself didn't touch any
+	float groundProbe;
+};
+
+/// <summary>
+/// What happened during one move
+/// </summary>
+struct CollisionMoveResult
+{
+	bool grounded;
+	float groundNormal[3];
+	unsigned int contacts;
+	unsigned int steps;
+};
+
+/// <summary>
+/// The first triangle a cast touched. The owner is the
+/// entity the triangle was added for, if any
+/// </summary>
+struct LevelHit
+{
+	float distance;
+	float point[3];		// On the triangle
+	float normal[3];	// Facing back towards the cast
+	EntityId owner;
+};
+
+/// <summary>
+/// One node of the hierarchy. Leaves hold a run of
+/// triangles, inner nodes the index of their first child,
+/// with the second right after it
+/// </summary>
+struct CollisionNode
+{
+	float min[3];
+	float max[3];
+	unsigned int first;
+	unsigned int count;		// 0 for inner nodes
+};
+
+class LevelCollision
+{
+public:
+	LevelCollision();
+
+	// Adds triangles, nine floats each, moved into world space
+	// by a matrix laid out like DirectX::XMFLOAT4X4. Only
+	// takes effect once Build() runs
+	void AddTriangles(const float* triangles, size_t triangleCount, const float world[4][4], EntityId owner = EntityId());
+	void Clear();
+	void Build();
+
+	/// <summary>
+	/// Moves a capsule by velocity * deltaTime, sliding along
+	/// whatever it hits. Position and velocity are updated,
+	/// the velocity losing whatever pushed into a surface
+	/// </summary>
+	void MoveCapsule(
+		const CollisionCapsule& capsule,
+		float position[3],
+		float velocity[3],
+		float deltaTime,
+		CollisionMoveResult* result) const;
+
+	/// <summary>
+	/// Sweeps a sphere from origin along a normalized direction,
+	/// or casts a ray when the radius is 0, and finds the first
+	/// triangle it touches within maxDistance. Triangles are hit
+	/// from either side
+	/// </summary>
+	bool CastSphere(
+		const float origin[3],
+		const float direction[3],
+		float radius,
+		float maxDistance,
+		LevelHit* hit) const;
+
+	unsigned int GetTriangleCount() const { return (unsigned int)(triangles.size() / 9); }
+	const float* GetTriangles() const { return triangles.data(); }
+	unsigned int GetNodeCount() const { return (unsigned int)nodes.size(); }
+	float GetBuildMS() const { return buildMS; }
+	const float* GetBoundsMin() const { return nodes.empty() ? nullptr : nodes[0].min; }
+	const float* GetBoundsMax() const { return nodes.empty() ? nullptr : nodes[0].max; }
+
+private:
+
+	struct Contact
+	{
+		float normal[3];
+		float depth;
+	};
+
+	// The deepest triangle the capsule is in, if any
+	bool FindDeepestContact(const float bottom[3], const float top[3], float radius, Contact* contact) const;
+
+	// Triangles as they were added, then reordered to
+	// follow the leaves once built
+	std::vector<float> triangles;
+	std::vector<float> normals;
+	std::vector<EntityId> owners;
+	std::vector<CollisionNode> nodes;
+	float buildMS;
+};
+
+/// <summary>
+/// Reads an .obj's positions and faces into a triangle soup,
+/// nine floats a triangle. Z is flipped and the winding
+/// reversed the same way Mesh does, so the triangles line up
+/// with what is drawn. Faces with more than three corners
+/// are split into a fan
+/// </summary>
+bool LoadCollisionOBJ(std::istream& obj, std::vector<float>& triangles);
+
+/// <summary>
+/// Times of one headless benchmark run
+/// </summary>
+struct CollisionBenchmark
+{
+	unsigned int playerCount;
+	unsigned int ticks;
+	float tickMS;				// Moving every player once
+	float movesPerMS;
+	unsigned int groundedPlayers;	// At the end of the run
+	unsigned int escapedPlayers;	// Ended up below the level's bounds
+};
+
+/// <summary>
+/// Drops players over the level and runs them around it at
+/// a 60 Hz tick, with gravity, for a number of ticks
+/// </summary>
+CollisionBenchmark BenchmarkCapsuleMoves(const LevelCollision& level, unsigned int playerCount, unsigned int ticks);
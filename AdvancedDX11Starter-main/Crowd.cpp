@@ -0,0 +1,640 @@
+#include "Crowd.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string.h>
+
+// How far agents lean right of where they're heading, as a
+// fraction of their speed
+#define CROWD_KEEP_RIGHT 0.1f
+
+CrowdSettings DefaultCrowdSettings()
+{
+	CrowdSettings settings;
+	settings.neighborRange = 2.5f;
+	settings.timeHorizon = 1.0f;
+	settings.hashBuckets = 16384;
+	return settings;
+}
+
+// --------------------------------------------------------
+// ORCA. Every neighbor rules out the velocities that would
+// meet it within the time horizon with a half plane, each
+// side taking half the effort. The new velocity is the one
+// nearest the preferred velocity inside every half plane
+// and the speed limit, or, when there is none, the one
+// breaking them the least. These follow RVO2's programs
+// --------------------------------------------------------
+
+namespace
+{
+	// A half plane's edge. Allowed velocities are on the left
+	// of the direction, which is normalized
+	struct Line
+	{
+		float pointX;
+		float pointZ;
+		float dirX;
+		float dirZ;
+	};
+
+	const float LP_EPSILON = 0.00001f;
+
+	inline float Det(float ax, float az, float bx, float bz)
+	{
+		return ax * bz - az * bx;
+	}
+
+	/// <summary>
+	/// Best velocity on one line within the speed limit and
+	/// every line before it. Fails when they leave none
+	/// </summary>
+	bool LinearProgram1(const Line* lines, unsigned int lineNo, float radius, float optX, float optZ, bool directionOpt, float* resultX, float* resultZ)
+	{
+		const Line& line = lines[lineNo];
+		float dot = line.pointX * line.dirX + line.pointZ * line.dirZ;
+		float discriminant = dot * dot + radius * radius - (line.pointX * line.pointX + line.pointZ * line.pointZ);
+		if (discriminant < 0.0f)
+			return false;
+
+		float root = sqrtf(discriminant);
+		float tLeft = -dot - root;
+		float tRight = -dot + root;
+		for (unsigned int i = 0; i < lineNo; i++)
+		{
+			float denominator = Det(line.dirX, line.dirZ, lines[i].dirX, lines[i].dirZ);
+			float numerator = Det(lines[i].dirX, lines[i].dirZ, line.pointX - lines[i].pointX, line.pointZ - lines[i].pointZ);
+
+			// Parallel lines either rule this one out or don't matter
+			if (fabsf(denominator) <= LP_EPSILON)
+			{
+				if (numerator < 0.0f)
+					return false;
+				continue;
+			}
+
+			float t = numerator / denominator;
+			if (denominator >= 0.0f)
+				tRight = (std::min)(tRight, t);
+			else
+				tLeft = (std::max)(tLeft, t);
+			if (tLeft > tRight)
+				return false;
+		}
+
+		float t;
+		if (directionOpt)
+			t = optX * line.dirX + optZ * line.dirZ > 0.0f ? tRight : tLeft;
+		else
+			t = (std::max)(tLeft, (std::min)(tRight, line.dirX * (optX - line.pointX) + line.dirZ * (optZ - line.pointZ)));
+		*resultX = line.pointX + t * line.dirX;
+		*resultZ = line.pointZ + t * line.dirZ;
+		return true;
+	}
+
+	/// <summary>
+	/// Best velocity inside every line and the speed limit,
+	/// adding lines one at a time. Returns the count of lines
+	/// when it succeeds and the one it failed on otherwise
+	/// </summary>
+	unsigned int LinearProgram2(const Line* lines, unsigned int lineCount, float radius, float optX, float optZ, bool directionOpt, float* resultX, float* resultZ)
+	{
+		float optLengthSq = optX * optX + optZ * optZ;
+		if (directionOpt)
+		{
+			*resultX = optX * radius;
+			*resultZ = optZ * radius;
+		}
+		else if (optLengthSq > radius * radius)
+		{
+			float scale = radius / sqrtf(optLengthSq);
+			*resultX = optX * scale;
+			*resultZ = optZ * scale;
+		}
+		else
+		{
+			*resultX = optX;
+			*resultZ = optZ;
+		}
+
+		for (unsigned int i = 0; i < lineCount; i++)
+		{
+			// Already on the allowed side
+			if (Det(lines[i].dirX, lines[i].dirZ, lines[i].pointX - *resultX, lines[i].pointZ - *resultZ) <= 0.0f)
+				continue;
+
+			float keepX = *resultX;
+			float keepZ = *resultZ;
+			if (!LinearProgram1(lines, i, radius, optX, optZ, directionOpt, resultX, resultZ))
+			{
+				*resultX = keepX;
+				*resultZ = keepZ;
+				return i;
+			}
+		}
+		return lineCount;
+	}
+
+	/// <summary>
+	/// When no velocity satisfies every line, finds the one
+	/// that strays the least far past any of them
+	/// </summary>
+	void LinearProgram3(const Line* lines, unsigned int lineCount, unsigned int beginLine, float radius, float* resultX, float* resultZ)
+	{
+		Line projected[CROWD_MAX_NEIGHBORS];
+		float distance = 0.0f;
+		for (unsigned int i = beginLine; i < lineCount; i++)
+		{
+			const Line& line = lines[i];
+			if (Det(line.dirX, line.dirZ, line.pointX - *resultX, line.pointZ - *resultZ) <= distance)
+				continue;
+
+			unsigned int projectedCount = 0;
+			for (unsigned int j = 0; j < i; j++)
+			{
+				Line p;
+				float determinant = Det(line.dirX, line.dirZ, lines[j].dirX, lines[j].dirZ);
+				if (fabsf(determinant) <= LP_EPSILON)
+				{
+					// Parallel and facing the same way
+					if (line.dirX * lines[j].dirX + line.dirZ * lines[j].dirZ > 0.0f)
+						continue;
+
+					p.pointX = 0.5f * (line.pointX + lines[j].pointX);
+					p.pointZ = 0.5f * (line.pointZ + lines[j].pointZ);
+				}
+				else
+				{
+					float t = Det(lines[j].dirX, lines[j].dirZ, line.pointX - lines[j].pointX, line.pointZ - lines[j].pointZ) / determinant;
+					p.pointX = line.pointX + t * line.dirX;
+					p.pointZ = line.pointZ + t * line.dirZ;
+				}
+
+				float dx = lines[j].dirX - line.dirX;
+				float dz = lines[j].dirZ - line.dirZ;
+				float length = sqrtf(dx * dx + dz * dz);
+				if (length <= LP_EPSILON)
+					continue;
+				p.dirX = dx / length;
+				p.dirZ = dz / length;
+				projected[projectedCount++] = p;
+			}
+
+			float keepX = *resultX;
+			float keepZ = *resultZ;
+			if (LinearProgram2(projected, projectedCount, radius, -line.dirZ, line.dirX, true, resultX, resultZ) < projectedCount)
+			{
+				// Can only fail from rounding, in which case the
+				// last result is as good as any
+				*resultX = keepX;
+				*resultZ = keepZ;
+			}
+			distance = Det(line.dirX, line.dirZ, line.pointX - *resultX, line.pointZ - *resultZ);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Crowd
+// --------------------------------------------------------
+
+Crowd::Crowd() :
+	settings(DefaultCrowdSettings()),
+	navMesh(nullptr)
+{
+}
+
+void Crowd::Init(const CrowdSettings& settings)
+{
+	this->settings = settings;
+}
+
+unsigned int Crowd::AddAgent(EntityId entity, const float position[3], float agentRadius, float agentMaxSpeed)
+{
+	unsigned int agent = (unsigned int)px.size();
+	entities.push_back(entity);
+	px.push_back(position[0]);
+	py.push_back(position[1]);
+	pz.push_back(position[2]);
+	vx.push_back(0.0f);
+	vz.push_back(0.0f);
+	nextVx.push_back(0.0f);
+	nextVz.push_back(0.0f);
+	radius.push_back(agentRadius);
+	maxSpeed.push_back(agentMaxSpeed);
+	arriveDistance.push_back(0.0f);
+	cornerCount.push_back(0);
+	corner.push_back(0);
+	corners.resize(corners.size() + CROWD_MAX_CORNERS * 3);
+	return agent;
+}
+
+void Crowd::SetPath(unsigned int agent, Span<const float> path, float arrive)
+{
+	unsigned int count = (unsigned int)(std::min)(path.size() / 3, (size_t)CROWD_MAX_CORNERS);
+	memcpy(&corners[agent * CROWD_MAX_CORNERS * 3], path.data(), sizeof(float) * 3 * count);
+	cornerCount[agent] = (unsigned char)count;
+	arriveDistance[agent] = arrive;
+
+	// The first corner is usually where the agent stood when
+	// the path was asked for
+	corner[agent] = count > 1 ? 1 : 0;
+}
+
+void Crowd::Update(float deltaTime)
+{
+	BuildHash();
+	SteerRange(0, GetAgentCount(), deltaTime);
+	MoveRange(0, GetAgentCount(), deltaTime);
+}
+
+unsigned int Crowd::AddJobs(RenderJobGraph* graph, unsigned int jobCount, float deltaTime)
+{
+	jobCount = (std::max)(1u, (std::min)(jobCount, (unsigned int)CROWD_MAX_JOBS));
+	unsigned int agentCount = GetAgentCount();
+
+	// Every velocity is picked from where everyone stands
+	// before anyone moves
+	unsigned int hash = graph->AddJob("Crowd Hash", [this](unsigned int) { BuildHash(); });
+	unsigned int steers[CROWD_MAX_JOBS];
+	for (unsigned int j = 0; j < jobCount; j++)
+	{
+		unsigned int first = agentCount * j / jobCount;
+		unsigned int end = agentCount * (j + 1) / jobCount;
+		steers[j] = graph->AddJob("Crowd Steer", [this, first, end, deltaTime](unsigned int) { SteerRange(first, end, deltaTime); }, Span<const unsigned int>(&hash, 1));
+	}
+	unsigned int steered = graph->AddJob("Crowd Steered", [](unsigned int) {}, Span<const unsigned int>(steers, jobCount));
+
+	unsigned int moves[CROWD_MAX_JOBS];
+	for (unsigned int j = 0; j < jobCount; j++)
+	{
+		unsigned int first = agentCount * j / jobCount;
+		unsigned int end = agentCount * (j + 1) / jobCount;
+		moves[j] = graph->AddJob("Crowd Move", [this, first, end, deltaTime](unsigned int) { MoveRange(first, end, deltaTime); }, Span<const unsigned int>(&steered, 1));
+	}
+	return graph->AddJob("Finish Crowd", [](unsigned int) {}, Span<const unsigned int>(moves, jobCount));
+}
+
+void Crowd::WriteTransforms(EntityStore* store, float footOffset) const
+{
+	for (unsigned int a = 0; a < GetAgentCount(); a++)
+	{
+		TransformComponent* transform = store->Get<TransformComponent>(entities[a]);
+		if (!transform)
+			continue;
+
+		transform->position[0] = px[a];
+		transform->position[1] = py[a] + footOffset * transform->scale[1];
+		transform->position[2] = pz[a];
+		if (vx[a] * vx[a] + vz[a] * vz[a] > 0.01f)
+			transform->pitchYawRoll[1] = atan2f(vx[a], vz[a]);
+		transform->dirty = true;
+	}
+}
+
+void Crowd::GetPosition(unsigned int agent, float position[3]) const
+{
+	position[0] = px[agent];
+	position[1] = py[agent];
+	position[2] = pz[agent];
+}
+
+float Crowd::GetSpeed(unsigned int agent) const
+{
+	return sqrtf(vx[agent] * vx[agent] + vz[agent] * vz[agent]);
+}
+
+bool Crowd::HasArrived(unsigned int agent) const
+{
+	if (cornerCount[agent] == 0)
+		return true;
+
+	const float* goal = &corners[(agent * CROWD_MAX_CORNERS + cornerCount[agent] - 1) * 3];
+	float dx = goal[0] - px[agent];
+	float dz = goal[2] - pz[agent];
+	return corner[agent] + 1 >= cornerCount[agent] &&
+		dx * dx + dz * dz <= (arriveDistance[agent] + radius[agent]) * (arriveDistance[agent] + radius[agent]);
+}
+
+unsigned int Crowd::Bucket(int cellX, int cellZ) const
+{
+	return ((unsigned int)cellX * 73856093u ^ (unsigned int)cellZ * 19349663u) & (settings.hashBuckets - 1);
+}
+
+/// <summary>
+/// Counting sort of the agents by the bucket of the cell
+/// they stand in, with the bucket table grown to stay at
+/// least twice the size of the crowd
+/// </summary>
+void Crowd::BuildHash()
+{
+	unsigned int agentCount = GetAgentCount();
+	while (settings.hashBuckets < agentCount * 2)
+		settings.hashBuckets *= 2;
+
+	float inverseCell = 1.0f / settings.neighborRange;
+	bucketStart.assign(settings.hashBuckets + 1, 0);
+	agentBuckets.resize(agentCount);
+	sorted.resize(agentCount);
+	for (unsigned int a = 0; a < agentCount; a++)
+	{
+		unsigned int bucket = Bucket((int)floorf(px[a] * inverseCell), (int)floorf(pz[a] * inverseCell));
+		agentBuckets[a] = bucket;
+		bucketStart[bucket]++;
+	}
+
+	// Running totals, then each agent placed from the back of
+	// its bucket leaves every entry at the start of its bucket
+	for (unsigned int b = 1; b <= settings.hashBuckets; b++)
+		bucketStart[b] += bucketStart[b - 1];
+	for (unsigned int a = agentCount; a-- > 0; )
+		sorted[--bucketStart[agentBuckets[a]]] = a;
+}
+
+/// <summary>
+/// Picks each agent's next velocity: towards its next corner,
+/// slowing into the last, then bent by ORCA around its nearest
+/// neighbors within range
+/// </summary>
+void Crowd::SteerRange(unsigned int first, unsigned int end, float deltaTime)
+{
+	const float inverseCell = 1.0f / settings.neighborRange;
+	const float rangeSq = settings.neighborRange * settings.neighborRange;
+	const float inverseHorizon = 1.0f / settings.timeHorizon;
+	const float inverseStep = 1.0f / deltaTime;
+
+	for (unsigned int a = first; a < end; a++)
+	{
+		// Where it would go if alone
+		float preferX = 0.0f;
+		float preferZ = 0.0f;
+		if (corner[a] < cornerCount[a])
+		{
+			const float* c = &corners[(a * CROWD_MAX_CORNERS + corner[a]) * 3];
+			float dx = c[0] - px[a];
+			float dz = c[2] - pz[a];
+			float distance = sqrtf(dx * dx + dz * dz);
+			bool last = corner[a] + 1 == cornerCount[a];
+			float remaining = last ? distance - arriveDistance[a] : distance;
+			if (remaining > 0.0f && distance > 1e-4f)
+			{
+				// Leaning a little to the right breaks the standoffs
+				// of agents meeting exactly head on, which ORCA alone
+				// leaves stuck, by having both keep right
+				float speed = last ? (std::min)(maxSpeed[a], remaining * 2.0f) : maxSpeed[a];
+				float forwardX = dx / distance;
+				float forwardZ = dz / distance;
+				preferX = (forwardX + forwardZ * CROWD_KEEP_RIGHT) * speed;
+				preferZ = (forwardZ - forwardX * CROWD_KEEP_RIGHT) * speed;
+			}
+		}
+
+		// Nearest neighbors in the cells around it. Two cells can
+		// share a bucket, so each bucket is only looked in once
+		unsigned int neighbors[CROWD_MAX_NEIGHBORS];
+		float neighborDistances[CROWD_MAX_NEIGHBORS];
+		unsigned int neighborCount = 0;
+		unsigned int seen[9];
+		unsigned int seenCount = 0;
+		int cellX = (int)floorf(px[a] * inverseCell);
+		int cellZ = (int)floorf(pz[a] * inverseCell);
+		for (int z = cellZ - 1; z <= cellZ + 1; z++)
+		{
+			for (int x = cellX - 1; x <= cellX + 1; x++)
+			{
+				unsigned int bucket = Bucket(x, z);
+				bool again = false;
+				for (unsigned int s = 0; s < seenCount; s++)
+					again = again || seen[s] == bucket;
+				if (again)
+					continue;
+				seen[seenCount++] = bucket;
+
+				for (unsigned int s = bucketStart[bucket]; s < bucketStart[bucket + 1]; s++)
+				{
+					unsigned int other = sorted[s];
+					float dx = px[other] - px[a];
+					float dz = pz[other] - pz[a];
+					float distanceSq = dx * dx + dz * dz;
+					if (other == a || distanceSq >= rangeSq)
+						continue;
+					if (neighborCount == CROWD_MAX_NEIGHBORS && distanceSq >= neighborDistances[neighborCount - 1])
+						continue;
+
+					unsigned int slot = neighborCount < CROWD_MAX_NEIGHBORS ? neighborCount++ : neighborCount - 1;
+					while (slot > 0 && neighborDistances[slot - 1] > distanceSq)
+					{
+						neighbors[slot] = neighbors[slot - 1];
+						neighborDistances[slot] = neighborDistances[slot - 1];
+						slot--;
+					}
+					neighbors[slot] = other;
+					neighborDistances[slot] = distanceSq;
+				}
+			}
+		}
+
+		// A half plane for each
+		Line lines[CROWD_MAX_NEIGHBORS];
+		for (unsigned int n = 0; n < neighborCount; n++)
+		{
+			unsigned int other = neighbors[n];
+			float relPosX = px[other] - px[a];
+			float relPosZ = pz[other] - pz[a];
+			float relVelX = vx[a] - vx[other];
+			float relVelZ = vz[a] - vz[other];
+			float distanceSq = neighborDistances[n];
+			float combinedRadius = radius[a] + radius[other];
+			float combinedRadiusSq = combinedRadius * combinedRadius;
+
+			Line& line = lines[n];
+			float uX;
+			float uZ;
+			if (distanceSq > combinedRadiusSq)
+			{
+				// From the relative velocity to the cutoff circle's center
+				float wX = relVelX - inverseHorizon * relPosX;
+				float wZ = relVelZ - inverseHorizon * relPosZ;
+				float wLengthSq = wX * wX + wZ * wZ;
+				float dot = wX * relPosX + wZ * relPosZ;
+
+				if (dot < 0.0f && dot * dot > combinedRadiusSq * wLengthSq)
+				{
+					// Nearest the cutoff circle
+					float wLength = sqrtf(wLengthSq);
+					float unitX = wX / wLength;
+					float unitZ = wZ / wLength;
+					line.dirX = unitZ;
+					line.dirZ = -unitX;
+					uX = (combinedRadius * inverseHorizon - wLength) * unitX;
+					uZ = (combinedRadius * inverseHorizon - wLength) * unitZ;
+				}
+				else
+				{
+					// Nearest one of the cone's legs
+					float leg = sqrtf(distanceSq - combinedRadiusSq);
+					if (Det(relPosX, relPosZ, wX, wZ) > 0.0f)
+					{
+						line.dirX = (relPosX * leg - relPosZ * combinedRadius) / distanceSq;
+						line.dirZ = (relPosX * combinedRadius + relPosZ * leg) / distanceSq;
+					}
+					else
+					{
+						line.dirX = -(relPosX * leg + relPosZ * combinedRadius) / distanceSq;
+						line.dirZ = -(-relPosX * combinedRadius + relPosZ * leg) / distanceSq;
+					}
+					float dot2 = relVelX * line.dirX + relVelZ * line.dirZ;
+					uX = dot2 * line.dirX - relVelX;
+					uZ = dot2 * line.dirZ - relVelZ;
+				}
+			}
+			else
+			{
+				// Already overlapping, so get apart within this tick
+				float wX = relVelX - inverseStep * relPosX;
+				float wZ = relVelZ - inverseStep * relPosZ;
+				float wLength = sqrtf(wX * wX + wZ * wZ);
+				if (wLength <= LP_EPSILON)
+				{
+					wX = 1.0f;
+					wZ = 0.0f;
+					wLength = 1.0f;
+				}
+				float unitX = wX / wLength;
+				float unitZ = wZ / wLength;
+				line.dirX = unitZ;
+				line.dirZ = -unitX;
+				uX = (combinedRadius * inverseStep - wLength) * unitX;
+				uZ = (combinedRadius * inverseStep - wLength) * unitZ;
+			}
+
+			line.pointX = vx[a] + 0.5f * uX;
+			line.pointZ = vz[a] + 0.5f * uZ;
+		}
+
+		float resultX;
+		float resultZ;
+		unsigned int failed = LinearProgram2(lines, neighborCount, maxSpeed[a], preferX, preferZ, false, &resultX, &resultZ);
+		if (failed < neighborCount)
+			LinearProgram3(lines, neighborCount, failed, maxSpeed[a], &resultX, &resultZ);
+
+		nextVx[a] = resultX;
+		nextVz[a] = resultZ;
+	}
+}
+
+/// <summary>
+/// Moves agents by their new velocities, passes corners they
+/// reached and keeps them on the navigation mesh. What they
+/// actually moved becomes their velocity, so neighbors see
+/// an agent held back by a wall as standing still
+/// </summary>
+void Crowd::MoveRange(unsigned int first, unsigned int end, float deltaTime)
+{
+	for (unsigned int a = first; a < end; a++)
+	{
+		float position[3] =
+		{
+			px[a] + nextVx[a] * deltaTime,
+			py[a],
+			pz[a] + nextVz[a] * deltaTime
+		};
+
+		if (navMesh)
+		{
+			float nearest[3];
+			if (navMesh->FindNearestPoly(position, 1.0f, nearest) >= 0)
+				memcpy(position, nearest, sizeof(position));
+		}
+
+		vx[a] = (position[0] - px[a]) / deltaTime;
+		vz[a] = (position[2] - pz[a]) / deltaTime;
+		px[a] = position[0];
+		py[a] = position[1];
+		pz[a] = position[2];
+
+		// Corners before the last are passed once within reach
+		while (corner[a] + 1 < cornerCount[a])
+		{
+			const float* c = &corners[(a * CROWD_MAX_CORNERS + corner[a]) * 3];
+			float dx = c[0] - px[a];
+			float dz = c[2] - pz[a];
+			if (dx * dx + dz * dz > radius[a] * radius[a])
+				break;
+			corner[a]++;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Benchmark
+// --------------------------------------------------------
+
+CrowdBenchmark BenchmarkCrowd(unsigned int agentCount, unsigned int ticks, unsigned int workerCount)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const float deltaTime = 1.0f / 60.0f;
+	const float agentRadius = 0.4f;
+	const float spacing = 2.0f;
+
+	CrowdBenchmark result = {};
+	result.agentCount = agentCount;
+	result.ticks = ticks;
+	result.workerCount = workerCount;
+
+	// Two square blocks a step apart, every agent heading for
+	// its mirror image on the other side
+	unsigned int side = (unsigned int)ceilf(sqrtf(agentCount * 0.5f));
+	auto populate = [&](Crowd& crowd)
+	{
+		crowd.Init(DefaultCrowdSettings());
+		for (unsigned int i = 0; i < agentCount; i++)
+		{
+			unsigned int k = i / 2;
+			float sign = i % 2 == 0 ? -1.0f : 1.0f;
+			float position[3] = { sign * (1.0f + (k / side) * spacing), 0.0f, ((float)(k % side) - side * 0.5f) * spacing };
+			float goal[3] = { -position[0], 0.0f, position[2] };
+			unsigned int agent = crowd.AddAgent(EntityId(), position, agentRadius, 2.0f);
+			crowd.SetPath(agent, Span<const float>(goal, 3), 0.1f);
+		}
+	};
+
+	Crowd serial;
+	populate(serial);
+	Clock::time_point start = Clock::now();
+	for (unsigned int t = 0; t < ticks; t++)
+		serial.Update(deltaTime);
+	result.serialTickMS = std::chrono::duration<float, std::milli>(Clock::now() - start).count() / ticks;
+
+	Crowd parallel;
+	populate(parallel);
+	RenderJobGraph graph(workerCount);
+	start = Clock::now();
+	for (unsigned int t = 0; t < ticks; t++)
+	{
+		graph.Reset();
+		parallel.AddJobs(&graph, workerCount + 1, deltaTime);
+		graph.Run(true);
+	}
+	result.parallelTickMS = std::chrono::duration<float, std::milli>(Clock::now() - start).count() / ticks;
+
+	// Both runs pick the same velocities, so either can be checked
+	for (unsigned int a = 0; a < agentCount; a++)
+	{
+		float pa[3];
+		parallel.GetPosition(a, pa);
+		for (unsigned int b = a + 1; b < agentCount; b++)
+		{
+			float pb[3];
+			parallel.GetPosition(b, pb);
+			float dx = pb[0] - pa[0];
+			float dz = pb[2] - pa[2];
+			float limit = agentRadius * 2.0f * 0.9f;
+			if (dx * dx + dz * dz < limit * limit)
+				result.overlaps++;
+		}
+		result.averageSpeed += parallel.GetSpeed(a) / agentCount;
+	}
+	return result;
+}
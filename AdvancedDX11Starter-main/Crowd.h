@@ -0,0 +1,130 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Move large groups of agents without them walking
+//			through each other. Agents are kept as structure of
+//			arrays and found by a spatial hash rebuilt every
+//			tick. Each agent steers towards the next corner of
+//			its path and picks the velocity closest to that
+//			which none of its nearest neighbors will run into
+//			soon, solving ORCA's half planes as a small linear
+//			program. Velocities are all chosen from last tick's
+//			state before anyone moves, so agents can be split
+//			across the job graph's workers in any way.
+
+#include <vector>
+
+#include "EntityStore.h"
+#include "NavMesh.h"
+#include "FrameArena.h"
+#include "RenderJobGraph.h"
+
+// Most neighbors an agent avoids at once, nearest first
+#define CROWD_MAX_NEIGHBORS 10
+
+// Most corners of a path an agent keeps. Longer paths are
+// cut short, to be asked for again before they run out
+#define CROWD_MAX_CORNERS 16
+
+// Most jobs a tick is split into
+#define CROWD_MAX_JOBS 64
+
+/// <summary>
+/// How far agents look and how far ahead they avoid
+/// </summary>
+struct CrowdSettings
+{
+	float neighborRange;	// Also the size of a hash cell
+	float timeHorizon;		// Seconds of moving straight that must stay clear
+	unsigned int hashBuckets;	// Power of two, at least twice the agent count
+};
+
+CrowdSettings DefaultCrowdSettings();
+
+class Crowd
+{
+public:
+	Crowd();
+
+	void Init(const CrowdSettings& settings);
+
+	// Agents are kept on the mesh's polygons after moving.
+	// Null leaves them free on flat ground
+	void SetNavMesh(const NavMesh* mesh) { navMesh = mesh; }
+
+	// Returns the agent's index, which never changes
+	unsigned int AddAgent(EntityId entity, const float position[3], float radius, float maxSpeed);
+
+	// Corners to walk, three floats each, the last being
+	// where to stop once within arriveDistance of it
+	void SetPath(unsigned int agent, Span<const float> corners, float arriveDistance);
+
+	// Moves every agent on the calling thread
+	void Update(float deltaTime);
+
+	// Adds a tick to a job graph split into jobCount runs of
+	// agents (at most CROWD_MAX_JOBS) and returns the index
+	// of a job waiting on all of it
+	unsigned int AddJobs(RenderJobGraph* graph, unsigned int jobCount, float deltaTime);
+
+	// Copies every agent onto its entity's transform, lifted
+	// by footOffset times its scale, facing the way it moves
+	void WriteTransforms(EntityStore* store, float footOffset) const;
+
+	unsigned int GetAgentCount() const { return (unsigned int)px.size(); }
+	void GetPosition(unsigned int agent, float position[3]) const;
+	float GetSpeed(unsigned int agent) const;
+	bool HasArrived(unsigned int agent) const;
+
+private:
+	void BuildHash();
+	void SteerRange(unsigned int first, unsigned int end, float deltaTime);
+	void MoveRange(unsigned int first, unsigned int end, float deltaTime);
+	unsigned int Bucket(int cellX, int cellZ) const;
+
+	CrowdSettings settings;
+	const NavMesh* navMesh;
+
+	// Agents
+	std::vector<EntityId> entities;
+	std::vector<float> px;
+	std::vector<float> py;
+	std::vector<float> pz;
+	std::vector<float> vx;
+	std::vector<float> vz;
+	std::vector<float> nextVx;		// Chosen this tick, applied once all have chosen
+	std::vector<float> nextVz;
+	std::vector<float> radius;
+	std::vector<float> maxSpeed;
+	std::vector<float> arriveDistance;
+	std::vector<unsigned char> cornerCount;
+	std::vector<unsigned char> corner;		// Next corner walked to
+	std::vector<float> corners;				// CROWD_MAX_CORNERS each
+
+	// Agents sorted by bucket, those of bucket b being
+	// bucketStart[b] up to bucketStart[b + 1]
+	std::vector<unsigned int> bucketStart;
+	std::vector<unsigned int> sorted;
+	std::vector<unsigned int> agentBuckets;
+};
+
+/// <summary>
+/// Times of one headless benchmark run
+/// </summary>
+struct CrowdBenchmark
+{
+	unsigned int agentCount;
+	unsigned int ticks;
+	unsigned int workerCount;
+	float serialTickMS;
+	float parallelTickMS;
+	unsigned int overlaps;		// Pairs closer than 90% of their radii at the end
+	float averageSpeed;			// At the end, out of 2 m/s
+};
+
+/// <summary>
+/// Two blocks of agents two meters apart walk through each
+/// other to swap sides on open ground at a 60 Hz tick, once
+/// on the calling thread and once across a graph of workers
+/// </summary>
+CrowdBenchmark BenchmarkCrowd(unsigned int agentCount, unsigned int ticks, unsigned int workerCount);
@@ -1,265 +1,522 @@
 #pragma once
 
 #include <DirectXMath.h>
+#include <d3d11.h>
+#include <wrl/client.h>
 #include <vector>
+#include <memory>
+#include <string.h>
+#include <fstream>
+#include <iterator>
 
 #include "Transform.h"
 #include "string"
 
-#include "Mesh.h"
+#include "SimpleShader.h"
+#include "Camera.h"
 #include "Helpers.h"
+#include "DebugGeometry.h"
+#include "DebugText.h"
 
 // Helper macros for making texture and shader loading code more succinct
 #define LoadTexture(file, srv) CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(file).c_str(), 0, srv.GetAddressOf())
 #define LoadShader(type, file) std::make_shared<type>(device.Get(), context.Get(), FixPath(file).c_str())
 
-enum DebugMeshType
-{
-	LINE		= 0,
-	CROSS		= 1,
-	SPHERE		= 2,
-	CIRCLE		= 3,
-	AXES		= 4,
-	TRIANGLE	= 5,
-	AABB		= 6,
-	OBB			= 7,
-	STRING		= 8
-};
-
-struct DebugEntity
-{
-	std::shared_ptr<GameEntity> entity;
-	DirectX::XMFLOAT3 color;
+// Smallest the debug vertex buffer is ever made, in vertices
+#define DEBUG_LINE_MIN_VERTICES 65536
 
-	DebugEntity() 
-	{
-		entity = nullptr; 
-		color = DirectX::XMFLOAT3(0, 0, 0);
-	}
-};
+// Smallest the debug glyph buffer is ever made, in glyphs
+#define DEBUG_TEXT_MIN_GLYPHS 16384
 
+/// <summary>
+/// Everything debug drawn this frame, added to from the main
+/// thread, plus the dynamic vertex buffer the render thread
+/// streams it through. Items without a duration only last the
+/// frame they were added in and are cleared all at once.
+/// Text works the same way with its own glyph stream
+/// </summary>
 struct DebugDrawData
 {
-	std::vector<DebugEntity> drawGroup;
-	std::vector<std::shared_ptr<Mesh>> debugMeshes;
-	std::shared_ptr<RendMat> debugMat;
+	DebugLineBatch lines;
+	DebugLineLifetimes timed;
+
+	DebugFont font;
+	DebugTextBatch text;
+
+	std::shared_ptr<SimpleVertexShader> lineVS;
+	std::shared_ptr<SimplePixelShader> linePS;
+	std::shared_ptr<SimpleVertexShader> textVS;
+	std::shared_ptr<SimplePixelShader> textPS;
+
+	// Ring of vertices. Only the render thread touches these
+	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
+	unsigned int capacity;
+	unsigned int writeOffset;
+
+	// Glyph atlas and the state text is drawn with. Each
+	// glyph is an instance of a four corner strip
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> atlasSRV;
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> atlasSampler;
+	Microsoft::WRL::ComPtr<ID3D11BlendState> textBlend;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> textDepth;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> cornerBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> glyphBuffer;
+	unsigned int glyphCapacity;
+
+	DebugDrawData() : capacity(0), writeOffset(0), glyphCapacity(0) {}
 
-	std::vector<float> lifeTimes;
+	/// <summary>
+	/// Initiate the debug manager
+	/// </summary>
+	DebugDrawData(
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		Microsoft::WRL::ComPtr<ID3D11Device> device) :
+		capacity(0),
+		writeOffset(0),
+		glyphCapacity(0)
+	{
+		// Load Shaders
+		lineVS = LoadShader(SimpleVertexShader, L"DebugLineVS.cso");
+		linePS = LoadShader(SimplePixelShader, L"DebugLinePS.cso");
+		textVS = LoadShader(SimpleVertexShader, L"DebugTextVS.cso");
+		textPS = LoadShader(SimplePixelShader, L"DebugTextPS.cso");
+
+		CreateTextResources(device.Get());
+	}
 
-	DebugDrawData() {}
+private:
 
 	/// <summary>
-	/// Initiate the debug manager 
+	/// Loads the font's atlas exactly as it is stored, already
+	/// compressed, and makes the state text is drawn with
 	/// </summary>
-	DebugDrawData(
-		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, 
-		Microsoft::WRL::ComPtr<ID3D11Device> device)
+	void CreateTextResources(ID3D11Device* device)
 	{
-		// Load Shaders 
-		std::shared_ptr<SimpleVertexShader> vertexShader = 
-			LoadShader(SimpleVertexShader, L"VertexShader.cso");
-		std::shared_ptr<SimplePixelShader> solidColorPS =
-			LoadShader(SimplePixelShader, L"SolidColorPS.cso");
-
-		std::shared_ptr<Mesh> sphereMesh = std::make_shared<Mesh>(
-			FixPath(L"../../Assets/Models/sphere.obj").c_str(), device);
-
-		debugMat = std::make_shared<RendMat>(
-			DirectX::XMFLOAT3(1, 1, 1), 
-			DirectX::XMFLOAT2(0, 0),
-			DirectX::XMFLOAT2(2, 2));
-		debugMeshes.push_back(sphereMesh);
-		debugMeshes.push_back(sphereMesh);
-		debugMeshes.push_back(sphereMesh);
-
-		drawGroup = std::vector<DebugEntity>();
+		std::ifstream file(FixPath(L"../../Assets/Textures/arial.spritefont"), std::ios::binary);
+		std::vector<unsigned char> bytes(
+			(std::istreambuf_iterator<char>(file)),
+			std::istreambuf_iterator<char>());
+		if (bytes.empty() || !font.Parse(bytes.data(), bytes.size()))
+			return;
+
+		D3D11_TEXTURE2D_DESC atlasDesc = {};
+		atlasDesc.Width = font.GetAtlasWidth();
+		atlasDesc.Height = font.GetAtlasHeight();
+		atlasDesc.MipLevels = 1;
+		atlasDesc.ArraySize = 1;
+		atlasDesc.Format = (DXGI_FORMAT)font.GetAtlasFormat();
+		atlasDesc.SampleDesc.Count = 1;
+		atlasDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		atlasDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		D3D11_SUBRESOURCE_DATA atlasData = {};
+		atlasData.pSysMem = font.GetAtlasData().data();
+		atlasData.SysMemPitch = font.GetAtlasPitch();
+
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> atlas;
+		device->CreateTexture2D(&atlasDesc, &atlasData, atlas.GetAddressOf());
+		if (atlas)
+			device->CreateShaderResourceView(atlas.Get(), 0, atlasSRV.GetAddressOf());
+
+		D3D11_SAMPLER_DESC samplerDesc = {};
+		samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+		samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+		samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+		samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+		samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+		device->CreateSamplerState(&samplerDesc, atlasSampler.GetAddressOf());
+
+		// Premultiplied alpha
+		D3D11_BLEND_DESC blendDesc = {};
+		blendDesc.RenderTarget[0].BlendEnable = TRUE;
+		blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_ONE;
+		blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+		blendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+		blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+		blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+		blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+		blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+		device->CreateBlendState(&blendDesc, textBlend.GetAddressOf());
+
+		// Labels are read over everything
+		D3D11_DEPTH_STENCIL_DESC depthDesc = {};
+		depthDesc.DepthEnable = FALSE;
+		depthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+		depthDesc.DepthFunc = D3D11_COMPARISON_ALWAYS;
+		device->CreateDepthStencilState(&depthDesc, textDepth.GetAddressOf());
+
+		const float corners[4][2] = { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 } };
+		D3D11_BUFFER_DESC cornerDesc = {};
+		cornerDesc.ByteWidth = sizeof(corners);
+		cornerDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		cornerDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		D3D11_SUBRESOURCE_DATA cornerData = {};
+		cornerData.pSysMem = corners;
+		device->CreateBuffer(&cornerDesc, &cornerData, cornerBuffer.GetAddressOf());
 	}
 };
 
 /// <summary>
-/// Update the lifetimes of the debug draw items and remove
-/// if lifetime has reached <= 0
+/// Uploads a frame of debug lines and draws them with a single
+/// call. The buffer is written as a ring, only discarded when
+/// it wraps, except on deferred contexts which have to discard
+/// on their first map of it in every command list
 /// </summary>
-static void ManageDebugLife(DebugDrawData* DDD, float delta)
+static void DrawDebugLines(
+	DebugDrawData* DDD,
+	ID3D11Device* device,
+	ID3D11DeviceContext* context,
+	bool deferred,
+	const std::vector<DebugVertex>& vertices,
+	Camera* camera)
 {
-	for (int i = 0; i < DDD->lifeTimes.size(); i++)
+	if (vertices.empty())
+		return;
+
+	// Grow to fit the whole frame so it stays one draw
+	unsigned int count = (unsigned int)vertices.size();
+	if (count > DDD->capacity)
+	{
+		unsigned int capacity = DDD->capacity > 0 ? DDD->capacity : DEBUG_LINE_MIN_VERTICES;
+		while (capacity < count)
+			capacity *= 2;
+
+		D3D11_BUFFER_DESC desc = {};
+		desc.ByteWidth = capacity * sizeof(DebugVertex);
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		if (FAILED(device->CreateBuffer(&desc, 0, DDD->vertexBuffer.ReleaseAndGetAddressOf())))
+		{
+			DDD->capacity = 0;
+			return;
+		}
+
+		DDD->capacity = capacity;
+		DDD->writeOffset = capacity;
+	}
+
+	D3D11_MAP mapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+	if (deferred || DDD->writeOffset + count > DDD->capacity)
 	{
-		DDD->lifeTimes[i] -= delta;
+		mapType = D3D11_MAP_WRITE_DISCARD;
+		DDD->writeOffset = 0;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(DDD->vertexBuffer.Get(), 0, mapType, 0, &mapped)))
+		return;
+	memcpy((DebugVertex*)mapped.pData + DDD->writeOffset, vertices.data(), count * sizeof(DebugVertex));
+	context->Unmap(DDD->vertexBuffer.Get(), 0);
+
+	UINT stride = sizeof(DebugVertex);
+	UINT offset = 0;
+	context->IASetVertexBuffers(0, 1, DDD->vertexBuffer.GetAddressOf(), &stride, &offset);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_LINELIST);
+
+	DDD->lineVS->SetShader();
+	DDD->lineVS->SetMatrix4x4("view", camera->viewMatrix);
+	DDD->lineVS->SetMatrix4x4("projection", camera->projMatrix);
+	DDD->lineVS->CopyAllBufferData();
+	DDD->linePS->SetShader();
+
+	context->Draw(count, DDD->writeOffset);
+	DDD->writeOffset += count;
 
-		// Remove from both arrays if lifetime is complete 
-		if (DDD->lifeTimes[i] <= 0.0f)
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+
+/// <summary>
+/// Draws a frame of already projected glyphs over everything
+/// else with a single instanced call. Only ever called on the
+/// immediate context, once per frame, so the buffer is always
+/// discarded rather than written as a ring
+/// </summary>
+static void DrawDebugText(
+	DebugDrawData* DDD,
+	ID3D11Device* device,
+	ID3D11DeviceContext* context,
+	const std::vector<DebugGlyphInstance>& glyphs,
+	float screenWidth,
+	float screenHeight)
+{
+	if (glyphs.empty() || !DDD->atlasSRV)
+		return;
+
+	unsigned int count = (unsigned int)glyphs.size();
+	if (count > DDD->glyphCapacity)
+	{
+		unsigned int capacity = DDD->glyphCapacity > 0 ? DDD->glyphCapacity : DEBUG_TEXT_MIN_GLYPHS;
+		while (capacity < count)
+			capacity *= 2;
+
+		D3D11_BUFFER_DESC desc = {};
+		desc.ByteWidth = capacity * sizeof(DebugGlyphInstance);
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		if (FAILED(device->CreateBuffer(&desc, 0, DDD->glyphBuffer.ReleaseAndGetAddressOf())))
 		{
-			DDD->lifeTimes.erase(DDD->lifeTimes.begin() + i);
-			DDD->drawGroup.erase(DDD->drawGroup.begin() + i);
-			i--;
+			DDD->glyphCapacity = 0;
+			return;
 		}
+		DDD->glyphCapacity = capacity;
 	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(DDD->glyphBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return;
+	memcpy(mapped.pData, glyphs.data(), count * sizeof(DebugGlyphInstance));
+	context->Unmap(DDD->glyphBuffer.Get(), 0);
+
+	ID3D11Buffer* buffers[2] = { DDD->cornerBuffer.Get(), DDD->glyphBuffer.Get() };
+	UINT strides[2] = { sizeof(float) * 2, sizeof(DebugGlyphInstance) };
+	UINT offsets[2] = { 0, 0 };
+	context->IASetVertexBuffers(0, 2, buffers, strides, offsets);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+
+	DDD->textVS->SetShader();
+	DDD->textVS->SetFloat2("screenSize", DirectX::XMFLOAT2(screenWidth, screenHeight));
+	DDD->textVS->CopyAllBufferData();
+	DDD->textPS->SetShader();
+	DDD->textPS->SetShaderResourceView("Atlas", DDD->atlasSRV);
+	DDD->textPS->SetSamplerState("AtlasSampler", DDD->atlasSampler);
+
+	float blendFactor[4] = { 0, 0, 0, 0 };
+	context->OMSetBlendState(DDD->textBlend.Get(), blendFactor, 0xFFFFFFFF);
+	context->OMSetDepthStencilState(DDD->textDepth.Get(), 0);
+
+	context->DrawInstanced(4, count, 0, 0);
+
+	context->OMSetBlendState(0, blendFactor, 0xFFFFFFFF);
+	context->OMSetDepthStencilState(0, 0);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 }
 
-#pragma region AddToDrawGroup
+/// <summary>
+/// Moves timed items forward, dropping the ones that expired.
+/// Called before anything is added for the frame
+/// </summary>
+static void AdvanceDebugDraws(DebugDrawData* DDD, float deltaTime)
+{
+	DDD->timed.Advance(deltaTime);
+	DDD->text.Advance(deltaTime);
+}
 
 /// <summary>
-/// Adds a line segement to debug drawing queue 
+/// Hands every line of the frame over to the renderer. The
+/// frame batch takes the given vector in exchange so its
+/// memory is reused instead of freed
 /// </summary>
-static void AddDebugLine(
+static void CollectDebugLines(DebugDrawData* DDD, std::vector<DebugVertex>& out)
+{
+	DDD->timed.AppendTo(DDD->lines);
+	out.swap(DDD->lines.GetVertices());
+	DDD->lines.Clear();
+}
+
+/// <summary>
+/// Projects every label with the camera the frame is drawn
+/// with. Anything behind it or off screen never leaves here
+/// </summary>
+static void CollectDebugText(
 	DebugDrawData* DDD,
-	Microsoft::WRL::ComPtr<ID3D11Device> device,
-	DirectX::XMFLOAT3 pointA,
-	DirectX::XMFLOAT3 pointB,
-	DirectX::XMFLOAT3 color,
-	float lineWidth = 1.0f,
-	float duration = 0.0f)
+	Camera* camera,
+	float screenWidth,
+	float screenHeight,
+	std::vector<DebugGlyphInstance>& out)
 {
-	// Generate a mesh that simply has its verticies at 
-	// pointA and pointB 
+	out.clear();
 
-	Vertex vertA = {};
-	Vertex vertB = {};
-	vertA.Position = DirectX::XMFLOAT3(pointA);
-	vertB.Position = DirectX::XMFLOAT3(pointB);
+	DirectX::XMFLOAT4X4 viewProj;
+	DirectX::XMStoreFloat4x4(&viewProj, DirectX::XMMatrixMultiply(
+		DirectX::XMLoadFloat4x4(&camera->viewMatrix),
+		DirectX::XMLoadFloat4x4(&camera->projMatrix)));
 
-	// Note: Use three instead of two because
-	//		 our mesh data structure creates
-	//		 some values for each vertex when
-	//		 loaded intro intialization 
+	DDD->text.Build(viewProj.m, screenWidth, screenHeight, out);
+}
 
-	Vertex* vertArr = new Vertex[3];
-	vertArr[0] = vertA;
-	vertArr[1] = vertB;
-	vertArr[2] = vertB;
+/// <summary>
+/// Where an item's lines go: the frame batch when it has no
+/// duration, otherwise the bucket it expires from
+/// </summary>
+static DebugLineBatch& BeginDebugItem(DebugDrawData* DDD, float duration)
+{
+	return duration > 0.0f ? DDD->timed.BeginItem(duration) : DDD->lines;
+}
 
-	unsigned int indexArr[] = { 0, 1, 1 };
-	std::shared_ptr<Mesh> lineMesh = std::make_shared<Mesh>(vertArr, 3, indexArr, 3, device);
-	delete[] vertArr;
+static void EndDebugItem(DebugDrawData* DDD, float duration)
+{
+	if (duration > 0.0f)
+		DDD->timed.EndItem();
+}
 
+#pragma region AddToDrawGroup
 
-	std::shared_ptr<GameEntity> sphere = std::make_shared<GameEntity>(
-		lineMesh, DDD->debugMat);
-	sphere->GetTransform()->SetPosition(pointA);
+// NOTE: Hardware lines are always a single pixel wide, so
+//		 none of these take a width. Items with a duration
+//		 are drawn every frame until it runs out
 
-	DebugEntity de;
-	de.entity = sphere;
-	de.color = color;
-	DDD->drawGroup.push_back(de);
+/// <summary>
+/// Adds a line segement to debug drawing queue
+/// </summary>
+static void AddDebugLine(
+	DebugDrawData* DDD,
+	DirectX::XMFLOAT3 pointA,
+	DirectX::XMFLOAT3 pointB,
+	DirectX::XMFLOAT4 color,
+	float duration = 0.0f)
+{
+	BeginDebugItem(DDD, duration).AddLine(&pointA.x, &pointB.x, &color.x);
+	EndDebugItem(DDD, duration);
 }
 
 /// <summary>
 /// Adds na axis-aligned cross (3 lines converging at a point)
-/// to the debug drawing queue  
+/// to the debug drawing queue
 /// </summary>
 static void AddDebugCross(
+	DebugDrawData* DDD,
 	DirectX::XMFLOAT3 point,
 	DirectX::XMFLOAT4 color,
 	float size,
 	float duration = 0.0f)
 {
-
+	BeginDebugItem(DDD, duration).AddCross(&point.x, size, &color.x);
+	EndDebugItem(DDD, duration);
 }
 
 /// <summary>
-/// Adds a wireframe sphere to the debug drawing queue 
+/// Adds a wireframe sphere to the debug drawing queue
 /// </summary>
 static void AddDebugSphere(
 	DebugDrawData* DDD,
 	DirectX::XMFLOAT3 point,
 	float radius,
-	DirectX::XMFLOAT3 color,
+	DirectX::XMFLOAT4 color,
 	float duration = 0.0f)
 {
-	std::shared_ptr<GameEntity> sphere = std::make_shared<GameEntity>(
-		DDD->debugMeshes[SPHERE], DDD->debugMat);
-	sphere->GetTransform()->SetPosition(point);
-	sphere->GetTransform()->SetScale(radius);
-
-	DebugEntity de;
-	de.entity = sphere;
-	de.color = color;
-	DDD->drawGroup.push_back(de);
+	BeginDebugItem(DDD, duration).AddSphere(&point.x, radius, &color.x);
+	EndDebugItem(DDD, duration);
 }
 
 /// <summary>
-/// Adds a circle to the debug drawing queue 
+/// Adds a circle to the debug drawing queue
 /// </summary>
 static void AddDebugCircle(
+	DebugDrawData* DDD,
 	DirectX::XMFLOAT3 point,
 	DirectX::XMFLOAT3 normal,
 	float radius,
 	DirectX::XMFLOAT4 color,
 	float duration = 0.0f)
 {
-
+	BeginDebugItem(DDD, duration).AddCircle(&point.x, &normal.x, radius, &color.x);
+	EndDebugItem(DDD, duration);
 }
 
 /// <summary>
-/// Adds a set of coordinate axes depicting the 
+/// Adds a set of coordinate axes depicting the
 /// position and orientation ofthe given
-/// transformation to the debug drawing queue 
+/// transformation to the debug drawing queue
 /// </summary>
 static void AddDebugAxes(
+	DebugDrawData* DDD,
 	Transform& xfm,
-	DirectX::XMFLOAT4 color,
 	float size,
 	float duration = 0.0f)
 {
-
+	DirectX::XMFLOAT4X4 world = xfm.GetWorldMatrix();
+	BeginDebugItem(DDD, duration).AddAxes(world.m, size);
+	EndDebugItem(DDD, duration);
 }
 
 /// <summary>
-/// Adds a wireframe triangle to the debug drawing queue 
+/// Adds a wireframe triangle to the debug drawing queue
 /// </summary>
 static void AddDebugTriangle(
+	DebugDrawData* DDD,
 	DirectX::XMFLOAT3 vertA,
 	DirectX::XMFLOAT3 vertB,
 	DirectX::XMFLOAT3 vertC,
 	DirectX::XMFLOAT4 color,
-	float lineWidth = 1.0f,
 	float duration = 0.0f)
 {
-
+	BeginDebugItem(DDD, duration).AddTriangle(&vertA.x, &vertB.x, &vertC.x, &color.x);
+	EndDebugItem(DDD, duration);
 }
 
 /// <summary>
 /// Adds an axis-alligned bounding box to the debug
-/// queue 
+/// queue
 /// </summary>
 /// <param name="minCoords"></param>
 /// <param name="maxCoords"></param>
 /// <param name="color"></param>
-/// <param name="lineWidth"></param>
 /// <param name="duration"></param>
 static void AddDebugAABB(
+	DebugDrawData* DDD,
 	DirectX::XMFLOAT3 minCoords,
 	DirectX::XMFLOAT3 maxCoords,
 	DirectX::XMFLOAT4 color,
-	float lineWidth = 1.0f,
 	float duration = 0.0f)
 {
-
+	BeginDebugItem(DDD, duration).AddAABB(&minCoords.x, &maxCoords.x, &color.x);
+	EndDebugItem(DDD, duration);
 }
 
 /// <summary>
-/// Adds an oriented bounding box to the debug queue 
+/// Adds an oriented bounding box to the debug queue
 /// </summary>
 static void AddDebugOBB(
+	DebugDrawData* DDD,
 	DirectX::XMFLOAT4X4 centerTransform,
 	DirectX::XMFLOAT3 scaleXYZ,
 	DirectX::XMFLOAT4 color,
-	float lineWidth = 1.0f,
 	float duration = 0.0f)
 {
+	BeginDebugItem(DDD, duration).AddOBB(centerTransform.m, &scaleXYZ.x, &color.x);
+	EndDebugItem(DDD, duration);
+}
 
+/// <summary>
+/// Adds the volume a view and projection can see to
+/// the debug queue, such as a camera or shadow cascade
+/// </summary>
+static void AddDebugFrustum(
+	DebugDrawData* DDD,
+	DirectX::XMFLOAT4X4 view,
+	DirectX::XMFLOAT4X4 projection,
+	DirectX::XMFLOAT4 color,
+	float duration = 0.0f)
+{
+	DirectX::XMMATRIX viewProj = DirectX::XMMatrixMultiply(
+		DirectX::XMLoadFloat4x4(&view),
+		DirectX::XMLoadFloat4x4(&projection));
+
+	DirectX::XMFLOAT4X4 inverse;
+	DirectX::XMStoreFloat4x4(&inverse, DirectX::XMMatrixInverse(0, viewProj));
+	BeginDebugItem(DDD, duration).AddFrustum(inverse.m, &color.x);
+	EndDebugItem(DDD, duration);
 }
 
 /// <summary>
-/// Adds a text string to the debug drawing queue 
+/// Adds a text string to the debug drawing queue, centered
+/// above the given point. Strings are laid out the first time
+/// they are seen, so repeating one costs a lookup
 /// </summary>
 static void AddDebugString(
+	DebugDrawData* DDD,
 	DirectX::XMFLOAT3 pos,
-	std::string text,
+	const std::string& text,
 	DirectX::XMFLOAT4 color,
-	float duration = 0.0f)
+	float duration = 0.0f,
+	float scale = 1.0f)
 {
+	if (!DDD->font.IsLoaded())
+		return;
 
+	DDD->text.Add(&pos.x, DDD->font.Layout(text), &color.x, scale, duration);
 }
 
-#pragma endregion
\ No newline at end of file
+#pragma endregion
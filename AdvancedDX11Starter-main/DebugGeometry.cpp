@@ -0,0 +1,417 @@
+#include "DebugGeometry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdlib.h>
+#include <utility>
+
+static const float Pi = 3.14159265f;
+
+static void TransformPoint(const float m[4][4], float x, float y, float z, float out[3])
+{
+	for (int i = 0; i < 3; i++)
+		out[i] = x * m[0][i] + y * m[1][i] + z * m[2][i] + m[3][i];
+}
+
+void DebugLineBatch::AddLine(const float a[3], const float b[3], const float color[4])
+{
+	DebugVertex va = { { a[0], a[1], a[2] }, { color[0], color[1], color[2], color[3] } };
+	DebugVertex vb = { { b[0], b[1], b[2] }, { color[0], color[1], color[2], color[3] } };
+	vertices.push_back(va);
+	vertices.push_back(vb);
+}
+
+void DebugLineBatch::Append(const DebugLineBatch& other)
+{
+	vertices.insert(vertices.end(), other.vertices.begin(), other.vertices.end());
+}
+
+void DebugLineBatch::AddCross(const float center[3], float size, const float color[4])
+{
+	float half = size * 0.5f;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float a[3] = { center[0], center[1], center[2] };
+		float b[3] = { center[0], center[1], center[2] };
+		a[axis] -= half;
+		b[axis] += half;
+		AddLine(a, b, color);
+	}
+}
+
+void DebugLineBatch::AddCircle(
+	const float center[3],
+	const float normal[3],
+	float radius,
+	const float color[4],
+	unsigned int segments)
+{
+	if (segments < 3)
+		segments = 3;
+
+	float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+	if (length <= 0.0f)
+		return;
+	float n[3] = { normal[0] / length, normal[1] / length, normal[2] / length };
+
+	// Two axes across the circle, starting from
+	// whichever world axis is least like the normal
+	float seed[3] = { 0, 0, 0 };
+	float ax = std::fabs(n[0]), ay = std::fabs(n[1]), az = std::fabs(n[2]);
+	seed[ax <= ay && ax <= az ? 0 : (ay <= az ? 1 : 2)] = 1.0f;
+
+	float u[3] =
+	{
+		n[1] * seed[2] - n[2] * seed[1],
+		n[2] * seed[0] - n[0] * seed[2],
+		n[0] * seed[1] - n[1] * seed[0]
+	};
+	float uLength = std::sqrt(u[0] * u[0] + u[1] * u[1] + u[2] * u[2]);
+	for (int i = 0; i < 3; i++)
+		u[i] /= uLength;
+
+	float v[3] =
+	{
+		n[1] * u[2] - n[2] * u[1],
+		n[2] * u[0] - n[0] * u[2],
+		n[0] * u[1] - n[1] * u[0]
+	};
+
+	vertices.reserve(vertices.size() + segments * 2);
+
+	float previous[3];
+	for (int i = 0; i < 3; i++)
+		previous[i] = center[i] + u[i] * radius;
+
+	for (unsigned int s = 1; s <= segments; s++)
+	{
+		float angle = 2.0f * Pi * s / segments;
+		float c = std::cos(angle) * radius;
+		float sn = std::sin(angle) * radius;
+
+		float point[3];
+		for (int i = 0; i < 3; i++)
+			point[i] = center[i] + u[i] * c + v[i] * sn;
+
+		AddLine(previous, point, color);
+		for (int i = 0; i < 3; i++)
+			previous[i] = point[i];
+	}
+}
+
+void DebugLineBatch::AddSphere(
+	const float center[3],
+	float radius,
+	const float color[4],
+	unsigned int segments)
+{
+	const float axes[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+	for (int axis = 0; axis < 3; axis++)
+		AddCircle(center, axes[axis], radius, color, segments);
+}
+
+void DebugLineBatch::AddAxes(const float transform[4][4], float size)
+{
+	const float colors[3][4] = { { 1, 0, 0, 1 }, { 0, 1, 0, 1 }, { 0, 0, 1, 1 } };
+
+	float origin[3];
+	TransformPoint(transform, 0, 0, 0, origin);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float end[3];
+		TransformPoint(transform,
+			axis == 0 ? size : 0,
+			axis == 1 ? size : 0,
+			axis == 2 ? size : 0,
+			end);
+		AddLine(origin, end, colors[axis]);
+	}
+}
+
+void DebugLineBatch::AddTriangle(const float a[3], const float b[3], const float c[3], const float color[4])
+{
+	AddLine(a, b, color);
+	AddLine(b, c, color);
+	AddLine(c, a, color);
+}
+
+void DebugLineBatch::AddBox(const float corners[8][3], const float color[4])
+{
+	// Corners differing in exactly one bit share an edge
+	for (int i = 0; i < 8; i++)
+		for (int bit = 1; bit < 8; bit <<= 1)
+			if (!(i & bit))
+				AddLine(corners[i], corners[i | bit], color);
+}
+
+void DebugLineBatch::AddAABB(const float minCoords[3], const float maxCoords[3], const float color[4])
+{
+	float corners[8][3];
+	for (int i = 0; i < 8; i++)
+	{
+		corners[i][0] = (i & 1) ? maxCoords[0] : minCoords[0];
+		corners[i][1] = (i & 2) ? maxCoords[1] : minCoords[1];
+		corners[i][2] = (i & 4) ? maxCoords[2] : minCoords[2];
+	}
+	AddBox(corners, color);
+}
+
+void DebugLineBatch::AddOBB(const float transform[4][4], const float size[3], const float color[4])
+{
+	float corners[8][3];
+	for (int i = 0; i < 8; i++)
+	{
+		TransformPoint(transform,
+			(i & 1) ? size[0] * 0.5f : -size[0] * 0.5f,
+			(i & 2) ? size[1] * 0.5f : -size[1] * 0.5f,
+			(i & 4) ? size[2] * 0.5f : -size[2] * 0.5f,
+			corners[i]);
+	}
+	AddBox(corners, color);
+}
+
+void DebugLineBatch::AddFrustum(const float inverseViewProjection[4][4], const float color[4])
+{
+	// Corners of clip space, with Direct3D's 0 to 1 depth
+	float corners[8][3];
+	for (int i = 0; i < 8; i++)
+	{
+		float clip[4] =
+		{
+			(i & 1) ? 1.0f : -1.0f,
+			(i & 2) ? 1.0f : -1.0f,
+			(i & 4) ? 1.0f : 0.0f,
+			1.0f
+		};
+
+		float world[4];
+		for (int c = 0; c < 4; c++)
+		{
+			world[c] =
+				clip[0] * inverseViewProjection[0][c] +
+				clip[1] * inverseViewProjection[1][c] +
+				clip[2] * inverseViewProjection[2][c] +
+				clip[3] * inverseViewProjection[3][c];
+		}
+
+		for (int c = 0; c < 3; c++)
+			corners[i][c] = world[c] / world[3];
+	}
+	AddBox(corners, color);
+}
+
+DebugLineLifetimes::DebugLineLifetimes() :
+	time(0),
+	tick(0),
+	openBucket(0),
+	itemCount(0),
+	lineCount(0)
+{
+	for (auto& bucket : buckets)
+		bucket.latestTick = 0;
+	scratch.latestTick = 0;
+	openItem = {};
+}
+
+DebugLineBatch& DebugLineLifetimes::BeginItem(float duration)
+{
+	// Always lasts at least until the next tick
+	unsigned long long ticks = (unsigned long long)std::ceil(duration / DEBUG_LIFETIME_TICK);
+	if (ticks < 1)
+		ticks = 1;
+
+	openItem.expiryTick = tick + ticks;
+	openBucket = &buckets[openItem.expiryTick % DEBUG_LIFETIME_BUCKETS];
+	openItem.firstVertex = openBucket->lines.GetVertices().size();
+	return openBucket->lines;
+}
+
+void DebugLineLifetimes::EndItem()
+{
+	if (!openBucket)
+		return;
+
+	openItem.vertexCount = openBucket->lines.GetVertices().size() - openItem.firstVertex;
+	if (openItem.vertexCount > 0)
+	{
+		openBucket->items.push_back(openItem);
+		if (openItem.expiryTick > openBucket->latestTick)
+			openBucket->latestTick = openItem.expiryTick;
+
+		itemCount++;
+		lineCount += openItem.vertexCount / 2;
+	}
+	openBucket = 0;
+}
+
+void DebugLineLifetimes::Advance(float deltaTime)
+{
+	time += deltaTime;
+	unsigned long long newTick = (unsigned long long)(time / DEBUG_LIFETIME_TICK);
+	if (newTick <= tick)
+		return;
+
+	// A long frame may pass more ticks than there are
+	// buckets, but each bucket only needs one visit
+	unsigned long long steps = newTick - tick;
+	if (steps > DEBUG_LIFETIME_BUCKETS)
+		steps = DEBUG_LIFETIME_BUCKETS;
+
+	tick = newTick;
+	for (unsigned long long t = newTick - steps + 1; t <= newTick; t++)
+		ExpireBucket(buckets[t % DEBUG_LIFETIME_BUCKETS]);
+}
+
+void DebugLineLifetimes::ExpireBucket(Bucket& bucket)
+{
+	if (bucket.items.empty())
+		return;
+
+	// Usual case, everything in the bucket is due
+	if (bucket.latestTick <= tick)
+	{
+		itemCount -= bucket.items.size();
+		lineCount -= bucket.lines.GetLineCount();
+		bucket.lines.Clear();
+		bucket.items.clear();
+		bucket.latestTick = 0;
+		return;
+	}
+
+	// Items due on a later lap of the ring are copied back
+	// into the same bucket, at most once per lap each
+	std::swap(bucket.lines, scratch.lines);
+	std::swap(bucket.items, scratch.items);
+	bucket.latestTick = 0;
+
+	const std::vector<DebugVertex>& vertices = scratch.lines.GetVertices();
+	for (auto& item : scratch.items)
+	{
+		if (item.expiryTick <= tick)
+		{
+			itemCount--;
+			lineCount -= item.vertexCount / 2;
+			continue;
+		}
+
+		std::vector<DebugVertex>& target = bucket.lines.GetVertices();
+		Item kept = item;
+		kept.firstVertex = target.size();
+		target.insert(
+			target.end(),
+			vertices.begin() + item.firstVertex,
+			vertices.begin() + item.firstVertex + item.vertexCount);
+
+		bucket.items.push_back(kept);
+		if (kept.expiryTick > bucket.latestTick)
+			bucket.latestTick = kept.expiryTick;
+	}
+
+	scratch.lines.Clear();
+	scratch.items.clear();
+}
+
+void DebugLineLifetimes::AppendTo(DebugLineBatch& frame) const
+{
+	if (lineCount == 0)
+		return;
+
+	frame.Reserve(frame.GetLineCount() + lineCount);
+	for (auto& bucket : buckets)
+		frame.Append(bucket.lines);
+}
+
+void DebugLineLifetimes::Clear()
+{
+	for (auto& bucket : buckets)
+	{
+		bucket.lines.Clear();
+		bucket.items.clear();
+		bucket.latestTick = 0;
+	}
+	openBucket = 0;
+	itemCount = 0;
+	lineCount = 0;
+}
+
+DebugLineBenchmark BenchmarkDebugLines(unsigned int lineCount, unsigned int iterations)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	DebugLineBenchmark result = {};
+	result.lineCount = lineCount;
+	if (iterations == 0)
+		return result;
+
+	// Points are made up front so only appending is timed
+	std::vector<float> points(lineCount * 6);
+	for (auto& p : points)
+		p = (float)rand() / RAND_MAX * 100.0f - 50.0f;
+
+	const float color[4] = { 1, 1, 0, 1 };
+	const unsigned int sphereLines = 3 * DEBUG_CIRCLE_SEGMENTS;
+	unsigned int sphereCount = lineCount / sphereLines;
+
+	DebugLineBatch batch;
+	double linesSeconds = 0;
+	double spheresSeconds = 0;
+	for (unsigned int i = 0; i < iterations; i++)
+	{
+		batch.Clear();
+		auto start = Clock::now();
+		for (unsigned int l = 0; l < lineCount; l++)
+			batch.AddLine(&points[l * 6], &points[l * 6 + 3], color);
+		linesSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+		batch.Clear();
+		start = Clock::now();
+		for (unsigned int s = 0; s < sphereCount; s++)
+			batch.AddSphere(&points[s * 6], 1.0f, color);
+		spheresSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	result.linesMS = (float)(linesSeconds * 1000.0 / iterations);
+	result.spheresMS = (float)(spheresSeconds * 1000.0 / iterations);
+	return result;
+}
+
+DebugLifetimeBenchmark BenchmarkDebugLifetimes(unsigned int itemCount, float maxDuration)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	DebugLifetimeBenchmark result = {};
+	result.itemCount = itemCount;
+
+	std::vector<float> durations(itemCount);
+	for (auto& d : durations)
+		d = (float)rand() / RAND_MAX * maxDuration;
+
+	const float a[3] = { 0, 0, 0 };
+	const float b[3] = { 0, 1, 0 };
+	const float color[4] = { 1, 1, 0, 1 };
+
+	DebugLineLifetimes lifetimes;
+	auto start = Clock::now();
+	for (unsigned int i = 0; i < itemCount; i++)
+	{
+		lifetimes.BeginItem(durations[i]).AddLine(a, b, color);
+		lifetimes.EndItem();
+	}
+	result.addMS = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+
+	// Stops early if something never expires
+	unsigned int frameLimit = (unsigned int)(maxDuration * 60.0f) + 2 * DEBUG_LIFETIME_BUCKETS;
+	while (lifetimes.GetItemCount() > 0 && result.frames < frameLimit)
+	{
+		start = Clock::now();
+		lifetimes.Advance(1.0f / 60.0f);
+		float ms = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+
+		result.advanceMS += ms;
+		result.worstAdvanceMS = (std::max)(result.worstAdvanceMS, ms);
+		result.frames++;
+	}
+
+	return result;
+}
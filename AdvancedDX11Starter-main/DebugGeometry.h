@@ -0,0 +1,181 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Build debug shapes out of line segments, all of
+//			them appended to one vertex stream that is
+//			uploaded and drawn with a single call each frame.
+
+#include <vector>
+#include <stddef.h>
+
+// Segments used for a full circle when none are given
+#define DEBUG_CIRCLE_SEGMENTS 32
+
+// Timed debug items are filed into a ring of buckets by the
+// tick they expire on. Items further out than the ring go
+// around it again until their tick comes up
+#define DEBUG_LIFETIME_BUCKETS 128
+#define DEBUG_LIFETIME_TICK (1.0f / 60.0f)
+
+/// <summary>
+/// One end of a debug line. Must match the input of DebugLineVS
+/// </summary>
+struct DebugVertex
+{
+	float position[3];
+	float color[4];
+};
+
+/// <summary>
+/// Every debug line of a frame. Shapes are tessellated as
+/// they are added, so drawing never has to know what they were
+/// </summary>
+class DebugLineBatch
+{
+public:
+	void Clear() { vertices.clear(); }
+	void Reserve(size_t lineCount) { vertices.reserve(lineCount * 2); }
+
+	void AddLine(const float a[3], const float b[3], const float color[4]);
+
+	// Three axis aligned lines crossing at a point
+	void AddCross(const float center[3], float size, const float color[4]);
+
+	void AddCircle(
+		const float center[3],
+		const float normal[3],
+		float radius,
+		const float color[4],
+		unsigned int segments = DEBUG_CIRCLE_SEGMENTS);
+
+	// A circle around each axis
+	void AddSphere(
+		const float center[3],
+		float radius,
+		const float color[4],
+		unsigned int segments = DEBUG_CIRCLE_SEGMENTS);
+
+	// Red, green and blue lines along a transform's x, y and z
+	void AddAxes(const float transform[4][4], float size);
+
+	void AddTriangle(const float a[3], const float b[3], const float c[3], const float color[4]);
+	void AddAABB(const float minCoords[3], const float maxCoords[3], const float color[4]);
+
+	// A unit cube scaled by size, then moved by transform
+	void AddOBB(const float transform[4][4], const float size[3], const float color[4]);
+
+	// The volume a view projection matrix sees, from its inverse
+	void AddFrustum(const float inverseViewProjection[4][4], const float color[4]);
+
+	// Copies every line of another batch onto this one
+	void Append(const DebugLineBatch& other);
+
+	const std::vector<DebugVertex>& GetVertices() const { return vertices; }
+	std::vector<DebugVertex>& GetVertices() { return vertices; }
+	size_t GetLineCount() const { return vertices.size() / 2; }
+
+private:
+
+	// Twelve edges between eight corners ordered
+	// like the bits of x, y and z
+	void AddBox(const float corners[8][3], const float color[4]);
+
+	std::vector<DebugVertex> vertices;
+};
+
+/// <summary>
+/// Debug items that last longer than the frame they were added
+/// in. Nothing is ever erased one at a time: a bucket whose
+/// items have all expired is cleared wholesale, so expiring
+/// costs the same no matter how many items go at once
+/// </summary>
+class DebugLineLifetimes
+{
+public:
+	DebugLineLifetimes();
+
+	// Shapes added to the returned batch between these two
+	// calls make up one item that lasts duration seconds
+	DebugLineBatch& BeginItem(float duration);
+	void EndItem();
+
+	// Moves time forward, dropping every item that expired
+	void Advance(float deltaTime);
+
+	// Copies every live line onto the frame's batch
+	void AppendTo(DebugLineBatch& frame) const;
+
+	void Clear();
+	size_t GetItemCount() const { return itemCount; }
+	size_t GetLineCount() const { return lineCount; }
+
+private:
+	struct Item
+	{
+		size_t firstVertex;
+		size_t vertexCount;
+		unsigned long long expiryTick;
+	};
+
+	struct Bucket
+	{
+		DebugLineBatch lines;
+		std::vector<Item> items;
+
+		// Nothing in the bucket outlives this tick
+		unsigned long long latestTick;
+	};
+
+	void ExpireBucket(Bucket& bucket);
+
+	Bucket buckets[DEBUG_LIFETIME_BUCKETS];
+
+	// Where items that went around the ring are moved
+	// out to while their bucket is refilled
+	Bucket scratch;
+
+	double time;
+	unsigned long long tick;
+
+	// Item opened by BeginItem
+	Bucket* openBucket;
+	Item openItem;
+
+	size_t itemCount;
+	size_t lineCount;
+};
+
+/// <summary>
+/// Times of one headless benchmark run, per simulated frame
+/// </summary>
+struct DebugLineBenchmark
+{
+	unsigned int lineCount;
+	float linesMS;		// lineCount single lines
+	float spheresMS;	// Spheres adding up to lineCount lines
+};
+
+/// <summary>
+/// Fills a batch with lineCount lines, then with as many
+/// spheres as make up lineCount lines, clearing it between
+/// frames like the game does, and averages the time each took
+/// </summary>
+DebugLineBenchmark BenchmarkDebugLines(unsigned int lineCount, unsigned int iterations);
+
+/// <summary>
+/// Times of one headless timed item benchmark run
+/// </summary>
+struct DebugLifetimeBenchmark
+{
+	unsigned int itemCount;
+	unsigned int frames;	// Frames until every item expired
+	float addMS;			// Adding every item
+	float advanceMS;		// Every Advance call added together
+	float worstAdvanceMS;	// Slowest single Advance
+};
+
+/// <summary>
+/// Adds itemCount single line items lasting up to maxDuration
+/// seconds, then steps 60hz frames until all have expired
+/// </summary>
+DebugLifetimeBenchmark BenchmarkDebugLifetimes(unsigned int itemCount, float maxDuration);
@@ -0,0 +1,28 @@
+
+// Debug lines are already in world space
+cbuffer externalData : register(b0)
+{
+	matrix view;
+	matrix projection;
+};
+
+// Must match DebugVertex in DebugGeometry.h
+struct VertexShaderInput
+{
+	float3 position		: POSITION;
+	float4 color		: COLOR;
+};
+
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float4 color		: COLOR;
+};
+
+VertexToPixel main(VertexShaderInput input)
+{
+	VertexToPixel output;
+	output.position = mul(mul(projection, view), float4(input.position, 1.0f));
+	output.color = input.color;
+	return output;
+}
@@ -0,0 +1,359 @@
+#include "DebugText.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Everything in a .spritefont is little endian
+static bool ReadBytes(const unsigned char* data, size_t size, size_t& offset, void* out, size_t count)
+{
+	if (offset + count > size)
+		return false;
+
+	memcpy(out, data + offset, count);
+	offset += count;
+	return true;
+}
+
+DebugFont::DebugFont() :
+	lineSpacing(0),
+	defaultCharacter(0),
+	atlasWidth(0),
+	atlasHeight(0),
+	atlasFormat(0),
+	atlasPitch(0),
+	cacheHits(0),
+	cacheMisses(0)
+{
+	for (int i = 0; i < 128; i++)
+		asciiGlyphs[i] = -1;
+}
+
+bool DebugFont::Parse(const unsigned char* data, size_t size)
+{
+	glyphs.clear();
+	cache.clear();
+	for (int i = 0; i < 128; i++)
+		asciiGlyphs[i] = -1;
+
+	size_t offset = 0;
+	char magic[8];
+	if (!ReadBytes(data, size, offset, magic, sizeof(magic)) ||
+		memcmp(magic, "DXTKfont", sizeof(magic)) != 0)
+		return false;
+
+	// Glyphs are stored sorted by character
+	unsigned int glyphCount = 0;
+	if (!ReadBytes(data, size, offset, &glyphCount, sizeof(glyphCount)) ||
+		glyphCount == 0 ||
+		glyphCount > (size - offset) / sizeof(DebugGlyph))
+		return false;
+
+	glyphs.resize(glyphCount);
+	ReadBytes(data, size, offset, glyphs.data(), glyphCount * sizeof(DebugGlyph));
+
+	if (!ReadBytes(data, size, offset, &lineSpacing, sizeof(lineSpacing)) ||
+		!ReadBytes(data, size, offset, &defaultCharacter, sizeof(defaultCharacter)))
+	{
+		glyphs.clear();
+		return false;
+	}
+
+	// Atlas, one row of pixels or compressed blocks at a time
+	unsigned int rows = 0;
+	if (!ReadBytes(data, size, offset, &atlasWidth, sizeof(atlasWidth)) ||
+		!ReadBytes(data, size, offset, &atlasHeight, sizeof(atlasHeight)) ||
+		!ReadBytes(data, size, offset, &atlasFormat, sizeof(atlasFormat)) ||
+		!ReadBytes(data, size, offset, &atlasPitch, sizeof(atlasPitch)) ||
+		!ReadBytes(data, size, offset, &rows, sizeof(rows)) ||
+		(size_t)atlasPitch * rows > size - offset)
+	{
+		glyphs.clear();
+		return false;
+	}
+
+	atlasData.assign(data + offset, data + offset + (size_t)atlasPitch * rows);
+
+	for (size_t i = 0; i < glyphs.size(); i++)
+	{
+		if (glyphs[i].character < 128)
+			asciiGlyphs[glyphs[i].character] = (int)i;
+	}
+
+	return true;
+}
+
+const DebugGlyph* DebugFont::FindGlyph(unsigned int character) const
+{
+	if (character < 128)
+	{
+		int index = asciiGlyphs[character];
+		if (index >= 0)
+			return &glyphs[index];
+	}
+	else
+	{
+		auto it = std::lower_bound(glyphs.begin(), glyphs.end(), character,
+			[](const DebugGlyph& g, unsigned int c) { return g.character < c; });
+		if (it != glyphs.end() && it->character == character)
+			return &(*it);
+	}
+
+	if (defaultCharacter != 0 && defaultCharacter != character)
+		return FindGlyph(defaultCharacter);
+	return 0;
+}
+
+std::shared_ptr<const DebugTextLayout> DebugFont::Layout(const std::string& text)
+{
+	auto it = cache.find(text);
+	if (it != cache.end())
+	{
+		cacheHits++;
+		return it->second;
+	}
+
+	// Starting over keeps the cache from growing forever with
+	// strings that change every frame. Anything still in use
+	// stays alive through its own reference
+	if (cache.size() >= DEBUG_TEXT_CACHE_MAX)
+		cache.clear();
+
+	cacheMisses++;
+	std::shared_ptr<const DebugTextLayout> layout =
+		std::make_shared<DebugTextLayout>(BuildLayout(text));
+	cache[text] = layout;
+	return layout;
+}
+
+DebugTextLayout DebugFont::BuildLayout(const std::string& text) const
+{
+	DebugTextLayout layout = {};
+	if (glyphs.empty())
+		return layout;
+
+	// Same placement rules as DirectXTK's SpriteFont
+	float x = 0;
+	float y = 0;
+	float invWidth = 1.0f / atlasWidth;
+	float invHeight = 1.0f / atlasHeight;
+	layout.quads.reserve(text.size());
+	for (unsigned char c : text)
+	{
+		if (c == '\r')
+			continue;
+
+		if (c == '\n')
+		{
+			x = 0;
+			y += lineSpacing;
+			continue;
+		}
+
+		const DebugGlyph* glyph = FindGlyph(c);
+		if (!glyph)
+			continue;
+
+		x = (std::max)(x + glyph->xOffset, 0.0f);
+		float width = (float)(glyph->right - glyph->left);
+		float height = (float)(glyph->bottom - glyph->top);
+
+		if (c != ' ' && c != '\t')
+		{
+			DebugTextQuad quad =
+			{
+				{ x, y + glyph->yOffset, x + width, y + glyph->yOffset + height },
+				{
+					glyph->left * invWidth,
+					glyph->top * invHeight,
+					glyph->right * invWidth,
+					glyph->bottom * invHeight
+				}
+			};
+			layout.quads.push_back(quad);
+		}
+
+		// Glyphs can reach past their own advance
+		layout.width = (std::max)(layout.width, x + width);
+		x += width + glyph->xAdvance;
+		layout.width = (std::max)(layout.width, x);
+	}
+
+	layout.height = y + lineSpacing;
+	return layout;
+}
+
+void DebugTextBatch::Add(
+	const float position[3],
+	std::shared_ptr<const DebugTextLayout> layout,
+	const float color[4],
+	float scale,
+	float duration)
+{
+	if (!layout || layout->quads.empty())
+		return;
+
+	Label label;
+	memcpy(label.position, position, sizeof(label.position));
+	memcpy(label.color, color, sizeof(label.color));
+	label.scale = scale;
+	label.timeLeft = duration;
+	label.layout = std::move(layout);
+
+	if (duration > 0.0f)
+		timedLabels.push_back(std::move(label));
+	else
+		frameLabels.push_back(std::move(label));
+}
+
+void DebugTextBatch::Advance(float deltaTime)
+{
+	// Labels are all the same size, so an expired one is
+	// replaced by the last instead of closing the gap
+	for (size_t i = 0; i < timedLabels.size();)
+	{
+		timedLabels[i].timeLeft -= deltaTime;
+		if (timedLabels[i].timeLeft > 0.0f)
+		{
+			i++;
+			continue;
+		}
+
+		if (i != timedLabels.size() - 1)
+			timedLabels[i] = std::move(timedLabels.back());
+		timedLabels.pop_back();
+	}
+}
+
+void DebugTextBatch::Build(
+	const float viewProjection[4][4],
+	float screenWidth,
+	float screenHeight,
+	std::vector<DebugGlyphInstance>& out)
+{
+	for (auto& label : frameLabels)
+		BuildLabel(label, viewProjection, screenWidth, screenHeight, out);
+	for (auto& label : timedLabels)
+		BuildLabel(label, viewProjection, screenWidth, screenHeight, out);
+
+	frameLabels.clear();
+}
+
+void DebugTextBatch::BuildLabel(
+	const Label& label,
+	const float viewProjection[4][4],
+	float screenWidth,
+	float screenHeight,
+	std::vector<DebugGlyphInstance>& out)
+{
+	const float* p = label.position;
+	float clip[4];
+	for (int c = 0; c < 4; c++)
+	{
+		clip[c] =
+			p[0] * viewProjection[0][c] +
+			p[1] * viewProjection[1][c] +
+			p[2] * viewProjection[2][c] +
+			viewProjection[3][c];
+	}
+
+	// Behind the camera or past the far plane
+	if (clip[3] <= 0.0001f || clip[2] < 0.0f || clip[2] > clip[3])
+		return;
+
+	float anchorX = (clip[0] / clip[3] * 0.5f + 0.5f) * screenWidth;
+	float anchorY = (0.5f - clip[1] / clip[3] * 0.5f) * screenHeight;
+
+	// Centered over the point, sitting on it
+	const DebugTextLayout& layout = *label.layout;
+	float left = anchorX - layout.width * 0.5f * label.scale;
+	float top = anchorY - layout.height * label.scale;
+	if (left > screenWidth || top > screenHeight ||
+		left + layout.width * label.scale < 0.0f || anchorY < 0.0f)
+		return;
+
+	size_t first = out.size();
+	out.resize(first + layout.quads.size());
+	DebugGlyphInstance* glyph = &out[first];
+	for (auto& quad : layout.quads)
+	{
+		glyph->rect[0] = left + quad.rect[0] * label.scale;
+		glyph->rect[1] = top + quad.rect[1] * label.scale;
+		glyph->rect[2] = left + quad.rect[2] * label.scale;
+		glyph->rect[3] = top + quad.rect[3] * label.scale;
+		memcpy(glyph->uv, quad.uv, sizeof(glyph->uv));
+		memcpy(glyph->color, label.color, sizeof(glyph->color));
+		glyph++;
+	}
+}
+
+void DebugTextBatch::Clear()
+{
+	frameLabels.clear();
+	timedLabels.clear();
+}
+
+DebugTextBenchmark BenchmarkDebugText(DebugFont& font, unsigned int labelCount, unsigned int iterations)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	DebugTextBenchmark result = {};
+	result.labelCount = labelCount;
+	if (iterations == 0 || !font.IsLoaded())
+		return result;
+
+	// 64 different names repeated over every label
+	std::vector<std::string> names(64);
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "Entity %u", (unsigned int)i * 37);
+		names[i] = name;
+	}
+
+	std::vector<float> points(labelCount * 3);
+	for (unsigned int i = 0; i < labelCount; i++)
+	{
+		points[i * 3 + 0] = (float)rand() / RAND_MAX * 40.0f - 20.0f;
+		points[i * 3 + 1] = (float)rand() / RAND_MAX * 20.0f - 10.0f;
+		points[i * 3 + 2] = (float)rand() / RAND_MAX * 50.0f + 5.0f;
+	}
+
+	// A 60 degree perspective at the origin looking down +z
+	const float nearClip = 0.1f;
+	const float farClip = 100.0f;
+	const float yScale = 1.7320508f;
+	const float range = farClip / (farClip - nearClip);
+	const float viewProjection[4][4] =
+	{
+		{ yScale * 720.0f / 1280.0f, 0, 0, 0 },
+		{ 0, yScale, 0, 0 },
+		{ 0, 0, range, 1 },
+		{ 0, 0, -nearClip * range, 0 }
+	};
+
+	const float color[4] = { 1, 1, 1, 1 };
+	DebugTextBatch batch;
+	std::vector<DebugGlyphInstance> glyphs;
+	double addSeconds = 0;
+	double buildSeconds = 0;
+	for (unsigned int i = 0; i < iterations; i++)
+	{
+		auto start = Clock::now();
+		for (unsigned int l = 0; l < labelCount; l++)
+			batch.Add(&points[l * 3], font.Layout(names[l % names.size()]), color, 1.0f, 0.0f);
+		addSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+		glyphs.clear();
+		start = Clock::now();
+		batch.Build(viewProjection, 1280.0f, 720.0f, glyphs);
+		buildSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	result.glyphCount = (unsigned int)glyphs.size();
+	result.addMS = (float)(addSeconds * 1000.0 / iterations);
+	result.buildMS = (float)(buildSeconds * 1000.0 / iterations);
+	return result;
+}
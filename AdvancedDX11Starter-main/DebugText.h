@@ -0,0 +1,181 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: World space debug labels. The glyph atlas comes
+//			from a DirectXTK .spritefont, strings are laid out
+//			once and cached, and every label of a frame is
+//			projected into one stream of glyph quads.
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <stddef.h>
+
+// Laid out strings kept before the cache starts over
+#define DEBUG_TEXT_CACHE_MAX 4096
+
+/// <summary>
+/// One glyph of the atlas, as stored in a .spritefont
+/// </summary>
+struct DebugGlyph
+{
+	unsigned int character;
+	int left;
+	int top;
+	int right;
+	int bottom;
+	float xOffset;
+	float yOffset;
+	float xAdvance;
+};
+
+/// <summary>
+/// A glyph placed within a string. Rect is in pixels from the
+/// string's top left, uv is the atlas rect, both min then max
+/// </summary>
+struct DebugTextQuad
+{
+	float rect[4];
+	float uv[4];
+};
+
+/// <summary>
+/// A whole string laid out, ready to be placed anywhere
+/// </summary>
+struct DebugTextLayout
+{
+	std::vector<DebugTextQuad> quads;
+	float width;
+	float height;
+};
+
+/// <summary>
+/// One glyph on screen. Must match the per instance
+/// input of DebugTextVS
+/// </summary>
+struct DebugGlyphInstance
+{
+	float rect[4];	// Pixels, min then max
+	float uv[4];
+	float color[4];
+};
+
+/// <summary>
+/// Glyph atlas and metrics of a .spritefont, plus the cache
+/// of strings laid out with it
+/// </summary>
+class DebugFont
+{
+public:
+	DebugFont();
+
+	// Reads a DirectXTK .spritefont already in memory
+	bool Parse(const unsigned char* data, size_t size);
+	bool IsLoaded() const { return !glyphs.empty(); }
+
+	// Laid out the first time a string is seen, then shared
+	std::shared_ptr<const DebugTextLayout> Layout(const std::string& text);
+	const DebugGlyph* FindGlyph(unsigned int character) const;
+
+	// The atlas exactly as the file has it, in block
+	// rows when the format is compressed
+	unsigned int GetAtlasWidth() const { return atlasWidth; }
+	unsigned int GetAtlasHeight() const { return atlasHeight; }
+	unsigned int GetAtlasFormat() const { return atlasFormat; }
+	unsigned int GetAtlasPitch() const { return atlasPitch; }
+	const std::vector<unsigned char>& GetAtlasData() const { return atlasData; }
+
+	float GetLineSpacing() const { return lineSpacing; }
+	size_t GetCachedLayoutCount() const { return cache.size(); }
+	unsigned long long GetCacheHits() const { return cacheHits; }
+	unsigned long long GetCacheMisses() const { return cacheMisses; }
+
+private:
+	DebugTextLayout BuildLayout(const std::string& text) const;
+
+	// Sorted by character, with the ASCII ones indexed directly
+	std::vector<DebugGlyph> glyphs;
+	int asciiGlyphs[128];
+
+	float lineSpacing;
+	unsigned int defaultCharacter;
+
+	unsigned int atlasWidth;
+	unsigned int atlasHeight;
+	unsigned int atlasFormat;
+	unsigned int atlasPitch;
+	std::vector<unsigned char> atlasData;
+
+	std::unordered_map<std::string, std::shared_ptr<const DebugTextLayout>> cache;
+	unsigned long long cacheHits;
+	unsigned long long cacheMisses;
+};
+
+/// <summary>
+/// Every label waiting to be drawn. Labels with a duration
+/// are kept across frames and swapped out when they expire
+/// </summary>
+class DebugTextBatch
+{
+public:
+	void Add(
+		const float position[3],
+		std::shared_ptr<const DebugTextLayout> layout,
+		const float color[4],
+		float scale,
+		float duration);
+
+	void Advance(float deltaTime);
+
+	// Projects every label with a row vector view projection
+	// and appends its glyphs, centered above its position.
+	// Labels behind the camera or off screen are skipped.
+	// Labels without a duration are removed afterwards
+	void Build(
+		const float viewProjection[4][4],
+		float screenWidth,
+		float screenHeight,
+		std::vector<DebugGlyphInstance>& out);
+
+	void Clear();
+	size_t GetLabelCount() const { return frameLabels.size() + timedLabels.size(); }
+	size_t GetTimedLabelCount() const { return timedLabels.size(); }
+
+private:
+	struct Label
+	{
+		float position[3];
+		float color[4];
+		float scale;
+		float timeLeft;
+		std::shared_ptr<const DebugTextLayout> layout;
+	};
+
+	void BuildLabel(
+		const Label& label,
+		const float viewProjection[4][4],
+		float screenWidth,
+		float screenHeight,
+		std::vector<DebugGlyphInstance>& out);
+
+	std::vector<Label> frameLabels;
+	std::vector<Label> timedLabels;
+};
+
+/// <summary>
+/// Times of one headless text benchmark run, per frame
+/// </summary>
+struct DebugTextBenchmark
+{
+	unsigned int labelCount;
+	unsigned int glyphCount;	// Glyphs that ended up on screen
+	float addMS;				// Looking up every label's layout
+	float buildMS;				// Projecting and emitting glyphs
+};
+
+/// <summary>
+/// Labels labelCount points in front of a camera with strings
+/// drawn from a small set, like entity names would be
+/// </summary>
+DebugTextBenchmark BenchmarkDebugText(DebugFont& font, unsigned int labelCount, unsigned int iterations);
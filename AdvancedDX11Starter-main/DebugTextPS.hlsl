@@ -0,0 +1,17 @@
+
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float2 uv			: TEXCOORD;
+	float4 color		: COLOR;
+};
+
+// Glyphs are white with premultiplied alpha
+Texture2D Atlas : register(t0);
+SamplerState AtlasSampler : register(s0);
+
+float4 main(VertexToPixel input) : SV_TARGET
+{
+	float4 color = float4(input.color.rgb * input.color.a, input.color.a);
+	return Atlas.Sample(AtlasSampler, input.uv).a * color;
+}
@@ -0,0 +1,38 @@
+
+// Glyphs arrive already projected, in pixels
+cbuffer externalData : register(b0)
+{
+	float2 screenSize;
+};
+
+// Corner comes from a four vertex strip, everything else
+// from DebugGlyphInstance in DebugText.h
+struct VertexShaderInput
+{
+	float2 corner		: POSITION;
+	float4 rect			: RECT_PER_INSTANCE;
+	float4 uvRect		: UV_PER_INSTANCE;
+	float4 color		: COLOR_PER_INSTANCE;
+};
+
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float2 uv			: TEXCOORD;
+	float4 color		: COLOR;
+};
+
+VertexToPixel main(VertexShaderInput input)
+{
+	float2 pixel = lerp(input.rect.xy, input.rect.zw, input.corner);
+
+	VertexToPixel output;
+	output.position = float4(
+		pixel.x / screenSize.x * 2.0f - 1.0f,
+		1.0f - pixel.y / screenSize.y * 2.0f,
+		0.0f,
+		1.0f);
+	output.uv = lerp(input.uvRect.xy, input.uvRect.zw, input.corner);
+	output.color = input.color;
+	return output;
+}
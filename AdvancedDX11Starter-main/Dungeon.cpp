@@ -0,0 +1,516 @@
+#include "Dungeon.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string.h>
+
+DungeonSettings DefaultDungeonSettings()
+{
+	DungeonSettings settings;
+	settings.seed = 1;
+	settings.width = 40;
+	settings.depth = 40;
+	settings.origin[0] = 0.0f;
+	settings.origin[1] = 0.0f;
+	settings.origin[2] = 0.0f;
+	settings.tileSize = 2.0f;
+	settings.wallHeight = 3.0f;
+	settings.minLeafTiles = 8;
+	settings.minRoomTiles = 3;
+	settings.maxRoomTiles = 10;
+	settings.corridorTiles = 1;
+	settings.chunkTiles = 16;
+	return settings;
+}
+
+// --------------------------------------------------------
+// Layout
+// --------------------------------------------------------
+
+namespace
+{
+	// SplitMix64. The standard library's distributions differ
+	// between compilers, so the same seed would lay out a
+	// different dungeon on Windows and on Linux
+	struct Random
+	{
+		uint64_t state;
+
+		uint64_t Next()
+		{
+			uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+			return z ^ (z >> 31);
+		}
+
+		// Between low and high, both included
+		unsigned int Range(unsigned int low, unsigned int high)
+		{
+			if (high <= low)
+				return low;
+			return low + (unsigned int)(Next() % (high - low + 1));
+		}
+
+		bool Coin() { return (Next() & 1) != 0; }
+	};
+
+	// A rectangle of the map, split in two or given a room
+	struct Partition
+	{
+		unsigned int x;
+		unsigned int z;
+		unsigned int width;
+		unsigned int depth;
+		unsigned int children[2];	// Zero for leaves, as the root is no one's child
+		unsigned int room;			// Its own for leaves, one of its leaves' otherwise
+	};
+}
+
+Dungeon::Dungeon() :
+	settings(DefaultDungeonSettings()),
+	chunksX(0),
+	floorTileCount(0),
+	layoutMS(0.0f)
+{
+}
+
+void Dungeon::Generate(const DungeonSettings& newSettings)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	settings = newSettings;
+	settings.chunkTiles = (std::max)(1u, settings.chunkTiles);
+	settings.corridorTiles = (std::max)(1u, settings.corridorTiles);
+	settings.minRoomTiles = (std::max)(1u, settings.minRoomTiles);
+	settings.minLeafTiles = (std::max)(settings.minLeafTiles, settings.minRoomTiles + 2);
+
+	tiles.assign((size_t)settings.width * settings.depth, DUNGEON_SOLID);
+	rooms.clear();
+
+	Random random = { settings.seed };
+
+	// Split breadth first, the longer side of a partition
+	// across, until both sides are too short to halve. Every
+	// child comes after its parent
+	std::vector<Partition> partitions;
+	Partition root = { 0, 0, settings.width, settings.depth, { 0, 0 }, 0 };
+	partitions.push_back(root);
+	for (size_t p = 0; p < partitions.size(); p++)
+	{
+		Partition node = partitions[p];
+		bool splitX = node.width >= settings.minLeafTiles * 2;
+		bool splitZ = node.depth >= settings.minLeafTiles * 2;
+		if (!splitX && !splitZ)
+			continue;
+
+		bool acrossX = splitX;
+		if (splitX && splitZ)
+		{
+			if (node.width * 4 > node.depth * 5)
+				acrossX = true;
+			else if (node.depth * 4 > node.width * 5)
+				acrossX = false;
+			else
+				acrossX = random.Coin();
+		}
+
+		Partition a = node;
+		Partition b = node;
+		a.children[0] = a.children[1] = b.children[0] = b.children[1] = 0;
+		if (acrossX)
+		{
+			unsigned int cut = random.Range(settings.minLeafTiles, node.width - settings.minLeafTiles);
+			a.width = cut;
+			b.x += cut;
+			b.width -= cut;
+		}
+		else
+		{
+			unsigned int cut = random.Range(settings.minLeafTiles, node.depth - settings.minLeafTiles);
+			a.depth = cut;
+			b.z += cut;
+			b.depth -= cut;
+		}
+
+		partitions[p].children[0] = (unsigned int)partitions.size();
+		partitions.push_back(a);
+		partitions[p].children[1] = (unsigned int)partitions.size();
+		partitions.push_back(b);
+	}
+
+	// A room in every leaf, a tile clear of its edges so rooms
+	// in neighboring leaves never touch
+	for (Partition& leaf : partitions)
+	{
+		if (leaf.children[0] != 0 || leaf.width < 3 || leaf.depth < 3)
+			continue;
+
+		DungeonRoom room;
+		room.width = random.Range(
+			(std::min)(settings.minRoomTiles, leaf.width - 2),
+			(std::min)(settings.maxRoomTiles, leaf.width - 2));
+		room.depth = random.Range(
+			(std::min)(settings.minRoomTiles, leaf.depth - 2),
+			(std::min)(settings.maxRoomTiles, leaf.depth - 2));
+		room.x = leaf.x + random.Range(1, leaf.width - room.width - 1);
+		room.z = leaf.z + random.Range(1, leaf.depth - room.depth - 1);
+
+		leaf.room = (unsigned int)rooms.size();
+		rooms.push_back(room);
+		Carve(room.x, room.z, room.width, room.depth, DUNGEON_ROOM);
+	}
+
+	// Children before parents, joining a room from each half
+	// of every split with a corridor bent once
+	for (size_t p = partitions.size(); p-- > 0;)
+	{
+		Partition& node = partitions[p];
+		if (node.children[0] == 0)
+			continue;
+
+		const DungeonRoom& a = rooms[partitions[node.children[0]].room];
+		const DungeonRoom& b = rooms[partitions[node.children[1]].room];
+		node.room = partitions[node.children[random.Coin() ? 1 : 0]].room;
+
+		unsigned int ax = a.x + a.width / 2;
+		unsigned int az = a.z + a.depth / 2;
+		unsigned int bx = b.x + b.width / 2;
+		unsigned int bz = b.z + b.depth / 2;
+		unsigned int lowX = (std::min)(ax, bx);
+		unsigned int lowZ = (std::min)(az, bz);
+		unsigned int spanX = (std::max)(ax, bx) - lowX + settings.corridorTiles;
+		unsigned int spanZ = (std::max)(az, bz) - lowZ + settings.corridorTiles;
+		if (random.Coin())
+		{
+			Carve(lowX, az, spanX, settings.corridorTiles, DUNGEON_CORRIDOR);
+			Carve(bx, lowZ, settings.corridorTiles, spanZ, DUNGEON_CORRIDOR);
+		}
+		else
+		{
+			Carve(ax, lowZ, settings.corridorTiles, spanZ, DUNGEON_CORRIDOR);
+			Carve(lowX, bz, spanX, settings.corridorTiles, DUNGEON_CORRIDOR);
+		}
+	}
+
+	floorTileCount = 0;
+	for (unsigned char tile : tiles)
+		floorTileCount += tile != DUNGEON_SOLID ? 1 : 0;
+
+	// Chunks are sized now so they can be built in parallel
+	// without anything growing underneath them
+	chunksX = (settings.width + settings.chunkTiles - 1) / settings.chunkTiles;
+	unsigned int chunksZ = (settings.depth + settings.chunkTiles - 1) / settings.chunkTiles;
+	chunks.clear();
+	chunks.resize((size_t)chunksX * chunksZ);
+	for (unsigned int c = 0; c < chunks.size(); c++)
+	{
+		chunks[c].x = (c % chunksX) * settings.chunkTiles;
+		chunks[c].z = (c / chunksX) * settings.chunkTiles;
+	}
+
+	layoutMS = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+}
+
+void Dungeon::Carve(unsigned int x, unsigned int z, unsigned int width, unsigned int depth, unsigned char tile)
+{
+	unsigned int endX = (std::min)(x + width, settings.width);
+	unsigned int endZ = (std::min)(z + depth, settings.depth);
+	for (unsigned int tz = z; tz < endZ; tz++)
+	{
+		for (unsigned int tx = x; tx < endX; tx++)
+		{
+			// Corridors run through rooms without claiming them
+			unsigned char& t = tiles[tx + (size_t)tz * settings.width];
+			if (t == DUNGEON_SOLID || tile == DUNGEON_ROOM)
+				t = tile;
+		}
+	}
+}
+
+unsigned char Dungeon::GetTile(int x, int z) const
+{
+	if (x < 0 || z < 0 || x >= (int)settings.width || z >= (int)settings.depth)
+		return DUNGEON_SOLID;
+	return tiles[x + (size_t)z * settings.width];
+}
+
+void Dungeon::GetTileCenter(unsigned int x, unsigned int z, float position[3]) const
+{
+	position[0] = settings.origin[0] + (x + 0.5f) * settings.tileSize;
+	position[1] = settings.origin[1];
+	position[2] = settings.origin[2] + (z + 0.5f) * settings.tileSize;
+}
+
+unsigned int Dungeon::GetTriangleCount() const
+{
+	size_t indices = 0;
+	for (const DungeonChunk& chunk : chunks)
+		indices += chunk.indices.size();
+	return (unsigned int)(indices / 3);
+}
+
+// --------------------------------------------------------
+// Chunks. Floors and ceilings are the floor tiles merged
+// into rectangles, walls are runs of floor tiles with solid
+// on the same side. Textures repeat once a tile
+// --------------------------------------------------------
+
+namespace
+{
+	// Adds the quad from corner along edges u and v, facing
+	// u cross v, to the chunk's mesh and collision
+	void AddQuad(
+		DungeonChunk& chunk,
+		const float corner[3], const float u[3], const float v[3],
+		const float uv[2], const float uvAlongU[2], const float uvAlongV[2])
+	{
+		float normal[3] = {
+			u[1] * v[2] - u[2] * v[1],
+			u[2] * v[0] - u[0] * v[2],
+			u[0] * v[1] - u[1] * v[0] };
+		float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		for (int i = 0; i < 3; i++)
+			normal[i] /= length;
+
+		// Corner, along u, along both, along v
+		const float steps[4][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+		unsigned int first = (unsigned int)chunk.vertices.size();
+		for (int c = 0; c < 4; c++)
+		{
+			DungeonVertex vertex;
+			for (int i = 0; i < 3; i++)
+			{
+				vertex.position[i] = corner[i] + u[i] * steps[c][0] + v[i] * steps[c][1];
+				vertex.normal[i] = normal[i];
+			}
+			for (int i = 0; i < 2; i++)
+				vertex.uv[i] = uv[i] + uvAlongU[i] * steps[c][0] + uvAlongV[i] * steps[c][1];
+			chunk.vertices.push_back(vertex);
+		}
+
+		const unsigned int corners[6] = { 0, 1, 2, 0, 2, 3 };
+		for (unsigned int c : corners)
+		{
+			chunk.indices.push_back(first + c);
+			const float* position = chunk.vertices[first + c].position;
+			chunk.collision.insert(chunk.collision.end(), position, position + 3);
+		}
+	}
+}
+
+void Dungeon::BuildChunk(unsigned int index)
+{
+	DungeonChunk& chunk = chunks[index];
+	chunk.vertices.clear();
+	chunk.indices.clear();
+	chunk.collision.clear();
+
+	const float ts = settings.tileSize;
+	const float height = settings.wallHeight;
+	const float* origin = settings.origin;
+	unsigned int side = settings.chunkTiles;
+	unsigned int endX = (std::min)(chunk.x + side, settings.width);
+	unsigned int endZ = (std::min)(chunk.z + side, settings.depth);
+
+	// Floor tiles taken by a rectangle already, chunk local
+	std::vector<unsigned char> covered((size_t)side * side, 0);
+	auto open = [&](unsigned int x, unsigned int z)
+	{
+		return IsFloor(x, z) && !covered[(x - chunk.x) + (z - chunk.z) * side];
+	};
+
+	for (unsigned int z = chunk.z; z < endZ; z++)
+	{
+		for (unsigned int x = chunk.x; x < endX; x++)
+		{
+			if (!open(x, z))
+				continue;
+
+			// As wide as the row goes, then as deep as every
+			// row below is free that wide
+			unsigned int rx = x + 1;
+			while (rx < endX && open(rx, z))
+				rx++;
+			unsigned int rz = z + 1;
+			for (; rz < endZ; rz++)
+			{
+				unsigned int t = x;
+				while (t < rx && open(t, rz))
+					t++;
+				if (t < rx)
+					break;
+			}
+			for (unsigned int cz = z; cz < rz; cz++)
+				for (unsigned int cx = x; cx < rx; cx++)
+					covered[(cx - chunk.x) + (cz - chunk.z) * side] = 1;
+
+			float dx = (rx - x) * ts;
+			float dz = (rz - z) * ts;
+			float floorCorner[3] = { origin[0] + x * ts, origin[1], origin[2] + z * ts };
+			float ceilingCorner[3] = { floorCorner[0], origin[1] + height, floorCorner[2] };
+			float alongX[3] = { dx, 0, 0 };
+			float alongZ[3] = { 0, 0, dz };
+			float uv[2] = { (float)x, (float)z };
+			float uvX[2] = { (float)(rx - x), 0 };
+			float uvZ[2] = { 0, (float)(rz - z) };
+			AddQuad(chunk, floorCorner, alongZ, alongX, uv, uvZ, uvX);
+			AddQuad(chunk, ceilingCorner, alongX, alongZ, uv, uvX, uvZ);
+		}
+	}
+
+	// Walls along Z, facing +X where solid is to the west and
+	// -X where it is to the east
+	float up[3] = { 0, height, 0 };
+	float uvUp[2] = { 0, -height / ts };
+	for (int facing = 1; facing >= -1; facing -= 2)
+	{
+		for (unsigned int x = chunk.x; x < endX; x++)
+		{
+			for (unsigned int z = chunk.z; z < endZ;)
+			{
+				if (!IsFloor(x, z) || IsFloor((int)x - facing, z))
+				{
+					z++;
+					continue;
+				}
+				unsigned int end = z + 1;
+				while (end < endZ && IsFloor(x, end) && !IsFloor((int)x - facing, end))
+					end++;
+
+				float wallX = origin[0] + (facing > 0 ? x : x + 1) * ts;
+				float corner[3] = { wallX, origin[1], origin[2] + z * ts };
+				float along[3] = { 0, 0, (end - z) * ts };
+				float uv[2] = { (float)z, height / ts };
+				float uvAlong[2] = { (float)(end - z), 0 };
+				if (facing > 0)
+					AddQuad(chunk, corner, up, along, uv, uvUp, uvAlong);
+				else
+					AddQuad(chunk, corner, along, up, uv, uvAlong, uvUp);
+				z = end;
+			}
+		}
+	}
+
+	// Walls along X, facing +Z where solid is to the south
+	// and -Z where it is to the north
+	for (int facing = 1; facing >= -1; facing -= 2)
+	{
+		for (unsigned int z = chunk.z; z < endZ; z++)
+		{
+			for (unsigned int x = chunk.x; x < endX;)
+			{
+				if (!IsFloor(x, z) || IsFloor(x, (int)z - facing))
+				{
+					x++;
+					continue;
+				}
+				unsigned int end = x + 1;
+				while (end < endX && IsFloor(end, z) && !IsFloor(end, (int)z - facing))
+					end++;
+
+				float wallZ = origin[2] + (facing > 0 ? z : z + 1) * ts;
+				float corner[3] = { origin[0] + x * ts, origin[1], wallZ };
+				float along[3] = { (end - x) * ts, 0, 0 };
+				float uv[2] = { (float)x, height / ts };
+				float uvAlong[2] = { (float)(end - x), 0 };
+				if (facing > 0)
+					AddQuad(chunk, corner, along, up, uv, uvAlong, uvUp);
+				else
+					AddQuad(chunk, corner, up, along, uv, uvUp, uvAlong);
+				x = end;
+			}
+		}
+	}
+}
+
+void Dungeon::BuildChunks()
+{
+	for (unsigned int c = 0; c < GetChunkCount(); c++)
+		BuildChunk(c);
+}
+
+unsigned int Dungeon::AddJobs(RenderJobGraph* graph, unsigned int jobCount)
+{
+	jobCount = (std::max)(1u, (std::min)(jobCount, (unsigned int)DUNGEON_MAX_JOBS));
+
+	// Chunks in the middle of the map hold more than those
+	// at its edges, so each job takes every jobCount'th one
+	// rather than a run of them
+	unsigned int jobs[DUNGEON_MAX_JOBS];
+	for (unsigned int j = 0; j < jobCount; j++)
+	{
+		jobs[j] = graph->AddJob("Dungeon Chunks", [this, j, jobCount](unsigned int)
+		{
+			for (unsigned int c = j; c < GetChunkCount(); c += jobCount)
+				BuildChunk(c);
+		});
+	}
+	return graph->AddJob("Finish Dungeon", [](unsigned int) {}, Span<const unsigned int>(jobs, jobCount));
+}
+
+uint64_t Dungeon::Hash() const
+{
+	uint64_t hash = 14695981039346656037ull;
+	auto add = [&hash](const void* data, size_t bytes)
+	{
+		const unsigned char* b = (const unsigned char*)data;
+		for (size_t i = 0; i < bytes; i++)
+			hash = (hash ^ b[i]) * 1099511628211ull;
+	};
+
+	add(tiles.data(), tiles.size());
+	for (const DungeonChunk& chunk : chunks)
+	{
+		add(chunk.vertices.data(), chunk.vertices.size() * sizeof(DungeonVertex));
+		add(chunk.indices.data(), chunk.indices.size() * sizeof(unsigned int));
+		add(chunk.collision.data(), chunk.collision.size() * sizeof(float));
+	}
+	return hash;
+}
+
+// --------------------------------------------------------
+// Benchmark
+// --------------------------------------------------------
+
+DungeonBenchmark BenchmarkDungeon(unsigned int tiles, unsigned int seed, unsigned int workerCount)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	DungeonBenchmark result = {};
+	result.tiles = tiles;
+	result.workerCount = workerCount;
+
+	DungeonSettings settings = DefaultDungeonSettings();
+	settings.seed = seed;
+	settings.width = tiles;
+	settings.depth = tiles;
+
+	Dungeon serial;
+	serial.Generate(settings);
+	result.layoutMS = serial.GetLayoutMS();
+	Clock::time_point start = Clock::now();
+	serial.BuildChunks();
+	result.serialChunksMS = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+
+	// Laid out again from the seed, so the layout is checked
+	// along with the chunks
+	Dungeon parallel;
+	parallel.Generate(settings);
+	RenderJobGraph graph(workerCount);
+	start = Clock::now();
+	graph.Reset();
+	parallel.AddJobs(&graph, workerCount + 1);
+	graph.Run(true);
+	result.parallelChunksMS = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+
+	result.rooms = serial.GetRoomCount();
+	result.floorTiles = serial.GetFloorTileCount();
+	result.chunks = serial.GetChunkCount();
+	result.triangles = serial.GetTriangleCount();
+	result.hash = serial.Hash();
+	result.deterministic = result.hash == parallel.Hash();
+	return result;
+}
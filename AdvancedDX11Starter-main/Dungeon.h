@@ -0,0 +1,160 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Lay out a dungeon from a seed. The map is split
+//			by a binary space partition, each leaf getting a
+//			room and each split a corridor joining a room on
+//			either side of it, all carved into a grid of
+//			tiles. The tiles are then cut into square chunks,
+//			each turned into one mesh of floors, walls and
+//			ceilings, with neighboring tiles merged into as
+//			few quads as will cover them, and the same
+//			triangles kept for collision. Chunks only read the
+//			finished tiles, so they can be built on any worker
+//			in any order and always come out the same.
+
+#include <vector>
+#include <stdint.h>
+
+#include "RenderJobGraph.h"
+
+// Most jobs the chunks are split into
+#define DUNGEON_MAX_JOBS 64
+
+// What a tile is carved into
+#define DUNGEON_SOLID 0
+#define DUNGEON_ROOM 1
+#define DUNGEON_CORRIDOR 2
+
+/// <summary>
+/// The seed, size and shape of a dungeon
+/// </summary>
+struct DungeonSettings
+{
+	unsigned int seed;
+	unsigned int width;			// Tiles along X
+	unsigned int depth;			// Tiles along Z
+	float origin[3];			// World position of tile 0's corner, on the floor
+	float tileSize;
+	float wallHeight;
+	unsigned int minLeafTiles;		// Partitions smaller than twice this aren't split
+	unsigned int minRoomTiles;
+	unsigned int maxRoomTiles;
+	unsigned int corridorTiles;		// Width of a corridor
+	unsigned int chunkTiles;		// Side of a chunk
+};
+
+/// <summary>
+/// A small dungeon of two meter tiles
+/// </summary>
+DungeonSettings DefaultDungeonSettings();
+
+/// <summary>
+/// A room's first tile and its size in tiles
+/// </summary>
+struct DungeonRoom
+{
+	unsigned int x;
+	unsigned int z;
+	unsigned int width;
+	unsigned int depth;
+};
+
+/// <summary>
+/// Laid out like the engine's Vertex, leaving the tangent
+/// for the mesh to work out
+/// </summary>
+struct DungeonVertex
+{
+	float position[3];
+	float uv[2];
+	float normal[3];
+};
+
+/// <summary>
+/// The geometry of one square of tiles, in world space
+/// </summary>
+struct DungeonChunk
+{
+	unsigned int x;				// First tile
+	unsigned int z;
+	std::vector<DungeonVertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<float> collision;		// Nine floats a triangle
+};
+
+class Dungeon
+{
+public:
+	Dungeon();
+
+	// Lays out the rooms and corridors and sizes the chunks,
+	// leaving their geometry empty
+	void Generate(const DungeonSettings& settings);
+
+	// Fills in one chunk's geometry from the tiles
+	void BuildChunk(unsigned int chunk);
+
+	// Builds every chunk on the calling thread
+	void BuildChunks();
+
+	// Adds jobs building every chunk to a graph, jobCount of
+	// them (at most DUNGEON_MAX_JOBS) taking every jobCount'th
+	// chunk, and returns the index of a job waiting on all
+	unsigned int AddJobs(RenderJobGraph* graph, unsigned int jobCount);
+
+	unsigned char GetTile(int x, int z) const;
+	bool IsFloor(int x, int z) const { return GetTile(x, z) != DUNGEON_SOLID; }
+
+	// Middle of a tile, on the floor
+	void GetTileCenter(unsigned int x, unsigned int z, float position[3]) const;
+
+	const DungeonSettings& GetSettings() const { return settings; }
+	unsigned int GetRoomCount() const { return (unsigned int)rooms.size(); }
+	const DungeonRoom& GetRoom(unsigned int index) const { return rooms[index]; }
+	unsigned int GetChunkCount() const { return (unsigned int)chunks.size(); }
+	const DungeonChunk& GetChunk(unsigned int index) const { return chunks[index]; }
+	unsigned int GetFloorTileCount() const { return floorTileCount; }
+	unsigned int GetTriangleCount() const;
+	float GetLayoutMS() const { return layoutMS; }
+
+	// FNV-1a over the tiles and every chunk's geometry, for
+	// telling whether two builds came out the same
+	uint64_t Hash() const;
+
+private:
+	void Carve(unsigned int x, unsigned int z, unsigned int width, unsigned int depth, unsigned char tile);
+
+	DungeonSettings settings;
+	std::vector<unsigned char> tiles;		// x + z * width
+	std::vector<DungeonRoom> rooms;
+	std::vector<DungeonChunk> chunks;
+	unsigned int chunksX;
+	unsigned int floorTileCount;
+	float layoutMS;
+};
+
+/// <summary>
+/// Results of one headless benchmark run
+/// </summary>
+struct DungeonBenchmark
+{
+	unsigned int tiles;				// Along each side
+	unsigned int rooms;
+	unsigned int floorTiles;
+	unsigned int chunks;
+	unsigned int triangles;
+	unsigned int workerCount;
+	float layoutMS;
+	float serialChunksMS;
+	float parallelChunksMS;
+	bool deterministic;				// Both builds hashed the same
+	uint64_t hash;
+};
+
+/// <summary>
+/// Generates a square dungeon of the given side from a seed,
+/// building its chunks once on the calling thread and once
+/// across a graph of workers, and checks the two match
+/// </summary>
+DungeonBenchmark BenchmarkDungeon(unsigned int tiles, unsigned int seed, unsigned int workerCount);
@@ -0,0 +1,85 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Skeletons that chase the player around the level.
+//			Each asks the path queue for a way to the player
+//			every so often and hands what it gets to the crowd,
+//			which walks every enemy along its path without them
+//			running into each other.
+
+#include <vector>
+#include <limits.h>
+#include <math.h>
+
+#include "EntityStore.h"
+#include "NavMesh.h"
+#include "Crowd.h"
+
+// Path tickets when there isn't one
+#define ENEMY_NO_PATH UINT_MAX
+
+// Skelly.obj's feet are this far under its origin
+#define ENEMY_FOOT_OFFSET 0.96f
+#define ENEMY_RADIUS 0.4f
+
+// How often a new path is asked for, and how close to the
+// target an enemy stops
+#define ENEMY_REPATH_SECONDS 1.0f
+#define ENEMY_STOP_DISTANCE 1.2f
+
+/// <summary>
+/// Holds data relating to every enemy walking the level.
+/// Where they are lives in the crowd
+/// </summary>
+struct EnemiesData
+{
+	std::vector<unsigned int> agents;		// In the crowd
+	std::vector<float> repathTimers;
+	std::vector<unsigned int> requests;		// Ticket of the next path, still searching
+};
+
+/// <summary>
+/// Add an enemy standing at position. Their first paths are
+/// asked for a little apart so they don't all search at once
+/// </summary>
+static void AddEnemy(EnemiesData* data, Crowd* crowd, EntityId entity, const float position[3], float speed)
+{
+	unsigned int count = (unsigned int)data->agents.size();
+	data->agents.push_back(crowd->AddAgent(entity, position, ENEMY_RADIUS, speed));
+	data->repathTimers.push_back(fmodf(count * 0.13f, ENEMY_REPATH_SECONDS));
+	data->requests.push_back(ENEMY_NO_PATH);
+}
+
+/// <summary>
+/// Hands paths the queue has finished to the crowd and asks
+/// for new ones when they're due. The crowd keeps walking the
+/// last path while the next is searched for
+/// </summary>
+static void UpdateEnemies(EnemiesData* data, Crowd* crowd, NavPathQueue* queue, const float target[3], float delta)
+{
+	for (size_t i = 0; i < data->agents.size(); i++)
+	{
+		unsigned int request = data->requests[i];
+		if (request != ENEMY_NO_PATH)
+		{
+			NavPathStatus status = queue->GetStatus(request);
+			if (status == NavPathStatus::Waiting || status == NavPathStatus::Searching)
+				continue;
+
+			if (status == NavPathStatus::Found || status == NavPathStatus::Partial)
+				crowd->SetPath(data->agents[i], queue->GetPath(request), ENEMY_STOP_DISTANCE);
+			queue->Release(request);
+			data->requests[i] = ENEMY_NO_PATH;
+		}
+
+		data->repathTimers[i] -= delta;
+		if (data->repathTimers[i] <= 0.0f)
+		{
+			data->repathTimers[i] += ENEMY_REPATH_SECONDS;
+
+			float position[3];
+			crowd->GetPosition(data->agents[i], position);
+			data->requests[i] = queue->Request(position, target);
+		}
+	}
+}
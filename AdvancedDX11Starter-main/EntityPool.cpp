@@ -0,0 +1,160 @@
+#include "EntityPool.h"
+
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+
+#include "AllocationCounter.h"
+
+EntityPool::EntityPool(EntityStore* store, const EntityDesc& prototype, unsigned int capacity) :
+	store(store),
+	prototype(prototype),
+	capacity(capacity),
+	rejected(0)
+{
+	live.reserve(capacity);
+}
+
+/// <summary>
+/// Copies the prototype to where it was asked for
+/// </summary>
+EntityId EntityPool::Spawn(const float position[3], const float pitchYawRoll[3], const float velocity[3])
+{
+	if (live.size() >= capacity)
+	{
+		rejected++;
+		return EntityId();
+	}
+
+	EntityDesc desc = prototype;
+	memcpy(desc.transform.position, position, sizeof(desc.transform.position));
+	memcpy(desc.transform.pitchYawRoll, pitchYawRoll, sizeof(desc.transform.pitchYawRoll));
+	memcpy(desc.gameplay.velocity, velocity, sizeof(desc.gameplay.velocity));
+	desc.transform.dirty = true;
+
+	EntityId id = store->Create(desc);
+	live.push_back(id);
+	return id;
+}
+
+void EntityPool::Despawn(EntityId id)
+{
+	store->Destroy(id);
+}
+
+/// <summary>
+/// Drops IDs that no longer name an entity, swapping the
+/// last one into their place
+/// </summary>
+void EntityPool::Update()
+{
+	for (size_t i = 0; i < live.size();)
+	{
+		if (store->IsValid(live[i]))
+		{
+			i++;
+			continue;
+		}
+		live[i] = live.back();
+		live.pop_back();
+	}
+}
+
+/// <summary>
+/// Destroying in the middle of the pass is safe since the
+/// store holds on to it until ApplyChanges()
+/// </summary>
+void UpdateGameplayComponents(EntityStore* store, float deltaTime)
+{
+	store->ForEachChunk(
+		COMPONENT_BIT(TransformComponent) | COMPONENT_BIT(GameplayComponent),
+		[store, deltaTime](EntityChunk& chunk)
+	{
+		TransformComponent* transforms = chunk.Get<TransformComponent>();
+		GameplayComponent* gameplay = chunk.Get<GameplayComponent>();
+		for (unsigned int i = 0; i < chunk.count; i++)
+		{
+			GameplayComponent& g = gameplay[i];
+			if (g.velocity[0] != 0.0f || g.velocity[1] != 0.0f || g.velocity[2] != 0.0f)
+			{
+				TransformComponent& t = transforms[i];
+				t.position[0] += g.velocity[0] * deltaTime;
+				t.position[1] += g.velocity[1] * deltaTime;
+				t.position[2] += g.velocity[2] * deltaTime;
+				t.dirty = true;
+			}
+
+			if (g.lifetime > 0.0f)
+			{
+				g.lifetime -= deltaTime;
+				if (g.lifetime <= 0.0f)
+					store->Destroy(chunk.ids[i]);
+			}
+		}
+	});
+}
+
+// --------------------------------------------------------
+// Benchmark
+// --------------------------------------------------------
+
+EntitySpawnBenchmark BenchmarkEntitySpawning(unsigned int spawnsPerSecond, float seconds)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	const float deltaTime = 1.0f / 60.0f;
+	const float warmupSeconds = 2.0f;
+
+	EntitySpawnBenchmark result = {};
+	result.spawnsPerSecond = spawnsPerSecond;
+	result.frames = (unsigned int)(seconds / deltaTime);
+
+	// Everything lives a second, so a pool a little bigger
+	// than a second of spawns never turns any away
+	EntityDesc prototype = {};
+	prototype.mask = COMPONENTS_RENDERABLE | COMPONENT_BIT(GameplayComponent);
+	prototype.transform = DefaultTransform();
+	prototype.bounds.localRadius = 0.25f;
+	prototype.mobility.mobility = EntityMobility::Dynamic;
+	prototype.gameplay.health = 1.0f;
+	prototype.gameplay.lifetime = 1.0f;
+
+	EntityStore store;
+	EntityPool pool(&store, prototype, spawnsPerSecond + spawnsPerSecond / 4 + 1);
+
+	double totalSeconds = 0;
+	double spawnDebt = 0;
+	unsigned long long steadyStart = 0;
+	for (unsigned int frame = 0; frame < result.frames; frame++)
+	{
+		if (frame == (unsigned int)(warmupSeconds / deltaTime))
+			steadyStart = GetThreadHeapAllocationCount();
+
+		auto start = Clock::now();
+
+		store.ApplyChanges();
+		pool.Update();
+		UpdateGameplayComponents(&store, deltaTime);
+
+		spawnDebt += spawnsPerSecond * (double)deltaTime;
+		for (; spawnDebt >= 1.0; spawnDebt -= 1.0)
+		{
+			float position[3] = { (float)(rand() % 200) - 100.0f, 1.0f, (float)(rand() % 200) - 100.0f };
+			float rotation[3] = { 0, 0, 0 };
+			float velocity[3] = { 0, 0, 10.0f };
+			pool.Spawn(position, rotation, velocity);
+		}
+
+		double frameSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+		totalSeconds += frameSeconds;
+		if ((float)(frameSeconds * 1000.0) > result.worstFrameMS)
+			result.worstFrameMS = (float)(frameSeconds * 1000.0);
+	}
+
+	if (result.frames > 0)
+		result.frameMS = (float)(totalSeconds * 1000.0 / result.frames);
+	if (steadyStart > 0)
+		result.steadyAllocations = GetThreadHeapAllocationCount() - steadyStart;
+	result.liveEntities = pool.GetLiveCount();
+	return result;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Spawn and despawn entities of one kind, like wand
+//			projectiles or a wave of enemies, without touching
+//			the heap once the pool has seen its busiest frame.
+//			The pool holds a prototype with its assets already
+//			looked up, the store reuses entity slots and chunks,
+//			and despawning is a swap with the last entity of the
+//			chunk, so nothing is regrouped or reallocated.
+
+#include <vector>
+
+#include "EntityStore.h"
+
+/// <summary>
+/// Spawns copies of a prototype into a store, up to a set
+/// number alive at once. Like everything in the store, spawns
+/// and despawns land on the next ApplyChanges()
+/// </summary>
+class EntityPool
+{
+public:
+	EntityPool(EntityStore* store, const EntityDesc& prototype, unsigned int capacity);
+
+	EntityPool(const EntityPool&) = delete;
+	EntityPool& operator=(const EntityPool&) = delete;
+
+	// Null when the pool is full. The velocity is only kept
+	// when the prototype has a gameplay component
+	EntityId Spawn(const float position[3], const float pitchYawRoll[3], const float velocity[3]);
+	void Despawn(EntityId id);
+
+	// Forgets entities destroyed by anything, the pool or
+	// not, since the last call. Once a frame is enough
+	void Update();
+
+	unsigned int GetLiveCount() const { return (unsigned int)live.size(); }
+	unsigned int GetCapacity() const { return capacity; }
+	unsigned int GetRejectedCount() const { return rejected; }
+
+private:
+	EntityStore* store;
+	EntityDesc prototype;
+	unsigned int capacity;
+	unsigned int rejected;
+
+	// Reserved up front, never grows
+	std::vector<EntityId> live;
+};
+
+/// <summary>
+/// Moves every entity with a velocity and counts down
+/// lifetimes, destroying entities whose time is up
+/// </summary>
+void UpdateGameplayComponents(EntityStore* store, float deltaTime);
+
+/// <summary>
+/// Results of the headless spawn stress test
+/// </summary>
+struct EntitySpawnBenchmark
+{
+	unsigned int spawnsPerSecond;
+	unsigned int frames;
+	unsigned int liveEntities;		// At the end of the run
+	float frameMS;					// Spawning, despawning and moving, per frame
+	float worstFrameMS;
+	unsigned long long steadyAllocations;	// After the first two seconds
+};
+
+/// <summary>
+/// Runs seconds of 60 Hz frames spawning spawnsPerSecond
+/// entities that live for one second each, and counts heap
+/// allocations once the pool has reached its steady size
+/// </summary>
+EntitySpawnBenchmark BenchmarkEntitySpawning(unsigned int spawnsPerSecond, float seconds);
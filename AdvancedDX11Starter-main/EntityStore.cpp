@@ -0,0 +1,515 @@
+#include "EntityStore.h"
+
+#include <chrono>
+#include <math.h>
+#include <memory>
+#include <stdlib.h>
+#include <string.h>
+
+static const size_t componentSizes[ENTITY_COMPONENT_TYPES] =
+{
+	sizeof(TransformComponent),
+	sizeof(RenderComponent),
+	sizeof(BoundsComponent),
+	sizeof(MobilityComponent),
+	sizeof(GameplayComponent)
+};
+
+// Where each component of an EntityDesc is, by type index
+static const void* DescComponent(const EntityDesc& desc, unsigned int type)
+{
+	switch (type)
+	{
+	case 0: return &desc.transform;
+	case 1: return &desc.render;
+	case 2: return &desc.bounds;
+	case 3: return &desc.mobility;
+	default: return &desc.gameplay;
+	}
+}
+
+TransformComponent DefaultTransform()
+{
+	TransformComponent transform = {};
+	transform.scale[0] = 1.0f;
+	transform.scale[1] = 1.0f;
+	transform.scale[2] = 1.0f;
+	transform.dirty = true;
+	for (int i = 0; i < 4; i++)
+	{
+		transform.world[i][i] = 1.0f;
+		transform.worldInvTrans[i][i] = 1.0f;
+	}
+	return transform;
+}
+
+// --------------------------------------------------------
+// Chunks
+// --------------------------------------------------------
+
+/// <summary>
+/// One allocation holding the chunk and an array for each
+/// component in the mask. Made with new so it shows up in
+/// the heap allocation count
+/// </summary>
+static EntityChunk* AllocateChunk(unsigned int mask)
+{
+	size_t bytes = (sizeof(EntityChunk) + 15) & ~(size_t)15;
+	size_t offsets[ENTITY_COMPONENT_TYPES] = {};
+	for (unsigned int c = 0; c < ENTITY_COMPONENT_TYPES; c++)
+	{
+		if (!(mask & (1u << c)))
+			continue;
+		offsets[c] = bytes;
+		bytes += (componentSizes[c] * ENTITY_CHUNK_CAPACITY + 15) & ~(size_t)15;
+	}
+
+	unsigned char* memory = (unsigned char*)::operator new(bytes);
+	EntityChunk* chunk = (EntityChunk*)memory;
+	chunk->count = 0;
+	for (unsigned int c = 0; c < ENTITY_COMPONENT_TYPES; c++)
+		chunk->components[c] = (mask & (1u << c)) ? memory + offsets[c] : nullptr;
+	return chunk;
+}
+
+static void* ComponentAt(const EntityChunk* chunk, unsigned int type, unsigned int row)
+{
+	return (unsigned char*)chunk->components[type] + componentSizes[type] * row;
+}
+
+// --------------------------------------------------------
+// Store
+// --------------------------------------------------------
+
+EntityStore::EntityStore() :
+	entityCount(0)
+{
+}
+
+EntityStore::~EntityStore()
+{
+	for (auto& archetype : archetypes)
+	{
+		for (EntityChunk* chunk : archetype.chunks)
+			::operator delete(chunk);
+	}
+}
+
+/// <summary>
+/// Hands out an ID now and places the entity on the next
+/// ApplyChanges()
+/// </summary>
+EntityId EntityStore::Create(const EntityDesc& desc)
+{
+	unsigned int index;
+	if (!freeSlots.empty())
+	{
+		index = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		index = (unsigned int)slots.size();
+		EntitySlot slot = {};
+		slot.generation = 1;
+		slot.archetype = -1;
+		slots.push_back(slot);
+	}
+
+	EntityId id;
+	id.index = index;
+	id.generation = slots[index].generation;
+
+	pendingCreates.push_back(desc);
+	pendingCreateIds.push_back(id);
+	return id;
+}
+
+/// <summary>
+/// An entity that was never placed is dropped right away,
+/// otherwise it goes on the next ApplyChanges()
+/// </summary>
+void EntityStore::Destroy(EntityId id)
+{
+	if (id.IsNull() || id.index >= slots.size())
+		return;
+
+	EntitySlot& slot = slots[id.index];
+	if (slot.generation != id.generation)
+		return;
+
+	if (slot.archetype < 0)
+	{
+		FreeSlot(id.index);
+		return;
+	}
+
+	if (!slot.destroyQueued)
+	{
+		slot.destroyQueued = true;
+		pendingDestroys.push_back(id);
+	}
+}
+
+/// <summary>
+/// Adds and removes components, moving the entity to the
+/// archetype for its new mask on the next ApplyChanges().
+/// Components it keeps keep their values, new ones start zeroed
+/// </summary>
+void EntityStore::SetComponentMask(EntityId id, unsigned int mask)
+{
+	MaskChange change = {};
+	change.id = id;
+	change.mask = mask;
+	pendingMasks.push_back(change);
+}
+
+/// <summary>
+/// Applies every structural change queued since the last
+/// call. Mask changes go first, then destroys, then creates
+/// </summary>
+void EntityStore::ApplyChanges()
+{
+	for (const MaskChange& change : pendingMasks)
+	{
+		if (!IsAlive(change.id) || slots[change.id.index].destroyQueued)
+			continue;
+
+		EntitySlot& slot = slots[change.id.index];
+		if (archetypes[slot.archetype].mask == change.mask)
+			continue;
+
+		// Copy into the new archetype first, then
+		// close the gap it left in the old one
+		int oldArchetype = slot.archetype;
+		EntityChunk* oldChunk = slot.chunk;
+		unsigned int oldRow = slot.row;
+		Place(change.id, FindOrAddArchetype(change.mask), oldChunk, oldRow, nullptr);
+		RemoveAt(oldArchetype, oldChunk, oldRow);
+	}
+	pendingMasks.clear();
+
+	for (EntityId id : pendingDestroys)
+	{
+		if (!IsAlive(id))
+			continue;
+		const EntitySlot& slot = slots[id.index];
+		RemoveAt(slot.archetype, slot.chunk, slot.row);
+		FreeSlot(id.index);
+		entityCount--;
+	}
+	pendingDestroys.clear();
+
+	for (size_t i = 0; i < pendingCreates.size(); i++)
+	{
+		EntityId id = pendingCreateIds[i];
+		const EntitySlot& slot = slots[id.index];
+		if (slot.generation != id.generation || slot.archetype >= 0)
+			continue;
+		Place(id, FindOrAddArchetype(pendingCreates[i].mask), nullptr, 0, &pendingCreates[i]);
+		entityCount++;
+	}
+	pendingCreates.clear();
+	pendingCreateIds.clear();
+}
+
+bool EntityStore::IsAlive(EntityId id) const
+{
+	return !id.IsNull() &&
+		id.index < slots.size() &&
+		slots[id.index].generation == id.generation &&
+		slots[id.index].archetype >= 0;
+}
+
+/// <summary>
+/// Whether the ID still names an entity, including one that
+/// is waiting to be placed or destroyed
+/// </summary>
+bool EntityStore::IsValid(EntityId id) const
+{
+	return !id.IsNull() &&
+		id.index < slots.size() &&
+		slots[id.index].generation == id.generation;
+}
+
+unsigned int EntityStore::GetComponentMask(EntityId id) const
+{
+	return IsAlive(id) ? archetypes[slots[id.index].archetype].mask : 0;
+}
+
+unsigned int EntityStore::GetChunkCount() const
+{
+	unsigned int count = 0;
+	for (auto& archetype : archetypes)
+		count += (unsigned int)archetype.chunks.size();
+	return count;
+}
+
+unsigned int EntityStore::GetPendingChangeCount() const
+{
+	return (unsigned int)(pendingCreates.size() + pendingDestroys.size() + pendingMasks.size());
+}
+
+int EntityStore::FindOrAddArchetype(unsigned int mask)
+{
+	for (size_t i = 0; i < archetypes.size(); i++)
+	{
+		if (archetypes[i].mask == mask)
+			return (int)i;
+	}
+
+	Archetype archetype = {};
+	archetype.mask = mask;
+	archetypes.push_back(archetype);
+	return (int)archetypes.size() - 1;
+}
+
+/// <summary>
+/// Appends an entity to an archetype. Components come from
+/// the description when there is one, otherwise from where
+/// the entity was, and anything neither has is zeroed
+/// </summary>
+void EntityStore::Place(EntityId id, int archetypeIndex, const EntityChunk* fromChunk, unsigned int fromRow, const EntityDesc* desc)
+{
+	Archetype& archetype = archetypes[archetypeIndex];
+
+	// Entities fill chunks in order, so the one with
+	// room is always the one after the full ones
+	unsigned int chunkIndex = archetype.count / ENTITY_CHUNK_CAPACITY;
+	if (chunkIndex == archetype.chunks.size())
+		archetype.chunks.push_back(AllocateChunk(archetype.mask));
+
+	EntityChunk* chunk = archetype.chunks[chunkIndex];
+	unsigned int row = chunk->count++;
+	chunk->ids[row] = id;
+
+	for (unsigned int c = 0; c < ENTITY_COMPONENT_TYPES; c++)
+	{
+		if (!(archetype.mask & (1u << c)))
+			continue;
+
+		void* to = ComponentAt(chunk, c, row);
+		if (desc)
+			memcpy(to, DescComponent(*desc, c), componentSizes[c]);
+		else if (fromChunk && fromChunk->components[c])
+			memcpy(to, ComponentAt(fromChunk, c, fromRow), componentSizes[c]);
+		else
+			memset(to, 0, componentSizes[c]);
+	}
+
+	archetype.count++;
+
+	EntitySlot& slot = slots[id.index];
+	slot.archetype = archetypeIndex;
+	slot.chunk = chunk;
+	slot.row = row;
+}
+
+/// <summary>
+/// Empties a row of an archetype by moving the archetype's
+/// last entity into it. Whoever was in the row is left for
+/// the caller to deal with
+/// </summary>
+void EntityStore::RemoveAt(int archetypeIndex, EntityChunk* chunk, unsigned int row)
+{
+	Archetype& archetype = archetypes[archetypeIndex];
+
+	unsigned int last = archetype.count - 1;
+	EntityChunk* lastChunk = archetype.chunks[last / ENTITY_CHUNK_CAPACITY];
+	unsigned int lastRow = last % ENTITY_CHUNK_CAPACITY;
+
+	if (lastChunk != chunk || lastRow != row)
+	{
+		EntityId movedId = lastChunk->ids[lastRow];
+		chunk->ids[row] = movedId;
+		for (unsigned int c = 0; c < ENTITY_COMPONENT_TYPES; c++)
+		{
+			if (archetype.mask & (1u << c))
+				memcpy(ComponentAt(chunk, c, row), ComponentAt(lastChunk, c, lastRow), componentSizes[c]);
+		}
+
+		slots[movedId.index].chunk = chunk;
+		slots[movedId.index].row = row;
+	}
+
+	// Empty chunks are kept for the next entities
+	lastChunk->count--;
+	archetype.count--;
+}
+
+/// <summary>
+/// Moves a slot on a generation so old IDs to it go stale
+/// </summary>
+void EntityStore::FreeSlot(unsigned int index)
+{
+	EntitySlot& slot = slots[index];
+	slot.generation++;
+	if (slot.generation == 0)
+		slot.generation = 1;
+	slot.archetype = -1;
+	slot.chunk = nullptr;
+	slot.row = 0;
+	slot.destroyQueued = false;
+	freeSlots.push_back(index);
+}
+
+// --------------------------------------------------------
+// Benchmark
+// --------------------------------------------------------
+
+namespace
+{
+	// Stand-ins for what a GameEntity pointed at
+	struct ListMesh
+	{
+		float boundsCenter[3];
+		float boundsRadius;
+		unsigned int indexCount;
+	};
+
+	struct ListMaterial
+	{
+		unsigned int vs;
+		unsigned int ps;
+	};
+
+	// Laid out like GameEntity with its Transform inside
+	class ListEntity
+	{
+	public:
+		std::shared_ptr<ListMesh> GetMesh() { return mesh; }
+		std::shared_ptr<ListMaterial> GetMaterial() { return material; }
+
+		std::shared_ptr<ListMesh> mesh;
+		std::shared_ptr<ListMaterial> material;
+		bool castsShadows;
+		EntityMobility mobility;
+
+		float position[3];
+		float pitchYawRoll[3];
+		float scale[3];
+		bool vectorsDirty;
+		float up[3];
+		float right[3];
+		float forward[3];
+		bool matricesDirty;
+		float world[4][4];
+		float worldInvTrans[4][4];
+	};
+}
+
+// Bounds in world space, the part of the pass both share
+static float WorldBounds(const float world[4][4], const float center[3], float radius, float out[3])
+{
+	for (int i = 0; i < 3; i++)
+		out[i] = center[0] * world[0][i] + center[1] * world[1][i] + center[2] * world[2][i] + world[3][i];
+
+	float scale = 0.0f;
+	for (int r = 0; r < 3; r++)
+	{
+		float length = sqrtf(world[r][0] * world[r][0] + world[r][1] * world[r][1] + world[r][2] * world[r][2]);
+		scale = length > scale ? length : scale;
+	}
+	return radius * scale;
+}
+
+EntityIterationBenchmark BenchmarkEntityIteration(unsigned int entityCount, unsigned int passes)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	EntityIterationBenchmark result = {};
+	result.entityCount = entityCount;
+	if (passes == 0)
+		return result;
+
+	// A handful of meshes and materials shared by everything
+	const unsigned int meshCount = 16;
+	const unsigned int materialCount = 8;
+	std::vector<std::shared_ptr<ListMesh>> meshes;
+	std::vector<std::shared_ptr<ListMaterial>> materials;
+	for (unsigned int i = 0; i < meshCount; i++)
+	{
+		ListMesh mesh = { { 0.0f, 0.5f, 0.0f }, 1.0f + i * 0.1f, 36 * (i + 1) };
+		meshes.push_back(std::make_shared<ListMesh>(mesh));
+	}
+	for (unsigned int i = 0; i < materialCount; i++)
+	{
+		ListMaterial material = { i, i % 3 };
+		materials.push_back(std::make_shared<ListMaterial>(material));
+	}
+
+	std::vector<std::shared_ptr<ListEntity>> list;
+	list.reserve(entityCount);
+	EntityStore store;
+
+	for (unsigned int i = 0; i < entityCount; i++)
+	{
+		unsigned int meshIndex = (unsigned int)rand() % meshCount;
+		unsigned int materialIndex = (unsigned int)rand() % materialCount;
+
+		EntityDesc desc = {};
+		desc.mask = COMPONENTS_RENDERABLE;
+		if (i % 4 == 0)
+			desc.mask |= COMPONENT_BIT(GameplayComponent);
+		desc.transform = DefaultTransform();
+		desc.transform.world[3][0] = (float)rand() / RAND_MAX * 200.0f - 100.0f;
+		desc.transform.world[3][2] = (float)rand() / RAND_MAX * 200.0f - 100.0f;
+		desc.render.mesh.index = meshIndex;
+		desc.render.material.index = materialIndex;
+		desc.render.ps.index = materials[materialIndex]->ps;
+		memcpy(desc.bounds.localCenter, meshes[meshIndex]->boundsCenter, sizeof(desc.bounds.localCenter));
+		desc.bounds.localRadius = meshes[meshIndex]->boundsRadius;
+		store.Create(desc);
+
+		std::shared_ptr<ListEntity> entity = std::make_shared<ListEntity>();
+		entity->mesh = meshes[meshIndex];
+		entity->material = materials[materialIndex];
+		memcpy(entity->world, desc.transform.world, sizeof(entity->world));
+		list.push_back(entity);
+	}
+	store.ApplyChanges();
+
+	// The snapshot used to keep its own reference to every
+	// entity and got the mesh and material by value
+	double listSeconds = 0;
+	double storeSeconds = 0;
+	volatile float sink = 0;
+	for (unsigned int p = 0; p < passes; p++)
+	{
+		float sum = 0;
+		auto start = Clock::now();
+		for (auto& entity : list)
+		{
+			std::shared_ptr<ListEntity> kept = entity;
+			std::shared_ptr<ListMesh> mesh = entity->GetMesh();
+			std::shared_ptr<ListMaterial> material = entity->GetMaterial();
+
+			float center[3];
+			float radius = WorldBounds(kept->world, mesh->boundsCenter, mesh->boundsRadius, center);
+			sum += center[0] + center[2] + radius + (float)material->ps;
+		}
+		listSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+		sink = sink + sum;
+
+		sum = 0;
+		start = Clock::now();
+		store.ForEachChunk(COMPONENTS_RENDERABLE, [&sum](EntityChunk& chunk)
+		{
+			TransformComponent* transforms = chunk.Get<TransformComponent>();
+			RenderComponent* renders = chunk.Get<RenderComponent>();
+			BoundsComponent* bounds = chunk.Get<BoundsComponent>();
+			for (unsigned int i = 0; i < chunk.count; i++)
+			{
+				float center[3];
+				float radius = WorldBounds(transforms[i].world, bounds[i].localCenter, bounds[i].localRadius, center);
+				sum += center[0] + center[2] + radius + (float)renders[i].ps.index;
+			}
+		});
+		storeSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+		sink = sink + sum;
+	}
+
+	result.sharedListMS = (float)(listSeconds * 1000.0 / passes);
+	result.storeMS = (float)(storeSeconds * 1000.0 / passes);
+	return result;
+}
@@ -0,0 +1,285 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Keep every entity's components in dense arrays.
+//			Entities with the same set of components share an
+//			archetype, whose chunks hold a fixed number of
+//			them with one array per component, so passes over
+//			the scene walk memory in order instead of chasing
+//			a pointer per entity. Entities are named by IDs
+//			carrying a generation like asset handles, and
+//			anything that moves entities between chunks waits
+//			for ApplyChanges() at the frame boundary so IDs and
+//			chunks stay put while a frame runs.
+
+#include <vector>
+#include <stddef.h>
+
+#include "AssetHandle.h"
+
+// Entities per chunk. Every array of a chunk is this long
+#define ENTITY_CHUNK_CAPACITY 256
+
+#define ENTITY_COMPONENT_TYPES 5
+
+/// <summary>
+/// Whether an entity can move once the level is loaded.
+/// Static entities can have their shadows cached
+/// </summary>
+enum class EntityMobility
+{
+	Static,
+	Dynamic
+};
+
+// --------------------------------------------------------
+// Components. Plain data only, chunks copy them around
+// with memcpy when entities move
+// --------------------------------------------------------
+
+/// <summary>
+/// Where an entity is. Anything that changes the position,
+/// rotation or scale sets dirty so the matrices are rebuilt
+/// </summary>
+struct TransformComponent
+{
+	float position[3];
+	float pitchYawRoll[3];
+	float scale[3];
+	bool dirty;
+
+	float world[4][4];
+	float worldInvTrans[4][4];
+};
+
+/// <summary>
+/// What an entity is drawn with. The shaders are the
+/// material's, kept here so grouping never looks it up
+/// </summary>
+struct RenderComponent
+{
+	MeshHandle mesh;
+	MaterialHandle material;
+	VertexShaderHandle vs;
+	PixelShaderHandle ps;
+	bool castsShadows;
+	bool batched;		// Drawn as part of a static batch rather than on its own
+};
+
+// Bits of BoundsComponent::queryLayers
+#define ENTITY_LAYER_DEFAULT		(1u << 0)
+#define ENTITY_LAYER_PROJECTILE		(1u << 1)
+
+/// <summary>
+/// Bounding sphere around the mesh, and around the entity
+/// once its transform has been applied. Spatial queries only
+/// see entities in one of their layers, none for entities
+/// already part of the level's collision
+/// </summary>
+struct BoundsComponent
+{
+	float localCenter[3];
+	float localRadius;
+	float center[3];
+	float radius;
+	unsigned int queryLayers;
+};
+
+struct MobilityComponent
+{
+	EntityMobility mobility;
+};
+
+/// <summary>
+/// State gameplay code keeps on an entity. A lifetime at or
+/// below zero never runs out
+/// </summary>
+struct GameplayComponent
+{
+	float health;
+	float lifetime;
+	float velocity[3];
+};
+
+template<typename T> struct ComponentType;
+template<> struct ComponentType<TransformComponent>	{ static const unsigned int index = 0; };
+template<> struct ComponentType<RenderComponent>	{ static const unsigned int index = 1; };
+template<> struct ComponentType<BoundsComponent>	{ static const unsigned int index = 2; };
+template<> struct ComponentType<MobilityComponent>	{ static const unsigned int index = 3; };
+template<> struct ComponentType<GameplayComponent>	{ static const unsigned int index = 4; };
+
+// Bit of a component in an archetype's mask
+#define COMPONENT_BIT(T) (1u << ComponentType<T>::index)
+
+#define COMPONENTS_RENDERABLE ( \
+	COMPONENT_BIT(TransformComponent) | \
+	COMPONENT_BIT(RenderComponent) | \
+	COMPONENT_BIT(BoundsComponent) | \
+	COMPONENT_BIT(MobilityComponent))
+
+/// <summary>
+/// Index into the entity slots plus the generation of the
+/// slot when the entity was made. Generation 0 is never used
+/// so a default ID is always null
+/// </summary>
+struct EntityId
+{
+	unsigned int index;
+	unsigned int generation;
+
+	EntityId() : index(0), generation(0) {}
+	bool IsNull() const { return generation == 0; }
+	bool operator==(const EntityId& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const EntityId& other) const { return !(*this == other); }
+};
+
+/// <summary>
+/// A run of entities of one archetype, the first count of
+/// every array in use. Arrays for components the archetype
+/// doesn't have are null
+/// </summary>
+struct EntityChunk
+{
+	unsigned int count;
+	EntityId ids[ENTITY_CHUNK_CAPACITY];
+	void* components[ENTITY_COMPONENT_TYPES];
+
+	template<typename T>
+	T* Get() { return static_cast<T*>(components[ComponentType<T>::index]); }
+};
+
+/// <summary>
+/// Everything a new entity starts with. Only the components
+/// in the mask are kept
+/// </summary>
+struct EntityDesc
+{
+	unsigned int mask;
+	TransformComponent transform;
+	RenderComponent render;
+	BoundsComponent bounds;
+	MobilityComponent mobility;
+	GameplayComponent gameplay;
+};
+
+// A transform at the origin with no rotation and a scale of 1
+TransformComponent DefaultTransform();
+
+class EntityStore
+{
+public:
+	EntityStore();
+	~EntityStore();
+
+	EntityStore(const EntityStore&) = delete;
+	EntityStore& operator=(const EntityStore&) = delete;
+
+	// Structural changes. The ID is handed out right away but
+	// the entity only exists, and changes only happen, once
+	// ApplyChanges() runs
+	EntityId Create(const EntityDesc& desc);
+	void Destroy(EntityId id);
+	void SetComponentMask(EntityId id, unsigned int mask);
+	void ApplyChanges();
+
+	bool IsAlive(EntityId id) const;
+	bool IsValid(EntityId id) const;
+	unsigned int GetComponentMask(EntityId id) const;
+
+	/// <summary>
+	/// One component of an entity, or null when the entity is
+	/// gone or doesn't have it. Only valid until ApplyChanges()
+	/// </summary>
+	template<typename T>
+	T* Get(EntityId id)
+	{
+		if (!IsAlive(id))
+			return nullptr;
+		const EntitySlot& slot = slots[id.index];
+		return slot.chunk->Get<T>() ? slot.chunk->Get<T>() + slot.row : nullptr;
+	}
+
+	/// <summary>
+	/// Visits every chunk of every archetype that has all of
+	/// the components in the mask
+	/// </summary>
+	template<typename F>
+	void ForEachChunk(unsigned int mask, F visit)
+	{
+		for (auto& archetype : archetypes)
+		{
+			if ((archetype.mask & mask) != mask)
+				continue;
+			for (EntityChunk* chunk : archetype.chunks)
+			{
+				if (chunk->count > 0)
+					visit(*chunk);
+			}
+		}
+	}
+
+	unsigned int GetEntityCount() const { return entityCount; }
+	unsigned int GetArchetypeCount() const { return (unsigned int)archetypes.size(); }
+	unsigned int GetChunkCount() const;
+	unsigned int GetPendingChangeCount() const;
+
+private:
+
+	struct EntitySlot
+	{
+		unsigned int generation;
+		int archetype;		// -1 until the entity is placed
+		EntityChunk* chunk;
+		unsigned int row;
+		bool destroyQueued;
+	};
+
+	struct Archetype
+	{
+		unsigned int mask;
+		std::vector<EntityChunk*> chunks;
+		unsigned int count;
+	};
+
+	struct MaskChange
+	{
+		EntityId id;
+		unsigned int mask;
+	};
+
+	int FindOrAddArchetype(unsigned int mask);
+	void Place(EntityId id, int archetype, const EntityChunk* fromChunk, unsigned int fromRow, const EntityDesc* desc);
+	void RemoveAt(int archetype, EntityChunk* chunk, unsigned int row);
+	void FreeSlot(unsigned int index);
+
+	std::vector<EntitySlot> slots;
+	std::vector<unsigned int> freeSlots;
+	std::vector<Archetype> archetypes;
+	unsigned int entityCount;
+
+	// Waiting for the next ApplyChanges()
+	std::vector<EntityDesc> pendingCreates;
+	std::vector<EntityId> pendingCreateIds;
+	std::vector<EntityId> pendingDestroys;
+	std::vector<MaskChange> pendingMasks;
+};
+
+/// <summary>
+/// Times of one headless iteration benchmark, per pass
+/// </summary>
+struct EntityIterationBenchmark
+{
+	unsigned int entityCount;
+	float sharedListMS;		// vector of shared_ptr entities like GameEntity was
+	float storeMS;			// The same pass over the store's chunks
+};
+
+/// <summary>
+/// Builds entityCount entities both as a list of individually
+/// allocated entities holding shared_ptr meshes and materials,
+/// the way the scene used to be kept, and in a store. Then
+/// times the pass the snapshot makes over them: read the world
+/// matrix, move the bounds into world space and look at the
+/// mesh and material
+/// </summary>
+EntityIterationBenchmark BenchmarkEntityIteration(unsigned int entityCount, unsigned int passes);
@@ -0,0 +1,108 @@
+#include "FrameArena.h"
+
+#include <stdlib.h>
+
+// Rounds an address up to a power of two alignment
+static size_t AlignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+FrameArena::FrameArena(size_t bytes) :
+	block(nullptr),
+	capacity(bytes > 0 ? bytes : 1),
+	offset(0),
+	overflowOffset(0),
+	overflowCapacity(0),
+	destructors(nullptr),
+	usedBytes(0),
+	peakBytes(0)
+{
+	block = (unsigned char*)malloc(capacity);
+}
+
+FrameArena::~FrameArena()
+{
+	Reset();
+	free(block);
+}
+
+/// <summary>
+/// Bumps past the next suitably aligned spot in the block,
+/// or in an overflow block once this frame has filled it
+/// </summary>
+void* FrameArena::Allocate(size_t bytes, size_t alignment)
+{
+	if (bytes == 0)
+		bytes = 1;
+
+	usedBytes += bytes;
+	if (usedBytes > peakBytes)
+		peakBytes = usedBytes;
+
+	size_t start = AlignUp((size_t)block + offset, alignment) - (size_t)block;
+	if (overflowBlocks.empty() && start + bytes <= capacity)
+	{
+		offset = start + bytes;
+		return block + start;
+	}
+
+	// Keep filling the newest overflow block, or take
+	// another at least as large as the main one
+	if (!overflowBlocks.empty())
+	{
+		unsigned char* overflow = overflowBlocks.back();
+		start = AlignUp((size_t)overflow + overflowOffset, alignment) - (size_t)overflow;
+		if (start + bytes <= overflowCapacity)
+		{
+			overflowOffset = start + bytes;
+			return overflow + start;
+		}
+	}
+
+	overflowCapacity = (bytes + alignment > capacity) ? bytes + alignment : capacity;
+	unsigned char* overflow = (unsigned char*)malloc(overflowCapacity);
+	overflowBlocks.push_back(overflow);
+	start = AlignUp((size_t)overflow, alignment) - (size_t)overflow;
+	overflowOffset = start + bytes;
+	return overflow + start;
+}
+
+void FrameArena::AddDestructor(void* object, void (*destroy)(void*))
+{
+	Destructor* d = (Destructor*)Allocate(sizeof(Destructor), alignof(Destructor));
+	d->destroy = destroy;
+	d->object = object;
+	d->next = destructors;
+	destructors = d;
+}
+
+/// <summary>
+/// Destructs in the reverse order things were made, then
+/// starts over at the beginning of the block. A frame that
+/// overflowed leaves the block grown to fit it
+/// </summary>
+void FrameArena::Reset()
+{
+	for (Destructor* d = destructors; d; d = d->next)
+		d->destroy(d->object);
+	destructors = nullptr;
+
+	if (!overflowBlocks.empty())
+	{
+		for (unsigned char* overflow : overflowBlocks)
+			free(overflow);
+		overflowBlocks.clear();
+		overflowOffset = 0;
+		overflowCapacity = 0;
+
+		// Alignment padding isn't in usedBytes, leave room for it
+		free(block);
+		while (capacity < peakBytes + peakBytes / 4)
+			capacity *= 2;
+		block = (unsigned char*)malloc(capacity);
+	}
+
+	offset = 0;
+	usedBytes = 0;
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Memory for things that only live for a frame.
+//			An arena hands out memory by bumping an offset
+//			and takes all of it back at once when the frame
+//			is over, so transient collections never touch
+//			the heap once the arena has grown to fit a frame.
+
+#include <new>
+#include <type_traits>
+#include <vector>
+#include <stddef.h>
+
+// Size of an arena's first block
+#define FRAME_ARENA_DEFAULT_BYTES (256 * 1024)
+
+/// <summary>
+/// A linear allocator. When a frame needs more than the block
+/// holds, extra blocks are taken from the heap for that frame
+/// and the next Reset() swaps them all for one block big
+/// enough, so a steady frame rate of work settles into no
+/// heap traffic at all
+/// </summary>
+class FrameArena
+{
+public:
+	FrameArena(size_t bytes = FRAME_ARENA_DEFAULT_BYTES);
+	~FrameArena();
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	void* Allocate(size_t bytes, size_t alignment);
+
+	/// <summary>
+	/// Makes an object in the arena. Its destructor, if it has
+	/// one that does anything, runs on the next Reset()
+	/// </summary>
+	template<typename T, typename... Args>
+	T* New(Args&&... args)
+	{
+		void* memory = Allocate(sizeof(T), alignof(T));
+		T* object = new (memory) T(static_cast<Args&&>(args)...);
+		if (!std::is_trivially_destructible<T>::value)
+			AddDestructor(object, [](void* o) { static_cast<T*>(o)->~T(); });
+		return object;
+	}
+
+	// Uninitialized room for count objects, which are
+	// never destructed so should be plain data
+	template<typename T>
+	T* NewArray(size_t count)
+	{
+		return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+	}
+
+	// Runs pending destructors and takes back every allocation
+	void Reset();
+
+	size_t GetUsedBytes() const { return usedBytes; }
+	size_t GetCapacity() const { return capacity; }
+	size_t GetPeakBytes() const { return peakBytes; }
+
+private:
+
+	struct Destructor
+	{
+		void (*destroy)(void*);
+		void* object;
+		Destructor* next;
+	};
+
+	void AddDestructor(void* object, void (*destroy)(void*));
+
+	// The block every frame starts in, and blocks taken
+	// when a frame overflowed it
+	unsigned char* block;
+	size_t capacity;
+	size_t offset;
+	std::vector<unsigned char*> overflowBlocks;
+	size_t overflowOffset;
+	size_t overflowCapacity;
+
+	Destructor* destructors;
+	size_t usedBytes;
+	size_t peakBytes;
+};
+
+/// <summary>
+/// Two arenas used on alternate frames. Whatever was made
+/// last frame stays valid through this one, so data handed
+/// from one frame to the next needs no copy
+/// </summary>
+class FrameArenaPair
+{
+public:
+	FrameArenaPair() : current(0) {}
+
+	// Flips to the older arena and empties it
+	void BeginFrame()
+	{
+		current ^= 1;
+		arenas[current].Reset();
+	}
+
+	FrameArena& Current() { return arenas[current]; }
+	FrameArena& Previous() { return arenas[current ^ 1]; }
+
+private:
+	FrameArena arenas[2];
+	int current;
+};
+
+/// <summary>
+/// Lets standard containers live in an arena. Freeing does
+/// nothing since the arena takes everything back at once, so
+/// a container that grows leaves its old storage behind until
+/// Reset(). Reserve up front when the size is known
+/// </summary>
+template<typename T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+
+	ArenaAllocator(FrameArena& arena) : arena(&arena) {}
+
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.GetArena()) {}
+
+	T* allocate(size_t count)
+	{
+		return static_cast<T*>(arena->Allocate(sizeof(T) * count, alignof(T)));
+	}
+	void deallocate(T*, size_t) {}
+
+	FrameArena* GetArena() const { return arena; }
+
+private:
+	FrameArena* arena;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.GetArena() == b.GetArena(); }
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.GetArena() != b.GetArena(); }
+
+// A vector whose storage comes from a frame arena
+template<typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
+
+/// <summary>
+/// A view of contiguous objects owned by something else, for
+/// passing transient collections around without copying them
+/// or caring where they live
+/// </summary>
+template<typename T>
+class Span
+{
+public:
+	Span() : items(nullptr), count(0) {}
+	Span(T* items, size_t count) : items(items), count(count) {}
+
+	template<size_t N>
+	Span(T (&items)[N]) : items(items), count(N) {}
+
+	// Any vector, whatever allocates it
+	template<typename V, typename A>
+	Span(std::vector<V, A>& vector) : items(vector.data()), count(vector.size()) {}
+	template<typename V, typename A>
+	Span(const std::vector<V, A>& vector) : items(vector.data()), count(vector.size()) {}
+
+	// A span of const objects from one of mutable ones
+	template<typename U>
+	Span(const Span<U>& other) : items(other.data()), count(other.size()) {}
+
+	T* data() const { return items; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	T* begin() const { return items; }
+	T* end() const { return items + count; }
+	T& operator[](size_t index) const { return items[index]; }
+
+private:
+	T* items;
+	size_t count;
+};
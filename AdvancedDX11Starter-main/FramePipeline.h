@@ -0,0 +1,245 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Hand frames from the update thread to the render
+//			thread. Update writes a snapshot of everything
+//			the renderer needs and publishes it, the render
+//			thread picks up a published snapshot and draws
+//			it while the next frame is already simulating.
+//			Nothing in here depends on Direct3D so the
+//			hand-off can be driven headless.
+
+#include <atomic>
+
+#define FRAME_PIPELINE_MAX_SNAPSHOTS 3
+
+/// <summary>
+/// How the pipeline trades latency against throughput
+/// </summary>
+struct FramePipelineSettings
+{
+	// Render on a separate thread, otherwise every
+	// snapshot is drawn right after it is written
+	bool pipelined;
+
+	// 2 is double buffering, 3 is triple buffering
+	int snapshotCount;
+
+	// When true the render thread always draws the newest
+	// snapshot and update never waits (lowest latency).
+	// When false every snapshot is drawn in order and update
+	// waits whenever all of them are queued (most throughput)
+	bool dropStaleSnapshots;
+};
+
+/// <summary>
+/// Time spent in each stage of the last frame. Written by
+/// whichever thread runs the stage and read by the UI
+/// </summary>
+struct FrameStageTimings
+{
+	std::atomic<float> updateMS;
+	std::atomic<float> snapshotWriteMS;
+	std::atomic<float> updateWaitMS;
+	std::atomic<float> recordMS;
+	std::atomic<float> submitMS;
+	std::atomic<float> presentMS;
+	std::atomic<float> renderFrameMS;
+
+	// Frames between the newest published snapshot
+	// and the one that was last drawn
+	std::atomic<unsigned int> latencyFrames;
+
+	// Heap allocations made by the update thread, by the
+	// render thread, and by every thread over the last frame
+	std::atomic<unsigned int> updateAllocations;
+	std::atomic<unsigned int> renderAllocations;
+	std::atomic<unsigned int> frameAllocations;
+
+	FrameStageTimings() :
+		updateMS(0), snapshotWriteMS(0), updateWaitMS(0),
+		recordMS(0), submitMS(0), presentMS(0), renderFrameMS(0),
+		latencyFrames(0),
+		updateAllocations(0), renderAllocations(0), frameAllocations(0)
+	{
+	}
+};
+
+/// <summary>
+/// Single producer, single consumer ring of snapshots. Each
+/// slot's ownership moves through an atomic state so neither
+/// side ever takes a lock. Only one thread may write and only
+/// one thread may read at any time
+/// </summary>
+template<typename T>
+class SnapshotRing
+{
+public:
+
+	SnapshotRing() :
+		slotCount(FRAME_PIPELINE_MAX_SNAPSHOTS),
+		dropStale(true),
+		nextSequence(1),
+		droppedSnapshots(0)
+	{
+		for (int i = 0; i < FRAME_PIPELINE_MAX_SNAPSHOTS; i++)
+		{
+			states[i] = SLOT_FREE;
+			sequences[i] = 0;
+		}
+	}
+
+	/// <summary>
+	/// Changes the slot count and drop policy. Only safe while
+	/// neither side holds a slot, so any queued snapshots are
+	/// thrown away
+	/// </summary>
+	void Configure(int count, bool dropStaleSnapshots)
+	{
+		if (count < 2) count = 2;
+		if (count > FRAME_PIPELINE_MAX_SNAPSHOTS) count = FRAME_PIPELINE_MAX_SNAPSHOTS;
+
+		slotCount = count;
+		dropStale = dropStaleSnapshots;
+		for (int i = 0; i < FRAME_PIPELINE_MAX_SNAPSHOTS; i++)
+			states[i] = SLOT_FREE;
+	}
+
+	/// <summary>
+	/// Claims a slot to write the next snapshot into. Returns
+	/// null when every slot is queued or being read and stale
+	/// snapshots may not be dropped, the caller should retry
+	/// </summary>
+	T* BeginWrite()
+	{
+		for (int i = 0; i < slotCount; i++)
+		{
+			int expected = SLOT_FREE;
+			if (states[i].compare_exchange_strong(expected, SLOT_WRITING))
+				return &slots[i];
+		}
+
+		if (!dropStale)
+			return nullptr;
+
+		// Everything is queued so overwrite the oldest
+		// snapshot the render thread has not picked up
+		int oldest = FindReady(false);
+		if (oldest >= 0)
+		{
+			int expected = SLOT_READY;
+			if (states[oldest].compare_exchange_strong(expected, SLOT_WRITING))
+			{
+				droppedSnapshots++;
+				return &slots[oldest];
+			}
+		}
+		return nullptr;
+	}
+
+	/// <summary>
+	/// Publishes a snapshot claimed by BeginWrite and
+	/// returns its sequence number
+	/// </summary>
+	unsigned long long EndWrite(T* snapshot)
+	{
+		int i = (int)(snapshot - slots);
+		unsigned long long sequence = nextSequence.fetch_add(1);
+		sequences[i] = sequence;
+		states[i] = SLOT_READY;
+		return sequence;
+	}
+
+	/// <summary>
+	/// Claims a published snapshot to read. Depending on the
+	/// drop policy this is either the newest or the oldest
+	/// one. Returns null when nothing has been published
+	/// </summary>
+	T* BeginRead(unsigned long long* sequenceOut = nullptr)
+	{
+		while (true)
+		{
+			int i = FindReady(dropStale);
+			if (i < 0)
+				return nullptr;
+
+			int expected = SLOT_READY;
+			if (!states[i].compare_exchange_strong(expected, SLOT_READING))
+				continue;
+
+			if (sequenceOut)
+				*sequenceOut = sequences[i];
+
+			// Anything older than the newest is never drawn
+			if (dropStale)
+			{
+				for (int j = 0; j < slotCount; j++)
+				{
+					int ready = SLOT_READY;
+					if (sequences[j] < sequences[i] &&
+						states[j].compare_exchange_strong(ready, SLOT_FREE))
+						droppedSnapshots++;
+				}
+			}
+
+			return &slots[i];
+		}
+	}
+
+	/// <summary>
+	/// Hands a snapshot claimed by BeginRead back to the writer
+	/// </summary>
+	void EndRead(T* snapshot)
+	{
+		states[snapshot - slots] = SLOT_FREE;
+	}
+
+	int GetSlotCount() { return slotCount; }
+	bool GetDropsStale() { return dropStale; }
+	unsigned long long GetDroppedCount() { return droppedSnapshots; }
+	unsigned long long GetPublishedCount() { return nextSequence - 1; }
+
+private:
+
+	enum SlotState
+	{
+		SLOT_FREE		= 0,
+		SLOT_WRITING	= 1,
+		SLOT_READY		= 2,
+		SLOT_READING	= 3
+	};
+
+	/// <summary>
+	/// Finds the ready slot with the newest or oldest sequence
+	/// </summary>
+	int FindReady(bool newest)
+	{
+		int found = -1;
+		unsigned long long foundSequence = 0;
+		for (int i = 0; i < slotCount; i++)
+		{
+			if (states[i] != SLOT_READY)
+				continue;
+
+			unsigned long long s = sequences[i];
+			if (found < 0 || (newest ? s > foundSequence : s < foundSequence))
+			{
+				found = i;
+				foundSequence = s;
+			}
+		}
+		return found;
+	}
+
+	T slots[FRAME_PIPELINE_MAX_SNAPSHOTS];
+	std::atomic<int> states[FRAME_PIPELINE_MAX_SNAPSHOTS];
+	std::atomic<unsigned long long> sequences[FRAME_PIPELINE_MAX_SNAPSHOTS];
+
+	int slotCount;
+	bool dropStale;
+
+	// Only advanced by the writer
+	std::atomic<unsigned long long> nextSequence;
+
+	std::atomic<unsigned long long> droppedSnapshots;
+};
@@ -1,11 +1,14 @@
 
 #include <stdlib.h>     // For seeding random and rand()
 #include <time.h>       // For grabbing time (to seed random)
+#include <chrono>       // For timing command recording
+#include <fstream>
 
 #include "Game.h"
 #include "Vertex.h"
 #include "Input.h"
 #include "Helpers.h"
+#include "AllocationCounter.h"
 
 #include "WICTextureLoader.h"
 #include "ImGui/imgui.h"
@@ -49,11 +52,82 @@ Game::Game(HINSTANCE hInstance)
 	lightCount(0),
 	showUIDemoWindow(false),
 	showPointLights(false),
-	updateMouseDelta(true)
+	updateMouseDelta(true),
+	multithreadedRendering(true),
+	recordingJobCount(0),
+	recordDeferred(true),
+	clusteredLighting(false),
+	clusterIndexCount(0),
+	clusterOverflowCount(0),
+	textureBudgetMB(64),
+	shadowMapUICascade(0),
+	shadowCacheEnabled(true),
+	staticBatching(true),
+	sceneDrawCount(0),
+	unbatchedDrawCount(0),
+	showCascadeBounds(false),
+	showLightRanges(false),
+	debugLineStress(false),
+	showCameraTrail(false),
+	labelEntities(false),
+	labelLights(false),
+	debugGlyphCount(0),
+	debugTextBuildMS(0),
+	debugLineCount(0),
+	debugLineUploadMS(0),
+	renderThreadRunning(false),
+	lastFrameAllocationCount(0),
+	projectileCooldown(0),
+	swingCooldown(0),
+	lastWandHitSomething(false),
+	lastSwingHits(0)
 {
 	// Seed random
 	srand((unsigned int)time(0));
 
+	// Simulate the next frame while the last one renders,
+	// always drawing the newest snapshot
+	pipelineSettings.pipelined = true;
+	pipelineSettings.snapshotCount = 3;
+	pipelineSettings.dropStaleSnapshots = true;
+	appliedPipelineSettings = pipelineSettings;
+
+	clusterParams = {};
+	clusterBenchmark = {};
+	debugLineBenchmark = {};
+	debugLifetimeBenchmark = {};
+	debugTextBenchmark = {};
+	textureStreamingSim = {};
+	navBenchmark = {};
+	crowdBenchmark = {};
+	dungeonBenchmark = {};
+	batchBenchmark = {};
+	entityBenchmark = {};
+	spawnBenchmark = {};
+	collisionBenchmark = {};
+	queryBenchmark = {};
+	netBenchmark = {};
+	predictionBenchmark = {};
+	lastWandHit = {};
+
+	// Four cascades over the first 60 units in front of
+	// the camera, mostly logarithmic so the closest
+	// cascades get the most detail
+	cascadeSettings.count = SHADOW_CASCADE_MAX_COUNT;
+	cascadeSettings.splitLambda = 0.75f;
+	cascadeSettings.shadowDistance = 60.0f;
+	cascadeSettings.resolution = SHADOW_MAP_RESOLUTION;
+	cascadeSettings.casterDistance = 50.0f;
+	cascadeSettings.snapTexels = 1;
+	for (int i = 0; i < SHADOW_CASCADE_MAX_COUNT; i++)
+	{
+		shadowCaches[i] = {};
+		cascadeDrawCounts[i] = 0;
+		cascadeUncachedDrawCounts[i] = 0;
+		cascadeCacheHits[i] = false;
+		cascadeRecordMS[i] = 0;
+	}
+
 	playersData = std::make_shared<PlayersData>();
 
 
@@ -78,6 +152,13 @@ Game::~Game()
 	// - If we weren't using smart pointers, we'd need
 	//   to call Release() on each DirectX object
 
+	// Nothing may still be drawing when things start
+	// being destroyed
+	StopRenderThread();
+
+	// Workers may still be decoding
+	streamedTextures.reset();
+
 	// ImGui clean up
 	ImGui_ImplDX11_Shutdown();
 	ImGui_ImplWin32_Shutdown();
@@ -100,6 +181,16 @@ void Game::Init()
 	// Add Debug Drawer 
 	debugDrawData = DebugDrawData(context, device);
 
+	// Texture streaming has to exist before any material loads
+	streamedTextures = std::make_unique<StreamedTextures>(device, TEXTURE_STREAM_WORKERS);
+	streamedTextures->SetBudget((size_t)textureBudgetMB * 1024 * 1024);
+
+	// Update's workers have to exist before the level is
+	// loaded, since the path queue is split across them
+	unsigned int simulationWorkers = std::thread::hardware_concurrency();
+	simulationWorkers = simulationWorkers > 1 ? simulationWorkers - 1 : 1;
+	simulationJobs = std::make_unique<RenderJobGraph>(simulationWorkers);
+
 	// Asset loading and entity creation
 	LoadAssetsAndCreateEntities();
 	
@@ -111,10 +202,18 @@ void Game::Init()
 	// Set up lights initially
 	lightCount = 64;
 	GenerateLights();
-	OnWorldLightChange();
 
 	// Set up shadow map resources 
 	GenerateShadowData();
+	CreateLightClusterBuffers();
+
+	// Recording workers, leaving a core for the main thread and
+	// never handing out more slots than SimpleShader can stage
+	unsigned int workerCount = std::thread::hardware_concurrency();
+	workerCount = workerCount > 1 ? workerCount - 1 : 1;
+	if (workerCount > SIMPLESHADER_MAX_RECORDING_SLOTS - 1)
+		workerCount = SIMPLESHADER_MAX_RECORDING_SLOTS - 1;
+	renderJobs = std::make_unique<RenderJobGraph>(workerCount);
 
 	// Set initial graphics API state
 	//  - These settings persist until we change them
@@ -130,59 +229,384 @@ void Game::Init()
 	// Set initial player data 
 	AddPlayer(playersData.get(), "Eureka", (float)windowWidth / (float)windowHeight);
 	playersData->transforms[0].SetPosition(0.0f, 0.0f, -10.0f);
+
+	// Start the frame pipeline last, once everything
+	// the render thread reads exists
+	ApplyPipelineSettings();
 }
 
 /// <summary>
 /// Stores a vertex shader into the game 
 /// </summary>
 /// <param name="name"></param>
-void Game::AddVS(const wchar_t* name, VertexShaders linkedEnum)
+void Game::AddVS(const wchar_t* name)
 {
-	std::shared_ptr<SimpleVertexShader> vertexShader = 
-		LoadShader(SimpleVertexShader, name);
-	
-	nameToVS.insert(std::pair<const wchar_t*, std::shared_ptr<SimpleVertexShader>>(
-		name, vertexShader));
+	assets.AddVertexShader(name, LoadShader(SimpleVertexShader, name));
 }
 
 /// <summary>
 /// Stores a pixel shader into the game 
 /// </summary>
 /// <param name="name"></param>
-void Game::AddPS(const wchar_t* name, PixelShaders linkedEnum)
+void Game::AddPS(const wchar_t* name)
 {
-	std::shared_ptr<SimplePixelShader> pixelShader =
-		LoadShader(SimplePixelShader, name);
+	assets.AddPixelShader(name, LoadShader(SimplePixelShader, name));
+}
 
-	nameToPS.insert(std::pair<const wchar_t*, std::shared_ptr<SimplePixelShader>>(
-		name, pixelShader));
+/// <summary>
+/// Loads a model from the Models folder into the game 
+/// </summary>
+/// <param name="name"></param>
+void Game::AddMesh(const wchar_t* name)
+{
+	std::wstring path = FixPath(std::wstring(L"../../Assets/Models/") + name);
+	assets.AddMesh(name, std::make_shared<Mesh>(path.c_str(), device));
+}
 
-	if (psNameToID.find(name) == psNameToID.end())
+/// <summary>
+/// Describes a renderable entity at the origin made from
+/// registered assets, holding a reference to both for as
+/// long as the game runs. The mask is left 0 when either
+/// asset isn't loaded, for callers to skip the entity
+/// </summary>
+EntityDesc Game::DescribeEntity(
+	AssetID mesh,
+	AssetID material,
+	bool castsShadows,
+	EntityMobility mobility)
+{
+	EntityDesc desc = {};
+	desc.mask = COMPONENTS_RENDERABLE;
+	desc.transform = DefaultTransform();
+
+	const std::shared_ptr<Mesh>& m = assets.meshes.Get(mesh);
+	const std::shared_ptr<RendMat>& mat = assets.materials.Get(material);
+	if (!m || !mat)
 	{
-		// Add new shader combination 
-		psNameToID.insert(
-			std::pair<const wchar_t*, PixelShaders>
-			(name, linkedEnum));
+		printf("Entity skipped: %s \"%s\" isn't loaded\n",
+			m ? "material" : "mesh",
+			assets.GetName(m ? material : mesh).c_str());
+		desc.mask = 0;
+		return desc;
 	}
-	else
+
+	desc.render.mesh = assets.meshes.Acquire(mesh);
+	desc.render.material = assets.materials.Acquire(material);
+	desc.render.vs = mat->vs;
+	desc.render.ps = mat->ps;
+	desc.render.castsShadows = castsShadows;
+
+	XMFLOAT3 center = m->GetBoundsCenter();
+	memcpy(desc.bounds.localCenter, &center, sizeof(desc.bounds.localCenter));
+	desc.bounds.localRadius = m->GetBoundsRadius();
+
+	// Static entities are hit through the level's triangles
+	desc.mobility.mobility = mobility;
+	desc.bounds.queryLayers = mobility == EntityMobility::Static ? 0 : ENTITY_LAYER_DEFAULT;
+	return desc;
+}
+
+/// <summary>
+/// Creates an entity from registered assets. It joins the
+/// scene at the next ApplyChanges()
+/// </summary>
+EntityId Game::MakeEntity(
+	AssetID mesh,
+	AssetID material,
+	XMFLOAT3 position,
+	XMFLOAT3 pitchYawRoll,
+	float scale,
+	bool castsShadows,
+	EntityMobility mobility)
+{
+	EntityDesc desc = DescribeEntity(mesh, material, castsShadows, mobility);
+	if (desc.mask == 0)
+		return EntityId();
+
+	memcpy(desc.transform.position, &position, sizeof(desc.transform.position));
+	memcpy(desc.transform.pitchYawRoll, &pitchYawRoll, sizeof(desc.transform.pitchYawRoll));
+	desc.transform.scale[0] = scale;
+	desc.transform.scale[1] = scale;
+	desc.transform.scale[2] = scale;
+	return scene.Create(desc);
+}
+
+/// <summary>
+/// Gathers the triangles of every static entity into the
+/// level's collision. Meshes keep no copy of their vertices
+/// once they're on the GPU, so each model is read again from
+/// its .obj, once per model however many entities use it.
+/// Generated meshes hand over the triangles they were made of
+/// </summary>
+void Game::BuildLevelCollision()
+{
+	levelCollision.Clear();
+
+	std::map<unsigned int, std::vector<float>> soups;
+	scene.ForEachChunk(COMPONENTS_RENDERABLE, [&](EntityChunk& chunk)
+	{
+		TransformComponent* transforms = chunk.Get<TransformComponent>();
+		RenderComponent* renders = chunk.Get<RenderComponent>();
+		MobilityComponent* mobility = chunk.Get<MobilityComponent>();
+		for (unsigned int i = 0; i < chunk.count; i++)
+		{
+			if (mobility[i].mobility != EntityMobility::Static)
+				continue;
+
+			MeshHandle mesh = renders[i].mesh;
+			auto generated = generatedCollision.find(mesh.index);
+			if (generated != generatedCollision.end())
+			{
+				Span<const float> triangles = generated->second;
+				levelCollision.AddTriangles(triangles.data(), triangles.size() / 9, transforms[i].world, chunk.ids[i]);
+				continue;
+			}
+
+			auto soup = soups.find(mesh.index);
+			if (soup == soups.end())
+			{
+				const std::string& name = assets.GetName(assets.meshes.GetSlots()[mesh.index].id);
+				std::ifstream obj(FixPath(L"../../Assets/Models/" + std::wstring(name.begin(), name.end())));
+				soup = soups.insert(std::make_pair(mesh.index, std::vector<float>())).first;
+				LoadCollisionOBJ(obj, soup->second);
+			}
+
+			levelCollision.AddTriangles(soup->second.data(), soup->second.size() / 9, transforms[i].world, chunk.ids[i]);
+		}
+	});
+
+	levelCollision.Build();
+}
+
+/// <summary>
+/// Lays out the dungeon beside the walls, builds its chunks
+/// across the simulation workers and makes a static entity of
+/// each. Chunks are already in world space
+/// </summary>
+void Game::GenerateDungeon()
+{
+	DungeonSettings settings = DefaultDungeonSettings();
+	settings.origin[0] = 60.0f;
+	settings.origin[1] = -1.0f;
+	settings.origin[2] = -26.0f;
+	dungeon.Generate(settings);
+
+	simulationJobs->Reset();
+	dungeon.AddJobs(simulationJobs.get(), simulationJobs->GetWorkerCount() + 1);
+	simulationJobs->Run(true);
+
+	std::vector<Vertex> vertices;
+	for (unsigned int c = 0; c < dungeon.GetChunkCount(); c++)
+	{
+		const DungeonChunk& chunk = dungeon.GetChunk(c);
+		if (chunk.indices.empty())
+			continue;
+
+		// The mesh works out the tangents
+		vertices.assign(chunk.vertices.size(), Vertex());
+		for (size_t v = 0; v < vertices.size(); v++)
+		{
+			memcpy(&vertices[v].Position, chunk.vertices[v].position, sizeof(vertices[v].Position));
+			memcpy(&vertices[v].UV, chunk.vertices[v].uv, sizeof(vertices[v].UV));
+			memcpy(&vertices[v].Normal, chunk.vertices[v].normal, sizeof(vertices[v].Normal));
+		}
+
+		std::wstring name = L"@dungeon" + std::to_wstring(c);
+		MeshHandle mesh = assets.AddMesh(name, std::make_shared<Mesh>(
+			vertices.data(), vertices.size(),
+			const_cast<unsigned int*>(chunk.indices.data()), chunk.indices.size(),
+			device));
+		generatedCollision[mesh.index] = Span<const float>(chunk.collision.data(), chunk.collision.size());
+
+		MakeEntity(assets.Intern(name), ASSET_ID("Cobble2x"), XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 0), 1.0f);
+	}
+
+	// Pillars holding up the corners of the bigger rooms
+	EntityDesc pillar = DescribeEntity(ASSET_ID("cube.obj"), ASSET_ID("SolidCommon"), true, EntityMobility::Static);
+	pillar.transform.scale[0] = 0.6f;
+	pillar.transform.scale[1] = settings.wallHeight;
+	pillar.transform.scale[2] = 0.6f;
+	if (pillar.mask == 0)
+		return;
+
+	for (unsigned int r = 0; r < dungeon.GetRoomCount(); r++)
+	{
+		const DungeonRoom& room = dungeon.GetRoom(r);
+		if (room.width < 5 || room.depth < 5)
+			continue;
+
+		for (int corner = 0; corner < 4; corner++)
+		{
+			unsigned int x = room.x + (corner & 1 ? room.width - 1 : 0);
+			unsigned int z = room.z + (corner & 2 ? room.depth - 1 : 0);
+			dungeon.GetTileCenter(x, z, pillar.transform.position);
+			pillar.transform.position[1] += settings.wallHeight * 0.5f;
+			scene.Create(pillar);
+		}
+	}
+}
+
+/// <summary>
+/// Merges static entities sharing a material, shaders and
+/// shadow casting into a batch a chunk of the world. Models
+/// are read again from their .obj, as for collision, while
+/// generated meshes are left alone, being made merged already
+/// </summary>
+void Game::BuildStaticBatches()
+{
+	static_assert(sizeof(Vertex) == BATCH_VERTEX_FLOATS * sizeof(float), "Batches are merged from the engine's vertices");
+
+	std::map<unsigned int, unsigned int> meshSources;	// BATCH_NONE for models that didn't load
+	std::vector<std::vector<Vertex>> sourceVertices;
+	std::vector<std::vector<unsigned int>> sourceIndices;
+	std::vector<RenderComponent> looks;					// What each key draws with
+	std::vector<BatchInstance> instances;
+	std::vector<EntityId> instanceEntities;
+
+	scene.ForEachChunk(COMPONENTS_RENDERABLE, [&](EntityChunk& chunk)
+	{
+		TransformComponent* transforms = chunk.Get<TransformComponent>();
+		RenderComponent* renders = chunk.Get<RenderComponent>();
+		MobilityComponent* mobility = chunk.Get<MobilityComponent>();
+		for (unsigned int i = 0; i < chunk.count; i++)
+		{
+			const RenderComponent& render = renders[i];
+			if (mobility[i].mobility != EntityMobility::Static || generatedCollision.count(render.mesh.index) > 0)
+				continue;
+
+			auto source = meshSources.find(render.mesh.index);
+			if (source == meshSources.end())
+			{
+				const std::string& name = assets.GetName(assets.meshes.GetSlots()[render.mesh.index].id);
+				std::vector<Vertex> vertices;
+				std::vector<unsigned int> indices;
+				unsigned int index = BATCH_NONE;
+				if (Mesh::LoadOBJ(FixPath(L"../../Assets/Models/" + std::wstring(name.begin(), name.end())), vertices, indices))
+				{
+					index = (unsigned int)sourceVertices.size();
+					sourceVertices.push_back(std::move(vertices));
+					sourceIndices.push_back(std::move(indices));
+				}
+				source = meshSources.insert(std::make_pair(render.mesh.index, index)).first;
+			}
+			if (source->second == BATCH_NONE)
+				continue;
+
+			unsigned int key = 0;
+			while (key < looks.size() && !(
+				looks[key].material == render.material &&
+				looks[key].vs == render.vs &&
+				looks[key].ps == render.ps &&
+				looks[key].castsShadows == render.castsShadows))
+				key++;
+			if (key == looks.size())
+				looks.push_back(render);
+
+			BatchInstance instance;
+			instance.source = source->second;
+			instance.key = key;
+			memcpy(instance.world, transforms[i].world, sizeof(instance.world));
+			memcpy(instance.worldInvTrans, transforms[i].worldInvTrans, sizeof(instance.worldInvTrans));
+			instances.push_back(instance);
+			instanceEntities.push_back(chunk.ids[i]);
+		}
+	});
+
+	std::vector<BatchSource> sources(sourceVertices.size());
+	for (size_t s = 0; s < sources.size(); s++)
+	{
+		sources[s].vertices = Span<const float>((const float*)sourceVertices[s].data(), sourceVertices[s].size() * BATCH_VERTEX_FLOATS);
+		sources[s].indices = Span<const unsigned int>(sourceIndices[s]);
+	}
+	staticBatches.Build(Span<const BatchSource>(sources), Span<const BatchInstance>(instances), DefaultStaticBatchSettings());
+
+	// A mesh for every batch, kept alive by the game since no
+	// entity refers to it. Tangents are worked out again over
+	// the merged vertices
+	staticDrawBatches.clear();
+	std::vector<Vertex> vertices;
+	for (unsigned int b = 0; b < staticBatches.GetBatchCount(); b++)
 	{
-		// Replace 
-		psNameToID[name] = linkedEnum;
+		const StaticBatch& batch = staticBatches.GetBatch(b);
+		vertices.resize(batch.vertices.size() / BATCH_VERTEX_FLOATS);
+		memcpy(vertices.data(), batch.vertices.data(), batch.vertices.size() * sizeof(float));
+
+		MeshHandle mesh = assets.AddMesh(L"@batch" + std::to_wstring(b), std::make_shared<Mesh>(
+			vertices.data(), vertices.size(),
+			const_cast<unsigned int*>(batch.indices.data()), batch.indices.size(),
+			device));
+		assets.meshes.AddRef(mesh);
+
+		const RenderComponent& look = looks[batch.key];
+		StaticDrawBatch draw = {};
+		draw.ps = look.ps;
+		draw.entity.mesh = mesh;
+		draw.entity.material = look.material;
+		draw.entity.vs = look.vs;
+		XMStoreFloat4x4(&draw.entity.world, XMMatrixIdentity());
+		XMStoreFloat4x4(&draw.entity.worldInvTrans, XMMatrixIdentity());
+		draw.entity.castsShadows = look.castsShadows;
+		draw.entity.isStatic = true;
+		memcpy(&draw.entity.boundsCenter, batch.boundsCenter, sizeof(draw.entity.boundsCenter));
+		draw.entity.boundsRadius = batch.boundsRadius;
+		staticDrawBatches.push_back(draw);
+	}
+
+	for (unsigned int i = 0; i < staticBatches.GetInstanceCount(); i++)
+	{
+		if (staticBatches.GetInstanceBatch(i) != BATCH_NONE)
+			scene.Get<RenderComponent>(instanceEntities[i])->batched = true;
 	}
 }
 
 /// <summary>
-/// Adds a material into the game 
+/// Builds the navigation mesh over the level's collision,
+/// so it sees the same static entities, a path queue with a
+/// slice per simulation worker searching it, and keeps the
+/// crowd on it
 /// </summary>
-/// <param name="mat"></param>
-/// <param name="matName"></param>
-void Game::AddMat(
-	std::shared_ptr<RendMat> mat,
-	const wchar_t* matName)
+void Game::BuildNavigation()
 {
-	nameToMat.insert(
-		std::pair<const wchar_t*, std::shared_ptr<RendMat>>(
-		matName, mat));
+	navMesh.Build(levelCollision.GetTriangles(), levelCollision.GetTriangleCount(), DefaultNavBuildSettings());
+	pathQueue = std::make_unique<NavPathQueue>(&navMesh, simulationJobs->GetWorkerCount() + 1);
+	crowd.SetNavMesh(&navMesh);
+}
+
+/// <summary>
+/// Rebuilds the matrices of every entity whose transform
+/// changed, and moves its bounds along with it
+/// </summary>
+void Game::UpdateEntityTransforms()
+{
+	scene.ForEachChunk(
+		COMPONENT_BIT(TransformComponent) | COMPONENT_BIT(BoundsComponent),
+		[](EntityChunk& chunk)
+	{
+		TransformComponent* transforms = chunk.Get<TransformComponent>();
+		BoundsComponent* bounds = chunk.Get<BoundsComponent>();
+		for (unsigned int i = 0; i < chunk.count; i++)
+		{
+			TransformComponent& t = transforms[i];
+			if (!t.dirty)
+				continue;
+			t.dirty = false;
+
+			XMMATRIX world =
+				XMMatrixScaling(t.scale[0], t.scale[1], t.scale[2]) *
+				XMMatrixRotationRollPitchYaw(t.pitchYawRoll[0], t.pitchYawRoll[1], t.pitchYawRoll[2]) *
+				XMMatrixTranslation(t.position[0], t.position[1], t.position[2]);
+			XMStoreFloat4x4((XMFLOAT4X4*)t.world, world);
+			XMStoreFloat4x4((XMFLOAT4X4*)t.worldInvTrans, XMMatrixInverse(0, XMMatrixTranspose(world)));
+
+			// Bounds follow the world matrix, with the radius
+			// grown by the largest scale
+			BoundsComponent& b = bounds[i];
+			XMVECTOR center = XMVector3Transform(XMLoadFloat3((XMFLOAT3*)b.localCenter), world);
+			XMStoreFloat3((XMFLOAT3*)b.center, center);
+			float scale = (std::max)(fabsf(t.scale[0]), (std::max)(fabsf(t.scale[1]), fabsf(t.scale[2])));
+			b.radius = b.localRadius * scale;
+		}
+	});
 }
 
 // --------------------------------------------------------
@@ -190,89 +614,30 @@ void Game::AddMat(
 // --------------------------------------------------------
 void Game::LoadAssetsAndCreateEntities()
 {
-	psNameToID = std::unordered_map<const wchar_t*, PixelShaders>();
-	vsNameToID = std::unordered_map<const wchar_t*, VertexShaders>();
-
 	// Load active shaders 
-	AddVS(	L"VertexShader.cso",		VERTEX_SHADER		);
-	AddVS(	L"ShadowVertex.cso",		SHADOW_VERTEX		);
-	AddPS(	L"PixelCommon.cso",			COMMON				);
-	AddPS(	L"SolidColorPS.cso",		SOLID_COLOR			);
-	AddPS(	L"PixelTriplanar.cso",		TRIPLANAR			);
-	AddPS(	L"TriplanarShadows.cso",	TRIPLANAR_SHADOWS	);
+	AddVS(	L"VertexShader.cso"		);
+	AddVS(	L"ShadowVertex.cso"		);
+	AddPS(	L"PixelCommon.cso"		);
+	AddPS(	L"SolidColorPS.cso"		);
+	AddPS(	L"PixelTriplanar.cso"	);
+	AddPS(	L"TriplanarShadows.cso"	);
 
 	// Shaders only needed here 
 	std::shared_ptr<SimpleVertexShader> skyVS = LoadShader(SimpleVertexShader, L"SkyVS.cso");
 	std::shared_ptr<SimplePixelShader> skyPS  = LoadShader(SimplePixelShader, L"SkyPS.cso");
 
 	// Make the meshes
-	std::shared_ptr<Mesh> sphereMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/sphere.obj").c_str(), device);
-	std::shared_ptr<Mesh> helixMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/helix.obj").c_str(), device);
-	std::shared_ptr<Mesh> cubeMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/cube.obj").c_str(), device);
-	std::shared_ptr<Mesh> coneMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/cone.obj").c_str(), device);
-	std::shared_ptr<Mesh> planeMesh = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/plane.obj").c_str(), device);
-	std::shared_ptr<Mesh> sampleLevel = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/SampleLevel.obj").c_str(), device);
-	std::shared_ptr<Mesh> skelly = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/Skelly.obj").c_str(), device);
-	
-	// Declare the textures we'll need
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobbleA,  cobbleN,  cobbleR,  cobbleM;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorA,  floorN,  floorR,  floorM;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> paintA,  paintN,  paintR,  paintM;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedA,  scratchedN,  scratchedR,  scratchedM;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bronzeA,  bronzeN,  bronzeR,  bronzeM;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughA,  roughN,  roughR,  roughM;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodA,  woodN,  woodR,  woodM;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> heronA, heronN, heronR, heronM;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> wandA, wandN, wandR, wandM;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> triFront, triSide, triTop;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> noise;
-
-	// Load the textures using our succinct LoadTexture() macro
-	LoadTexture(L"../../Assets/Textures/cobblestone_albedo.png", cobbleA);
-	LoadTexture(L"../../Assets/Textures/cobblestone_normals.png", cobbleN);
-	LoadTexture(L"../../Assets/Textures/cobblestone_roughness.png", cobbleR);
-	LoadTexture(L"../../Assets/Textures/cobblestone_metal.png", cobbleM);
-
-	LoadTexture(L"../../Assets/Textures/floor_albedo.png", floorA);
-	LoadTexture(L"../../Assets/Textures/floor_normals.png", floorN);
-	LoadTexture(L"../../Assets/Textures/floor_roughness.png", floorR);
-	LoadTexture(L"../../Assets/Textures/floor_metal.png", floorM);
-	
-	LoadTexture(L"../../Assets/Textures/paint_albedo.png", paintA);
-	LoadTexture(L"../../Assets/Textures/paint_normals.png", paintN);
-	LoadTexture(L"../../Assets/Textures/paint_roughness.png", paintR);
-	LoadTexture(L"../../Assets/Textures/paint_metal.png", paintM);
-	
-	LoadTexture(L"../../Assets/Textures/scratched_albedo.png", scratchedA);
-	LoadTexture(L"../../Assets/Textures/scratched_normals.png", scratchedN);
-	LoadTexture(L"../../Assets/Textures/scratched_roughness.png", scratchedR);
-	LoadTexture(L"../../Assets/Textures/scratched_metal.png", scratchedM);
-	
-	LoadTexture(L"../../Assets/Textures/bronze_albedo.png", bronzeA);
-	LoadTexture(L"../../Assets/Textures/bronze_normals.png", bronzeN);
-	LoadTexture(L"../../Assets/Textures/bronze_roughness.png", bronzeR);
-	LoadTexture(L"../../Assets/Textures/bronze_metal.png", bronzeM);
-	
-	LoadTexture(L"../../Assets/Textures/rough_albedo.png", roughA);
-	LoadTexture(L"../../Assets/Textures/rough_normals.png", roughN);
-	LoadTexture(L"../../Assets/Textures/rough_roughness.png", roughR);
-	LoadTexture(L"../../Assets/Textures/rough_metal.png", roughM);
+	AddMesh(	L"sphere.obj"		);
+	AddMesh(	L"helix.obj"		);
+	AddMesh(	L"cube.obj"			);
+	AddMesh(	L"cone.obj"			);
+	AddMesh(	L"plane.obj"		);
+	AddMesh(	L"SampleLevel.obj"	);
+	AddMesh(	L"Skelly.obj"		);
 	
-	LoadTexture(L"../../Assets/Textures/wood_albedo.png", woodA);
-	LoadTexture(L"../../Assets/Textures/wood_normals.png", woodN);
-	LoadTexture(L"../../Assets/Textures/wood_roughness.png", woodR);
-	LoadTexture(L"../../Assets/Textures/wood_metal.png", woodM);
-
-	LoadTexture(L"../../Assets/Textures/HeronScissors.png", heronA);
-	LoadTexture(L"../../Assets/Textures/Crowbar_Temp.png", wandA);
-
+	// Textures the engine uses directly. Material textures
+	// are loaded along with the material files below
 	LoadTexture(L"../../Assets/Textures/noise.png", shadowTextureSRV);
-	
-	LoadTexture(L"../../Assets/Textures/test/uv1.png", triFront);
-	LoadTexture(L"../../Assets/Textures/test/uv1.png", triSide);
-	LoadTexture(L"../../Assets/Textures/test/uv1.png", triTop);
-	LoadTexture(L"../../Assets/Textures/rainbowDither.png", noise);
-
 
 
 	// Describe and create our sampler state
@@ -294,218 +659,113 @@ void Game::LoadAssetsAndCreateEntities()
 		FixPath(L"..\\..\\Assets\\Skies\\Clouds Blue\\down.png").c_str(),
 		FixPath(L"..\\..\\Assets\\Skies\\Clouds Blue\\front.png").c_str(),
 		FixPath(L"..\\..\\Assets\\Skies\\Clouds Blue\\back.png").c_str(),
-		cubeMesh,
+		assets.meshes.Get(assets.meshes.Acquire(ASSET_ID("cube.obj"))),
 		skyVS,
 		skyPS,
 		samplerOptions,
 		device,
 		context);
 
-	// Solid Mat 
-	std::shared_ptr<Material> solidMat = std::make_shared<Material>( XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
-
-
-	// Create non-PBR materials
-	std::shared_ptr<RendMat> cobble2xRendMat = 
-		std::make_shared<RendMat>(
-			XMFLOAT3(1, 1, 1),
-			XMFLOAT2(0, 0),
-			XMFLOAT2(2, 2),
-			L"VertexShader.cso",
-			L"PixelCommon.cso"
-		);
-	AddSampler(cobble2xRendMat, "BasicSampler", samplerOptions);
-	AddTextureSRV(cobble2xRendMat, "Albedo", cobbleA);
-	AddTextureSRV(cobble2xRendMat, "NormalMap", cobbleN);
-	AddTextureSRV(cobble2xRendMat, "RoughnessMap", cobbleR);
-	AddTextureSRV(cobble2xRendMat, "Lightbox", sky->GetSkySRV());
-
-
-	std::shared_ptr<RendMat> paintRendMat =
-		std::make_shared<RendMat>(
-			XMFLOAT3(1, 1, 1),
-			XMFLOAT2(0, 0),
-			XMFLOAT2(2, 2),
-			L"VertexShader.cso",
-			L"PixelCommon.cso"
-		);
-	AddSampler(paintRendMat, "BasicSampler", samplerOptions);
-	AddTextureSRV(paintRendMat, "Albedo", paintA);
-	AddTextureSRV(paintRendMat, "NormalMap", paintN);
-	AddTextureSRV(paintRendMat, "RoughnessMap", paintR);
-	AddTextureSRV(paintRendMat, "Lightbox", sky->GetSkySRV());
-
-	std::shared_ptr<RendMat> bronzeRendMat =
-		std::make_shared<RendMat>(
-			XMFLOAT3(1, 1, 1),
-			XMFLOAT2(0, 0),
-			XMFLOAT2(2, 2),
-			L"VertexShader.cso",
-			L"PixelCommon.cso"
-		);
-	AddSampler(bronzeRendMat, "BasicSampler", samplerOptions);
-	AddTextureSRV(bronzeRendMat, "Albedo", bronzeA);
-	AddTextureSRV(bronzeRendMat, "NormalMap", bronzeN);
-	AddTextureSRV(bronzeRendMat, "RoughnessMap", bronzeR);
-	AddTextureSRV(bronzeRendMat, "Lightbox", sky->GetSkySRV());
-
-	std::shared_ptr<RendMat> roughRendMat =
-		std::make_shared<RendMat>(
-			XMFLOAT3(1, 1, 1),
-			XMFLOAT2(0, 0),
-			XMFLOAT2(2, 2),
-			L"VertexShader.cso",
-			L"PixelCommon.cso"
-		);
-	AddSampler(roughRendMat, "BasicSampler", samplerOptions);
-	AddTextureSRV(roughRendMat, "Albedo", roughA);
-	AddTextureSRV(roughRendMat, "NormalMap", roughN);
-	AddTextureSRV(roughRendMat, "RoughnessMap", roughR);
-	AddTextureSRV(roughRendMat, "Lightbox", sky->GetSkySRV());
-
-	std::shared_ptr<RendMat> woodRendMat =
-		std::make_shared<RendMat>(
-			XMFLOAT3(1, 1, 1),
-			XMFLOAT2(0, 0),
-			XMFLOAT2(2, 2),
-			L"VertexShader.cso",
-			L"PixelCommon.cso"
-		);
-	AddSampler(woodRendMat, "BasicSampler", samplerOptions);
-	AddTextureSRV(woodRendMat, "Albedo", woodA);
-	AddTextureSRV(woodRendMat, "NormalMap", woodN);
-	AddTextureSRV(woodRendMat, "RoughnessMap", woodR);
-	AddTextureSRV(woodRendMat, "Lightbox", sky->GetSkySRV());
-
-	std::shared_ptr<RendMat> heronRendMat =
-		std::make_shared<RendMat>(
-			XMFLOAT3(1, 1, 1),
-			XMFLOAT2(0, 0),
-			XMFLOAT2(1, 1),
-			L"VertexShader.cso",
-			L"PixelCommon.cso"
-		);
-	AddSampler(heronRendMat, "BasicSampler", samplerOptions);
-	AddTextureSRV(heronRendMat, "Albedo", heronA);
-	AddTextureSRV(heronRendMat, "NormalMap", woodN);
-	AddTextureSRV(heronRendMat, "RoughnessMap", woodR);
-	AddTextureSRV(heronRendMat, "Lightbox", sky->GetSkySRV());
-
-	std::shared_ptr<RendMat> wandRendMat =
-		std::make_shared<RendMat>(
-			XMFLOAT3(1, 1, 1),
-			XMFLOAT2(0, 0),
-			XMFLOAT2(1, 1),
-			L"VertexShader.cso",
-			L"PixelCommon.cso"
-		);
-	AddSampler(wandRendMat, "BasicSampler", samplerOptions);
-	AddTextureSRV(wandRendMat, "Albedo", wandA);
-	AddTextureSRV(wandRendMat, "NormalMap", woodN);
-	AddTextureSRV(wandRendMat, "RoughnessMap", woodR);
-	AddTextureSRV(wandRendMat, "Lightbox", sky->GetSkySRV());
-
-	std::shared_ptr<RendMat> solidCommon =
-		std::make_shared<RendMat>(
-			XMFLOAT3(1, 1, 1),
-			XMFLOAT2(0, 0),
-			XMFLOAT2(1, 1),
-			L"VertexShader.cso",
-			L"PixelCommon.cso"
-		);
-	AddSampler(solidCommon, "BasicSampler", samplerOptions);
-	AddTextureSRV(solidCommon, "Albedo", scratchedA);
-	AddTextureSRV(solidCommon, "NormalMap", woodN);
-	AddTextureSRV(solidCommon, "RoughnessMap", woodR);
-	AddTextureSRV(solidCommon, "Lightbox", sky->GetSkySRV());
-
-	std::shared_ptr<RendMat> triplanar =
-		std::make_shared<RendMat>(
-			XMFLOAT3(1, 1, 1),
-			XMFLOAT2(0, 0),
-			XMFLOAT2(1, 1),
-			L"VertexShader.cso",
-			L"PixelTriplanar.cso"
-		);
-	AddSampler(triplanar,		"BasicSampler", samplerOptions);
-	AddTextureSRV(triplanar,	"AlbedoFront",	woodA);
-	AddTextureSRV(triplanar,	"AlbedoSide",	cobbleA);
-	AddTextureSRV(triplanar,	"AlbedoTop",	scratchedA);
-
-	std::shared_ptr<RendMat> triplanarShadows =
-		std::make_shared<RendMat>(
-			XMFLOAT3(1, 1, 1),
-			XMFLOAT2(0, 0),
-			XMFLOAT2(1, 1),
-			L"VertexShader.cso",
-			L"TriplanarShadows.cso"
-		);
-	AddSampler(triplanarShadows, "BasicSampler", samplerOptions);
-	AddTextureSRV(triplanarShadows, "Albedo", triFront);
-	AddTextureSRV(triplanarShadows, "AlbedoFront", noise);
-	AddTextureSRV(triplanarShadows, "AlbedoSide", noise);
-	AddTextureSRV(triplanarShadows, "AlbedoTop", noise);
+	// Bake the light the sky gives off, or load the last bake
+	std::wstring skyFolder = FixPath(L"..\\..\\Assets\\Skies\\Clouds Blue\\");
+	std::wstring skyFaces[6] = {
+		skyFolder + L"right.png",
+		skyFolder + L"left.png",
+		skyFolder + L"up.png",
+		skyFolder + L"down.png",
+		skyFolder + L"front.png",
+		skyFolder + L"back.png" };
+	sky->BakeLighting(skyFaces, FixPath(L"..\\..\\Assets\\Cooked\\Skies\\Clouds Blue\\"));
+
+	// Load every material file. Anything they refer to with
+	// @name is made by the engine and registered here
+	MaterialLoadContext materialContext = {};
+	materialContext.device = device;
+	materialContext.context = context;
+	materialContext.assets = &assets;
+	materialContext.namedSamplers["basic"] = samplerOptions;
+	materialContext.streaming = streamedTextures.get();
+	assets.AddTexture("@sky", sky->GetSkySRV());
+
+	LoadMaterialFolder(FixPath(L"../../Assets/Materials"), &materialContext);
 
 
 	// Create the non-PBR entities ==============================
 
-	// Generate Cornell-like cube 
-	float yOffset = 1.0f;
+	// A sphere and cube where the player starts
+	MakeEntity(ASSET_ID("sphere.obj"), ASSET_ID("SolidCommon"), XMFLOAT3(1.0f, -0.5f, 0.0f), XMFLOAT3(0.0f, XM_PI / 4.0f, 0.0f), 1.0f);
+	MakeEntity(ASSET_ID("cube.obj"), ASSET_ID("SolidCommon"), XMFLOAT3(-1.0f, -0.25f, 0.0f), XMFLOAT3(0, 0, 0), 1.5f);
 
-	std::shared_ptr<GameEntity> leftWall = std::make_shared<GameEntity>(planeMesh, solidCommon);
-	leftWall->GetTransform()->SetPosition(-2, yOffset, 0);
-	leftWall->GetTransform()->Rotate(0.0f, 0.0f, -XM_PI / 2.0f);
-	leftWall->GetTransform()->SetScale(2.0f);
 
-	std::shared_ptr<GameEntity> rightWall = std::make_shared<GameEntity>(planeMesh, solidCommon);
-	rightWall->GetTransform()->SetPosition(2, yOffset, 0);
-	rightWall->GetTransform()->Rotate(-XM_PI / 2.0f, 0.0f, XM_PI / 2.0f);
-	rightWall->GetTransform()->SetScale(2.0f);
-	
-	std::shared_ptr<GameEntity> backWall = std::make_shared<GameEntity>(planeMesh, solidCommon);
-	backWall->GetTransform()->SetPosition(0.0f, yOffset, 2.0f);
-	backWall->GetTransform()->Rotate(-XM_PI / 2.0f, 0.0f, 0.0f);
-	backWall->GetTransform()->SetScale(2.0f);
-
-	std::shared_ptr<GameEntity> floor = std::make_shared<GameEntity>(planeMesh, solidCommon);
-	floor->GetTransform()->SetPosition(0.0f, -2.0f + yOffset, 0.0f);
-	floor->GetTransform()->SetScale(2.0f);
-
-	std::shared_ptr<GameEntity> roof = std::make_shared<GameEntity>(planeMesh, solidCommon);
-	roof->GetTransform()->SetPosition(0.0f, 2.0f + yOffset, 0.0f);
-	roof->GetTransform()->Rotate(0.0f, 0.0f, XM_PI);
-	roof->GetTransform()->SetScale(2.0f);
-
-	std::shared_ptr<GameEntity> cubeA = std::make_shared<GameEntity>(sphereMesh, solidCommon);
-	cubeA->GetTransform()->SetPosition(1.0f, -1.5f + yOffset, 0.0f);
-	cubeA->GetTransform()->Rotate(0.0f, XM_PI / 4.0f, 0.0f);
-	cubeA->GetTransform()->SetScale(1.0f);
-
-	std::shared_ptr<GameEntity> cubeB = std::make_shared<GameEntity>(cubeMesh, solidCommon);
-	cubeB->GetTransform()->SetPosition(-1.0f, -1.25f + yOffset, 0.0f);
-	cubeB->GetTransform()->Rotate(0.0f, 0.0f, 0.0f);
-	cubeB->GetTransform()->SetScale(1.5f);
-
-
-	swordEntity = std::make_shared<GameEntity>(planeMesh, heronRendMat, false);
-	wandEntity = std::make_shared<GameEntity>(planeMesh, wandRendMat, false);
-
-	entities.push_back(leftWall);
-	entities.push_back(rightWall);
-	entities.push_back(backWall);
-	entities.push_back(floor);
-	entities.push_back(roof);
-	entities.push_back(cubeA);
-	entities.push_back(cubeB);
-	entities.push_back(swordEntity);
-	entities.push_back(wandEntity);
+	// Walls to walk between, just under the dungeon's floor
+	// height so the two don't fight where they meet
+	MakeEntity(ASSET_ID("SampleLevel.obj"), ASSET_ID("Cobble2x"), XMFLOAT3(0.0f, -1.02f, 14.0f), XMFLOAT3(0, 0, 0), 1.0f);
+
+	// The dungeon, east of the walls
+	GenerateDungeon();
+
+
+	// Held items follow the player
+	swordEntity = MakeEntity(ASSET_ID("plane.obj"), ASSET_ID("Heron"), XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 0), 1.0f, false, EntityMobility::Dynamic);
+	wandEntity = MakeEntity(ASSET_ID("plane.obj"), ASSET_ID("Wand"), XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 0), 1.0f, false, EntityMobility::Dynamic);
+	scene.ApplyChanges();
+
+	// Nothing can hit what the player is holding
+	if (BoundsComponent* bounds = scene.Get<BoundsComponent>(swordEntity))
+		bounds->queryLayers = 0;
+	if (BoundsComponent* bounds = scene.Get<BoundsComponent>(wandEntity))
+		bounds->queryLayers = 0;
+
+	// Wand shots fly straight for a couple of seconds
+	EntityDesc projectile = DescribeEntity(ASSET_ID("sphere.obj"), ASSET_ID("SolidCommon"), false, EntityMobility::Dynamic);
+	if (projectile.mask != 0)
+	{
+		projectile.mask |= COMPONENT_BIT(GameplayComponent);
+		projectile.bounds.queryLayers = ENTITY_LAYER_PROJECTILE;
+		projectile.transform.scale[0] = 0.15f;
+		projectile.transform.scale[1] = 0.15f;
+		projectile.transform.scale[2] = 0.15f;
+		projectile.gameplay.health = 1.0f;
+		projectile.gameplay.lifetime = 2.0f;
+		projectilePool = std::make_unique<EntityPool>(&scene, projectile, 256);
+	}
+
+	// Everything static so far is level
+	UpdateEntityTransforms();
+	BuildLevelCollision();
+	spatialIndex.SetLevel(&levelCollision);
+	spatialIndex.Rebuild(&scene);
+	BuildNavigation();
+
+	// Skeletons in a ring around the middle of the walls,
+	// standing on whatever ground the navigation mesh finds
+	for (int i = 0; i < 8; i++)
+	{
+		float angle = XM_2PI * i / 8.0f;
+		float spot[3] = { cosf(angle) * 8.0f, -1.0f, 14.0f + sinf(angle) * 8.0f };
+		float ground[3];
+		if (navMesh.FindNearestPoly(spot, 3.0f, ground) < 0)
+			continue;
+
+		EntityId skelly = MakeEntity(
+			ASSET_ID("Skelly.obj"), ASSET_ID("Bronze"),
+			XMFLOAT3(ground[0], ground[1] + ENEMY_FOOT_OFFSET, ground[2]), XMFLOAT3(0, angle, 0), 1.0f,
+			true, EntityMobility::Dynamic);
+		if (skelly.IsNull())
+			continue;
+		AddEnemy(&enemiesData, &crowd, skelly, ground, 2.5f);
+	}
+
+	// Nothing static is made after this
+	BuildStaticBatches();
 
 	// Save assets needed for drawing point lights
-	lightMesh = sphereMesh;
-	lightVS = nameToVS[L"VertexShader.cso"];
-	lightPS = nameToPS[L"SolidColorPS.cso"];
+	lightMesh = assets.meshes.Get(assets.meshes.Acquire(ASSET_ID("sphere.obj")));
+	lightVS = assets.vertexShaders.Get(assets.vertexShaders.Acquire(ASSET_ID("VertexShader.cso")));
+	lightPS = assets.pixelShaders.Get(assets.pixelShaders.Acquire(ASSET_ID("SolidColorPS.cso")));
 
-	GroupEntitiesByShaders();
+	// Drawn directly by the engine rather than through a material
+	assets.vertexShaders.Acquire(ASSET_ID("ShadowVertex.cso"));
 }
 
 
@@ -563,11 +823,12 @@ void Game::GenerateLights()
 // --------------------------------------------------------
 void Game::GenerateShadowData()
 {
-	// Create the actual texture that will be the shadow map
+	// Create the actual texture that will be the shadow map,
+	// one slice for each cascade
 	D3D11_TEXTURE2D_DESC shadowDesc = {};
 	shadowDesc.Width = SHADOW_MAP_RESOLUTION; // Ideally a power of 2 (like 1024)
 	shadowDesc.Height = SHADOW_MAP_RESOLUTION; // Ideally a power of 2 (like 1024)
-	shadowDesc.ArraySize = 1;
+	shadowDesc.ArraySize = SHADOW_CASCADE_MAX_COUNT;
 	shadowDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
 	shadowDesc.CPUAccessFlags = 0;
 	shadowDesc.Format = DXGI_FORMAT_R32_TYPELESS;
@@ -576,35 +837,64 @@ void Game::GenerateShadowData()
 	shadowDesc.SampleDesc.Count = 1;
 	shadowDesc.SampleDesc.Quality = 0;
 	shadowDesc.Usage = D3D11_USAGE_DEFAULT;
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> shadowTexture;
-	device->CreateTexture2D(&shadowDesc, 0, shadowTexture.GetAddressOf());
+	device->CreateTexture2D(&shadowDesc, 0, shadowTexture.ReleaseAndGetAddressOf());
+
+	// Matching array the static casters are cached in
+	shadowDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+	device->CreateTexture2D(&shadowDesc, 0, shadowCacheTexture.ReleaseAndGetAddressOf());
+
+	// Single slice copy for the shadow map window
+	shadowDesc.ArraySize = 1;
+	shadowDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	device->CreateTexture2D(&shadowDesc, 0, shadowPreviewTexture.ReleaseAndGetAddressOf());
 
 
 	// NOTE: We are creating two views since we are rendering
 	//		 for the depth data along with creating an image. 
 
-	// Create the depth/stencil view that lets us access the 
-	// shadow texture 
-	D3D11_DEPTH_STENCIL_VIEW_DESC shadowDSDesc = {};
-	shadowDSDesc.Format = DXGI_FORMAT_D32_FLOAT;
-	shadowDSDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
-	shadowDSDesc.Texture2D.MipSlice = 0;
-	device->CreateDepthStencilView(
-		shadowTexture.Get(),
-		&shadowDSDesc,
-		shadowDSV.GetAddressOf());
+	// Create the depth/stencil views that let us draw into
+	// each slice of the shadow texture
+	for (int i = 0; i < SHADOW_CASCADE_MAX_COUNT; i++)
+	{
+		D3D11_DEPTH_STENCIL_VIEW_DESC shadowDSDesc = {};
+		shadowDSDesc.Format = DXGI_FORMAT_D32_FLOAT;
+		shadowDSDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+		shadowDSDesc.Texture2DArray.MipSlice = 0;
+		shadowDSDesc.Texture2DArray.FirstArraySlice = i;
+		shadowDSDesc.Texture2DArray.ArraySize = 1;
+		device->CreateDepthStencilView(
+			shadowTexture.Get(),
+			&shadowDSDesc,
+			shadowDSVs[i].GetAddressOf());
+		device->CreateDepthStencilView(
+			shadowCacheTexture.Get(),
+			&shadowDSDesc,
+			shadowCacheDSVs[i].GetAddressOf());
+	}
 
-	// Create the SRV for the shadow map
+	// Create the SRV for the whole shadow map
 	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
-	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MipLevels = 1;
-	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+	srvDesc.Texture2DArray.MipLevels = 1;
+	srvDesc.Texture2DArray.MostDetailedMip = 0;
+	srvDesc.Texture2DArray.FirstArraySlice = 0;
+	srvDesc.Texture2DArray.ArraySize = SHADOW_CASCADE_MAX_COUNT;
 	device->CreateShaderResourceView(
 		shadowTexture.Get(),
 		&srvDesc,
 		shadowSRV.GetAddressOf());
 
+	D3D11_SHADER_RESOURCE_VIEW_DESC previewDesc = {};
+	previewDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	previewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	previewDesc.Texture2D.MipLevels = 1;
+	previewDesc.Texture2D.MostDetailedMip = 0;
+	device->CreateShaderResourceView(
+		shadowPreviewTexture.Get(),
+		&previewDesc,
+		shadowPreviewSRV.GetAddressOf());
+
 	// Shadow rasterizer 
 	D3D11_RASTERIZER_DESC shadowRastDesc = {};
 	shadowRastDesc.FillMode = D3D11_FILL_SOLID;
@@ -625,6 +915,41 @@ void Game::GenerateShadowData()
 	device->CreateSamplerState(&shadowSampDesc, &shadowSampler);
 }
 
+// --------------------------------------------------------
+// Creates the structured buffers the light clusters are
+// uploaded to every frame. Sized for the most they can
+// ever hold so they never have to be recreated
+// --------------------------------------------------------
+void Game::CreateLightClusterBuffers()
+{
+	auto createBuffer = [this](
+		unsigned int stride,
+		unsigned int count,
+		Microsoft::WRL::ComPtr<ID3D11Buffer>& buffer,
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv)
+	{
+		D3D11_BUFFER_DESC desc = {};
+		desc.ByteWidth = stride * count;
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		desc.StructureByteStride = stride;
+		device->CreateBuffer(&desc, 0, buffer.GetAddressOf());
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements = count;
+		device->CreateShaderResourceView(buffer.Get(), &srvDesc, srv.GetAddressOf());
+	};
+
+	createBuffer(sizeof(Light), MAX_LIGHTS, clusterLightBuffer, clusterLightSRV);
+	createBuffer(sizeof(LightClusterRange), LIGHT_CLUSTER_COUNT, clusterRangeBuffer, clusterRangeSRV);
+	createBuffer(sizeof(unsigned int), LIGHT_CLUSTER_MAX_INDICES, clusterIndexBuffer, clusterIndexSRV);
+}
+
 
 
 // --------------------------------------------------------
@@ -633,8 +958,12 @@ void Game::GenerateShadowData()
 // --------------------------------------------------------
 void Game::OnResize()
 {
-	// Handle base-level DX resize stuff
-	DXCore::OnResize();
+	// Handle base-level DX resize stuff, waiting for the
+	// render thread to be done with the back buffer
+	{
+		std::lock_guard<std::mutex> lock(deviceMutex);
+		DXCore::OnResize();
+	}
 
 	// Update our projection matrix to match the new aspect ratio
 	for (int i = 0; i < playersData->cams.size(); i++)
@@ -648,107 +977,825 @@ void Game::OnResize()
 // --------------------------------------------------------
 void Game::Update(float deltaTime, float totalTime)
 {
+	auto updateStart = std::chrono::high_resolution_clock::now();
+
+	// Every thread's allocations since the last frame began
+	unsigned long long allocations = GetHeapAllocationCount();
+	frameTimings.frameAllocations = (unsigned int)(allocations - lastFrameAllocationCount);
+	lastFrameAllocationCount = allocations;
+	unsigned long long updateAllocationsStart = GetThreadHeapAllocationCount();
+
+	updateArenas.BeginFrame();
+
+	// Entities made or removed since last frame join or
+	// leave the scene here, before anything looks at it
+	scene.ApplyChanges();
+	if (projectilePool)
+		projectilePool->Update();
+
+	// Pipeline settings changed in last frame's UI
+	if (pipelineSettings.pipelined != appliedPipelineSettings.pipelined ||
+		pipelineSettings.snapshotCount != appliedPipelineSettings.snapshotCount ||
+		pipelineSettings.dropStaleSnapshots != appliedPipelineSettings.dropStaleSnapshots)
+		ApplyPipelineSettings();
+
 	// Set up the new frame for the UI, then build
 	// this frame's interface.  Note that the building
 	// of the UI could happen at any point during update.
 	UINewFrame(deltaTime);
 	BuildUI();
 
+	// Drop timed debug items before anything new is added
+	AdvanceDebugDraws(&debugDrawData, deltaTime);
+
 
 	// Update the player
-	std::vector<PlayerInput> inputs = PlayersInputs(updateMouseDelta);
-	TransformPlayers(playersData.get(), inputs, deltaTime);
+	Span<PlayerInput> inputs = PlayersInputs(updateArenas.Current(), updateMouseDelta);
+	TransformPlayers(playersData.get(), inputs, deltaTime, &levelCollision);
 	/*UpdatePlayerGameLogic(
 		playersData.get(),
-		swordEntity, wandEntity,
+		&scene, swordEntity, wandEntity,
 		deltaTime);*/
 
+	// Holding the left mouse button fires the wand while
+	// the mouse is captured, the right swings the sword. Both
+	// ask what they hit in one batch of queries
+	combatQueries.Clear();
+	int wandQuery = -1;
+	int swingQuery = -1;
+
+	SpatialQuery combat = {};
+	Transform& cam = playersData->cams[0].transform;
+	XMFLOAT3 aim = cam.GetForward();
+	XMFLOAT3 eye = cam.GetPosition();
+	memcpy(combat.origin, &eye, sizeof(combat.origin));
+	memcpy(combat.direction, &aim, sizeof(combat.direction));
+	combat.flags = QUERY_ENTITIES | QUERY_LEVEL;
+	combat.layers = ENTITY_LAYER_DEFAULT;
+
+	projectileCooldown -= deltaTime;
+	if (updateMouseDelta && inputs[0].leftMouseClicked && projectileCooldown <= 0.0f)
+	{
+		projectileCooldown = 0.1f;
+
+		XMFLOAT3 forward = aim;
+		XMFLOAT3 position = eye;
+		XMFLOAT3 rotation = cam.GetPitchYawRoll();
+		XMStoreFloat3(&position, XMVectorAdd(XMLoadFloat3(&position), XMLoadFloat3(&forward)));
+		XMStoreFloat3(&forward, XMVectorScale(XMLoadFloat3(&forward), 20.0f));
+		if (projectilePool)
+			projectilePool->Spawn(&position.x, &rotation.x, &forward.x);
+
+		combat.shape = QueryShape::Ray;
+		combat.maxDistance = 100.0f;
+		combat.maxHits = 1;
+		wandQuery = (int)combatQueries.Add(combat);
+	}
+
+	swingCooldown -= deltaTime;
+	if (updateMouseDelta && inputs[0].rightMouseClicked && swingCooldown <= 0.0f)
+	{
+		swingCooldown = 0.4f;
+
+		combat.shape = QueryShape::Cone;
+		combat.maxDistance = 2.5f;
+		combat.coneCosine = cosf(XMConvertToRadians(40.0f));
+		combat.maxHits = 8;
+		swingQuery = (int)combatQueries.Add(combat);
+	}
+
+	spatialIndex.Run(&combatQueries);
+	if (wandQuery >= 0)
+	{
+		Span<const QueryHit> hits = combatQueries.GetHits(wandQuery);
+		lastWandHitSomething = !hits.empty();
+		if (lastWandHitSomething)
+		{
+			lastWandHit = hits[0];
+			AddDebugCross(&debugDrawData, XMFLOAT3(lastWandHit.point), XMFLOAT4(1, 0.5f, 0, 1), 0.25f, 1.0f);
+		}
+	}
+	if (swingQuery >= 0)
+	{
+		Span<const QueryHit> hits = combatQueries.GetHits(swingQuery);
+		lastSwingHits = (unsigned int)hits.size();
+		for (const QueryHit& hit : hits)
+			AddDebugSphere(&debugDrawData, XMFLOAT3(hit.point), 0.1f, XMFLOAT4(1, 0, 0, 1), 0.5f);
+	}
+
 	// Check individual input
 	Input& input = Input::GetInstance();
 
-	static bool heldPrev = false;
-	if (input.KeyDown(VK_TAB) && !heldPrev)
+	static bool heldPrev = false;
+	if (input.KeyDown(VK_TAB) && !heldPrev)
+	{
+		// Toggle mouse constatins 
+		updateMouseDelta = !updateMouseDelta;
+		SetCursorPos(
+			GetSystemMetrics(SM_CXSCREEN) / 2, 
+			GetSystemMetrics(SM_CYSCREEN) / 2);
+
+		ShowCursor(!updateMouseDelta);
+
+		heldPrev = true;
+	}
+	else if (input.KeyUp(VK_TAB))
+	{
+		heldPrev = false; 
+	}
+	if (input.KeyDown(VK_ESCAPE)) Quit();
+	if (input.KeyPress(VK_TAB)) GenerateLights();
+
+	// Enemies walk towards wherever the player stands. Path
+	// searches and the crowd's tick share one pass over the
+	// simulation workers, then every agent lands on its entity
+	XMFLOAT3 playerFeet = playersData->transforms[0].GetPosition();
+	UpdateEnemies(&enemiesData, &crowd, pathQueue.get(), &playerFeet.x, deltaTime);
+	simulationJobs->Reset();
+	pathQueue->AddJobs(simulationJobs.get(), 256);
+	crowd.AddJobs(simulationJobs.get(), simulationJobs->GetWorkerCount() + 1, deltaTime);
+	simulationJobs->Run(true);
+	crowd.WriteTransforms(&scene, ENEMY_FOOT_OFFSET);
+
+	// Move and age spawned entities, then rebuild the
+	// matrices and bounds of whatever moved this frame
+	UpdateGameplayComponents(&scene, deltaTime);
+	UpdateEntityTransforms();
+	spatialIndex.Rebuild(&scene);
+
+	// Finish the UI here so its draw data can
+	// travel to the render thread with the snapshot
+	ImGui::Render();
+
+	frameTimings.updateMS = std::chrono::duration<float, std::milli>(
+		std::chrono::high_resolution_clock::now() - updateStart).count();
+
+	// Hand this frame over to the renderer
+	PublishSnapshot(deltaTime, totalTime);
+
+	frameTimings.updateAllocations = (unsigned int)(GetThreadHeapAllocationCount() - updateAllocationsStart);
+}
+
+// --------------------------------------------------------
+// Before rendering the main primary entities go through 
+// and draw the shadow depths of one cascade for sampling
+// later. Only casters that overlap the cascade are drawn.
+// With the cache on, static casters come from the cached
+// copy of the cascade and only dynamic ones are drawn
+// --------------------------------------------------------
+void Game::DrawShadowMap(ID3D11DeviceContext* ctx, RenderSnapshot* snapshot, int cascade)
+{
+	auto recordStart = std::chrono::high_resolution_clock::now();
+
+	const ShadowCascade& bounds = snapshot->cascades[cascade];
+	ID3D11DepthStencilView* dsv = shadowDSVs[cascade].Get();
+
+	// Set to shadow rasterizer 
+	ctx->RSSetState(shadowRasterizer.Get());
+
+	// Unbind pixel shader 
+	ctx->PSSetShader(0, 0, 0);
+
+	// Adjust viewport to match shadow map resolution 
+	D3D11_VIEWPORT viewport = {};
+	viewport.Width = (float)SHADOW_MAP_RESOLUTION;
+	viewport.Height = (float)SHADOW_MAP_RESOLUTION;
+	viewport.MinDepth = 0.0f;
+	viewport.MaxDepth = 1.0f;
+	ctx->RSSetViewports(1, &viewport);
+
+
+	// Draw all entities to shadow map 
+	const std::shared_ptr<SimpleVertexShader>& shadowVS = assets.vertexShaders.Get(ASSET_ID("ShadowVertex.cso"));
+	shadowVS->SetShader();
+	shadowVS->SetData("view", bounds.view, sizeof(bounds.view));
+	shadowVS->SetData("projection", bounds.projection, sizeof(bounds.projection));
+
+	// Draws the casters in this cascade, either all of them or
+	// only the static or dynamic ones, and returns how many
+	// there were. Casters are only counted when draw is false
+	auto drawCasters = [&](bool draw, bool includeStatic, bool includeDynamic)
+	{
+		unsigned int casters = 0;
+		for (auto& group : snapshot->groups)
+		{
+			for (auto& e : group.entities)
+			{
+				if (!e.castsShadows)
+					continue;
+				if (e.isStatic ? !includeStatic : !includeDynamic)
+					continue;
+
+				if (!ShadowCascadeOverlapsSphere(bounds, &e.boundsCenter.x, e.boundsRadius))
+					continue;
+				casters++;
+
+				if (!draw)
+					continue;
+
+				shadowVS->SetMatrix4x4("world", e.world);
+				shadowVS->CopyAllBufferData();
+
+				// Draw the mesh directly to avoid the entity's material
+				// Note: Your code may differ significantly here!
+				assets.meshes.Get(e.mesh)->SetBuffersAndDraw(ctx);
+			}
+		}
+		return casters;
+	};
+
+	// We do not need a color output so null for render target
+	ID3D11RenderTargetView* nullRTV{};
+	unsigned int draws = 0;
+	unsigned int staticCasters = 0;
+	bool cacheHit = false;
+
+	if (snapshot->shadowCacheEnabled)
+	{
+		// Redraw the cached static casters only when
+		// the cascade or the static casters changed
+		cacheHit = ShadowCacheMatches(shadowCaches[cascade], bounds, snapshot->staticShadowKey);
+		if (!cacheHit)
+		{
+			ID3D11DepthStencilView* cacheDSV = shadowCacheDSVs[cascade].Get();
+			ctx->ClearDepthStencilView(cacheDSV, D3D11_CLEAR_DEPTH, 1.0f, 0);
+			ctx->OMSetRenderTargets(1, &nullRTV, cacheDSV);
+			staticCasters = drawCasters(true, true, false);
+			draws += staticCasters;
+			StoreShadowCache(&shadowCaches[cascade], bounds, snapshot->staticShadowKey);
+		}
+		else
+			staticCasters = drawCasters(false, true, false);
+
+		// Start from the static depths
+		ctx->OMSetRenderTargets(0, 0, 0);
+		ctx->CopySubresourceRegion(shadowTexture.Get(), cascade, 0, 0, 0, shadowCacheTexture.Get(), cascade, 0);
+
+		ctx->OMSetRenderTargets(1, &nullRTV, dsv);
+		unsigned int dynamicCasters = drawCasters(true, false, true);
+		draws += dynamicCasters;
+		cascadeUncachedDrawCounts[cascade] = staticCasters + dynamicCasters;
+	}
+	else
+	{
+		// Clear shadow map and draw everything
+		ctx->ClearDepthStencilView(dsv, D3D11_CLEAR_DEPTH, 1.0f, 0);
+		ctx->OMSetRenderTargets(1, &nullRTV, dsv);
+		draws = drawCasters(true, true, true);
+		cascadeUncachedDrawCounts[cascade] = draws;
+	}
+
+	cascadeDrawCounts[cascade] = draws;
+	cascadeCacheHits[cascade] = cacheHit;
+
+	// Copy out the cascade the shadow map window shows
+	if (cascade == snapshot->shadowPreviewCascade)
+	{
+		ctx->OMSetRenderTargets(0, 0, 0);
+		ctx->CopySubresourceRegion(shadowPreviewTexture.Get(), 0, 0, 0, 0, shadowTexture.Get(), cascade, 0);
+	}
+
+	// Disable shadow rasterizer 
+	ctx->RSSetState(0);
+
+	// Reset pipeline
+	viewport = GetMainViewport();
+	ctx->RSSetViewports(1, &viewport);
+	ctx->OMSetRenderTargets(
+		1,
+		backBufferRTV.GetAddressOf(),
+		depthBufferDSV.Get());
+
+	cascadeRecordMS[cascade] = std::chrono::duration<float, std::milli>(
+		std::chrono::high_resolution_clock::now() - recordStart).count();
+}
+
+// --------------------------------------------------------
+// The viewport used for everything drawn to the back buffer
+// --------------------------------------------------------
+D3D11_VIEWPORT Game::GetMainViewport()
+{
+	D3D11_VIEWPORT viewport = {};
+	viewport.TopLeftX = -(windowWidth - targetSizeX) / 2.0f;
+	viewport.TopLeftY = -(windowHeight - targetSizeY) / 2.0f;
+	viewport.Width = (float)this->windowWidth;
+	viewport.Height = (float)this->windowHeight;
+	viewport.MinDepth = 0.0f;
+	viewport.MaxDepth = 1.0f;
+	return viewport;
+}
+
+/// <summary>
+/// Adds a job whose draw calls are recorded into its own
+/// deferred context. When multithreaded rendering is off the
+/// job records straight into the immediate context instead
+/// </summary>
+unsigned int Game::AddRecordingJob(
+	const char* name,
+	std::function<void(ID3D11DeviceContext*)> record,
+	Span<const unsigned int> dependencies)
+{
+	unsigned int jobIndex = renderJobs->GetJobCount();
+	unsigned int contextIndex = recordingJobCount++;
+
+	// The job only keeps a pointer to the recording so its
+	// function is small enough to never allocate
+	std::function<void(ID3D11DeviceContext*)>* recording =
+		renderArena.New<std::function<void(ID3D11DeviceContext*)>>(std::move(record));
+
+	return renderJobs->AddJob(name, [this, jobIndex, contextIndex, recording](unsigned int slot)
+	{
+		if (!recordDeferred)
+		{
+			(*recording)(context.Get());
+			return;
+		}
+
+		ID3D11DeviceContext* dc = deferredContexts[contextIndex].Get();
+		ISimpleShader::BeginRecording(dc, slot);
+
+		// Deferred contexts start every command list
+		// from the default pipeline state
+		D3D11_VIEWPORT viewport = GetMainViewport();
+		dc->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthBufferDSV.Get());
+		dc->RSSetViewports(1, &viewport);
+		dc->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+		(*recording)(dc);
+
+		dc->FinishCommandList(FALSE, commandLists[jobIndex].ReleaseAndGetAddressOf());
+		ISimpleShader::EndRecording();
+	}, dependencies);
+}
+
+/// <summary>
+/// Bins the snapshot's point and spot lights on the workers
+/// and uploads the clusters once binning is done. Added first
+/// so the upload is submitted before anything that reads it
+/// </summary>
+void Game::AddLightClusterJobs(RenderSnapshot* snapshot)
+{
+	Camera& camera = snapshot->camera;
+
+	ClusterFrustum frustum = {};
+	memcpy(frustum.view, &camera.viewMatrix, sizeof(frustum.view));
+	frustum.projScaleX = camera.projMatrix._11;
+	frustum.projScaleY = camera.projMatrix._22;
+	frustum.nearClip = camera.nearClip;
+	frustum.farClip = camera.farClip;
+	frustum.orthographic = camera.projectionType == CameraProjectionType::Orthographic;
+
+	// Only the active point and spot lights are binned,
+	// keeping their index into the whole light array
+	ClusterLight clusterLights[MAX_LIGHTS];
+	unsigned int clusterLightCount = 0;
+	unsigned int activeLights = (std::min)((unsigned int)snapshot->lightCount, (unsigned int)snapshot->lights.size());
+	for (unsigned int i = 0; i < activeLights && i < MAX_LIGHTS; i++)
+	{
+		const Light& light = snapshot->lights[i];
+		if (light.Type == LIGHT_TYPE_DIRECTIONAL)
+			continue;
+
+		ClusterLight& c = clusterLights[clusterLightCount++];
+		c.x = light.Position.x;
+		c.y = light.Position.y;
+		c.z = light.Position.z;
+		c.range = light.Range;
+		c.lightIndex = i;
+	}
+
+	lightClusters.Prepare(frustum, clusterLights, clusterLightCount);
+
+	D3D11_VIEWPORT viewport = GetMainViewport();
+	clusterParams = lightClusters.GetShaderParams(viewport.TopLeftX, viewport.TopLeftY, viewport.Width, viewport.Height);
+
+	unsigned int binned = lightClusters.AddJobs(renderJobs.get(), renderJobs->GetWorkerCount() + 1);
+
+	AddRecordingJob("Light Cluster Upload", [this, snapshot](ID3D11DeviceContext* ctx)
+	{
+		auto upload = [ctx](ID3D11Buffer* buffer, const void* data, size_t bytes)
+		{
+			D3D11_MAPPED_SUBRESOURCE mapped = {};
+			if (FAILED(ctx->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+				return;
+			if (bytes > 0)
+				memcpy(mapped.pData, data, bytes);
+			ctx->Unmap(buffer, 0);
+		};
+
+		unsigned int indexCount = lightClusters.GetIndexCount();
+		upload(clusterLightBuffer.Get(), snapshot->lights.data(), sizeof(Light) * (std::min)(snapshot->lights.size(), (size_t)MAX_LIGHTS));
+		upload(clusterRangeBuffer.Get(), lightClusters.GetClusterRanges().data(), sizeof(LightClusterRange) * LIGHT_CLUSTER_COUNT);
+		upload(clusterIndexBuffer.Get(), lightClusters.GetLightIndices().data(), sizeof(unsigned int) * indexCount);
+
+		clusterIndexCount = indexCount;
+		clusterOverflowCount = lightClusters.GetOverflowCount();
+	}, Span<const unsigned int>(&binned, 1));
+}
+
+/// <summary>
+/// Builds the recording jobs for a snapshot: the shadow
+/// map, one job per shader group and the debug drawing
+/// </summary>
+void Game::BuildRenderJobs(RenderSnapshot* snapshot)
+{
+	renderJobs->Reset();
+	renderArena.Reset();
+	recordingJobCount = 0;
+
+	if (snapshot->clusteredLighting)
+		AddLightClusterJobs(snapshot);
+
+	// Every cascade records on its own worker
+	static const char* cascadeJobNames[SHADOW_CASCADE_MAX_COUNT] =
+	{
+		"Shadow Cascade 0",
+		"Shadow Cascade 1",
+		"Shadow Cascade 2",
+		"Shadow Cascade 3"
+	};
+	for (int i = 0; i < snapshot->cascadeCount; i++)
+	{
+		AddRecordingJob(cascadeJobNames[i], [this, snapshot, i](ID3D11DeviceContext* ctx)
+		{
+			DrawShadowMap(ctx, snapshot, i);
+		});
+	}
+
+	for (auto& group : snapshot->groups)
+	{
+		if (group.entities.empty())
+			continue;
+
+		AddRecordingJob("Shader Group", [this, snapshot, &group](ID3D11DeviceContext* ctx)
+		{
+			SetLightClusters(
+				group.ps,
+				snapshot->clusteredLighting,
+				clusterParams,
+				clusterLightSRV,
+				clusterRangeSRV,
+				clusterIndexSRV);
+
+			SetShadowCascades(
+				group.ps,
+				snapshot->cascades,
+				snapshot->cascadeCount,
+				&snapshot->camera);
+
+			SetSkyLighting(
+				group.ps,
+				sky->GetIrradianceSH(),
+				sky->GetSpecularSRV());
+
+			// Pixel shader is set for entire group 
+			// since they are (currently) not entity dependent 
+			SetPixelShader(
+				group.ps,
+				snapshot->lights[0],
+				snapshot->cameraPosition,
+				shadowSRV, shadowSampler
+			);
+
+			// TODO: Optimization is having setting of the shaders not 
+			//		 reset repeated data. We can have a stored enum to 
+			//		 remember the previously set shader and pass in a
+			//		 bool that indicates whether to use set an entire
+			//		 new shader or simply update necessary items 
+
+			for (auto& e : group.entities)
+			{
+				// Vertex shader must be set for entire group
+				// since they are entity dependent 
+				SetVertexShader(
+					assets.vertexShaders.Get(e.vs),
+					e.world,
+					e.worldInvTrans,
+					&snapshot->camera,
+					snapshot->shadowViewMatrix,
+					snapshot->shadowProjectionMatrix);
+
+				// Draw entity 
+				BindMaterial(assets.materials.Get(e.material), ctx);
+				assets.meshes.Get(e.mesh)->SetBuffersAndDraw(ctx);
+			}
+		});
+	}
+
+	// Every debug line of the frame is one upload and one draw
+	debugLineCount = (unsigned int)(snapshot->debugLines.size() / 2);
+	if (!snapshot->debugLines.empty())
+	{
+		AddRecordingJob("Debug Draw", [this, snapshot](ID3D11DeviceContext* ctx)
+		{
+			auto uploadStart = std::chrono::high_resolution_clock::now();
+
+			DrawDebugLines(
+				&debugDrawData,
+				device.Get(),
+				ctx,
+				ctx != context.Get(),
+				snapshot->debugLines,
+				&snapshot->camera);
+
+			debugLineUploadMS = std::chrono::duration<float, std::milli>(
+				std::chrono::high_resolution_clock::now() - uploadStart).count();
+		});
+	}
+	else
+	{
+		debugLineUploadMS = 0;
+	}
+
+	// Every job that records needs a deferred context of its
+	// own, the light binning jobs don't. If one can't be made
+	// the frame is recorded in order on the immediate context
+	while (deferredContexts.size() < recordingJobCount)
+	{
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> deferred;
+		if (FAILED(device->CreateDeferredContext(0, deferred.GetAddressOf())))
+		{
+			recordDeferred = false;
+			break;
+		}
+		deferredContexts.push_back(deferred);
+	}
+	commandLists.resize(renderJobs->GetJobCount());
+}
+
+/// <summary>
+/// Copies everything the renderer needs out of the game
+/// state and publishes it for the render thread. Called
+/// once at the end of every Update
+/// </summary>
+void Game::PublishSnapshot(float deltaTime, float totalTime)
+{
+	auto waitStart = std::chrono::high_resolution_clock::now();
+
+	// Only waits when every snapshot is queued and
+	// stale snapshots are not allowed to be dropped
+	RenderSnapshot* snapshot = snapshots.BeginWrite();
+	while (!snapshot)
+	{
+		std::this_thread::yield();
+		snapshot = snapshots.BeginWrite();
+	}
+
+	auto writeStart = std::chrono::high_resolution_clock::now();
+
+	snapshot->frameIndex = snapshots.GetPublishedCount() + 1;
+	snapshot->deltaTime = deltaTime;
+	snapshot->totalTime = totalTime;
+	snapshot->multithreadedRecording = multithreadedRendering;
+
+	// Camera
+	snapshot->camera = playersData->cams[0];
+	snapshot->cameraPosition = playersData->cams[0].transform.GetPosition();
+
+	// Lights and shadows
+	snapshot->lights = lights;
+	snapshot->lightCount = lightCount;
+	snapshot->showPointLights = showPointLights;
+	snapshot->clusteredLighting = clusteredLighting;
+	snapshot->shadowCacheEnabled = shadowCacheEnabled;
+	FitCascades(snapshot);
+	snapshot->shadowPreviewCascade = shadowMapUICascade;
+
+	// Entities, straight out of the scene's chunks and into
+	// a group per pixel shader. Groups keep their vectors so
+	// memory is reused from frame to frame. Static casters
+	// are hashed along the way to tell when they change
+	unsigned long long staticShadowKey = SHADOW_STATIC_KEY_SEED;
+	for (auto& group : snapshot->groups)
+		group.entities.clear();
+
+	auto findGroup = [snapshot, this](PixelShaderHandle ps)
+	{
+		for (auto& g : snapshot->groups)
+		{
+			if (g.psHandle == ps)
+				return &g;
+		}
+		snapshot->groups.push_back(SnapshotGroup());
+		SnapshotGroup* group = &snapshot->groups.back();
+		group->psHandle = ps;
+		group->ps = assets.pixelShaders.Get(ps);
+		return group;
+	};
+
+	auto addStaticCaster = [&staticShadowKey](const SnapshotEntity& e)
+	{
+		if (e.castsShadows && e.isStatic)
+		{
+			staticShadowKey = HashShadowCaster(staticShadowKey, &e.mesh, sizeof(e.mesh));
+			staticShadowKey = HashShadowCaster(staticShadowKey, &e.world, sizeof(e.world));
+		}
+	};
+
+	unsigned int drawCount = 0;
+	unsigned int batchedCount = 0;
+
+	scene.ForEachChunk(COMPONENTS_RENDERABLE, [&](EntityChunk& chunk)
 	{
-		// Toggle mouse constatins 
-		updateMouseDelta = !updateMouseDelta;
-		SetCursorPos(
-			GetSystemMetrics(SM_CXSCREEN) / 2, 
-			GetSystemMetrics(SM_CYSCREEN) / 2);
+		TransformComponent* transforms = chunk.Get<TransformComponent>();
+		RenderComponent* renders = chunk.Get<RenderComponent>();
+		BoundsComponent* bounds = chunk.Get<BoundsComponent>();
+		MobilityComponent* mobilities = chunk.Get<MobilityComponent>();
 
-		ShowCursor(!updateMouseDelta);
+		SnapshotGroup* group = nullptr;
+		for (unsigned int i = 0; i < chunk.count; i++)
+		{
+			const RenderComponent& render = renders[i];
+			if (staticBatching && render.batched)
+			{
+				batchedCount++;
+				continue;
+			}
 
-		heldPrev = true;
-	}
-	else if (input.KeyUp(VK_TAB))
+			// Neighbours almost always share a shader, and
+			// there are only ever a handful of groups
+			if (!group || group->psHandle != render.ps)
+				group = findGroup(render.ps);
+
+			SnapshotEntity e;
+			e.mesh = render.mesh;
+			e.material = render.material;
+			e.vs = render.vs;
+			memcpy(&e.world, transforms[i].world, sizeof(e.world));
+			memcpy(&e.worldInvTrans, transforms[i].worldInvTrans, sizeof(e.worldInvTrans));
+			e.castsShadows = render.castsShadows;
+			e.isStatic = mobilities[i].mobility == EntityMobility::Static;
+			memcpy(&e.boundsCenter, bounds[i].center, sizeof(e.boundsCenter));
+			e.boundsRadius = bounds[i].radius;
+
+			addStaticCaster(e);
+			group->entities.push_back(e);
+			drawCount++;
+		}
+	});
+
+	// Batches stand in for the entities skipped above
+	if (staticBatching)
 	{
-		heldPrev = false; 
+		for (const StaticDrawBatch& batch : staticDrawBatches)
+		{
+			addStaticCaster(batch.entity);
+			findGroup(batch.ps)->entities.push_back(batch.entity);
+			drawCount++;
+		}
 	}
-	if (input.KeyDown(VK_ESCAPE)) Quit();
-	if (input.KeyPress(VK_TAB)) GenerateLights();
+	snapshot->staticShadowKey = staticShadowKey;
+	sceneDrawCount = drawCount;
+	unbatchedDrawCount = drawCount + batchedCount - (staticBatching ? (unsigned int)staticDrawBatches.size() : 0);
+
+	RequestStreamedTextures(snapshot);
+
+	// Debug drawing. The batch takes the snapshot's old
+	// vector in exchange so neither ever reallocates
+	AddSceneDebugDraws(snapshot);
+	CollectDebugLines(&debugDrawData, snapshot->debugLines);
+
+	// Labels are projected here, with the camera
+	// the snapshot will be drawn from
+	auto textStart = std::chrono::high_resolution_clock::now();
+	snapshot->screenWidth = (float)windowWidth;
+	snapshot->screenHeight = (float)windowHeight;
+	CollectDebugText(
+		&debugDrawData,
+		&snapshot->camera,
+		snapshot->screenWidth,
+		snapshot->screenHeight,
+		snapshot->debugGlyphs);
+	debugGlyphCount = (unsigned int)snapshot->debugGlyphs.size();
+	debugTextBuildMS = std::chrono::duration<float, std::milli>(
+		std::chrono::high_resolution_clock::now() - textStart).count();
+
+	// UI was finished at the end of Update
+	CopyUIDrawData(&snapshot->ui, ImGui::GetDrawData());
+
+	auto writeEnd = std::chrono::high_resolution_clock::now();
+	snapshots.EndWrite(snapshot);
+
+	frameTimings.updateWaitMS = std::chrono::duration<float, std::milli>(writeStart - waitStart).count();
+	frameTimings.snapshotWriteMS = std::chrono::duration<float, std::milli>(writeEnd - writeStart).count();
 }
 
-// --------------------------------------------------------
-// Before rendering the main primary entities go through 
-// and draw the shadow depths for sampling later 
-// --------------------------------------------------------
-void Game::DrawShadowMap()
+/// <summary>
+/// Asks for the mips every entity's textures need at its size
+/// on screen, then hands out the loads and evictions
+/// </summary>
+void Game::RequestStreamedTextures(RenderSnapshot* snapshot)
 {
-	// Set to shadow rasterizer 
-	context->RSSetState(shadowRasterizer.Get());
+	streamedTextures->SetBudget((size_t)textureBudgetMB * 1024 * 1024);
+	streamedTextures->BeginFrame();
+
+	Camera& camera = snapshot->camera;
+	XMFLOAT3 forward = camera.transform.GetForward();
+	for (auto& group : snapshot->groups)
+	{
+		for (auto& e : group.entities)
+		{
+			float diameter = EstimateScreenDiameter(
+				&e.boundsCenter.x,
+				e.boundsRadius,
+				&snapshot->cameraPosition.x,
+				&forward.x,
+				camera.projMatrix._22,
+				(float)windowHeight);
+			if (diameter <= 0.0f)
+				continue;
+
+			const std::shared_ptr<RendMat>& mat = assets.materials.Get(e.material);
+			float uvScale = (std::max)(mat->uvScale.x, mat->uvScale.y);
+			for (auto& handle : mat->textureHandles)
+			{
+				const std::shared_ptr<TextureAsset>& texture = assets.textures.Get(handle);
+				if (texture && texture->streamIndex >= 0)
+					streamedTextures->Request((unsigned int)texture->streamIndex, uvScale, diameter);
+			}
+		}
+	}
 
-	// Clear shadow map 
-	context->ClearDepthStencilView(shadowDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+	streamedTextures->Update();
 
-	// Set up shadow depth target. We do not need
-	// a color output so null for render target
-	ID3D11RenderTargetView* nullRTV{};
-	context->OMSetRenderTargets(1, &nullRTV, shadowDSV.Get()); 
+	// Streamed textures are added with nothing loaded, so
+	// their memory follows the mips that are resident now
+	for (auto& slot : assets.textures.GetSlots())
+	{
+		if (slot.asset && slot.asset->streamIndex >= 0)
+			assets.textures.SetBytes(assets.textures.Find(slot.id), streamedTextures->GetResidentBytes((unsigned int)slot.asset->streamIndex));
+	}
+}
 
-	// Unbind pixel shader 
-	context->PSSetShader(0, 0, 0);
+/// <summary>
+/// Draws the next published snapshot, if there is one
+/// </summary>
+bool Game::RenderNextSnapshot()
+{
+	unsigned long long sequence = 0;
+	RenderSnapshot* snapshot = snapshots.BeginRead(&sequence);
+	if (!snapshot)
+		return false;
 
-	// Adjust viewport to match shadow map resolution 
-	D3D11_VIEWPORT viewport = {};
-	viewport.Width = (float)SHADOW_MAP_RESOLUTION;
-	viewport.Height = (float)SHADOW_MAP_RESOLUTION;
-	viewport.MinDepth = 0.0f;
-	viewport.MaxDepth = 1.0f;
-	context->RSSetViewports(1, &viewport);
+	{
+		// Resizing swaps out the back buffer so it
+		// must never happen in the middle of a frame
+		std::lock_guard<std::mutex> lock(deviceMutex);
+		DrawSnapshot(snapshot);
+	}
 
+	frameTimings.latencyFrames = (unsigned int)(snapshots.GetPublishedCount() - sequence);
+	snapshots.EndRead(snapshot);
+	return true;
+}
 
-	// Draw all entities to shadow map 
-	std::shared_ptr<SimpleVertexShader> shadowVS = nameToVS[L"ShadowVertex.cso"];
-	shadowVS->SetShader();
-	shadowVS->SetMatrix4x4("view", shadowViewMatrix);
-	shadowVS->SetMatrix4x4("projection", shadowProjectionMatrix);
-	// Loop and draw all entities
-	for (auto& e : entities)
+/// <summary>
+/// Render thread loop, runs until the pipeline is stopped
+/// </summary>
+void Game::RenderThreadLoop()
+{
+	while (renderThreadRunning)
 	{
-		if (!e->castsShadows) 
-			continue;
+		if (!RenderNextSnapshot())
+			std::this_thread::yield();
+	}
+}
+
+/// <summary>
+/// Starts rendering on its own thread
+/// </summary>
+void Game::StartRenderThread()
+{
+	renderThreadRunning = true;
+	renderThread = std::thread(&Game::RenderThreadLoop, this);
+}
 
-		shadowVS->SetMatrix4x4("world", e->GetTransform()->GetWorldMatrix());
-		shadowVS->CopyAllBufferData();
+/// <summary>
+/// Stops the render thread once it finishes its current frame
+/// </summary>
+void Game::StopRenderThread()
+{
+	if (!renderThread.joinable())
+		return;
 
+	renderThreadRunning = false;
+	renderThread.join();
+}
 
-		// Draw the mesh directly to avoid the entity's material
-		// Note: Your code may differ significantly here!
-		e->GetMesh()->SetBuffersAndDraw(context);
-	}
+/// <summary>
+/// Applies changes made to the pipeline settings. Called
+/// between frames by the update thread so the render thread
+/// can be stopped while the snapshot ring is reconfigured
+/// </summary>
+void Game::ApplyPipelineSettings()
+{
+	StopRenderThread();
 
-	// Disable shadow rasterizer 
-	context->RSSetState(0);
+	snapshots.Configure(pipelineSettings.snapshotCount, pipelineSettings.dropStaleSnapshots);
+	appliedPipelineSettings = pipelineSettings;
 
-	// Reset pipeline
-	viewport.TopLeftX = -(windowWidth - targetSizeX) / 2.0f;
-	viewport.TopLeftY = -(windowHeight - targetSizeY) / 2.0f;
-	viewport.Width = (float)this->windowWidth;
-	viewport.Height = (float)this->windowHeight;
-	context->RSSetViewports(1, &viewport);
-	context->OMSetRenderTargets(
-		1,
-		backBufferRTV.GetAddressOf(),
-		depthBufferDSV.Get());
+	if (pipelineSettings.pipelined)
+		StartRenderThread();
 }
 
 // --------------------------------------------------------
@@ -756,7 +1803,27 @@ void Game::DrawShadowMap()
 // --------------------------------------------------------
 void Game::Draw(float deltaTime, float totalTime)
 {
-	DrawShadowMap();
+	// When the frame pipeline is running the render thread
+	// draws the snapshots, otherwise the one Update just
+	// published is drawn here
+	if (renderThreadRunning)
+		return;
+
+	RenderNextSnapshot();
+}
+
+// --------------------------------------------------------
+// Draws a single snapshot. Runs on the render thread when
+// the frame pipeline is on
+// --------------------------------------------------------
+void Game::DrawSnapshot(RenderSnapshot* snapshot)
+{
+	auto frameStart = std::chrono::high_resolution_clock::now();
+	unsigned long long allocationsStart = GetThreadHeapAllocationCount();
+
+	// Texture changes land before anything is recorded
+	// with the materials they are swapped into
+	streamedTextures->ApplySwaps(context.Get());
 
 	// Frame START
 	// - These things should happen ONCE PER FRAME
@@ -772,81 +1839,55 @@ void Game::Draw(float deltaTime, float totalTime)
 
 	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-	
-	for (auto group : entityGroups)
-	{
-		// Pixel shader is set for entire group 
-		// since they are (currently) not entity dependent 
-
-		std::shared_ptr<SimplePixelShader> ps = nameToPS[group[0]->GetMaterial()->psName];
-
-		
+	// Record the shadow map, shader groups and debug drawing
+	auto recordStart = std::chrono::high_resolution_clock::now();
+	recordDeferred = snapshot->multithreadedRecording;
+	BuildRenderJobs(snapshot);
+	renderJobs->Run(recordDeferred);
+	auto recordEnd = std::chrono::high_resolution_clock::now();
 
-		SetPixelShader(
-			group[0]->GetMaterial(),
-			ps,
-			lights[0],
-			playersData->cams[0].transform.GetPosition(),
-			shadowTextureSRV,
-			shadowSRV, shadowSampler,
-			psNameToID
-		);
-
-		// TODO: Optimization is having setting of the shaders not 
-		//		 reset repeated data. We can have a stored enum to 
-		//		 remember the previously set shader and pass in a
-		//		 bool that indicates whether to use set an entire
-		//		 new shader or simply update necessary items 
-
-		for (auto entity : group)
+	if (recordDeferred)
+	{
+		// Play the command lists back in the order the jobs were added
+		renderJobs->Submit([this](unsigned int jobIndex)
 		{
-			// Vertex shader must be set for entire group
-			// since they are entity dependent 
-			SetVertexShader(
-				nameToVS[entity->GetMaterial()->vsName],
-				entity->GetTransform(),
-				&playersData->cams[0],
-				shadowViewMatrix,
-				shadowProjectionMatrix);
-
-			// Draw entity 
-			entity->Draw(context, ps);
-		}
-	}
+			if (!commandLists[jobIndex])
+				return;
 
-#if defined(DEBUG) || defined(_DEBUG)
-	// Debug Drawing 
-	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_LINELIST);
-
-	for (auto& ge : debugDrawData.drawGroup)
-	{
-		std::shared_ptr<SimplePixelShader> ps = nameToPS[L"SolidColorPS.cso"]; //ge.entity->GetMaterial()->GetPixelShader();
-		ps->SetFloat3("Color", ge.color);
-		ps->CopyBufferData("perFrame");
+			context->ExecuteCommandList(commandLists[jobIndex].Get(), FALSE);
+			commandLists[jobIndex].Reset();
+		});
 
-		// Draw the entity
-		ge.entity->Draw(context, ps);
+		// Executing resets the immediate context's state
+		D3D11_VIEWPORT viewport = GetMainViewport();
+		context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthBufferDSV.Get());
+		context->RSSetViewports(1, &viewport);
 	}
-#endif
-
-	
-
 
 	// Draw the light sources?
-	if(showPointLights)
-		DrawPointLights();
+	if(snapshot->showPointLights)
+		DrawPointLights(snapshot);
 
 	// Draw the sky
 	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	sky->Draw(&playersData->cams[0]);
+	sky->Draw(&snapshot->camera);
+
+	// Debug labels go over the sky and everything else
+	DrawDebugText(
+		&debugDrawData,
+		device.Get(),
+		context.Get(),
+		snapshot->debugGlyphs,
+		snapshot->screenWidth,
+		snapshot->screenHeight);
+	auto submitEnd = std::chrono::high_resolution_clock::now();
 
 	// Frame END
 	// - These should happen exactly ONCE PER FRAME
 	// - At the very end of the frame (after drawing *everything*)
 	{
 		// Draw the UI after everything else
-		ImGui::Render();
-		ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+		ImGui_ImplDX11_RenderDrawData(&snapshot->ui.drawData);
 
 		// Present the back buffer to the user
 		//  - Puts the results of what we've drawn onto the window
@@ -858,30 +1899,37 @@ void Game::Draw(float deltaTime, float totalTime)
 
 		// Must re-bind buffers after presenting, as they become unbound
 		context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthBufferDSV.Get());
-	
+
 		// Unbind shadowmap 
 		ID3D11ShaderResourceView* nullSRVs[128] = {};
 		context->PSSetShaderResources(0, 128, nullSRVs);
 	}
+
+	auto frameEnd = std::chrono::high_resolution_clock::now();
+	frameTimings.recordMS = std::chrono::duration<float, std::milli>(recordEnd - recordStart).count();
+	frameTimings.submitMS = std::chrono::duration<float, std::milli>(submitEnd - recordEnd).count();
+	frameTimings.presentMS = std::chrono::duration<float, std::milli>(frameEnd - submitEnd).count();
+	frameTimings.renderFrameMS = std::chrono::duration<float, std::milli>(frameEnd - frameStart).count();
+	frameTimings.renderAllocations = (unsigned int)(GetThreadHeapAllocationCount() - allocationsStart);
 }
 
 
 // --------------------------------------------------------
 // Draws the point lights as solid color spheres
 // --------------------------------------------------------
-void Game::DrawPointLights()
+void Game::DrawPointLights(RenderSnapshot* snapshot)
 {
 	// Turn on these shaders
 	lightVS->SetShader();
 	lightPS->SetShader();
 
 	// Set up vertex shader
-	lightVS->SetMatrix4x4("view", playersData->cams[0].viewMatrix);
-	lightVS->SetMatrix4x4("projection", playersData->cams[0].projMatrix);
+	lightVS->SetMatrix4x4("view", snapshot->camera.viewMatrix);
+	lightVS->SetMatrix4x4("projection", snapshot->camera.projMatrix);
 
-	for (int i = 0; i < lightCount; i++)
+	for (int i = 0; i < snapshot->lightCount; i++)
 	{
-		Light light = lights[i];
+		Light light = snapshot->lights[i];
 
 		// Only drawing points, so skip others
 		if (light.Type != LIGHT_TYPE_POINT)
@@ -923,62 +1971,142 @@ void Game::DrawPointLights()
 }
 
 /// <summary>
-/// Regenerate the light view matrix and other directional
-/// light data   
+/// Fits the directional light's shadow cascades to the
+/// player camera. Called every frame since both the camera
+/// and the light can move
 /// </summary>
-void Game::OnWorldLightChange()
+void Game::FitCascades(RenderSnapshot* snapshot)
 {
-	XMFLOAT3 mainLightDir = lights[0].Direction;
-	XMVECTOR loadedDir = XMLoadFloat3(&mainLightDir);
-
-	XMMATRIX lightView = XMMatrixLookToLH(
-		-loadedDir * 20, // Position: "Backing up" 20 units from origin
-		loadedDir, // Direction: light's direction
-		XMVectorSet(0, 1, 0, 0)); // Up: World up vector (Y axis)
-
-	float lightProjectionSize = 15.0f; // Tweak for your scene!
-	XMMATRIX lightProjection = XMMatrixOrthographicLH(
-		lightProjectionSize,
-		lightProjectionSize,
-		1.0f,
-		100.0f);
-
-	XMStoreFloat4x4(&shadowViewMatrix, lightView);
-	XMStoreFloat4x4(&shadowProjectionMatrix, lightProjection);
+	Camera& camera = playersData->cams[0];
+
+	ShadowCascadeCamera view = {};
+	XMFLOAT3 position = camera.transform.GetPosition();
+	XMFLOAT3 right = camera.transform.GetRight();
+	XMFLOAT3 up = camera.transform.GetUp();
+	XMFLOAT3 forward = camera.transform.GetForward();
+	memcpy(view.position, &position, sizeof(view.position));
+	memcpy(view.right, &right, sizeof(view.right));
+	memcpy(view.up, &up, sizeof(view.up));
+	memcpy(view.forward, &forward, sizeof(view.forward));
+	view.fieldOfView = camera.fieldOfView;
+	view.aspectRatio = camera.aspectRatio;
+	view.nearClip = camera.nearClip;
+	view.farClip = camera.farClip;
+	view.orthographic = camera.projectionType == CameraProjectionType::Orthographic;
+	view.orthographicWidth = camera.orthographicWidth;
+
+	cascadeSettings.snapTexels = shadowCacheEnabled ? SHADOW_CACHE_SNAP_TEXELS : 1;
+	snapshot->cascadeCount = FitShadowCascades(
+		view,
+		&lights[0].Direction.x,
+		cascadeSettings,
+		snapshot->cascades);
+
+	// The vertex shaders' single light matrix
+	// follows the closest cascade
+	memcpy(&snapshot->shadowViewMatrix, snapshot->cascades[0].view, sizeof(XMFLOAT4X4));
+	memcpy(&snapshot->shadowProjectionMatrix, snapshot->cascades[0].projection, sizeof(XMFLOAT4X4));
 }
 
 /// <summary>
-/// Distribute group of active entities into shader groups. 
-/// Used for reseting all entities or loading a scene 
+/// Debug shapes for whatever the Inspector has turned on.
+/// Cascades are drawn as they were just fitted for this frame
 /// </summary>
-void Game::GroupEntitiesByShaders()
+void Game::AddSceneDebugDraws(RenderSnapshot* snapshot)
 {
-	// Cleanup 
-	entityGroups.clear();
+	if (showCascadeBounds)
+	{
+		static const XMFLOAT4 cascadeColors[SHADOW_CASCADE_MAX_COUNT] =
+		{
+			XMFLOAT4(1, 0, 0, 1),
+			XMFLOAT4(0, 1, 0, 1),
+			XMFLOAT4(0, 0, 1, 1),
+			XMFLOAT4(1, 1, 0, 1)
+		};
 
+		for (int i = 0; i < snapshot->cascadeCount; i++)
+		{
+			XMFLOAT4X4 view;
+			XMFLOAT4X4 projection;
+			memcpy(&view, snapshot->cascades[i].view, sizeof(view));
+			memcpy(&projection, snapshot->cascades[i].projection, sizeof(projection));
+			AddDebugFrustum(&debugDrawData, view, projection, cascadeColors[i]);
+		}
+	}
 
-	std::unordered_map<std::shared_ptr<SimplePixelShader>, int> psToIndex;
-	for (auto entity : entities)
+	if (showLightRanges)
 	{
-		// Current entity shaders 
-		std::shared_ptr<SimplePixelShader> ps =
-			nameToPS[entity->GetMaterial()->psName];
-		std::shared_ptr<SimpleVertexShader> vs =
-			nameToVS[entity->GetMaterial()->vsName];
+		for (int i = 0; i < lightCount; i++)
+		{
+			Light& light = lights[i];
+			if (light.Type != LIGHT_TYPE_POINT)
+				continue;
+
+			AddDebugSphere(
+				&debugDrawData,
+				light.Position,
+				light.Range,
+				XMFLOAT4(light.Color.x, light.Color.y, light.Color.z, 1));
+		}
+	}
 
-		// Check if pixel shader exists 
-		if (psToIndex.find(ps) == psToIndex.end())
+	if (labelEntities)
+	{
+		char label[32];
+		scene.ForEachChunk(COMPONENT_BIT(TransformComponent), [&](EntityChunk& chunk)
 		{
-			// Remember new ps index relation 
-			psToIndex.insert(
-				std::pair<std::shared_ptr<SimplePixelShader>, int>
-				(ps, entityGroups.size()));
+			TransformComponent* transforms = chunk.Get<TransformComponent>();
+			for (unsigned int i = 0; i < chunk.count; i++)
+			{
+				XMFLOAT3 position(transforms[i].position[0], transforms[i].position[1] + 0.75f, transforms[i].position[2]);
+				snprintf(label, sizeof(label), "Entity %u", chunk.ids[i].index);
+				AddDebugString(&debugDrawData, position, label, XMFLOAT4(1, 1, 1, 1));
+			}
+		});
+	}
 
-			// Add new entity group which all use this type of ps 
-			entityGroups.push_back(std::vector<std::shared_ptr<GameEntity>>());
+	if (labelLights)
+	{
+		char label[48];
+		for (int i = 0; i < lightCount; i++)
+		{
+			Light& light = lights[i];
+			if (light.Type != LIGHT_TYPE_POINT)
+				continue;
+
+			snprintf(label, sizeof(label), "Light %d\nRange %.1f", i, light.Range);
+			AddDebugString(
+				&debugDrawData,
+				light.Position,
+				label,
+				XMFLOAT4(light.Color.x, light.Color.y, light.Color.z, 1));
+		}
+	}
+
+	// Crosses left behind the camera that fade out of
+	// existence two seconds later
+	if (showCameraTrail)
+	{
+		XMFLOAT3 position = snapshot->cameraPosition;
+		position.y -= 0.5f;
+		AddDebugCross(&debugDrawData, position, XMFLOAT4(0, 1, 1, 1), 0.1f, 2.0f);
+	}
+
+	// A grid of short vertical lines, enough to see what
+	// the batch costs to fill, upload and draw at scale
+	if (debugLineStress)
+	{
+		const int side = 317;
+		debugDrawData.lines.Reserve(debugDrawData.lines.GetLineCount() + side * side);
+		for (int z = 0; z < side; z++)
+		{
+			for (int x = 0; x < side; x++)
+			{
+				XMFLOAT3 a(x * 0.25f - side * 0.125f, 0.0f, z * 0.25f - side * 0.125f);
+				XMFLOAT3 b(a.x, 0.2f + 0.1f * sinf(x * 0.1f + z * 0.1f + snapshot->totalTime), a.z);
+				AddDebugLine(&debugDrawData, a, b, XMFLOAT4(x / (float)side, 1, z / (float)side, 1));
+			}
 		}
-		
-		entityGroups[psToIndex[ps]].push_back(entity);
 	}
 }
 
@@ -1028,7 +2156,8 @@ void Game::BuildUI()
 	// Shadow map GUI
 	ImGui::Begin("Shadow map");
 	{
-		ImGui::Image(shadowSRV.Get(), ImVec2(512, 512));
+		ImGui::SliderInt("Cascade", &shadowMapUICascade, 0, SHADOW_CASCADE_MAX_COUNT - 1);
+		ImGui::Image(shadowPreviewSRV.Get(), ImVec2(512, 512));
 	}
 	ImGui::End();
 
@@ -1076,6 +2205,208 @@ void Game::BuildUI()
 			ImGui::TreePop();
 		}
 
+		// === Rendering ===
+		if (ImGui::TreeNode("Rendering"))
+		{
+			ImGui::Spacing();
+			ImGui::Checkbox("Multithreaded Recording", &multithreadedRendering);
+			ImGui::Text("Recording Workers: %d", renderJobs->GetWorkerCount());
+			ImGui::Text("Recording Jobs: %d", renderJobs->GetJobCount());
+			ImGui::Spacing();
+
+			// Frame pipeline
+			ImGui::Checkbox("Pipelined Frames", &pipelineSettings.pipelined);
+			ImGui::SliderInt("Snapshot Buffers", &pipelineSettings.snapshotCount, 2, FRAME_PIPELINE_MAX_SNAPSHOTS);
+			ImGui::Checkbox("Drop Stale Snapshots", &pipelineSettings.dropStaleSnapshots);
+			ImGui::Text("Latency: %d frame(s)", frameTimings.latencyFrames.load());
+			ImGui::Text("Dropped Snapshots: %llu", snapshots.GetDroppedCount());
+			ImGui::Spacing();
+
+			// Transient memory, which should settle at no
+			// allocations once every arena fits a frame
+			ImGui::Text("Heap Allocations: %u per frame (update %u, render %u)",
+				frameTimings.frameAllocations.load(),
+				frameTimings.updateAllocations.load(),
+				frameTimings.renderAllocations.load());
+			ImGui::Text("Update Arena: %.1f KB of %.1f KB last frame",
+				updateArenas.Previous().GetUsedBytes() / 1024.0f,
+				updateArenas.Previous().GetCapacity() / 1024.0f);
+			ImGui::Spacing();
+
+			// Per-stage timings
+			ImGui::Text("Update: %.3f ms", frameTimings.updateMS.load());
+			ImGui::Text("Snapshot Write: %.3f ms", frameTimings.snapshotWriteMS.load());
+			ImGui::Text("Update Wait: %.3f ms", frameTimings.updateWaitMS.load());
+			ImGui::Text("Record: %.3f ms", frameTimings.recordMS.load());
+			ImGui::Text("Submit: %.3f ms", frameTimings.submitMS.load());
+			ImGui::Text("Present: %.3f ms", frameTimings.presentMS.load());
+			ImGui::Text("Render Frame: %.3f ms", frameTimings.renderFrameMS.load());
+			ImGui::Spacing();
+
+			// Light clusters
+			ImGui::Checkbox("Clustered Point Lights", &clusteredLighting);
+			ImGui::Text("Clusters: %d x %d x %d", LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y, LIGHT_CLUSTERS_Z);
+			ImGui::Text("Cluster Light Indices: %u", clusterIndexCount.load());
+			ImGui::Text("Full Clusters: %u", clusterOverflowCount.load());
+			if (ImGui::Button("Benchmark 4096 Lights"))
+				clusterBenchmark = BenchmarkLightClusters(4096, 32, renderJobs->GetWorkerCount());
+			if (clusterBenchmark.lightCount > 0)
+			{
+				ImGui::Text("Serial: %.3f ms", clusterBenchmark.serialMS);
+				ImGui::Text("%u Workers: %.3f ms", clusterBenchmark.workerCount, clusterBenchmark.parallelMS);
+			}
+			ImGui::Spacing();
+
+			// Shadow cascades, shown as they were last fitted
+			ImGui::SliderInt("Shadow Cascades", &cascadeSettings.count, 1, SHADOW_CASCADE_MAX_COUNT);
+			ImGui::SliderFloat("Cascade Split Lambda", &cascadeSettings.splitLambda, 0.0f, 1.0f);
+			ImGui::SliderFloat("Shadow Distance", &cascadeSettings.shadowDistance, 5.0f, 100.0f);
+			{
+				Camera& camera = playersData->cams[0];
+				float splits[SHADOW_CASCADE_MAX_COUNT + 1];
+				float farClip = (std::min)(camera.farClip, cascadeSettings.shadowDistance);
+				ComputeCascadeSplits(camera.nearClip, farClip, cascadeSettings.count, cascadeSettings.splitLambda, splits);
+				for (int i = 0; i < cascadeSettings.count; i++)
+					ImGui::Text("Cascade %d: %.2f - %.2f, %u draws%s", i, splits[i], splits[i + 1],
+						cascadeDrawCounts[i].load(), cascadeCacheHits[i] ? " (cached)" : "");
+			}
+			ImGui::Spacing();
+
+			// Static shadow cache. Draws without the cache are
+			// what the same frame would have drawn with it off
+			ImGui::Checkbox("Static Shadow Cache", &shadowCacheEnabled);
+			{
+				unsigned int draws = 0;
+				unsigned int uncachedDraws = 0;
+				float recordMS = 0;
+				for (int i = 0; i < cascadeSettings.count; i++)
+				{
+					draws += cascadeDrawCounts[i];
+					uncachedDraws += cascadeUncachedDrawCounts[i];
+					recordMS += cascadeRecordMS[i];
+				}
+				ImGui::Text("Shadow Draws: %u (%u without cache)", draws, uncachedDraws);
+				ImGui::Text("Shadow Record: %.3f ms", recordMS);
+			}
+			ImGui::Spacing();
+
+			// Static batching. Draws without batching are what
+			// the same frame would have drawn with it off
+			ImGui::Checkbox("Static Batching", &staticBatching);
+			ImGui::Text("Scene Draws: %u (%u without batching)", sceneDrawCount, unbatchedDrawCount);
+			ImGui::Text("%u of %u Static Entities in %u Batches (built in %.3f ms)",
+				staticBatches.GetMergedCount(),
+				staticBatches.GetInstanceCount(),
+				staticBatches.GetBatchCount(),
+				staticBatches.GetBuildMS());
+			if (ImGui::Button("Benchmark 10k Instances"))
+				batchBenchmark = BenchmarkStaticBatching(10000, 4);
+			if (batchBenchmark.instanceCount > 0)
+			{
+				ImGui::Text("%u Draws Instead of %u, %u Batches", batchBenchmark.drawsAfter, batchBenchmark.drawsBefore, batchBenchmark.batchCount);
+				ImGui::Text("Build: %.3f ms, %u Vertices", batchBenchmark.buildMS, batchBenchmark.vertexCount);
+				ImGui::Text("Misplaced Vertices: %u", batchBenchmark.mismatches);
+			}
+			ImGui::Spacing();
+
+			// Debug lines
+			ImGui::Checkbox("Show Cascade Bounds", &showCascadeBounds);
+			ImGui::Checkbox("Show Light Ranges", &showLightRanges);
+			ImGui::Checkbox("Debug Line Stress (100k)", &debugLineStress);
+			ImGui::Text("Debug Lines: %u", debugLineCount.load());
+			ImGui::Text("Debug Line Upload: %.3f ms", debugLineUploadMS.load());
+			if (ImGui::Button("Benchmark 100k Debug Lines"))
+				debugLineBenchmark = BenchmarkDebugLines(100000, 32);
+			if (debugLineBenchmark.lineCount > 0)
+			{
+				ImGui::Text("Lines: %.3f ms", debugLineBenchmark.linesMS);
+				ImGui::Text("Spheres: %.3f ms", debugLineBenchmark.spheresMS);
+			}
+
+			// Timed debug items
+			ImGui::Checkbox("Camera Trail (2s)", &showCameraTrail);
+			ImGui::Text("Timed Debug Items: %zu (%zu lines)",
+				debugDrawData.timed.GetItemCount(),
+				debugDrawData.timed.GetLineCount());
+			if (ImGui::Button("Benchmark 100k Timed Debug Items"))
+				debugLifetimeBenchmark = BenchmarkDebugLifetimes(100000, 2.0f);
+			if (debugLifetimeBenchmark.itemCount > 0)
+			{
+				ImGui::Text("Add: %.3f ms", debugLifetimeBenchmark.addMS);
+				ImGui::Text("Expire: %.3f ms over %u frames (worst %.3f ms)",
+					debugLifetimeBenchmark.advanceMS,
+					debugLifetimeBenchmark.frames,
+					debugLifetimeBenchmark.worstAdvanceMS);
+			}
+
+			// Debug text
+			ImGui::Checkbox("Label Entities", &labelEntities);
+			ImGui::Checkbox("Label Lights", &labelLights);
+			ImGui::Text("Debug Glyphs: %u", debugGlyphCount);
+			ImGui::Text("Debug Text Build: %.3f ms", debugTextBuildMS);
+			ImGui::Text("Cached Layouts: %zu (%llu hits, %llu misses)",
+				debugDrawData.font.GetCachedLayoutCount(),
+				debugDrawData.font.GetCacheHits(),
+				debugDrawData.font.GetCacheMisses());
+			if (ImGui::Button("Benchmark 5000 Debug Labels"))
+				debugTextBenchmark = BenchmarkDebugText(debugDrawData.font, 5000, 32);
+			if (debugTextBenchmark.labelCount > 0)
+			{
+				ImGui::Text("Layout Lookup: %.3f ms", debugTextBenchmark.addMS);
+				ImGui::Text("Project: %.3f ms (%u glyphs)", debugTextBenchmark.buildMS, debugTextBenchmark.glyphCount);
+			}
+			ImGui::Spacing();
+
+			// Texture streaming
+			{
+				TextureStreamStats stats = streamedTextures->GetStats();
+				ImGui::SliderInt("Texture Budget (MB)", &textureBudgetMB, 8, 512);
+				ImGui::Text("Streamed Textures: %u (%u resident, %u loading)",
+					stats.textureCount, stats.residentCount, stats.pendingCount);
+				ImGui::Text("Texture Memory: %.1f MB (%.1f MB at full size)",
+					stats.residentBytes / 1048576.0f, stats.fullBytes / 1048576.0f);
+				ImGui::Text("Mip Loads: %llu, Evictions: %llu", stats.loads, stats.evictions);
+			}
+			if (ImGui::Button("Simulate Texture Streaming"))
+			{
+				TextureStreamingSimSettings settings = { 40, 2048, (size_t)textureBudgetMB * 1024 * 1024, 1200, 3 };
+				textureStreamingSim = SimulateTextureStreaming(settings);
+			}
+			if (textureStreamingSim.fullBytes > 0)
+			{
+				ImGui::Text("Peak: %.1f MB of %.1f MB, %u frame(s) over budget",
+					textureStreamingSim.peakResidentBytes / 1048576.0f,
+					textureStreamingSim.fullBytes / 1048576.0f,
+					textureStreamingSim.overBudgetFrames);
+				ImGui::Text("Loads: %llu, Evictions: %llu", textureStreamingSim.loads, textureStreamingSim.evictions);
+				ImGui::Text("Mip Deficit: %.2f, Update: %.4f ms",
+					textureStreamingSim.averageMipDeficit, textureStreamingSim.updateMS);
+			}
+			ImGui::Spacing();
+
+			// Sky lighting
+			ImGui::Text("Sky Bake: %.1f ms (%s)", sky->GetBakeMS(), sky->WasBakeCached() ? "cached" : "baked");
+			ImGui::Spacing();
+
+			// Finalize the tree node
+			ImGui::TreePop();
+		}
+
+		// === Assets ===
+		if (ImGui::TreeNode("Assets"))
+		{
+			ImGui::Spacing();
+			AssetPoolUI("Vertex Shaders", assets.vertexShaders);
+			AssetPoolUI("Pixel Shaders", assets.pixelShaders);
+			AssetPoolUI("Meshes", assets.meshes);
+			AssetPoolUI("Textures", assets.textures);
+			AssetPoolUI("Materials", assets.materials);
+			ImGui::Spacing();
+
+			// Finalize the tree node
+			ImGui::TreePop();
+		}
+
 		// === Camera details ===
 		if (ImGui::TreeNode("Camera"))
 		{
@@ -1089,22 +2420,194 @@ void Game::BuildUI()
 		// === Entities ===
 		if (ImGui::TreeNode("Scene Entities"))
 		{
+			ImGui::Text("Entities: %u", scene.GetEntityCount());
+			ImGui::Text("Archetypes: %u", scene.GetArchetypeCount());
+			ImGui::Text("Chunks: %u (%d entities each)", scene.GetChunkCount(), ENTITY_CHUNK_CAPACITY);
+
+			// Iteration against a list of shared_ptr entities,
+			// the way the scene was kept before the store
+			if (ImGui::Button("Benchmark 10k")) entityBenchmark = BenchmarkEntityIteration(10000, 32);
+			ImGui::SameLine();
+			if (ImGui::Button("100k")) entityBenchmark = BenchmarkEntityIteration(100000, 8);
+			ImGui::SameLine();
+			if (ImGui::Button("1M")) entityBenchmark = BenchmarkEntityIteration(1000000, 4);
+			if (entityBenchmark.entityCount > 0)
+			{
+				ImGui::Text("%u Entities", entityBenchmark.entityCount);
+				ImGui::Text("shared_ptr List: %.3f ms", entityBenchmark.sharedListMS);
+				ImGui::Text("Store: %.3f ms", entityBenchmark.storeMS);
+			}
+			ImGui::Spacing();
+
+			// Spawning
+			if (projectilePool)
+			{
+				ImGui::Text("Projectiles: %u / %u (%u turned away)",
+					projectilePool->GetLiveCount(),
+					projectilePool->GetCapacity(),
+					projectilePool->GetRejectedCount());
+			}
+			if (ImGui::Button("Benchmark 10k Spawns per Second"))
+				spawnBenchmark = BenchmarkEntitySpawning(10000, 5.0f);
+			if (spawnBenchmark.frames > 0)
+			{
+				ImGui::Text("%u Frames, %u Alive", spawnBenchmark.frames, spawnBenchmark.liveEntities);
+				ImGui::Text("Frame: %.3f ms (worst %.3f ms)", spawnBenchmark.frameMS, spawnBenchmark.worstFrameMS);
+				ImGui::Text("Heap Allocations After Warmup: %llu", spawnBenchmark.steadyAllocations);
+			}
+			ImGui::Spacing();
+
+			// Level collision
+			ImGui::Text("Collision: %u Triangles, %u Nodes (built in %.3f ms)",
+				levelCollision.GetTriangleCount(),
+				levelCollision.GetNodeCount(),
+				levelCollision.GetBuildMS());
+			ImGui::Text("Player %s, Falling at %.2f",
+				playersData->grounded[0] ? "Grounded" : "In the Air",
+				-playersData->fallSpeeds[0]);
+			if (ImGui::Button("Benchmark 4096 Players"))
+				collisionBenchmark = BenchmarkCapsuleMoves(levelCollision, 4096, 120);
+			if (collisionBenchmark.ticks > 0)
+			{
+				ImGui::Text("%u Players, %u Ticks", collisionBenchmark.playerCount, collisionBenchmark.ticks);
+				ImGui::Text("Tick: %.3f ms (%.0f moves per ms)", collisionBenchmark.tickMS, collisionBenchmark.movesPerMS);
+				ImGui::Text("%u Grounded, %u Fell Through", collisionBenchmark.groundedPlayers, collisionBenchmark.escapedPlayers);
+			}
+			ImGui::Spacing();
+
+			// Spatial queries
+			ImGui::Text("Query Index: %u Entities, %u Nodes (built in %.3f ms)",
+				spatialIndex.GetEntityCount(),
+				spatialIndex.GetNodeCount(),
+				spatialIndex.GetBuildMS());
+			if (lastWandHitSomething)
+				ImGui::Text("Last Wand Shot: %s %u at %.2f",
+					lastWandHit.level ? "Level Entity" : "Entity",
+					lastWandHit.entity.index,
+					lastWandHit.distance);
+			else
+				ImGui::Text("Last Wand Shot: Nothing");
+			ImGui::Text("Last Sword Swing: %u Hits", lastSwingHits);
+			if (ImGui::Button("Benchmark 4096 Queries over 10k Entities"))
+				queryBenchmark = BenchmarkSpatialQueries(10000, 4096, renderJobs->GetWorkerCount());
+			if (queryBenchmark.queryCount > 0)
+			{
+				ImGui::Text("Tree Build: %.3f ms", queryBenchmark.buildMS);
+				ImGui::Text("Brute Force: %.3f ms", queryBenchmark.bruteForceMS);
+				ImGui::Text("Serial: %.3f ms", queryBenchmark.serialMS);
+				ImGui::Text("%u Workers: %.3f ms (%.0f queries per ms)",
+					queryBenchmark.workerCount, queryBenchmark.parallelMS, queryBenchmark.queriesPerMS);
+				ImGui::Text("Differences from Brute Force: %u", queryBenchmark.mismatches);
+			}
+			ImGui::Spacing();
+
+			// Dungeon
+			ImGui::Text("Dungeon: Seed %u, %ux%u Tiles, %u Rooms",
+				dungeon.GetSettings().seed,
+				dungeon.GetSettings().width,
+				dungeon.GetSettings().depth,
+				dungeon.GetRoomCount());
+			ImGui::Text("%u Chunks, %u Triangles (laid out in %.3f ms)",
+				dungeon.GetChunkCount(),
+				dungeon.GetTriangleCount(),
+				dungeon.GetLayoutMS());
+			if (ImGui::Button("Benchmark 512x512 Tiles"))
+				dungeonBenchmark = BenchmarkDungeon(512, dungeon.GetSettings().seed, simulationJobs->GetWorkerCount());
+			if (dungeonBenchmark.tiles > 0)
+			{
+				ImGui::Text("%u Rooms, %u Floor Tiles, %u Triangles in %u Chunks",
+					dungeonBenchmark.rooms, dungeonBenchmark.floorTiles, dungeonBenchmark.triangles, dungeonBenchmark.chunks);
+				ImGui::Text("Layout: %.3f ms", dungeonBenchmark.layoutMS);
+				ImGui::Text("Serial Chunks: %.3f ms", dungeonBenchmark.serialChunksMS);
+				ImGui::Text("%u Workers: %.3f ms", dungeonBenchmark.workerCount, dungeonBenchmark.parallelChunksMS);
+				ImGui::Text("%s", dungeonBenchmark.deterministic ? "Both Builds Match" : "Builds Differ!");
+			}
+			ImGui::Spacing();
+
+			// Navigation
+			ImGui::Text("Navigation: %u Polygons, %u Links (built in %.3f ms)",
+				navMesh.GetPolyCount(),
+				navMesh.GetLinkCount(),
+				navMesh.GetBuildMS());
+			ImGui::Text("%u Spans, %u Walkable Cells", navMesh.GetSpanCount(), navMesh.GetWalkableCellCount());
+			ImGui::Text("%u Enemies, %u Paths Waiting", (unsigned int)enemiesData.agents.size(), pathQueue->GetPendingCount());
+			if (ImGui::Button("Benchmark 400 Agents"))
+				navBenchmark = BenchmarkNavigation(
+					levelCollision.GetTriangles(), levelCollision.GetTriangleCount(),
+					400, 8, renderJobs->GetWorkerCount());
+			if (navBenchmark.pathCount > 0)
+			{
+				ImGui::Text("Build: %.3f ms, %u Polygons", navBenchmark.buildMS, navBenchmark.polyCount);
+				ImGui::Text("%u Paths, %u Unreached", navBenchmark.pathCount, navBenchmark.unreachedPaths);
+				ImGui::Text("%u Corners, %u Polygons Visited a Path", navBenchmark.averageCorners, navBenchmark.averagePolysVisited);
+				ImGui::Text("Serial: %.0f paths/s", navBenchmark.serialPathsPerSecond);
+				ImGui::Text("%u Workers: %.0f paths/s (%u ticks)",
+					navBenchmark.workerCount, navBenchmark.parallelPathsPerSecond, navBenchmark.parallelTicks);
+			}
+			ImGui::Spacing();
+
+			// Crowds
+			ImGui::Text("Crowd: %u Agents", crowd.GetAgentCount());
+			if (ImGui::Button("Benchmark 5000 Agents"))
+				crowdBenchmark = BenchmarkCrowd(5000, 120, simulationJobs->GetWorkerCount());
+			if (crowdBenchmark.ticks > 0)
+			{
+				ImGui::Text("%u Agents, %u Ticks", crowdBenchmark.agentCount, crowdBenchmark.ticks);
+				ImGui::Text("Serial: %.3f ms a tick", crowdBenchmark.serialTickMS);
+				ImGui::Text("%u Workers: %.3f ms a tick", crowdBenchmark.workerCount, crowdBenchmark.parallelTickMS);
+				ImGui::Text("%u Overlapping, Moving at %.2f m/s", crowdBenchmark.overlaps, crowdBenchmark.averageSpeed);
+			}
+			ImGui::Spacing();
+
+			// Networking
+			ImGui::Text("Networking: %d Ticks a Second, %d Players a Snapshot", NET_TICK_RATE, NET_SNAPSHOT_PLAYERS);
+			if (ImGui::Button("Benchmark 64 Clients on Loopback"))
+				netBenchmark = BenchmarkNetServer(64, 150);
+			if (netBenchmark.ticks > 0)
+			{
+				ImGui::Text("%u of %u Clients Connected, %u Ticks", netBenchmark.connected, netBenchmark.clientCount, netBenchmark.ticks);
+				ImGui::Text("Snapshots: %.1f bytes a client a tick (%.1f whole)",
+					netBenchmark.snapshotBytesPerClientTick, netBenchmark.wholeSnapshotBytesPerClientTick);
+				ImGui::Text("Inputs: %.1f bytes a client a tick", netBenchmark.inputBytesPerClientTick);
+				ImGui::Text("Server: %.3f ms a tick, %.2f us a player", netBenchmark.serverTickMS, netBenchmark.serverMicrosecondsPerPlayer);
+				ImGui::Text("Mismatched Players: %u", netBenchmark.mismatches);
+			}
+			if (ImGui::Button("Benchmark Prediction, 100 ms and 5% Loss"))
+			{
+				NetLinkSettings link = { 0.1f, 0.03f, 0.05f, 3 };
+				predictionBenchmark = BenchmarkPrediction(link, 600);
+			}
+			if (predictionBenchmark.ticks > 0)
+			{
+				const NetCorrectionStats& c = predictionBenchmark.corrections;
+				ImGui::Text("%u Snapshots, %.1f Inputs Ahead of the Server", c.checks, predictionBenchmark.averageReplaySteps);
+				ImGui::Text("%u Corrections (%u Shoves, %u Snapped)", c.corrections, predictionBenchmark.pushes, c.snaps);
+				ImGui::Text("Correction: %.3f m average, %.3f m largest",
+					c.corrections > 0 ? c.total / c.corrections : 0.0f, c.largest);
+				ImGui::Text("Largest Smoothed Step: %.3f m a frame", predictionBenchmark.largestDisplayStep);
+			}
+			ImGui::Spacing();
+
 			// Loop and show the details for each entity
-			for (int i = 0; i < entities.size(); i++)
+			scene.ForEachChunk(0, [&](EntityChunk& chunk)
 			{
-				// New node for each entity
-				// Note the use of PushID(), so that each tree node and its widgets
-				// have unique internal IDs in the ImGui system
-				ImGui::PushID(i);
-				if (ImGui::TreeNode("Entity Node", "Entity %d", i))
+				for (unsigned int i = 0; i < chunk.count; i++)
 				{
-					// Build UI for one entity at a time
-					EntityUI(entities[i]);
-
-					ImGui::TreePop();
+					// New node for each entity
+					// Note the use of PushID(), so that each tree node and its widgets
+					// have unique internal IDs in the ImGui system
+					EntityId id = chunk.ids[i];
+					ImGui::PushID((int)id.index);
+					if (ImGui::TreeNode("Entity Node", "Entity %u", id.index))
+					{
+						// Build UI for one entity at a time
+						EntityUI(id);
+
+						ImGui::TreePop();
+					}
+					ImGui::PopID();
 				}
-				ImGui::PopID();
-			}
+			});
 
 			// Finalize the tree node
 			ImGui::TreePop();
@@ -1209,23 +2712,40 @@ void Game::CameraUI(std::shared_ptr<FreeCamera> cam)
 // --------------------------------------------------------
 // Builds the UI for a single entity
 // --------------------------------------------------------
-void Game::EntityUI(std::shared_ptr<GameEntity> entity)
+void Game::EntityUI(EntityId id)
 {
 	ImGui::Spacing();
 
 	// Transform details
-	Transform* trans = entity->GetTransform();
-	XMFLOAT3 pos = trans->GetPosition();
-	XMFLOAT3 rot = trans->GetPitchYawRoll();
-	XMFLOAT3 sca = trans->GetScale();
-
-	if (ImGui::DragFloat3("Position", &pos.x, 0.01f)) trans->SetPosition(pos);
-	if (ImGui::DragFloat3("Rotation (Radians)", &rot.x, 0.01f)) trans->SetRotation(rot);
-	if (ImGui::DragFloat3("Scale", &sca.x, 0.01f)) trans->SetScale(sca);
+	TransformComponent* trans = scene.Get<TransformComponent>(id);
+	if (trans)
+	{
+		if (ImGui::DragFloat3("Position", trans->position, 0.01f)) trans->dirty = true;
+		if (ImGui::DragFloat3("Rotation (Radians)", trans->pitchYawRoll, 0.01f)) trans->dirty = true;
+		if (ImGui::DragFloat3("Scale", trans->scale, 0.01f)) trans->dirty = true;
+	}
 
 	// Mesh details
-	ImGui::Spacing();
-	ImGui::Text("Mesh Index Count: %d", entity->GetMesh()->GetIndexCount());
+	RenderComponent* render = scene.Get<RenderComponent>(id);
+	if (render)
+	{
+		ImGui::Spacing();
+		ImGui::Text("Mesh Index Count: %d", assets.meshes.Get(render->mesh)->GetIndexCount());
+		ImGui::Checkbox("Casts Shadows", &render->castsShadows);
+	}
+
+	// Moving a static entity is allowed, it just
+	// redraws every cached shadow it is in
+	MobilityComponent* mobility = scene.Get<MobilityComponent>(id);
+	if (mobility)
+	{
+		ImGui::Spacing();
+		if (ImGui::RadioButton("Static", mobility->mobility == EntityMobility::Static))
+			mobility->mobility = EntityMobility::Static;
+		ImGui::SameLine();
+		if (ImGui::RadioButton("Dynamic", mobility->mobility == EntityMobility::Dynamic))
+			mobility->mobility = EntityMobility::Dynamic;
+	}
 
 	ImGui::Spacing();
 }
@@ -1282,4 +2802,26 @@ void Game::LightUI(Light& light)
 	ImGui::SliderFloat("Intensity", &light.Intensity, 0.0f, 10.0f);
 }
 
+// --------------------------------------------------------
+// Builds the UI for one type of asset: totals, then every
+// loaded asset with its reference count and memory
+// --------------------------------------------------------
+template<typename T>
+void Game::AssetPoolUI(const char* label, const AssetPool<T>& pool)
+{
+	AssetPoolStats stats = pool.GetStats();
+	if (ImGui::TreeNode(label, "%s: %u (%u in use), %.1f KB", label, stats.count, stats.referenced, stats.bytes / 1024.0f))
+	{
+		for (auto& slot : pool.GetSlots())
+		{
+			if (!slot.asset)
+				continue;
+
+			ImGui::Text("%s", assets.GetName(slot.id).c_str());
+			ImGui::SameLine(200); ImGui::Text("refs %u", slot.refCount);
+			ImGui::SameLine(275); ImGui::Text("%.1f KB", slot.bytes / 1024.0f);
+		}
 
+		ImGui::TreePop();
+	}
+}
@@ -2,7 +2,15 @@
 
 #include "DXCore.h"
 #include "Mesh.h"
-#include "GameEntity.h"
+#include "EntityStore.h"
+#include "EntityPool.h"
+#include "Collision.h"
+#include "SpatialQuery.h"
+#include "NavMesh.h"
+#include "Crowd.h"
+#include "Dungeon.h"
+#include "StaticBatch.h"
+#include "NetPrediction.h"
 #include "Camera.h"
 #include "SimpleShader.h"
 #include "Lights.h"
@@ -14,9 +22,21 @@
 #include <map>
 
 #include "Player.h"
+#include "Enemy.h"
 
 #include "DebugDrawManager.h"
 #include "ShaderHelper.h"
+#include "RenderJobGraph.h"
+#include "FramePipeline.h"
+#include "RenderSnapshot.h"
+#include "AssetRegistry.h"
+#include "LightClusters.h"
+#include "ShadowCascades.h"
+#include "StreamedTextures.h"
+#include "FrameArena.h"
+
+#include <thread>
+#include <mutex>
 
 class Game 
 	: public DXCore
@@ -31,20 +51,90 @@ public:
 	void Init();
 	void OnResize();
 	void Update(float deltaTime, float totalTime);
-	void DrawShadowMap();
+	void DrawShadowMap(ID3D11DeviceContext* ctx, RenderSnapshot* snapshot, int cascade);
 	void Draw(float deltaTime, float totalTime);
 
 private:
 
-	// Our scene
-	std::vector<std::shared_ptr<GameEntity>> entities;
-	std::vector<std::vector<std::shared_ptr<GameEntity>>> shaderSplitEntityList;
+	// Our scene. Entities are added and removed at the
+	// start of Update, never in the middle of a frame
+	EntityStore scene;
+	EntityIterationBenchmark entityBenchmark;
+	void UpdateEntityTransforms();
+
+	// Spawned entities, a pool per kind sized for the
+	// most of that kind alive at once
+	std::unique_ptr<EntityPool> projectilePool;
+	float projectileCooldown;
+	EntitySpawnBenchmark spawnBenchmark;
 	bool updateMouseDelta; 
 
+	// Static entities' triangles, for keeping players out
+	// of walls. Built once the level's entities are made
+	LevelCollision levelCollision;
+	CollisionBenchmark collisionBenchmark;
+	void BuildLevelCollision();
+
+	// Triangles of meshes made in code rather than read from
+	// an .obj, by mesh index
+	std::map<unsigned int, Span<const float>> generatedCollision;
+
+	// Rooms and corridors laid out from a seed, a static
+	// entity for every chunk of tiles
+	Dungeon dungeon;
+	DungeonBenchmark dungeonBenchmark;
+	void GenerateDungeon();
+
+	// Static entities drawn the same way, merged into a mesh
+	// a chunk of the world and drawn in their place while
+	// staticBatching is on
+	struct StaticDrawBatch
+	{
+		PixelShaderHandle ps;
+		SnapshotEntity entity;
+	};
+	StaticBatches staticBatches;
+	std::vector<StaticDrawBatch> staticDrawBatches;
+	StaticBatchBenchmark batchBenchmark;
+	bool staticBatching;
+	unsigned int sceneDrawCount;
+	unsigned int unbatchedDrawCount;		// What the same frame would draw without batches
+	void BuildStaticBatches();
+
+	// What wand shots and sword swings hit, asked of an
+	// index rebuilt once entities have moved each frame
+	SpatialIndex spatialIndex;
+	QueryBatch combatQueries;
+	SpatialQueryBenchmark queryBenchmark;
+	float swingCooldown;
+	QueryHit lastWandHit;
+	bool lastWandHitSomething;
+	unsigned int lastSwingHits;
+
+	// Walkable polygons built from the level's collision,
+	// and skeletons finding their way to the player over them
+	// as a crowd. Paths and steering run on the simulation
+	// workers, the update thread's own job graph, since the
+	// render thread's may be recording while Update runs
+	NavMesh navMesh;
+	std::unique_ptr<NavPathQueue> pathQueue;
+	NavBenchmark navBenchmark;
+	Crowd crowd;
+	CrowdBenchmark crowdBenchmark;
+	EnemiesData enemiesData;
+	std::unique_ptr<RenderJobGraph> simulationJobs;
+	void BuildNavigation();
+
+	// A headless server stepping players the way the game
+	// does, and bots on loopback to measure it with, one
+	// predicting its own moves through a simulated bad link
+	NetBenchmark netBenchmark;
+	NetPredictionBenchmark predictionBenchmark;
+
 	// Player
 	std::shared_ptr<PlayersData> playersData;
-	std::shared_ptr<GameEntity> swordEntity;
-	std::shared_ptr<GameEntity> wandEntity;
+	EntityId swordEntity;
+	EntityId wandEntity;
 
 	// Lights
 	std::vector<Light> lights;
@@ -57,25 +147,24 @@ private:
 	std::shared_ptr<SimpleVertexShader> lightVS;
 	std::shared_ptr<SimplePixelShader> lightPS;
 
-	// Shaders 
-	std::unordered_map<const wchar_t*, std::shared_ptr<SimpleVertexShader>> nameToVS;
-	std::unordered_map<const wchar_t*, std::shared_ptr<SimplePixelShader>> nameToPS;
-	std::unordered_map<const wchar_t*, std::shared_ptr<RendMat>> nameToMat;
-	void AddVS(const wchar_t* name, VertexShaders linkedEnum);
-	void AddPS(const wchar_t* name, PixelShaders linkedEnum);
-	void AddMat(
-		std::shared_ptr<RendMat> mat,
-		const wchar_t* matName);
-
-	// Entities grouped by shader type 
-	// Group 1 is PixelShader
-	// Group 2 is VertexShader
-	std::vector<std::vector<std::shared_ptr<GameEntity>>> entityGroups;
-	std::unordered_map<const wchar_t*, PixelShaders>  psNameToID;
-	std::unordered_map<const wchar_t*, VertexShaders> vsNameToID;
-	void GroupEntitiesByShaders();
-	void AddEntities();
-	void RemoveEntities();
+	// Shaders, meshes, textures and materials
+	AssetRegistry assets;
+	void AddVS(const wchar_t* name);
+	void AddPS(const wchar_t* name);
+	void AddMesh(const wchar_t* name);
+	EntityDesc DescribeEntity(
+		AssetID mesh,
+		AssetID material,
+		bool castsShadows,
+		EntityMobility mobility);
+	EntityId MakeEntity(
+		AssetID mesh,
+		AssetID material,
+		DirectX::XMFLOAT3 position,
+		DirectX::XMFLOAT3 pitchYawRoll,
+		float scale,
+		bool castsShadows = true,
+		EntityMobility mobility = EntityMobility::Static);
 
 
 	// Texture related resources
@@ -84,39 +173,149 @@ private:
 	// Skybox
 	std::shared_ptr<Sky> sky;
 
-	// Shadow Mapping  
-	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowDSV;
+	// Shadow Mapping. The directional light's shadow is a
+	// texture array with one slice per cascade, refitted
+	// to the player camera every frame
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> shadowTexture;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowDSVs[SHADOW_CASCADE_MAX_COUNT];
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowTextureSRV;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV;
-	DirectX::XMFLOAT4X4 shadowViewMatrix;
-	DirectX::XMFLOAT4X4 shadowProjectionMatrix;
 
 	Microsoft::WRL::ComPtr<ID3D11RasterizerState> shadowRasterizer;
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> shadowSampler;
 
 	const int SHADOW_MAP_RESOLUTION = 2048;
 
-	
+	ShadowCascadeSettings cascadeSettings;
+	int shadowMapUICascade;
+
+	// ImGui can only show plain 2D textures, so the
+	// cascade being looked at is copied out to this
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> shadowPreviewTexture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowPreviewSRV;
+
+	// Static shadow cache. Static casters are drawn into a
+	// copy of each cascade that is only redrawn when the
+	// cascade moves or the static casters change. Every
+	// frame starts from that copy and adds the dynamic ones
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> shadowCacheTexture;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowCacheDSVs[SHADOW_CASCADE_MAX_COUNT];
+	ShadowCascadeCache shadowCaches[SHADOW_CASCADE_MAX_COUNT];
+	bool shadowCacheEnabled;
+
+	// Cascades move in steps this many texels wide while
+	// caching, so walking does not redraw them every frame
+	const unsigned int SHADOW_CACHE_SNAP_TEXELS = 32;
+
+	// Per cascade cost of the last frame, written by
+	// whichever worker recorded the cascade
+	std::atomic<unsigned int> cascadeDrawCounts[SHADOW_CASCADE_MAX_COUNT];
+	std::atomic<unsigned int> cascadeUncachedDrawCounts[SHADOW_CASCADE_MAX_COUNT];
+	std::atomic<bool> cascadeCacheHits[SHADOW_CASCADE_MAX_COUNT];
+	std::atomic<float> cascadeRecordMS[SHADOW_CASCADE_MAX_COUNT];
+	void FitCascades(RenderSnapshot* snapshot);
+
+	// Multithreaded recording. Each job records into its
+	// own deferred context and the resulting command lists
+	// are executed in job order on the immediate context
+	std::unique_ptr<RenderJobGraph> renderJobs;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11DeviceContext>> deferredContexts;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11CommandList>> commandLists;	// By job
+	unsigned int recordingJobCount;		// Jobs this frame that record, one deferred context each
+	bool multithreadedRendering;
+	bool recordDeferred;
+	void BuildRenderJobs(RenderSnapshot* snapshot);
+	unsigned int AddRecordingJob(
+		const char* name,
+		std::function<void(ID3D11DeviceContext*)> record,
+		Span<const unsigned int> dependencies = Span<const unsigned int>());
+	D3D11_VIEWPORT GetMainViewport();
+
+	// Clustered lighting. Point and spot lights are binned
+	// on the recording workers and uploaded as structured
+	// buffers before any shader group draws
+	LightClusters lightClusters;
+	LightClusterShaderParams clusterParams;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> clusterLightBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> clusterRangeBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> clusterIndexBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> clusterLightSRV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> clusterRangeSRV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> clusterIndexSRV;
+	bool clusteredLighting;
+	std::atomic<unsigned int> clusterIndexCount;
+	std::atomic<unsigned int> clusterOverflowCount;
+	LightClusterBenchmark clusterBenchmark;
+	void CreateLightClusterBuffers();
+	void AddLightClusterJobs(RenderSnapshot* snapshot);
+
+	// Texture streaming. Material textures start as stand-ins
+	// and get their mips by size on screen, loaded on worker
+	// threads and kept within a memory budget
+	std::unique_ptr<StreamedTextures> streamedTextures;
+	int textureBudgetMB;
+	TextureStreamingSimResult textureStreamingSim;
+	void RequestStreamedTextures(RenderSnapshot* snapshot);
+
+	// Frame pipeline. Update publishes a snapshot of the
+	// frame and the render thread draws it
+	SnapshotRing<RenderSnapshot> snapshots;
+	FramePipelineSettings pipelineSettings;
+	FramePipelineSettings appliedPipelineSettings;
+	FrameStageTimings frameTimings;
+	std::thread renderThread;
+	std::atomic<bool> renderThreadRunning;
+	std::mutex deviceMutex;
+	void PublishSnapshot(float deltaTime, float totalTime);
+	bool RenderNextSnapshot();
+	void DrawSnapshot(RenderSnapshot* snapshot);
+	void RenderThreadLoop();
+	void StartRenderThread();
+	void StopRenderThread();
+	void ApplyPipelineSettings();
+
+	// Transient per-frame memory. Update alternates between
+	// two arenas so last frame's data outlives it by a frame,
+	// the render thread's only lives while its jobs record
+	FrameArenaPair updateArenas;
+	FrameArena renderArena;
+	unsigned long long lastFrameAllocationCount;
 
 
 	// General helpers for setup and drawing
 	void LoadAssetsAndCreateEntities();
 	void GenerateLights();
 	void GenerateShadowData();
-	void DrawPointLights();
-	void OnWorldLightChange(); 
+	void DrawPointLights(RenderSnapshot* snapshot);
 
 	// UI functions
 	void UINewFrame(float deltaTime);
 	void BuildUI();
 	void CameraUI(std::shared_ptr<FreeCamera> cam);
-	void EntityUI(std::shared_ptr<GameEntity> entity);
+	void EntityUI(EntityId id);
 	void LightUI(Light& light);
+	template<typename T>
+	void AssetPoolUI(const char* label, const AssetPool<T>& pool);
 	
 	// Should the ImGui demo window be shown?
 	bool showUIDemoWindow;
 
-	// Debug Drawing
+	// Debug Drawing. Lines from the whole frame go to the
+	// render thread with the snapshot and draw in one call
 	DebugDrawData debugDrawData; 
+	bool showCascadeBounds;
+	bool showLightRanges;
+	bool debugLineStress;
+	bool showCameraTrail;
+	bool labelEntities;
+	bool labelLights;
+	std::atomic<unsigned int> debugLineCount;
+	std::atomic<float> debugLineUploadMS;
+	DebugLineBenchmark debugLineBenchmark;
+	DebugLifetimeBenchmark debugLifetimeBenchmark;
+	DebugTextBenchmark debugTextBenchmark;
+	unsigned int debugGlyphCount;
+	float debugTextBuildMS;
+	void AddSceneDebugDraws(RenderSnapshot* snapshot);
 };
 
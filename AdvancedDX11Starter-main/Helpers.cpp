@@ -1,5 +1,7 @@
 
 #include <Windows.h>
+#include <wincodec.h>
+#include <wrl/client.h>
 #include <codecvt>
 #include <locale>
 
@@ -86,3 +88,39 @@ std::wstring NarrowToWide(const std::string& str)
 	std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
 	return converter.from_bytes(str);
 }
+
+
+// ----------------------------------------------------
+//  Helper function for decoding an image file to
+//  tightly packed RGBA8 on the CPU, for anything that
+//  is built from images before it reaches the GPU
+// ----------------------------------------------------
+bool ReadImageRGBA(const std::wstring& path, std::vector<unsigned char>& rgba, unsigned int* width, unsigned int* height)
+{
+	// Balanced here, whether or not COM was already started
+	HRESULT comResult = CoInitializeEx(0, COINIT_MULTITHREADED);
+
+	bool read = false;
+	{
+		Microsoft::WRL::ComPtr<IWICImagingFactory> factory;
+		Microsoft::WRL::ComPtr<IWICBitmapDecoder> decoder;
+		Microsoft::WRL::ComPtr<IWICBitmapFrameDecode> frame;
+		Microsoft::WRL::ComPtr<IWICFormatConverter> converter;
+		if (SUCCEEDED(CoCreateInstance(CLSID_WICImagingFactory, 0, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(factory.GetAddressOf()))) &&
+			SUCCEEDED(factory->CreateDecoderFromFilename(
+				path.c_str(), 0, GENERIC_READ, WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf())) &&
+			SUCCEEDED(decoder->GetFrame(0, frame.GetAddressOf())) &&
+			SUCCEEDED(frame->GetSize(width, height)) &&
+			SUCCEEDED(factory->CreateFormatConverter(converter.GetAddressOf())) &&
+			SUCCEEDED(converter->Initialize(
+				frame.Get(), GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, 0, 0, WICBitmapPaletteTypeCustom)))
+		{
+			rgba.resize((size_t)*width * *height * 4);
+			read = SUCCEEDED(converter->CopyPixels(0, *width * 4, (unsigned int)rgba.size(), rgba.data()));
+		}
+	}
+
+	if (SUCCEEDED(comResult))
+		CoUninitialize();
+	return read;
+}
@@ -1,9 +1,13 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 // Helpers for determining the actual path to the executable
 std::wstring GetExePath();
 std::wstring FixPath(const std::wstring& relativeFilePath);
 std::string WideToNarrow(const std::wstring& str);
-std::wstring NarrowToWide(const std::string& str);
\ No newline at end of file
+std::wstring NarrowToWide(const std::string& str);
+
+// Decodes an image file with WIC, false if it could not be read
+bool ReadImageRGBA(const std::wstring& path, std::vector<unsigned char>& rgba, unsigned int* width, unsigned int* height);
\ No newline at end of file
@@ -0,0 +1,413 @@
+#include "LightClusters.h"
+
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#define CLUSTER_SLICE_SIZE (LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y)
+
+LightClusters::LightClusters() :
+	frustum(),
+	sliceScale(0),
+	sliceBias(0),
+	lightCount(0),
+	blockCount(0),
+	indexCount(0),
+	overflowCount(0)
+{
+	ranges.resize(LIGHT_CLUSTER_COUNT);
+	written.resize(LIGHT_CLUSTER_COUNT);
+	indices.resize(LIGHT_CLUSTER_MAX_INDICES);
+}
+
+/// <summary>
+/// Makes the plane of a tile edge at an NDC coordinate. Under
+/// a perspective projection the plane passes through the
+/// camera, under an orthographic one it is axis aligned
+/// </summary>
+static void MakeTilePlane(float plane[3], float ndc, float projScale, bool orthographic, float facing)
+{
+	if (orthographic)
+	{
+		plane[0] = facing;
+		plane[1] = 0;
+		plane[2] = -facing * ndc / projScale;
+		return;
+	}
+
+	float length = std::sqrt(projScale * projScale + ndc * ndc);
+	plane[0] = facing * projScale / length;
+	plane[1] = -facing * ndc / length;
+	plane[2] = 0;
+}
+
+void LightClusters::Prepare(
+	const ClusterFrustum& cameraFrustum,
+	const ClusterLight* lights,
+	unsigned int count)
+{
+	frustum = cameraFrustum;
+
+	// Logarithmic slices between the cluster near and the far clip
+	float nearZ = (std::max)(frustum.nearClip, LIGHT_CLUSTER_NEAR);
+	float farZ = (std::max)(frustum.farClip, nearZ + 1.0f);
+	float logRatio = std::log(farZ / nearZ);
+	sliceScale = LIGHT_CLUSTERS_Z / logRatio;
+	sliceBias = -LIGHT_CLUSTERS_Z * std::log(nearZ) / logRatio;
+
+	// Columns count left to right, rows top to bottom
+	for (int i = 0; i <= LIGHT_CLUSTERS_X; i++)
+		MakeTilePlane(planesX[i], -1.0f + 2.0f * i / LIGHT_CLUSTERS_X, frustum.projScaleX, frustum.orthographic, 1.0f);
+	for (int i = 0; i <= LIGHT_CLUSTERS_Y; i++)
+		MakeTilePlane(planesY[i], 1.0f - 2.0f * i / LIGHT_CLUSTERS_Y, frustum.projScaleY, frustum.orthographic, -1.0f);
+
+	// Pad to whole blocks of four. Padding lights have
+	// no range and are never written out
+	lightCount = count;
+	blockCount = (count + 3) / 4;
+	lightX.assign(blockCount * 4, 0.0f);
+	lightY.assign(blockCount * 4, 0.0f);
+	lightZ.assign(blockCount * 4, 0.0f);
+	lightRange.assign(blockCount * 4, 0.0f);
+	lightIndex.resize(count);
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		lightX[i] = lights[i].x;
+		lightY[i] = lights[i].y;
+		lightZ[i] = lights[i].z;
+		lightRange[i] = lights[i].range;
+		lightIndex[i] = lights[i].lightIndex;
+	}
+
+	minX.resize(count); maxX.resize(count);
+	minY.resize(count); maxY.resize(count);
+	minZ.resize(count); maxZ.resize(count);
+}
+
+void LightClusters::Build()
+{
+	jobTotals.assign(1, 0);
+	jobOverflows.assign(1, 0);
+
+	BinLights(0, blockCount);
+	CountSlices(0, 0, LIGHT_CLUSTERS_Z);
+	FillSlices(0, 0, LIGHT_CLUSTERS_Z);
+	Finish();
+}
+
+/// <summary>
+/// Binning the lights is split by light, counting and filling
+/// by depth slice so every job owns the clusters it writes.
+/// Filling waits on every count since each job's place in the
+/// index list depends on how many indices came before it
+/// </summary>
+unsigned int LightClusters::AddJobs(RenderJobGraph* graph, unsigned int jobCount)
+{
+	jobCount = (std::max)(1u, (std::min)(jobCount, (unsigned int)LIGHT_CLUSTERS_Z));
+	jobTotals.assign(jobCount, 0);
+	jobOverflows.assign(jobCount, 0);
+
+	unsigned int binJobs[LIGHT_CLUSTERS_Z];
+	for (unsigned int j = 0; j < jobCount; j++)
+	{
+		unsigned int first = blockCount * j / jobCount;
+		unsigned int end = blockCount * (j + 1) / jobCount;
+		binJobs[j] = graph->AddJob("Bin Lights", [this, first, end](unsigned int) { BinLights(first, end); });
+	}
+
+	unsigned int countJobs[LIGHT_CLUSTERS_Z];
+	for (unsigned int j = 0; j < jobCount; j++)
+	{
+		unsigned int first = LIGHT_CLUSTERS_Z * j / jobCount;
+		unsigned int end = LIGHT_CLUSTERS_Z * (j + 1) / jobCount;
+		countJobs[j] = graph->AddJob("Count Clusters", [this, j, first, end](unsigned int) { CountSlices(j, first, end); }, Span<const unsigned int>(binJobs, jobCount));
+	}
+
+	unsigned int fillJobs[LIGHT_CLUSTERS_Z];
+	for (unsigned int j = 0; j < jobCount; j++)
+	{
+		unsigned int first = LIGHT_CLUSTERS_Z * j / jobCount;
+		unsigned int end = LIGHT_CLUSTERS_Z * (j + 1) / jobCount;
+		fillJobs[j] = graph->AddJob("Fill Clusters", [this, j, first, end](unsigned int) { FillSlices(j, first, end); }, Span<const unsigned int>(countJobs, jobCount));
+	}
+
+	return graph->AddJob("Finish Clusters", [this](unsigned int) { Finish(); }, Span<const unsigned int>(fillJobs, jobCount));
+}
+
+LightClusterShaderParams LightClusters::GetShaderParams(
+	float viewportX,
+	float viewportY,
+	float viewportWidth,
+	float viewportHeight)
+{
+	LightClusterShaderParams params = {};
+	params.clustersPerPixel[0] = LIGHT_CLUSTERS_X / viewportWidth;
+	params.clustersPerPixel[1] = LIGHT_CLUSTERS_Y / viewportHeight;
+	params.viewportOrigin[0] = viewportX;
+	params.viewportOrigin[1] = viewportY;
+	params.sliceScale = sliceScale;
+	params.sliceBias = sliceBias;
+
+	for (int i = 0; i < 4; i++)
+		params.depthRow[i] = frustum.view[i][2];
+	return params;
+}
+
+/// <summary>
+/// Depth slice of a view space depth
+/// </summary>
+static int DepthSlice(float z, float sliceScale, float sliceBias)
+{
+	int slice = (int)std::floor(std::log((std::max)(z, LIGHT_CLUSTER_NEAR)) * sliceScale + sliceBias);
+	return (std::max)(0, (std::min)(slice, LIGHT_CLUSTERS_Z - 1));
+}
+
+/// <summary>
+/// Finds the tiles a block of four spheres covers along one
+/// axis. A sphere cannot reach the tiles before the last
+/// plane it is fully in front of, nor the tiles from the
+/// first plane it is fully behind. Comparing against every
+/// plane keeps this exact without any branches
+/// </summary>
+static void TileRange(
+	const float (*planes)[3],
+	int planeCount,
+	__m128 v,
+	__m128 vz,
+	__m128 radius,
+	__m128i* first,
+	__m128i* last)
+{
+	__m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), radius);
+	__m128i lo = _mm_setzero_si128();
+	__m128i hi = _mm_set1_epi32(planeCount - 2);
+
+	for (int k = 0; k < planeCount; k++)
+	{
+		__m128 d = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(planes[k][0])), _mm_mul_ps(vz, _mm_set1_ps(planes[k][1]))),
+			_mm_set1_ps(planes[k][2]));
+
+		__m128i inFront = _mm_castps_si128(_mm_cmpgt_ps(d, radius));
+		lo = _mm_or_si128(_mm_and_si128(inFront, _mm_set1_epi32(k)), _mm_andnot_si128(inFront, lo));
+	}
+
+	for (int k = planeCount - 1; k >= 0; k--)
+	{
+		__m128 d = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(planes[k][0])), _mm_mul_ps(vz, _mm_set1_ps(planes[k][1]))),
+			_mm_set1_ps(planes[k][2]));
+
+		__m128i behind = _mm_castps_si128(_mm_cmplt_ps(d, negRadius));
+		hi = _mm_or_si128(_mm_and_si128(behind, _mm_set1_epi32(k - 1)), _mm_andnot_si128(behind, hi));
+	}
+
+	*first = lo;
+	*last = hi;
+}
+
+/// <summary>
+/// Moves blocks of four lights into view space and finds the
+/// range of clusters each one's sphere touches
+/// </summary>
+void LightClusters::BinLights(unsigned int firstBlock, unsigned int endBlock)
+{
+	const float (*m)[4] = frustum.view;
+
+	for (unsigned int b = firstBlock; b < endBlock; b++)
+	{
+		unsigned int base = b * 4;
+		__m128 x = _mm_loadu_ps(&lightX[base]);
+		__m128 y = _mm_loadu_ps(&lightY[base]);
+		__m128 z = _mm_loadu_ps(&lightZ[base]);
+		__m128 radius = _mm_loadu_ps(&lightRange[base]);
+
+		// Row vector times the view matrix
+		__m128 vx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(m[0][0])), _mm_mul_ps(y, _mm_set1_ps(m[1][0]))),
+			_mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(m[2][0])), _mm_set1_ps(m[3][0])));
+		__m128 vy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(m[0][1])), _mm_mul_ps(y, _mm_set1_ps(m[1][1]))),
+			_mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(m[2][1])), _mm_set1_ps(m[3][1])));
+		__m128 vz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(m[0][2])), _mm_mul_ps(y, _mm_set1_ps(m[1][2]))),
+			_mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(m[2][2])), _mm_set1_ps(m[3][2])));
+
+		__m128i firstX, lastX, firstY, lastY;
+		TileRange(planesX, LIGHT_CLUSTERS_X + 1, vx, vz, radius, &firstX, &lastX);
+		TileRange(planesY, LIGHT_CLUSTERS_Y + 1, vy, vz, radius, &firstY, &lastY);
+
+		int tiles[4][4];
+		float depth[4];
+		float range[4];
+		_mm_storeu_si128((__m128i*)tiles[0], firstX);
+		_mm_storeu_si128((__m128i*)tiles[1], lastX);
+		_mm_storeu_si128((__m128i*)tiles[2], firstY);
+		_mm_storeu_si128((__m128i*)tiles[3], lastY);
+		_mm_storeu_ps(depth, vz);
+		_mm_storeu_ps(range, radius);
+
+		unsigned int lanes = (std::min)(4u, lightCount - base);
+		for (unsigned int l = 0; l < lanes; l++)
+		{
+			unsigned int i = base + l;
+			minX[i] = tiles[0][l];
+			maxX[i] = tiles[1][l];
+			minY[i] = tiles[2][l];
+			maxY[i] = tiles[3][l];
+
+			// Entirely in front of the near clip or past the far clip
+			float nearZ = depth[l] - range[l];
+			float farZ = depth[l] + range[l];
+			if (farZ < frustum.nearClip || nearZ > frustum.farClip)
+			{
+				minZ[i] = 1;
+				maxZ[i] = 0;
+				continue;
+			}
+
+			minZ[i] = DepthSlice(nearZ, sliceScale, sliceBias);
+			maxZ[i] = DepthSlice(farZ, sliceScale, sliceBias);
+		}
+	}
+}
+
+/// <summary>
+/// Counts the lights of every cluster in a run of slices,
+/// capped at the most a cluster may hold
+/// </summary>
+void LightClusters::CountSlices(unsigned int job, unsigned int firstSlice, unsigned int endSlice)
+{
+	for (unsigned int c = firstSlice * CLUSTER_SLICE_SIZE; c < endSlice * CLUSTER_SLICE_SIZE; c++)
+		ranges[c].count = 0;
+
+	for (unsigned int i = 0; i < lightCount; i++)
+	{
+		int z0 = (std::max)(minZ[i], (int)firstSlice);
+		int z1 = (std::min)(maxZ[i], (int)endSlice - 1);
+		for (int z = z0; z <= z1; z++)
+			for (int y = minY[i]; y <= maxY[i]; y++)
+				for (int x = minX[i]; x <= maxX[i]; x++)
+					ranges[(z * LIGHT_CLUSTERS_Y + y) * LIGHT_CLUSTERS_X + x].count++;
+	}
+
+	unsigned int total = 0;
+	unsigned int overflow = 0;
+	for (unsigned int c = firstSlice * CLUSTER_SLICE_SIZE; c < endSlice * CLUSTER_SLICE_SIZE; c++)
+	{
+		if (ranges[c].count > LIGHT_CLUSTER_MAX_LIGHTS)
+		{
+			overflow++;
+			ranges[c].count = LIGHT_CLUSTER_MAX_LIGHTS;
+		}
+		total += ranges[c].count;
+	}
+
+	jobTotals[job] = total;
+	jobOverflows[job] = overflow;
+}
+
+/// <summary>
+/// Lays out the clusters of a run of slices in the index list
+/// and writes their lights, lowest light index first
+/// </summary>
+void LightClusters::FillSlices(unsigned int job, unsigned int firstSlice, unsigned int endSlice)
+{
+	unsigned int offset = 0;
+	for (unsigned int j = 0; j < job; j++)
+		offset += jobTotals[j];
+
+	for (unsigned int c = firstSlice * CLUSTER_SLICE_SIZE; c < endSlice * CLUSTER_SLICE_SIZE; c++)
+	{
+		ranges[c].offset = offset;
+		offset += ranges[c].count;
+		written[c] = 0;
+	}
+
+	for (unsigned int i = 0; i < lightCount; i++)
+	{
+		int z0 = (std::max)(minZ[i], (int)firstSlice);
+		int z1 = (std::min)(maxZ[i], (int)endSlice - 1);
+		for (int z = z0; z <= z1; z++)
+			for (int y = minY[i]; y <= maxY[i]; y++)
+				for (int x = minX[i]; x <= maxX[i]; x++)
+				{
+					unsigned int c = (z * LIGHT_CLUSTERS_Y + y) * LIGHT_CLUSTERS_X + x;
+					if (written[c] < ranges[c].count)
+						indices[ranges[c].offset + written[c]++] = lightIndex[i];
+				}
+	}
+}
+
+void LightClusters::Finish()
+{
+	indexCount = 0;
+	overflowCount = 0;
+	for (size_t j = 0; j < jobTotals.size(); j++)
+	{
+		indexCount += jobTotals[j];
+		overflowCount += jobOverflows[j];
+	}
+}
+
+
+// --------------------------------------------------------
+// Benchmark
+// --------------------------------------------------------
+
+LightClusterBenchmark BenchmarkLightClusters(
+	unsigned int lightCount,
+	unsigned int iterations,
+	unsigned int workerCount)
+{
+	LightClusterBenchmark result = {};
+	result.lightCount = lightCount;
+	result.workerCount = workerCount;
+	iterations = (std::max)(iterations, 1u);
+
+	// Camera at the origin looking down +Z with a
+	// 60 degree field of view at 16:9
+	ClusterFrustum frustum = {};
+	frustum.view[0][0] = frustum.view[1][1] = frustum.view[2][2] = frustum.view[3][3] = 1.0f;
+	frustum.projScaleY = 1.0f / std::tan(3.14159265f / 6.0f);
+	frustum.projScaleX = frustum.projScaleY / (16.0f / 9.0f);
+	frustum.nearClip = 0.01f;
+	frustum.farClip = 100.0f;
+
+	// Fixed seed so runs are comparable
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> spread(-1.0f, 1.0f);
+	std::vector<ClusterLight> lights(lightCount);
+	for (unsigned int i = 0; i < lightCount; i++)
+	{
+		lights[i].z = (spread(random) * 0.5f + 0.5f) * frustum.farClip;
+		lights[i].x = spread(random) * lights[i].z;
+		lights[i].y = spread(random) * lights[i].z * 0.6f;
+		lights[i].range = 1.0f + (spread(random) * 0.5f + 0.5f) * 4.0f;
+		lights[i].lightIndex = i;
+	}
+
+	LightClusters clusters;
+	clusters.Prepare(frustum, lights.data(), lightCount);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < iterations; i++)
+		clusters.Build();
+	auto end = std::chrono::high_resolution_clock::now();
+	result.serialMS = std::chrono::duration<float, std::milli>(end - start).count() / iterations;
+
+	RenderJobGraph graph(workerCount);
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < iterations; i++)
+	{
+		graph.Reset();
+		clusters.AddJobs(&graph, workerCount + 1);
+		graph.Run(true);
+	}
+	end = std::chrono::high_resolution_clock::now();
+	result.parallelMS = std::chrono::duration<float, std::milli>(end - start).count() / iterations;
+
+	result.indexCount = clusters.GetIndexCount();
+	return result;
+}
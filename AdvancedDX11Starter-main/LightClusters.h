@@ -0,0 +1,181 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Bin point and spot lights into a grid of view
+//			space clusters (screen tiles split into depth
+//			slices) so a pixel only loops over the lights
+//			that can reach its cluster. Binning runs on the
+//			CPU, four lights at a time with SSE, spread over
+//			the RenderJobGraph's workers.
+
+#include <vector>
+
+#include "RenderJobGraph.h"
+
+// Must match LightClusters.hlsli
+#define LIGHT_CLUSTERS_X			16
+#define LIGHT_CLUSTERS_Y			9
+#define LIGHT_CLUSTERS_Z			24
+#define LIGHT_CLUSTER_COUNT			(LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z)
+
+// Lights past this in a single cluster are dropped, which
+// keeps the index list (and its GPU buffer) a fixed size
+#define LIGHT_CLUSTER_MAX_LIGHTS	64
+#define LIGHT_CLUSTER_MAX_INDICES	(LIGHT_CLUSTER_COUNT * LIGHT_CLUSTER_MAX_LIGHTS)
+
+// Depth slices are logarithmic, which makes the ones close
+// to a tiny near clip far too thin. Anything closer than
+// this shares the first slice
+#define LIGHT_CLUSTER_NEAR			0.25f
+
+/// <summary>
+/// The camera as the binning sees it. Matrices are laid out
+/// like DirectX::XMFLOAT4X4, row vectors times the matrix
+/// </summary>
+struct ClusterFrustum
+{
+	float view[4][4];
+	float projScaleX;	// projection._11
+	float projScaleY;	// projection._22
+	float nearClip;
+	float farClip;
+	bool orthographic;
+};
+
+/// <summary>
+/// A point or spot light as a bounding sphere in world space.
+/// Spot lights use their whole range since only their falloff
+/// exponent is known, not a cone angle
+/// </summary>
+struct ClusterLight
+{
+	float x, y, z;
+	float range;
+	unsigned int lightIndex;	// Into the light array the shader reads
+};
+
+/// <summary>
+/// Where a cluster's lights are in the index list. Matches
+/// the uint2 read by the shader
+/// </summary>
+struct LightClusterRange
+{
+	unsigned int offset;
+	unsigned int count;
+};
+
+/// <summary>
+/// Values a shader needs to find the cluster of a pixel,
+/// laid out as the three float4s the shader declares
+/// </summary>
+struct LightClusterShaderParams
+{
+	float clustersPerPixel[2];
+	float viewportOrigin[2];
+
+	float sliceScale;
+	float sliceBias;
+	float padding[2];
+
+	// View space depth is dot(float4(worldPos, 1), depthRow)
+	float depthRow[4];
+};
+
+class LightClusters
+{
+public:
+	LightClusters();
+
+	// Copies the camera and lights in. Must be called
+	// before Build() or running the jobs from AddJobs()
+	void Prepare(
+		const ClusterFrustum& frustum,
+		const ClusterLight* lights,
+		unsigned int lightCount);
+
+	// Bins everything on the calling thread
+	void Build();
+
+	// Adds the binning to a job graph and returns the
+	// index of its last job, which later jobs can wait on
+	unsigned int AddJobs(RenderJobGraph* graph, unsigned int jobCount);
+
+	LightClusterShaderParams GetShaderParams(
+		float viewportX,
+		float viewportY,
+		float viewportWidth,
+		float viewportHeight);
+
+	// Results
+	const std::vector<LightClusterRange>& GetClusterRanges() { return ranges; }
+	const std::vector<unsigned int>& GetLightIndices() { return indices; }
+	unsigned int GetIndexCount() { return indexCount; }
+	unsigned int GetLightCount() { return lightCount; }
+	unsigned int GetOverflowCount() { return overflowCount; }
+
+private:
+
+	// Steps of a build, in order
+	void BinLights(unsigned int firstBlock, unsigned int endBlock);
+	void CountSlices(unsigned int job, unsigned int firstSlice, unsigned int endSlice);
+	void FillSlices(unsigned int job, unsigned int firstSlice, unsigned int endSlice);
+	void Finish();
+
+	ClusterFrustum frustum;
+	float sliceScale;
+	float sliceBias;
+
+	// Tile edge planes, outer frustum edges included, as
+	// (n, nz, w) with distance = n * x (or y) + nz * z + w.
+	// Each faces towards the tiles after it
+	float planesX[LIGHT_CLUSTERS_X + 1][3];
+	float planesY[LIGHT_CLUSTERS_Y + 1][3];
+
+	// Lights in blocks of four, structure of arrays so
+	// each block is a single SSE register per component
+	unsigned int lightCount;
+	unsigned int blockCount;
+	std::vector<float> lightX;
+	std::vector<float> lightY;
+	std::vector<float> lightZ;
+	std::vector<float> lightRange;
+	std::vector<unsigned int> lightIndex;
+
+	// Per light cluster bounds, inclusive. minZ > maxZ
+	// marks a light that is outside the frustum
+	std::vector<int> minX, maxX, minY, maxY, minZ, maxZ;
+
+	// Indices each counting job found, in slice order
+	std::vector<unsigned int> jobTotals;
+	std::vector<unsigned int> jobOverflows;
+
+	// Lights written to each cluster while filling
+	std::vector<unsigned int> written;
+
+	std::vector<LightClusterRange> ranges;
+	std::vector<unsigned int> indices;
+	unsigned int indexCount;
+	unsigned int overflowCount;
+};
+
+/// <summary>
+/// Times of one headless benchmark run
+/// </summary>
+struct LightClusterBenchmark
+{
+	unsigned int lightCount;
+	unsigned int workerCount;
+	float serialMS;
+	float parallelMS;
+	unsigned int indexCount;
+};
+
+/// <summary>
+/// Bins random lights spread in front of a camera, once on
+/// the calling thread and once across a graph of workers,
+/// and averages the time each build took
+/// </summary>
+LightClusterBenchmark BenchmarkLightClusters(
+	unsigned int lightCount,
+	unsigned int iterations,
+	unsigned int workerCount);
@@ -0,0 +1,60 @@
+// Include guard
+#ifndef _LIGHT_CLUSTERS_HLSL
+#define _LIGHT_CLUSTERS_HLSL
+
+#include "Lighting.hlsli"
+
+// Must match LightClusters.h
+#define LIGHT_CLUSTERS_X	16
+#define LIGHT_CLUSTERS_Y	9
+#define LIGHT_CLUSTERS_Z	24
+#define LIGHT_CLUSTER_NEAR	0.25f
+
+// Every light, the offset and count of each cluster's
+// lights and the list of light indices they point into
+StructuredBuffer<Light> ClusterLights : register(t8);
+StructuredBuffer<uint2> ClusterRanges : register(t9);
+StructuredBuffer<uint> ClusterLightIndices : register(t10);
+
+// clusterScreen:	xy clusters per pixel, zw viewport origin
+// clusterDepth:	x slice scale, y slice bias
+// clusterDepthRow:	view space depth is dot(float4(worldPos, 1), clusterDepthRow)
+uint2 GetLightCluster(float2 pixel, float3 worldPos, float4 clusterScreen, float4 clusterDepth, float4 clusterDepthRow)
+{
+	uint2 tile = min(
+		uint2(max(pixel - clusterScreen.zw, 0) * clusterScreen.xy),
+		uint2(LIGHT_CLUSTERS_X - 1, LIGHT_CLUSTERS_Y - 1));
+
+	float depth = dot(float4(worldPos, 1), clusterDepthRow);
+	uint slice = (uint)clamp(floor(log(max(depth, LIGHT_CLUSTER_NEAR)) * clusterDepth.x + clusterDepth.y), 0, LIGHT_CLUSTERS_Z - 1);
+
+	return ClusterRanges[(slice * LIGHT_CLUSTERS_Y + tile.y) * LIGHT_CLUSTERS_X + tile.x];
+}
+
+// Point and spot lighting from only the lights binned into this pixel's cluster
+float3 ClusteredLights(
+float2 pixel,
+float4 clusterScreen,
+float4 clusterDepth,
+float4 clusterDepthRow,
+float3 normal,
+float3 worldPos,
+float3 camPos,
+float shininess,
+float3 surfaceColor)
+{
+	uint2 cluster = GetLightCluster(pixel, worldPos, clusterScreen, clusterDepth, clusterDepthRow);
+
+	float3 total = float3(0, 0, 0);
+	for (uint i = 0; i < cluster.y; i++)
+	{
+		Light light = ClusterLights[ClusterLightIndices[cluster.x + i]];
+		if (light.Type == LIGHT_TYPE_SPOT)
+			total += SpotLight(light, normal, worldPos, camPos, shininess, surfaceColor);
+		else
+			total += PointLight(light, normal, worldPos, camPos, shininess, surfaceColor);
+	}
+	return total;
+}
+
+#endif
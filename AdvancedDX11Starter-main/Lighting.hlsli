@@ -23,10 +23,12 @@ struct Light
 
 // === UTILITY FUNCTIONS ============================================
 
-// Basic sample and unpack
+// Basic sample and unpack. Only xy is read, since cooked
+// normal maps are two channel BC5, and z is rebuilt from it
 float3 SampleAndUnpackNormalMap(Texture2D map, SamplerState samp, float2 uv)
 {
-	return map.Sample(samp, uv).rgb * 2.0f - 1.0f;
+	float2 xy = map.Sample(samp, uv).rg * 2.0f - 1.0f;
+	return float3(xy, sqrt(saturate(1.0f - dot(xy, xy))));
 }
 
 // Handle converting tangent-space normal map to world space normal
@@ -328,6 +330,52 @@ float3 SpotLightPBR(Light light, float3 normal, float3 worldPos, float3 camPos,
 	return PointLightPBR(light, normal, worldPos, camPos, roughness, metalness, surfaceColor, specularColor) * penumbra;
 }
 
+// === BAKED SKY LIGHTING ==========================================
+
+// Diffuse light from the sky's nine baked harmonics, which
+// already hold the cosine convolution. Same basis and order
+// as SkyBake.cpp
+float3 IrradianceSH9(float4 sh[9], float3 n)
+{
+	float3 result =
+		sh[0].rgb * 0.282095f +
+		sh[1].rgb * 0.488603f * n.y +
+		sh[2].rgb * 0.488603f * n.z +
+		sh[3].rgb * 0.488603f * n.x +
+		sh[4].rgb * 1.092548f * n.x * n.y +
+		sh[5].rgb * 1.092548f * n.y * n.z +
+		sh[6].rgb * 0.315392f * (3.0f * n.z * n.z - 1.0f) +
+		sh[7].rgb * 1.092548f * n.x * n.z +
+		sh[8].rgb * 0.546274f * (n.x * n.x - n.y * n.y);
+	return max(result, 0.0f);
+}
+
+// Ambient light from the sky. The specular cube's mips are
+// prefiltered for roughness going from 0 at the top to 1 at
+// the last one
+float3 SkyLight(
+	float4 sh[9],
+	TextureCube specularCube,
+	SamplerState samp,
+	float3 normal,
+	float3 worldPos,
+	float3 camPos,
+	float roughness,
+	float metalness,
+	float3 surfaceColor)
+{
+	uint width, height, mipCount;
+	specularCube.GetDimensions(0, width, height, mipCount);
+
+	float3 toCam = normalize(camPos - worldPos);
+	float3 reflected = reflect(-toCam, normal);
+	float3 specular = specularCube.SampleLevel(samp, reflected, roughness * (mipCount - 1)).rgb;
+
+	float3 specColor = lerp(F0_NON_METAL.rrr, surfaceColor, metalness);
+	float3 diffuse = IrradianceSH9(sh, normal) * surfaceColor * (1 - metalness);
+	return diffuse + specular * specColor;
+}
+
 // === DISTANCE FOG ===============================================
 
 float3 FogColor(float fogStart, float fogStop, float3 eyePos, float3 worldPos, float3 col, float3 fogCol)
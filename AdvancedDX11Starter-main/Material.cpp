@@ -1,4 +1,15 @@
 #include "Material.h"
+#include "Helpers.h"
+#include "StreamedTextures.h"
+#include "TextureCooker.h"
+#include "DDSTextureLoader.h"
+#include "WICTextureLoader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
 
 Material::Material(
 	DirectX::XMFLOAT3 tint, 
@@ -74,4 +85,420 @@ void Material::PrepareMaterial(std::shared_ptr<SimplePixelShader> inPS)
 	// Loop and set any other resources
 	for (auto& t : textureSRVs) { inPS->SetShaderResourceView(t.first.c_str(), t.second.Get()); }
 	for (auto& s : samplers) { inPS->SetSamplerState(s.first.c_str(), s.second.Get()); }
-}
\ No newline at end of file
+}
+
+// --------------------------------------------------------
+// Material resolving
+//
+// Materials keep their values by name, which is handy for
+// authoring but slow for drawing. Resolving looks every name
+// up in the shader's reflection once and keeps only register
+// numbers, raw views and an already filled constant buffer.
+// --------------------------------------------------------
+
+// Only this constant buffer is baked into the material. The
+// rest (perFrame, per object data) are filled by the engine
+#define MATERIAL_CBUFFER_NAME "perMaterial"
+
+/// <summary>
+/// Sorts (register, item) pairs and splits them into runs of
+/// consecutive registers so each run is a single bind call
+/// </summary>
+template<typename T>
+static void BuildBindRanges(
+	std::vector<std::pair<unsigned int, T*>> items,
+	std::vector<MaterialBindRange>* ranges,
+	std::vector<T*>* flat)
+{
+	std::sort(items.begin(), items.end(),
+		[](const std::pair<unsigned int, T*>& a, const std::pair<unsigned int, T*>& b) { return a.first < b.first; });
+
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		// Same register twice, the later one wins
+		if (!ranges->empty() && i > 0 && items[i].first == items[i - 1].first)
+		{
+			flat->back() = items[i].second;
+			continue;
+		}
+
+		if (ranges->empty() || ranges->back().startSlot + ranges->back().count != items[i].first)
+		{
+			MaterialBindRange r = {};
+			r.startSlot = items[i].first;
+			r.offset = (unsigned int)flat->size();
+			ranges->push_back(r);
+		}
+
+		ranges->back().count++;
+		flat->push_back(items[i].second);
+	}
+}
+
+/// <summary>
+/// Resolves a material against a single shader stage
+/// </summary>
+static void ResolveStage(
+	RendMat* mat,
+	ISimpleShader* shader,
+	MaterialStageBindings* bindings,
+	Microsoft::WRL::ComPtr<ID3D11Device> device)
+{
+	*bindings = MaterialStageBindings();
+	if (!shader || !shader->IsShaderValid())
+		return;
+
+	// Textures and samplers
+	std::vector<std::pair<unsigned int, ID3D11ShaderResourceView*>> srvs;
+	for (auto& t : mat->textureSRVs)
+	{
+		const SimpleSRV* info = shader->GetShaderResourceViewInfo(t.first);
+		if (info) srvs.push_back(std::make_pair(info->BindIndex, t.second.Get()));
+	}
+	BuildBindRanges(srvs, &bindings->srvRanges, &bindings->srvs);
+
+	std::vector<std::pair<unsigned int, ID3D11SamplerState*>> samplers;
+	for (auto& s : mat->samplers)
+	{
+		const SimpleSampler* info = shader->GetSamplerInfo(s.first);
+		if (info) samplers.push_back(std::make_pair(info->BindIndex, s.second.Get()));
+	}
+	BuildBindRanges(samplers, &bindings->samplerRanges, &bindings->samplers);
+
+	// Constant buffer values, the universal ones first
+	// so a material file can still override them
+	std::vector<MaterialParameter> parameters;
+	MaterialParameter tint = { "colorTint", { mat->colorTint.x, mat->colorTint.y, mat->colorTint.z, 0 }, 3 };
+	MaterialParameter scale = { "uvScale", { mat->uvScale.x, mat->uvScale.y, 0, 0 }, 2 };
+	MaterialParameter offset = { "uvOffset", { mat->uvOffset.x, mat->uvOffset.y, 0, 0 }, 2 };
+	parameters.push_back(tint);
+	parameters.push_back(scale);
+	parameters.push_back(offset);
+	parameters.insert(parameters.end(), mat->parameters.begin(), mat->parameters.end());
+
+	const SimpleConstantBuffer* cbInfo = shader->GetBufferInfo(MATERIAL_CBUFFER_NAME);
+	if (!cbInfo || cbInfo->Type != D3D11_CT_CBUFFER)
+		return;
+
+	MaterialConstantBuffer cb = {};
+	cb.bindIndex = cbInfo->BindIndex;
+	cb.data.resize((cbInfo->Size + 15) / 16 * 16, 0);
+
+	for (auto& p : parameters)
+	{
+		const SimpleShaderVariable* var = shader->GetVariableInfo(p.name);
+		if (!var || shader->GetBufferInfo(var->ConstantBufferIndex) != cbInfo)
+			continue;
+
+		unsigned int bytes = (std::min)(var->Size, p.count * (unsigned int)sizeof(float));
+		memcpy(&cb.data[var->ByteOffset], p.values, bytes);
+	}
+
+	// Immutable since the values never change after this
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = (unsigned int)cb.data.size();
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+
+	D3D11_SUBRESOURCE_DATA initial = {};
+	initial.pSysMem = cb.data.data();
+
+	if (SUCCEEDED(device->CreateBuffer(&desc, &initial, cb.buffer.GetAddressOf())))
+		bindings->constantBuffers.push_back(cb);
+}
+
+void ResolveMaterial(
+	std::shared_ptr<RendMat> mat,
+	std::shared_ptr<SimpleVertexShader> vs,
+	std::shared_ptr<SimplePixelShader> ps,
+	Microsoft::WRL::ComPtr<ID3D11Device> device)
+{
+	ResolveStage(mat.get(), vs.get(), &mat->vsBindings, device);
+	ResolveStage(mat.get(), ps.get(), &mat->psBindings, device);
+	mat->resolved = true;
+}
+
+
+// --------------------------------------------------------
+// Material files
+//
+// Plain text, one entry per line. Paths are relative to the
+// Assets folder and @name refers to a resource the engine
+// registered itself:
+//
+//		vs			VertexShader.cso
+//		ps			PixelCommon.cso
+//		float3		colorTint		1 1 1
+//		float2		uvScale			2 2
+//		texture		Albedo			Textures/cobblestone_albedo.png
+//		sampler		BasicSampler	@basic
+//
+// Lines starting with // are comments.
+// --------------------------------------------------------
+
+/// <summary>
+/// Packs an _orm texture from its single channel maps when
+/// it has not been cooked, the same way the cooker does.
+/// Only with streaming off, when everything else is loaded
+/// whole up front too
+/// </summary>
+static Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> PackOrmFromMaps(
+	const std::string& value,
+	MaterialLoadContext* loadContext)
+{
+	std::vector<unsigned char> maps[ORM_CHANNEL_COUNT];
+	const unsigned char* sources[ORM_CHANNEL_COUNT] = {};
+	unsigned int widths[ORM_CHANNEL_COUNT] = {};
+	unsigned int heights[ORM_CHANNEL_COUNT] = {};
+	bool found = false;
+	for (unsigned int c = 0; c < ORM_CHANNEL_COUNT; c++)
+	{
+		std::wstring path = FixPath(L"../../Assets/" + NarrowToWide(OrmChannelSource(value, c)));
+		if (ReadImageRGBA(path, maps[c], &widths[c], &heights[c]))
+		{
+			sources[c] = maps[c].data();
+			found = true;
+		}
+	}
+
+	if (!found)
+		return 0;
+
+	std::vector<unsigned char> packed;
+	unsigned int width, height;
+	PackOrmTexture(sources, widths, heights, packed, &width, &height);
+
+	std::vector<unsigned char> levels;
+	std::vector<size_t> levelOffsets;
+	BuildMipChain(packed.data(), width, height, levels, levelOffsets);
+
+	std::vector<D3D11_SUBRESOURCE_DATA> data(levelOffsets.size());
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		data[i].pSysMem = levels.data() + levelOffsets[i];
+		data[i].SysMemPitch = (std::max)(width >> i, 1u) * 4;
+	}
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = width;
+	desc.Height = height;
+	desc.MipLevels = (unsigned int)data.size();
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	if (SUCCEEDED(loadContext->device->CreateTexture2D(&desc, data.data(), texture.GetAddressOf())))
+		loadContext->device->CreateShaderResourceView(texture.Get(), 0, srv.GetAddressOf());
+	return srv;
+}
+
+/// <summary>
+/// Gets a texture by @name or loads (once) from the Assets
+/// folder, and adds the material's reference to it. A cooked
+/// .dds of the file is used instead when there is one. With
+/// streaming on, files are only registered here and the
+/// material starts out with the stream's stand-in
+/// </summary>
+static Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetMaterialTexture(
+	const std::string& name,
+	const std::string& value,
+	std::shared_ptr<RendMat> mat,
+	MaterialLoadContext* loadContext)
+{
+	AssetRegistry* assets = loadContext->assets;
+	AssetID id = assets->Intern(value);
+
+	TextureHandle handle = assets->textures.Acquire(id);
+	if (handle.IsNull() && !value.empty() && value[0] != '@')
+	{
+		// Prefer what the texture cooker made from the file
+		std::wstring path = FixPath(L"../../Assets/" + NarrowToWide(CookedTexturePath(value)));
+		bool cooked = GetFileAttributesW(path.c_str()) != INVALID_FILE_ATTRIBUTES;
+		if (!cooked)
+			path = FixPath(L"../../Assets/" + NarrowToWide(value));
+
+		bool packed = !cooked && IsOrmTexture(value);
+		if (loadContext->streaming)
+		{
+			// Nothing is read yet. The stand-in is per file and
+			// the first material decides if it is a normal map.
+			// Its memory is filled in as mips are swapped in.
+			// Uncooked _orm textures are packed a mip at a time
+			// by the workers, there is no file to stream from
+			unsigned int stream = loadContext->streaming->Register(path, name == "NormalMap", packed);
+			assets->textures.AddRef(handle = assets->AddTexture(value, 0));
+			assets->textures.Get(handle)->streamIndex = (int)stream;
+		}
+		else if (packed)
+		{
+			// No single file to load either, packed here instead
+			assets->textures.AddRef(handle = assets->AddTexture(value, PackOrmFromMaps(value, loadContext)));
+		}
+		else
+		{
+			// Cooked files already have every mip
+			Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+			if (cooked)
+			{
+				DirectX::CreateDDSTextureFromFile(
+					loadContext->device.Get(),
+					path.c_str(),
+					0,
+					srv.GetAddressOf());
+			}
+			else
+			{
+				DirectX::CreateWICTextureFromFile(
+					loadContext->device.Get(),
+					loadContext->context.Get(),
+					path.c_str(),
+					0,
+					srv.GetAddressOf());
+			}
+
+			// A missing file is still registered so it
+			// is only ever looked for once
+			assets->textures.AddRef(handle = assets->AddTexture(value, srv));
+		}
+	}
+
+	if (handle.IsNull())
+		return 0;
+
+	mat->textureHandles.push_back(handle);
+
+	const std::shared_ptr<TextureAsset>& texture = assets->textures.Get(handle);
+	if (texture->streamIndex >= 0)
+		return loadContext->streaming->AddUser((unsigned int)texture->streamIndex, mat);
+	return texture->srv;
+}
+
+std::shared_ptr<RendMat> LoadMaterialFile(
+	const std::wstring& path,
+	MaterialLoadContext* loadContext)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		printf("Material %ls couldn't be opened\n", path.c_str());
+		return 0;
+	}
+
+	std::shared_ptr<RendMat> mat = std::make_shared<RendMat>(
+		DirectX::XMFLOAT3(1, 1, 1),
+		DirectX::XMFLOAT2(0, 0),
+		DirectX::XMFLOAT2(1, 1));
+
+	// Kept to say which one didn't resolve
+	std::string vsName, psName;
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream in(line);
+		std::string keyword;
+		if (!(in >> keyword) || keyword.compare(0, 2, "//") == 0)
+			continue;
+
+		if (keyword == "vs" || keyword == "ps")
+		{
+			std::string name;
+			in >> name;
+			AssetID id = loadContext->assets->Intern(name);
+			if (keyword == "vs")
+			{
+				mat->vs = loadContext->assets->vertexShaders.Find(id);
+				vsName = name;
+			}
+			else
+			{
+				mat->ps = loadContext->assets->pixelShaders.Find(id);
+				psName = name;
+			}
+		}
+		else if (keyword == "texture" || keyword == "sampler")
+		{
+			std::string name, value;
+			in >> name >> value;
+
+			if (keyword == "texture")
+				AddTextureSRV(mat, name, GetMaterialTexture(name, value, mat, loadContext));
+			else if (value.size() > 1 && value[0] == '@' && loadContext->namedSamplers.count(value.substr(1)))
+				AddSampler(mat, name, loadContext->namedSamplers[value.substr(1)]);
+		}
+		else if (keyword.compare(0, 5, "float") == 0)
+		{
+			std::string name;
+			in >> name;
+
+			float values[4] = {};
+			unsigned int count = 0;
+			while (count < 4 && in >> values[count])
+				count++;
+
+			// The universal values have their own fields
+			if (name == "colorTint" && count >= 3) mat->colorTint = DirectX::XMFLOAT3(values[0], values[1], values[2]);
+			else if (name == "uvScale" && count >= 2) mat->uvScale = DirectX::XMFLOAT2(values[0], values[1]);
+			else if (name == "uvOffset" && count >= 2) mat->uvOffset = DirectX::XMFLOAT2(values[0], values[1]);
+			else AddParameter(mat, name, values, count);
+		}
+	}
+
+	// Both shaders are required to resolve against. A typo
+	// here would otherwise just leave the material missing
+	AssetRegistry* assets = loadContext->assets;
+	bool vsLoaded = assets->vertexShaders.IsAlive(mat->vs);
+	bool psLoaded = assets->pixelShaders.IsAlive(mat->ps);
+	if (!vsLoaded || !psLoaded)
+	{
+		if (!vsLoaded)
+			printf("Material %ls skipped: vertex shader \"%s\" isn't loaded\n", path.c_str(), vsName.c_str());
+		if (!psLoaded)
+			printf("Material %ls skipped: pixel shader \"%s\" isn't loaded\n", path.c_str(), psName.c_str());
+
+		for (auto& t : mat->textureHandles)
+			assets->textures.Release(t);
+		return 0;
+	}
+
+	assets->vertexShaders.AddRef(mat->vs);
+	assets->pixelShaders.AddRef(mat->ps);
+
+	ResolveMaterial(
+		mat,
+		assets->vertexShaders.Get(mat->vs),
+		assets->pixelShaders.Get(mat->ps),
+		loadContext->device);
+
+	return mat;
+}
+
+unsigned int LoadMaterialFolder(
+	const std::wstring& folder,
+	MaterialLoadContext* loadContext)
+{
+	unsigned int loaded = 0;
+
+	WIN32_FIND_DATAW found = {};
+	HANDLE search = FindFirstFileW((folder + L"\\*.mat").c_str(), &found);
+	if (search == INVALID_HANDLE_VALUE)
+		return loaded;
+
+	do
+	{
+		std::wstring fileName = found.cFileName;
+		std::shared_ptr<RendMat> mat = LoadMaterialFile(folder + L"\\" + fileName, loadContext);
+		if (mat)
+		{
+			loadContext->assets->AddMaterial(fileName.substr(0, fileName.find_last_of(L'.')), mat);
+			loaded++;
+		}
+	} while (FindNextFileW(search, &found));
+
+	FindClose(search);
+	return loaded;
+}
@@ -5,10 +5,15 @@
 #include <DirectXMath.h>
 #include <memory>
 #include <unordered_map>
+#include <vector>
+#include <string>
 
 #include "SimpleShader.h"
 #include "Camera.h"
 #include "Transform.h"
+#include "AssetRegistry.h"
+
+class StreamedTextures;
 
 class Material
 {
@@ -50,6 +55,50 @@ private:
 };
 
 
+/// <summary>
+/// A named value written into a material's constant buffer
+/// </summary>
+struct MaterialParameter
+{
+	std::string name;
+	float values[4];
+	unsigned int count;
+};
+
+/// <summary>
+/// A run of consecutive shader registers bound with one call
+/// </summary>
+struct MaterialBindRange
+{
+	unsigned int startSlot;
+	unsigned int count;
+	unsigned int offset;	// Into the stage's flat view/sampler array
+};
+
+/// <summary>
+/// A material constant buffer baked once at resolve time. It
+/// never changes afterwards so binding it uploads nothing
+/// </summary>
+struct MaterialConstantBuffer
+{
+	unsigned int bindIndex;
+	std::vector<unsigned char> data;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+};
+
+/// <summary>
+/// Everything a material binds to one shader stage, laid out
+/// as flat arrays that are handed straight to the context
+/// </summary>
+struct MaterialStageBindings
+{
+	std::vector<MaterialBindRange> srvRanges;
+	std::vector<ID3D11ShaderResourceView*> srvs;
+	std::vector<MaterialBindRange> samplerRanges;
+	std::vector<ID3D11SamplerState*> samplers;
+	std::vector<MaterialConstantBuffer> constantBuffers;
+};
+
 struct RendMat
 {
 
@@ -57,13 +106,14 @@ struct RendMat
 		DirectX::XMFLOAT3 _colorTint,
 		DirectX::XMFLOAT2 _uvOffset,
 		DirectX::XMFLOAT2 _uvScale,
-		const wchar_t* _vsName,
-		const wchar_t* _psName) :
+		VertexShaderHandle _vs,
+		PixelShaderHandle _ps) :
 		colorTint(_colorTint),
 		uvOffset(_uvOffset),
 		uvScale(_uvScale),
-		vsName(_vsName),
-		psName(_psName) { }
+		vs(_vs),
+		ps(_ps),
+		resolved(false) { }
 
 	RendMat(
 		DirectX::XMFLOAT3 _colorTint,
@@ -71,9 +121,9 @@ struct RendMat
 		DirectX::XMFLOAT2 _uvScale) :
 		colorTint(_colorTint),
 		uvOffset(_uvOffset),
-		uvScale(_uvScale) { }
+		uvScale(_uvScale),
+		resolved(false) { }
 
-	// TODO: Make materials more generic with their data 
 	// Material universal properties
 	DirectX::XMFLOAT3 colorTint;
 
@@ -81,11 +131,26 @@ struct RendMat
 	DirectX::XMFLOAT2 uvOffset;
 	DirectX::XMFLOAT2 uvScale;
 
-	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> textureSRVs;
-	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11SamplerState>> samplers;
+	// Any other shader values, by variable name
+	std::vector<MaterialParameter> parameters;
 
-	const wchar_t* vsName;
-	const wchar_t* psName;
+	// Resources by shader name. Only read when the
+	// material is resolved, never while drawing
+	std::vector<std::pair<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>> textureSRVs;
+	std::vector<std::pair<std::string, Microsoft::WRL::ComPtr<ID3D11SamplerState>>> samplers;
+
+	// Shaders in the asset registry. Null for materials
+	// that are bound by hand rather than through a group
+	VertexShaderHandle vs;
+	PixelShaderHandle ps;
+
+	// Registry textures this material holds a reference to
+	std::vector<TextureHandle> textureHandles;
+
+	// Filled in by ResolveMaterial
+	bool resolved;
+	MaterialStageBindings vsBindings;
+	MaterialStageBindings psBindings;
 };
 
 /// <summary>
@@ -96,7 +161,7 @@ inline static void AddTextureSRV(
 	std::string name,
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
 {
-	mat->textureSRVs.insert(
+	mat->textureSRVs.push_back(
 		std::pair<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>
 		(name, srv));
 }
@@ -109,10 +174,28 @@ inline static void AddSampler(
 	std::string name,
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler)
 {
-	mat->samplers.insert(
+	mat->samplers.push_back(
 		std::pair<std::string, Microsoft::WRL::ComPtr<ID3D11SamplerState>>
 		(name, sampler));
 }
+
+/// <summary>
+/// Add a constant buffer value to the given RendMat
+/// </summary>
+inline static void AddParameter(
+	std::shared_ptr<RendMat> mat,
+	std::string name,
+	const float* values,
+	unsigned int count)
+{
+	MaterialParameter p = {};
+	p.name = name;
+	p.count = count > 4 ? 4 : count;
+	for (unsigned int i = 0; i < p.count; i++)
+		p.values[i] = values[i];
+
+	mat->parameters.push_back(p);
+}
  	    
 /// <summary>
 /// Remove a textureSRV from the given
@@ -122,7 +205,34 @@ inline static void RemoveTextureSRV(
 	std::shared_ptr<RendMat> mat,
 	std::string name)
 {
-	mat->textureSRVs.erase(name);
+	for (size_t i = 0; i < mat->textureSRVs.size(); i++)
+	{
+		if (mat->textureSRVs[i].first == name)
+		{
+			mat->textureSRVs.erase(mat->textureSRVs.begin() + i);
+			return;
+		}
+	}
+}
+
+/// <summary>
+/// Points an already resolved material at a different view
+/// in place of another, without resolving it again. Only
+/// safe on the thread that records with the material
+/// </summary>
+inline static void ReplaceTextureSRV(
+	std::shared_ptr<RendMat> mat,
+	ID3D11ShaderResourceView* oldSRV,
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> newSRV)
+{
+	for (auto& t : mat->textureSRVs)
+	{
+		if (t.second.Get() == oldSRV)
+			t.second = newSRV;
+	}
+
+	for (auto& srv : mat->vsBindings.srvs) { if (srv == oldSRV) srv = newSRV.Get(); }
+	for (auto& srv : mat->psBindings.srvs) { if (srv == oldSRV) srv = newSRV.Get(); }
 }
 
 /// <summary>
@@ -133,20 +243,79 @@ inline static void RemoveSampler(
 	std::shared_ptr<RendMat> mat,
 	std::string name)
 {
-	mat->textureSRVs.erase(name);
+	for (size_t i = 0; i < mat->samplers.size(); i++)
+	{
+		if (mat->samplers[i].first == name)
+		{
+			mat->samplers.erase(mat->samplers.begin() + i);
+			return;
+		}
+	}
 }
- 	    
+
 /// <summary>
-/// Prepares the TextureSRVs and Samplers
-/// for the rending of the entity 
+/// Binds the resolved textures, samplers and baked constant
+/// buffers of a material. Must come after the shaders' own
+/// SetShader() since that binds their constant buffers
 /// </summary>
-/// <param name="mat"></param>
-/// <param name="inPS"></param>
-inline static void PrepareMaterial(
+inline static void BindMaterial(
+	const std::shared_ptr<RendMat>& mat,
+	ID3D11DeviceContext* context)
+{
+	MaterialStageBindings& vs = mat->vsBindings;
+	for (auto& r : vs.srvRanges) { context->VSSetShaderResources(r.startSlot, r.count, &vs.srvs[r.offset]); }
+	for (auto& r : vs.samplerRanges) { context->VSSetSamplers(r.startSlot, r.count, &vs.samplers[r.offset]); }
+	for (auto& cb : vs.constantBuffers) { context->VSSetConstantBuffers(cb.bindIndex, 1, cb.buffer.GetAddressOf()); }
+
+	MaterialStageBindings& ps = mat->psBindings;
+	for (auto& r : ps.srvRanges) { context->PSSetShaderResources(r.startSlot, r.count, &ps.srvs[r.offset]); }
+	for (auto& r : ps.samplerRanges) { context->PSSetSamplers(r.startSlot, r.count, &ps.samplers[r.offset]); }
+	for (auto& cb : ps.constantBuffers) { context->PSSetConstantBuffers(cb.bindIndex, 1, cb.buffer.GetAddressOf()); }
+}
+
+/// <summary>
+/// Looks up everything the material sets in the shaders'
+/// reflection data and bakes it into flat binding arrays.
+/// Anything a shader does not use is dropped here
+/// </summary>
+void ResolveMaterial(
 	std::shared_ptr<RendMat> mat,
-	std::shared_ptr<SimplePixelShader> inPS)
+	std::shared_ptr<SimpleVertexShader> vs,
+	std::shared_ptr<SimplePixelShader> ps,
+	Microsoft::WRL::ComPtr<ID3D11Device> device);
+
+/// <summary>
+/// What a material file may refer to besides files on disk
+/// </summary>
+struct MaterialLoadContext
 {
-	// Loop and set any other resources
-	for (auto& t : mat->textureSRVs) { inPS->SetShaderResourceView(t.first.c_str(), t.second.Get()); }
-	for (auto& s : mat->samplers) { inPS->SetSamplerState(s.first.c_str(), s.second.Get()); }
-}
\ No newline at end of file
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+
+	// Shaders, and textures by path. Textures made by the
+	// engine are registered as @name and referred to that way
+	AssetRegistry* assets;
+
+	// Samplers made by the engine, referred to as @name
+	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11SamplerState>> namedSamplers;
+
+	// When set, texture files are streamed in rather
+	// than loaded in full
+	StreamedTextures* streaming;
+};
+
+/// <summary>
+/// Loads and resolves a single .mat file. Returns null
+/// if the file is missing or names an unknown shader
+/// </summary>
+std::shared_ptr<RendMat> LoadMaterialFile(
+	const std::wstring& path,
+	MaterialLoadContext* loadContext);
+
+/// <summary>
+/// Loads every .mat file in a folder into the registry, named
+/// by file name without the extension. Returns how many loaded
+/// </summary>
+unsigned int LoadMaterialFolder(
+	const std::wstring& folder,
+	MaterialLoadContext* loadContext);
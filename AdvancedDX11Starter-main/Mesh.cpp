@@ -2,6 +2,8 @@
 #include <DirectXMath.h>
 #include <vector>
 #include <fstream>
+#include <algorithm>
+#include <cmath>
 
 using namespace DirectX;
 
@@ -15,7 +17,9 @@ using namespace DirectX;
 // device     - The D3D device to use for buffer creation
 // --------------------------------------------------------
 Mesh::Mesh(Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device) :
-	numIndices(0)
+	numIndices(0),
+	boundsCenter(0, 0, 0),
+	boundsRadius(0)
 {
 	CreateBuffers(vertArray, numVerts, indexArray, numIndices, device);
 }
@@ -28,22 +32,42 @@ Mesh::Mesh(Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t
 // device   - The D3D device to use for buffer creation
 // --------------------------------------------------------
 Mesh::Mesh(const std::wstring& objFile, Microsoft::WRL::ComPtr<ID3D11Device> device) :
-	numIndices(0)
+	numIndices(0),
+	boundsCenter(0, 0, 0),
+	boundsRadius(0)
+{
+	std::vector<Vertex> verts;
+	std::vector<UINT> indices;
+	if (!LoadOBJ(objFile, verts, indices))
+		return;
+
+	CreateBuffers(&verts[0], verts.size(), &indices[0], indices.size(), device);
+}
+
+
+// --------------------------------------------------------
+// Reads the vertices of the given .obj file
+// 
+// objFile  - Path to the .obj 3D model file to load
+// verts    - Filled with the file's vertices, without tangents
+// indices  - Filled with the indices of those vertices
+// --------------------------------------------------------
+bool Mesh::LoadOBJ(const std::wstring& objFile, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
 {
 	// File input object
 	std::ifstream obj(objFile);
 
 	// Check for successful open
 	if (!obj.is_open())
-		return;
+		return false;
 
 	// Variables used while reading the file
 	std::vector<XMFLOAT3> positions;     // Positions from the file
 	std::vector<XMFLOAT3> normals;       // Normals from the file
 	std::vector<XMFLOAT2> uvs;           // UVs from the file
-	std::vector<Vertex> verts;           // Verts we're assembling
-	std::vector<UINT> indices;           // Indices of these verts
 	unsigned int vertCounter = 0;        // Count of vertices/indices
+	verts.clear();
+	indices.clear();
 	char chars[100];                     // String for line reading
 
 	// Still have data left?
@@ -187,9 +211,9 @@ Mesh::Mesh(const std::wstring& objFile, Microsoft::WRL::ComPtr<ID3D11Device> dev
 		}
 	}
 
-	// Close the file and create the actual buffers
+	// Close the file, leaving the buffers to the caller
 	obj.close();
-	CreateBuffers(&verts[0], vertCounter, &indices[0], vertCounter, device);
+	return !verts.empty();
 }
 
 
@@ -207,6 +231,8 @@ Mesh::~Mesh() { }
 Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetVertexBuffer() { return vb; }
 Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetIndexBuffer() { return ib; }
 unsigned int Mesh::GetIndexCount() { return numIndices; }
+DirectX::XMFLOAT3 Mesh::GetBoundsCenter() { return boundsCenter; }
+float Mesh::GetBoundsRadius() { return boundsRadius; }
 
 
 // --------------------------------------------------------
@@ -250,6 +276,39 @@ void Mesh::CreateBuffers(Vertex* vertArray, size_t numVerts, unsigned int* index
 
 	// Save the indices
 	this->numIndices = (unsigned int)numIndices;
+
+	// Bounding sphere centered on the vertices' box. Not
+	// the tightest sphere, but cheap and close enough
+	DirectX::XMFLOAT3 minPos(0, 0, 0);
+	DirectX::XMFLOAT3 maxPos(0, 0, 0);
+	for (size_t i = 0; i < numVerts; i++)
+	{
+		DirectX::XMFLOAT3 p = vertArray[i].Position;
+		if (i == 0)
+		{
+			minPos = maxPos = p;
+			continue;
+		}
+
+		minPos.x = (std::min)(minPos.x, p.x); maxPos.x = (std::max)(maxPos.x, p.x);
+		minPos.y = (std::min)(minPos.y, p.y); maxPos.y = (std::max)(maxPos.y, p.y);
+		minPos.z = (std::min)(minPos.z, p.z); maxPos.z = (std::max)(maxPos.z, p.z);
+	}
+
+	boundsCenter = DirectX::XMFLOAT3(
+		(minPos.x + maxPos.x) * 0.5f,
+		(minPos.y + maxPos.y) * 0.5f,
+		(minPos.z + maxPos.z) * 0.5f);
+
+	float radiusSq = 0;
+	for (size_t i = 0; i < numVerts; i++)
+	{
+		float dx = vertArray[i].Position.x - boundsCenter.x;
+		float dy = vertArray[i].Position.y - boundsCenter.y;
+		float dz = vertArray[i].Position.z - boundsCenter.z;
+		radiusSq = (std::max)(radiusSq, dx * dx + dy * dy + dz * dz);
+	}
+	boundsRadius = sqrtf(radiusSq);
 }
 
 // --------------------------------------------------------
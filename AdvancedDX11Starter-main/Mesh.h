@@ -3,6 +3,7 @@
 #include <d3d11.h>
 #include <wrl/client.h>
 #include <string>
+#include <vector>
 
 #include "Vertex.h"
 
@@ -14,11 +15,19 @@ public:
 	Mesh(const std::wstring& objFile, Microsoft::WRL::ComPtr<ID3D11Device> device);
 	~Mesh();
 
+	// Reads an .obj's vertices as the constructor would, without
+	// tangents, for code that needs the geometry on the CPU
+	static bool LoadOBJ(const std::wstring& objFile, std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
+
 	// Getters for mesh data
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer();
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer();
 	unsigned int GetIndexCount();
 
+	// Sphere around every vertex, in the mesh's own space
+	DirectX::XMFLOAT3 GetBoundsCenter();
+	float GetBoundsRadius();
+
 	// Basic mesh drawing
 	void SetBuffersAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
 
@@ -30,6 +39,10 @@ private:
 	// Total indices in this mesh
 	unsigned int numIndices;
 
+	// Local bounding sphere
+	DirectX::XMFLOAT3 boundsCenter;
+	float boundsRadius;
+
 	// Helper for creating buffers (in the event we add more constructor overloads)
 	void CreateBuffers(Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device);
 	void CalculateTangents(Vertex* verts, size_t numVerts, unsigned int* indices, size_t numIndices);
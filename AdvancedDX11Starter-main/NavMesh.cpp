@@ -0,0 +1,1084 @@
+#include "NavMesh.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <random>
+#include <string.h>
+
+// Points further than this from the mesh can't start or
+// end a path
+#define NAV_SNAP_DISTANCE 2.0f
+
+NavBuildSettings DefaultNavBuildSettings()
+{
+	NavBuildSettings settings;
+	settings.cellSize = 0.2f;
+	settings.cellHeight = 0.1f;
+	settings.agentRadius = 0.4f;
+	settings.agentHeight = 1.8f;
+	settings.agentClimb = 0.4f;
+	settings.maxSlope = 45.0f;
+	settings.maxPolyCells = 48;
+	return settings;
+}
+
+// --------------------------------------------------------
+// Voxelizing. Each column of the heightfield keeps a list
+// of solid spans, sorted bottom up, merged where they touch
+// --------------------------------------------------------
+
+namespace
+{
+	struct HeightSpan
+	{
+		int min;
+		int max;
+		bool walkable;		// Whether the top is ground
+		int next;
+	};
+
+	struct Heightfield
+	{
+		int width;
+		int depth;
+		std::vector<int> heads;
+		std::vector<HeightSpan> spans;
+		int freeSpan;
+	};
+
+	/// <summary>
+	/// Adds a span to a column, swallowing any it overlaps. The
+	/// top decides whether it can be stood on, and tops within a
+	/// voxel of each other count as walkable if either is
+	/// </summary>
+	void AddSpan(Heightfield& field, int column, int min, int max, bool walkable)
+	{
+		int prev = -1;
+		int cur = field.heads[column];
+		while (cur != -1)
+		{
+			HeightSpan& span = field.spans[cur];
+			if (span.min > max)
+				break;
+			if (span.max < min)
+			{
+				prev = cur;
+				cur = span.next;
+				continue;
+			}
+
+			if (abs(span.max - max) <= 1)
+				walkable = walkable || span.walkable;
+			else if (span.max > max)
+				walkable = span.walkable;
+			min = (std::min)(min, span.min);
+			max = (std::max)(max, span.max);
+
+			// Drop the swallowed span
+			int next = span.next;
+			span.next = field.freeSpan;
+			field.freeSpan = cur;
+			if (prev == -1)
+				field.heads[column] = next;
+			else
+				field.spans[prev].next = next;
+			cur = next;
+		}
+
+		int index;
+		if (field.freeSpan != -1)
+		{
+			index = field.freeSpan;
+			field.freeSpan = field.spans[index].next;
+		}
+		else
+		{
+			index = (int)field.spans.size();
+			field.spans.push_back(HeightSpan());
+		}
+
+		HeightSpan& span = field.spans[index];
+		span.min = min;
+		span.max = max;
+		span.walkable = walkable;
+		span.next = cur;
+		if (prev == -1)
+			field.heads[column] = index;
+		else
+			field.spans[prev].next = index;
+	}
+
+	/// <summary>
+	/// Keeps the part of a polygon at or past value along an
+	/// axis, side being 1 for above and -1 for below
+	/// </summary>
+	int ClipPolygon(const float* in, int count, float* out, int axis, float value, float side)
+	{
+		int outCount = 0;
+		for (int i = 0; i < count; i++)
+		{
+			const float* a = in + i * 3;
+			const float* b = in + ((i + 1) % count) * 3;
+			float da = (a[axis] - value) * side;
+			float db = (b[axis] - value) * side;
+			if (da >= 0.0f)
+			{
+				memcpy(out + outCount * 3, a, sizeof(float) * 3);
+				outCount++;
+			}
+			if ((da >= 0.0f) != (db >= 0.0f))
+			{
+				float t = da / (da - db);
+				for (int k = 0; k < 3; k++)
+					out[outCount * 3 + k] = a[k] + (b[k] - a[k]) * t;
+				outCount++;
+			}
+		}
+		return outCount;
+	}
+
+	/// <summary>
+	/// Cuts a triangle into the columns it covers, a row at a
+	/// time, and adds the height range of each piece
+	/// </summary>
+	void RasterizeTriangle(Heightfield& field, const float* v, bool walkable, const float origin[3], float cellSize, float cellHeight)
+	{
+		float minZ = (std::min)(v[2], (std::min)(v[5], v[8]));
+		float maxZ = (std::max)(v[2], (std::max)(v[5], v[8]));
+		int z0 = (std::max)((int)floorf((minZ - origin[2]) / cellSize), 0);
+		int z1 = (std::min)((int)floorf((maxZ - origin[2]) / cellSize), field.depth - 1);
+
+		// A triangle clipped by four planes has at most seven corners
+		float row[8 * 3];
+		float cell[8 * 3];
+		float scratch[8 * 3];
+		for (int z = z0; z <= z1; z++)
+		{
+			float rowZ = origin[2] + z * cellSize;
+			int rowCount = ClipPolygon(v, 3, scratch, 2, rowZ, 1.0f);
+			rowCount = ClipPolygon(scratch, rowCount, row, 2, rowZ + cellSize, -1.0f);
+			if (rowCount < 3)
+				continue;
+
+			float minX = row[0];
+			float maxX = row[0];
+			for (int i = 1; i < rowCount; i++)
+			{
+				minX = (std::min)(minX, row[i * 3]);
+				maxX = (std::max)(maxX, row[i * 3]);
+			}
+			int x0 = (std::max)((int)floorf((minX - origin[0]) / cellSize), 0);
+			int x1 = (std::min)((int)floorf((maxX - origin[0]) / cellSize), field.width - 1);
+
+			for (int x = x0; x <= x1; x++)
+			{
+				float cellX = origin[0] + x * cellSize;
+				int cellCount = ClipPolygon(row, rowCount, scratch, 0, cellX, 1.0f);
+				cellCount = ClipPolygon(scratch, cellCount, cell, 0, cellX + cellSize, -1.0f);
+				if (cellCount < 3)
+					continue;
+
+				float minY = cell[1];
+				float maxY = cell[1];
+				for (int i = 1; i < cellCount; i++)
+				{
+					minY = (std::min)(minY, cell[i * 3 + 1]);
+					maxY = (std::max)(maxY, cell[i * 3 + 1]);
+				}
+				int spanMin = (int)floorf((minY - origin[1]) / cellHeight);
+				int spanMax = (std::max)((int)ceilf((maxY - origin[1]) / cellHeight), spanMin + 1);
+				AddSpan(field, x + z * field.width, spanMin, spanMax, walkable);
+			}
+		}
+	}
+
+	float Distance(const float a[3], const float b[3])
+	{
+		float x = b[0] - a[0];
+		float y = b[1] - a[1];
+		float z = b[2] - a[2];
+		return sqrtf(x * x + y * y + z * z);
+	}
+
+	// Twice the signed area of a, b, c seen from above,
+	// positive when c is left of a to b
+	float Cross2(const float a[3], const float b[3], const float c[3])
+	{
+		return (b[0] - a[0]) * (c[2] - a[2]) - (b[2] - a[2]) * (c[0] - a[0]);
+	}
+
+	bool SameSpot(const float a[3], const float b[3])
+	{
+		return fabsf(a[0] - b[0]) < 1e-5f && fabsf(a[2] - b[2]) < 1e-5f;
+	}
+
+	void ClampToPoly(const NavPoly& poly, const float point[3], float clamped[3])
+	{
+		clamped[0] = (std::max)(poly.min[0], (std::min)(point[0], poly.max[0]));
+		clamped[1] = poly.y;
+		clamped[2] = (std::max)(poly.min[1], (std::min)(point[2], poly.max[1]));
+	}
+}
+
+// --------------------------------------------------------
+// Mesh
+// --------------------------------------------------------
+
+NavMesh::NavMesh() :
+	settings(DefaultNavBuildSettings()),
+	width(0),
+	depth(0),
+	spanCount(0),
+	walkableCellCount(0),
+	buildMS(0.0f)
+{
+	origin[0] = origin[1] = origin[2] = 0.0f;
+}
+
+/// <summary>
+/// Voxelizes the triangles, keeps the spans with room above
+/// them to stand in, shrinks them away from every edge by
+/// the agent's radius and greedily merges what's left into
+/// rectangles of cells at the same height. Neighboring
+/// rectangles are linked wherever the agent can step from
+/// one onto the other
+/// </summary>
+void NavMesh::Build(const float* triangles, size_t triangleCount, const NavBuildSettings& buildSettings)
+{
+	auto buildStart = std::chrono::high_resolution_clock::now();
+
+	settings = buildSettings;
+	cellStart.clear();
+	cells.clear();
+	polys.clear();
+	links.clear();
+	width = depth = 0;
+	spanCount = walkableCellCount = 0;
+	buildMS = 0.0f;
+	if (triangleCount == 0)
+		return;
+
+	const float cs = settings.cellSize;
+	const float ch = settings.cellHeight;
+
+	// Bounds of everything, with the grid starting at the
+	// lowest corner
+	float lo[3] = { triangles[0], triangles[1], triangles[2] };
+	float hi[3] = { triangles[0], triangles[1], triangles[2] };
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			lo[k] = (std::min)(lo[k], triangles[i * 3 + k]);
+			hi[k] = (std::max)(hi[k], triangles[i * 3 + k]);
+		}
+	}
+	memcpy(origin, lo, sizeof(origin));
+	width = (int)ceilf((hi[0] - lo[0]) / cs) + 1;
+	depth = (int)ceilf((hi[2] - lo[2]) / cs) + 1;
+
+	Heightfield field;
+	field.width = width;
+	field.depth = depth;
+	field.heads.assign((size_t)width * depth, -1);
+	field.freeSpan = -1;
+
+	float walkableCosine = cosf(settings.maxSlope * 3.14159265f / 180.0f);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const float* v = triangles + t * 9;
+		float ax = v[3] - v[0], ay = v[4] - v[1], az = v[5] - v[2];
+		float bx = v[6] - v[0], by = v[7] - v[1], bz = v[8] - v[2];
+		float nx = ay * bz - az * by;
+		float ny = az * bx - ax * bz;
+		float nz = ax * by - ay * bx;
+		float length = sqrtf(nx * nx + ny * ny + nz * nz);
+		if (length <= 1e-12f)
+			continue;
+
+		RasterizeTriangle(field, v, ny / length >= walkableCosine, origin, cs, ch);
+	}
+
+	// Walkable tops with the agent's height free above them
+	int clearance = (int)ceilf(settings.agentHeight / ch);
+	cellStart.resize((size_t)width * depth + 1);
+	for (size_t column = 0; column < field.heads.size(); column++)
+	{
+		cellStart[column] = (unsigned int)cells.size();
+		for (int s = field.heads[column]; s != -1; s = field.spans[s].next)
+		{
+			spanCount++;
+			const HeightSpan& span = field.spans[s];
+			int above = span.next == -1 ? INT_MAX : field.spans[span.next].min;
+			if (span.walkable && above - span.max >= clearance)
+			{
+				Cell cell = { span.max, -1 };
+				cells.push_back(cell);
+			}
+		}
+	}
+	cellStart[field.heads.size()] = (unsigned int)cells.size();
+
+	// Distance in cells from the nearest edge, where a cell
+	// is missing a neighbor it could step onto. Spreads out
+	// from the edges a ring at a time
+	int climb = (int)floorf(settings.agentClimb / ch);
+	const int dx[4] = { 1, 0, -1, 0 };
+	const int dz[4] = { 0, 1, 0, -1 };
+	std::vector<unsigned short> distances(cells.size(), 0xffff);
+	std::vector<unsigned int> frontier;
+	std::vector<unsigned int> columns(cells.size());
+	for (int z = 0; z < depth; z++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			unsigned int column = x + z * width;
+			for (unsigned int c = cellStart[column]; c < cellStart[column + 1]; c++)
+			{
+				columns[c] = column;
+				for (int d = 0; d < 4; d++)
+				{
+					if (FindCell(x + dx[d], z + dz[d], cells[c].y, climb) < 0)
+					{
+						distances[c] = 0;
+						frontier.push_back(c);
+						break;
+					}
+				}
+			}
+		}
+	}
+	for (size_t f = 0; f < frontier.size(); f++)
+	{
+		unsigned int c = frontier[f];
+		int x = columns[c] % width;
+		int z = columns[c] / width;
+		for (int d = 0; d < 4; d++)
+		{
+			int n = FindCell(x + dx[d], z + dz[d], cells[c].y, climb);
+			if (n >= 0 && distances[n] == 0xffff)
+			{
+				distances[n] = distances[c] + 1;
+				frontier.push_back(n);
+			}
+		}
+	}
+
+	// Cells the agent's center can't reach are left out
+	int erosion = (int)ceilf(settings.agentRadius / cs);
+	for (size_t c = 0; c < cells.size(); c++)
+	{
+		if (distances[c] < erosion)
+			cells[c].poly = -2;
+		else
+			walkableCellCount++;
+	}
+
+	// Rectangles, grown along x and then along z for as long
+	// as every cell is free and at the same height
+	int maxCells = (int)(std::max)(settings.maxPolyCells, 1u);
+	for (int z = 0; z < depth; z++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			unsigned int column = x + z * width;
+			for (unsigned int c = cellStart[column]; c < cellStart[column + 1]; c++)
+			{
+				if (cells[c].poly != -1)
+					continue;
+
+				int y = cells[c].y;
+				int w = 1;
+				while (w < maxCells)
+				{
+					int n = FindCell(x + w, z, y, 0);
+					if (n < 0 || cells[n].poly != -1)
+						break;
+					w++;
+				}
+
+				int d = 1;
+				while (d < maxCells)
+				{
+					bool free = true;
+					for (int i = 0; i < w && free; i++)
+					{
+						int n = FindCell(x + i, z + d, y, 0);
+						free = n >= 0 && cells[n].poly == -1;
+					}
+					if (!free)
+						break;
+					d++;
+				}
+
+				int index = (int)polys.size();
+				for (int j = 0; j < d; j++)
+					for (int i = 0; i < w; i++)
+						cells[FindCell(x + i, z + j, y, 0)].poly = index;
+
+				NavPoly poly = {};
+				poly.min[0] = origin[0] + x * cs;
+				poly.min[1] = origin[2] + z * cs;
+				poly.max[0] = origin[0] + (x + w) * cs;
+				poly.max[1] = origin[2] + (z + d) * cs;
+				poly.y = origin[1] + y * ch;
+				polys.push_back(poly);
+			}
+		}
+	}
+
+	// Walk the four sides of each rectangle, starting a new
+	// link wherever the polygon across the side changes
+	for (size_t p = 0; p < polys.size(); p++)
+	{
+		NavPoly& poly = polys[p];
+		poly.firstLink = (unsigned int)links.size();
+
+		int x0 = (int)floorf((poly.min[0] - origin[0]) / cs + 0.5f);
+		int z0 = (int)floorf((poly.min[1] - origin[2]) / cs + 0.5f);
+		int x1 = (int)floorf((poly.max[0] - origin[0]) / cs + 0.5f);
+		int z1 = (int)floorf((poly.max[1] - origin[2]) / cs + 0.5f);
+		int y = (int)floorf((poly.y - origin[1]) / ch + 0.5f);
+
+		for (int side = 0; side < 4; side++)
+		{
+			// Runs along z for the x sides, along x for the z sides
+			bool alongZ = side < 2;
+			int count = alongZ ? z1 - z0 : x1 - x0;
+			int runPoly = -1;
+			int runStart = 0;
+			for (int i = 0; i <= count; i++)
+			{
+				int across = -1;
+				if (i < count)
+				{
+					int x = alongZ ? (side == 0 ? x1 : x0 - 1) : x0 + i;
+					int z = alongZ ? z0 + i : (side == 2 ? z1 : z0 - 1);
+					int n = FindCell(x, z, y, climb);
+					if (n >= 0 && cells[n].poly >= 0 && cells[n].poly != (int)p)
+						across = cells[n].poly;
+				}
+				if (across == runPoly)
+					continue;
+
+				if (runPoly >= 0)
+				{
+					float portalY = (poly.y + polys[runPoly].y) * 0.5f;
+					float edge = alongZ
+						? (side == 0 ? poly.max[0] : poly.min[0])
+						: (side == 2 ? poly.max[1] : poly.min[1]);
+					float from = (alongZ ? origin[2] : origin[0]) + runStart * cs + (alongZ ? z0 : x0) * cs;
+					float to = (alongZ ? origin[2] : origin[0]) + i * cs + (alongZ ? z0 : x0) * cs;
+
+					NavLink link;
+					link.poly = (unsigned int)runPoly;
+					link.a[0] = alongZ ? edge : from;
+					link.a[1] = portalY;
+					link.a[2] = alongZ ? from : edge;
+					link.b[0] = alongZ ? edge : to;
+					link.b[1] = portalY;
+					link.b[2] = alongZ ? to : edge;
+					links.push_back(link);
+				}
+				runPoly = across;
+				runStart = i;
+			}
+		}
+
+		poly.linkCount = (unsigned int)links.size() - poly.firstLink;
+	}
+
+	buildMS = std::chrono::duration<float, std::milli>(
+		std::chrono::high_resolution_clock::now() - buildStart).count();
+}
+
+/// <summary>
+/// The cell of a column nearest a height, if one is within
+/// tolerance voxels of it
+/// </summary>
+int NavMesh::FindCell(int x, int z, int y, int tolerance) const
+{
+	if (x < 0 || z < 0 || x >= width || z >= depth)
+		return -1;
+
+	unsigned int column = x + z * width;
+	int best = -1;
+	int bestGap = tolerance + 1;
+	for (unsigned int c = cellStart[column]; c < cellStart[column + 1]; c++)
+	{
+		int gap = abs(cells[c].y - y);
+		if (gap < bestGap)
+		{
+			best = (int)c;
+			bestGap = gap;
+		}
+	}
+	return best;
+}
+
+int NavMesh::FindNearestPoly(const float point[3], float searchRadius, float nearest[3]) const
+{
+	if (polys.empty())
+		return -1;
+
+	const float cs = settings.cellSize;
+	float reachY = settings.agentClimb + settings.cellHeight * 2.0f;
+	int cx = (int)floorf((point[0] - origin[0]) / cs);
+	int cz = (int)floorf((point[2] - origin[2]) / cs);
+	int reach = (int)ceilf(searchRadius / cs);
+
+	// Most points asked about are already on a polygon, which
+	// the cell under them tells without looking any further
+	if (cx >= 0 && cz >= 0 && cx < width && cz < depth)
+	{
+		unsigned int column = cx + cz * width;
+		for (unsigned int c = cellStart[column]; c < cellStart[column + 1]; c++)
+		{
+			const Cell& cell = cells[c];
+			if (cell.poly >= 0 && fabsf(origin[1] + cell.y * settings.cellHeight - point[1]) <= reachY)
+			{
+				ClampToPoly(polys[cell.poly], point, nearest);
+				return cell.poly;
+			}
+		}
+	}
+
+	int best = -1;
+	float bestDistanceSq = searchRadius * searchRadius + reachY * reachY;
+	for (int z = cz - reach; z <= cz + reach; z++)
+	{
+		for (int x = cx - reach; x <= cx + reach; x++)
+		{
+			if (x < 0 || z < 0 || x >= width || z >= depth)
+				continue;
+
+			unsigned int column = x + z * width;
+			for (unsigned int c = cellStart[column]; c < cellStart[column + 1]; c++)
+			{
+				if (cells[c].poly < 0 || cells[c].poly == best)
+					continue;
+
+				float clamped[3];
+				ClampToPoly(polys[cells[c].poly], point, clamped);
+				float ox = clamped[0] - point[0];
+				float oy = clamped[1] - point[1];
+				float oz = clamped[2] - point[2];
+				float distanceSq = ox * ox + oy * oy + oz * oz;
+				if (fabsf(oy) <= reachY && distanceSq < bestDistanceSq)
+				{
+					best = cells[c].poly;
+					bestDistanceSq = distanceSq;
+					memcpy(nearest, clamped, sizeof(clamped));
+				}
+			}
+		}
+	}
+	return best;
+}
+
+// --------------------------------------------------------
+// Searching
+// --------------------------------------------------------
+
+NavQuery::NavQuery() :
+	mesh(nullptr),
+	search(0),
+	startPoly(-1),
+	endPoly(-1),
+	bestPoly(-1),
+	bestDistance(0.0f),
+	polysVisited(0),
+	status(NavPathStatus::Free)
+{
+}
+
+void NavQuery::Init(const NavMesh* mesh)
+{
+	this->mesh = mesh;
+	nodes.assign(mesh->GetPolyCount(), Node());
+	search = 0;
+	status = NavPathStatus::Free;
+}
+
+NavPathStatus NavQuery::Begin(const float start[3], const float end[3])
+{
+	open.clear();
+	polysVisited = 0;
+	startPoly = mesh->FindNearestPoly(start, NAV_SNAP_DISTANCE, this->start);
+	endPoly = mesh->FindNearestPoly(end, NAV_SNAP_DISTANCE, this->end);
+	if (startPoly < 0 || endPoly < 0)
+		return status = NavPathStatus::Failed;
+
+	// Stamps save clearing every node between searches,
+	// until they wrap
+	if (++search == 0)
+	{
+		for (Node& node : nodes)
+			node.search = 0;
+		search = 1;
+	}
+
+	Node& node = nodes[startPoly];
+	node.cost = 0.0f;
+	node.total = Distance(this->start, this->end);
+	memcpy(node.position, this->start, sizeof(node.position));
+	node.parent = -1;
+	node.search = search;
+	node.closed = false;
+	Push(startPoly, node.total);
+
+	bestPoly = startPoly;
+	bestDistance = node.total;
+	return status = NavPathStatus::Searching;
+}
+
+/// <summary>
+/// Every polygon is entered through the middle of the portal
+/// it was reached by, and costs the straight distance from
+/// where its parent was entered
+/// </summary>
+NavPathStatus NavQuery::Step(unsigned int maxSteps, unsigned int* stepsTaken)
+{
+	unsigned int steps = 0;
+	while (status == NavPathStatus::Searching && steps < maxSteps)
+	{
+		int p = Pop();
+		if (p < 0)
+		{
+			status = NavPathStatus::Partial;
+			break;
+		}
+
+		Node& node = nodes[p];
+		node.closed = true;
+		steps++;
+		polysVisited++;
+
+		float toEnd = Distance(node.position, end);
+		if (toEnd < bestDistance)
+		{
+			bestPoly = p;
+			bestDistance = toEnd;
+		}
+		if (p == endPoly)
+		{
+			status = NavPathStatus::Found;
+			break;
+		}
+
+		const NavPoly& poly = mesh->GetPoly(p);
+		for (unsigned int l = poly.firstLink; l < poly.firstLink + poly.linkCount; l++)
+		{
+			const NavLink& link = mesh->GetLink(l);
+			Node& neighbor = nodes[link.poly];
+			bool fresh = neighbor.search != search;
+			if (!fresh && neighbor.closed)
+				continue;
+
+			float middle[3] =
+			{
+				(link.a[0] + link.b[0]) * 0.5f,
+				(link.a[1] + link.b[1]) * 0.5f,
+				(link.a[2] + link.b[2]) * 0.5f
+			};
+			float cost = node.cost + Distance(node.position, middle);
+			float heuristic = Distance(middle, end);
+			if (!fresh && cost >= neighbor.cost)
+				continue;
+
+			neighbor.cost = cost;
+			neighbor.total = cost + heuristic;
+			memcpy(neighbor.position, middle, sizeof(middle));
+			neighbor.parent = p;
+			neighbor.search = search;
+			neighbor.closed = false;
+			Push((int)link.poly, neighbor.total);
+		}
+	}
+
+	*stepsTaken = steps;
+	return status;
+}
+
+/// <summary>
+/// Walks back from the last polygon to the first, then runs
+/// the funnel over the portals between them. The funnel's
+/// sides narrow portal by portal until one crosses the
+/// other, and the side it crossed becomes a corner
+/// </summary>
+unsigned int NavQuery::Finish(float* points)
+{
+	if (status != NavPathStatus::Found && status != NavPathStatus::Partial)
+		return 0;
+
+	int last = status == NavPathStatus::Found ? endPoly : bestPoly;
+	float goal[3];
+	if (status == NavPathStatus::Found)
+		memcpy(goal, end, sizeof(goal));
+	else
+		ClampToPoly(mesh->GetPoly(last), end, goal);
+
+	corridor.clear();
+	for (int p = last; p >= 0; p = nodes[p].parent)
+		corridor.push_back(p);
+	std::reverse(corridor.begin(), corridor.end());
+
+	// Portals as left then right corners, seen from the
+	// polygon before them. The first and last are the start
+	// and goal
+	portals.clear();
+	portals.insert(portals.end(), start, start + 3);
+	portals.insert(portals.end(), start, start + 3);
+	for (size_t i = 0; i + 1 < corridor.size(); i++)
+	{
+		const NavPoly& from = mesh->GetPoly(corridor[i]);
+		const NavPoly& to = mesh->GetPoly(corridor[i + 1]);
+		for (unsigned int l = from.firstLink; l < from.firstLink + from.linkCount; l++)
+		{
+			const NavLink& link = mesh->GetLink(l);
+			if (link.poly != (unsigned int)corridor[i + 1])
+				continue;
+
+			float a[3] = { (from.min[0] + from.max[0]) * 0.5f, 0.0f, (from.min[1] + from.max[1]) * 0.5f };
+			float b[3] = { (to.min[0] + to.max[0]) * 0.5f, 0.0f, (to.min[1] + to.max[1]) * 0.5f };
+			bool aIsLeft = Cross2(a, b, link.a) > 0.0f;
+			const float* left = aIsLeft ? link.a : link.b;
+			const float* right = aIsLeft ? link.b : link.a;
+			portals.insert(portals.end(), left, left + 3);
+			portals.insert(portals.end(), right, right + 3);
+			break;
+		}
+	}
+	portals.insert(portals.end(), goal, goal + 3);
+	portals.insert(portals.end(), goal, goal + 3);
+
+	unsigned int count = 0;
+	auto addPoint = [&](const float* point)
+	{
+		if (count > 0 && SameSpot(points + (count - 1) * 3, point))
+			return;
+		if (count < NAV_MAX_PATH_POINTS)
+		{
+			memcpy(points + count * 3, point, sizeof(float) * 3);
+			count++;
+		}
+	};
+
+	float apex[3];
+	float left[3];
+	float right[3];
+	memcpy(apex, start, sizeof(apex));
+	memcpy(left, start, sizeof(left));
+	memcpy(right, start, sizeof(right));
+	int apexIndex = 0;
+	int leftIndex = 0;
+	int rightIndex = 0;
+	addPoint(start);
+
+	int portalCount = (int)portals.size() / 6;
+	for (int i = 1; i < portalCount; i++)
+	{
+		const float* portalLeft = &portals[i * 6];
+		const float* portalRight = &portals[i * 6 + 3];
+
+		// Narrow the right side, or turn around the left corner
+		// if it would cross over
+		if (Cross2(apex, right, portalRight) >= 0.0f)
+		{
+			if (SameSpot(apex, right) || Cross2(apex, left, portalRight) < 0.0f)
+			{
+				memcpy(right, portalRight, sizeof(right));
+				rightIndex = i;
+			}
+			else
+			{
+				addPoint(left);
+				memcpy(apex, left, sizeof(apex));
+				apexIndex = leftIndex;
+				memcpy(right, apex, sizeof(right));
+				leftIndex = rightIndex = apexIndex;
+				i = apexIndex;
+				continue;
+			}
+		}
+
+		// And the same for the left side
+		if (Cross2(apex, left, portalLeft) <= 0.0f)
+		{
+			if (SameSpot(apex, left) || Cross2(apex, right, portalLeft) > 0.0f)
+			{
+				memcpy(left, portalLeft, sizeof(left));
+				leftIndex = i;
+			}
+			else
+			{
+				addPoint(right);
+				memcpy(apex, right, sizeof(apex));
+				apexIndex = rightIndex;
+				memcpy(left, apex, sizeof(left));
+				leftIndex = rightIndex = apexIndex;
+				i = apexIndex;
+				continue;
+			}
+		}
+	}
+
+	// The goal can be cut off when the path has too many corners
+	if (count == NAV_MAX_PATH_POINTS)
+		count--;
+	addPoint(goal);
+	return count;
+}
+
+void NavQuery::Push(int poly, float total)
+{
+	OpenEntry entry = { total, poly };
+	open.push_back(entry);
+	std::push_heap(open.begin(), open.end(), [](const OpenEntry& a, const OpenEntry& b) { return a.total > b.total; });
+}
+
+int NavQuery::Pop()
+{
+	while (!open.empty())
+	{
+		std::pop_heap(open.begin(), open.end(), [](const OpenEntry& a, const OpenEntry& b) { return a.total > b.total; });
+		OpenEntry entry = open.back();
+		open.pop_back();
+
+		// Entries left behind when a cheaper way was found
+		const Node& node = nodes[entry.poly];
+		if (!node.closed && entry.total <= node.total)
+			return entry.poly;
+	}
+	return -1;
+}
+
+// --------------------------------------------------------
+// Request queue
+// --------------------------------------------------------
+
+NavPathQueue::NavPathQueue(const NavMesh* mesh, unsigned int sliceCount) :
+	mesh(mesh)
+{
+	sliceCount = (std::max)(1u, (std::min)(sliceCount, (unsigned int)NAV_MAX_SLICES));
+	slices.resize(sliceCount);
+	for (Slice& slice : slices)
+	{
+		slice.query.Init(mesh);
+		slice.next = 0;
+	}
+}
+
+unsigned int NavPathQueue::Request(const float start[3], const float end[3])
+{
+	unsigned int ticket;
+	if (!freeTickets.empty())
+	{
+		ticket = freeTickets.back();
+		freeTickets.pop_back();
+	}
+	else
+	{
+		ticket = (unsigned int)requests.size();
+		requests.push_back(PathRequest());
+	}
+
+	PathRequest& request = requests[ticket];
+	memcpy(request.start, start, sizeof(request.start));
+	memcpy(request.end, end, sizeof(request.end));
+	request.status = NavPathStatus::Waiting;
+	request.queued = true;
+	request.released = false;
+	request.pointCount = 0;
+
+	// To whichever slice has the least left to do
+	Slice* shortest = &slices[0];
+	for (Slice& slice : slices)
+		if (slice.waiting.size() - slice.next < shortest->waiting.size() - shortest->next)
+			shortest = &slice;
+	shortest->waiting.push_back(ticket);
+	return ticket;
+}
+
+void NavPathQueue::Release(unsigned int ticket)
+{
+	PathRequest& request = requests[ticket];
+	if (request.status == NavPathStatus::Free)
+		return;
+
+	request.released = true;
+	if (!request.queued)
+	{
+		request.status = NavPathStatus::Free;
+		freeTickets.push_back(ticket);
+	}
+}
+
+Span<const float> NavPathQueue::GetPath(unsigned int ticket) const
+{
+	const PathRequest& request = requests[ticket];
+	return Span<const float>(request.points, request.pointCount * 3);
+}
+
+unsigned int NavPathQueue::GetPendingCount() const
+{
+	unsigned int pending = 0;
+	for (const Slice& slice : slices)
+		pending += (unsigned int)slice.waiting.size() - slice.next;
+	return pending;
+}
+
+void NavPathQueue::Update(unsigned int stepsPerSlice)
+{
+	Collect();
+	for (Slice& slice : slices)
+		UpdateSlice(slice, stepsPerSlice);
+}
+
+unsigned int NavPathQueue::AddJobs(RenderJobGraph* graph, unsigned int stepsPerSlice)
+{
+	Collect();
+
+	unsigned int jobs[NAV_MAX_SLICES];
+	for (unsigned int s = 0; s < slices.size(); s++)
+		jobs[s] = graph->AddJob("Path Slice", [this, s, stepsPerSlice](unsigned int) { UpdateSlice(slices[s], stepsPerSlice); });
+	return graph->AddJob("Finish Path Slices", [](unsigned int) {}, Span<const unsigned int>(jobs, (unsigned int)slices.size()));
+}
+
+void NavPathQueue::Collect()
+{
+	for (Slice& slice : slices)
+	{
+		for (unsigned int i = 0; i < slice.next; i++)
+		{
+			unsigned int ticket = slice.waiting[i];
+			PathRequest& request = requests[ticket];
+			if (request.released && !request.queued && request.status != NavPathStatus::Free)
+			{
+				request.status = NavPathStatus::Free;
+				freeTickets.push_back(ticket);
+			}
+		}
+		slice.waiting.erase(slice.waiting.begin(), slice.waiting.begin() + slice.next);
+		slice.next = 0;
+	}
+}
+
+/// <summary>
+/// Works down a slice's requests until its steps run out.
+/// A search cut off by the budget picks up where it left off
+/// next update
+/// </summary>
+void NavPathQueue::UpdateSlice(Slice& slice, unsigned int stepsPerSlice)
+{
+	unsigned int budget = stepsPerSlice;
+	while (budget > 0 && slice.next < slice.waiting.size())
+	{
+		PathRequest& request = requests[slice.waiting[slice.next]];
+		if (request.released)
+		{
+			request.queued = false;
+			slice.next++;
+			continue;
+		}
+
+		if (request.status == NavPathStatus::Waiting)
+			request.status = slice.query.Begin(request.start, request.end);
+		if (request.status == NavPathStatus::Searching)
+		{
+			unsigned int taken = 0;
+			request.status = slice.query.Step(budget, &taken);
+			budget -= (std::min)(taken, budget);
+		}
+		if (request.status == NavPathStatus::Searching)
+			break;
+
+		request.pointCount = slice.query.Finish(request.points);
+		request.queued = false;
+		slice.next++;
+	}
+}
+
+// --------------------------------------------------------
+// Benchmark
+// --------------------------------------------------------
+
+NavBenchmark BenchmarkNavigation(
+	const float* triangles,
+	size_t triangleCount,
+	unsigned int agentCount,
+	unsigned int rounds,
+	unsigned int workerCount)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const unsigned int stepsPerTick = 256;
+
+	NavBenchmark result = {};
+	result.agentCount = agentCount;
+	result.workerCount = workerCount;
+
+	NavMesh mesh;
+	mesh.Build(triangles, triangleCount, DefaultNavBuildSettings());
+	result.polyCount = mesh.GetPolyCount();
+	result.buildMS = mesh.GetBuildMS();
+	if (mesh.GetPolyCount() == 0)
+		return result;
+
+	// Somewhere on a random polygon for each end of each path
+	std::mt19937 random(45);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::uniform_int_distribution<unsigned int> pick(0, mesh.GetPolyCount() - 1);
+	result.pathCount = agentCount * rounds;
+	std::vector<float> ends(result.pathCount * 6);
+	for (unsigned int i = 0; i < result.pathCount * 2; i++)
+	{
+		const NavPoly& poly = mesh.GetPoly(pick(random));
+		ends[i * 3 + 0] = poly.min[0] + (poly.max[0] - poly.min[0]) * unit(random);
+		ends[i * 3 + 1] = poly.y;
+		ends[i * 3 + 2] = poly.min[1] + (poly.max[1] - poly.min[1]) * unit(random);
+	}
+
+	// Each path searched start to finish, one at a time
+	NavQuery query;
+	query.Init(&mesh);
+	float points[NAV_MAX_PATH_POINTS * 3];
+	unsigned long long corners = 0;
+	unsigned long long visited = 0;
+	Clock::time_point start = Clock::now();
+	for (unsigned int p = 0; p < result.pathCount; p++)
+	{
+		NavPathStatus status = query.Begin(&ends[p * 6], &ends[p * 6 + 3]);
+		unsigned int taken;
+		while (status == NavPathStatus::Searching)
+			status = query.Step(stepsPerTick, &taken);
+		corners += query.Finish(points);
+		visited += query.GetPolysVisited();
+		if (status != NavPathStatus::Found)
+			result.unreachedPaths++;
+	}
+	float serialSeconds = std::chrono::duration<float>(Clock::now() - start).count();
+	result.serialPathsPerSecond = serialSeconds > 0.0f ? result.pathCount / serialSeconds : 0.0f;
+	result.averageCorners = (unsigned int)(corners / result.pathCount);
+	result.averagePolysVisited = (unsigned int)(visited / result.pathCount);
+
+	// The same paths through a queue, a slice a worker and
+	// another for the thread running the graph, a tick's
+	// worth of steps each at a time
+	RenderJobGraph graph(workerCount);
+	NavPathQueue queue(&mesh, workerCount + 1);
+	start = Clock::now();
+	for (unsigned int p = 0; p < result.pathCount; p++)
+		queue.Request(&ends[p * 6], &ends[p * 6 + 3]);
+	while (queue.GetPendingCount() > 0)
+	{
+		graph.Reset();
+		queue.AddJobs(&graph, stepsPerTick);
+		graph.Run(true);
+		result.parallelTicks++;
+	}
+	float parallelSeconds = std::chrono::duration<float>(Clock::now() - start).count();
+	result.parallelPathsPerSecond = parallelSeconds > 0.0f ? result.pathCount / parallelSeconds : 0.0f;
+	return result;
+}
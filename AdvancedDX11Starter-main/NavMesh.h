@@ -0,0 +1,296 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Let enemies find their way around the level. The
+//			level's triangles are voxelized into a heightfield,
+//			the spans an agent can stand on are kept, shrunk
+//			away from walls and ledges by the agent's radius,
+//			and merged into flat rectangles that become the
+//			polygons of the navigation mesh. Paths are found
+//			with A* over the polygons and pulled tight through
+//			the portals between them. A search can stop after a
+//			number of steps and carry on next tick, so a queue
+//			of requests is worked through a slice at a time,
+//			spread over the job graph's workers.
+
+#include <vector>
+#include <stddef.h>
+
+#include "FrameArena.h"
+#include "RenderJobGraph.h"
+
+// Most corners a finished path keeps, the start and end
+// included. Longer paths are cut short
+#define NAV_MAX_PATH_POINTS 64
+
+// Most slices a queue works on at once
+#define NAV_MAX_SLICES 64
+
+/// <summary>
+/// How the level is voxelized and who it is built for
+/// </summary>
+struct NavBuildSettings
+{
+	float cellSize;			// Width of a heightfield column
+	float cellHeight;		// Height of a voxel
+	float agentRadius;
+	float agentHeight;
+	float agentClimb;		// Tallest step the agent walks up
+	float maxSlope;			// Degrees from flat
+	unsigned int maxPolyCells;	// Longest side of a polygon, in cells
+};
+
+/// <summary>
+/// Settings for agents the size of the player's capsule
+/// </summary>
+NavBuildSettings DefaultNavBuildSettings();
+
+/// <summary>
+/// A flat rectangle of walkable cells, and the run of links
+/// to the polygons next to it
+/// </summary>
+struct NavPoly
+{
+	float min[2];		// X and Z
+	float max[2];
+	float y;
+	unsigned int firstLink;
+	unsigned int linkCount;
+};
+
+/// <summary>
+/// Where two polygons meet. The portal is the stretch of
+/// their shared side either can be crossed through
+/// </summary>
+struct NavLink
+{
+	unsigned int poly;
+	float a[3];
+	float b[3];
+};
+
+class NavMesh
+{
+public:
+	NavMesh();
+
+	// Builds from a world space triangle soup, nine floats a
+	// triangle, replacing whatever was built before
+	void Build(const float* triangles, size_t triangleCount, const NavBuildSettings& settings);
+
+	/// <summary>
+	/// The polygon under or nearest a point, looking at most
+	/// searchRadius to the side and a little more than the
+	/// agent's climb up or down. The point is moved onto the
+	/// polygon. Returns -1 when nothing is close enough
+	/// </summary>
+	int FindNearestPoly(const float point[3], float searchRadius, float nearest[3]) const;
+
+	unsigned int GetPolyCount() const { return (unsigned int)polys.size(); }
+	unsigned int GetLinkCount() const { return (unsigned int)links.size(); }
+	const NavPoly& GetPoly(unsigned int index) const { return polys[index]; }
+	const NavLink& GetLink(unsigned int index) const { return links[index]; }
+
+	unsigned int GetSpanCount() const { return spanCount; }
+	unsigned int GetWalkableCellCount() const { return walkableCellCount; }
+	const NavBuildSettings& GetSettings() const { return settings; }
+	float GetBuildMS() const { return buildMS; }
+
+private:
+
+	// A walkable span's top, and the polygon it ended up in,
+	// -1 for cells too close to an edge
+	struct Cell
+	{
+		int y;
+		int poly;
+	};
+
+	int FindCell(int x, int z, int y, int tolerance) const;
+
+	NavBuildSettings settings;
+	float origin[3];
+	int width;
+	int depth;
+
+	// Cells of column x + z * width are cellStart[column]
+	// up to cellStart[column + 1]
+	std::vector<unsigned int> cellStart;
+	std::vector<Cell> cells;
+
+	std::vector<NavPoly> polys;
+	std::vector<NavLink> links;
+
+	unsigned int spanCount;
+	unsigned int walkableCellCount;
+	float buildMS;
+};
+
+enum class NavPathStatus
+{
+	Free,
+	Waiting,
+	Searching,
+	Found,
+	Partial,	// Ran out of steps or path, ends as close as it got
+	Failed
+};
+
+/// <summary>
+/// One search over a mesh, which can be stepped a bit at a
+/// time. Keeps scratch for every polygon, so there is one
+/// per thread searching rather than one per path
+/// </summary>
+class NavQuery
+{
+public:
+	NavQuery();
+
+	void Init(const NavMesh* mesh);
+
+	// Snaps both points onto the mesh. Fails when either is
+	// off it
+	NavPathStatus Begin(const float start[3], const float end[3]);
+
+	// Expands at most maxSteps polygons. Returns Searching
+	// until the end is reached or nothing is left to expand
+	NavPathStatus Step(unsigned int maxSteps, unsigned int* stepsTaken);
+
+	// Pulls the path found through its portals into corners,
+	// three floats each, at most NAV_MAX_PATH_POINTS. Ends at
+	// the polygon closest to the end if it was never reached
+	unsigned int Finish(float* points);
+
+	unsigned int GetPolysVisited() const { return polysVisited; }
+
+private:
+	struct OpenEntry
+	{
+		float total;
+		int poly;
+	};
+
+	struct Node
+	{
+		float cost;
+		float total;
+		float position[3];		// Where the path enters the polygon
+		int parent;
+		unsigned int search;	// Which search last touched it
+		bool closed;
+	};
+
+	// Open polygons are a heap that may hold stale entries,
+	// skipped when popped, rather than one with a decrease key
+	void Push(int poly, float total);
+	int Pop();
+
+	const NavMesh* mesh;
+	std::vector<Node> nodes;
+	std::vector<OpenEntry> open;
+	std::vector<int> corridor;
+	std::vector<float> portals;
+	unsigned int search;
+
+	float start[3];
+	float end[3];
+	int startPoly;
+	int endPoly;
+	int bestPoly;			// Closest to the end so far
+	float bestDistance;
+	unsigned int polysVisited;
+	NavPathStatus status;
+};
+
+/// <summary>
+/// Path requests worked through a slice of search steps at
+/// a time. Every slice has its own query and its own queue
+/// of requests, so slices never share anything and can run
+/// on any thread. Requests are only made and released
+/// between updates
+/// </summary>
+class NavPathQueue
+{
+public:
+	NavPathQueue(const NavMesh* mesh, unsigned int sliceCount);
+
+	// A ticket to ask after the path with
+	unsigned int Request(const float start[3], const float end[3]);
+	void Release(unsigned int ticket);
+
+	NavPathStatus GetStatus(unsigned int ticket) const { return requests[ticket].status; }
+
+	// Corners of a found or partial path, empty otherwise
+	Span<const float> GetPath(unsigned int ticket) const;
+
+	// Gives every slice stepsPerSlice polygons to expand on
+	// the calling thread
+	void Update(unsigned int stepsPerSlice);
+
+	// Adds a job per slice to a graph and returns the index
+	// of a job waiting on all of them
+	unsigned int AddJobs(RenderJobGraph* graph, unsigned int stepsPerSlice);
+
+	unsigned int GetSliceCount() const { return (unsigned int)slices.size(); }
+	unsigned int GetPendingCount() const;
+
+private:
+	struct PathRequest
+	{
+		float start[3];
+		float end[3];
+		NavPathStatus status;
+		bool queued;		// Still in a slice's waiting list
+		bool released;		// Given back while queued, freed once it leaves
+		unsigned int pointCount;
+		float points[NAV_MAX_PATH_POINTS * 3];
+	};
+
+	struct Slice
+	{
+		NavQuery query;
+		std::vector<unsigned int> waiting;
+		unsigned int next;		// First of waiting not yet done
+	};
+
+	// Frees tickets released while their slice still had
+	// them, and drops finished requests from the slices
+	void Collect();
+	void UpdateSlice(Slice& slice, unsigned int stepsPerSlice);
+
+	const NavMesh* mesh;
+	std::vector<PathRequest> requests;
+	std::vector<unsigned int> freeTickets;
+	std::vector<Slice> slices;
+};
+
+/// <summary>
+/// Results of one headless benchmark run
+/// </summary>
+struct NavBenchmark
+{
+	unsigned int polyCount;
+	float buildMS;
+	unsigned int agentCount;
+	unsigned int pathCount;
+	unsigned int unreachedPaths;	// Islands the end couldn't be reached from
+	unsigned int averageCorners;
+	unsigned int averagePolysVisited;
+	unsigned int workerCount;
+	float serialPathsPerSecond;
+	float parallelPathsPerSecond;
+	unsigned int parallelTicks;		// To finish everything at stepsPerTick a slice
+};
+
+/// <summary>
+/// Rebuilds the mesh from the triangles to time it, then has
+/// every agent ask for rounds paths between random polygons,
+/// worked through once on the calling thread and once as a
+/// slice a worker across a job graph
+/// </summary>
+NavBenchmark BenchmarkNavigation(
+	const float* triangles,
+	size_t triangleCount,
+	unsigned int agentCount,
+	unsigned int rounds,
+	unsigned int workerCount);
@@ -0,0 +1,763 @@
+#include "NetPlayers.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <string.h>
+
+namespace
+{
+	// First in every packet, so stray datagrams are ignored
+	const uint32_t NET_PROTOCOL = 0x444D;
+
+	enum NetPacketType
+	{
+		NET_PACKET_CONNECT = 1,
+		NET_PACKET_DISCONNECT,
+		NET_PACKET_INPUT,
+		NET_PACKET_SNAPSHOT
+	};
+
+	const float TWO_PI = 6.28318530718f;
+	const float HALF_PI = 1.57079632679f;
+	const float YAW_STEP = TWO_PI / 65536.0f;
+	const float PITCH_STEP = (2.0f * HALF_PI) / 65535.0f;
+
+	int32_t Quantize(float value, float scale)
+	{
+		return (int32_t)floorf(value * scale + 0.5f);
+	}
+
+	void WriteHeader(BitWriter& writer, NetPacketType type)
+	{
+		writer.Write(NET_PROTOCOL, 16);
+		writer.Write(type, 8);
+	}
+
+	// Wrapping differences, so values that overflow still
+	// come back out where they went in
+	int32_t Difference(int32_t value, int32_t base) { return (int32_t)((uint32_t)value - (uint32_t)base); }
+	int32_t Add(int32_t base, int32_t difference) { return (int32_t)((uint32_t)base + (uint32_t)difference); }
+
+	// A player one bit long when nothing changed, each field
+	// otherwise written as how far it moved
+	void WritePlayer(BitWriter& writer, const NetPlayerState& player, const NetPlayerState& base)
+	{
+		bool changed = !SamePlayerState(player, base);
+		writer.Write(changed ? 1 : 0, 1);
+		if (!changed)
+			return;
+
+		for (int i = 0; i < 3; i++)
+			writer.WriteSigned(Difference(player.position[i], base.position[i]));
+		for (int i = 0; i < 3; i++)
+			writer.WriteSigned(Difference(player.velocity[i], base.velocity[i]));
+		writer.WriteSigned(Difference(player.fallSpeed, base.fallSpeed));
+		writer.WriteSigned((int16_t)(uint16_t)(player.yaw - base.yaw));
+		writer.WriteSigned((int16_t)(uint16_t)(player.pitch - base.pitch));
+		writer.Write(player.grounded, 1);
+	}
+
+	void ReadPlayer(BitReader& reader, const NetPlayerState& base, NetPlayerState* player)
+	{
+		uint16_t id = player->id;
+		*player = base;
+		player->id = id;
+		if (reader.Read(1) == 0)
+			return;
+
+		for (int i = 0; i < 3; i++)
+			player->position[i] = Add(base.position[i], reader.ReadSigned());
+		for (int i = 0; i < 3; i++)
+			player->velocity[i] = Add(base.velocity[i], reader.ReadSigned());
+		player->fallSpeed = Add(base.fallSpeed, reader.ReadSigned());
+		player->yaw = (uint16_t)(base.yaw + reader.ReadSigned());
+		player->pitch = (uint16_t)(base.pitch + reader.ReadSigned());
+		player->grounded = (uint8_t)reader.Read(1);
+	}
+
+	// The baseline's state for the same player, found by
+	// walking both lists in id order, or all zeros if the
+	// player is new
+	NetPlayerState FindBase(const NetSnapshot* baseline, uint16_t id, unsigned int* cursor)
+	{
+		NetPlayerState base = {};
+		base.id = id;
+		if (!baseline)
+			return base;
+
+		while (*cursor < baseline->playerCount && baseline->players[*cursor].id < id)
+			(*cursor)++;
+		if (*cursor < baseline->playerCount && baseline->players[*cursor].id == id)
+			base = baseline->players[*cursor];
+		return base;
+	}
+}
+
+// --------------------------------------------------------
+// Quantizing
+// --------------------------------------------------------
+
+NetPlayerState QuantizePlayerState(uint16_t id, const PlayerMotionState& state)
+{
+	NetPlayerState net;
+	net.id = id;
+	for (int i = 0; i < 3; i++)
+	{
+		net.position[i] = Quantize(state.position[i], NET_POSITION_SCALE);
+		net.velocity[i] = Quantize(state.velocity[i], NET_VELOCITY_SCALE);
+	}
+	net.fallSpeed = Quantize(state.fallSpeed, NET_VELOCITY_SCALE);
+
+	float yaw = fmodf(state.yaw, TWO_PI);
+	if (yaw < 0.0f)
+		yaw += TWO_PI;
+	net.yaw = (uint16_t)((uint32_t)Quantize(yaw, 1.0f / YAW_STEP) & 0xFFFF);
+
+	int32_t pitch = Quantize(state.pitch + HALF_PI, 1.0f / PITCH_STEP);
+	net.pitch = (uint16_t)(std::max)(0, (std::min)(pitch, 65535));
+	net.grounded = state.grounded ? 1 : 0;
+	return net;
+}
+
+void DequantizePlayerState(const NetPlayerState& net, PlayerMotionState* state)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		state->position[i] = net.position[i] / NET_POSITION_SCALE;
+		state->velocity[i] = net.velocity[i] / NET_VELOCITY_SCALE;
+	}
+	state->fallSpeed = net.fallSpeed / NET_VELOCITY_SCALE;
+	state->yaw = net.yaw * YAW_STEP;
+	state->pitch = net.pitch * PITCH_STEP - HALF_PI;
+	state->grounded = net.grounded != 0;
+}
+
+bool SamePlayerState(const NetPlayerState& a, const NetPlayerState& b)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		if (a.position[i] != b.position[i] || a.velocity[i] != b.velocity[i])
+			return false;
+	}
+	return a.fallSpeed == b.fallSpeed &&
+		a.yaw == b.yaw &&
+		a.pitch == b.pitch &&
+		a.grounded == b.grounded;
+}
+
+void SnapPlayerState(PlayerMotionState* state)
+{
+	DequantizePlayerState(QuantizePlayerState(0, *state), state);
+}
+
+NetInput QuantizeInput(const PlayerMotionInput& input)
+{
+	NetInput net;
+	for (int i = 0; i < 2; i++)
+	{
+		float dir = (std::max)(-1.0f, (std::min)(input.dir[i * 2], 1.0f));
+		net.dir[i] = (int8_t)Quantize(dir, 127.0f);
+
+		int32_t mouse = Quantize(input.mouseDelta[i], 16.0f);
+		net.mouseDelta[i] = (int16_t)(std::max)(-32768, (std::min)(mouse, 32767));
+	}
+	return net;
+}
+
+PlayerMotionInput DequantizeInput(const NetInput& input)
+{
+	PlayerMotionInput motion;
+	motion.dir[0] = input.dir[0] / 127.0f;
+	motion.dir[1] = 0.0f;
+	motion.dir[2] = input.dir[1] / 127.0f;
+	motion.mouseDelta[0] = input.mouseDelta[0] / 16.0f;
+	motion.mouseDelta[1] = input.mouseDelta[1] / 16.0f;
+	return motion;
+}
+
+// --------------------------------------------------------
+// Snapshots
+// --------------------------------------------------------
+
+size_t WriteSnapshot(const NetSnapshot& snapshot, const NetSnapshot* baseline, unsigned char* buffer, size_t capacity)
+{
+	BitWriter writer(buffer, capacity);
+	WriteHeader(writer, NET_PACKET_SNAPSHOT);
+	writer.Write(snapshot.tick, 32);
+	writer.WriteSigned(baseline ? (int32_t)(snapshot.tick - baseline->tick) : 0);
+	writer.Write(snapshot.playerId, 16);
+	writer.Write(snapshot.lastInput, 32);
+	writer.Write(snapshot.playerCount, 8);
+
+	// Ids go in as the gap from the one before
+	unsigned int cursor = 0;
+	int32_t previous = -1;
+	for (unsigned int p = 0; p < snapshot.playerCount; p++)
+	{
+		const NetPlayerState& player = snapshot.players[p];
+		writer.WriteSigned(player.id - previous - 1);
+		previous = player.id;
+		WritePlayer(writer, player, FindBase(baseline, player.id, &cursor));
+	}
+
+	return writer.Overflowed() ? 0 : writer.GetBytes();
+}
+
+bool ReadSnapshot(const unsigned char* data, size_t bytes, const NetSnapshot* history, NetSnapshot* snapshot)
+{
+	BitReader reader(data, bytes);
+	if (reader.Read(16) != NET_PROTOCOL || reader.Read(8) != NET_PACKET_SNAPSHOT)
+		return false;
+
+	snapshot->tick = reader.Read(32);
+	int32_t back = reader.ReadSigned();
+	snapshot->playerId = (uint16_t)reader.Read(16);
+	snapshot->lastInput = reader.Read(32);
+	snapshot->playerCount = reader.Read(8);
+	if (reader.Overflowed() || snapshot->tick == NET_NONE || snapshot->playerCount > NET_SNAPSHOT_PLAYERS || back < 0)
+		return false;
+
+	const NetSnapshot* baseline = 0;
+	if (back > 0)
+	{
+		uint32_t baseTick = snapshot->tick - (uint32_t)back;
+		baseline = &history[baseTick % NET_SNAPSHOT_HISTORY];
+		if (baseline->tick != baseTick)
+			return false;
+	}
+
+	unsigned int cursor = 0;
+	int32_t previous = -1;
+	for (unsigned int p = 0; p < snapshot->playerCount; p++)
+	{
+		NetPlayerState& player = snapshot->players[p];
+		previous += reader.ReadSigned() + 1;
+		player.id = (uint16_t)previous;
+		ReadPlayer(reader, FindBase(baseline, player.id, &cursor), &player);
+	}
+
+	return !reader.Overflowed();
+}
+
+// --------------------------------------------------------
+// Server
+// --------------------------------------------------------
+
+NetServerSettings DefaultNetServerSettings()
+{
+	NetServerSettings settings;
+	settings.port = 27020;
+	settings.maxClients = 64;
+	settings.timeoutSeconds = 5.0f;
+	settings.spawn[0] = 0.0f;
+	settings.spawn[1] = 1.0f;
+	settings.spawn[2] = 0.0f;
+	settings.spawnSpacing = 2.0f;
+
+	// As AddPlayer() sets them up
+	settings.motion.acceleration = 15.0f;
+	settings.motion.deceleration = 30.0f;
+	settings.motion.maxSpeed = 8.0f;
+	settings.motion.mouseSensitivity = 0.5f;
+	settings.measureWholeSnapshots = false;
+	return settings;
+}
+
+NetServer::NetServer() :
+	settings(DefaultNetServerSettings()),
+	level(0),
+	tick(0),
+	nextPlayerId(0),
+	snapshotsSent(0),
+	wholeSnapshotsSent(0),
+	wholeSnapshotBytes(0),
+	playerSteps(0)
+{
+}
+
+bool NetServer::Start(const NetServerSettings& serverSettings, const LevelCollision* serverLevel)
+{
+	Stop();
+	settings = serverSettings;
+	level = serverLevel;
+	tick = 0;
+	nextPlayerId = 0;
+	snapshotsSent = 0;
+	wholeSnapshotsSent = 0;
+	wholeSnapshotBytes = 0;
+	playerSteps = 0;
+	return socket.Open(settings.port);
+}
+
+void NetServer::Stop()
+{
+	socket.Close();
+	clients.clear();
+}
+
+bool NetServer::GetPlayerState(uint16_t playerId, PlayerMotionState* state) const
+{
+	for (const Client& client : clients)
+	{
+		if (client.playerId == playerId)
+		{
+			*state = client.state;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool NetServer::SetPlayerState(uint16_t playerId, const PlayerMotionState& state)
+{
+	for (Client& client : clients)
+	{
+		if (client.playerId == playerId)
+		{
+			client.state = state;
+			SnapPlayerState(&client.state);
+			return true;
+		}
+	}
+	return false;
+}
+
+NetServer::Client* NetServer::FindClient(const NetAddress& address)
+{
+	for (Client& client : clients)
+	{
+		if (client.address == address)
+			return &client;
+	}
+	return 0;
+}
+
+void NetServer::ReceivePackets()
+{
+	unsigned char packet[NET_MAX_PACKET];
+	NetAddress from;
+	size_t bytes;
+	while ((bytes = socket.Receive(&from, packet, sizeof(packet))) > 0)
+	{
+		BitReader reader(packet, bytes);
+		if (reader.Read(16) != NET_PROTOCOL)
+			continue;
+		unsigned int type = reader.Read(8);
+		Client* client = FindClient(from);
+
+		// New players stand on a grid out from the spawn
+		if (type == NET_PACKET_CONNECT)
+		{
+			if (client || clients.size() >= settings.maxClients)
+				continue;
+
+			clients.emplace_back();
+			Client& added = clients.back();
+			added.address = from;
+			added.playerId = nextPlayerId++;
+			added.state = {};
+			added.state.position[0] = settings.spawn[0] + (added.playerId % 16) * settings.spawnSpacing;
+			added.state.position[1] = settings.spawn[1];
+			added.state.position[2] = settings.spawn[2] + (added.playerId / 16) * settings.spawnSpacing;
+			SnapPlayerState(&added.state);
+			added.lastInput = 0;
+			added.ackedTick = NET_NONE;
+			added.lastHeard = tick;
+			memset(added.inputSequences, 0, sizeof(added.inputSequences));
+			added.history.resize(NET_SNAPSHOT_HISTORY);
+			for (NetSnapshot& sent : added.history)
+				sent.tick = NET_NONE;
+			continue;
+		}
+
+		if (!client)
+			continue;
+		client->lastHeard = tick;
+
+		if (type == NET_PACKET_DISCONNECT)
+		{
+			clients.erase(clients.begin() + (client - clients.data()));
+			continue;
+		}
+		if (type != NET_PACKET_INPUT)
+			continue;
+
+		uint32_t acked = reader.Read(32);
+		uint32_t newest = reader.Read(32);
+		unsigned int count = reader.Read(3);
+		NetInput inputs[NET_INPUTS_PER_PACKET];
+		for (unsigned int i = 0; i < count && i < NET_INPUTS_PER_PACKET; i++)
+		{
+			inputs[i].dir[0] = (int8_t)reader.Read(8);
+			inputs[i].dir[1] = (int8_t)reader.Read(8);
+			inputs[i].mouseDelta[0] = (int16_t)reader.Read(16);
+			inputs[i].mouseDelta[1] = (int16_t)reader.Read(16);
+		}
+		if (reader.Overflowed() || count > NET_INPUTS_PER_PACKET)
+			continue;
+
+		if (acked != NET_NONE && acked <= tick && (client->ackedTick == NET_NONE || acked > client->ackedTick))
+			client->ackedTick = acked;
+
+		// Too far ahead to keep everything in between, so what
+		// never came is given up on
+		if (newest > client->lastInput + NET_INPUT_BUFFER)
+			client->lastInput = newest - NET_INPUT_BUFFER;
+
+		for (unsigned int i = 0; i < count && i < newest; i++)
+		{
+			uint32_t sequence = newest - i;
+			if (sequence <= client->lastInput)
+				break;
+			client->inputSequences[sequence % NET_INPUT_BUFFER] = sequence;
+			client->inputs[sequence % NET_INPUT_BUFFER] = inputs[i];
+		}
+	}
+}
+
+void NetServer::Tick()
+{
+	if (!socket.IsOpen())
+		return;
+
+	tick++;
+	ReceivePackets();
+
+	// Gone quiet for too long
+	uint32_t timeoutTicks = (uint32_t)(settings.timeoutSeconds * NET_TICK_RATE);
+	clients.erase(std::remove_if(clients.begin(), clients.end(),
+		[&](const Client& client) { return tick - client.lastHeard > timeoutTicks; }),
+		clients.end());
+
+	// Each player steps once for every input that came, in
+	// order, skipping any that never will. Those behind catch
+	// up a few steps at a time
+	const float delta = 1.0f / NET_TICK_RATE;
+	for (Client& client : clients)
+	{
+		for (int step = 0; step < NET_MAX_INPUTS_PER_TICK; step++)
+		{
+			uint32_t next = 0;
+			for (uint32_t sequence : client.inputSequences)
+			{
+				if (sequence > client.lastInput && (next == 0 || sequence < next))
+					next = sequence;
+			}
+			if (next == 0)
+				break;
+
+			StepPlayerMotion(&client.state, DequantizeInput(client.inputs[next % NET_INPUT_BUFFER]), settings.motion, delta, level);
+			SnapPlayerState(&client.state);
+			client.lastInput = next;
+			playerSteps++;
+		}
+	}
+
+	for (Client& client : clients)
+		SendSnapshot(client);
+}
+
+void NetServer::SendSnapshot(Client& client)
+{
+	// The players nearest this client's, theirs included
+	nearest.resize(clients.size());
+	for (unsigned int i = 0; i < nearest.size(); i++)
+		nearest[i] = i;
+
+	if (clients.size() > NET_SNAPSHOT_PLAYERS)
+	{
+		distances.resize(clients.size());
+		for (unsigned int i = 0; i < clients.size(); i++)
+		{
+			float d = 0.0f;
+			for (int c = 0; c < 3; c++)
+			{
+				float gap = clients[i].state.position[c] - client.state.position[c];
+				d += gap * gap;
+			}
+			distances[i] = d;
+		}
+
+		std::nth_element(nearest.begin(), nearest.begin() + NET_SNAPSHOT_PLAYERS, nearest.end(),
+			[&](unsigned int a, unsigned int b) { return distances[a] < distances[b]; });
+		nearest.resize(NET_SNAPSHOT_PLAYERS);
+	}
+
+	std::sort(nearest.begin(), nearest.end(),
+		[&](unsigned int a, unsigned int b) { return clients[a].playerId < clients[b].playerId; });
+
+	NetSnapshot& snapshot = client.history[tick % NET_SNAPSHOT_HISTORY];
+	snapshot.tick = tick;
+	snapshot.playerId = client.playerId;
+	snapshot.lastInput = client.lastInput;
+	snapshot.playerCount = (unsigned int)nearest.size();
+	for (unsigned int p = 0; p < snapshot.playerCount; p++)
+	{
+		const Client& other = clients[nearest[p]];
+		snapshot.players[p] = QuantizePlayerState(other.playerId, other.state);
+	}
+
+	// Written against the newest the client has, if it is
+	// still kept
+	const NetSnapshot* baseline = 0;
+	if (client.ackedTick != NET_NONE && tick - client.ackedTick < NET_SNAPSHOT_HISTORY)
+	{
+		const NetSnapshot& acked = client.history[client.ackedTick % NET_SNAPSHOT_HISTORY];
+		if (acked.tick == client.ackedTick)
+			baseline = &acked;
+	}
+
+	unsigned char packet[NET_MAX_PACKET];
+	size_t bytes = WriteSnapshot(snapshot, baseline, packet, sizeof(packet));
+	if (bytes == 0 || !socket.Send(client.address, packet, bytes))
+		return;
+
+	snapshotsSent++;
+	if (!baseline)
+		wholeSnapshotsSent++;
+	if (settings.measureWholeSnapshots)
+		wholeSnapshotBytes += baseline ? WriteSnapshot(snapshot, 0, packet, sizeof(packet)) : bytes;
+}
+
+// --------------------------------------------------------
+// Client
+// --------------------------------------------------------
+
+NetClient::NetClient() :
+	server(),
+	latestTick(NET_NONE),
+	sequence(0),
+	snapshotsReceived(0),
+	snapshotsDropped(0)
+{
+}
+
+bool NetClient::Connect(const NetAddress& serverAddress)
+{
+	Disconnect();
+	if (!socket.Open(0))
+		return false;
+
+	server = serverAddress;
+	history.resize(NET_SNAPSHOT_HISTORY);
+	for (NetSnapshot& snapshot : history)
+		snapshot.tick = NET_NONE;
+	latestTick = NET_NONE;
+	sequence = 0;
+	snapshotsReceived = 0;
+	snapshotsDropped = 0;
+
+	unsigned char packet[4];
+	BitWriter writer(packet, sizeof(packet));
+	WriteHeader(writer, NET_PACKET_CONNECT);
+	return socket.Send(server, packet, writer.GetBytes());
+}
+
+void NetClient::Disconnect()
+{
+	if (socket.IsOpen())
+	{
+		unsigned char packet[4];
+		BitWriter writer(packet, sizeof(packet));
+		WriteHeader(writer, NET_PACKET_DISCONNECT);
+		socket.Send(server, packet, writer.GetBytes());
+		socket.Close();
+	}
+	latestTick = NET_NONE;
+}
+
+uint32_t NetClient::SendInput(const PlayerMotionInput& input)
+{
+	if (!socket.IsOpen())
+		return 0;
+
+	unsigned char packet[NET_MAX_PACKET];
+	BitWriter writer(packet, sizeof(packet));
+
+	// Still waiting to be given a player
+	if (!IsConnected())
+	{
+		WriteHeader(writer, NET_PACKET_CONNECT);
+		socket.Send(server, packet, writer.GetBytes());
+		return 0;
+	}
+
+	sequence++;
+	inputs[sequence % NET_INPUT_BUFFER] = QuantizeInput(input);
+
+	unsigned int count = (std::min)(sequence, (uint32_t)NET_INPUTS_PER_PACKET);
+	WriteHeader(writer, NET_PACKET_INPUT);
+	writer.Write(latestTick, 32);
+	writer.Write(sequence, 32);
+	writer.Write(count, 3);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const NetInput& sent = inputs[(sequence - i) % NET_INPUT_BUFFER];
+		writer.Write((uint8_t)sent.dir[0], 8);
+		writer.Write((uint8_t)sent.dir[1], 8);
+		writer.Write((uint16_t)sent.mouseDelta[0], 16);
+		writer.Write((uint16_t)sent.mouseDelta[1], 16);
+	}
+	socket.Send(server, packet, writer.GetBytes());
+	return sequence;
+}
+
+bool NetClient::Receive()
+{
+	bool newer = false;
+	unsigned char packet[NET_MAX_PACKET];
+	NetAddress from;
+	size_t bytes;
+	while ((bytes = socket.Receive(&from, packet, sizeof(packet))) > 0)
+	{
+		if (from != server)
+			continue;
+
+		NetSnapshot snapshot;
+		if (!ReadSnapshot(packet, bytes, history.data(), &snapshot))
+		{
+			snapshotsDropped++;
+			continue;
+		}
+
+		// Too old to keep without pushing out a newer one
+		if (latestTick != NET_NONE && latestTick - snapshot.tick < UINT32_MAX / 2 && latestTick - snapshot.tick >= NET_SNAPSHOT_HISTORY)
+			continue;
+
+		snapshotsReceived++;
+		history[snapshot.tick % NET_SNAPSHOT_HISTORY] = snapshot;
+		if (latestTick == NET_NONE || snapshot.tick > latestTick)
+		{
+			latestTick = snapshot.tick;
+			newer = true;
+		}
+	}
+	return newer;
+}
+
+// --------------------------------------------------------
+// Benchmark
+// --------------------------------------------------------
+
+NetBenchmark BenchmarkNetServer(unsigned int clientCount, unsigned int ticks)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	NetBenchmark result = {};
+	result.clientCount = clientCount;
+	result.ticks = ticks;
+	if (clientCount == 0 || ticks == 0)
+		return result;
+
+	// Flat ground with room for everyone to wander
+	const float half = 200.0f;
+	const float ground[18] = {
+		-half, 0.0f, -half,		-half, 0.0f, half,		half, 0.0f, half,
+		-half, 0.0f, -half,		half, 0.0f, half,		half, 0.0f, -half };
+	const float identity[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+	LevelCollision level;
+	level.AddTriangles(ground, 2, identity);
+	level.Build();
+
+	NetServerSettings settings = DefaultNetServerSettings();
+	settings.port = 0;
+	settings.maxClients = clientCount;
+	settings.spawn[0] = -15.0f;
+	settings.spawn[2] = -15.0f;
+	settings.measureWholeSnapshots = true;
+
+	NetServer server;
+	if (!server.Start(settings, &level))
+		return result;
+
+	std::vector<std::unique_ptr<NetClient>> clients;
+	for (unsigned int c = 0; c < clientCount; c++)
+	{
+		clients.emplace_back(new NetClient());
+		clients.back()->Connect(LoopbackAddress(server.GetPort()));
+	}
+
+	// Everyone asks for a player until they have one
+	PlayerMotionInput idle = {};
+	for (int attempt = 0; attempt < 10 && result.connected < clientCount; attempt++)
+	{
+		for (auto& client : clients)
+			client->SendInput(idle);
+		server.Tick();
+
+		result.connected = 0;
+		for (auto& client : clients)
+		{
+			client->Receive();
+			if (client->IsConnected())
+				result.connected++;
+		}
+	}
+
+	uint64_t serverSentStart = server.GetBytesSent();
+	uint64_t serverReceivedStart = server.GetBytesReceived();
+	uint64_t wholeStart = server.GetWholeSnapshotBytes();
+	float serverSeconds = 0.0f;
+	std::vector<PlayerMotionState> serverStates;
+
+	for (unsigned int t = 0; t < ticks; t++)
+	{
+		// A quarter stand still and the rest walk in circles
+		// of their own size, now and then stopping
+		for (unsigned int c = 0; c < clientCount; c++)
+		{
+			PlayerMotionInput input = {};
+			if (c % 4 != 0 && (t / 45 + c) % 5 != 0)
+			{
+				input.dir[0] = sinf(t * 0.05f + c) * 0.5f;
+				input.dir[2] = 1.0f;
+				input.mouseDelta[0] = 2.0f + (c % 7);
+			}
+			clients[c]->SendInput(input);
+		}
+
+		Clock::time_point start = Clock::now();
+		server.Tick();
+		serverSeconds += std::chrono::duration<float>(Clock::now() - start).count();
+
+		// Every player a client was told about, as the server
+		// has them now
+		serverStates.assign(clientCount, PlayerMotionState());
+		for (unsigned int id = 0; id < clientCount; id++)
+			server.GetPlayerState((uint16_t)id, &serverStates[id]);
+
+		for (auto& client : clients)
+		{
+			client->Receive();
+			if (!client->IsConnected())
+				continue;
+
+			const NetSnapshot& snapshot = client->GetSnapshot();
+			if (snapshot.tick != server.GetTick())
+			{
+				result.mismatches++;
+				continue;
+			}
+			for (unsigned int p = 0; p < snapshot.playerCount; p++)
+			{
+				const NetPlayerState& player = snapshot.players[p];
+				if (player.id >= clientCount || !SamePlayerState(player, QuantizePlayerState(player.id, serverStates[player.id])))
+					result.mismatches++;
+			}
+		}
+	}
+
+	float clientTicks = (float)ticks * (std::max)(result.connected, 1u);
+	result.snapshotBytesPerClientTick = (server.GetBytesSent() - serverSentStart) / clientTicks;
+	result.wholeSnapshotBytesPerClientTick = (server.GetWholeSnapshotBytes() - wholeStart) / clientTicks;
+	result.inputBytesPerClientTick = (server.GetBytesReceived() - serverReceivedStart) / clientTicks;
+	result.serverTickMS = serverSeconds * 1000.0f / ticks;
+	result.serverMicrosecondsPerPlayer = serverSeconds * 1000000.0f / clientTicks;
+
+	for (auto& client : clients)
+		client->Disconnect();
+	server.Stop();
+	return result;
+}
@@ -0,0 +1,258 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Players over the network. The server steps every
+//			connected player with the inputs they sent on a
+//			fixed tick, the same step the game moves players
+//			with, then sends each client a snapshot of the
+//			players nearest them. States are quantized and
+//			each snapshot is written as the difference from
+//			the last one that client said it got, so a player
+//			standing still costs a couple of bits. The server
+//			keeps its players on the quantized values, so
+//			anyone starting from a snapshot lands exactly where
+//			the server does.
+
+#include <vector>
+#include <stdint.h>
+#include <limits.h>
+
+#include "Network.h"
+#include "PlayerMotion.h"
+
+// Ticks a second, and so steps a second of every player
+#define NET_TICK_RATE 30
+
+// Most players in one snapshot, those nearest the client's
+// own. Small enough for a whole snapshot to fit a packet
+#define NET_SNAPSHOT_PLAYERS 24
+
+// Snapshots kept on both sides to write differences from.
+// A power of two
+#define NET_SNAPSHOT_HISTORY 64
+
+// Inputs sent in every packet, the newest and those before
+// it, so one lost packet loses no input
+#define NET_INPUTS_PER_PACKET 4
+
+// Inputs the server keeps waiting for a player, and the
+// most it steps them a tick when catching up
+#define NET_INPUT_BUFFER 32
+#define NET_MAX_INPUTS_PER_TICK 4
+
+// Ticks that haven't happened. Input sequences start at 1,
+// 0 being none
+#define NET_NONE UINT32_MAX
+
+// Steps quantized values count in
+#define NET_POSITION_SCALE 1024.0f		// A meter
+#define NET_VELOCITY_SCALE 256.0f		// A meter a second
+
+/// <summary>
+/// A player's motion state as it is sent
+/// </summary>
+struct NetPlayerState
+{
+	uint16_t id;
+	int32_t position[3];
+	int32_t velocity[3];
+	int32_t fallSpeed;
+	uint16_t yaw;		// A full turn
+	uint16_t pitch;		// Straight down to straight up
+	uint8_t grounded;
+};
+
+NetPlayerState QuantizePlayerState(uint16_t id, const PlayerMotionState& state);
+void DequantizePlayerState(const NetPlayerState& net, PlayerMotionState* state);
+bool SamePlayerState(const NetPlayerState& a, const NetPlayerState& b);
+
+// Rounds a state onto what can be sent. Done after every
+// step on both sides, so a client replaying inputs from a
+// snapshot lands exactly where the server did
+void SnapPlayerState(PlayerMotionState* state);
+
+/// <summary>
+/// An input as it is sent. Clients step with what this
+/// gives back too, so they move the way the server will
+/// </summary>
+struct NetInput
+{
+	int8_t dir[2];			// X and Z, a full step of 127
+	int16_t mouseDelta[2];	// Sixteenths of a pixel
+};
+
+NetInput QuantizeInput(const PlayerMotionInput& input);
+PlayerMotionInput DequantizeInput(const NetInput& input);
+
+/// <summary>
+/// Every player one client is told about on one tick
+/// </summary>
+struct NetSnapshot
+{
+	uint32_t tick;					// NET_NONE while the slot is empty
+	uint16_t playerId;				// The client's own
+	uint32_t lastInput;				// Sequence of the client's last input stepped
+	unsigned int playerCount;
+	NetPlayerState players[NET_SNAPSHOT_PLAYERS];	// By id
+};
+
+/// <summary>
+/// Writes a snapshot as its difference from a baseline, or
+/// whole when there is none. Returns the bytes written, 0
+/// if they didn't fit
+/// </summary>
+size_t WriteSnapshot(const NetSnapshot& snapshot, const NetSnapshot* baseline, unsigned char* buffer, size_t capacity);
+
+/// <summary>
+/// Reads a snapshot packet, finding its baseline among the
+/// NET_SNAPSHOT_HISTORY kept by tick. Fails on anything else,
+/// or when the baseline is gone
+/// </summary>
+bool ReadSnapshot(const unsigned char* data, size_t bytes, const NetSnapshot* history, NetSnapshot* snapshot);
+
+/// <summary>
+/// Where the server listens and how its players move
+/// </summary>
+struct NetServerSettings
+{
+	uint16_t port;						// 0 for any free one
+	unsigned int maxClients;
+	float timeoutSeconds;				// Clients this quiet are dropped
+	float spawn[3];						// New players stand in a row from here
+	float spawnSpacing;
+	PlayerMotionSettings motion;
+	bool measureWholeSnapshots;			// Also size every snapshot as if sent whole
+};
+
+NetServerSettings DefaultNetServerSettings();
+
+class NetServer
+{
+public:
+	NetServer();
+
+	bool Start(const NetServerSettings& settings, const LevelCollision* level);
+	void Stop();
+
+	// Takes in every waiting packet, steps each player with
+	// the inputs that came in, and sends every client its
+	// snapshot. Call NET_TICK_RATE times a second
+	void Tick();
+
+	bool IsRunning() const { return socket.IsOpen(); }
+	uint16_t GetPort() const { return socket.GetPort(); }
+	uint32_t GetTick() const { return tick; }
+	unsigned int GetClientCount() const { return (unsigned int)clients.size(); }
+
+	// False when no client has the player. Setting one moves
+	// them somewhere their client can't have predicted, like
+	// a knockback or a teleport
+	bool GetPlayerState(uint16_t playerId, PlayerMotionState* state) const;
+	bool SetPlayerState(uint16_t playerId, const PlayerMotionState& state);
+
+	uint64_t GetBytesSent() const { return socket.GetBytesSent(); }
+	uint64_t GetBytesReceived() const { return socket.GetBytesReceived(); }
+	uint64_t GetSnapshotsSent() const { return snapshotsSent; }
+	uint64_t GetWholeSnapshotsSent() const { return wholeSnapshotsSent; }	// With no baseline to go from
+	uint64_t GetWholeSnapshotBytes() const { return wholeSnapshotBytes; }	// With measureWholeSnapshots
+	uint64_t GetPlayerSteps() const { return playerSteps; }
+
+private:
+	struct Client
+	{
+		NetAddress address;
+		uint16_t playerId;
+		PlayerMotionState state;
+		uint32_t lastInput;					// Last sequence stepped
+		uint32_t ackedTick;					// Newest snapshot the client has
+		uint32_t lastHeard;					// Tick of its last packet
+		uint32_t inputSequences[NET_INPUT_BUFFER];
+		NetInput inputs[NET_INPUT_BUFFER];
+		std::vector<NetSnapshot> history;	// Sent, by tick
+	};
+
+	void ReceivePackets();
+	Client* FindClient(const NetAddress& address);
+	void SendSnapshot(Client& client);
+
+	NetServerSettings settings;
+	const LevelCollision* level;
+	UdpSocket socket;
+	std::vector<Client> clients;
+	uint32_t tick;
+	uint16_t nextPlayerId;
+
+	// Scratch for picking who goes in a snapshot
+	std::vector<float> distances;
+	std::vector<unsigned int> nearest;
+
+	uint64_t snapshotsSent;
+	uint64_t wholeSnapshotsSent;
+	uint64_t wholeSnapshotBytes;
+	uint64_t playerSteps;
+};
+
+class NetClient
+{
+public:
+	NetClient();
+
+	// Opens a socket and asks the server for a player
+	bool Connect(const NetAddress& server);
+	void Disconnect();
+
+	// Sends one step's input along with the few before it,
+	// or asks for a player again until one is given. Returns
+	// the input's sequence
+	uint32_t SendInput(const PlayerMotionInput& input);
+
+	// Reads every waiting snapshot. True if a newer one came
+	bool Receive();
+
+	bool IsConnected() const { return latestTick != NET_NONE; }
+	const NetSnapshot& GetSnapshot() const { return history[latestTick % NET_SNAPSHOT_HISTORY]; }
+	uint16_t GetPlayerId() const { return GetSnapshot().playerId; }
+
+	// Inputs as sent, kept for the last NET_INPUT_BUFFER sequences
+	uint32_t GetLastSequence() const { return sequence; }
+	const NetInput& GetInput(uint32_t inputSequence) const { return inputs[inputSequence % NET_INPUT_BUFFER]; }
+
+	uint64_t GetBytesSent() const { return socket.GetBytesSent(); }
+	uint64_t GetBytesReceived() const { return socket.GetBytesReceived(); }
+	uint64_t GetSnapshotsReceived() const { return snapshotsReceived; }
+	uint64_t GetSnapshotsDropped() const { return snapshotsDropped; }
+
+private:
+	UdpSocket socket;
+	NetAddress server;
+	std::vector<NetSnapshot> history;
+	uint32_t latestTick;
+	uint32_t sequence;
+	NetInput inputs[NET_INPUT_BUFFER];
+	uint64_t snapshotsReceived;
+	uint64_t snapshotsDropped;		// Their baseline was already gone
+};
+
+/// <summary>
+/// Results of one headless benchmark run
+/// </summary>
+struct NetBenchmark
+{
+	unsigned int clientCount;
+	unsigned int ticks;
+	unsigned int connected;
+	float snapshotBytesPerClientTick;
+	float wholeSnapshotBytesPerClientTick;	// Had nothing been sent as a difference
+	float inputBytesPerClientTick;
+	float serverTickMS;
+	float serverMicrosecondsPerPlayer;
+	unsigned int mismatches;				// Players a client read differently from the server
+};
+
+/// <summary>
+/// Runs a server and clientCount bots over loopback on flat
+/// ground, every bot sending an input a tick, some walking
+/// in circles and some standing still, and checks what each
+/// bot reads against the server's players
+/// </summary>
+NetBenchmark BenchmarkNetServer(unsigned int clientCount, unsigned int ticks);
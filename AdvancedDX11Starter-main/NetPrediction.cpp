@@ -0,0 +1,383 @@
+#include "NetPrediction.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+
+namespace
+{
+	const float PI = 3.14159265359f;
+
+	float WrapAngle(float angle)
+	{
+		angle = fmodf(angle + PI, 2.0f * PI);
+		if (angle < 0.0f)
+			angle += 2.0f * PI;
+		return angle - PI;
+	}
+
+	float Length(const float v[3])
+	{
+		return sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+	}
+}
+
+// --------------------------------------------------------
+// Prediction
+// --------------------------------------------------------
+
+NetPredictionSettings DefaultNetPredictionSettings()
+{
+	NetPredictionSettings settings;
+	settings.motion = DefaultNetServerSettings().motion;
+	settings.smoothing = 12.0f;
+	settings.snapDistance = 3.0f;
+	return settings;
+}
+
+PredictedPlayer::PredictedPlayer() :
+	settings(DefaultNetPredictionSettings()),
+	level(0),
+	sequence(0),
+	yawOffset(0.0f),
+	stats()
+{
+	memset(sequences, 0xFF, sizeof(sequences));
+	memset(offset, 0, sizeof(offset));
+	states[0] = {};
+}
+
+void PredictedPlayer::Init(const NetPredictionSettings& predictionSettings, const LevelCollision* predictionLevel)
+{
+	settings = predictionSettings;
+	level = predictionLevel;
+	stats = {};
+}
+
+void PredictedPlayer::Reset(const PlayerMotionState& state, uint32_t resetSequence)
+{
+	memset(sequences, 0xFF, sizeof(sequences));
+	sequence = resetSequence;
+	sequences[sequence % NET_PREDICTION_BUFFER] = sequence;
+	states[sequence % NET_PREDICTION_BUFFER] = state;
+	SnapPlayerState(&states[sequence % NET_PREDICTION_BUFFER]);
+	memset(offset, 0, sizeof(offset));
+	yawOffset = 0.0f;
+}
+
+void PredictedPlayer::Predict(uint32_t inputSequence, const NetInput& input)
+{
+	// Stepped the way the server will, from the state before
+	PlayerMotionState state = GetState();
+	StepPlayerMotion(&state, DequantizeInput(input), settings.motion, 1.0f / NET_TICK_RATE, level);
+	SnapPlayerState(&state);
+
+	sequence = inputSequence;
+	sequences[sequence % NET_PREDICTION_BUFFER] = sequence;
+	inputs[sequence % NET_PREDICTION_BUFFER] = input;
+	states[sequence % NET_PREDICTION_BUFFER] = state;
+}
+
+float PredictedPlayer::Reconcile(const PlayerMotionState& server, uint32_t lastInput)
+{
+	// Ahead of anything sent, or so far behind the inputs
+	// since are gone, so there is nothing to replay
+	unsigned int slot = lastInput % NET_PREDICTION_BUFFER;
+	if (lastInput > sequence || sequence - lastInput >= NET_PREDICTION_BUFFER || sequences[slot] != lastInput)
+	{
+		float before[3];
+		GetDisplayPosition(before);
+		uint32_t current = (std::max)(sequence, lastInput);
+		Reset(server, current);
+		for (int i = 0; i < 3; i++)
+			offset[i] = before[i] - GetState().position[i];
+
+		float error = Length(offset);
+		if (error > settings.snapDistance)
+		{
+			memset(offset, 0, sizeof(offset));
+			stats.snaps++;
+		}
+		stats.checks++;
+		stats.corrections++;
+		stats.total += error;
+		stats.largest = (std::max)(stats.largest, error);
+		return error;
+	}
+
+	stats.checks++;
+	NetPlayerState predicted = QuantizePlayerState(0, states[slot]);
+	if (SamePlayerState(predicted, QuantizePlayerState(0, server)))
+		return 0.0f;
+
+	float miss[3];
+	for (int i = 0; i < 3; i++)
+		miss[i] = server.position[i] - states[slot].position[i];
+	float error = Length(miss);
+
+	// Where the player is drawn now, kept while the state
+	// under it is replayed
+	float before[3];
+	GetDisplayPosition(before);
+	float beforeYaw = GetDisplayYaw();
+
+	states[slot] = server;
+	SnapPlayerState(&states[slot]);
+	for (uint32_t s = lastInput + 1; s <= sequence; s++)
+	{
+		PlayerMotionState state = states[(s - 1) % NET_PREDICTION_BUFFER];
+		StepPlayerMotion(&state, DequantizeInput(inputs[s % NET_PREDICTION_BUFFER]), settings.motion, 1.0f / NET_TICK_RATE, level);
+		SnapPlayerState(&state);
+		states[s % NET_PREDICTION_BUFFER] = state;
+		stats.replayedSteps++;
+	}
+
+	const PlayerMotionState& now = GetState();
+	for (int i = 0; i < 3; i++)
+		offset[i] = before[i] - now.position[i];
+	yawOffset = WrapAngle(beforeYaw - now.yaw);
+	if (Length(offset) > settings.snapDistance)
+	{
+		memset(offset, 0, sizeof(offset));
+		yawOffset = 0.0f;
+		stats.snaps++;
+	}
+
+	stats.corrections++;
+	stats.total += error;
+	stats.largest = (std::max)(stats.largest, error);
+	return error;
+}
+
+void PredictedPlayer::Smooth(float deltaTime)
+{
+	float fade = expf(-settings.smoothing * deltaTime);
+	for (int i = 0; i < 3; i++)
+		offset[i] *= fade;
+	yawOffset *= fade;
+}
+
+void PredictedPlayer::GetDisplayPosition(float position[3]) const
+{
+	for (int i = 0; i < 3; i++)
+		position[i] = GetState().position[i] + offset[i];
+}
+
+float PredictedPlayer::GetDisplayYaw() const
+{
+	return GetState().yaw + yawOffset;
+}
+
+// --------------------------------------------------------
+// Simulated link
+// --------------------------------------------------------
+
+NetLink::NetLink() :
+	settings(),
+	server(),
+	client(),
+	hasClient(false),
+	packetsPassed(0),
+	packetsLost(0)
+{
+}
+
+bool NetLink::Open(const NetAddress& serverAddress, const NetLinkSettings& linkSettings)
+{
+	Close();
+	settings = linkSettings;
+	server = serverAddress;
+	random.seed(settings.seed);
+	packetsPassed = 0;
+	packetsLost = 0;
+	return front.Open(0) && back.Open(0);
+}
+
+void NetLink::Close()
+{
+	front.Close();
+	back.Close();
+	waiting.clear();
+	hasClient = false;
+}
+
+void NetLink::Take(UdpSocket& from, bool toServer, double now)
+{
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	unsigned char packet[NET_MAX_PACKET];
+	NetAddress sender;
+	size_t bytes;
+	while ((bytes = from.Receive(&sender, packet, sizeof(packet))) > 0)
+	{
+		// The first to send from the front is the client, and
+		// only the server is listened to at the back
+		if (toServer)
+		{
+			if (!hasClient)
+			{
+				client = sender;
+				hasClient = true;
+			}
+			if (sender != client)
+				continue;
+		}
+		else if (sender != server)
+			continue;
+
+		if (unit(random) < settings.loss)
+		{
+			packetsLost++;
+			continue;
+		}
+
+		DelayedPacket delayed;
+		float jitter = (unit(random) * 2.0f - 1.0f) * settings.jitter;
+		delayed.due = now + (std::max)(0.0f, settings.latency + jitter);
+		delayed.toServer = toServer;
+		delayed.data.assign(packet, packet + bytes);
+		waiting.push_back(std::move(delayed));
+	}
+}
+
+void NetLink::Pump(double now)
+{
+	if (!front.IsOpen())
+		return;
+
+	Take(front, true, now);
+	Take(back, false, now);
+
+	// Due ones go out soonest first, which jitter may make a
+	// different order from how they came in
+	std::stable_sort(waiting.begin(), waiting.end(),
+		[](const DelayedPacket& a, const DelayedPacket& b) { return a.due < b.due; });
+
+	size_t passed = 0;
+	for (; passed < waiting.size() && waiting[passed].due <= now; passed++)
+	{
+		const DelayedPacket& delayed = waiting[passed];
+		if (delayed.toServer)
+			back.Send(server, delayed.data.data(), delayed.data.size());
+		else
+			front.Send(client, delayed.data.data(), delayed.data.size());
+		packetsPassed++;
+	}
+	waiting.erase(waiting.begin(), waiting.begin() + passed);
+}
+
+// --------------------------------------------------------
+// Benchmark
+// --------------------------------------------------------
+
+NetPredictionBenchmark BenchmarkPrediction(const NetLinkSettings& linkSettings, unsigned int ticks)
+{
+	// Frames drawn for every tick, each one smoothing a little
+	const unsigned int framesPerTick = 4;
+	const float frameTime = 1.0f / (NET_TICK_RATE * framesPerTick);
+
+	NetPredictionBenchmark result = {};
+	result.link = linkSettings;
+	result.ticks = ticks;
+
+	const float half = 200.0f;
+	const float ground[18] = {
+		-half, 0.0f, -half,		-half, 0.0f, half,		half, 0.0f, half,
+		-half, 0.0f, -half,		half, 0.0f, half,		half, 0.0f, -half };
+	const float identity[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+	LevelCollision level;
+	level.AddTriangles(ground, 2, identity);
+	level.Build();
+
+	NetServerSettings serverSettings = DefaultNetServerSettings();
+	serverSettings.port = 0;
+	NetServer server;
+	NetLink link;
+	NetClient client;
+	if (!server.Start(serverSettings, &level) ||
+		!link.Open(LoopbackAddress(server.GetPort()), linkSettings) ||
+		!client.Connect(LoopbackAddress(link.GetPort())))
+		return result;
+
+	NetPredictionSettings predictionSettings = DefaultNetPredictionSettings();
+	predictionSettings.motion = serverSettings.motion;
+	PredictedPlayer player;
+	player.Init(predictionSettings, &level);
+
+	unsigned long long unanswered = 0;
+	for (unsigned int frame = 0; frame < ticks * framesPerTick; frame++)
+	{
+		double now = frame * (double)frameTime;
+		if (frame % framesPerTick == 0)
+		{
+			// Walks in a wobbling circle, stopping now and then
+			unsigned int t = frame / framesPerTick;
+			PlayerMotionInput input = {};
+			if ((t / 40) % 4 != 3)
+			{
+				input.dir[0] = sinf(t * 0.07f) * 0.4f;
+				input.dir[2] = 1.0f;
+				input.mouseDelta[0] = 4.0f;
+			}
+
+			uint32_t sent = client.SendInput(input);
+			if (sent != 0 && result.connected)
+				player.Predict(sent, client.GetInput(sent));
+			link.Pump(now);
+
+			// Every two seconds the server shoves the player half a
+			// meter sideways, which no client could see coming
+			PlayerMotionState shoved;
+			if (result.connected && t % (NET_TICK_RATE * 2) == NET_TICK_RATE &&
+				server.GetPlayerState(client.GetPlayerId(), &shoved))
+			{
+				shoved.position[0] += 0.5f;
+				server.SetPlayerState(client.GetPlayerId(), shoved);
+				result.pushes++;
+			}
+			server.Tick();
+		}
+		link.Pump(now);
+
+		if (client.Receive())
+		{
+			const NetSnapshot& snapshot = client.GetSnapshot();
+			for (unsigned int p = 0; p < snapshot.playerCount; p++)
+			{
+				if (snapshot.players[p].id != snapshot.playerId)
+					continue;
+
+				PlayerMotionState state;
+				DequantizePlayerState(snapshot.players[p], &state);
+				if (!result.connected)
+				{
+					player.Reset(state, client.GetLastSequence());
+					result.connected = true;
+				}
+				else
+				{
+					unanswered += player.GetSequence() - snapshot.lastInput;
+					player.Reconcile(state, snapshot.lastInput);
+				}
+			}
+		}
+
+		float before[3];
+		float after[3];
+		player.GetDisplayPosition(before);
+		player.Smooth(frameTime);
+		player.GetDisplayPosition(after);
+
+		// Only what the smoothing moved, not the walking
+		float step[3] = { after[0] - before[0], after[1] - before[1], after[2] - before[2] };
+		result.largestDisplayStep = (std::max)(result.largestDisplayStep, Length(step));
+	}
+
+	result.corrections = player.GetStats();
+	if (result.corrections.checks > 0)
+		result.averageReplaySteps = (float)unanswered / result.corrections.checks;
+
+	client.Disconnect();
+	link.Close();
+	server.Stop();
+	return result;
+}
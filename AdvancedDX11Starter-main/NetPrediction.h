@@ -0,0 +1,172 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Keeps the local player responsive while the server
+//			decides where they really are. Every input is
+//			stepped the moment it is made and kept, with the
+//			state it led to, until the server says it has
+//			stepped it too. When the server disagrees the
+//			player is put back where it says and every input
+//			since is stepped again, and the jump that leaves is
+//			eased out over a few frames rather than shown.
+//			Also a stand-in for a bad connection, to try all
+//			this against on one machine.
+
+#include <random>
+#include <vector>
+#include <stdint.h>
+
+#include "NetPlayers.h"
+
+// Inputs and the states they led to kept for replaying, a
+// little over two seconds of them. A power of two
+#define NET_PREDICTION_BUFFER 64
+
+/// <summary>
+/// How corrections are shown
+/// </summary>
+struct NetPredictionSettings
+{
+	PlayerMotionSettings motion;	// As the server steps players
+	float smoothing;				// How fast a correction fades, per second
+	float snapDistance;				// Corrections this big are jumped to at once
+};
+
+NetPredictionSettings DefaultNetPredictionSettings();
+
+/// <summary>
+/// How often and how far the server has corrected a player
+/// </summary>
+struct NetCorrectionStats
+{
+	unsigned int checks;			// Snapshots compared against what was predicted
+	unsigned int corrections;		// Of those that disagreed
+	unsigned int snaps;				// Corrections too big to ease out
+	unsigned int replayedSteps;
+	float largest;					// Meters off, where the server said the player was
+	float total;
+};
+
+class PredictedPlayer
+{
+public:
+	PredictedPlayer();
+
+	void Init(const NetPredictionSettings& settings, const LevelCollision* level);
+
+	// Starts over from a state the server sent, as of an input
+	void Reset(const PlayerMotionState& state, uint32_t sequence);
+
+	// Steps the player with an input as it is sent, each one
+	// the sequence after the last
+	void Predict(uint32_t sequence, const NetInput& input);
+
+	// Checks the server's state as of an input against what
+	// was predicted for it. When they differ the player goes
+	// back to the server's and every input since is stepped
+	// again. Returns how many meters off the prediction was
+	float Reconcile(const PlayerMotionState& server, uint32_t lastInput);
+
+	// Eases away whatever is left of the last correction
+	void Smooth(float deltaTime);
+
+	const PlayerMotionState& GetState() const { return states[sequence % NET_PREDICTION_BUFFER]; }
+	uint32_t GetSequence() const { return sequence; }
+
+	// Where to draw the player, the prediction plus what is
+	// left of the last correction
+	void GetDisplayPosition(float position[3]) const;
+	float GetDisplayYaw() const;
+
+	const NetCorrectionStats& GetStats() const { return stats; }
+
+private:
+	NetPredictionSettings settings;
+	const LevelCollision* level;
+
+	uint32_t sequence;
+	uint32_t sequences[NET_PREDICTION_BUFFER];
+	NetInput inputs[NET_PREDICTION_BUFFER];
+	PlayerMotionState states[NET_PREDICTION_BUFFER];	// After each input
+
+	float offset[3];
+	float yawOffset;
+	NetCorrectionStats stats;
+};
+
+/// <summary>
+/// What a simulated connection does to packets
+/// </summary>
+struct NetLinkSettings
+{
+	float latency;		// Seconds each way
+	float jitter;		// Seconds more or less, at random
+	float loss;			// Of every packet, each way
+	unsigned int seed;
+};
+
+/// <summary>
+/// Sits between one client and a server on loopback and
+/// passes packets both ways late, out of order or not at
+/// all. The client connects to this instead of the server
+/// </summary>
+class NetLink
+{
+public:
+	NetLink();
+
+	bool Open(const NetAddress& server, const NetLinkSettings& settings);
+	void Close();
+
+	uint16_t GetPort() const { return front.GetPort(); }
+
+	// Takes in packets from both sides and passes on those due
+	// by now, in seconds
+	void Pump(double now);
+
+	uint64_t GetPacketsPassed() const { return packetsPassed; }
+	uint64_t GetPacketsLost() const { return packetsLost; }
+
+private:
+	struct DelayedPacket
+	{
+		double due;
+		bool toServer;
+		std::vector<unsigned char> data;
+	};
+
+	void Take(UdpSocket& from, bool toServer, double now);
+
+	NetLinkSettings settings;
+	UdpSocket front;		// Faces the client
+	UdpSocket back;			// Faces the server
+	NetAddress server;
+	NetAddress client;
+	bool hasClient;
+	std::vector<DelayedPacket> waiting;
+	std::mt19937 random;
+	uint64_t packetsPassed;
+	uint64_t packetsLost;
+};
+
+/// <summary>
+/// Results of one headless prediction run
+/// </summary>
+struct NetPredictionBenchmark
+{
+	NetLinkSettings link;
+	unsigned int ticks;
+	bool connected;
+	unsigned int pushes;				// Times the server moved the player itself
+	NetCorrectionStats corrections;
+	float averageReplaySteps;			// Inputs still unanswered a snapshot, about the round trip
+	float largestDisplayStep;			// Most the smoothing moved the drawn player in one frame
+};
+
+/// <summary>
+/// Runs a server and one predicting bot through a simulated
+/// link, the bot walking in circles and the server now and
+/// then shoving it sideways, and reports how often and how
+/// far the bot had to be corrected
+/// </summary>
+NetPredictionBenchmark BenchmarkPrediction(const NetLinkSettings& link, unsigned int ticks);
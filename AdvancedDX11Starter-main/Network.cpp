@@ -0,0 +1,262 @@
+#include "Network.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+typedef int SocketLength;
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef socklen_t SocketLength;
+#endif
+
+#include <string.h>
+
+NetAddress LoopbackAddress(uint16_t port)
+{
+	NetAddress address;
+	address.ip = 0x7F000001;
+	address.port = port;
+	return address;
+}
+
+// --------------------------------------------------------
+// Sockets
+// --------------------------------------------------------
+
+namespace
+{
+#ifdef _WIN32
+	// Winsock is started the first time a socket opens and
+	// stopped when the program ends
+	struct WinsockStartup
+	{
+		bool started;
+		WinsockStartup()
+		{
+			WSADATA data;
+			started = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+		}
+		~WinsockStartup()
+		{
+			if (started)
+				WSACleanup();
+		}
+	};
+
+	typedef SOCKET NativeSocket;
+	void CloseNative(NativeSocket s) { closesocket(s); }
+	bool SetNonBlocking(NativeSocket s)
+	{
+		u_long nonBlocking = 1;
+		return ioctlsocket(s, FIONBIO, &nonBlocking) == 0;
+	}
+#else
+	typedef int NativeSocket;
+	const NativeSocket INVALID_SOCKET = -1;
+	void CloseNative(NativeSocket s) { close(s); }
+	bool SetNonBlocking(NativeSocket s)
+	{
+		int flags = fcntl(s, F_GETFL, 0);
+		return flags >= 0 && fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+	}
+#endif
+}
+
+UdpSocket::UdpSocket() :
+	handle(0),
+	open(false),
+	port(0),
+	bytesSent(0),
+	bytesReceived(0)
+{
+}
+
+UdpSocket::~UdpSocket()
+{
+	Close();
+}
+
+bool UdpSocket::Open(uint16_t bindPort)
+{
+	Close();
+
+#ifdef _WIN32
+	static WinsockStartup winsock;
+	if (!winsock.started)
+		return false;
+#endif
+
+	NativeSocket s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (s == INVALID_SOCKET)
+		return false;
+
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(bindPort);
+	if (bind(s, (const sockaddr*)&address, sizeof(address)) != 0 || !SetNonBlocking(s))
+	{
+		CloseNative(s);
+		return false;
+	}
+
+	// Find out which port was picked
+	SocketLength length = sizeof(address);
+	if (getsockname(s, (sockaddr*)&address, &length) != 0)
+	{
+		CloseNative(s);
+		return false;
+	}
+
+	handle = (uintptr_t)s;
+	port = ntohs(address.sin_port);
+	open = true;
+	return true;
+}
+
+void UdpSocket::Close()
+{
+	if (!open)
+		return;
+	CloseNative((NativeSocket)handle);
+	open = false;
+	port = 0;
+}
+
+bool UdpSocket::Send(const NetAddress& to, const void* data, size_t bytes)
+{
+	if (!open)
+		return false;
+
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(to.ip);
+	address.sin_port = htons(to.port);
+	int sent = (int)sendto((NativeSocket)handle, (const char*)data, (int)bytes, 0, (const sockaddr*)&address, sizeof(address));
+	if (sent != (int)bytes)
+		return false;
+
+	bytesSent += bytes;
+	return true;
+}
+
+size_t UdpSocket::Receive(NetAddress* from, void* buffer, size_t capacity)
+{
+	while (open)
+	{
+		sockaddr_in address = {};
+		SocketLength length = sizeof(address);
+		int received = (int)recvfrom((NativeSocket)handle, (char*)buffer, (int)capacity, 0, (sockaddr*)&address, &length);
+
+		// Nothing waiting, or a datagram too big for the buffer
+		// (on Windows) that is skipped to get to the next
+		if (received < 0)
+		{
+#ifdef _WIN32
+			if (WSAGetLastError() == WSAEMSGSIZE || WSAGetLastError() == WSAECONNRESET)
+				continue;
+#endif
+			return 0;
+		}
+		if (received == 0)
+			continue;
+
+		from->ip = ntohl(address.sin_addr.s_addr);
+		from->port = ntohs(address.sin_port);
+		bytesReceived += (uint64_t)received;
+		return (size_t)received;
+	}
+	return 0;
+}
+
+// --------------------------------------------------------
+// Bit streams
+// --------------------------------------------------------
+
+namespace
+{
+	// Widths a signed value may take after its size code
+	const unsigned int SIGNED_WIDTHS[4] = { 4, 8, 16, 32 };
+}
+
+BitWriter::BitWriter(unsigned char* buffer, size_t capacity) :
+	buffer(buffer),
+	capacity(capacity),
+	bitCount(0),
+	overflowed(false)
+{
+	memset(buffer, 0, capacity);
+}
+
+void BitWriter::Write(uint32_t value, unsigned int bits)
+{
+	if (overflowed || bitCount + bits > capacity * 8)
+	{
+		overflowed = true;
+		return;
+	}
+
+	for (unsigned int i = 0; i < bits; i++, bitCount++)
+	{
+		if ((value >> i) & 1)
+			buffer[bitCount >> 3] |= (unsigned char)(1 << (bitCount & 7));
+	}
+}
+
+void BitWriter::WriteSigned(int32_t value)
+{
+	// Zigzag, so small values of either sign stay small
+	uint32_t zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+	if (zigzag == 0)
+	{
+		Write(0, 1);
+		return;
+	}
+
+	unsigned int size = 0;
+	while (size < 3 && (zigzag >> SIGNED_WIDTHS[size]) != 0)
+		size++;
+	Write(1, 1);
+	Write(size, 2);
+	Write(zigzag, SIGNED_WIDTHS[size]);
+}
+
+BitReader::BitReader(const unsigned char* buffer, size_t bytes) :
+	buffer(buffer),
+	bytes(bytes),
+	bitCount(0),
+	overflowed(false)
+{
+}
+
+uint32_t BitReader::Read(unsigned int bits)
+{
+	if (overflowed || bitCount + bits > bytes * 8)
+	{
+		overflowed = true;
+		return 0;
+	}
+
+	uint32_t value = 0;
+	for (unsigned int i = 0; i < bits; i++, bitCount++)
+	{
+		if ((buffer[bitCount >> 3] >> (bitCount & 7)) & 1)
+			value |= 1u << i;
+	}
+	return value;
+}
+
+int32_t BitReader::ReadSigned()
+{
+	if (Read(1) == 0)
+		return 0;
+
+	unsigned int size = Read(2);
+	uint32_t zigzag = Read(SIGNED_WIDTHS[size]);
+	return (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+}
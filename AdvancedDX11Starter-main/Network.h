@@ -0,0 +1,108 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Send and receive datagrams, and pack values into
+//			them a few bits at a time. Sockets are Winsock on
+//			Windows and BSD sockets everywhere else, and never
+//			block, so a tick never waits on the network. Bits
+//			go in lowest first and readers and writers stop
+//			quietly once they run past the end, leaving it to
+//			the caller to check before trusting what was read.
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Largest datagram sent, well under the usual MTU so nothing
+// is split on the way
+#define NET_MAX_PACKET 1200
+
+/// <summary>
+/// An IPv4 address and port, both in host byte order
+/// </summary>
+struct NetAddress
+{
+	uint32_t ip;
+	uint16_t port;
+
+	bool operator==(const NetAddress& other) const { return ip == other.ip && port == other.port; }
+	bool operator!=(const NetAddress& other) const { return !(*this == other); }
+};
+
+// 127.0.0.1 at the given port
+NetAddress LoopbackAddress(uint16_t port);
+
+class UdpSocket
+{
+public:
+	UdpSocket();
+	~UdpSocket();
+
+	// Binds to a port on every interface, 0 picking any free
+	// one. Closes whatever was open before
+	bool Open(uint16_t port);
+	void Close();
+
+	bool IsOpen() const { return open; }
+	uint16_t GetPort() const { return port; }
+
+	bool Send(const NetAddress& to, const void* data, size_t bytes);
+
+	// Size of the next datagram waiting, copied into buffer,
+	// or 0 when there are none. Datagrams bigger than the
+	// buffer are dropped
+	size_t Receive(NetAddress* from, void* buffer, size_t capacity);
+
+	uint64_t GetBytesSent() const { return bytesSent; }
+	uint64_t GetBytesReceived() const { return bytesReceived; }
+
+private:
+	UdpSocket(const UdpSocket&) = delete;
+	UdpSocket& operator=(const UdpSocket&) = delete;
+
+	uintptr_t handle;
+	bool open;
+	uint16_t port;
+	uint64_t bytesSent;
+	uint64_t bytesReceived;
+};
+
+class BitWriter
+{
+public:
+	BitWriter(unsigned char* buffer, size_t capacity);
+
+	// The lowest bits of value, at most 32
+	void Write(uint32_t value, unsigned int bits);
+
+	// Small numbers in a few bits, bigger ones in more, zero
+	// in one
+	void WriteSigned(int32_t value);
+
+	size_t GetBytes() const { return (bitCount + 7) / 8; }
+	size_t GetBits() const { return bitCount; }
+	bool Overflowed() const { return overflowed; }
+
+private:
+	unsigned char* buffer;
+	size_t capacity;
+	size_t bitCount;
+	bool overflowed;
+};
+
+class BitReader
+{
+public:
+	BitReader(const unsigned char* buffer, size_t bytes);
+
+	uint32_t Read(unsigned int bits);
+	int32_t ReadSigned();
+
+	// Reading past the end gives zeros and sets this
+	bool Overflowed() const { return overflowed; }
+
+private:
+	const unsigned char* buffer;
+	size_t bytes;
+	size_t bitCount;
+	bool overflowed;
+};
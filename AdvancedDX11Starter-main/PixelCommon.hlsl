@@ -1,5 +1,7 @@
 
 #include "Lighting.hlsli"
+#include "LightClusters.hlsli"
+#include "Shadows.hlsli"
 #include "Triplanar.hlsli"
 #include "Common.hlsli"
 
@@ -22,6 +24,21 @@ cbuffer perFrame : register(b1)
 
 	// Needed for specular (reflection) calculation
     float3 cameraPosition;
+
+	// Point and spot lights binned per cluster
+    int clusteredLighting;
+    float4 clusterScreen;
+    float4 clusterDepth;
+    float4 clusterDepthRow;
+
+	// Directional light shadow cascades
+    matrix cascadeViewProj[SHADOW_CASCADE_MAX_COUNT];
+    float4 cascadeSplits;
+    float4 shadowDepthRow;
+    int cascadeCount;
+
+	// Sky irradiance baked into nine harmonics, rgb only
+    float4 skyIrradiance[9];
 };
 
 
@@ -31,9 +48,9 @@ cbuffer perFrame : register(b1)
 // Texture-related variables
 Texture2D Albedo : register(t0);
 Texture2D NormalMap : register(t1);
-Texture2D RoughnessMap : register(t2);
-Texture2D ShadowMap : register(t3);
-TextureCube Lightbox : register(t4);
+Texture2D ORMMap : register(t2); // Occlusion, roughness, metalness
+Texture2DArray ShadowMap : register(t3);
+TextureCube SkySpecular : register(t4); // Prefiltered by roughness per mip
 SamplerState BasicSampler : register(s0);
 SamplerComparisonState ShadowSampler : register(s1);
 
@@ -44,22 +61,15 @@ float4 main(VertexToPixel input) : SV_TARGET
     if(surfaceColor.w <= 0.1f)
         discard;
     
-    // Perform the perspective divide (divide by W) ourselves
-    input.shadowMapPos /= input.shadowMapPos.w;
-    
-    // Convert the normalized device coordinates to UVs for sampling
-    float2 shadowUV = input.shadowMapPos.xy * 0.5f + 0.5f;
-    shadowUV.y = 1 - shadowUV.y; // Flip the Y
-    
-    // Grab the distances we need: light-to-pixel and closest-surface
-    float distToLight = input.shadowMapPos.z;
-    float distShadowMap = ShadowMap.Sample(BasicSampler, shadowUV).r;
-    
-    // Get a ratio of comparison results using SampleCmpLevelZero()
-    float shadowAmount = ShadowMap.SampleCmpLevelZero(
+    // Compare against whichever cascade covers this pixel
+    float shadowAmount = CascadedShadow(
+        ShadowMap,
         ShadowSampler,
-        shadowUV,
-        distToLight).r;
+        cascadeViewProj,
+        cascadeSplits,
+        shadowDepthRow,
+        cascadeCount,
+        input.worldPos);
     shadowAmount = max(0.01f, shadowAmount);
     
 	// Always re-normalize interpolated direction vectors
@@ -73,7 +83,8 @@ float4 main(VertexToPixel input) : SV_TARGET
     input.normal = NormalMapping(NormalMap, BasicSampler, input.uv, input.normal, input.tangent);
 	
 	// Treating roughness as a pseduo-spec map here
-    float roughness = RoughnessMap.Sample(BasicSampler, input.uv).r;
+    float3 orm = ORMMap.Sample(BasicSampler, input.uv).rgb;
+    float roughness = orm.g;
     float specPower = max(256.0f * (1.0f - roughness), 0.01f); // Ensure we never hit 0
 	
 	// Gamma correct the texture back to linear space and apply the color tint
@@ -88,15 +99,32 @@ float4 main(VertexToPixel input) : SV_TARGET
     
     totalColor += DirLight(worldLight, input.normal, input.worldPos, cameraPosition, specPower, surfaceColor.rgb);
     totalColor *= shadowAmount;
+    
+    if (clusteredLighting)
+    {
+        totalColor += ClusteredLights(
+        input.screenPosition.xy,
+        clusterScreen,
+        clusterDepth,
+        clusterDepthRow,
+        input.normal,
+        input.worldPos,
+        cameraPosition,
+        specPower,
+        surfaceColor.rgb);
+    }
    
-    totalColor += CubeLight(
-    1.0f,
+    // Occlusion only darkens the ambient light
+    totalColor += SkyLight(
+    skyIrradiance,
+    SkySpecular,
+    BasicSampler,
     input.normal,
     input.worldPos,
     cameraPosition,
-    specPower,
-    surfaceColor.rgb,
-    Lightbox.Sample(BasicSampler, input.normal).rgb);
+    roughness,
+    orm.b,
+    surfaceColor.rgb) * orm.r;
     
     totalColor = HeightFogColor(10.0f, 15.0f, -2.0f, -3.0f, cameraPosition, input.worldPos, totalColor, float3(0.2f, 0.2f, 0.25f));
     
@@ -34,7 +34,7 @@ cbuffer perFrame : register(b1)
 // Texture-related variables
 Texture2D Albedo			: register(t0);
 Texture2D NormalMap			: register(t1);
-Texture2D RoughnessMap		: register(t2);
+Texture2D ORMMap			: register(t2);	// Occlusion, roughness, metalness
 SamplerState BasicSampler	: register(s0);
 
 
@@ -52,7 +52,7 @@ float4 main(VertexToPixel input) : SV_TARGET
 	input.normal = NormalMapping(NormalMap, BasicSampler, input.uv, input.normal, input.tangent);
 	
 	// Treating roughness as a pseduo-spec map here
-	float roughness = RoughnessMap.Sample(BasicSampler, input.uv).r;
+	float roughness = ORMMap.Sample(BasicSampler, input.uv).g;
 	float specPower = max(256.0f * (1.0f - roughness), 0.01f); // Ensure we never hit 0
 	
 	// Gamma correct the texture back to linear space and apply the color tint
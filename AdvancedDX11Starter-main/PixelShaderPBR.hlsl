@@ -44,8 +44,7 @@ struct VertexToPixel
 // Texture-related variables
 Texture2D Albedo			: register(t0);
 Texture2D NormalMap			: register(t1);
-Texture2D RoughnessMap		: register(t2);
-Texture2D MetalMap			: register(t3);
+Texture2D ORMMap			: register(t2);	// Occlusion, roughness, metalness
 SamplerState BasicSampler	: register(s0);
 
 
@@ -61,8 +60,9 @@ float4 main(VertexToPixel input) : SV_TARGET
 
 	// Sample various textures
 	input.normal = NormalMapping(NormalMap, BasicSampler, input.uv, input.normal, input.tangent);
-	float roughness = RoughnessMap.Sample(BasicSampler, input.uv).r;
-	float metal = MetalMap.Sample(BasicSampler, input.uv).r;
+	float3 orm = ORMMap.Sample(BasicSampler, input.uv).rgb;
+	float roughness = orm.g;
+	float metal = orm.b;
 
 	// Gamma correct the texture back to linear space and apply the color tint
 	float4 surfaceColor = Albedo.Sample(BasicSampler, input.uv);
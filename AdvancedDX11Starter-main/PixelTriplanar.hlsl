@@ -27,7 +27,7 @@ Texture2D AlbedoFront   : register(t1);
 Texture2D AlbedoSide    : register(t2);
 Texture2D AlbedoTop     : register(t3);
 
-Texture2D ShadowMap     : register(t4);
+Texture2DArray ShadowMap : register(t4);
 
 SamplerState BasicSampler : register(s0);
 SamplerComparisonState ShadowSampler : register(s1);
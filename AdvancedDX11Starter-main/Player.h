@@ -1,11 +1,16 @@
 #pragma once
 #include <DirectXMath.h>
 #include <vector>
+#include <string.h>
 
 #include "Transform.h"
 #include "Camera.h"
 
 #include "Input.h"
+#include "FrameArena.h"
+#include "EntityStore.h"
+#include "Collision.h"
+#include "PlayerMotion.h"
 
 /// <summary>
 /// Holds data relating to moving the player and
@@ -44,6 +49,8 @@ public:
 	std::vector<DirectX::XMFLOAT3> playerVels;		// Velocity  
 	std::vector<float> playerMaxSpeed;	// Max Speed  
 	std::vector<float> mouseSensitivity; // Necessary? 
+	std::vector<float> fallSpeeds;		// Only when moving through a level
+	std::vector<bool> grounded;
 };
 
 /// <summary>
@@ -84,142 +91,102 @@ static void AddPlayer(PlayersData* data, std::string id, float camRatio)
 	data->playerVels.push_back(DirectX::XMFLOAT3(0, 0, 0));
 	data->playerMaxSpeed.push_back(8.0f);
 	data->mouseSensitivity.push_back(0.5f);
+	data->fallSpeeds.push_back(0.0f);
+	data->grounded.push_back(false);
 }
 
 /// <summary>
-/// Moves all player entities based on directional inputs 
+/// A player's state as the motion step sees it
 /// </summary>
-/// <param name="data"></param>
-/// <param name="dirs"></param>
-static void TransformPlayers(PlayersData* data, std::vector<PlayerInput> inputs, float delta)
+static PlayerMotionState GetPlayerMotionState(PlayersData* data, int i)
 {
+	PlayerMotionState state;
+	DirectX::XMFLOAT3 position = data->transforms[i].GetPosition();
+	memcpy(state.position, &position, sizeof(state.position));
+	memcpy(state.velocity, &data->playerVels[i], sizeof(state.velocity));
+	state.yaw = data->transforms[i].GetPitchYawRoll().y;
+	state.pitch = data->cams[i].transform.GetPitchYawRoll().x;
+	state.fallSpeed = data->fallSpeeds[i];
+	state.grounded = data->grounded[i];
+	return state;
+}
 
-	// TODO: Split into multiple for loops to avoid cache misses 
-
-	for (int i = 0; i < data->transforms.size(); i++)
-	{
-		// Translate base position 
-		DirectX::XMFLOAT3 dir = inputs[i].dir; // WASD input 
-
-		// New physical movement 
-		DirectX::XMFLOAT3 cVel = data->playerVels[i];
-		float cAcl = data->playerAcls[i]; // Player's accel 
-		DirectX::XMVECTOR vel = DirectX::XMLoadFloat3( 
-			&cVel); // Current vel 
-
-		float acl = delta * cAcl;
-		DirectX::XMVECTOR deltaV;
-		deltaV = DirectX::XMVectorScale( // Change in vel 
-			DirectX::XMLoadFloat3(&dir),
-			acl);
-		
-		// Clamp new velocity 
-		vel = DirectX::XMVectorAdd(vel, deltaV); // Combine 
-		DirectX::XMFLOAT3 combined; 
-		DirectX::XMStoreFloat3(&combined, vel);
-
-		// Make sure there is some input 
-		if (abs(dir.x) >= 0.1f || abs(dir.z) >= 0.1f)
-		{
-			DirectX::XMVECTOR vLength = 
-				DirectX::XMVector3Length(vel);
-			DirectX::XMFLOAT3 speed; // Magnitude of vel 
-			DirectX::XMStoreFloat3(&speed, vLength);
-
-
-			// Check if speed is out of range 
-			if (abs(speed.x) >= data->playerMaxSpeed[i])
-			{
-				vel = DirectX::XMVectorScale(
-					DirectX::XMVector3Normalize(vel),
-					data->playerMaxSpeed[i]);
-			}
-
-			
-
-
-			// Store new velocity 
-			DirectX::XMStoreFloat3(&cVel, vel);
-
-			// Stop movement in direction if intent is opposite 
-			if (dir.x * cVel.x < 0.0)
-			{
-				cVel.x = 0.0f;
-			}
-
-			if (dir.z * cVel.z < 0.0)
-			{
-				cVel.z = 0.0f;
-			}
-
-		}
-		else
-		{
-			float dacl = data->playerDcls[i] * delta;
-
-			data->playerVels[i] = DirectX::XMFLOAT3(
-				cVel.x = (cVel.x < 0 ? 
-					min(0, cVel.x + dacl) :
-					max(0, cVel.x - dacl)),
-				cVel.y, 
-				cVel.z = (cVel.z < 0 ?
-					min(0, cVel.z + dacl) :
-					max(0, cVel.z - dacl)));
-		}
-
-		// Use displacement 
-		DirectX::XMFLOAT3 d; 
-		DirectX::XMVECTOR displacement = DirectX::XMVectorScale( 
-			vel, 
-			delta);
-		DirectX::XMStoreFloat3(&d, displacement);
-		data->transforms[i].MoveRelative(d);
-		data->playerVels[i] = cVel;
-
-
-
-		// Camera position offset 
-		DirectX::XMFLOAT3 camPos; 
-		DirectX::XMFLOAT3 pos = data->transforms[i].GetPosition();
-		DirectX::XMFLOAT3 up = data->transforms[i].GetUp();
-		DirectX::XMStoreFloat3(&camPos, 
-			DirectX::XMVectorAdd(
-				DirectX::XMLoadFloat3(&pos), 
-				DirectX::XMVectorScale(
-					DirectX::XMLoadFloat3(&up), 
-					data->camHeight[i])));
-		data->cams[i].transform.SetPosition(camPos);
-
-
-		// Rotation 
-		DirectX::XMFLOAT2 mouseDelta = inputs[i].mouseDelta;
-
-		float sensitivity = data->mouseSensitivity[i];
-		float xRot = data->mouseSensitivity[i] * mouseDelta.x * sensitivity * delta;
-
-
-		// Roate base AND cam for x-delta 
-		data->transforms[i].Rotate(
-			0.0f,
-			xRot, 0.0f);
-		data->cams[i].transform.Rotate(
-			data->mouseSensitivity[i] * mouseDelta.y * sensitivity * delta,
-			xRot, 0.0f);
+static PlayerMotionSettings GetPlayerMotionSettings(const PlayersData* data, int i)
+{
+	PlayerMotionSettings settings;
+	settings.acceleration = data->playerAcls[i];
+	settings.deceleration = data->playerDcls[i];
+	settings.maxSpeed = data->playerMaxSpeed[i];
+	settings.mouseSensitivity = data->mouseSensitivity[i];
+	return settings;
+}
 
+static PlayerMotionInput GetPlayerMotionInput(const PlayerInput& input)
+{
+	PlayerMotionInput motion;
+	memcpy(motion.dir, &input.dir, sizeof(motion.dir));
+	memcpy(motion.mouseDelta, &input.mouseDelta, sizeof(motion.mouseDelta));
+	return motion;
+}
 
-		// Clamp the X rotation
-		DirectX::XMFLOAT3 rot = data->cams[i].transform.GetPitchYawRoll();
-		rot.x = max(-1.2f, min(rot.x, 1.2f));
-		data->cams[i].transform.SetRotation(rot);
+/// <summary>
+/// Puts a stepped state back on the player, with the camera
+/// standing camHeight over their feet looking where they do
+/// </summary>
+static void SetPlayerMotionState(PlayersData* data, int i, const PlayerMotionState& state)
+{
+	data->transforms[i].SetPosition(state.position[0], state.position[1], state.position[2]);
+	data->transforms[i].SetRotation(0.0f, state.yaw, 0.0f);
+	memcpy(&data->playerVels[i], state.velocity, sizeof(state.velocity));
+	data->fallSpeeds[i] = state.fallSpeed;
+	data->grounded[i] = state.grounded;
+
+	Transform& cam = data->cams[i].transform;
+	cam.SetPosition(state.position[0], state.position[1] + data->camHeight[i], state.position[2]);
+	cam.SetRotation(state.pitch, state.yaw, cam.GetPitchYawRoll().z);
+	UpdateViewMatrix(&data->cams[i]);
+}
 
-		UpdateViewMatrix(&data->cams[i]);
+/// <summary>
+/// Moves all player entities based on directional inputs 
+/// </summary>
+/// <param name="data"></param>
+/// <param name="inputs">One per player</param>
+/// <param name="level">Collision to keep players out of, or null to fly freely</param>
+static void TransformPlayers(PlayersData* data, Span<const PlayerInput> inputs, float delta, const LevelCollision* level)
+{
+	for (int i = 0; i < data->transforms.size(); i++)
+	{
+		PlayerMotionState state = GetPlayerMotionState(data, i);
+		StepPlayerMotion(&state, GetPlayerMotionInput(inputs[i]), GetPlayerMotionSettings(data, i), delta, level);
+		SetPlayerMotionState(data, i, state);
 	}
 }
 
+/// <summary>
+/// Copies a transform worked out with Transform's helpers
+/// onto an entity, if it is still around
+/// </summary>
+static void SetEntityTransform(EntityStore* scene, EntityId id, Transform& transform)
+{
+	TransformComponent* t = scene->Get<TransformComponent>(id);
+	if (!t)
+		return;
+
+	DirectX::XMFLOAT3 position = transform.GetPosition();
+	DirectX::XMFLOAT3 rotation = transform.GetPitchYawRoll();
+	DirectX::XMFLOAT3 scale = transform.GetScale();
+	memcpy(t->position, &position, sizeof(t->position));
+	memcpy(t->pitchYawRoll, &rotation, sizeof(t->pitchYawRoll));
+	memcpy(t->scale, &scale, sizeof(t->scale));
+	t->dirty = true;
+}
+
 static void UpdatePlayerGameLogic(
 	PlayersData* data, 
-	std::shared_ptr<GameEntity> heldSword,
-	std::shared_ptr<GameEntity> heldWand,
+	EntityStore* scene,
+	EntityId heldSword,
+	EntityId heldWand,
 	float delta)
 {
 	Transform trans				= data->transforms[0];
@@ -255,12 +222,14 @@ static void UpdatePlayerGameLogic(
 		DirectX::XMFLOAT3 sTarget;
 		DirectX::XMStoreFloat3(&sTarget, sPos);
 
-		heldSword->GetTransform()->SetPosition(sTarget);
-		heldSword->GetTransform()->SetRotation(data->cams[0].transform.GetPitchYawRoll());
-		heldSword->GetTransform()->Rotate(0.0f, 0.0f, rotZSword);
-		heldSword->GetTransform()->Rotate(rotXSword, 0.0f, 0.0f);
+		Transform sword;
+		sword.SetPosition(sTarget);
+		sword.SetRotation(data->cams[0].transform.GetPitchYawRoll());
+		sword.Rotate(0.0f, 0.0f, rotZSword);
+		sword.Rotate(rotXSword, 0.0f, 0.0f);
 
-		heldSword->GetTransform()->MoveAbsolute(DirectX::XMFLOAT3(0, vertOffset, 0));
+		sword.MoveAbsolute(DirectX::XMFLOAT3(0, vertOffset, 0));
+		SetEntityTransform(scene, heldSword, sword);
 	}
 
 	{ // Wand 
@@ -280,29 +249,34 @@ static void UpdatePlayerGameLogic(
 		DirectX::XMFLOAT3 sTarget;
 		DirectX::XMStoreFloat3(&sTarget, sPos);
 
-		heldWand->GetTransform()->SetPosition(sTarget);
-		heldWand->GetTransform()->SetRotation(data->cams[0].transform.GetPitchYawRoll());
-		heldWand->GetTransform()->Rotate(0.0f, 0.0f, rotZWand);
-		heldWand->GetTransform()->Rotate(rotXWand, 0.0f, 0.0f);
+		Transform wand;
+		wand.SetPosition(sTarget);
+		wand.SetRotation(data->cams[0].transform.GetPitchYawRoll());
+		wand.Rotate(0.0f, 0.0f, rotZWand);
+		wand.Rotate(rotXWand, 0.0f, 0.0f);
 
-		heldWand->GetTransform()->MoveAbsolute(DirectX::XMFLOAT3(0, vertOffset, 0));
+		wand.MoveAbsolute(DirectX::XMFLOAT3(0, vertOffset, 0));
+		SetEntityTransform(scene, heldWand, wand);
 	}
 	
 }
 
 /// <summary>
 /// Gets all the current input data of players and
-/// organizes it into a sweet little vector 
+/// organizes it into a sweet little array made in
+/// this frame's arena 
 /// </summary>
-/// <param name="delta"></param>
-static std::vector<PlayerInput> PlayersInputs(bool updateMouseDelta)
+/// <param name="arena"></param>
+/// <param name="updateMouseDelta"></param>
+static Span<PlayerInput> PlayersInputs(FrameArena& arena, bool updateMouseDelta)
 {
 	// In its current state only worry about one player's 
 	// inputs 
+	const size_t playerCount = 1;
 
 	Input& input = Input::GetInstance(); 
 
-	std::vector<PlayerInput> inputs;
+	PlayerInput* inputs = arena.NewArray<PlayerInput>(playerCount);
 
 	{ // Represents a single player 
 
@@ -359,9 +333,9 @@ static std::vector<PlayerInput> PlayersInputs(bool updateMouseDelta)
 		curr.rightMouseClicked = input.MouseLeftDown();
 
 		curr.dir = dirInput;
-		inputs.push_back(curr);
+		inputs[0] = curr;
 	}
 
 
-	return inputs;
+	return Span<PlayerInput>(inputs, playerCount);
 }
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "PlayerMotion.h"
+
+#include <algorithm>
+#include <cmath>
+
+void StepPlayerMotion(
+	PlayerMotionState* state,
+	const PlayerMotionInput& input,
+	const PlayerMotionSettings& settings,
+	float delta,
+	const LevelCollision* level)
+{
+	// Speed up along the input. What is kept for next step
+	// is clamped to the top speed and loses any part going
+	// against the input, while this step moves with the
+	// velocity before that
+	float acceleration = delta * settings.acceleration;
+	float velocity[3];
+	for (int i = 0; i < 3; i++)
+		velocity[i] = state->velocity[i] + input.dir[i] * acceleration;
+
+	float kept[3] = { state->velocity[0], state->velocity[1], state->velocity[2] };
+	if (fabsf(input.dir[0]) >= 0.1f || fabsf(input.dir[2]) >= 0.1f)
+	{
+		float speed = sqrtf(velocity[0] * velocity[0] + velocity[1] * velocity[1] + velocity[2] * velocity[2]);
+		if (speed >= settings.maxSpeed)
+		{
+			for (int i = 0; i < 3; i++)
+				velocity[i] *= settings.maxSpeed / speed;
+		}
+
+		for (int i = 0; i < 3; i++)
+			kept[i] = velocity[i];
+		if (input.dir[0] * kept[0] < 0.0f)
+			kept[0] = 0.0f;
+		if (input.dir[2] * kept[2] < 0.0f)
+			kept[2] = 0.0f;
+	}
+	else
+	{
+		// Slow to a stop without passing it
+		float deceleration = settings.deceleration * delta;
+		kept[0] = kept[0] < 0 ? (std::min)(0.0f, kept[0] + deceleration) : (std::max)(0.0f, kept[0] - deceleration);
+		kept[2] = kept[2] < 0 ? (std::min)(0.0f, kept[2] + deceleration) : (std::max)(0.0f, kept[2] - deceleration);
+	}
+
+	// Turned to where the player faces, like Transform's
+	// MoveRelative() with only a yaw
+	float c = cosf(state->yaw);
+	float s = sinf(state->yaw);
+	float move[3] = {
+		(velocity[0] * c + velocity[2] * s) * delta,
+		velocity[1] * delta,
+		(velocity[2] * c - velocity[0] * s) * delta };
+
+	if (level && level->GetNodeCount() > 0)
+	{
+		if (delta > 0.0f)
+		{
+			float worldVelocity[3] = {
+				move[0] / delta,
+				state->grounded ? 0.0f : state->fallSpeed - PLAYER_GRAVITY * delta,
+				move[2] / delta };
+
+			CollisionMoveResult result;
+			level->MoveCapsule(PLAYER_CAPSULE, state->position, worldVelocity, delta, &result);
+
+			// Landing or bumping a ceiling takes the fall speed away
+			state->grounded = result.grounded;
+			state->fallSpeed = worldVelocity[1];
+		}
+	}
+	else
+	{
+		for (int i = 0; i < 3; i++)
+			state->position[i] += move[i];
+	}
+
+	for (int i = 0; i < 3; i++)
+		state->velocity[i] = kept[i];
+
+	// The body turns left and right, the camera up and down too
+	float sensitivity = settings.mouseSensitivity;
+	state->yaw += sensitivity * input.mouseDelta[0] * sensitivity * delta;
+	state->pitch += sensitivity * input.mouseDelta[1] * sensitivity * delta;
+	state->pitch = (std::max)(-PLAYER_MAX_PITCH, (std::min)(state->pitch, PLAYER_MAX_PITCH));
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: One step of a player's movement with nothing but
+//			floats, so the server, a client replaying its own
+//			inputs and the game all move players the same way.
+//			Players speed up along their input up to a top
+//			speed, slow down when there is none, fall unless
+//			they stand on something and turn with the mouse.
+
+#include "Collision.h"
+
+// Players are this size when moving through the level
+static const CollisionCapsule PLAYER_CAPSULE = { 0.4f, 1.8f, 0.7f, 0.05f };
+#define PLAYER_GRAVITY 20.0f
+
+// Furthest the camera looks up or down, in radians
+#define PLAYER_MAX_PITCH 1.2f
+
+/// <summary>
+/// How a player handles, which never changes while moving
+/// </summary>
+struct PlayerMotionSettings
+{
+	float acceleration;
+	float deceleration;
+	float maxSpeed;
+	float mouseSensitivity;
+};
+
+/// <summary>
+/// One step of input. Direction is relative to where the
+/// player faces, X right and Z forward
+/// </summary>
+struct PlayerMotionInput
+{
+	float dir[3];
+	float mouseDelta[2];
+};
+
+/// <summary>
+/// Everything a step changes. Velocity is relative to where
+/// the player faces, like the input, and pitch is the
+/// camera's, as the body only turns about Y
+/// </summary>
+struct PlayerMotionState
+{
+	float position[3];
+	float velocity[3];
+	float yaw;
+	float pitch;
+	float fallSpeed;		// Only when moving through a level
+	bool grounded;
+};
+
+/// <summary>
+/// Moves a player one step of delta seconds, through the
+/// level's collision if it has any, flying freely otherwise
+/// </summary>
+void StepPlayerMotion(
+	PlayerMotionState* state,
+	const PlayerMotionInput& input,
+	const PlayerMotionSettings& settings,
+	float delta,
+	const LevelCollision* level);
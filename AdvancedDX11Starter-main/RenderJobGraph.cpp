@@ -0,0 +1,188 @@
+#include "RenderJobGraph.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/// <summary>
+/// Starts the worker threads. Workers record with slots
+/// 1 through workerCount, slot 0 is left for the thread
+/// that calls Run() since it helps out while waiting
+/// </summary>
+RenderJobGraph::RenderJobGraph(unsigned int workerCount) :
+	jobCount(0),
+	finishedJobs(0),
+	shuttingDown(false)
+{
+	for (unsigned int i = 0; i < workerCount; i++)
+	{
+		workers.push_back(std::thread(&RenderJobGraph::WorkerLoop, this, i + 1));
+	}
+}
+
+RenderJobGraph::~RenderJobGraph()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		shuttingDown = true;
+	}
+	workReady.notify_all();
+
+	for (auto& w : workers)
+		w.join();
+}
+
+/// <summary>
+/// Clears out the jobs of the previous frame, keeping
+/// them around to be reused by this one
+/// </summary>
+void RenderJobGraph::Reset()
+{
+	jobCount = 0;
+	readyJobs.clear();
+	finishedJobs = 0;
+}
+
+/// <summary>
+/// Adds a job to the graph and returns its index, which
+/// is also its position in the submission order
+/// </summary>
+unsigned int RenderJobGraph::AddJob(
+	const char* name,
+	std::function<void(unsigned int slot)> record,
+	Span<const unsigned int> dependencies)
+{
+	unsigned int index = jobCount++;
+	if (index == jobs.size())
+		jobs.push_back(RenderJob());
+
+	RenderJob& job = jobs[index];
+	job.name = name;
+	job.record = std::move(record);
+	job.dependencies.clear();
+	job.dependents.clear();
+	job.unfinishedDependencies = 0;
+	job.recordedBySlot = 0;
+
+	for (unsigned int d : dependencies)
+	{
+		// Only earlier jobs can be waited on. Anything else is
+		// a mistake in the caller, and ignoring it would leave
+		// the two jobs racing, so stop right here
+		if (d >= index)
+		{
+			fprintf(stderr, "RenderJobGraph: job %u (%s) depends on job %u, which hasn't been added\n", index, name, d);
+			abort();
+		}
+
+		job.dependencies.push_back(d);
+		jobs[d].dependents.push_back(index);
+		job.unfinishedDependencies++;
+	}
+
+	return index;
+}
+
+/// <summary>
+/// Records all jobs. In parallel mode the calling thread
+/// works alongside the workers until every job is done,
+/// otherwise the jobs are recorded in order on this thread
+/// </summary>
+void RenderJobGraph::Run(bool parallel)
+{
+	if (!parallel || workers.empty())
+	{
+		for (unsigned int i = 0; i < jobCount; i++)
+		{
+			jobs[i].recordedBySlot = 0;
+			jobs[i].record(0);
+		}
+		finishedJobs = jobCount;
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	// Seed with everything that has nothing to wait on
+	for (unsigned int i = 0; i < jobCount; i++)
+	{
+		if (jobs[i].unfinishedDependencies == 0)
+			readyJobs.push_back(i);
+	}
+	workReady.notify_all();
+
+	// Help out until there is nothing left to grab,
+	// then wait for the workers to finish theirs
+	while (finishedJobs < jobCount)
+	{
+		if (!readyJobs.empty())
+		{
+			unsigned int jobIndex = readyJobs.back();
+			readyJobs.pop_back();
+			RunJob(jobIndex, 0, lock);
+		}
+		else
+		{
+			workDone.wait(lock);
+		}
+	}
+}
+
+/// <summary>
+/// Walks the jobs in insertion order
+/// </summary>
+void RenderJobGraph::Submit(std::function<void(unsigned int jobIndex)> submit)
+{
+	for (unsigned int i = 0; i < jobCount; i++)
+	{
+		submit(i);
+	}
+}
+
+unsigned int RenderJobGraph::GetJobCount() { return jobCount; }
+unsigned int RenderJobGraph::GetWorkerCount() { return (unsigned int)workers.size(); }
+const RenderJob& RenderJobGraph::GetJob(unsigned int index) { return jobs[index]; }
+
+/// <summary>
+/// Workers sleep until jobs become ready
+/// </summary>
+void RenderJobGraph::WorkerLoop(unsigned int slot)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		workReady.wait(lock, [this]() { return shuttingDown || !readyJobs.empty(); });
+		if (shuttingDown)
+			return;
+
+		unsigned int jobIndex = readyJobs.back();
+		readyJobs.pop_back();
+		RunJob(jobIndex, slot, lock);
+	}
+}
+
+/// <summary>
+/// Records a single job outside of the lock and then
+/// releases anything that was waiting on it
+/// </summary>
+void RenderJobGraph::RunJob(unsigned int jobIndex, unsigned int slot, std::unique_lock<std::mutex>& lock)
+{
+	lock.unlock();
+	jobs[jobIndex].recordedBySlot = slot;
+	jobs[jobIndex].record(slot);
+	lock.lock();
+
+	bool released = false;
+	for (unsigned int d : jobs[jobIndex].dependents)
+	{
+		if (--jobs[d].unfinishedDependencies == 0)
+		{
+			readyJobs.push_back(d);
+			released = true;
+		}
+	}
+
+	finishedJobs++;
+	if (released)
+		workReady.notify_all();
+	workDone.notify_all();
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Schedule the recording of render work across
+//			worker threads. The graph knows nothing about
+//			Direct3D, each job is simply handed a recording
+//			slot, so the scheduling and submission order can
+//			be driven with a stubbed context.
+
+#include <functional>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "FrameArena.h"
+
+/// <summary>
+/// A single unit of recording work. Dependencies may only
+/// refer to jobs added before this one which keeps the
+/// graph acyclic and its insertion order a valid serial order.
+/// AddJob() aborts on any other.
+/// Jobs are reused from frame to frame so their lists keep
+/// their memory
+/// </summary>
+struct RenderJob
+{
+	const char* name;
+	std::function<void(unsigned int slot)> record;
+	std::vector<unsigned int> dependencies;
+
+	// Scheduling state
+	std::vector<unsigned int> dependents;
+	unsigned int unfinishedDependencies;
+	unsigned int recordedBySlot;
+};
+
+class RenderJobGraph
+{
+public:
+	RenderJobGraph(unsigned int workerCount);
+	~RenderJobGraph();
+
+	// Building the graph
+	void Reset();
+	unsigned int AddJob(
+		const char* name,
+		std::function<void(unsigned int slot)> record,
+		Span<const unsigned int> dependencies = Span<const unsigned int>());
+
+	// Records every job, blocking until all have finished
+	void Run(bool parallel);
+
+	// Visits jobs in the order they were added regardless
+	// of the order the workers finished them in
+	void Submit(std::function<void(unsigned int jobIndex)> submit);
+
+	unsigned int GetJobCount();
+	unsigned int GetWorkerCount();
+	const RenderJob& GetJob(unsigned int index);
+
+private:
+
+	void WorkerLoop(unsigned int slot);
+	void RunJob(unsigned int jobIndex, unsigned int slot, std::unique_lock<std::mutex>& lock);
+
+	// Only the first jobCount are this frame's
+	std::vector<RenderJob> jobs;
+	unsigned int jobCount;
+	std::vector<std::thread> workers;
+
+	// Shared scheduling state, guarded by mutex
+	std::mutex mutex;
+	std::condition_variable workReady;
+	std::condition_variable workDone;
+	std::vector<unsigned int> readyJobs;
+	unsigned int finishedJobs;
+	bool shuttingDown;
+};
@@ -0,0 +1,156 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Everything the render thread needs to draw one
+//			frame, copied out of the game state at the end of
+//			Update. The render thread never reads the live
+//			entities, camera or lights, only this copy.
+
+#include <DirectXMath.h>
+#include <vector>
+#include <memory>
+#include <string.h>
+
+#include "AssetHandle.h"
+#include "Camera.h"
+#include "Lights.h"
+#include "SimpleShader.h"
+#include "ImGui/imgui.h"
+#include "ShadowCascades.h"
+#include "DebugGeometry.h"
+#include "DebugText.h"
+
+/// <summary>
+/// One entity as it was at the end of Update. Assets are
+/// handles, looked up in the registry when drawn
+/// </summary>
+struct SnapshotEntity
+{
+	MeshHandle mesh;
+	MaterialHandle material;
+	VertexShaderHandle vs;
+	DirectX::XMFLOAT4X4 world;
+	DirectX::XMFLOAT4X4 worldInvTrans;
+	bool castsShadows;
+	bool isStatic;
+
+	// World space bounding sphere, for culling
+	DirectX::XMFLOAT3 boundsCenter;
+	float boundsRadius;
+};
+
+/// <summary>
+/// Entities that share a pixel shader
+/// </summary>
+struct SnapshotGroup
+{
+	PixelShaderHandle psHandle;
+	std::shared_ptr<SimplePixelShader> ps;
+	std::vector<SnapshotEntity> entities;
+};
+
+/// <summary>
+/// Copy of ImGui's draw data. ImGui reuses its own draw lists
+/// on the next NewFrame so the vertices have to be copied out
+/// </summary>
+struct UISnapshot
+{
+	ImDrawData drawData;
+	std::vector<ImDrawList*> drawLists;
+};
+
+struct RenderSnapshot
+{
+	unsigned long long frameIndex;
+	float deltaTime;
+	float totalTime;
+	bool multithreadedRecording;
+
+	// Camera
+	Camera camera;
+	DirectX::XMFLOAT3 cameraPosition;
+
+	// Lights and shadows
+	std::vector<Light> lights;
+	int lightCount;
+	bool showPointLights;
+	bool clusteredLighting;
+	DirectX::XMFLOAT4X4 shadowViewMatrix;
+	DirectX::XMFLOAT4X4 shadowProjectionMatrix;
+	ShadowCascade cascades[SHADOW_CASCADE_MAX_COUNT];
+	int cascadeCount;
+	int shadowPreviewCascade;
+
+	// Static shadow casters and everything about them that
+	// changes their shadow, hashed into one key
+	bool shadowCacheEnabled;
+	unsigned long long staticShadowKey;
+
+	// Scene
+	std::vector<SnapshotGroup> groups;
+
+	// Every debug line added this frame, already tessellated.
+	// Swapped in rather than copied so it costs nothing to publish
+	std::vector<DebugVertex> debugLines;
+
+	// Debug labels, projected with this snapshot's
+	// camera at this size of window
+	std::vector<DebugGlyphInstance> debugGlyphs;
+	float screenWidth;
+	float screenHeight;
+
+	UISnapshot ui;
+
+	RenderSnapshot() :
+		frameIndex(0),
+		deltaTime(0),
+		totalTime(0),
+		multithreadedRecording(true),
+		camera(),
+		cameraPosition(0, 0, 0),
+		lightCount(0),
+		showPointLights(false),
+		clusteredLighting(false),
+		cascadeCount(0),
+		shadowPreviewCascade(0),
+		shadowCacheEnabled(false),
+		staticShadowKey(SHADOW_STATIC_KEY_SEED),
+		screenWidth(1),
+		screenHeight(1)
+	{
+	}
+
+	~RenderSnapshot()
+	{
+		for (auto list : ui.drawLists)
+			IM_DELETE(list);
+	}
+};
+
+/// <summary>
+/// Copies the ImGui draw data into the snapshot, reusing the
+/// snapshot's draw lists so no allocation happens once they
+/// have grown large enough
+/// </summary>
+static void CopyUIDrawData(UISnapshot* ui, ImDrawData* src)
+{
+	while (ui->drawLists.size() < (size_t)src->CmdListsCount)
+		ui->drawLists.push_back(IM_NEW(ImDrawList)(nullptr));
+
+	for (int i = 0; i < src->CmdListsCount; i++)
+	{
+		ImDrawList* from = src->CmdLists[i];
+		ImDrawList* to = ui->drawLists[i];
+
+		to->CmdBuffer.resize(from->CmdBuffer.Size);
+		to->IdxBuffer.resize(from->IdxBuffer.Size);
+		to->VtxBuffer.resize(from->VtxBuffer.Size);
+		memcpy(to->CmdBuffer.Data, from->CmdBuffer.Data, from->CmdBuffer.size_in_bytes());
+		memcpy(to->IdxBuffer.Data, from->IdxBuffer.Data, from->IdxBuffer.size_in_bytes());
+		memcpy(to->VtxBuffer.Data, from->VtxBuffer.Data, from->VtxBuffer.size_in_bytes());
+		to->Flags = from->Flags;
+	}
+
+	ui->drawData = *src;
+	ui->drawData.CmdLists = ui->drawLists.data();
+}
@@ -14,65 +14,27 @@
 #include "Lights.h"
 #include "Transform.h"
 #include "Camera.h"
+#include "LightClusters.h"
+#include "ShadowCascades.h"
 
-// NOTE: To add a shader you must refer to it in the 
-//		 following sections. 
-//			A) In the PS/VS enum 
-//			B) Add a function for setting it 
-//			C) Include setting function in Set PS/VS function (Bottom of page)
-//			D) Link to VS/PS in LoadAssetsAndCreateEntities()
-
-// This should keep the adding of new shaders within this file
-// and allow for the swapping of shader types to be easier 
-// within game. 
-
-// Also note that when loading a new shader to link it with the 
-// appropriate shader enum 
-
-
-enum PixelShaders
-{
-	COMMON,
-	SOLID_COLOR,
-	TRIPLANAR,
-	TRIPLANAR_SHADOWS
-};
-
-enum VertexShaders
-{
-	VERTEX_SHADER,
-	SHADOW_VERTEX,
-};
-
-
-static void LinkPSShader(
-	const wchar_t* name, 
-	PixelShaders link,
-	std::unordered_map<const wchar_t*, PixelShaders>  psNameToID)
-{
-
-	if (psNameToID.find(name) == psNameToID.end())
-	{
-		// Add new shader combination 
-		psNameToID.insert(
-			std::pair<const wchar_t*, PixelShaders>
-			(name, link));
-	}
-	else
-	{
-		// Replace 
-		psNameToID[name] = link;
-	}
-}
+// NOTE: Adding a shader only needs it loaded in 
+//		 LoadAssetsAndCreateEntities(). Everything a
+//		 material sets is found through the shader's 
+//		 reflection when the material is resolved, and
+//		 the per-frame values below are only sent to 
+//		 shaders that declare them.
 
 #pragma region VERTEX_SHADERS
 
 /// <summary>
-/// Sends data for the VertexShader 
+/// Sends data for the VertexShader using world matrices
+/// that were already calculated, such as the copies held
+/// by a render snapshot
 /// </summary>
 static void SetVertexShader(
-	std::shared_ptr<SimpleVertexShader> vs,
-	Transform* transform,
+	const std::shared_ptr<SimpleVertexShader>& vs,
+	const DirectX::XMFLOAT4X4& world,
+	const DirectX::XMFLOAT4X4& worldInvTrans,
 	Camera* camera,
 	DirectX::XMFLOAT4X4 shadowViewMatrix,
 	DirectX::XMFLOAT4X4 shadowProjMatrix)
@@ -80,8 +42,8 @@ static void SetVertexShader(
 	vs->SetShader();
 
 	// Send data to the vertex shader
-	vs->SetMatrix4x4("world", transform->GetWorldMatrix());
-	vs->SetMatrix4x4("worldInverseTranspose", transform->GetWorldInverseTransposeMatrix());
+	vs->SetMatrix4x4("world", world);
+	vs->SetMatrix4x4("worldInverseTranspose", worldInvTrans);
 	vs->SetMatrix4x4("view", camera->viewMatrix);
 	vs->SetMatrix4x4("projection", camera->projMatrix);
 	vs->SetMatrix4x4("lightView", shadowViewMatrix);
@@ -89,6 +51,25 @@ static void SetVertexShader(
 	vs->CopyAllBufferData();
 }
 
+/// <summary>
+/// Sends data for the VertexShader 
+/// </summary>
+static void SetVertexShader(
+	std::shared_ptr<SimpleVertexShader> vs,
+	Transform* transform,
+	Camera* camera,
+	DirectX::XMFLOAT4X4 shadowViewMatrix,
+	DirectX::XMFLOAT4X4 shadowProjMatrix)
+{
+	SetVertexShader(
+		vs,
+		transform->GetWorldMatrix(),
+		transform->GetWorldInverseTransposeMatrix(),
+		camera,
+		shadowViewMatrix,
+		shadowProjMatrix);
+}
+
 
 #pragma endregion
 
@@ -97,145 +78,110 @@ static void SetVertexShader(
 
 
 /// <summary>
-/// Sends data universal to every material 
-/// </summary>
-static void SetMateralPixelData(
-	std::shared_ptr<SimplePixelShader> ps,
-	std::shared_ptr<RendMat> material)
-{
-	// TODO: Loop through material vector of pairs
-	//		 and send data to shader. Should help 
-	//		 make materials more generic 
-
-	ps->SetFloat3("colorTint", material->colorTint);
-	ps->SetFloat2("uvScale", material->uvScale);
-	ps->SetFloat2("uvOffset", material->uvOffset);
-	ps->CopyAllBufferData();
-}
-
-/// <summary>
-/// Sends buffer data for the CommonPixel shader 
+/// Sets up a lit pixel shader. Material values are bound
+/// per entity with BindMaterial so only the per-frame data
+/// is sent here
 /// </summary>
-static void SetCommonPixel(
-	std::shared_ptr<RendMat> material,
+static void SetPixelShader(
 	std::shared_ptr<SimplePixelShader> ps,
 	Light dirLight,
 	DirectX::XMFLOAT3 camPos,
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV,
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> shadowSampler)
 {
-	// Common pixel shader from material 
-	//std::shared_ptr<SimplePixelShader> ps = material->GetPixelShader();
 	ps->SetShader();
 
-	// Set data specific to this shader 
-	ps->SetData("worldLight", &dirLight, sizeof(Light));
-	ps->SetFloat3("cameraPosition", camPos);
-	ps->CopyBufferData("perFrame");
+	// Set data specific to this frame 
+	if (ps->HasVariable("worldLight"))
+	{
+		ps->SetData("worldLight", &dirLight, sizeof(Light));
+		ps->SetFloat3("cameraPosition", camPos);
+		ps->CopyBufferData("perFrame");
+	}
 
 	// Set shadowmap shader which is passed in
 	// every frame 
-	ps->SetShaderResourceView("ShadowMap", shadowSRV);
-	ps->SetSamplerState("ShadowSampler", shadowSampler);
-
-	// Set data 
-	SetMateralPixelData(ps, material);
-}
-
-static void SetSolidColor(
-	std::shared_ptr<RendMat> material,
-	std::shared_ptr<SimplePixelShader> ps,
-	Light dirLight,
-	DirectX::XMFLOAT3 camPos,
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV,
-	Microsoft::WRL::ComPtr<ID3D11SamplerState> shadowSampler)
-{
-	// TODO...
+	if (ps->HasShaderResourceView("ShadowMap"))
+	{
+		ps->SetShaderResourceView("ShadowMap", shadowSRV);
+		ps->SetSamplerState("ShadowSampler", shadowSampler);
+	}
 }
 
-static void SetTriplanar(
-	std::shared_ptr<RendMat> material,
+/// <summary>
+/// Sends the light clusters to a pixel shader that reads
+/// them. Must come before SetPixelShader since that is what
+/// uploads the perFrame buffer these values live in
+/// </summary>
+static void SetLightClusters(
 	std::shared_ptr<SimplePixelShader> ps,
-	Light dirLight,
-	DirectX::XMFLOAT3 camPos,
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV,
-	Microsoft::WRL::ComPtr<ID3D11SamplerState> shadowSampler)
+	bool enabled,
+	const LightClusterShaderParams& params,
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> lightsSRV,
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> rangesSRV,
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> indicesSRV)
 {
-	// Common pixel shader from material 
-	ps->SetShader();
+	if (!ps->HasVariable("clusteredLighting"))
+		return;
 
-	// Set data specific to this shader 
-	ps->SetData("worldLight", &dirLight, sizeof(Light));
-	ps->SetFloat3("cameraPosition", camPos);
-	ps->CopyBufferData("perFrame");
+	ps->SetInt("clusteredLighting", enabled ? 1 : 0);
+	ps->SetFloat4("clusterScreen", params.clustersPerPixel);
+	ps->SetFloat4("clusterDepth", &params.sliceScale);
+	ps->SetFloat4("clusterDepthRow", params.depthRow);
 
-	// Set shadowmap shader which is passed in
-	// every frame 
-	ps->SetShaderResourceView("ShadowMap", shadowSRV);
-	ps->SetSamplerState("ShadowSampler", shadowSampler);
-
-	// Set data 
-	PrepareMaterial(material, ps);
-	SetMateralPixelData(ps, material);
+	ps->SetShaderResourceView("ClusterLights", lightsSRV);
+	ps->SetShaderResourceView("ClusterRanges", rangesSRV);
+	ps->SetShaderResourceView("ClusterLightIndices", indicesSRV);
 }
 
-static void SetTriplanarShadows(
-	std::shared_ptr<RendMat> material,
+/// <summary>
+/// Sends the fitted shadow cascades to a pixel shader that
+/// reads them. Like SetLightClusters, must come before
+/// SetPixelShader
+/// </summary>
+static void SetShadowCascades(
 	std::shared_ptr<SimplePixelShader> ps,
-	Light dirLight,
-	DirectX::XMFLOAT3 camPos,
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV,
-	Microsoft::WRL::ComPtr<ID3D11SamplerState> shadowSampler)
+	const ShadowCascade* cascades,
+	int cascadeCount,
+	Camera* camera)
 {
-	// Common pixel shader from material 
-	ps->SetShader();
+	if (!ps->HasVariable("cascadeViewProj"))
+		return;
 
-	// Set data specific to this shader 
-	ps->SetData("worldLight", &dirLight, sizeof(Light));
-	ps->SetFloat3("cameraPosition", camPos);
-	ps->CopyBufferData("perFrame");
+	DirectX::XMFLOAT4X4 viewProj[SHADOW_CASCADE_MAX_COUNT] = {};
+	float splits[4] = {};
+	for (int i = 0; i < cascadeCount; i++)
+	{
+		memcpy(&viewProj[i], cascades[i].viewProjection, sizeof(DirectX::XMFLOAT4X4));
+		splits[i] = cascades[i].splitFar;
+	}
 
-	// Set shadowmap shader which is passed in
-	// every frame 
-	ps->SetShaderResourceView("ShadowMap", shadowSRV);
-	ps->SetSamplerState("ShadowSampler", shadowSampler);
+	// View space depth is the third column of the view matrix
+	const DirectX::XMFLOAT4X4& view = camera->viewMatrix;
+	float depthRow[4] = { view._13, view._23, view._33, view._43 };
 
-	// Set data 
-	PrepareMaterial(material, ps);
-	SetMateralPixelData(ps, material);
+	ps->SetData("cascadeViewProj", viewProj, sizeof(viewProj));
+	ps->SetFloat4("cascadeSplits", splits);
+	ps->SetFloat4("shadowDepthRow", depthRow);
+	ps->SetInt("cascadeCount", cascadeCount);
 }
 
 /// <summary>
-/// Sets up a lit pixel shader 
+/// Sends the sky's baked irradiance and prefiltered cube to
+/// a pixel shader that lights with them. Like the others,
+/// must come before SetPixelShader
 /// </summary>
-static void SetPixelShader(
-	std::shared_ptr<RendMat> material,
+static void SetSkyLighting(
 	std::shared_ptr<SimplePixelShader> ps,
-	Light dirLight,
-	DirectX::XMFLOAT3 camPos,
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowTextureSRV,
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV,
-	Microsoft::WRL::ComPtr<ID3D11SamplerState> shadowSampler,
-	std::unordered_map<const wchar_t*, PixelShaders>  psNameToID)
+	const float* irradianceSH,
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> specularSRV)
 {
+	if (!ps->HasVariable("skyIrradiance"))
+		return;
 
-	int type = psNameToID[material->psName];
-
-	switch (type)
-	{
-	case COMMON:
-		SetCommonPixel(material, ps, dirLight, camPos, shadowSRV, shadowSampler);
-		break;
-	case SOLID_COLOR:
-		break;
-	case TRIPLANAR:
-		SetTriplanar(material, ps, dirLight, camPos, shadowSRV, shadowSampler);
-		break;
-	case TRIPLANAR_SHADOWS:
-		SetTriplanar(material, ps, dirLight, camPos, shadowSRV, shadowSampler);
-	default:
-		break;
-	}
+	// Nine float4s, the fourth of each unused
+	ps->SetData("skyIrradiance", irradianceSH, sizeof(float) * 36);
+	ps->SetShaderResourceView("SkySpecular", specularSRV);
 }
 
 #pragma endregion 
\ No newline at end of file
@@ -0,0 +1,254 @@
+#include "ShadowCascades.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+
+static float Dot(const float a[3], const float b[3])
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void Cross(const float a[3], const float b[3], float out[3])
+{
+	out[0] = a[1] * b[2] - a[2] * b[1];
+	out[1] = a[2] * b[0] - a[0] * b[2];
+	out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static void Normalize(float v[3])
+{
+	float length = std::sqrt(Dot(v, v));
+	if (length <= 0.0f)
+		return;
+
+	v[0] /= length;
+	v[1] /= length;
+	v[2] /= length;
+}
+
+static void Multiply(const float a[4][4], const float b[4][4], float out[4][4])
+{
+	for (int r = 0; r < 4; r++)
+		for (int c = 0; c < 4; c++)
+			out[r][c] = a[r][0] * b[0][c] + a[r][1] * b[1][c] + a[r][2] * b[2][c] + a[r][3] * b[3][c];
+}
+
+void ComputeCascadeSplits(
+	float nearClip,
+	float farClip,
+	int count,
+	float lambda,
+	float* splits)
+{
+	splits[0] = nearClip;
+	for (int i = 1; i < count; i++)
+	{
+		float t = (float)i / count;
+		float logSplit = nearClip * std::pow(farClip / nearClip, t);
+		float uniformSplit = nearClip + (farClip - nearClip) * t;
+		splits[i] = lambda * logSplit + (1.0f - lambda) * uniformSplit;
+	}
+	splits[count] = farClip;
+}
+
+/// <summary>
+/// Smallest sphere around the part of the camera frustum
+/// between two depths, as a distance along the camera's
+/// forward axis and a radius. It only depends on the depths
+/// and the lens, never on which way the camera faces
+/// </summary>
+static void FitSliceSphere(
+	const ShadowCascadeCamera& camera,
+	float sliceNear,
+	float sliceFar,
+	float* centerDepth,
+	float* radius)
+{
+	// Half the diagonal of the slice's near and far faces
+	float nearHalf, farHalf;
+	if (camera.orthographic)
+	{
+		float halfWidth = camera.orthographicWidth * 0.5f;
+		float halfHeight = halfWidth / camera.aspectRatio;
+		nearHalf = farHalf = std::sqrt(halfWidth * halfWidth + halfHeight * halfHeight);
+	}
+	else
+	{
+		float tanY = std::tan(camera.fieldOfView * 0.5f);
+		float tanX = tanY * camera.aspectRatio;
+		float diagonal = std::sqrt(tanX * tanX + tanY * tanY);
+		nearHalf = sliceNear * diagonal;
+		farHalf = sliceFar * diagonal;
+	}
+
+	// The center is as far from both faces' corners
+	float depth = sliceFar - sliceNear;
+	float c = (depth * depth + farHalf * farHalf - nearHalf * nearHalf) / (2.0f * depth);
+	c = (std::max)(0.0f, (std::min)(c, depth));
+
+	float toNear = std::sqrt(c * c + nearHalf * nearHalf);
+	float toFar = std::sqrt((depth - c) * (depth - c) + farHalf * farHalf);
+
+	*centerDepth = sliceNear + c;
+	*radius = (std::max)(toNear, toFar);
+}
+
+int FitShadowCascades(
+	const ShadowCascadeCamera& camera,
+	const float lightDirection[3],
+	const ShadowCascadeSettings& settings,
+	ShadowCascade* cascades)
+{
+	int count = (std::max)(1, (std::min)(settings.count, SHADOW_CASCADE_MAX_COUNT));
+
+	float farClip = (std::min)(camera.farClip, settings.shadowDistance);
+	farClip = (std::max)(farClip, camera.nearClip + 0.01f);
+
+	float splits[SHADOW_CASCADE_MAX_COUNT + 1];
+	ComputeCascadeSplits(camera.nearClip, farClip, count, settings.splitLambda, splits);
+
+	// One light view for every cascade. It sits at the world
+	// origin so snapping in its space snaps to fixed texels
+	float z[3] = { lightDirection[0], lightDirection[1], lightDirection[2] };
+	Normalize(z);
+
+	float up[3] = { 0, 1, 0 };
+	if (std::fabs(z[1]) > 0.99f)
+	{
+		up[1] = 0;
+		up[2] = 1;
+	}
+
+	float x[3], y[3];
+	Cross(up, z, x);
+	Normalize(x);
+	Cross(z, x, y);
+
+	float view[4][4] =
+	{
+		{ x[0], y[0], z[0], 0 },
+		{ x[1], y[1], z[1], 0 },
+		{ x[2], y[2], z[2], 0 },
+		{ 0, 0, 0, 1 }
+	};
+
+	for (int i = 0; i < count; i++)
+	{
+		ShadowCascade& cascade = cascades[i];
+		cascade.splitNear = splits[i];
+		cascade.splitFar = splits[i + 1];
+
+		float centerDepth, radius;
+		FitSliceSphere(camera, splits[i], splits[i + 1], &centerDepth, &radius);
+
+		// Rounding up keeps float noise from
+		// changing the size frame to frame
+		radius = std::ceil(radius * 16.0f) / 16.0f;
+
+		// Pad the box so the sphere stays inside it however
+		// far snapping moves the center, which is one step
+		unsigned int snapTexels = (std::max)(1u, (std::min)(settings.snapTexels, settings.resolution / 4));
+		float halfWidth = radius * settings.resolution / (settings.resolution - 2.0f * snapTexels);
+		float texelSize = 2.0f * halfWidth / settings.resolution;
+		float step = texelSize * snapTexels;
+
+		float center[3] =
+		{
+			camera.position[0] + camera.forward[0] * centerDepth,
+			camera.position[1] + camera.forward[1] * centerDepth,
+			camera.position[2] + camera.forward[2] * centerDepth
+		};
+
+		// Snap the center to whole steps in light space. Depth
+		// is snapped too so the depth range only changes
+		// when the box does
+		float lightCenter[3] = { Dot(center, x), Dot(center, y), Dot(center, z) };
+		lightCenter[0] = std::floor(lightCenter[0] / step) * step;
+		lightCenter[1] = std::floor(lightCenter[1] / step) * step;
+		lightCenter[2] = std::floor(lightCenter[2] / step) * step;
+
+		float left = lightCenter[0] - halfWidth;
+		float right = lightCenter[0] + halfWidth;
+		float bottom = lightCenter[1] - halfWidth;
+		float top = lightCenter[1] + halfWidth;
+		float nearZ = lightCenter[2] - radius - settings.casterDistance;
+		float farZ = lightCenter[2] + radius + step;
+
+		// Same as XMMatrixOrthographicOffCenterLH
+		float projection[4][4] =
+		{
+			{ 2.0f / (right - left), 0, 0, 0 },
+			{ 0, 2.0f / (top - bottom), 0, 0 },
+			{ 0, 0, 1.0f / (farZ - nearZ), 0 },
+			{ (left + right) / (left - right), (top + bottom) / (bottom - top), nearZ / (nearZ - farZ), 1 }
+		};
+
+		memcpy(cascade.view, view, sizeof(view));
+		memcpy(cascade.projection, projection, sizeof(projection));
+		Multiply(view, projection, cascade.viewProjection);
+
+		memcpy(cascade.center, lightCenter, sizeof(lightCenter));
+		cascade.radius = halfWidth;
+		cascade.nearZ = nearZ;
+		cascade.farZ = farZ;
+		cascade.texelSize = texelSize;
+	}
+
+	return count;
+}
+
+bool ShadowCascadeOverlapsSphere(
+	const ShadowCascade& cascade,
+	const float center[3],
+	float radius)
+{
+	// Light space axes are the view matrix's columns
+	float lightCenter[3];
+	for (int a = 0; a < 3; a++)
+		lightCenter[a] = center[0] * cascade.view[0][a] + center[1] * cascade.view[1][a] + center[2] * cascade.view[2][a];
+
+	return
+		std::fabs(lightCenter[0] - cascade.center[0]) <= cascade.radius + radius &&
+		std::fabs(lightCenter[1] - cascade.center[1]) <= cascade.radius + radius &&
+		lightCenter[2] + radius >= cascade.nearZ &&
+		lightCenter[2] - radius <= cascade.farZ;
+}
+
+bool ShadowCacheMatches(
+	const ShadowCascadeCache& cache,
+	const ShadowCascade& cascade,
+	unsigned long long staticKey)
+{
+	// Exact compare on purpose. Snapped bounds come out
+	// bit for bit the same while the cascade stands still
+	return
+		cache.valid &&
+		cache.staticKey == staticKey &&
+		memcmp(cache.viewProjection, cascade.viewProjection, sizeof(cache.viewProjection)) == 0;
+}
+
+void StoreShadowCache(
+	ShadowCascadeCache* cache,
+	const ShadowCascade& cascade,
+	unsigned long long staticKey)
+{
+	cache->valid = true;
+	cache->staticKey = staticKey;
+	memcpy(cache->viewProjection, cascade.viewProjection, sizeof(cache->viewProjection));
+}
+
+unsigned long long HashShadowCaster(
+	unsigned long long key,
+	const void* data,
+	size_t bytes)
+{
+	// FNV-1a
+	const unsigned char* b = (const unsigned char*)data;
+	for (size_t i = 0; i < bytes; i++)
+	{
+		key ^= b[i];
+		key *= 1099511628211ull;
+	}
+	return key;
+}
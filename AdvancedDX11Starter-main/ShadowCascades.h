@@ -0,0 +1,147 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Fit the directional light's shadow projections to
+//			the camera. The view frustum is split into depth
+//			ranges and each one gets its own orthographic
+//			projection, bounded by a sphere so it does not
+//			change size as the camera turns and snapped to
+//			whole shadow map texels so it does not shimmer as
+//			the camera moves. Plain float math with no
+//			Direct3D so the fitting can be checked headless.
+
+// Must match Shadows.hlsli
+#define SHADOW_CASCADE_MAX_COUNT 4
+
+#include <stddef.h>
+
+/// <summary>
+/// How the cascades are split and fitted
+/// </summary>
+struct ShadowCascadeSettings
+{
+	int count;
+
+	// 0 splits the shadowed range evenly, 1 splits it
+	// logarithmically. In between blends the two
+	float splitLambda;
+
+	// Shadows end here even when the camera sees further
+	float shadowDistance;
+
+	// Width of one cascade's shadow map in texels
+	unsigned int resolution;
+
+	// How far towards the light past a cascade's bounds
+	// casters are still drawn into it
+	float casterDistance;
+
+	// Cascades move in steps of this many texels. Larger
+	// steps keep a cascade still for longer, which is what
+	// lets its static casters stay cached, at the cost of a
+	// little resolution spent on padding. 1 for no padding
+	unsigned int snapTexels;
+};
+
+/// <summary>
+/// The camera as the fitting sees it. Vectors are in world space
+/// </summary>
+struct ShadowCascadeCamera
+{
+	float position[3];
+	float right[3];
+	float up[3];
+	float forward[3];
+	float fieldOfView;
+	float aspectRatio;
+	float nearClip;
+	float farClip;
+	bool orthographic;
+	float orthographicWidth;
+};
+
+/// <summary>
+/// One fitted cascade. Matrices are laid out like
+/// DirectX::XMFLOAT4X4, row vectors times the matrix
+/// </summary>
+struct ShadowCascade
+{
+	float view[4][4];
+	float projection[4][4];
+	float viewProjection[4][4];
+
+	// Camera depth range this cascade covers
+	float splitNear;
+	float splitFar;
+
+	// Bounds in the light's view space. Radius is half the
+	// width of the box, padded past the fitted sphere
+	float center[3];
+	float radius;
+	float nearZ;
+	float farZ;
+
+	// World units covered by one texel
+	float texelSize;
+};
+
+/// <summary>
+/// Fills splits with count + 1 depths from near to far,
+/// blending uniform and logarithmic splits by lambda
+/// </summary>
+void ComputeCascadeSplits(
+	float nearClip,
+	float farClip,
+	int count,
+	float lambda,
+	float* splits);
+
+/// <summary>
+/// Fits every cascade to the camera for a light shining in
+/// lightDirection. Returns how many cascades were fitted
+/// </summary>
+int FitShadowCascades(
+	const ShadowCascadeCamera& camera,
+	const float lightDirection[3],
+	const ShadowCascadeSettings& settings,
+	ShadowCascade* cascades);
+
+/// <summary>
+/// Whether a world space sphere can cast a shadow into a cascade
+/// </summary>
+bool ShadowCascadeOverlapsSphere(
+	const ShadowCascade& cascade,
+	const float center[3],
+	float radius);
+
+/// <summary>
+/// What a cascade's cached static casters were drawn with.
+/// They can be reused for as long as neither changes
+/// </summary>
+struct ShadowCascadeCache
+{
+	bool valid;
+	unsigned long long staticKey;
+	float viewProjection[4][4];
+};
+
+bool ShadowCacheMatches(
+	const ShadowCascadeCache& cache,
+	const ShadowCascade& cascade,
+	unsigned long long staticKey);
+
+void StoreShadowCache(
+	ShadowCascadeCache* cache,
+	const ShadowCascade& cascade,
+	unsigned long long staticKey);
+
+/// <summary>
+/// Folds a static caster's data into the key of the whole
+/// static set. Start from SHADOW_STATIC_KEY_SEED
+/// </summary>
+unsigned long long HashShadowCaster(
+	unsigned long long key,
+	const void* data,
+	size_t bytes);
+
+#define SHADOW_STATIC_KEY_SEED 14695981039346656037ull
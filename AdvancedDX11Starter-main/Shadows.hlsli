@@ -0,0 +1,82 @@
+// Include guard
+#ifndef _SHADOWS_HLSL
+#define _SHADOWS_HLSL
+
+// Must match ShadowCascades.h
+#define SHADOW_CASCADE_MAX_COUNT 4
+
+// How much of each cascade's end is blended into the next
+#define SHADOW_CASCADE_BLEND 0.1f
+
+// cascadeViewProj:	light view projection of each cascade
+// cascadeSplits:	camera depth each cascade ends at
+// depthRow:		view space depth is dot(float4(worldPos, 1), depthRow)
+// cascadeCount:	cascades actually drawn this frame
+
+/// <summary>
+/// Compares a world position against a single cascade
+/// </summary>
+float SampleShadowCascade(
+    Texture2DArray shadowMap,
+    SamplerComparisonState shadowSampler,
+    matrix viewProj,
+    float3 worldPos,
+    int cascade)
+{
+    // Orthographic, so no divide by W
+    float4 shadowPos = mul(viewProj, float4(worldPos, 1.0f));
+
+    // Convert the normalized device coordinates to UVs for sampling
+    float2 shadowUV = shadowPos.xy * 0.5f + 0.5f;
+    shadowUV.y = 1 - shadowUV.y; // Flip the Y
+
+    return shadowMap.SampleCmpLevelZero(
+        shadowSampler,
+        float3(shadowUV, cascade),
+        shadowPos.z).r;
+}
+
+/// <summary>
+/// How lit a world position is by the cascaded directional
+/// light shadow, 1 being fully lit. Positions past the last
+/// cascade are always lit
+/// </summary>
+float CascadedShadow(
+    Texture2DArray shadowMap,
+    SamplerComparisonState shadowSampler,
+    matrix cascadeViewProj[SHADOW_CASCADE_MAX_COUNT],
+    float4 cascadeSplits,
+    float4 depthRow,
+    int cascadeCount,
+    float3 worldPos)
+{
+    float depth = dot(float4(worldPos, 1.0f), depthRow);
+
+    // First cascade that still reaches this depth
+    int cascade = 0;
+    [unroll]
+    for (int i = 0; i < SHADOW_CASCADE_MAX_COUNT - 1; i++)
+        cascade += (i < cascadeCount - 1 && depth > cascadeSplits[i]) ? 1 : 0;
+
+    if (depth > cascadeSplits[cascade])
+        return 1.0f;
+
+    float shadow = SampleShadowCascade(shadowMap, shadowSampler, cascadeViewProj[cascade], worldPos, cascade);
+
+    // Fade into the next cascade near the end of this one so
+    // the change in resolution is not a hard line
+    float start = cascade > 0 ? cascadeSplits[cascade - 1] : 0.0f;
+    float blendStart = cascadeSplits[cascade] - (cascadeSplits[cascade] - start) * SHADOW_CASCADE_BLEND;
+    if (depth > blendStart)
+    {
+        float t = (depth - blendStart) / (cascadeSplits[cascade] - blendStart);
+        float next = cascade < cascadeCount - 1 ?
+            SampleShadowCascade(shadowMap, shadowSampler, cascadeViewProj[cascade + 1], worldPos, cascade + 1) :
+            1.0f;
+        shadow = lerp(shadow, next, t);
+    }
+
+    return shadow;
+}
+
+#endif
@@ -1,5 +1,8 @@
 #include "SimpleShader.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+
 // Default error reporting state
 bool ISimpleShader::ReportErrors = false;
 bool ISimpleShader::ReportWarnings = false;
@@ -11,6 +14,10 @@ bool ISimpleShader::ReportWarnings = false;
 // ISimpleShader::ReportErrors = true;
 // ISimpleShader::ReportWarnings = true;
 
+// Per-thread recording state (see BeginRecording())
+static thread_local ID3D11DeviceContext* recordingContext = 0;
+static thread_local unsigned int recordingSlot = 0;
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // ------ BASE SIMPLE SHADER --------------------------------------------------
@@ -200,8 +207,10 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 
 		// Set up the data buffer for this constant buffer
 		constantBuffers[b].Size = bufferDesc.Size;
-		constantBuffers[b].LocalDataBuffer = new unsigned char[bufferDesc.Size];
-		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
+		// Every recording slot gets its own (16-byte aligned) copy of the local data
+		unsigned int slotStride = ((bufferDesc.Size + 15) / 16) * 16;
+		constantBuffers[b].LocalDataBuffer = new unsigned char[slotStride * SIMPLESHADER_MAX_RECORDING_SLOTS];
+		ZeroMemory(constantBuffers[b].LocalDataBuffer, slotStride * SIMPLESHADER_MAX_RECORDING_SLOTS);
 
 		// Loop through all variables in this buffer
 		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
@@ -322,6 +331,56 @@ void ISimpleShader::LogWarning(std::string message) { Log(message, FOREGROUND_RE
 void ISimpleShader::LogWarningW(std::wstring message) { LogW(message, FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_INTENSITY); }
 
 
+// --------------------------------------------------------
+// Redirects all shader calls made on this thread to the
+// given (usually deferred) context until EndRecording()
+//
+// context - The context to record into
+// slot    - Which copy of the local constant buffer data
+//           this thread uses.  Must be unique per thread
+//           and less than SIMPLESHADER_MAX_RECORDING_SLOTS
+// --------------------------------------------------------
+void ISimpleShader::BeginRecording(ID3D11DeviceContext* context, unsigned int slot)
+{
+	// Falling back to another slot would have two threads
+	// writing the same staging data, so stop right here
+	if (slot >= SIMPLESHADER_MAX_RECORDING_SLOTS)
+	{
+		fprintf(stderr, "SimpleShader: recording slot %u is past the last of %u\n", slot, SIMPLESHADER_MAX_RECORDING_SLOTS);
+		abort();
+	}
+
+	recordingContext = context;
+	recordingSlot = slot;
+}
+
+// --------------------------------------------------------
+// Returns this thread to the shader's own context and slot 0
+// --------------------------------------------------------
+void ISimpleShader::EndRecording()
+{
+	recordingContext = 0;
+	recordingSlot = 0;
+}
+
+// --------------------------------------------------------
+// Gets the context this thread should issue commands to
+// --------------------------------------------------------
+ID3D11DeviceContext* ISimpleShader::GetActiveContext()
+{
+	return recordingContext ? recordingContext : deviceContext.Get();
+}
+
+// --------------------------------------------------------
+// Gets this thread's copy of a buffer's local data
+// --------------------------------------------------------
+unsigned char* ISimpleShader::GetLocalData(SimpleConstantBuffer* cb)
+{
+	unsigned int slotStride = ((cb->Size + 15) / 16) * 16;
+	return cb->LocalDataBuffer + slotStride * recordingSlot;
+}
+
+
 // --------------------------------------------------------
 // Sets the shader and associated constant buffers in Direct3D
 // --------------------------------------------------------
@@ -349,9 +408,9 @@ void ISimpleShader::CopyAllBufferData()
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
 		// Copy the entire local data buffer
-		deviceContext->UpdateSubresource(
+		GetActiveContext()->UpdateSubresource(
 			constantBuffers[i].ConstantBuffer.Get(), 0, 0,
-			constantBuffers[i].LocalDataBuffer, 0, 0);
+			GetLocalData(&constantBuffers[i]), 0, 0);
 	}
 }
 
@@ -380,9 +439,9 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 	if (!cb) return;
 
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
+	GetActiveContext()->UpdateSubresource(
 		cb->ConstantBuffer.Get(), 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+		GetLocalData(cb), 0, 0);
 }
 
 // --------------------------------------------------------
@@ -402,9 +461,9 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 	if (!cb) return;
 
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
+	GetActiveContext()->UpdateSubresource(
 		cb->ConstantBuffer.Get(), 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+		GetLocalData(cb), 0, 0);
 }
 
 
@@ -447,7 +506,7 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 
 	// Set the data in the local data buffer
 	memcpy(
-		constantBuffers[var->ConstantBufferIndex].LocalDataBuffer + var->ByteOffset,
+		GetLocalData(&constantBuffers[var->ConstantBufferIndex]) + var->ByteOffset,
 		data,
 		size);
 
@@ -869,8 +928,8 @@ void SimpleVertexShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader and input layout
-	deviceContext->IASetInputLayout(inputLayout.Get());
-	deviceContext->VSSetShader(shader.Get(), 0, 0);
+	GetActiveContext()->IASetInputLayout(inputLayout.Get());
+	GetActiveContext()->VSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -880,7 +939,7 @@ void SimpleVertexShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->VSSetConstantBuffers(
+		GetActiveContext()->VSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
 			constantBuffers[i].ConstantBuffer.GetAddressOf());
@@ -911,7 +970,7 @@ bool SimpleVertexShader::SetShaderResourceView(std::string name, Microsoft::WRL:
 	}
 
 	// Set the shader resource view
-	deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	GetActiveContext()->VSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -941,7 +1000,7 @@ bool SimpleVertexShader::SetSamplerState(std::string name, Microsoft::WRL::ComPt
 	}
 
 	// Set the shader resource view
-	deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	GetActiveContext()->VSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
@@ -1012,7 +1071,7 @@ void SimplePixelShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 	
 	// Set the shader
-	deviceContext->PSSetShader(shader.Get(), 0, 0);
+	GetActiveContext()->PSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1022,7 +1081,7 @@ void SimplePixelShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->PSSetConstantBuffers(
+		GetActiveContext()->PSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
 			constantBuffers[i].ConstantBuffer.GetAddressOf());
@@ -1053,7 +1112,7 @@ bool SimplePixelShader::SetShaderResourceView(std::string name, Microsoft::WRL::
 	}
 
 	// Set the shader resource view
-	deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	GetActiveContext()->PSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -1083,7 +1142,7 @@ bool SimplePixelShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr
 	}
 
 	// Set the shader resource view
-	deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	GetActiveContext()->PSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
@@ -1156,7 +1215,7 @@ void SimpleDomainShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->DSSetShader(shader.Get(), 0, 0);
+	GetActiveContext()->DSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1166,7 +1225,7 @@ void SimpleDomainShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->DSSetConstantBuffers(
+		GetActiveContext()->DSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
 			constantBuffers[i].ConstantBuffer.GetAddressOf());
@@ -1197,7 +1256,7 @@ bool SimpleDomainShader::SetShaderResourceView(std::string name, Microsoft::WRL:
 	}
 
 	// Set the shader resource view
-	deviceContext->DSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	GetActiveContext()->DSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -1227,7 +1286,7 @@ bool SimpleDomainShader::SetSamplerState(std::string name, Microsoft::WRL::ComPt
 	}
 
 	// Set the shader resource view
-	deviceContext->DSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	GetActiveContext()->DSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
@@ -1299,7 +1358,7 @@ void SimpleHullShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->HSSetShader(shader.Get(), 0, 0);
+	GetActiveContext()->HSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1309,7 +1368,7 @@ void SimpleHullShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->HSSetConstantBuffers(
+		GetActiveContext()->HSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
 			constantBuffers[i].ConstantBuffer.GetAddressOf());
@@ -1340,7 +1399,7 @@ bool SimpleHullShader::SetShaderResourceView(std::string name, Microsoft::WRL::C
 	}
 
 	// Set the shader resource view
-	deviceContext->HSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	GetActiveContext()->HSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -1370,7 +1429,7 @@ bool SimpleHullShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr<
 	}
 
 	// Set the shader resource view
-	deviceContext->HSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	GetActiveContext()->HSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
@@ -1573,7 +1632,7 @@ void SimpleGeometryShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->GSSetShader(shader.Get(), 0, 0);
+	GetActiveContext()->GSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1583,7 +1642,7 @@ void SimpleGeometryShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->GSSetConstantBuffers(
+		GetActiveContext()->GSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
 			constantBuffers[i].ConstantBuffer.GetAddressOf());
@@ -1614,7 +1673,7 @@ bool SimpleGeometryShader::SetShaderResourceView(std::string name, Microsoft::WR
 	}
 
 	// Set the shader resource view
-	deviceContext->GSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	GetActiveContext()->GSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -1644,7 +1703,7 @@ bool SimpleGeometryShader::SetSamplerState(std::string name, Microsoft::WRL::Com
 	}
 
 	// Set the shader resource view
-	deviceContext->GSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	GetActiveContext()->GSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
@@ -1783,7 +1842,7 @@ void SimpleComputeShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->CSSetShader(shader.Get(), 0, 0);
+	GetActiveContext()->CSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1793,7 +1852,7 @@ void SimpleComputeShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->CSSetConstantBuffers(
+		GetActiveContext()->CSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
 			constantBuffers[i].ConstantBuffer.GetAddressOf());
@@ -1822,7 +1881,7 @@ void SimpleComputeShader::SetShaderAndCBs()
 // --------------------------------------------------------
 void SimpleComputeShader::DispatchByGroups(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ)
 {
-	deviceContext->Dispatch(groupsX, groupsY, groupsZ);
+	GetActiveContext()->Dispatch(groupsX, groupsY, groupsZ);
 }
 
 // --------------------------------------------------------
@@ -1847,7 +1906,7 @@ void SimpleComputeShader::DispatchByGroups(unsigned int groupsX, unsigned int gr
 // --------------------------------------------------------
 void SimpleComputeShader::DispatchByThreads(unsigned int threadsX, unsigned int threadsY, unsigned int threadsZ)
 {
-	deviceContext->Dispatch(
+	GetActiveContext()->Dispatch(
 		max((unsigned int)ceil((float)threadsX / this->threadsX), 1),
 		max((unsigned int)ceil((float)threadsY / this->threadsY), 1),
 		max((unsigned int)ceil((float)threadsZ / this->threadsZ), 1));
@@ -1885,7 +1944,7 @@ bool SimpleComputeShader::SetShaderResourceView(std::string name, Microsoft::WRL
 	}
 
 	// Set the shader resource view
-	deviceContext->CSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	GetActiveContext()->CSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -1915,7 +1974,7 @@ bool SimpleComputeShader::SetSamplerState(std::string name, Microsoft::WRL::ComP
 	}
 
 	// Set the shader resource view
-	deviceContext->CSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	GetActiveContext()->CSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
@@ -1946,7 +2005,7 @@ bool SimpleComputeShader::SetUnorderedAccessView(std::string name, Microsoft::WR
 	}
 
 	// Set the shader resource view
-	deviceContext->CSSetUnorderedAccessViews(bindIndex, 1, uav.GetAddressOf(), &appendConsumeOffset);
+	GetActiveContext()->CSSetUnorderedAccessViews(bindIndex, 1, uav.GetAddressOf(), &appendConsumeOffset);
 
 	// Success
 	return true;
@@ -11,6 +11,10 @@
 #include <vector>
 #include <string>
 
+// Number of threads that may stage constant buffer data at once.
+// Slot 0 is always the thread that owns the immediate context, the
+// rest are handed out to threads recording into deferred contexts
+#define SIMPLESHADER_MAX_RECORDING_SLOTS 8
 
 // --------------------------------------------------------
 // Used by simple shaders to store information about
@@ -35,7 +39,7 @@ struct SimpleConstantBuffer
 	unsigned int Size = 0;
 	unsigned int BindIndex = 0;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> ConstantBuffer = 0;
-	unsigned char* LocalDataBuffer = 0;
+	unsigned char* LocalDataBuffer = 0; // One Size-byte block per recording slot
 	std::vector<SimpleShaderVariable> Variables;
 };
 
@@ -118,6 +122,12 @@ public:
 	// Misc getters
 	Microsoft::WRL::ComPtr<ID3DBlob> GetShaderBlob() { return shaderBlob; }
 
+	// Redirects this thread's shader calls to a deferred context.
+	// Each recording thread must use its own slot so that the
+	// local (CPU-side) constant buffer data is never shared
+	static void BeginRecording(ID3D11DeviceContext* context, unsigned int slot);
+	static void EndRecording();
+
 	// Error reporting
 	static bool ReportErrors;
 	static bool ReportWarnings;
@@ -154,6 +164,10 @@ protected:
 	SimpleShaderVariable* FindVariable(std::string name, int size);
 	SimpleConstantBuffer* FindConstantBuffer(std::string name);
 
+	// Helpers for the calling thread's recording state
+	ID3D11DeviceContext* GetActiveContext();
+	unsigned char* GetLocalData(SimpleConstantBuffer* cb);
+
 	// Error logging
 	void Log(std::string message, WORD color);
 	void LogW(std::wstring message, WORD color);
@@ -1,7 +1,14 @@
 #include "Sky.h"
+#include "SkyBake.h"
+#include "Helpers.h"
 #include "WICTextureLoader.h"
 #include "DDSTextureLoader.h"
 
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
 using namespace DirectX;
 
 Sky::Sky(
@@ -287,4 +294,180 @@ Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(
 Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::GetSkySRV()
 {
 	return skySRV;
+}
+
+// --------------------------------------------------------
+// Baked lighting
+// --------------------------------------------------------
+
+// Last write time of a file, or false when it is missing
+static bool GetWriteTime(const std::wstring& path, FILETIME* time)
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data))
+		return false;
+
+	*time = data.ftLastWriteTime;
+	return true;
+}
+
+void Sky::BakeLighting(const std::wstring faces[6], const std::wstring& cacheFolder)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	bakeCached = LoadBakedLighting(faces, cacheFolder);
+	if (!bakeCached)
+	{
+		// Decode the faces, all of which have to match
+		std::vector<unsigned char> pixels[6];
+		unsigned int faceSize = 0;
+		for (int i = 0; i < 6; i++)
+		{
+			unsigned int width = 0;
+			unsigned int height = 0;
+			if (!ReadImageRGBA(faces[i], pixels[i], &width, &height) || width != height || (i > 0 && width != faceSize))
+				return;
+			faceSize = width;
+		}
+
+		const unsigned char* facePixels[6];
+		for (int i = 0; i < 6; i++)
+			facePixels[i] = pixels[i].data();
+
+		SkyCube source;
+		SkyCubeFromFaces(facePixels, faceSize, SKY_BAKE_SOURCE_SIZE, &source);
+
+		SkyBakeResult bake;
+		BakeSkyLighting(source, (std::max)(1u, std::thread::hardware_concurrency()), &bake);
+
+		for (int i = 0; i < 9; i++)
+		{
+			irradianceSH[i][0] = bake.irradiance[i][0];
+			irradianceSH[i][1] = bake.irradiance[i][1];
+			irradianceSH[i][2] = bake.irradiance[i][2];
+			irradianceSH[i][3] = 0.0f;
+		}
+
+		// Every level of every face as half floats
+		std::vector<unsigned char> data;
+		PackSkySpecular(bake, data);
+
+		D3D11_SUBRESOURCE_DATA initial[6 * SKY_BAKE_SPECULAR_MIPS] = {};
+		size_t offset = 0;
+		for (unsigned int face = 0; face < 6; face++)
+		{
+			for (unsigned int mip = 0; mip < SKY_BAKE_SPECULAR_MIPS; mip++)
+			{
+				unsigned int size = bake.specular[mip].size;
+				D3D11_SUBRESOURCE_DATA& sub = initial[D3D11CalcSubresource(mip, face, SKY_BAKE_SPECULAR_MIPS)];
+				sub.pSysMem = data.data() + offset;
+				sub.SysMemPitch = size * 8;
+				offset += (size_t)size * size * 8;
+			}
+		}
+
+		D3D11_TEXTURE2D_DESC cubeDesc = {};
+		cubeDesc.ArraySize = 6;
+		cubeDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		cubeDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+		cubeDesc.Width = SKY_BAKE_SPECULAR_SIZE;
+		cubeDesc.Height = SKY_BAKE_SPECULAR_SIZE;
+		cubeDesc.MipLevels = SKY_BAKE_SPECULAR_MIPS;
+		cubeDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+		cubeDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		cubeDesc.SampleDesc.Count = 1;
+
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> cubeTexture;
+		if (FAILED(device->CreateTexture2D(&cubeDesc, initial, cubeTexture.GetAddressOf())))
+			return;
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = cubeDesc.Format;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+		srvDesc.TextureCube.MipLevels = SKY_BAKE_SPECULAR_MIPS;
+		srvDesc.TextureCube.MostDetailedMip = 0;
+		specularSRV.Reset();
+		device->CreateShaderResourceView(cubeTexture.Get(), &srvDesc, specularSRV.GetAddressOf());
+
+		// Make every folder on the way to the cache, then save
+		// it so the next run can skip all of the above
+		for (size_t slash = cacheFolder.find_first_of(L"\\/"); slash != std::wstring::npos; slash = cacheFolder.find_first_of(L"\\/", slash + 1))
+			CreateDirectoryW(cacheFolder.substr(0, slash).c_str(), 0);
+		CreateDirectoryW(cacheFolder.c_str(), 0);
+
+		std::vector<unsigned char> file;
+		WriteSkySpecular(bake, file);
+		std::ofstream specularFile(cacheFolder + L"specular.dds", std::ios::binary);
+		specularFile.write((const char*)file.data(), file.size());
+
+		std::ofstream irradianceFile(cacheFolder + L"irradiance.txt");
+		irradianceFile << WriteSkyIrradiance(bake);
+	}
+
+	bakeMS = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+}
+
+bool Sky::LoadBakedLighting(const std::wstring faces[6], const std::wstring& cacheFolder)
+{
+	std::wstring specularPath = cacheFolder + L"specular.dds";
+	std::wstring irradiancePath = cacheFolder + L"irradiance.txt";
+
+	// Both halves of the cache have to be newer than every face
+	FILETIME specularTime;
+	FILETIME irradianceTime;
+	if (!GetWriteTime(specularPath, &specularTime) || !GetWriteTime(irradiancePath, &irradianceTime))
+		return false;
+
+	for (int i = 0; i < 6; i++)
+	{
+		FILETIME faceTime;
+		if (!GetWriteTime(faces[i], &faceTime) ||
+			CompareFileTime(&faceTime, &specularTime) > 0 ||
+			CompareFileTime(&faceTime, &irradianceTime) > 0)
+			return false;
+	}
+
+	// Harmonics first, since a version mismatch means rebaking
+	std::ifstream irradianceFile(irradiancePath);
+	std::stringstream text;
+	text << irradianceFile.rdbuf();
+
+	float sh[9][3];
+	if (!ReadSkyIrradiance(text.str(), sh))
+		return false;
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	if (FAILED(CreateDDSTextureFromFile(device.Get(), specularPath.c_str(), 0, srv.GetAddressOf())))
+		return false;
+
+	for (int i = 0; i < 9; i++)
+	{
+		irradianceSH[i][0] = sh[i][0];
+		irradianceSH[i][1] = sh[i][1];
+		irradianceSH[i][2] = sh[i][2];
+		irradianceSH[i][3] = 0.0f;
+	}
+	specularSRV = srv;
+	return true;
+}
+
+const float* Sky::GetIrradianceSH()
+{
+	return &irradianceSH[0][0];
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::GetSpecularSRV()
+{
+	return specularSRV;
+}
+
+float Sky::GetBakeMS()
+{
+	return bakeMS;
+}
+
+bool Sky::WasBakeCached()
+{
+	return bakeCached;
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <string>
 
 #include "Mesh.h"
 #include "SimpleShader.h"
@@ -69,10 +70,24 @@ public:
 	void Draw(Camera* camera);
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetSkySRV();
 
+	// Bakes the light the sky gives off from its six faces,
+	// or loads the last bake from the cache folder when it
+	// is newer than all of them
+	void BakeLighting(const std::wstring faces[6], const std::wstring& cacheFolder);
+
+	// Nine SH coefficients padded to float4 for a cbuffer,
+	// and the cube whose mips are prefiltered by roughness
+	const float* GetIrradianceSH();
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetSpecularSRV();
+	float GetBakeMS();
+	bool WasBakeCached();
+
 private:
 
 	void InitRenderStates();
 
+	bool LoadBakedLighting(const std::wstring faces[6], const std::wstring& cacheFolder);
+
 	// Helper for creating a cubemap from 6 individual textures
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateCubemap(
 		const wchar_t* right,
@@ -100,6 +115,12 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> skyDepthState;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> skySRV;
 
+	// Baked lighting
+	float irradianceSH[9][4] = {};
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> specularSRV;
+	float bakeMS = 0.0f;
+	bool bakeCached = false;
+
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerOptions;
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
 	Microsoft::WRL::ComPtr<ID3D11Device> device;
@@ -0,0 +1,551 @@
+#include "SkyBake.h"
+#include "TextureCooker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+#include <thread>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// Faces are gamma encoded the same way albedo is
+#define SKY_BAKE_GAMMA 2.2f
+
+#define SKY_BAKE_PI 3.14159265f
+
+// --------------------------------------------------------
+// Cube layout
+// --------------------------------------------------------
+
+void SkyCubeDirection(unsigned int face, float u, float v, float dir[3])
+{
+	switch (face)
+	{
+	case 0: dir[0] = 1.0f;	dir[1] = -v;	dir[2] = -u;	break;
+	case 1: dir[0] = -1.0f;	dir[1] = -v;	dir[2] = u;		break;
+	case 2: dir[0] = u;		dir[1] = 1.0f;	dir[2] = v;		break;
+	case 3: dir[0] = u;		dir[1] = -1.0f;	dir[2] = -v;	break;
+	case 4: dir[0] = u;		dir[1] = -v;	dir[2] = 1.0f;	break;
+	default: dir[0] = -u;	dir[1] = -v;	dir[2] = -1.0f;	break;
+	}
+
+	float length = sqrtf(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+	dir[0] /= length;
+	dir[1] /= length;
+	dir[2] /= length;
+}
+
+/// <summary>
+/// The face a direction points into and where on it, the
+/// reverse of SkyCubeDirection
+/// </summary>
+static void SkyCubeFace(const float dir[3], unsigned int* face, float* u, float* v)
+{
+	float x = fabsf(dir[0]);
+	float y = fabsf(dir[1]);
+	float z = fabsf(dir[2]);
+
+	float major, s, t;
+	if (x >= y && x >= z)
+	{
+		major = x;
+		*face = dir[0] > 0 ? 0 : 1;
+		s = dir[0] > 0 ? -dir[2] : dir[2];
+		t = -dir[1];
+	}
+	else if (y >= z)
+	{
+		major = y;
+		*face = dir[1] > 0 ? 2 : 3;
+		s = dir[0];
+		t = dir[1] > 0 ? dir[2] : -dir[2];
+	}
+	else
+	{
+		major = z;
+		*face = dir[2] > 0 ? 4 : 5;
+		s = dir[2] > 0 ? dir[0] : -dir[0];
+		t = -dir[1];
+	}
+
+	*u = s / major;
+	*v = t / major;
+}
+
+// Integral over the face from the center to (x, y)
+static float AreaElement(float x, float y)
+{
+	return atan2f(x * y, sqrtf(x * x + y * y + 1.0f));
+}
+
+float SkyTexelSolidAngle(unsigned int size, unsigned int x, unsigned int y)
+{
+	float texel = 2.0f / size;
+	float x0 = x * texel - 1.0f;
+	float y0 = y * texel - 1.0f;
+	float x1 = x0 + texel;
+	float y1 = y0 + texel;
+	return AreaElement(x0, y0) - AreaElement(x0, y1) - AreaElement(x1, y0) + AreaElement(x1, y1);
+}
+
+// --------------------------------------------------------
+// Building and sampling cubes
+// --------------------------------------------------------
+
+void SkyCubeFromFaces(
+	const unsigned char* const faces[6],
+	unsigned int faceSize,
+	unsigned int size,
+	SkyCube* out)
+{
+	float toLinear[256];
+	for (int i = 0; i < 256; i++)
+		toLinear[i] = powf(i / 255.0f, SKY_BAKE_GAMMA);
+
+	// Whole texels only, so every output texel
+	// averages the same number of inputs
+	unsigned int ratio = (std::max)(faceSize / (std::max)(size, 1u), 1u);
+	out->size = faceSize / ratio;
+	out->texels.assign((size_t)6 * out->size * out->size * 3, 0.0f);
+
+	float scale = 1.0f / (ratio * ratio);
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		for (unsigned int y = 0; y < out->size; y++)
+		{
+			for (unsigned int x = 0; x < out->size; x++)
+			{
+				float* texel = out->Texel(face, x, y);
+				for (unsigned int sy = 0; sy < ratio; sy++)
+				{
+					const unsigned char* row = &faces[face][((size_t)(y * ratio + sy) * faceSize + x * ratio) * 4];
+					for (unsigned int sx = 0; sx < ratio; sx++)
+					{
+						texel[0] += toLinear[row[sx * 4 + 0]];
+						texel[1] += toLinear[row[sx * 4 + 1]];
+						texel[2] += toLinear[row[sx * 4 + 2]];
+					}
+				}
+
+				texel[0] *= scale;
+				texel[1] *= scale;
+				texel[2] *= scale;
+			}
+		}
+	}
+}
+
+void DownsampleSkyCube(const SkyCube& cube, SkyCube* out)
+{
+	out->size = (std::max)(cube.size / 2, 1u);
+	out->texels.assign((size_t)6 * out->size * out->size * 3, 0.0f);
+
+	unsigned int step = cube.size / out->size;
+	float scale = 1.0f / (step * step);
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		for (unsigned int y = 0; y < out->size; y++)
+		{
+			for (unsigned int x = 0; x < out->size; x++)
+			{
+				float* texel = out->Texel(face, x, y);
+				for (unsigned int sy = 0; sy < step; sy++)
+				{
+					for (unsigned int sx = 0; sx < step; sx++)
+					{
+						const float* source = cube.Texel(face, x * step + sx, y * step + sy);
+						for (int c = 0; c < 3; c++)
+							texel[c] += source[c] * scale;
+					}
+				}
+			}
+		}
+	}
+}
+
+void SampleSkyCube(const SkyCube& cube, const float dir[3], float out[3])
+{
+	unsigned int face;
+	float u, v;
+	SkyCubeFace(dir, &face, &u, &v);
+
+	// Clamped at the face edges rather than crossing over
+	float maxTexel = (float)(cube.size - 1);
+	float x = (std::min)((std::max)((u + 1.0f) * 0.5f * cube.size - 0.5f, 0.0f), maxTexel);
+	float y = (std::min)((std::max)((v + 1.0f) * 0.5f * cube.size - 0.5f, 0.0f), maxTexel);
+	unsigned int x0 = (unsigned int)x;
+	unsigned int y0 = (unsigned int)y;
+	unsigned int x1 = (std::min)(x0 + 1, cube.size - 1);
+	unsigned int y1 = (std::min)(y0 + 1, cube.size - 1);
+	float fx = x - x0;
+	float fy = y - y0;
+
+	const float* t00 = cube.Texel(face, x0, y0);
+	const float* t10 = cube.Texel(face, x1, y0);
+	const float* t01 = cube.Texel(face, x0, y1);
+	const float* t11 = cube.Texel(face, x1, y1);
+	for (int c = 0; c < 3; c++)
+	{
+		float top = t00[c] + (t10[c] - t00[c]) * fx;
+		float bottom = t01[c] + (t11[c] - t01[c]) * fx;
+		out[c] = top + (bottom - top) * fy;
+	}
+}
+
+// --------------------------------------------------------
+// Diffuse: nine spherical harmonics
+//
+// The sky is projected onto the first three bands, then
+// each band is scaled by its share of the cosine lobe
+// (pi, 2pi/3, pi/4) and divided by pi.
+// --------------------------------------------------------
+
+static void SHBasis(const float dir[3], float basis[9])
+{
+	float x = dir[0];
+	float y = dir[1];
+	float z = dir[2];
+
+	basis[0] = 0.282095f;
+	basis[1] = 0.488603f * y;
+	basis[2] = 0.488603f * z;
+	basis[3] = 0.488603f * x;
+	basis[4] = 1.092548f * x * y;
+	basis[5] = 1.092548f * y * z;
+	basis[6] = 0.315392f * (3.0f * z * z - 1.0f);
+	basis[7] = 1.092548f * x * z;
+	basis[8] = 0.546274f * (x * x - y * y);
+}
+
+void ProjectIrradianceSH9(const SkyCube& cube, float sh[9][3])
+{
+	double sums[9][3] = {};
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		for (unsigned int y = 0; y < cube.size; y++)
+		{
+			for (unsigned int x = 0; x < cube.size; x++)
+			{
+				float dir[3];
+				SkyCubeDirection(face, (x + 0.5f) * 2.0f / cube.size - 1.0f, (y + 0.5f) * 2.0f / cube.size - 1.0f, dir);
+
+				float basis[9];
+				SHBasis(dir, basis);
+
+				float solidAngle = SkyTexelSolidAngle(cube.size, x, y);
+				const float* texel = cube.Texel(face, x, y);
+				for (int i = 0; i < 9; i++)
+					for (int c = 0; c < 3; c++)
+						sums[i][c] += (double)texel[c] * basis[i] * solidAngle;
+			}
+		}
+	}
+
+	static const float bandScale[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+	for (int i = 0; i < 9; i++)
+		for (int c = 0; c < 3; c++)
+			sh[i][c] = (float)sums[i][c] * bandScale[i];
+}
+
+void EvaluateIrradianceSH9(const float sh[9][3], const float dir[3], float out[3])
+{
+	float basis[9];
+	SHBasis(dir, basis);
+
+	for (int c = 0; c < 3; c++)
+	{
+		float sum = 0.0f;
+		for (int i = 0; i < 9; i++)
+			sum += sh[i][c] * basis[i];
+
+		// Three bands can ring below zero on a sharp sky
+		out[c] = (std::max)(sum, 0.0f);
+	}
+}
+
+// --------------------------------------------------------
+// Specular: GGX prefiltering
+//
+// Importance sampled with the view along the normal, each
+// sample weighted by N dot L. Samples read from the source
+// level whose texels are about the size of the solid angle
+// the sample stands for, so the sky does not alias.
+// --------------------------------------------------------
+
+float SkySpecularRoughness(unsigned int level)
+{
+	return (float)level / (SKY_BAKE_SPECULAR_MIPS - 1);
+}
+
+static void Hammersley(unsigned int i, unsigned int count, float* u, float* v)
+{
+	unsigned int bits = i;
+	bits = (bits << 16) | (bits >> 16);
+	bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+	bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+	bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+	bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+
+	*u = (float)i / count;
+	*v = bits * 2.3283064365386963e-10f;
+}
+
+void PrefilterSkyDirection(
+	const std::vector<SkyCube>& levels,
+	const float dir[3],
+	float roughness,
+	unsigned int sampleCount,
+	float out[3])
+{
+	// A mirror is the sky itself
+	if (roughness <= 0.0f)
+	{
+		SampleSkyCube(levels[0], dir, out);
+		return;
+	}
+
+	// Any frame around the direction will do
+	float up[3] = { 0.0f, 0.0f, 0.0f };
+	up[fabsf(dir[2]) < 0.999f ? 2 : 0] = 1.0f;
+	float tangent[3] =
+	{
+		up[1] * dir[2] - up[2] * dir[1],
+		up[2] * dir[0] - up[0] * dir[2],
+		up[0] * dir[1] - up[1] * dir[0]
+	};
+	float tangentLength = sqrtf(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2]);
+	for (int c = 0; c < 3; c++)
+		tangent[c] /= tangentLength;
+	float bitangent[3] =
+	{
+		dir[1] * tangent[2] - dir[2] * tangent[1],
+		dir[2] * tangent[0] - dir[0] * tangent[2],
+		dir[0] * tangent[1] - dir[1] * tangent[0]
+	};
+
+	float alpha = roughness * roughness;
+	float alpha2 = alpha * alpha;
+	float texelSolidAngle = 4.0f * SKY_BAKE_PI / (6.0f * levels[0].size * levels[0].size);
+	float maxLevel = (float)(levels.size() - 1);
+
+	float sum[3] = {};
+	float weight = 0.0f;
+	for (unsigned int i = 0; i < sampleCount; i++)
+	{
+		float u, v;
+		Hammersley(i, sampleCount, &u, &v);
+
+		float phi = 2.0f * SKY_BAKE_PI * u;
+		float cosTheta = sqrtf((1.0f - v) / (1.0f + (alpha2 - 1.0f) * v));
+		float sinTheta = sqrtf(1.0f - cosTheta * cosTheta);
+
+		float half[3];
+		for (int c = 0; c < 3; c++)
+			half[c] = (tangent[c] * cosf(phi) + bitangent[c] * sinf(phi)) * sinTheta + dir[c] * cosTheta;
+
+		// Reflect the view, which is the direction itself
+		float light[3];
+		for (int c = 0; c < 3; c++)
+			light[c] = 2.0f * cosTheta * half[c] - dir[c];
+
+		float nDotL = light[0] * dir[0] + light[1] * dir[1] + light[2] * dir[2];
+		if (nDotL <= 0.0f)
+			continue;
+
+		// With the view on the normal the pdf is D / 4
+		float denominator = cosTheta * cosTheta * (alpha2 - 1.0f) + 1.0f;
+		float distribution = alpha2 / (SKY_BAKE_PI * denominator * denominator);
+		float sampleSolidAngle = 4.0f / (sampleCount * distribution);
+		float level = (std::min)((std::max)(0.5f * log2f(sampleSolidAngle / texelSolidAngle), 0.0f), maxLevel);
+
+		// Between the two nearest levels
+		unsigned int fine = (unsigned int)level;
+		unsigned int coarse = (std::min)(fine + 1, (unsigned int)maxLevel);
+		float blend = level - fine;
+
+		float fineColor[3], coarseColor[3];
+		SampleSkyCube(levels[fine], light, fineColor);
+		SampleSkyCube(levels[coarse], light, coarseColor);
+		for (int c = 0; c < 3; c++)
+			sum[c] += (fineColor[c] + (coarseColor[c] - fineColor[c]) * blend) * nDotL;
+		weight += nDotL;
+	}
+
+	for (int c = 0; c < 3; c++)
+		out[c] = weight > 0.0f ? sum[c] / weight : 0.0f;
+}
+
+// --------------------------------------------------------
+// Baking
+// --------------------------------------------------------
+
+void BakeSkyLighting(const SkyCube& source, unsigned int threadCount, SkyBakeResult* out)
+{
+	// Every level of the source down to 1x1
+	std::vector<SkyCube> levels(1, source);
+	while (levels.back().size > 1)
+	{
+		SkyCube next;
+		DownsampleSkyCube(levels.back(), &next);
+		levels.push_back(next);
+	}
+
+	// The harmonics only need a small cube
+	const SkyCube* shCube = &levels.back();
+	for (auto& level : levels)
+	{
+		if (level.size <= SKY_BAKE_SH_SIZE)
+		{
+			shCube = &level;
+			break;
+		}
+	}
+	ProjectIrradianceSH9(*shCube, out->irradiance);
+
+	// The top of the specular cube is the sky at its size
+	unsigned int top = 0;
+	while (top + 1 < levels.size() && levels[top].size > SKY_BAKE_SPECULAR_SIZE)
+		top++;
+
+	out->specular.resize(SKY_BAKE_SPECULAR_MIPS);
+	out->specular[0] = levels[top];
+	for (unsigned int m = 1; m < SKY_BAKE_SPECULAR_MIPS; m++)
+	{
+		SkyCube& mip = out->specular[m];
+		mip.size = (std::max)(levels[top].size >> m, 1u);
+		mip.texels.resize((size_t)6 * mip.size * mip.size * 3);
+	}
+
+	// One job per row of every face of every level
+	struct Row
+	{
+		unsigned int mip;
+		unsigned int face;
+		unsigned int y;
+	};
+	std::vector<Row> rows;
+	for (unsigned int m = 1; m < SKY_BAKE_SPECULAR_MIPS; m++)
+		for (unsigned int face = 0; face < 6; face++)
+			for (unsigned int y = 0; y < out->specular[m].size; y++)
+				rows.push_back(Row{ m, face, y });
+
+	std::atomic<size_t> next(0);
+	auto work = [&]()
+	{
+		for (size_t i = next++; i < rows.size(); i = next++)
+		{
+			const Row& row = rows[i];
+			SkyCube& mip = out->specular[row.mip];
+			float roughness = SkySpecularRoughness(row.mip);
+			for (unsigned int x = 0; x < mip.size; x++)
+			{
+				float dir[3];
+				SkyCubeDirection(row.face, (x + 0.5f) * 2.0f / mip.size - 1.0f, (row.y + 0.5f) * 2.0f / mip.size - 1.0f, dir);
+				PrefilterSkyDirection(levels, dir, roughness, SKY_BAKE_SAMPLES, mip.Texel(row.face, x, row.y));
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned int t = 1; t < threadCount; t++)
+		threads.push_back(std::thread(work));
+	work();
+	for (auto& thread : threads)
+		thread.join();
+}
+
+// --------------------------------------------------------
+// Files
+// --------------------------------------------------------
+
+// Rounds to the nearest half, flushing tiny values to 0
+// and clamping huge ones, neither of which a sky has
+static unsigned short FloatToHalf(float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, 4);
+
+	unsigned int sign = (bits >> 16) & 0x8000;
+	int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+	unsigned int mantissa = bits & 0x7FFFFF;
+
+	if (exponent <= 0)
+		return (unsigned short)sign;
+	if (exponent >= 31)
+		return (unsigned short)(sign | 0x7BFF);
+
+	unsigned int half = sign | (exponent << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000)
+		half++;
+	return (unsigned short)half;
+}
+
+void PackSkySpecular(const SkyBakeResult& bake, std::vector<unsigned char>& data)
+{
+	data.clear();
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		for (auto& mip : bake.specular)
+		{
+			for (unsigned int y = 0; y < mip.size; y++)
+			{
+				for (unsigned int x = 0; x < mip.size; x++)
+				{
+					const float* texel = mip.Texel(face, x, y);
+					unsigned short halves[4] = { FloatToHalf(texel[0]), FloatToHalf(texel[1]), FloatToHalf(texel[2]), FloatToHalf(1.0f) };
+					const unsigned char* bytes = (const unsigned char*)halves;
+					data.insert(data.end(), bytes, bytes + sizeof(halves));
+				}
+			}
+		}
+	}
+}
+
+void WriteSkySpecular(const SkyBakeResult& bake, std::vector<unsigned char>& file)
+{
+	std::vector<unsigned char> data;
+	PackSkySpecular(bake, data);
+	WriteCookedCubemap(bake.specular[0].size, (unsigned int)bake.specular.size(), COOKED_FORMAT_RGBA16F, data, file);
+}
+
+std::string WriteSkyIrradiance(const SkyBakeResult& bake)
+{
+	std::string text = "// Sky irradiance, nine SH coefficients as r g b\n";
+	text += "version " + std::to_string(SKY_BAKE_VERSION) + "\n";
+	for (int i = 0; i < 9; i++)
+	{
+		char line[128];
+		snprintf(line, sizeof(line), "%.9g %.9g %.9g\n", bake.irradiance[i][0], bake.irradiance[i][1], bake.irradiance[i][2]);
+		text += line;
+	}
+	return text;
+}
+
+bool ReadSkyIrradiance(const std::string& text, float sh[9][3])
+{
+	std::istringstream stream(text);
+	std::string line;
+	int coefficient = -1;
+	while (std::getline(stream, line) && coefficient < 9)
+	{
+		if (line.empty() || line.compare(0, 2, "//") == 0)
+			continue;
+
+		std::istringstream values(line);
+		if (coefficient < 0)
+		{
+			// An older bake is as good as none
+			std::string word;
+			int version = 0;
+			if (!(values >> word >> version) || word != "version" || version != SKY_BAKE_VERSION)
+				return false;
+		}
+		else if (!(values >> sh[coefficient][0] >> sh[coefficient][1] >> sh[coefficient][2]))
+		{
+			return false;
+		}
+		coefficient++;
+	}
+	return coefficient == 9;
+}
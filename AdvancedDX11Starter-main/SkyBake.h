@@ -0,0 +1,122 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Bake the lighting a sky gives off from its six
+//			faces: nine spherical harmonics for the diffuse
+//			part and a cube whose mips are prefiltered for
+//			rising roughness for the specular part. Nothing
+//			in here touches Direct3D so it can be checked
+//			off the engine.
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+// Faces are shrunk to this before anything is sampled
+#define SKY_BAKE_SOURCE_SIZE 256
+
+// Top of the prefiltered cube and how many levels it has,
+// roughness going from 0 at the top to 1 at the last
+#define SKY_BAKE_SPECULAR_SIZE 128
+#define SKY_BAKE_SPECULAR_MIPS 6
+
+// GGX samples per prefiltered texel. Fewer leave visible
+// noise around small bright spots like the moon
+#define SKY_BAKE_SAMPLES 1024
+
+// Face size the harmonics are projected from
+#define SKY_BAKE_SH_SIZE 64
+
+// Bumped whenever the above changes so old caches rebake
+#define SKY_BAKE_VERSION 1
+
+/// <summary>
+/// A cube of linear RGB floats, faces in the order
+/// +X -X +Y -Y +Z -Z like Direct3D
+/// </summary>
+struct SkyCube
+{
+	unsigned int size;
+	std::vector<float> texels;
+
+	float* Texel(unsigned int face, unsigned int x, unsigned int y)
+	{
+		return &texels[(((size_t)face * size + y) * size + x) * 3];
+	}
+	const float* Texel(unsigned int face, unsigned int x, unsigned int y) const
+	{
+		return &texels[(((size_t)face * size + y) * size + x) * 3];
+	}
+};
+
+/// <summary>
+/// Everything the shaders need from a sky
+/// </summary>
+struct SkyBakeResult
+{
+	// Already convolved with the cosine lobe and divided by
+	// pi, so evaluating them gives the diffuse light itself
+	float irradiance[9][3];
+
+	// One cube per roughness step, largest first
+	std::vector<SkyCube> specular;
+};
+
+// Direction through a face, u and v from -1 to 1 with v down
+void SkyCubeDirection(unsigned int face, float u, float v, float dir[3]);
+
+// Solid angle a texel covers on the unit sphere
+float SkyTexelSolidAngle(unsigned int size, unsigned int x, unsigned int y);
+
+/// <summary>
+/// Turns six gamma encoded RGBA8 faces into a linear cube no
+/// larger than the given size, box filtering on the way down
+/// </summary>
+void SkyCubeFromFaces(
+	const unsigned char* const faces[6],
+	unsigned int faceSize,
+	unsigned int size,
+	SkyCube* out);
+
+// Half the size, averaging 2x2 texels
+void DownsampleSkyCube(const SkyCube& cube, SkyCube* out);
+
+// Bilinear within the face the direction points into
+void SampleSkyCube(const SkyCube& cube, const float dir[3], float out[3]);
+
+// Projects a cube onto the first nine harmonics and applies
+// the cosine convolution
+void ProjectIrradianceSH9(const SkyCube& cube, float sh[9][3]);
+void EvaluateIrradianceSH9(const float sh[9][3], const float dir[3], float out[3]);
+
+// Roughness a prefiltered level is made for
+float SkySpecularRoughness(unsigned int level);
+
+/// <summary>
+/// Prefilters one direction of the sky for a GGX lobe of the
+/// given roughness, with the view along the normal. Samples
+/// read from smaller levels as the lobe widens so few of them
+/// are needed. Levels starts at the largest
+/// </summary>
+void PrefilterSkyDirection(
+	const std::vector<SkyCube>& levels,
+	const float dir[3],
+	float roughness,
+	unsigned int sampleCount,
+	float out[3]);
+
+/// <summary>
+/// Bakes both parts, spreading the work over the given
+/// number of threads
+/// </summary>
+void BakeSkyLighting(const SkyCube& source, unsigned int threadCount, SkyBakeResult* out);
+
+// The prefiltered cube as half floats in the cooked .dds
+// container, and the harmonics as a small text file
+void WriteSkySpecular(const SkyBakeResult& bake, std::vector<unsigned char>& file);
+std::string WriteSkyIrradiance(const SkyBakeResult& bake);
+bool ReadSkyIrradiance(const std::string& text, float sh[9][3]);
+
+// Texels of every level of every face as half floats, laid
+// out like the .dds file
+void PackSkySpecular(const SkyBakeResult& bake, std::vector<unsigned char>& data);
@@ -0,0 +1,669 @@
+#include "SpatialQuery.h"
+
+#include <xmmintrin.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+// --------------------------------------------------------
+// Shared by the tree and the brute force check, so both
+// agree on exactly what counts as touching
+// --------------------------------------------------------
+
+/// <summary>
+/// Whether a query touches a sphere, and how far away.
+/// Rays and sweeps give the distance along the direction
+/// where they first touch, cones the distance from the
+/// origin to the sphere's surface
+/// </summary>
+static bool TouchesSphere(const SpatialQuery& query, const float center[3], float radius, float sinAngle, float* distance)
+{
+	const float* o = query.origin;
+	const float* d = query.direction;
+
+	if (query.shape == QueryShape::Cone)
+	{
+		float vx = center[0] - o[0];
+		float vy = center[1] - o[1];
+		float vz = center[2] - o[2];
+		float along = vx * d[0] + vy * d[1] + vz * d[2];
+		float lengthSq = vx * vx + vy * vy + vz * vz;
+		float perp = sqrtf((std::max)(lengthSq - along * along, 0.0f));
+
+		// How far the center is outside the cone's side
+		if (along < -radius || perp * query.coneCosine - along * sinAngle > radius)
+			return false;
+
+		*distance = (std::max)(sqrtf(lengthSq) - radius, 0.0f);
+		return *distance <= query.maxDistance;
+	}
+
+	float grown = radius + (query.shape == QueryShape::SphereSweep ? query.radius : 0.0f);
+	float mx = o[0] - center[0];
+	float my = o[1] - center[1];
+	float mz = o[2] - center[2];
+	float b = mx * d[0] + my * d[1] + mz * d[2];
+	float c = mx * mx + my * my + mz * mz - grown * grown;
+	float discriminant = b * b - c;
+	if ((c > 0.0f && b > 0.0f) || discriminant < 0.0f)
+		return false;
+
+	*distance = (std::max)(-b - sqrtf((std::max)(discriminant, 0.0f)), 0.0f);
+	return *distance <= query.maxDistance;
+}
+
+/// <summary>
+/// Fills in where a query touched a sphere
+/// </summary>
+static void MakeHit(const SpatialQuery& query, const float center[3], float radius, float distance, EntityId id, QueryHit* hit)
+{
+	// Where the query was when it touched
+	float at[3];
+	for (int c = 0; c < 3; c++)
+	{
+		at[c] = query.origin[c];
+		if (query.shape != QueryShape::Cone)
+			at[c] += query.direction[c] * distance;
+	}
+
+	float n[3] = { at[0] - center[0], at[1] - center[1], at[2] - center[2] };
+	float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+	for (int c = 0; c < 3; c++)
+	{
+		hit->normal[c] = length > 1e-6f ? n[c] / length : -query.direction[c];
+		hit->point[c] = center[c] + hit->normal[c] * radius;
+	}
+
+	hit->entity = id;
+	hit->distance = distance;
+	hit->level = false;
+}
+
+/// <summary>
+/// Keeps the nearest maxHits hits sorted, dropping the
+/// furthest when full
+/// </summary>
+static void InsertHit(QueryHit* hits, unsigned int* count, unsigned int maxHits, const QueryHit& hit)
+{
+	unsigned int i = *count;
+	if (i == maxHits)
+	{
+		if (hit.distance >= hits[maxHits - 1].distance)
+			return;
+		i--;
+	}
+	else
+	{
+		(*count)++;
+	}
+
+	for (; i > 0 && hits[i - 1].distance > hit.distance; i--)
+		hits[i] = hits[i - 1];
+	hits[i] = hit;
+}
+
+// Spreads ten bits out to every third bit, for Morton codes
+static unsigned int SpreadBits(unsigned int v)
+{
+	v &= 0x3ff;
+	v = (v | (v << 16)) & 0x030000ff;
+	v = (v | (v << 8)) & 0x0300f00f;
+	v = (v | (v << 4)) & 0x030c30c3;
+	v = (v | (v << 2)) & 0x09249249;
+	return v;
+}
+
+// --------------------------------------------------------
+// Batch
+// --------------------------------------------------------
+
+QueryBatch::QueryBatch()
+{
+}
+
+void QueryBatch::Clear()
+{
+	queries.clear();
+	ranges.clear();
+	hits.clear();
+}
+
+unsigned int QueryBatch::Add(const SpatialQuery& query)
+{
+	Range range;
+	range.first = (unsigned int)hits.size();
+	range.count = 0;
+
+	queries.push_back(query);
+	ranges.push_back(range);
+	hits.resize(hits.size() + (std::min)(query.maxHits, (unsigned int)QUERY_MAX_HITS));
+	return (unsigned int)queries.size() - 1;
+}
+
+Span<const QueryHit> QueryBatch::GetHits(unsigned int index) const
+{
+	return Span<const QueryHit>(hits.data() + ranges[index].first, ranges[index].count);
+}
+
+// --------------------------------------------------------
+// Index
+// --------------------------------------------------------
+
+SpatialIndex::SpatialIndex() :
+	level(nullptr),
+	root(-1),
+	entityCount(0),
+	largestRadius(0),
+	buildMS(0)
+{
+}
+
+/// <summary>
+/// Sorts the spheres along a Morton curve so each leaf gets
+/// four that are close together, then groups four children
+/// under a node, level by level, until one is left
+/// </summary>
+void SpatialIndex::Rebuild(EntityStore* store)
+{
+	auto buildStart = std::chrono::high_resolution_clock::now();
+
+	entries.clear();
+	leaves.clear();
+	nodes.clear();
+	root = -1;
+	largestRadius = 0.0f;
+
+	float lo[3] = { 1e30f, 1e30f, 1e30f };
+	float hi[3] = { -1e30f, -1e30f, -1e30f };
+	store->ForEachChunk(COMPONENT_BIT(BoundsComponent), [&](EntityChunk& chunk)
+	{
+		BoundsComponent* bounds = chunk.Get<BoundsComponent>();
+		for (unsigned int i = 0; i < chunk.count; i++)
+		{
+			const BoundsComponent& b = bounds[i];
+			if (b.queryLayers == 0)
+				continue;
+
+			Entry entry = {};
+			for (int c = 0; c < 3; c++)
+			{
+				entry.center[c] = b.center[c];
+				lo[c] = (std::min)(lo[c], b.center[c]);
+				hi[c] = (std::max)(hi[c], b.center[c]);
+			}
+			entry.radius = b.radius;
+			entry.layers = b.queryLayers;
+			entry.id = chunk.ids[i];
+			entries.push_back(entry);
+			largestRadius = (std::max)(largestRadius, b.radius);
+		}
+	});
+	entityCount = (unsigned int)entries.size();
+
+	if (!entries.empty())
+	{
+		// One scale for every axis, or a flat level would be
+		// sorted mostly by height
+		float extent = (std::max)(hi[0] - lo[0], (std::max)(hi[1] - lo[1], hi[2] - lo[2]));
+		float scale = extent > 0.0f ? 1023.0f / extent : 0.0f;
+		for (Entry& entry : entries)
+		{
+			entry.key =
+				SpreadBits((unsigned int)((entry.center[0] - lo[0]) * scale)) |
+				SpreadBits((unsigned int)((entry.center[1] - lo[1]) * scale)) << 1 |
+				SpreadBits((unsigned int)((entry.center[2] - lo[2]) * scale)) << 2;
+		}
+		std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.key < b.key; });
+
+		levelChildren.clear();
+		levelBounds.clear();
+		for (size_t i = 0; i < entries.size(); i += 4)
+		{
+			Leaf leaf = {};
+			leaf.count = (unsigned int)(std::min)((size_t)4, entries.size() - i);
+
+			float box[6] = { 1e30f, 1e30f, 1e30f, -1e30f, -1e30f, -1e30f };
+			for (unsigned int lane = 0; lane < leaf.count; lane++)
+			{
+				const Entry& entry = entries[i + lane];
+				leaf.x[lane] = entry.center[0];
+				leaf.y[lane] = entry.center[1];
+				leaf.z[lane] = entry.center[2];
+				leaf.radius[lane] = entry.radius;
+				leaf.layers[lane] = entry.layers;
+				leaf.ids[lane] = entry.id;
+				for (int c = 0; c < 3; c++)
+				{
+					box[c] = (std::min)(box[c], entry.center[c] - entry.radius);
+					box[3 + c] = (std::max)(box[3 + c], entry.center[c] + entry.radius);
+				}
+			}
+
+			leaves.push_back(leaf);
+			levelChildren.push_back(~(int)(leaves.size() - 1));
+			levelBounds.insert(levelBounds.end(), box, box + 6);
+		}
+
+		// Each node is written over the first of the children
+		// it was made from, which has already been read
+		do
+		{
+			size_t childCount = levelChildren.size();
+			size_t next = 0;
+			for (size_t i = 0; i < childCount; i += 4)
+			{
+				Node node = {};
+				node.count = (unsigned int)(std::min)((size_t)4, childCount - i);
+
+				float box[6] = { 1e30f, 1e30f, 1e30f, -1e30f, -1e30f, -1e30f };
+				for (unsigned int lane = 0; lane < node.count; lane++)
+				{
+					const float* child = &levelBounds[(i + lane) * 6];
+					node.minX[lane] = child[0];
+					node.minY[lane] = child[1];
+					node.minZ[lane] = child[2];
+					node.maxX[lane] = child[3];
+					node.maxY[lane] = child[4];
+					node.maxZ[lane] = child[5];
+					node.children[lane] = levelChildren[i + lane];
+					for (int c = 0; c < 3; c++)
+					{
+						box[c] = (std::min)(box[c], child[c]);
+						box[3 + c] = (std::max)(box[3 + c], child[3 + c]);
+					}
+				}
+
+				nodes.push_back(node);
+				levelChildren[next] = (int)nodes.size() - 1;
+				std::copy(box, box + 6, &levelBounds[next * 6]);
+				next++;
+			}
+			levelChildren.resize(next);
+			levelBounds.resize(next * 6);
+		} while (levelChildren.size() > 1);
+
+		root = levelChildren[0];
+	}
+
+	buildMS = std::chrono::duration<float, std::milli>(
+		std::chrono::high_resolution_clock::now() - buildStart).count();
+}
+
+void SpatialIndex::Run(QueryBatch* batch) const
+{
+	RunRange(batch, 0, batch->GetQueryCount());
+}
+
+unsigned int SpatialIndex::AddJobs(RenderJobGraph* graph, QueryBatch* batch, unsigned int jobCount) const
+{
+	jobCount = (std::max)(1u, (std::min)(jobCount, (unsigned int)SPATIAL_QUERY_MAX_JOBS));
+	unsigned int queryCount = batch->GetQueryCount();
+
+	unsigned int jobs[SPATIAL_QUERY_MAX_JOBS];
+	for (unsigned int j = 0; j < jobCount; j++)
+	{
+		unsigned int first = queryCount * j / jobCount;
+		unsigned int end = queryCount * (j + 1) / jobCount;
+		jobs[j] = graph->AddJob("Spatial Queries", [this, batch, first, end](unsigned int) { RunRange(batch, first, end); });
+	}
+	return graph->AddJob("Finish Spatial Queries", [](unsigned int) {}, Span<const unsigned int>(jobs, jobCount));
+}
+
+void SpatialIndex::RunRange(QueryBatch* batch, unsigned int first, unsigned int end) const
+{
+	for (unsigned int q = first; q < end; q++)
+	{
+		QueryBatch::Range& range = batch->ranges[q];
+		range.count = Answer(batch->queries[q], batch->hits.data() + range.first);
+	}
+}
+
+/// <summary>
+/// Rays and sweeps meet the level first, since nothing behind
+/// the first wall can be hit. Nodes are then tested four boxes
+/// at a time, grown by how far the query reaches to the side,
+/// and leaves four spheres at a time. Cones can't stop at a
+/// wall, so each entity they touch is checked for a clear line
+/// from the origin instead, and the level itself is never one
+/// of their hits
+/// </summary>
+unsigned int SpatialIndex::Answer(const SpatialQuery& query, QueryHit* hits) const
+{
+	unsigned int maxHits = (std::min)(query.maxHits, (unsigned int)QUERY_MAX_HITS);
+	if (maxHits == 0)
+		return 0;
+
+	unsigned int count = 0;
+	bool cone = query.shape == QueryShape::Cone;
+	bool sweep = query.shape == QueryShape::SphereSweep;
+	bool testLevel = level && (query.flags & QUERY_LEVEL);
+	float limit = query.maxDistance;
+
+	QueryHit levelHit = {};
+	bool hitLevel = false;
+	if (testLevel && !cone)
+	{
+		LevelHit hit;
+		if (level->CastSphere(query.origin, query.direction, sweep ? query.radius : 0.0f, limit, &hit))
+		{
+			limit = hit.distance;
+			levelHit.entity = hit.owner;
+			levelHit.distance = hit.distance;
+			std::copy(hit.point, hit.point + 3, levelHit.point);
+			std::copy(hit.normal, hit.normal + 3, levelHit.normal);
+			levelHit.level = true;
+			hitLevel = true;
+		}
+	}
+
+	if ((query.flags & QUERY_ENTITIES) && root >= 0)
+	{
+		// How far past the center line a node's box can be and
+		// still hold something the query touches
+		float sinAngle = 0.0f;
+		float pad = sweep ? query.radius : 0.0f;
+		if (cone)
+		{
+			float cosAngle = (std::max)(query.coneCosine, 0.01f);
+			sinAngle = sqrtf(1.0f - cosAngle * cosAngle);
+			pad = query.maxDistance * sinAngle / cosAngle + largestRadius * (2.0f + sinAngle) / cosAngle;
+		}
+
+		const float* o = query.origin;
+		const float* d = query.direction;
+		float inverse[3];
+		for (int c = 0; c < 3; c++)
+			inverse[c] = fabsf(d[c]) > 1e-12f ? 1.0f / d[c] : (d[c] >= 0.0f ? 1e30f : -1e30f);
+
+		__m128 zero = _mm_setzero_ps();
+		__m128 ox = _mm_set1_ps(o[0]);
+		__m128 oy = _mm_set1_ps(o[1]);
+		__m128 oz = _mm_set1_ps(o[2]);
+		__m128 dx = _mm_set1_ps(d[0]);
+		__m128 dy = _mm_set1_ps(d[1]);
+		__m128 dz = _mm_set1_ps(d[2]);
+		__m128 ix = _mm_set1_ps(inverse[0]);
+		__m128 iy = _mm_set1_ps(inverse[1]);
+		__m128 iz = _mm_set1_ps(inverse[2]);
+		__m128 pad4 = _mm_set1_ps(pad);
+		__m128 sweep4 = _mm_set1_ps(sweep ? query.radius : 0.0f);
+		__m128 cos4 = _mm_set1_ps(query.coneCosine);
+		__m128 sin4 = _mm_set1_ps(sinAngle);
+		__m128 reach4 = _mm_set1_ps(query.maxDistance);
+
+		// Children are pushed furthest first so the nearest are
+		// looked at first, and the hits fill up with near ones
+		// that rule out the rest early
+		struct Visit
+		{
+			int ref;
+			float tMin;
+		};
+		Visit stack[256];
+		unsigned int stackSize = 0;
+		stack[stackSize].ref = root;
+		stack[stackSize++].tMin = 0.0f;
+		while (stackSize > 0)
+		{
+			Visit visit = stack[--stackSize];
+			int ref = visit.ref;
+
+			// Once full, only something nearer than the furthest
+			// hit kept is worth finding. Cones measure distance
+			// differently from the boxes so can't skip by it
+			float cutoff = count == maxHits ? hits[maxHits - 1].distance : limit;
+			if (!cone && visit.tMin > cutoff)
+				continue;
+
+			if (ref >= 0)
+			{
+				const Node& node = nodes[ref];
+				__m128 cap = _mm_set1_ps(cone ? query.maxDistance : cutoff);
+				__m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(node.minX), pad4), ox), ix);
+				__m128 tx2 = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_loadu_ps(node.maxX), pad4), ox), ix);
+				__m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(node.minY), pad4), oy), iy);
+				__m128 ty2 = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_loadu_ps(node.maxY), pad4), oy), iy);
+				__m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(node.minZ), pad4), oz), iz);
+				__m128 tz2 = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_loadu_ps(node.maxZ), pad4), oz), iz);
+				__m128 tMin = _mm_max_ps(
+					_mm_max_ps(_mm_min_ps(tx1, tx2), _mm_min_ps(ty1, ty2)),
+					_mm_max_ps(_mm_min_ps(tz1, tz2), zero));
+				__m128 tMax = _mm_min_ps(
+					_mm_min_ps(_mm_max_ps(tx1, tx2), _mm_max_ps(ty1, ty2)),
+					_mm_min_ps(_mm_max_ps(tz1, tz2), cap));
+
+				int mask = _mm_movemask_ps(_mm_cmple_ps(tMin, tMax)) & ((1 << node.count) - 1);
+				float entries[4];
+				_mm_storeu_ps(entries, tMin);
+
+				Visit children[4];
+				unsigned int childCount = 0;
+				for (unsigned int lane = 0; lane < 4; lane++)
+				{
+					if (!(mask & (1 << lane)))
+						continue;
+
+					// Insertion sort, furthest first
+					unsigned int i = childCount++;
+					for (; i > 0 && children[i - 1].tMin < entries[lane]; i--)
+						children[i] = children[i - 1];
+					children[i].ref = node.children[lane];
+					children[i].tMin = entries[lane];
+				}
+				for (unsigned int i = 0; i < childCount && stackSize < 256; i++)
+					stack[stackSize++] = children[i];
+				continue;
+			}
+
+			const Leaf& leaf = leaves[~ref];
+			__m128 cx = _mm_loadu_ps(leaf.x);
+			__m128 cy = _mm_loadu_ps(leaf.y);
+			__m128 cz = _mm_loadu_ps(leaf.z);
+			__m128 radius = _mm_loadu_ps(leaf.radius);
+
+			__m128 touching;
+			__m128 distance;
+			if (cone)
+			{
+				__m128 vx = _mm_sub_ps(cx, ox);
+				__m128 vy = _mm_sub_ps(cy, oy);
+				__m128 vz = _mm_sub_ps(cz, oz);
+				__m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, dx), _mm_mul_ps(vy, dy)), _mm_mul_ps(vz, dz));
+				__m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+				__m128 perp = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(lengthSq, _mm_mul_ps(along, along)), zero));
+				__m128 outside = _mm_or_ps(
+					_mm_cmplt_ps(along, _mm_sub_ps(zero, radius)),
+					_mm_cmpgt_ps(_mm_sub_ps(_mm_mul_ps(perp, cos4), _mm_mul_ps(along, sin4)), radius));
+				distance = _mm_max_ps(_mm_sub_ps(_mm_sqrt_ps(lengthSq), radius), zero);
+				touching = _mm_andnot_ps(outside, _mm_cmple_ps(distance, reach4));
+			}
+			else
+			{
+				__m128 grown = _mm_add_ps(radius, sweep4);
+				__m128 mx = _mm_sub_ps(ox, cx);
+				__m128 my = _mm_sub_ps(oy, cy);
+				__m128 mz = _mm_sub_ps(oz, cz);
+				__m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(mx, dx), _mm_mul_ps(my, dy)), _mm_mul_ps(mz, dz));
+				__m128 c = _mm_sub_ps(
+					_mm_add_ps(_mm_add_ps(_mm_mul_ps(mx, mx), _mm_mul_ps(my, my)), _mm_mul_ps(mz, mz)),
+					_mm_mul_ps(grown, grown));
+				__m128 discriminant = _mm_sub_ps(_mm_mul_ps(b, b), c);
+				__m128 miss = _mm_or_ps(
+					_mm_and_ps(_mm_cmpgt_ps(c, zero), _mm_cmpgt_ps(b, zero)),
+					_mm_cmplt_ps(discriminant, zero));
+				distance = _mm_max_ps(
+					_mm_sub_ps(_mm_sub_ps(zero, b), _mm_sqrt_ps(_mm_max_ps(discriminant, zero))),
+					zero);
+				touching = _mm_andnot_ps(miss, _mm_cmple_ps(distance, reach4));
+			}
+
+			int mask = _mm_movemask_ps(_mm_and_ps(touching, _mm_cmple_ps(distance, _mm_set1_ps(cutoff)))) &
+				((1 << leaf.count) - 1);
+			if (mask == 0)
+				continue;
+
+			float distances[4];
+			_mm_storeu_ps(distances, distance);
+			for (unsigned int lane = 0; lane < 4; lane++)
+			{
+				if (!(mask & (1 << lane)) || !(leaf.layers[lane] & query.layers) || leaf.ids[lane] == query.ignore)
+					continue;
+
+				float center[3] = { leaf.x[lane], leaf.y[lane], leaf.z[lane] };
+				if (cone && testLevel)
+				{
+					float toCenter[3] = { center[0] - o[0], center[1] - o[1], center[2] - o[2] };
+					float length = sqrtf(toCenter[0] * toCenter[0] + toCenter[1] * toCenter[1] + toCenter[2] * toCenter[2]);
+					float clear = length - leaf.radius[lane];
+					LevelHit blocked;
+					if (clear > 0.0f)
+					{
+						for (int c = 0; c < 3; c++)
+							toCenter[c] /= length;
+						if (level->CastSphere(o, toCenter, 0.0f, clear, &blocked))
+							continue;
+					}
+				}
+
+				QueryHit hit;
+				MakeHit(query, center, leaf.radius[lane], distances[lane], leaf.ids[lane], &hit);
+				InsertHit(hits, &count, maxHits, hit);
+			}
+		}
+	}
+
+	if (hitLevel)
+		InsertHit(hits, &count, maxHits, levelHit);
+	return count;
+}
+
+// --------------------------------------------------------
+// Benchmark
+// --------------------------------------------------------
+
+SpatialQueryBenchmark BenchmarkSpatialQueries(
+	unsigned int entityCount,
+	unsigned int queryCount,
+	unsigned int workerCount)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const unsigned int passes = 8;
+	const unsigned int maxHits = 8;
+
+	SpatialQueryBenchmark result = {};
+	result.entityCount = entityCount;
+	result.queryCount = queryCount;
+	result.workerCount = workerCount;
+
+	// About one entity every four square meters, up to a
+	// couple of meters off the ground
+	std::mt19937 random(44);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	float side = sqrtf((float)entityCount) * 2.0f;
+
+	EntityStore store;
+	EntityDesc desc = {};
+	desc.mask = COMPONENT_BIT(BoundsComponent);
+	desc.bounds.queryLayers = ENTITY_LAYER_DEFAULT;
+	for (unsigned int i = 0; i < entityCount; i++)
+	{
+		desc.bounds.center[0] = (unit(random) - 0.5f) * side;
+		desc.bounds.center[1] = unit(random) * 2.0f;
+		desc.bounds.center[2] = (unit(random) - 0.5f) * side;
+		desc.bounds.radius = 0.25f + unit(random) * 0.75f;
+		store.Create(desc);
+	}
+	store.ApplyChanges();
+
+	SpatialIndex index;
+	index.Rebuild(&store);
+	result.buildMS = index.GetBuildMS();
+
+	// Players standing among them, aiming roughly level
+	QueryBatch batch;
+	for (unsigned int q = 0; q < queryCount; q++)
+	{
+		SpatialQuery query = {};
+		query.shape = (QueryShape)(q % 3);
+		query.origin[0] = (unit(random) - 0.5f) * side;
+		query.origin[1] = 1.5f;
+		query.origin[2] = (unit(random) - 0.5f) * side;
+
+		float yaw = unit(random) * 6.2831853f;
+		float pitch = (unit(random) - 0.5f) * 0.5f;
+		query.direction[0] = cosf(pitch) * sinf(yaw);
+		query.direction[1] = sinf(pitch);
+		query.direction[2] = cosf(pitch) * cosf(yaw);
+
+		switch (query.shape)
+		{
+		case QueryShape::Ray: query.maxDistance = 50.0f; break;
+		case QueryShape::SphereSweep: query.maxDistance = 30.0f; query.radius = 0.3f; break;
+		case QueryShape::Cone: query.maxDistance = 3.0f; query.coneCosine = cosf(3.1415927f / 6.0f); break;
+		}
+		query.flags = QUERY_ENTITIES;
+		query.layers = ENTITY_LAYER_DEFAULT;
+		query.maxHits = maxHits;
+		batch.Add(query);
+	}
+
+	// Every query against every sphere
+	std::vector<QueryHit> bruteHits(queryCount * maxHits);
+	std::vector<unsigned int> bruteCounts(queryCount);
+	auto start = Clock::now();
+	for (unsigned int q = 0; q < queryCount; q++)
+	{
+		const SpatialQuery& query = batch.GetQuery(q);
+		float sinAngle = sqrtf(1.0f - query.coneCosine * query.coneCosine);
+		QueryHit* hits = &bruteHits[q * maxHits];
+		unsigned int count = 0;
+		store.ForEachChunk(COMPONENT_BIT(BoundsComponent), [&](EntityChunk& chunk)
+		{
+			BoundsComponent* bounds = chunk.Get<BoundsComponent>();
+			for (unsigned int i = 0; i < chunk.count; i++)
+			{
+				float distance;
+				if (!TouchesSphere(query, bounds[i].center, bounds[i].radius, sinAngle, &distance))
+					continue;
+				if (count == maxHits && distance >= hits[maxHits - 1].distance)
+					continue;
+
+				QueryHit hit;
+				MakeHit(query, bounds[i].center, bounds[i].radius, distance, chunk.ids[i], &hit);
+				InsertHit(hits, &count, maxHits, hit);
+			}
+		});
+		bruteCounts[q] = count;
+	}
+	result.bruteForceMS = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+
+	start = Clock::now();
+	for (unsigned int p = 0; p < passes; p++)
+		index.Run(&batch);
+	result.serialMS = std::chrono::duration<float, std::milli>(Clock::now() - start).count() / passes;
+
+	// Same hits at the same distances. Ties may come back in
+	// either order so only distances are compared
+	for (unsigned int q = 0; q < queryCount; q++)
+	{
+		Span<const QueryHit> hits = batch.GetHits(q);
+		bool same = hits.size() == bruteCounts[q];
+		for (unsigned int h = 0; same && h < hits.size(); h++)
+			same = fabsf(hits[h].distance - bruteHits[q * maxHits + h].distance) < 1e-4f;
+		if (!same)
+			result.mismatches++;
+	}
+
+	RenderJobGraph graph(workerCount);
+	start = Clock::now();
+	for (unsigned int p = 0; p < passes; p++)
+	{
+		graph.Reset();
+		index.AddJobs(&graph, &batch, workerCount + 1);
+		graph.Run(true);
+	}
+	result.parallelMS = std::chrono::duration<float, std::milli>(Clock::now() - start).count() / passes;
+	result.queriesPerMS = result.parallelMS > 0.0f ? queryCount / result.parallelMS : 0.0f;
+	return result;
+}
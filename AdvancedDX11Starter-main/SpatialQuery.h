@@ -0,0 +1,215 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Answer what a sword swing or a wand shot hits.
+//			Rays, sphere sweeps and cones are tested against
+//			entity bounding spheres and the level's triangles,
+//			in batches holding every player's queries for a
+//			tick. Entity spheres are kept in a tree four wide,
+//			rebuilt once a tick, whose nodes and leaves are
+//			structure of arrays so a single SSE test covers
+//			all four children. Queries only read the tree, so
+//			a batch can be split across the job graph's
+//			workers.
+
+#include <vector>
+
+#include "EntityStore.h"
+#include "Collision.h"
+#include "FrameArena.h"
+#include "RenderJobGraph.h"
+
+// Most hits one query can return
+#define QUERY_MAX_HITS 32
+
+// Most jobs a batch is split into
+#define SPATIAL_QUERY_MAX_JOBS 64
+
+// What a query looks at
+#define QUERY_ENTITIES	(1u << 0)
+#define QUERY_LEVEL		(1u << 1)
+
+enum class QueryShape
+{
+	Ray,
+	SphereSweep,
+	Cone
+};
+
+/// <summary>
+/// One question about the scene. Entities count when their
+/// bounds' query layers share a bit with the query's
+/// </summary>
+struct SpatialQuery
+{
+	QueryShape shape;
+	float origin[3];
+	float direction[3];		// Normalized
+	float maxDistance;		// Length of the ray, sweep or cone
+	float radius;			// Sweeps only
+	float coneCosine;		// Cones only, the cosine of half the angle
+
+	unsigned int flags;		// QUERY_ENTITIES and or QUERY_LEVEL
+	unsigned int layers;
+	EntityId ignore;		// The one asking, say
+	unsigned int maxHits;	// The nearest are kept, at most QUERY_MAX_HITS
+};
+
+/// <summary>
+/// Something a query touched. For the level the entity is
+/// the one whose mesh the triangle came from
+/// </summary>
+struct QueryHit
+{
+	EntityId entity;
+	float distance;			// Along the direction, or from the origin for cones
+	float point[3];
+	float normal[3];		// Facing back towards the query
+	bool level;
+};
+
+/// <summary>
+/// A tick's queries and their answers. Every query has its
+/// own run of hit slots so queries can be answered in any
+/// order, on any thread
+/// </summary>
+class QueryBatch
+{
+public:
+	QueryBatch();
+
+	// Keeps memory for the next tick
+	void Clear();
+
+	// Returns the index the query's hits are found by
+	unsigned int Add(const SpatialQuery& query);
+
+	unsigned int GetQueryCount() const { return (unsigned int)queries.size(); }
+	const SpatialQuery& GetQuery(unsigned int index) const { return queries[index]; }
+
+	// Nearest first
+	Span<const QueryHit> GetHits(unsigned int index) const;
+
+private:
+	friend class SpatialIndex;
+
+	struct Range
+	{
+		unsigned int first;
+		unsigned int count;
+	};
+
+	std::vector<SpatialQuery> queries;
+	std::vector<Range> ranges;
+	std::vector<QueryHit> hits;
+};
+
+class SpatialIndex
+{
+public:
+	SpatialIndex();
+
+	// Collects every entity with bounds in a query layer and
+	// builds the tree over them. Queries see entities where
+	// they were when this last ran
+	void Rebuild(EntityStore* store);
+
+	// Level triangles to test, or null for none. Must outlive
+	// the index or be replaced
+	void SetLevel(const LevelCollision* level) { this->level = level; }
+
+	// Answers every query of a batch on the calling thread
+	void Run(QueryBatch* batch) const;
+
+	// Adds the batch to a job graph, split into jobCount even
+	// runs of queries (at most SPATIAL_QUERY_MAX_JOBS), and
+	// returns the index of a job waiting on all of them
+	unsigned int AddJobs(RenderJobGraph* graph, QueryBatch* batch, unsigned int jobCount) const;
+
+	unsigned int GetEntityCount() const { return entityCount; }
+	unsigned int GetNodeCount() const { return (unsigned int)nodes.size(); }
+	float GetBuildMS() const { return buildMS; }
+
+private:
+
+	// Four entity spheres, and which lanes are in use
+	struct Leaf
+	{
+		float x[4];
+		float y[4];
+		float z[4];
+		float radius[4];
+		unsigned int layers[4];
+		EntityId ids[4];
+		unsigned int count;
+	};
+
+	// Boxes around four children. A child is a node when it is
+	// at least zero and the leaf ~child otherwise
+	struct Node
+	{
+		float minX[4];
+		float minY[4];
+		float minZ[4];
+		float maxX[4];
+		float maxY[4];
+		float maxZ[4];
+		int children[4];
+		unsigned int count;
+	};
+
+	struct Entry
+	{
+		unsigned int key;		// Morton code of the center
+		float center[3];
+		float radius;
+		unsigned int layers;
+		EntityId id;
+	};
+
+	void RunRange(QueryBatch* batch, unsigned int first, unsigned int end) const;
+	unsigned int Answer(const SpatialQuery& query, QueryHit* hits) const;
+
+	const LevelCollision* level;
+	std::vector<Entry> entries;
+	std::vector<Leaf> leaves;
+	std::vector<Node> nodes;
+
+	// Children of the level of the tree being built, and
+	// their boxes, kept so rebuilds don't allocate
+	std::vector<int> levelChildren;
+	std::vector<float> levelBounds;
+
+	int root;
+	unsigned int entityCount;
+	float largestRadius;
+	float buildMS;
+};
+
+/// <summary>
+/// Times of one headless benchmark run
+/// </summary>
+struct SpatialQueryBenchmark
+{
+	unsigned int entityCount;
+	unsigned int queryCount;		// Per tick, a third of each shape
+	unsigned int workerCount;
+	float buildMS;
+	float bruteForceMS;				// Every query against every sphere, no SIMD
+	float serialMS;
+	float parallelMS;
+	float queriesPerMS;				// Through the workers
+	unsigned int mismatches;		// Queries whose hits differ from brute force
+};
+
+/// <summary>
+/// Scatters entities and asks queryCount random rays, sweeps
+/// and cones of players standing among them, first against
+/// every sphere one by one, then through the tree on the
+/// calling thread and across a graph of workers. Only entity
+/// bounds are tested so the answers can be checked
+/// </summary>
+SpatialQueryBenchmark BenchmarkSpatialQueries(
+	unsigned int entityCount,
+	unsigned int queryCount,
+	unsigned int workerCount);
@@ -0,0 +1,326 @@
+#include "StaticBatch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdlib.h>
+#include <string.h>
+
+StaticBatchSettings DefaultStaticBatchSettings()
+{
+	StaticBatchSettings settings;
+	settings.chunkSize = 32.0f;
+	settings.minInstances = 2;
+	settings.maxVertices = 1 << 20;
+	return settings;
+}
+
+namespace
+{
+	// Row vector times the matrix, with or without its
+	// translation
+	void TransformPoint(const float m[4][4], const float* v, float* out)
+	{
+		for (int j = 0; j < 3; j++)
+			out[j] = v[0] * m[0][j] + v[1] * m[1][j] + v[2] * m[2][j] + m[3][j];
+	}
+
+	void TransformDirection(const float m[4][4], const float* v, float* out)
+	{
+		for (int j = 0; j < 3; j++)
+			out[j] = v[0] * m[0][j] + v[1] * m[1][j] + v[2] * m[2][j];
+
+		float length = sqrtf(out[0] * out[0] + out[1] * out[1] + out[2] * out[2]);
+		if (length > 1e-12f)
+		{
+			for (int j = 0; j < 3; j++)
+				out[j] /= length;
+		}
+	}
+
+	// Mirroring transforms turn triangles inside out
+	bool Mirrors(const float m[4][4])
+	{
+		float det =
+			m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+			m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+			m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+		return det < 0.0f;
+	}
+
+	// Sphere around the middle of the positions' box, like a
+	// mesh's own bounds
+	void FitBounds(const std::vector<float>& vertices, float center[3], float* radius)
+	{
+		float low[3] = { 0, 0, 0 };
+		float high[3] = { 0, 0, 0 };
+		for (size_t v = 0; v < vertices.size(); v += BATCH_VERTEX_FLOATS)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				low[j] = v == 0 ? vertices[v + j] : (std::min)(low[j], vertices[v + j]);
+				high[j] = v == 0 ? vertices[v + j] : (std::max)(high[j], vertices[v + j]);
+			}
+		}
+
+		float radiusSq = 0.0f;
+		for (int j = 0; j < 3; j++)
+			center[j] = (low[j] + high[j]) * 0.5f;
+		for (size_t v = 0; v < vertices.size(); v += BATCH_VERTEX_FLOATS)
+		{
+			float dx = vertices[v] - center[0];
+			float dy = vertices[v + 1] - center[1];
+			float dz = vertices[v + 2] - center[2];
+			radiusSq = (std::max)(radiusSq, dx * dx + dy * dy + dz * dz);
+		}
+		*radius = sqrtf(radiusSq);
+	}
+
+	// Where an instance goes, sorted by key, then chunk, then
+	// the order instances were given in
+	struct Placement
+	{
+		unsigned int key;
+		int chunk[2];
+		unsigned int instance;
+
+		bool operator<(const Placement& other) const
+		{
+			if (key != other.key)
+				return key < other.key;
+			if (chunk[1] != other.chunk[1])
+				return chunk[1] < other.chunk[1];
+			if (chunk[0] != other.chunk[0])
+				return chunk[0] < other.chunk[0];
+			return instance < other.instance;
+		}
+
+		bool SameGroup(const Placement& other) const
+		{
+			return key == other.key && chunk[0] == other.chunk[0] && chunk[1] == other.chunk[1];
+		}
+	};
+}
+
+StaticBatches::StaticBatches() :
+	mergedCount(0),
+	buildMS(0.0f)
+{
+}
+
+void StaticBatches::Build(Span<const BatchSource> sources, Span<const BatchInstance> instances, const StaticBatchSettings& settings)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	batches.clear();
+	instanceBatches.assign(instances.size(), BATCH_NONE);
+	mergedCount = 0;
+
+	// Instances are placed by the middle of their source's box
+	std::vector<float> sourceCenters(sources.size() * 3, 0.0f);
+	for (size_t s = 0; s < sources.size(); s++)
+	{
+		Span<const float> vertices = sources[s].vertices;
+		float low[3] = { 0, 0, 0 };
+		float high[3] = { 0, 0, 0 };
+		for (size_t v = 0; v < vertices.size(); v += BATCH_VERTEX_FLOATS)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				low[j] = v == 0 ? vertices[v + j] : (std::min)(low[j], vertices[v + j]);
+				high[j] = v == 0 ? vertices[v + j] : (std::max)(high[j], vertices[v + j]);
+			}
+		}
+		for (int j = 0; j < 3; j++)
+			sourceCenters[s * 3 + j] = (low[j] + high[j]) * 0.5f;
+	}
+
+	std::vector<Placement> placements(instances.size());
+	for (unsigned int i = 0; i < instances.size(); i++)
+	{
+		float center[3];
+		TransformPoint(instances[i].world, &sourceCenters[instances[i].source * 3], center);
+		placements[i].key = instances[i].key;
+		placements[i].chunk[0] = (int)floorf(center[0] / settings.chunkSize);
+		placements[i].chunk[1] = (int)floorf(center[2] / settings.chunkSize);
+		placements[i].instance = i;
+	}
+	std::sort(placements.begin(), placements.end());
+
+	for (size_t first = 0; first < placements.size();)
+	{
+		size_t end = first + 1;
+		while (end < placements.size() && placements[end].SameGroup(placements[first]))
+			end++;
+
+		if (end - first < settings.minInstances)
+		{
+			first = end;
+			continue;
+		}
+
+		StaticBatch* batch = nullptr;
+		for (size_t p = first; p < end; p++)
+		{
+			unsigned int i = placements[p].instance;
+			const BatchInstance& instance = instances[i];
+			const BatchSource& source = sources[instance.source];
+			size_t vertexCount = source.vertices.size() / BATCH_VERTEX_FLOATS;
+
+			// Full batches carry on into another of the same chunk
+			if (!batch || (batch->vertices.size() / BATCH_VERTEX_FLOATS + vertexCount > settings.maxVertices && !batch->instances.empty()))
+			{
+				batches.push_back(StaticBatch());
+				batch = &batches.back();
+				batch->key = placements[p].key;
+				batch->chunk[0] = placements[p].chunk[0];
+				batch->chunk[1] = placements[p].chunk[1];
+			}
+
+			unsigned int base = (unsigned int)(batch->vertices.size() / BATCH_VERTEX_FLOATS);
+			batch->vertices.resize(batch->vertices.size() + source.vertices.size());
+			float* out = &batch->vertices[(size_t)base * BATCH_VERTEX_FLOATS];
+			for (size_t v = 0; v < vertexCount; v++)
+			{
+				const float* in = &source.vertices[v * BATCH_VERTEX_FLOATS];
+				TransformPoint(instance.world, in, out);
+				out[3] = in[3];
+				out[4] = in[4];
+				TransformDirection(instance.worldInvTrans, in + 5, out + 5);
+				TransformDirection(instance.world, in + 8, out + 8);
+				out += BATCH_VERTEX_FLOATS;
+			}
+
+			bool flip = Mirrors(instance.world);
+			for (size_t t = 0; t + 2 < source.indices.size(); t += 3)
+			{
+				batch->indices.push_back(base + source.indices[t]);
+				batch->indices.push_back(base + source.indices[t + (flip ? 2 : 1)]);
+				batch->indices.push_back(base + source.indices[t + (flip ? 1 : 2)]);
+			}
+
+			batch->instances.push_back(i);
+			instanceBatches[i] = (unsigned int)(batches.size() - 1);
+			mergedCount++;
+		}
+		first = end;
+	}
+
+	for (StaticBatch& batch : batches)
+		FitBounds(batch.vertices, batch.boundsCenter, &batch.boundsRadius);
+
+	buildMS = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+}
+
+// --------------------------------------------------------
+// Benchmark
+// --------------------------------------------------------
+
+StaticBatchBenchmark BenchmarkStaticBatching(unsigned int instanceCount, unsigned int keyCount)
+{
+	StaticBatchBenchmark result = {};
+	result.instanceCount = instanceCount;
+	result.keyCount = keyCount = (std::max)(1u, keyCount);
+
+	// A unit box, four corners a side so each side keeps its
+	// own normal
+	std::vector<float> boxVertices;
+	std::vector<unsigned int> boxIndices;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		for (int sign = -1; sign <= 1; sign += 2)
+		{
+			unsigned int base = (unsigned int)(boxVertices.size() / BATCH_VERTEX_FLOATS);
+			int u = (axis + 1) % 3;
+			int v = (axis + 2) % 3;
+			for (int c = 0; c < 4; c++)
+			{
+				float vertex[BATCH_VERTEX_FLOATS] = {};
+				vertex[axis] = sign * 0.5f;
+				vertex[u] = (c == 1 || c == 2) ? 0.5f : -0.5f;
+				vertex[v] = (c >= 2) ? 0.5f : -0.5f;
+				vertex[3] = vertex[u] + 0.5f;
+				vertex[4] = vertex[v] + 0.5f;
+				vertex[5 + axis] = (float)sign;
+				vertex[8 + u] = 1.0f;
+				boxVertices.insert(boxVertices.end(), vertex, vertex + BATCH_VERTEX_FLOATS);
+			}
+			const unsigned int corners[6] = { 0, 1, 2, 0, 2, 3 };
+			for (unsigned int c : corners)
+				boxIndices.push_back(base + c);
+		}
+	}
+	BatchSource box = { Span<const float>(boxVertices), Span<const unsigned int>(boxIndices) };
+
+	// Turned about Y and scaled, over ground four meters a box
+	float side = sqrtf((float)instanceCount) * 4.0f;
+	std::vector<BatchInstance> instances(instanceCount);
+	for (unsigned int i = 0; i < instanceCount; i++)
+	{
+		BatchInstance& instance = instances[i];
+		float angle = (float)rand() / RAND_MAX * 6.2831853f;
+		float scale = 0.5f + 1.5f * (float)rand() / RAND_MAX;
+		float c = cosf(angle) * scale;
+		float s = sinf(angle) * scale;
+
+		memset(instance.world, 0, sizeof(instance.world));
+		instance.world[0][0] = c;
+		instance.world[0][2] = -s;
+		instance.world[1][1] = scale;
+		instance.world[2][0] = s;
+		instance.world[2][2] = c;
+		instance.world[3][0] = (float)rand() / RAND_MAX * side - side * 0.5f;
+		instance.world[3][1] = scale * 0.5f;
+		instance.world[3][2] = (float)rand() / RAND_MAX * side - side * 0.5f;
+		instance.world[3][3] = 1.0f;
+
+		// Uniform scale, so the inverse transpose is the
+		// rotation over the scale
+		memset(instance.worldInvTrans, 0, sizeof(instance.worldInvTrans));
+		for (int r = 0; r < 3; r++)
+			for (int k = 0; k < 3; k++)
+				instance.worldInvTrans[r][k] = instance.world[r][k] / (scale * scale);
+		instance.worldInvTrans[3][3] = 1.0f;
+
+		instance.source = 0;
+		instance.key = i % keyCount;
+	}
+
+	StaticBatches batches;
+	batches.Build(Span<const BatchSource>(&box, 1), Span<const BatchInstance>(instances), DefaultStaticBatchSettings());
+	result.batchCount = batches.GetBatchCount();
+	result.drawsBefore = instanceCount;
+	result.drawsAfter = batches.GetDrawCount();
+	result.buildMS = batches.GetBuildMS();
+
+	// Every merged vertex must be its instance's vertex moved
+	// into the world, each instance's run of them coming in
+	// the order the batch lists its instances
+	size_t boxVertexCount = boxVertices.size() / BATCH_VERTEX_FLOATS;
+	for (unsigned int b = 0; b < batches.GetBatchCount(); b++)
+	{
+		const StaticBatch& batch = batches.GetBatch(b);
+		result.vertexCount += (unsigned int)(batch.vertices.size() / BATCH_VERTEX_FLOATS);
+		for (size_t k = 0; k < batch.instances.size(); k++)
+		{
+			const BatchInstance& instance = instances[batch.instances[k]];
+			for (size_t v = 0; v < boxVertexCount; v++)
+			{
+				float expected[3];
+				TransformPoint(instance.world, &boxVertices[v * BATCH_VERTEX_FLOATS], expected);
+				const float* merged = &batch.vertices[(k * boxVertexCount + v) * BATCH_VERTEX_FLOATS];
+				float dx = merged[0] - expected[0];
+				float dy = merged[1] - expected[1];
+				float dz = merged[2] - expected[2];
+				float dcx = merged[0] - batch.boundsCenter[0];
+				float dcy = merged[1] - batch.boundsCenter[1];
+				float dcz = merged[2] - batch.boundsCenter[2];
+				bool outside = dcx * dcx + dcy * dcy + dcz * dcz > batch.boundsRadius * batch.boundsRadius * 1.0001f + 1e-6f;
+				if (dx * dx + dy * dy + dz * dz > 1e-8f || outside)
+					result.mismatches++;
+			}
+		}
+	}
+	return result;
+}
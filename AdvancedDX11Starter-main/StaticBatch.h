@@ -0,0 +1,122 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Merge static entities that are drawn the same way
+//			into a few big meshes. Every instance's vertices
+//			are moved into world space and appended to the
+//			batch for its key, which stands for whatever must
+//			match to share a draw (material, shaders), and for
+//			the chunk of the world its middle falls in, so each
+//			batch stays small enough to be culled on its own.
+//			Keys and chunks are visited in order, so the same
+//			instances always give the same batches.
+
+#include <vector>
+#include <limits.h>
+
+#include "FrameArena.h"
+
+// Floats in a vertex, laid out like the engine's Vertex:
+// position, uv, normal and tangent
+#define BATCH_VERTEX_FLOATS 11
+
+// What GetInstanceBatch gives for instances left to be
+// drawn on their own
+#define BATCH_NONE UINT_MAX
+
+/// <summary>
+/// How big batches are allowed to get
+/// </summary>
+struct StaticBatchSettings
+{
+	float chunkSize;			// Side of a chunk along X and Z
+	unsigned int minInstances;	// Fewer in a chunk than this are left alone
+	unsigned int maxVertices;	// A batch is split before it grows past this
+};
+
+StaticBatchSettings DefaultStaticBatchSettings();
+
+/// <summary>
+/// A model's geometry, in its own space
+/// </summary>
+struct BatchSource
+{
+	Span<const float> vertices;		// BATCH_VERTEX_FLOATS each
+	Span<const unsigned int> indices;
+};
+
+/// <summary>
+/// A placed copy of a source. Matrices are row major, for
+/// row vectors, as entity transforms keep them
+/// </summary>
+struct BatchInstance
+{
+	unsigned int source;
+	unsigned int key;			// Only instances of the same key share a batch
+	float world[4][4];
+	float worldInvTrans[4][4];
+};
+
+/// <summary>
+/// Instances merged into one mesh, in world space
+/// </summary>
+struct StaticBatch
+{
+	unsigned int key;
+	int chunk[2];				// X and Z
+	std::vector<float> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<unsigned int> instances;
+	float boundsCenter[3];
+	float boundsRadius;
+};
+
+class StaticBatches
+{
+public:
+	StaticBatches();
+
+	// Replaces whatever was built before
+	void Build(Span<const BatchSource> sources, Span<const BatchInstance> instances, const StaticBatchSettings& settings);
+
+	unsigned int GetBatchCount() const { return (unsigned int)batches.size(); }
+	const StaticBatch& GetBatch(unsigned int index) const { return batches[index]; }
+
+	// The batch an instance went into, or BATCH_NONE
+	unsigned int GetInstanceBatch(unsigned int instance) const { return instanceBatches[instance]; }
+
+	unsigned int GetInstanceCount() const { return (unsigned int)instanceBatches.size(); }
+	unsigned int GetMergedCount() const { return mergedCount; }
+
+	// Draws once built: one a batch and one a leftover instance
+	unsigned int GetDrawCount() const { return GetBatchCount() + GetInstanceCount() - mergedCount; }
+	float GetBuildMS() const { return buildMS; }
+
+private:
+	std::vector<StaticBatch> batches;
+	std::vector<unsigned int> instanceBatches;
+	unsigned int mergedCount;
+	float buildMS;
+};
+
+/// <summary>
+/// Results of one headless benchmark run
+/// </summary>
+struct StaticBatchBenchmark
+{
+	unsigned int instanceCount;
+	unsigned int keyCount;
+	unsigned int batchCount;
+	unsigned int drawsBefore;
+	unsigned int drawsAfter;
+	unsigned int vertexCount;		// Across every batch
+	float buildMS;
+	unsigned int mismatches;		// Merged vertices not where their instance put them
+};
+
+/// <summary>
+/// Scatters boxes over a square of ground, each given one of
+/// keyCount keys and a random turn and scale, batches them
+/// and checks every merged vertex against its instance
+/// </summary>
+StaticBatchBenchmark BenchmarkStaticBatching(unsigned int instanceCount, unsigned int keyCount);
@@ -0,0 +1,579 @@
+#include "StreamedTextures.h"
+#include "Material.h"
+#include "TextureCooker.h"
+#include "Helpers.h"
+
+#include <algorithm>
+#include <fstream>
+
+#pragma comment(lib, "windowscodecs.lib")
+
+/// <summary>
+/// Starts the decoding workers
+/// </summary>
+StreamedTextures::StreamedTextures(Microsoft::WRL::ComPtr<ID3D11Device> device, unsigned int workerCount) :
+	device(device),
+	shuttingDown(false)
+{
+	for (unsigned int i = 0; i < workerCount; i++)
+		workers.push_back(std::thread(&StreamedTextures::WorkerLoop, this));
+}
+
+/// <summary>
+/// Lets the workers finish the file they are on and waits
+/// for them. Anything still queued is never loaded
+/// </summary>
+StreamedTextures::~StreamedTextures()
+{
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		shuttingDown = true;
+	}
+	jobReady.notify_all();
+
+	for (auto& worker : workers)
+		worker.join();
+}
+
+unsigned int StreamedTextures::Register(const std::wstring& path, bool normalMap, bool packed)
+{
+	Stream stream;
+	stream.path = path;
+	stream.packed = packed;
+	stream.srv = MakeStandIn(normalMap);
+	stream.residentMip = TEXTURE_STREAM_NOT_RESIDENT;
+	streams.push_back(stream);
+	residentBytes.push_back(0);
+
+	return streamer.Register();
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> StreamedTextures::AddUser(
+	unsigned int stream,
+	std::shared_ptr<RendMat> mat)
+{
+	streams[stream].users.push_back(mat);
+	return streams[stream].srv;
+}
+
+void StreamedTextures::BeginFrame()
+{
+	streamer.BeginFrame();
+}
+
+void StreamedTextures::Request(unsigned int stream, float uvScale, float screenDiameter)
+{
+	streamer.Request(stream, uvScale, screenDiameter);
+}
+
+/// <summary>
+/// Reports the loads that finished since last frame, then
+/// queues the streamer's new loads for the workers and its
+/// evictions for the render thread
+/// </summary>
+void StreamedTextures::Update()
+{
+	{
+		std::lock_guard<std::mutex> lock(loadedMutex);
+		finished.swap(loaded);
+	}
+
+	for (auto& result : finished)
+	{
+		if (result.srv)
+			streamer.CompleteLoad(result.stream, result.mip, result.width, result.height);
+		else
+			streamer.FailLoad(result.stream);
+	}
+
+	commands.clear();
+	streamer.Update(commands);
+
+	{
+		// Loads that just finished go first, since the
+		// streamer may already be evicting from them
+		std::lock_guard<std::mutex> lock(swapMutex);
+		for (auto& result : finished)
+		{
+			if (result.srv)
+				swaps.push_back(result);
+		}
+
+		for (auto& command : commands)
+		{
+			if (command.type != TextureStreamCommandType::Evict)
+				continue;
+
+			LoadResult evict = {};
+			evict.stream = command.texture;
+			evict.mip = command.mip;
+			evict.evict = true;
+			swaps.push_back(evict);
+		}
+	}
+	finished.clear();
+
+	bool queued = false;
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		for (auto& command : commands)
+		{
+			if (command.type != TextureStreamCommandType::Load)
+				continue;
+
+			LoadJob job = { command.texture, command.mip, streams[command.texture].path, streams[command.texture].packed };
+			jobs.push_back(job);
+			queued = true;
+		}
+	}
+
+	if (queued)
+		jobReady.notify_all();
+}
+
+/// <summary>
+/// Swaps finished loads and evictions into the materials.
+/// Nothing drawn before this frame is affected, the context
+/// keeps whatever it already has bound alive
+/// </summary>
+void StreamedTextures::ApplySwaps(ID3D11DeviceContext* context)
+{
+	{
+		std::lock_guard<std::mutex> lock(swapMutex);
+		applying.swap(swaps);
+	}
+
+	for (auto& swap : applying)
+	{
+		Stream& stream = streams[swap.stream];
+		if (swap.evict)
+		{
+			Evict(context, stream, swap.mip);
+			continue;
+		}
+
+		stream.texture = swap.texture;
+		stream.residentMip = swap.mip;
+		SwapInto(stream, swap.srv);
+	}
+
+	if (!applying.empty())
+	{
+		// Measured from the textures themselves, so cooked
+		// files count at their compressed size
+		std::lock_guard<std::mutex> lock(swapMutex);
+		for (auto& swap : applying)
+		{
+			Stream& stream = streams[swap.stream];
+			residentBytes[swap.stream] = stream.texture ? TextureBytes(stream.srv.Get()) : 0;
+		}
+	}
+
+	applying.clear();
+}
+
+size_t StreamedTextures::GetResidentBytes(unsigned int stream)
+{
+	std::lock_guard<std::mutex> lock(swapMutex);
+	return residentBytes[stream];
+}
+
+/// <summary>
+/// Drops every mip finer than the given one by copying the
+/// rest into a smaller texture, all on the GPU
+/// </summary>
+void StreamedTextures::Evict(ID3D11DeviceContext* context, Stream& stream, unsigned int mip)
+{
+	if (!stream.texture || mip <= stream.residentMip)
+		return;
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	stream.texture->GetDesc(&desc);
+
+	unsigned int dropped = mip - stream.residentMip;
+	if (dropped >= desc.MipLevels)
+		return;
+
+	// Block compressed tops have to stay whole blocks, so
+	// keep a finer level than asked for when they would not
+	if (IsBlockCompressed(desc.Format))
+	{
+		while (dropped > 0 && ((desc.Width >> dropped) % 4 != 0 || (desc.Height >> dropped) % 4 != 0))
+			dropped--;
+		if (dropped == 0)
+			return;
+		mip = stream.residentMip + dropped;
+	}
+
+	unsigned int oldLevels = desc.MipLevels;
+	desc.Width = (std::max)(desc.Width >> dropped, 1u);
+	desc.Height = (std::max)(desc.Height >> dropped, 1u);
+	desc.MipLevels = oldLevels - dropped;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	if (FAILED(device->CreateTexture2D(&desc, 0, texture.GetAddressOf())) ||
+		FAILED(device->CreateShaderResourceView(texture.Get(), 0, srv.GetAddressOf())))
+		return;
+
+	for (unsigned int level = 0; level < desc.MipLevels; level++)
+	{
+		context->CopySubresourceRegion(
+			texture.Get(), D3D11CalcSubresource(level, 0, desc.MipLevels), 0, 0, 0,
+			stream.texture.Get(), D3D11CalcSubresource(level + dropped, 0, oldLevels), 0);
+	}
+
+	stream.texture = texture;
+	stream.residentMip = mip;
+	SwapInto(stream, srv);
+}
+
+/// <summary>
+/// Points every material using the stream at a new view
+/// </summary>
+void StreamedTextures::SwapInto(Stream& stream, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+{
+	for (auto& user : stream.users)
+	{
+		std::shared_ptr<RendMat> mat = user.lock();
+		if (mat)
+			ReplaceTextureSRV(mat, stream.srv.Get(), srv);
+	}
+
+	stream.srv = srv;
+}
+
+/// <summary>
+/// 1x1 texture bound until the first mips arrive. Middle grey
+/// reads as a plain surface, and flat blue as an unbent normal
+/// </summary>
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> StreamedTextures::MakeStandIn(bool normalMap)
+{
+	const unsigned char grey[4] = { 128, 128, 128, 255 };
+	const unsigned char flat[4] = { 128, 128, 255, 255 };
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = 1;
+	desc.Height = 1;
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	D3D11_SUBRESOURCE_DATA data = {};
+	data.pSysMem = normalMap ? flat : grey;
+	data.SysMemPitch = TEXTURE_STREAM_TEXEL_BYTES;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	if (SUCCEEDED(device->CreateTexture2D(&desc, &data, texture.GetAddressOf())))
+		device->CreateShaderResourceView(texture.Get(), 0, srv.GetAddressOf());
+	return srv;
+}
+
+/// <summary>
+/// Workers sleep until there is a file to decode
+/// </summary>
+void StreamedTextures::WorkerLoop()
+{
+	// WIC is COM, and every thread needs it started
+	HRESULT comResult = CoInitializeEx(0, COINIT_MULTITHREADED);
+
+	Microsoft::WRL::ComPtr<IWICImagingFactory> factory;
+	CoCreateInstance(
+		CLSID_WICImagingFactory,
+		0,
+		CLSCTX_INPROC_SERVER,
+		IID_PPV_ARGS(factory.GetAddressOf()));
+
+	while (true)
+	{
+		LoadJob job;
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			jobReady.wait(lock, [this]() { return shuttingDown || !jobs.empty(); });
+			if (shuttingDown)
+				break;
+
+			job = jobs.front();
+			jobs.pop_front();
+		}
+
+		// A failed load comes back without a view
+		LoadResult result = {};
+		result.stream = job.stream;
+		// Cooked files are read as they are, without WIC
+		bool cooked = job.path.size() > 4 && _wcsicmp(job.path.c_str() + job.path.size() - 4, L".dds") == 0;
+		bool loadedMips = false;
+		if (cooked)
+			loadedMips = LoadCookedMips(job, &result);
+		else if (factory)
+			loadedMips = job.packed ? LoadPackedMips(factory.Get(), job, &result) : LoadMips(factory.Get(), job, &result);
+
+		if (!loadedMips)
+		{
+			result.texture.Reset();
+			result.srv.Reset();
+		}
+
+		std::lock_guard<std::mutex> lock(loadedMutex);
+		loaded.push_back(result);
+	}
+
+	factory.Reset();
+	if (SUCCEEDED(comResult))
+		CoUninitialize();
+}
+
+/// <summary>
+/// Decodes a file straight to the size of the requested mip
+/// and builds the smaller ones from it. The source images
+/// have no mips of their own, so nothing is gained by
+/// reading more than that one level from them
+/// </summary>
+bool StreamedTextures::LoadMips(IWICImagingFactory* factory, const LoadJob& job, LoadResult* result)
+{
+	Microsoft::WRL::ComPtr<IWICBitmapDecoder> decoder;
+	Microsoft::WRL::ComPtr<IWICBitmapFrameDecode> frame;
+	if (FAILED(factory->CreateDecoderFromFilename(
+			job.path.c_str(), 0, GENERIC_READ, WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf())) ||
+		FAILED(decoder->GetFrame(0, frame.GetAddressOf())))
+		return false;
+
+	unsigned int width = 0;
+	unsigned int height = 0;
+	if (FAILED(frame->GetSize(&width, &height)) || width == 0 || height == 0)
+		return false;
+
+	// The size of a first load is only known now
+	unsigned int mip = job.mip == TEXTURE_STREAM_BASE_MIP ? TextureBaseMip(width, height) : job.mip;
+	mip = (std::min)(mip, TextureMipCount(width, height) - 1);
+	unsigned int mipWidth = (std::max)(width >> mip, 1u);
+	unsigned int mipHeight = (std::max)(height >> mip, 1u);
+
+	std::vector<unsigned char> pixels;
+	if (!DecodeRGBA(factory, frame.Get(), mipWidth, mipHeight, pixels) ||
+		!CreateMips(pixels, mipWidth, mipHeight, result))
+		return false;
+
+	result->mip = mip;
+	result->width = width;
+	result->height = height;
+	return true;
+}
+
+/// <summary>
+/// Packs an _orm texture from its single channel maps the way
+/// the cooker does, but with every map decoded straight to the
+/// size of the requested mip. Missing maps take the cooker's
+/// defaults, with none at all the load fails
+/// </summary>
+bool StreamedTextures::LoadPackedMips(IWICImagingFactory* factory, const LoadJob& job, LoadResult* result)
+{
+	// Only sizes are read at first, the packed texture is
+	// the size of the largest map
+	std::string ormPath = WideToNarrow(job.path);
+	Microsoft::WRL::ComPtr<IWICBitmapFrameDecode> frames[ORM_CHANNEL_COUNT];
+	unsigned int width = 0;
+	unsigned int height = 0;
+	for (unsigned int c = 0; c < ORM_CHANNEL_COUNT; c++)
+	{
+		Microsoft::WRL::ComPtr<IWICBitmapDecoder> decoder;
+		unsigned int mapWidth = 0;
+		unsigned int mapHeight = 0;
+		if (FAILED(factory->CreateDecoderFromFilename(
+				NarrowToWide(OrmChannelSource(ormPath, c)).c_str(), 0, GENERIC_READ, WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf())) ||
+			FAILED(decoder->GetFrame(0, frames[c].GetAddressOf())) ||
+			FAILED(frames[c]->GetSize(&mapWidth, &mapHeight)) || mapWidth == 0 || mapHeight == 0)
+		{
+			frames[c].Reset();
+			continue;
+		}
+
+		width = (std::max)(width, mapWidth);
+		height = (std::max)(height, mapHeight);
+	}
+
+	if (width == 0)
+		return false;
+
+	unsigned int mip = job.mip == TEXTURE_STREAM_BASE_MIP ? TextureBaseMip(width, height) : job.mip;
+	mip = (std::min)(mip, TextureMipCount(width, height) - 1);
+	unsigned int mipWidth = (std::max)(width >> mip, 1u);
+	unsigned int mipHeight = (std::max)(height >> mip, 1u);
+
+	// Already the same size, so packing has nothing to stretch
+	std::vector<unsigned char> maps[ORM_CHANNEL_COUNT];
+	const unsigned char* sources[ORM_CHANNEL_COUNT] = {};
+	unsigned int widths[ORM_CHANNEL_COUNT] = {};
+	unsigned int heights[ORM_CHANNEL_COUNT] = {};
+	for (unsigned int c = 0; c < ORM_CHANNEL_COUNT; c++)
+	{
+		if (!frames[c])
+			continue;
+		if (!DecodeRGBA(factory, frames[c].Get(), mipWidth, mipHeight, maps[c]))
+			return false;
+
+		sources[c] = maps[c].data();
+		widths[c] = mipWidth;
+		heights[c] = mipHeight;
+	}
+
+	std::vector<unsigned char> packed;
+	unsigned int packedWidth, packedHeight;
+	PackOrmTexture(sources, widths, heights, packed, &packedWidth, &packedHeight);
+	if (!CreateMips(packed, packedWidth, packedHeight, result))
+		return false;
+
+	result->mip = mip;
+	result->width = width;
+	result->height = height;
+	return true;
+}
+
+/// <summary>
+/// Converts a decoded frame to RGBA8, scaled to the given size
+/// when it isn't already that size
+/// </summary>
+bool StreamedTextures::DecodeRGBA(
+	IWICImagingFactory* factory,
+	IWICBitmapFrameDecode* frame,
+	unsigned int width,
+	unsigned int height,
+	std::vector<unsigned char>& pixels)
+{
+	unsigned int frameWidth = 0;
+	unsigned int frameHeight = 0;
+	Microsoft::WRL::ComPtr<IWICFormatConverter> converter;
+	if (FAILED(frame->GetSize(&frameWidth, &frameHeight)) ||
+		FAILED(factory->CreateFormatConverter(converter.GetAddressOf())) ||
+		FAILED(converter->Initialize(
+			frame,
+			GUID_WICPixelFormat32bppRGBA,
+			WICBitmapDitherTypeNone,
+			0,
+			0,
+			WICBitmapPaletteTypeCustom)))
+		return false;
+
+	Microsoft::WRL::ComPtr<IWICBitmapSource> source = converter;
+	if (frameWidth != width || frameHeight != height)
+	{
+		Microsoft::WRL::ComPtr<IWICBitmapScaler> scaler;
+		if (FAILED(factory->CreateBitmapScaler(scaler.GetAddressOf())) ||
+			FAILED(scaler->Initialize(converter.Get(), width, height, WICBitmapInterpolationModeFant)))
+			return false;
+		source = scaler;
+	}
+
+	unsigned int pitch = width * TEXTURE_STREAM_TEXEL_BYTES;
+	pixels.resize((size_t)pitch * height);
+	return SUCCEEDED(source->CopyPixels(0, pitch, (unsigned int)pixels.size(), pixels.data()));
+}
+
+/// <summary>
+/// Builds the smaller mips of an RGBA8 image and makes the
+/// texture and view holding all of them
+/// </summary>
+bool StreamedTextures::CreateMips(
+	const std::vector<unsigned char>& pixels,
+	unsigned int mipWidth,
+	unsigned int mipHeight,
+	LoadResult* result)
+{
+	std::vector<unsigned char> levels;
+	std::vector<size_t> levelOffsets;
+	BuildMipChain(pixels.data(), mipWidth, mipHeight, levels, levelOffsets);
+
+	std::vector<D3D11_SUBRESOURCE_DATA> data(levelOffsets.size());
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		data[i].pSysMem = levels.data() + levelOffsets[i];
+		data[i].SysMemPitch = (std::max)(mipWidth >> i, 1u) * TEXTURE_STREAM_TEXEL_BYTES;
+	}
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = mipWidth;
+	desc.Height = mipHeight;
+	desc.MipLevels = (unsigned int)data.size();
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	if (FAILED(device->CreateTexture2D(&desc, data.data(), result->texture.GetAddressOf())) ||
+		FAILED(device->CreateShaderResourceView(result->texture.Get(), 0, result->srv.GetAddressOf())))
+		return false;
+	return true;
+}
+
+/// <summary>
+/// Reads a cooked file from the requested mip down. Every
+/// level is already there and compressed, so the levels
+/// above it are skipped over and the rest copied as is
+/// </summary>
+bool StreamedTextures::LoadCookedMips(const LoadJob& job, LoadResult* result)
+{
+	std::ifstream file(job.path.c_str(), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	unsigned char header[COOKED_TEXTURE_HEADER_SIZE];
+	file.seekg(0, std::ios::end);
+	size_t fileSize = (size_t)file.tellg();
+	file.seekg(0);
+	if (!file.read((char*)header, sizeof(header)))
+		return false;
+
+	// A cut short file would leave levels half read
+	CookedTextureInfo info;
+	if (!ReadCookedTextureHeader(header, sizeof(header), &info) || fileSize < info.fileSize)
+		return false;
+
+	unsigned int mip = job.mip == TEXTURE_STREAM_BASE_MIP ? TextureBaseMip(info.width, info.height) : job.mip;
+	mip = (std::min)(mip, info.levelCount - 1);
+
+	// Only levels that are whole blocks can be the top
+	bool compressed = IsBlockCompressed(info.format);
+	while (compressed && mip > 0 && ((info.width >> mip) % 4 != 0 || (info.height >> mip) % 4 != 0))
+		mip--;
+
+	std::vector<unsigned char> levels(info.fileSize - info.levelOffsets[mip]);
+	file.seekg(info.levelOffsets[mip]);
+	if (!file.read((char*)levels.data(), levels.size()))
+		return false;
+
+	unsigned int mipWidth = (std::max)(info.width >> mip, 1u);
+	unsigned int mipHeight = (std::max)(info.height >> mip, 1u);
+	unsigned int blockBytes = CookedFormatBlockBytes(info.format);
+
+	std::vector<D3D11_SUBRESOURCE_DATA> data(info.levelCount - mip);
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		unsigned int levelWidth = (std::max)(mipWidth >> i, 1u);
+		data[i].pSysMem = levels.data() + (info.levelOffsets[mip + i] - info.levelOffsets[mip]);
+		data[i].SysMemPitch = compressed ? (levelWidth + 3) / 4 * blockBytes : levelWidth * blockBytes;
+	}
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = mipWidth;
+	desc.Height = mipHeight;
+	desc.MipLevels = (unsigned int)data.size();
+	desc.ArraySize = 1;
+	desc.Format = (DXGI_FORMAT)info.format;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	if (FAILED(device->CreateTexture2D(&desc, data.data(), result->texture.GetAddressOf())) ||
+		FAILED(device->CreateShaderResourceView(result->texture.Get(), 0, result->srv.GetAddressOf())))
+		return false;
+
+	result->mip = mip;
+	result->width = info.width;
+	result->height = info.height;
+	return true;
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: The Direct3D side of texture streaming. Material
+//			textures are registered without loading anything and
+//			bound as a 1x1 stand-in, worker threads decode the
+//			mips the TextureStreamer asks for, and the render
+//			thread swaps the finished textures into every
+//			material using them before it records a frame.
+//			Uncooked _orm textures have no file of their own,
+//			workers pack them from their channel maps instead.
+
+#include <d3d11.h>
+#include <wincodec.h>
+#include <wrl/client.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "TextureStreaming.h"
+
+// Threads decoding files. Loads are few and far between,
+// these only need to keep up with the camera moving
+#define TEXTURE_STREAM_WORKERS 2
+
+struct RendMat;
+
+class StreamedTextures
+{
+public:
+	StreamedTextures(Microsoft::WRL::ComPtr<ID3D11Device> device, unsigned int workerCount);
+	~StreamedTextures();
+
+	// Only while loading materials, before the render thread
+	// starts. Every stream gets its own 1x1 stand-in, flat
+	// blue for normal maps, so a view always names one stream.
+	// A packed stream's path is the _orm texture's, its maps
+	// are found from it
+	unsigned int Register(const std::wstring& path, bool normalMap, bool packed);
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> AddUser(
+		unsigned int stream,
+		std::shared_ptr<RendMat> mat);
+
+	// Main thread, once per frame: requests for everything
+	// about to be drawn, then Update to hand out the work
+	void BeginFrame();
+	void Request(unsigned int stream, float uvScale, float screenDiameter);
+	void Update();
+
+	// Render thread, before anything using materials is recorded
+	void ApplySwaps(ID3D11DeviceContext* context);
+
+	void SetBudget(size_t bytes) { streamer.SetBudget(bytes); }
+	size_t GetBudget() const { return streamer.GetBudget(); }
+	TextureStreamStats GetStats() const { return streamer.GetStats(); }
+	unsigned int GetStreamCount() const { return (unsigned int)streams.size(); }
+
+	// Main thread. Memory of what the render thread last
+	// swapped in, as made rather than as the budget counts it
+	size_t GetResidentBytes(unsigned int stream);
+
+private:
+	struct Stream
+	{
+		std::wstring path;
+		bool packed;
+
+		// Render thread only once streaming has started. The
+		// texture holds full size mips from residentMip down
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+		unsigned int residentMip;
+
+		std::vector<std::weak_ptr<RendMat>> users;
+	};
+
+	struct LoadJob
+	{
+		unsigned int stream;
+		unsigned int mip;
+		std::wstring path;
+		bool packed;
+	};
+
+	// A finished load on its way to the main thread, or a
+	// texture change on its way to the render thread
+	struct LoadResult
+	{
+		unsigned int stream;
+		unsigned int mip;
+		unsigned int width;
+		unsigned int height;
+		bool evict;
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	};
+
+	void WorkerLoop();
+	bool LoadMips(IWICImagingFactory* factory, const LoadJob& job, LoadResult* result);
+	bool LoadPackedMips(IWICImagingFactory* factory, const LoadJob& job, LoadResult* result);
+	bool LoadCookedMips(const LoadJob& job, LoadResult* result);
+	bool DecodeRGBA(
+		IWICImagingFactory* factory,
+		IWICBitmapFrameDecode* frame,
+		unsigned int width,
+		unsigned int height,
+		std::vector<unsigned char>& pixels);
+	bool CreateMips(
+		const std::vector<unsigned char>& pixels,
+		unsigned int mipWidth,
+		unsigned int mipHeight,
+		LoadResult* result);
+	void Evict(ID3D11DeviceContext* context, Stream& stream, unsigned int mip);
+	void SwapInto(Stream& stream, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> MakeStandIn(bool normalMap);
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+
+	// Main thread only
+	TextureStreamer streamer;
+	std::vector<TextureStreamCommand> commands;
+	std::vector<LoadResult> finished;
+
+	// Only added to while loading, after that the render
+	// thread is the only one touching them
+	std::vector<Stream> streams;
+
+	// Main thread to workers
+	std::vector<std::thread> workers;
+	std::mutex jobMutex;
+	std::condition_variable jobReady;
+	std::deque<LoadJob> jobs;
+	bool shuttingDown;
+
+	// Workers to main thread
+	std::mutex loadedMutex;
+	std::vector<LoadResult> loaded;
+
+	// Main thread to render thread, kept in order so a load
+	// is always swapped in before its later eviction
+	std::mutex swapMutex;
+	std::vector<LoadResult> swaps;
+	std::vector<LoadResult> applying;
+
+	// Render thread to main thread, also under swapMutex
+	std::vector<size_t> residentBytes;
+};
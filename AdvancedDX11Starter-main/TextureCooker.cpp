@@ -0,0 +1,1020 @@
+#include "TextureCooker.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The shaders decode albedo with a plain 2.2 power, so
+// mips are filtered in the same linear space
+#define COOKER_GAMMA 2.2f
+
+// Power iterations when finding a block's main axis
+#define COOKER_AXIS_ITERATIONS 8
+
+// Below this the top level keeps its RGBA8 texels instead.
+// Reported for levels that compress without any loss
+#define COOKER_MIN_PSNR 30.0f
+#define COOKER_LOSSLESS_PSNR 99.0f
+
+// --------------------------------------------------------
+// Naming and sizes
+// --------------------------------------------------------
+
+static bool EndsWith(const std::string& text, const char* suffix)
+{
+	size_t length = strlen(suffix);
+	return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+TextureMapType ClassifyTexture(const std::string& fileName)
+{
+	std::string name = fileName.substr(0, fileName.find_last_of('.'));
+	std::transform(name.begin(), name.end(), name.begin(), [](char c) { return (char)tolower(c); });
+
+	if (EndsWith(name, "_albedo")) return TextureMapType::Albedo;
+	if (EndsWith(name, "_normals") || EndsWith(name, "_normal")) return TextureMapType::Normal;
+	if (EndsWith(name, "_roughness") || EndsWith(name, "_metal") || EndsWith(name, "_ao") || EndsWith(name, "_height"))
+		return TextureMapType::Mask;
+	if (EndsWith(name, ORM_SUFFIX)) return TextureMapType::Packed;
+	return TextureMapType::Color;
+}
+
+unsigned int ChooseCookedFormat(TextureMapType type, bool hasAlpha)
+{
+	switch (type)
+	{
+	case TextureMapType::Albedo: return COOKED_FORMAT_BC7;
+	case TextureMapType::Normal: return COOKED_FORMAT_BC5;
+	case TextureMapType::Mask: return COOKED_FORMAT_BC4;
+	case TextureMapType::Packed: return COOKED_FORMAT_BC7;
+	default: return hasAlpha ? COOKED_FORMAT_BC7 : COOKED_FORMAT_BC1;
+	}
+}
+
+std::string CookedTexturePath(const std::string& sourcePath)
+{
+	return COOKED_TEXTURE_FOLDER + sourcePath.substr(0, sourcePath.find_last_of('.')) + ".dds";
+}
+
+// --------------------------------------------------------
+// Channel packing
+// --------------------------------------------------------
+
+static const char* OrmChannelSuffixes[ORM_CHANNEL_COUNT] = { "_ao", "_roughness", "_metal", "_height" };
+static const unsigned char OrmChannelDefaults[ORM_CHANNEL_COUNT] = { 255, 255, 0, 255 };
+
+// The path without its extension
+static std::string StripExtension(const std::string& path)
+{
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("/\\");
+	return dot == std::string::npos || (slash != std::string::npos && dot < slash) ? path : path.substr(0, dot);
+}
+
+bool IsOrmTexture(const std::string& path)
+{
+	return EndsWith(StripExtension(path), ORM_SUFFIX);
+}
+
+std::string OrmChannelSource(const std::string& ormPath, unsigned int channel)
+{
+	std::string base = StripExtension(ormPath);
+	base.resize(base.size() - strlen(ORM_SUFFIX));
+	return base + OrmChannelSuffixes[channel] + ormPath.substr(StripExtension(ormPath).size());
+}
+
+std::string OrmTextureOf(const std::string& sourcePath, unsigned int* channel)
+{
+	std::string name = StripExtension(sourcePath);
+	for (unsigned int c = 0; c < ORM_CHANNEL_COUNT; c++)
+	{
+		if (!EndsWith(name, OrmChannelSuffixes[c]))
+			continue;
+
+		*channel = c;
+		return name.substr(0, name.size() - strlen(OrmChannelSuffixes[c])) + ORM_SUFFIX + sourcePath.substr(name.size());
+	}
+	return std::string();
+}
+
+void PackOrmTexture(
+	const unsigned char* const sources[ORM_CHANNEL_COUNT],
+	const unsigned int widths[ORM_CHANNEL_COUNT],
+	const unsigned int heights[ORM_CHANNEL_COUNT],
+	std::vector<unsigned char>& out,
+	unsigned int* width,
+	unsigned int* height)
+{
+	*width = 1;
+	*height = 1;
+	for (unsigned int c = 0; c < ORM_CHANNEL_COUNT; c++)
+	{
+		if (!sources[c])
+			continue;
+		*width = (std::max)(*width, widths[c]);
+		*height = (std::max)(*height, heights[c]);
+	}
+
+	size_t texelCount = (size_t)*width * *height;
+	out.resize(texelCount * 4);
+
+	std::vector<unsigned char> resized;
+	for (unsigned int c = 0; c < ORM_CHANNEL_COUNT; c++)
+	{
+		const unsigned char* source = sources[c];
+		if (source && (widths[c] != *width || heights[c] != *height))
+		{
+			// Smaller maps, like the 128 pixel metal ones,
+			// are stretched to fit
+			ResizeImage(source, widths[c], heights[c], *width, *height, TextureMapType::Mask, resized);
+			source = resized.data();
+		}
+
+		for (size_t i = 0; i < texelCount; i++)
+			out[i * 4 + c] = source ? source[i * 4] : OrmChannelDefaults[c];
+	}
+}
+
+unsigned int CookedFormatBlockBytes(unsigned int format)
+{
+	switch (format)
+	{
+	case COOKED_FORMAT_BC1:
+	case COOKED_FORMAT_BC4: return 8;
+	case COOKED_FORMAT_BC5:
+	case COOKED_FORMAT_BC7: return 16;
+	case COOKED_FORMAT_RGBA8: return 4;
+	case COOKED_FORMAT_RGBA16F: return 8;
+	default: return 0;
+	}
+}
+
+bool IsBlockCompressed(unsigned int format)
+{
+	return
+		format == COOKED_FORMAT_BC1 ||
+		format == COOKED_FORMAT_BC4 ||
+		format == COOKED_FORMAT_BC5 ||
+		format == COOKED_FORMAT_BC7;
+}
+
+size_t CookedLevelBytes(unsigned int format, unsigned int width, unsigned int height)
+{
+	if (!IsBlockCompressed(format))
+		return (size_t)width * height * CookedFormatBlockBytes(format);
+
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * CookedFormatBlockBytes(format);
+}
+
+// --------------------------------------------------------
+// Filtering
+//
+// Texels are decoded to floats in the space they should be
+// averaged in, weighted, and encoded back.
+// --------------------------------------------------------
+
+struct GammaTable
+{
+	float toLinear[256];
+
+	GammaTable()
+	{
+		for (int i = 0; i < 256; i++)
+			toLinear[i] = powf(i / 255.0f, COOKER_GAMMA);
+	}
+};
+
+// Built once, even with several cooking threads asking
+static const float* GammaToLinearTable()
+{
+	static const GammaTable table;
+	return table.toLinear;
+}
+
+static void DecodeTexel(const unsigned char* texel, TextureMapType type, float out[4])
+{
+	if (type == TextureMapType::Albedo || type == TextureMapType::Color)
+	{
+		const float* toLinear = GammaToLinearTable();
+		out[0] = toLinear[texel[0]];
+		out[1] = toLinear[texel[1]];
+		out[2] = toLinear[texel[2]];
+	}
+	else if (type == TextureMapType::Normal)
+	{
+		out[0] = texel[0] / 255.0f * 2.0f - 1.0f;
+		out[1] = texel[1] / 255.0f * 2.0f - 1.0f;
+		out[2] = texel[2] / 255.0f * 2.0f - 1.0f;
+	}
+	else
+	{
+		out[0] = texel[0] / 255.0f;
+		out[1] = texel[1] / 255.0f;
+		out[2] = texel[2] / 255.0f;
+	}
+	out[3] = texel[3] / 255.0f;
+}
+
+static unsigned char ToByte(float value)
+{
+	value = value * 255.0f + 0.5f;
+	return (unsigned char)(value < 0.0f ? 0.0f : value > 255.0f ? 255.0f : value);
+}
+
+static void EncodeTexel(const float in[4], TextureMapType type, unsigned char* texel)
+{
+	if (type == TextureMapType::Albedo || type == TextureMapType::Color)
+	{
+		for (int c = 0; c < 3; c++)
+			texel[c] = ToByte(powf((std::max)(in[c], 0.0f), 1.0f / COOKER_GAMMA));
+	}
+	else if (type == TextureMapType::Normal)
+	{
+		// Averaged normals come out short, and a flat
+		// normal is better than a direction of nothing
+		float length = sqrtf(in[0] * in[0] + in[1] * in[1] + in[2] * in[2]);
+		float n[3] = { 0, 0, 1 };
+		if (length > 0.0001f)
+		{
+			n[0] = in[0] / length;
+			n[1] = in[1] / length;
+			n[2] = in[2] / length;
+		}
+		for (int c = 0; c < 3; c++)
+			texel[c] = ToByte(n[c] * 0.5f + 0.5f);
+	}
+	else
+	{
+		for (int c = 0; c < 3; c++)
+			texel[c] = ToByte(in[c]);
+	}
+	texel[3] = ToByte(in[3]);
+}
+
+void DownsampleLevel(
+	const unsigned char* rgba,
+	unsigned int width,
+	unsigned int height,
+	TextureMapType type,
+	std::vector<unsigned char>& out)
+{
+	unsigned int newWidth = (std::max)(width / 2, 1u);
+	unsigned int newHeight = (std::max)(height / 2, 1u);
+	out.resize((size_t)newWidth * newHeight * 4);
+
+	for (unsigned int y = 0; y < newHeight; y++)
+	{
+		unsigned int y0 = (std::min)(y * 2, height - 1);
+		unsigned int y1 = (std::min)(y * 2 + 1, height - 1);
+		for (unsigned int x = 0; x < newWidth; x++)
+		{
+			unsigned int x0 = (std::min)(x * 2, width - 1);
+			unsigned int x1 = (std::min)(x * 2 + 1, width - 1);
+
+			float sum[4] = {};
+			const unsigned int xs[4] = { x0, x1, x0, x1 };
+			const unsigned int ys[4] = { y0, y0, y1, y1 };
+			for (int s = 0; s < 4; s++)
+			{
+				float texel[4];
+				DecodeTexel(&rgba[((size_t)ys[s] * width + xs[s]) * 4], type, texel);
+				for (int c = 0; c < 4; c++)
+					sum[c] += texel[c] * 0.25f;
+			}
+
+			EncodeTexel(sum, type, &out[((size_t)y * newWidth + x) * 4]);
+		}
+	}
+}
+
+void ResizeImage(
+	const unsigned char* rgba,
+	unsigned int width,
+	unsigned int height,
+	unsigned int newWidth,
+	unsigned int newHeight,
+	TextureMapType type,
+	std::vector<unsigned char>& out)
+{
+	out.resize((size_t)newWidth * newHeight * 4);
+
+	float scaleX = (float)width / newWidth;
+	float scaleY = (float)height / newHeight;
+	for (unsigned int y = 0; y < newHeight; y++)
+	{
+		float v = (std::max)((y + 0.5f) * scaleY - 0.5f, 0.0f);
+		unsigned int y0 = (std::min)((unsigned int)v, height - 1);
+		unsigned int y1 = (std::min)(y0 + 1, height - 1);
+		float fy = v - y0;
+
+		for (unsigned int x = 0; x < newWidth; x++)
+		{
+			float u = (std::max)((x + 0.5f) * scaleX - 0.5f, 0.0f);
+			unsigned int x0 = (std::min)((unsigned int)u, width - 1);
+			unsigned int x1 = (std::min)(x0 + 1, width - 1);
+			float fx = u - x0;
+
+			float sum[4] = {};
+			const unsigned int xs[4] = { x0, x1, x0, x1 };
+			const unsigned int ys[4] = { y0, y0, y1, y1 };
+			const float weights[4] = { (1 - fx) * (1 - fy), fx * (1 - fy), (1 - fx) * fy, fx * fy };
+			for (int s = 0; s < 4; s++)
+			{
+				float texel[4];
+				DecodeTexel(&rgba[((size_t)ys[s] * width + xs[s]) * 4], type, texel);
+				for (int c = 0; c < 4; c++)
+					sum[c] += texel[c] * weights[s];
+			}
+
+			EncodeTexel(sum, type, &out[((size_t)y * newWidth + x) * 4]);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Block encoders
+//
+// Endpoints come from the block's main axis, found with a
+// few power iterations on its covariance. Indices are then
+// picked by brute force against the decoded palette, and a
+// least squares refit of the endpoints is kept if it helps.
+// --------------------------------------------------------
+
+/// <summary>
+/// Ends of the line through a block's texels along their
+/// main axis, over the first channels
+/// </summary>
+static void FindBlockAxisEnds(const float texels[16][4], int channels, float low[4], float high[4])
+{
+	float mean[4] = {};
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < channels; c++)
+			mean[c] += texels[i][c] / 16.0f;
+
+	float covariance[4][4] = {};
+	for (int i = 0; i < 16; i++)
+	{
+		float d[4];
+		for (int c = 0; c < channels; c++)
+			d[c] = texels[i][c] - mean[c];
+		for (int a = 0; a < channels; a++)
+			for (int b = 0; b < channels; b++)
+				covariance[a][b] += d[a] * d[b];
+	}
+
+	float axis[4] = { 1, 1, 1, 1 };
+	for (int iteration = 0; iteration < COOKER_AXIS_ITERATIONS; iteration++)
+	{
+		float next[4] = {};
+		float length = 0;
+		for (int a = 0; a < channels; a++)
+		{
+			for (int b = 0; b < channels; b++)
+				next[a] += covariance[a][b] * axis[b];
+			length = (std::max)(length, fabsf(next[a]));
+		}
+
+		// A flat block has no axis, any one will do
+		if (length < 1e-8f)
+			break;
+		for (int c = 0; c < channels; c++)
+			axis[c] = next[c] / length;
+	}
+
+	float axisLength = 0;
+	for (int c = 0; c < channels; c++)
+		axisLength += axis[c] * axis[c];
+	axisLength = sqrtf(axisLength);
+	for (int c = 0; c < channels; c++)
+		axis[c] /= axisLength;
+
+	float minT = 0;
+	float maxT = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		float t = 0;
+		for (int c = 0; c < channels; c++)
+			t += (texels[i][c] - mean[c]) * axis[c];
+		minT = (std::min)(minT, t);
+		maxT = (std::max)(maxT, t);
+	}
+
+	for (int c = 0; c < channels; c++)
+	{
+		low[c] = (std::min)((std::max)(mean[c] + axis[c] * minT, 0.0f), 255.0f);
+		high[c] = (std::min)((std::max)(mean[c] + axis[c] * maxT, 0.0f), 255.0f);
+	}
+}
+
+/// <summary>
+/// Endpoints that best fit texels already assigned a weight
+/// towards the second endpoint. False when every weight is
+/// the same and there is nothing to solve
+/// </summary>
+static bool RefitEndpoints(
+	const float texels[16][4],
+	const float weights[16],
+	int channels,
+	float first[4],
+	float second[4])
+{
+	float aa = 0, ab = 0, bb = 0;
+	float ax[4] = {}, bx[4] = {};
+	for (int i = 0; i < 16; i++)
+	{
+		float b = weights[i];
+		float a = 1.0f - b;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (int c = 0; c < channels; c++)
+		{
+			ax[c] += a * texels[i][c];
+			bx[c] += b * texels[i][c];
+		}
+	}
+
+	float determinant = aa * bb - ab * ab;
+	if (fabsf(determinant) < 1e-6f)
+		return false;
+
+	for (int c = 0; c < channels; c++)
+	{
+		first[c] = (std::min)((std::max)((ax[c] * bb - bx[c] * ab) / determinant, 0.0f), 255.0f);
+		second[c] = (std::min)((std::max)((bx[c] * aa - ax[c] * ab) / determinant, 0.0f), 255.0f);
+	}
+	return true;
+}
+
+static unsigned short PackRGB565(const float color[4])
+{
+	unsigned int r = (unsigned int)(color[0] * 31.0f / 255.0f + 0.5f);
+	unsigned int g = (unsigned int)(color[1] * 63.0f / 255.0f + 0.5f);
+	unsigned int b = (unsigned int)(color[2] * 31.0f / 255.0f + 0.5f);
+	return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+static void UnpackRGB565(unsigned short packed, int color[3])
+{
+	int r = (packed >> 11) & 31;
+	int g = (packed >> 5) & 63;
+	int b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+/// <summary>
+/// Writes a BC1 block for two 565 endpoints, returning its
+/// squared error. Always the four color mode
+/// </summary>
+static unsigned int WriteBC1Block(const float texels[16][4], unsigned short c0, unsigned short c1, unsigned char out[8])
+{
+	// The four color mode needs c0 above c1
+	if (c0 < c1)
+		std::swap(c0, c1);
+
+	int palette[4][3];
+	UnpackRGB565(c0, palette[0]);
+	UnpackRGB565(c1, palette[1]);
+	for (int c = 0; c < 3; c++)
+	{
+		palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	}
+
+	unsigned int error = 0;
+	unsigned int indices = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		unsigned int best = 0;
+		unsigned int bestError = 0xFFFFFFFF;
+
+		// Equal endpoints leave only the first entry usable
+		int entries = c0 == c1 ? 1 : 4;
+		for (int p = 0; p < entries; p++)
+		{
+			unsigned int e = 0;
+			for (int c = 0; c < 3; c++)
+			{
+				int d = (int)(texels[i][c] + 0.5f) - palette[p][c];
+				e += d * d;
+			}
+			if (e < bestError)
+			{
+				bestError = e;
+				best = p;
+			}
+		}
+
+		error += bestError;
+		indices |= best << (i * 2);
+	}
+
+	out[0] = (unsigned char)(c0 & 0xFF);
+	out[1] = (unsigned char)(c0 >> 8);
+	out[2] = (unsigned char)(c1 & 0xFF);
+	out[3] = (unsigned char)(c1 >> 8);
+	memcpy(&out[4], &indices, 4);
+	return error;
+}
+
+static unsigned int EncodeBC1(const float texels[16][4], unsigned char out[8])
+{
+	float low[4], high[4];
+	FindBlockAxisEnds(texels, 3, low, high);
+	unsigned int error = WriteBC1Block(texels, PackRGB565(high), PackRGB565(low), out);
+
+	// Refit against the palette the indices actually chose
+	static const float weightOfIndex[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	unsigned int indices;
+	memcpy(&indices, &out[4], 4);
+
+	float weights[16];
+	for (int i = 0; i < 16; i++)
+		weights[i] = weightOfIndex[(indices >> (i * 2)) & 3];
+
+	float first[4], second[4];
+	if (RefitEndpoints(texels, weights, 3, first, second))
+	{
+		unsigned char refit[8];
+		unsigned int refitError = WriteBC1Block(texels, PackRGB565(first), PackRGB565(second), refit);
+		if (refitError < error)
+		{
+			memcpy(out, refit, 8);
+			error = refitError;
+		}
+	}
+	return error;
+}
+
+static unsigned int EncodeBC4(const float values[16], unsigned char out[8])
+{
+	float low = 255.0f;
+	float high = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		low = (std::min)(low, values[i]);
+		high = (std::max)(high, values[i]);
+	}
+
+	// Eight value mode, which needs r0 above r1
+	int r0 = (int)(high + 0.5f);
+	int r1 = (int)(low + 0.5f);
+	int palette[8] = { r0, r1 };
+	for (int p = 2; p < 8; p++)
+		palette[p] = ((8 - p) * r0 + (p - 1) * r1 + 3) / 7;
+
+	// Equal ends leave every index at 0
+	int entries = r0 != r1 ? 8 : 1;
+	unsigned long long indices = 0;
+	unsigned int error = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		int value = (int)(values[i] + 0.5f);
+		unsigned long long best = 0;
+		int bestError = 256;
+		for (int p = 0; p < entries; p++)
+		{
+			int e = abs(value - palette[p]);
+			if (e < bestError)
+			{
+				bestError = e;
+				best = p;
+			}
+		}
+		indices |= best << (i * 3);
+		error += bestError * bestError;
+	}
+
+	out[0] = (unsigned char)r0;
+	out[1] = (unsigned char)r1;
+	for (int b = 0; b < 6; b++)
+		out[2 + b] = (unsigned char)(indices >> (b * 8));
+	return error;
+}
+
+// BC7 mode 6: one subset, 7 bit RGBA endpoints with a shared
+// low bit each, and a 4 bit index per texel
+static const int BC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct BC7Mode6Block
+{
+	int endpoints[2][4];	// 7 bit
+	int pBits[2];
+	int indices[16];
+	unsigned int error;
+};
+
+static void PickBC7Indices(const float texels[16][4], BC7Mode6Block* block)
+{
+	int ends[2][4];
+	for (int e = 0; e < 2; e++)
+		for (int c = 0; c < 4; c++)
+			ends[e][c] = (block->endpoints[e][c] << 1) | block->pBits[e];
+
+	int palette[16][4];
+	for (int p = 0; p < 16; p++)
+		for (int c = 0; c < 4; c++)
+			palette[p][c] = ((64 - BC7Weights[p]) * ends[0][c] + BC7Weights[p] * ends[1][c] + 32) >> 6;
+
+	block->error = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		int texel[4];
+		for (int c = 0; c < 4; c++)
+			texel[c] = (int)(texels[i][c] + 0.5f);
+
+		int best = 0;
+		unsigned int bestError = 0xFFFFFFFF;
+		for (int p = 0; p < 16; p++)
+		{
+			unsigned int e = 0;
+			for (int c = 0; c < 4; c++)
+			{
+				int d = texel[c] - palette[p][c];
+				e += d * d;
+			}
+			if (e < bestError)
+			{
+				bestError = e;
+				best = p;
+			}
+		}
+
+		block->indices[i] = best;
+		block->error += bestError;
+	}
+}
+
+/// <summary>
+/// Best of the four p-bit choices for two float endpoints
+/// </summary>
+static BC7Mode6Block FitBC7Mode6(const float texels[16][4], const float first[4], const float second[4])
+{
+	BC7Mode6Block best = {};
+	best.error = 0xFFFFFFFF;
+	for (int p = 0; p < 4; p++)
+	{
+		BC7Mode6Block block = {};
+		block.pBits[0] = p & 1;
+		block.pBits[1] = p >> 1;
+		for (int c = 0; c < 4; c++)
+		{
+			block.endpoints[0][c] = (std::min)((std::max)((int)((first[c] - block.pBits[0]) * 0.5f + 0.5f), 0), 127);
+			block.endpoints[1][c] = (std::min)((std::max)((int)((second[c] - block.pBits[1]) * 0.5f + 0.5f), 0), 127);
+		}
+
+		PickBC7Indices(texels, &block);
+		if (block.error < best.error)
+			best = block;
+	}
+	return best;
+}
+
+static void WriteBits(unsigned char out[16], unsigned int& position, unsigned int value, unsigned int count)
+{
+	for (unsigned int b = 0; b < count; b++, position++)
+	{
+		if (value & (1u << b))
+			out[position >> 3] |= (unsigned char)(1u << (position & 7));
+	}
+}
+
+static unsigned int EncodeBC7(const float texels[16][4], unsigned char out[16])
+{
+	float low[4], high[4];
+	FindBlockAxisEnds(texels, 4, low, high);
+	BC7Mode6Block block = FitBC7Mode6(texels, low, high);
+
+	float weights[16];
+	for (int i = 0; i < 16; i++)
+		weights[i] = BC7Weights[block.indices[i]] / 64.0f;
+
+	float first[4], second[4];
+	if (block.error > 0 && RefitEndpoints(texels, weights, 4, first, second))
+	{
+		BC7Mode6Block refit = FitBC7Mode6(texels, first, second);
+		if (refit.error < block.error)
+			block = refit;
+	}
+
+	// The first texel's index drops its top bit, so it has
+	// to be in the lower half. Swapping the ends flips it
+	if (block.indices[0] >= 8)
+	{
+		for (int c = 0; c < 4; c++)
+			std::swap(block.endpoints[0][c], block.endpoints[1][c]);
+		std::swap(block.pBits[0], block.pBits[1]);
+		for (int i = 0; i < 16; i++)
+			block.indices[i] = 15 - block.indices[i];
+	}
+
+	memset(out, 0, 16);
+	unsigned int position = 0;
+	WriteBits(out, position, 1u << 6, 7);
+	for (int c = 0; c < 4; c++)
+	{
+		WriteBits(out, position, block.endpoints[0][c], 7);
+		WriteBits(out, position, block.endpoints[1][c], 7);
+	}
+	WriteBits(out, position, block.pBits[0], 1);
+	WriteBits(out, position, block.pBits[1], 1);
+	for (int i = 0; i < 16; i++)
+		WriteBits(out, position, block.indices[i], i == 0 ? 3 : 4);
+	return block.error;
+}
+
+double CompressLevel(
+	const unsigned char* rgba,
+	unsigned int width,
+	unsigned int height,
+	unsigned int format,
+	unsigned char* out)
+{
+	if (!IsBlockCompressed(format))
+	{
+		memcpy(out, rgba, (size_t)width * height * 4);
+		return 0.0;
+	}
+
+	double error = 0.0;
+
+	unsigned int blockBytes = CookedFormatBlockBytes(format);
+	unsigned int blocksX = (width + 3) / 4;
+	unsigned int blocksY = (height + 3) / 4;
+	for (unsigned int by = 0; by < blocksY; by++)
+	{
+		for (unsigned int bx = 0; bx < blocksX; bx++)
+		{
+			float texels[16][4];
+			for (unsigned int i = 0; i < 16; i++)
+			{
+				unsigned int x = (std::min)(bx * 4 + (i & 3), width - 1);
+				unsigned int y = (std::min)(by * 4 + (i >> 2), height - 1);
+				const unsigned char* texel = &rgba[((size_t)y * width + x) * 4];
+				for (int c = 0; c < 4; c++)
+					texels[i][c] = texel[c];
+			}
+
+			unsigned char* block = out + ((size_t)by * blocksX + bx) * blockBytes;
+			switch (format)
+			{
+			case COOKED_FORMAT_BC1:
+				error += EncodeBC1(texels, block);
+				break;
+
+			case COOKED_FORMAT_BC4:
+			case COOKED_FORMAT_BC5:
+			{
+				// One BC4 block per channel, red then green
+				int channels = format == COOKED_FORMAT_BC4 ? 1 : 2;
+				for (int c = 0; c < channels; c++)
+				{
+					float values[16];
+					for (int i = 0; i < 16; i++)
+						values[i] = texels[i][c];
+					error += EncodeBC4(values, block + c * 8);
+				}
+				break;
+			}
+
+			case COOKED_FORMAT_BC7:
+				error += EncodeBC7(texels, block);
+				break;
+			}
+		}
+	}
+	return error;
+}
+
+/// <summary>
+/// How many channels a format's block error is summed over
+/// </summary>
+static unsigned int CompressedChannels(unsigned int format)
+{
+	switch (format)
+	{
+	case COOKED_FORMAT_BC1: return 3;
+	case COOKED_FORMAT_BC4: return 1;
+	case COOKED_FORMAT_BC5: return 2;
+	default: return 4;
+	}
+}
+
+/// <summary>
+/// Cooks every level in one format, returning the PSNR of
+/// the top level
+/// </summary>
+static float CookInFormat(
+	const unsigned char* rgba,
+	unsigned int width,
+	unsigned int height,
+	TextureMapType type,
+	unsigned int format,
+	CookedTexture* out)
+{
+	out->format = format;
+	out->data.clear();
+	out->levelOffsets.clear();
+
+	// Direct3D wants the top of a block compressed
+	// texture to be whole blocks
+	std::vector<unsigned char> level(rgba, rgba + (size_t)width * height * 4);
+	if (IsBlockCompressed(format) && (width % 4 != 0 || height % 4 != 0))
+	{
+		std::vector<unsigned char> resized;
+		unsigned int newWidth = (width + 3) / 4 * 4;
+		unsigned int newHeight = (height + 3) / 4 * 4;
+		ResizeImage(level.data(), width, height, newWidth, newHeight, type, resized);
+		level.swap(resized);
+		width = newWidth;
+		height = newHeight;
+	}
+
+	out->width = width;
+	out->height = height;
+
+	// Every mip comes from the uncompressed one above it
+	float psnr = COOKER_LOSSLESS_PSNR;
+	std::vector<unsigned char> next;
+	while (true)
+	{
+		size_t offset = out->data.size();
+		out->levelOffsets.push_back(offset);
+		out->data.resize(offset + CookedLevelBytes(format, width, height));
+		double error = CompressLevel(level.data(), width, height, format, &out->data[offset]);
+
+		// Edge blocks repeat texels, so round the block count up
+		if (offset == 0 && error > 0.0)
+		{
+			double samples = (double)((width + 3) / 4) * ((height + 3) / 4) * 16 * CompressedChannels(format);
+			psnr = (std::min)((float)(10.0 * log10(255.0 * 255.0 * samples / error)), COOKER_LOSSLESS_PSNR);
+		}
+
+		if (width == 1 && height == 1)
+			break;
+
+		DownsampleLevel(level.data(), width, height, type, next);
+		level.swap(next);
+		width = (std::max)(width / 2, 1u);
+		height = (std::max)(height / 2, 1u);
+	}
+	return psnr;
+}
+
+void CookTexture(
+	const unsigned char* rgba,
+	unsigned int width,
+	unsigned int height,
+	TextureMapType type,
+	CookedTexture* out)
+{
+	bool hasAlpha = false;
+	for (size_t i = 0; i < (size_t)width * height && !hasAlpha; i++)
+		hasAlpha = rgba[i * 4 + 3] < 255;
+
+	unsigned int format = ChooseCookedFormat(type, hasAlpha);
+	out->topLevelPSNR = CookInFormat(rgba, width, height, type, format, out);
+
+	// Images with more colors per block than the format
+	// can hold, like dithering, stay uncompressed
+	if (IsBlockCompressed(format) && out->topLevelPSNR < COOKER_MIN_PSNR)
+		out->topLevelPSNR = CookInFormat(rgba, width, height, type, COOKED_FORMAT_RGBA8, out);
+}
+
+// --------------------------------------------------------
+// .dds container
+//
+// The legacy header followed by the DX10 one, which names
+// the format as a DXGI_FORMAT directly.
+// --------------------------------------------------------
+
+#define DDS_MAGIC				0x20534444	// "DDS "
+#define DDS_HEADER_SIZE			124
+#define DDS_PIXEL_FORMAT_SIZE	32
+#define DDS_DX10_HEADER_SIZE	20
+#define DDS_FOURCC_DX10			0x30315844	// "DX10"
+
+#define DDSD_CAPS			0x1
+#define DDSD_HEIGHT			0x2
+#define DDSD_WIDTH			0x4
+#define DDSD_PIXELFORMAT	0x1000
+#define DDSD_MIPMAPCOUNT	0x20000
+#define DDSD_LINEARSIZE		0x80000
+#define DDPF_FOURCC			0x4
+#define DDSCAPS_COMPLEX		0x8
+#define DDSCAPS_TEXTURE		0x1000
+#define DDSCAPS_MIPMAP		0x400000
+#define DDSCAPS2_CUBEMAP_ALL	0xFE00	// The cube flag and all six faces
+#define DDS_DIMENSION_TEXTURE2D	3
+#define DDS_MISC_TEXTURECUBE	0x4
+
+static void WriteUInt(std::vector<unsigned char>& file, unsigned int value)
+{
+	for (int b = 0; b < 4; b++)
+		file.push_back((unsigned char)(value >> (b * 8)));
+}
+
+static unsigned int ReadUInt(const unsigned char* data)
+{
+	return data[0] | (data[1] << 8) | (data[2] << 16) | ((unsigned int)data[3] << 24);
+}
+
+static void WriteHeaders(
+	std::vector<unsigned char>& file,
+	unsigned int width,
+	unsigned int height,
+	unsigned int levelCount,
+	unsigned int format,
+	bool cube)
+{
+	WriteUInt(file, DDS_MAGIC);
+	WriteUInt(file, DDS_HEADER_SIZE);
+	WriteUInt(file, DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE);
+	WriteUInt(file, height);
+	WriteUInt(file, width);
+	WriteUInt(file, (unsigned int)CookedLevelBytes(format, width, height));
+	WriteUInt(file, 0);		// Depth
+	WriteUInt(file, levelCount);
+	for (int i = 0; i < 11; i++)
+		WriteUInt(file, 0);
+
+	WriteUInt(file, DDS_PIXEL_FORMAT_SIZE);
+	WriteUInt(file, DDPF_FOURCC);
+	WriteUInt(file, DDS_FOURCC_DX10);
+	for (int i = 0; i < 5; i++)
+		WriteUInt(file, 0);
+
+	WriteUInt(file, DDSCAPS_COMPLEX | DDSCAPS_TEXTURE | DDSCAPS_MIPMAP);
+	WriteUInt(file, cube ? DDSCAPS2_CUBEMAP_ALL : 0);
+	for (int i = 0; i < 3; i++)
+		WriteUInt(file, 0);
+
+	WriteUInt(file, format);
+	WriteUInt(file, DDS_DIMENSION_TEXTURE2D);
+	WriteUInt(file, cube ? DDS_MISC_TEXTURECUBE : 0);
+	WriteUInt(file, 1);		// Array size, which counts whole cubes
+	WriteUInt(file, 0);		// Alpha mode unknown
+}
+
+void WriteCookedTexture(const CookedTexture& texture, std::vector<unsigned char>& file)
+{
+	file.clear();
+	file.reserve(COOKED_TEXTURE_HEADER_SIZE + texture.data.size());
+
+	WriteHeaders(file, texture.width, texture.height, (unsigned int)texture.levelOffsets.size(), texture.format, false);
+	file.insert(file.end(), texture.data.begin(), texture.data.end());
+}
+
+void WriteCookedCubemap(
+	unsigned int size,
+	unsigned int levelCount,
+	unsigned int format,
+	const std::vector<unsigned char>& data,
+	std::vector<unsigned char>& file)
+{
+	file.clear();
+	file.reserve(COOKED_TEXTURE_HEADER_SIZE + data.size());
+
+	WriteHeaders(file, size, size, levelCount, format, true);
+	file.insert(file.end(), data.begin(), data.end());
+}
+
+bool ReadCookedTextureHeader(const unsigned char* data, size_t size, CookedTextureInfo* out)
+{
+	const size_t headersSize = COOKED_TEXTURE_HEADER_SIZE;
+	if (size < headersSize ||
+		ReadUInt(data) != DDS_MAGIC ||
+		ReadUInt(data + 4) != DDS_HEADER_SIZE ||
+		ReadUInt(data + 4 + 80) != DDS_FOURCC_DX10)
+		return false;
+
+	const unsigned char* dx10 = data + 4 + DDS_HEADER_SIZE;
+	out->height = ReadUInt(data + 12);
+	out->width = ReadUInt(data + 16);
+	out->levelCount = (std::max)(ReadUInt(data + 28), 1u);
+	out->format = ReadUInt(dx10);
+	if (ReadUInt(dx10 + 4) != DDS_DIMENSION_TEXTURE2D ||
+		ReadUInt(dx10 + 8) != 0 ||
+		ReadUInt(dx10 + 12) != 1 ||
+		CookedFormatBlockBytes(out->format) == 0 ||
+		out->width == 0 || out->height == 0 ||
+		out->levelCount > 16)
+		return false;
+
+	size_t offset = headersSize;
+	for (unsigned int i = 0; i < out->levelCount; i++)
+	{
+		unsigned int width = (std::max)(out->width >> i, 1u);
+		unsigned int height = (std::max)(out->height >> i, 1u);
+		out->levelOffsets[i] = offset;
+		out->levelSizes[i] = CookedLevelBytes(out->format, width, height);
+		offset += out->levelSizes[i];
+	}
+
+	out->fileSize = offset;
+	return true;
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Turn source images into block compressed textures
+//			with their whole mip chain, stored as .dds so the
+//			engine uploads them as they are. Mips are filtered
+//			the way each kind of map needs, colors in linear
+//			space and normals renormalized. It needs no GPU,
+//			so cooking can run on any machine.
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+// DXGI_FORMAT values of what the cooker writes
+#define COOKED_FORMAT_RGBA16F	10
+#define COOKED_FORMAT_RGBA8	28
+#define COOKED_FORMAT_BC1	71
+#define COOKED_FORMAT_BC4	80
+#define COOKED_FORMAT_BC5	83
+#define COOKED_FORMAT_BC7	98
+
+// Where cooked textures live, relative to the Assets folder
+#define COOKED_TEXTURE_FOLDER "Cooked/"
+
+/// <summary>
+/// What a texture holds decides both how its mips are
+/// filtered and how it is compressed
+/// </summary>
+enum class TextureMapType
+{
+	Albedo,		// Gamma encoded color, BC7
+	Color,		// Any other image, BC1 unless it has alpha
+	Normal,		// Tangent space xy, BC5 with z rebuilt in the shader
+	Mask,		// One linear channel like roughness, BC4
+	Packed		// Linear masks packed per channel, BC7
+};
+
+// Single channel maps are packed into one texture named
+// like them with _orm: Textures/wood_orm.png packs
+// wood_ao, wood_roughness, wood_metal and wood_height
+#define ORM_CHANNEL_COUNT 4
+#define ORM_SUFFIX "_orm"
+
+/// <summary>
+/// A cooked texture, every level packed one after another
+/// starting with the largest
+/// </summary>
+struct CookedTexture
+{
+	unsigned int width;
+	unsigned int height;
+	unsigned int format;
+	float topLevelPSNR;		// Against the source, in dB
+	std::vector<unsigned char> data;
+	std::vector<size_t> levelOffsets;
+};
+
+// The .dds magic plus both headers, all a cooked file has
+// before its first level
+#define COOKED_TEXTURE_HEADER_SIZE 148
+
+/// <summary>
+/// Where every level of a cooked file is, from its headers.
+/// Offsets count from the start of the file
+/// </summary>
+struct CookedTextureInfo
+{
+	unsigned int width;
+	unsigned int height;
+	unsigned int format;
+	unsigned int levelCount;
+	size_t levelOffsets[16];
+	size_t levelSizes[16];
+	size_t fileSize;
+};
+
+// Guessed from the file name: _albedo, _normals, the _orm
+// channels and _orm itself, anything else is a plain color image
+TextureMapType ClassifyTexture(const std::string& fileName);
+unsigned int ChooseCookedFormat(TextureMapType type, bool hasAlpha);
+
+// Textures/wood_albedo.png is cooked to Cooked/Textures/wood_albedo.dds
+std::string CookedTexturePath(const std::string& sourcePath);
+
+// Textures/wood_orm.png with channel 1 is Textures/wood_roughness.png.
+// The other way round, a channel map gives its packed texture
+// and which channel it goes in, or an empty string
+bool IsOrmTexture(const std::string& path);
+std::string OrmChannelSource(const std::string& ormPath, unsigned int channel);
+std::string OrmTextureOf(const std::string& sourcePath, unsigned int* channel);
+
+/// <summary>
+/// Packs the red channel of each source into one RGBA8 image
+/// the size of the largest, in the order occlusion, roughness,
+/// metalness, height. Null sources take a default that leaves
+/// the surface unchanged: no occlusion, fully rough, not metal
+/// </summary>
+void PackOrmTexture(
+	const unsigned char* const sources[ORM_CHANNEL_COUNT],
+	const unsigned int widths[ORM_CHANNEL_COUNT],
+	const unsigned int heights[ORM_CHANNEL_COUNT],
+	std::vector<unsigned char>& out,
+	unsigned int* width,
+	unsigned int* height);
+
+// Bytes of one block, or of one texel when not block compressed
+unsigned int CookedFormatBlockBytes(unsigned int format);
+bool IsBlockCompressed(unsigned int format);
+size_t CookedLevelBytes(unsigned int format, unsigned int width, unsigned int height);
+
+/// <summary>
+/// Box filters one level down to the next, in the space that
+/// suits the map type. Sizes round down and never reach 0
+/// </summary>
+void DownsampleLevel(
+	const unsigned char* rgba,
+	unsigned int width,
+	unsigned int height,
+	TextureMapType type,
+	std::vector<unsigned char>& out);
+
+/// <summary>
+/// Bilinear resize, used to bring block compressed textures
+/// to a multiple of 4 which Direct3D requires
+/// </summary>
+void ResizeImage(
+	const unsigned char* rgba,
+	unsigned int width,
+	unsigned int height,
+	unsigned int newWidth,
+	unsigned int newHeight,
+	TextureMapType type,
+	std::vector<unsigned char>& out);
+
+/// <summary>
+/// Compresses an RGBA8 level into blocks of the given format,
+/// returning the summed squared error of every block. Edge
+/// blocks repeat their last row and column
+/// </summary>
+double CompressLevel(
+	const unsigned char* rgba,
+	unsigned int width,
+	unsigned int height,
+	unsigned int format,
+	unsigned char* out);
+
+/// <summary>
+/// Resizes if needed, builds every mip and compresses them.
+/// Falls back to RGBA8 when the format loses too much
+/// </summary>
+void CookTexture(
+	const unsigned char* rgba,
+	unsigned int width,
+	unsigned int height,
+	TextureMapType type,
+	CookedTexture* out);
+
+// .dds with the DX10 header, readable by DirectXTK's loader.
+// Only the headers are needed to find a level, so a level
+// can be read without reading the ones above it
+void WriteCookedTexture(const CookedTexture& texture, std::vector<unsigned char>& file);
+
+// A cube in the same container. Data holds the faces in the
+// order +X -X +Y -Y +Z -Z, each with all of its levels
+void WriteCookedCubemap(
+	unsigned int size,
+	unsigned int levelCount,
+	unsigned int format,
+	const std::vector<unsigned char>& data,
+	std::vector<unsigned char>& file);
+bool ReadCookedTextureHeader(const unsigned char* data, size_t size, CookedTextureInfo* out);
@@ -0,0 +1,511 @@
+#include "TextureStreaming.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string.h>
+
+unsigned int TextureMipCount(unsigned int width, unsigned int height)
+{
+	unsigned int size = (std::max)(width, height);
+	unsigned int count = 1;
+	while (size > 1)
+	{
+		size >>= 1;
+		count++;
+	}
+	return count;
+}
+
+unsigned int TextureBaseMip(unsigned int width, unsigned int height)
+{
+	unsigned int size = (std::max)(width, height);
+	unsigned int mip = 0;
+	while (size > TEXTURE_STREAM_BASE_SIZE)
+	{
+		size >>= 1;
+		mip++;
+	}
+	return mip;
+}
+
+size_t TextureMipChainBytes(unsigned int width, unsigned int height, unsigned int firstMip)
+{
+	size_t bytes = 0;
+	unsigned int count = TextureMipCount(width, height);
+	for (unsigned int mip = firstMip; mip < count; mip++)
+	{
+		size_t w = (std::max)(width >> mip, 1u);
+		size_t h = (std::max)(height >> mip, 1u);
+		bytes += w * h * TEXTURE_STREAM_TEXEL_BYTES;
+	}
+	return bytes;
+}
+
+float EstimateScreenDiameter(
+	const float center[3],
+	float radius,
+	const float cameraPosition[3],
+	const float cameraForward[3],
+	float projScaleY,
+	float screenHeight)
+{
+	float toCenter[3] =
+	{
+		center[0] - cameraPosition[0],
+		center[1] - cameraPosition[1],
+		center[2] - cameraPosition[2]
+	};
+
+	float depth =
+		toCenter[0] * cameraForward[0] +
+		toCenter[1] * cameraForward[1] +
+		toCenter[2] * cameraForward[2];
+	if (depth < -radius)
+		return 0.0f;
+
+	// Inside the sphere it could be covering the whole screen
+	float distance = std::sqrt(
+		toCenter[0] * toCenter[0] +
+		toCenter[1] * toCenter[1] +
+		toCenter[2] * toCenter[2]);
+	if (distance <= radius)
+		return screenHeight;
+
+	return radius / distance * projScaleY * screenHeight;
+}
+
+unsigned int ComputeDesiredMip(
+	unsigned int width,
+	unsigned int height,
+	float uvScale,
+	float screenDiameter)
+{
+	// Texels of the whole repeated texture per pixel of the
+	// object. Every doubling of that is one mip coarser
+	float texels = (std::max)(width, height) * (std::max)(uvScale, 0.0001f);
+	float ratio = texels / (std::max)(screenDiameter, 1.0f);
+	if (ratio <= 1.0f)
+		return 0;
+
+	unsigned int mip = (unsigned int)std::floor(std::log2(ratio));
+	return (std::min)(mip, TextureMipCount(width, height) - 1);
+}
+
+void BuildMipChain(
+	const unsigned char* rgba,
+	unsigned int width,
+	unsigned int height,
+	std::vector<unsigned char>& levels,
+	std::vector<size_t>& levelOffsets)
+{
+	levels.resize(TextureMipChainBytes(width, height, 0));
+	levelOffsets.clear();
+
+	memcpy(levels.data(), rgba, (size_t)width * height * TEXTURE_STREAM_TEXEL_BYTES);
+	levelOffsets.push_back(0);
+
+	unsigned int w = width;
+	unsigned int h = height;
+	size_t offset = 0;
+	while (w > 1 || h > 1)
+	{
+		unsigned int nw = (std::max)(w / 2, 1u);
+		unsigned int nh = (std::max)(h / 2, 1u);
+		size_t nextOffset = offset + (size_t)w * h * TEXTURE_STREAM_TEXEL_BYTES;
+
+		const unsigned char* src = &levels[offset];
+		unsigned char* dst = &levels[nextOffset];
+		for (unsigned int y = 0; y < nh; y++)
+		{
+			// Odd sizes reuse their last row or column
+			unsigned int y0 = (std::min)(y * 2, h - 1);
+			unsigned int y1 = (std::min)(y * 2 + 1, h - 1);
+			for (unsigned int x = 0; x < nw; x++)
+			{
+				unsigned int x0 = (std::min)(x * 2, w - 1);
+				unsigned int x1 = (std::min)(x * 2 + 1, w - 1);
+				for (unsigned int c = 0; c < TEXTURE_STREAM_TEXEL_BYTES; c++)
+				{
+					unsigned int sum =
+						src[((size_t)y0 * w + x0) * TEXTURE_STREAM_TEXEL_BYTES + c] +
+						src[((size_t)y0 * w + x1) * TEXTURE_STREAM_TEXEL_BYTES + c] +
+						src[((size_t)y1 * w + x0) * TEXTURE_STREAM_TEXEL_BYTES + c] +
+						src[((size_t)y1 * w + x1) * TEXTURE_STREAM_TEXEL_BYTES + c];
+					dst[((size_t)y * nw + x) * TEXTURE_STREAM_TEXEL_BYTES + c] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+
+		levelOffsets.push_back(nextOffset);
+		offset = nextOffset;
+		w = nw;
+		h = nh;
+	}
+}
+
+TextureStreamer::TextureStreamer() :
+	budgetBytes(64 * 1024 * 1024),
+	residentBytes(0),
+	pendingBytes(0),
+	frame(0),
+	loads(0),
+	evictions(0)
+{
+}
+
+unsigned int TextureStreamer::Register()
+{
+	Texture texture = {};
+	texture.baseMip = 0;
+	texture.residentMip = TEXTURE_STREAM_NOT_RESIDENT;
+	texture.desiredMip = TEXTURE_STREAM_BASE_MIP;
+	texture.pendingMip = TEXTURE_STREAM_NOT_RESIDENT;
+	textures.push_back(texture);
+	return (unsigned int)textures.size() - 1;
+}
+
+void TextureStreamer::BeginFrame()
+{
+	frame++;
+}
+
+void TextureStreamer::Request(unsigned int texture, float uvScale, float screenDiameter)
+{
+	Texture& t = textures[texture];
+
+	// Until the first load comes back only the base is wanted
+	unsigned int desired = t.width == 0 ?
+		TEXTURE_STREAM_BASE_MIP :
+		(std::min)(ComputeDesiredMip(t.width, t.height, uvScale, screenDiameter), t.baseMip);
+
+	// Several things can share a texture, the biggest wins
+	if (t.lastUsedFrame != frame)
+	{
+		t.lastUsedFrame = frame;
+		t.desiredMip = desired;
+		t.priority = screenDiameter;
+	}
+	else
+	{
+		t.desiredMip = (std::min)(t.desiredMip, desired);
+		t.priority = (std::max)(t.priority, screenDiameter);
+	}
+}
+
+size_t TextureStreamer::ResidentBytes(const Texture& texture) const
+{
+	if (texture.residentMip == TEXTURE_STREAM_NOT_RESIDENT)
+		return 0;
+	return TextureMipChainBytes(texture.width, texture.height, texture.residentMip);
+}
+
+bool TextureStreamer::MakeRoom(size_t extraBytes, unsigned int except, std::vector<TextureStreamCommand>& commands)
+{
+	if (residentBytes + pendingBytes + extraBytes <= budgetBytes)
+		return true;
+
+	// Anything not seen this frame can go down to its base
+	// mip, anything seen only down to what it needs. Check
+	// it can fit at all before evicting anything
+	size_t freeable = 0;
+	for (unsigned int i = 0; i < textures.size(); i++)
+	{
+		const Texture& t = textures[i];
+		if (i == except || t.pendingMip != TEXTURE_STREAM_NOT_RESIDENT || t.residentMip >= t.baseMip)
+			continue;
+
+		unsigned int floor = t.lastUsedFrame == frame ? t.desiredMip : t.baseMip;
+		if (t.residentMip < floor)
+			freeable += ResidentBytes(t) - TextureMipChainBytes(t.width, t.height, floor);
+	}
+	if (residentBytes + pendingBytes + extraBytes > budgetBytes + freeable)
+		return false;
+
+	while (residentBytes + pendingBytes + extraBytes > budgetBytes)
+	{
+		// Least recently used first, and between textures
+		// seen this frame the one with the most to spare
+		unsigned int victim = TEXTURE_STREAM_NOT_RESIDENT;
+		for (unsigned int i = 0; i < textures.size(); i++)
+		{
+			const Texture& t = textures[i];
+			if (i == except || t.pendingMip != TEXTURE_STREAM_NOT_RESIDENT || t.residentMip >= t.baseMip)
+				continue;
+
+			bool seen = t.lastUsedFrame == frame;
+			if (seen && t.residentMip >= t.desiredMip)
+				continue;
+
+			if (victim == TEXTURE_STREAM_NOT_RESIDENT)
+			{
+				victim = i;
+				continue;
+			}
+
+			const Texture& v = textures[victim];
+			if (t.lastUsedFrame < v.lastUsedFrame ||
+				(t.lastUsedFrame == v.lastUsedFrame &&
+					(int)t.desiredMip - (int)t.residentMip > (int)v.desiredMip - (int)v.residentMip))
+				victim = i;
+		}
+
+		if (victim == TEXTURE_STREAM_NOT_RESIDENT)
+			return false;
+
+		// One mip at a time, finest first
+		Texture& v = textures[victim];
+		size_t before = ResidentBytes(v);
+		v.residentMip++;
+		residentBytes -= before - ResidentBytes(v);
+		evictions++;
+
+		TextureStreamCommand command = { TextureStreamCommandType::Evict, victim, v.residentMip };
+		commands.push_back(command);
+	}
+
+	return true;
+}
+
+void TextureStreamer::Update(std::vector<TextureStreamCommand>& commands)
+{
+	// The budget may have been lowered since last frame
+	MakeRoom(0, TEXTURE_STREAM_NOT_RESIDENT, commands);
+
+	unsigned int inFlight = 0;
+	candidates.clear();
+	for (unsigned int i = 0; i < textures.size(); i++)
+	{
+		const Texture& t = textures[i];
+		if (t.pendingMip != TEXTURE_STREAM_NOT_RESIDENT)
+		{
+			inFlight++;
+			continue;
+		}
+
+		if (t.failed || t.lastUsedFrame != frame)
+			continue;
+
+		if (t.residentMip == TEXTURE_STREAM_NOT_RESIDENT || t.desiredMip < t.residentMip)
+			candidates.push_back(i);
+	}
+
+	// Textures with nothing at all come first, then
+	// whatever covers the most of the screen
+	std::sort(candidates.begin(), candidates.end(), [this](unsigned int a, unsigned int b)
+	{
+		bool aMissing = textures[a].residentMip == TEXTURE_STREAM_NOT_RESIDENT;
+		bool bMissing = textures[b].residentMip == TEXTURE_STREAM_NOT_RESIDENT;
+		if (aMissing != bMissing)
+			return aMissing;
+		return textures[a].priority > textures[b].priority;
+	});
+
+	for (unsigned int index : candidates)
+	{
+		if (inFlight >= TEXTURE_STREAM_MAX_IN_FLIGHT)
+			break;
+
+		Texture& t = textures[index];
+		unsigned int target = TEXTURE_STREAM_NOT_RESIDENT;
+		size_t extra = 0;
+
+		if (t.residentMip == TEXTURE_STREAM_NOT_RESIDENT)
+		{
+			// Size is not known yet, so this is a guess
+			extra = TextureMipChainBytes(TEXTURE_STREAM_BASE_SIZE, TEXTURE_STREAM_BASE_SIZE, 0);
+			if (MakeRoom(extra, index, commands))
+				target = TEXTURE_STREAM_BASE_MIP;
+		}
+		else
+		{
+			// Settle for a coarser mip than wanted if
+			// that is all the budget has room for
+			size_t resident = ResidentBytes(t);
+			for (unsigned int mip = t.desiredMip; mip < t.residentMip; mip++)
+			{
+				extra = TextureMipChainBytes(t.width, t.height, mip) - resident;
+				if (MakeRoom(extra, index, commands))
+				{
+					target = mip;
+					break;
+				}
+			}
+		}
+
+		if (target == TEXTURE_STREAM_NOT_RESIDENT)
+			continue;
+
+		t.pendingMip = target;
+		t.pendingBytes = extra;
+		pendingBytes += extra;
+		loads++;
+		inFlight++;
+
+		TextureStreamCommand command = { TextureStreamCommandType::Load, index, target };
+		commands.push_back(command);
+	}
+}
+
+void TextureStreamer::CompleteLoad(unsigned int texture, unsigned int mip, unsigned int width, unsigned int height)
+{
+	Texture& t = textures[texture];
+	pendingBytes -= t.pendingBytes;
+	t.pendingBytes = 0;
+	t.pendingMip = TEXTURE_STREAM_NOT_RESIDENT;
+
+	size_t before = ResidentBytes(t);
+	if (t.width == 0)
+	{
+		t.width = width;
+		t.height = height;
+		t.baseMip = TextureBaseMip(width, height);
+		t.desiredMip = t.baseMip;
+	}
+
+	t.residentMip = mip;
+	residentBytes = residentBytes - before + ResidentBytes(t);
+}
+
+void TextureStreamer::FailLoad(unsigned int texture)
+{
+	Texture& t = textures[texture];
+	pendingBytes -= t.pendingBytes;
+	t.pendingBytes = 0;
+	t.pendingMip = TEXTURE_STREAM_NOT_RESIDENT;
+	t.failed = true;
+}
+
+TextureStreamStats TextureStreamer::GetStats() const
+{
+	TextureStreamStats stats = {};
+	stats.textureCount = (unsigned int)textures.size();
+	stats.budgetBytes = budgetBytes;
+	stats.residentBytes = residentBytes;
+	stats.pendingBytes = pendingBytes;
+	stats.loads = loads;
+	stats.evictions = evictions;
+	for (auto& t : textures)
+	{
+		if (t.residentMip != TEXTURE_STREAM_NOT_RESIDENT)
+			stats.residentCount++;
+		if (t.pendingMip != TEXTURE_STREAM_NOT_RESIDENT)
+			stats.pendingCount++;
+		if (t.width > 0)
+			stats.fullBytes += TextureMipChainBytes(t.width, t.height, 0);
+	}
+	return stats;
+}
+
+TextureStreamingSimResult SimulateTextureStreaming(const TextureStreamingSimSettings& settings)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	struct PendingLoad
+	{
+		unsigned int texture;
+		unsigned int mip;
+		unsigned int dueFrame;
+	};
+
+	TextureStreamingSimResult result = {};
+
+	// One object every six units down +z, each with a texture
+	// of its own. Every other one is half the size
+	const float spacing = 6.0f;
+	const float radius = 1.5f;
+	TextureStreamer streamer;
+	streamer.SetBudget(settings.budgetBytes);
+	std::vector<unsigned int> sizes(settings.objectCount);
+	for (unsigned int i = 0; i < settings.objectCount; i++)
+	{
+		streamer.Register();
+		sizes[i] = (i % 2) ? settings.textureSize / 2 : settings.textureSize;
+		result.fullBytes += TextureMipChainBytes(sizes[i], sizes[i], 0);
+	}
+
+	// There and back again, looking the way it walks
+	float length = settings.objectCount * spacing + 10.0f;
+	std::vector<TextureStreamCommand> commands;
+	std::vector<PendingLoad> pending;
+	double updateSeconds = 0;
+	double deficit = 0;
+	unsigned long long deficitSamples = 0;
+	for (unsigned int f = 0; f < settings.frames; f++)
+	{
+		float t = (float)f / (std::max)(settings.frames - 1, 1u) * 2.0f;
+		bool returning = t > 1.0f;
+		float position[3] = { 0.0f, 0.0f, -5.0f + length * (returning ? 2.0f - t : t) };
+		float forward[3] = { 0.0f, 0.0f, returning ? -1.0f : 1.0f };
+
+		// Loads that have finished come back first
+		for (size_t p = 0; p < pending.size();)
+		{
+			if (pending[p].dueFrame > f)
+			{
+				p++;
+				continue;
+			}
+
+			unsigned int size = sizes[pending[p].texture];
+			unsigned int mip = pending[p].mip == TEXTURE_STREAM_BASE_MIP ? TextureBaseMip(size, size) : pending[p].mip;
+			streamer.CompleteLoad(pending[p].texture, mip, size, size);
+			pending[p] = pending.back();
+			pending.pop_back();
+		}
+
+		streamer.BeginFrame();
+		for (unsigned int i = 0; i < settings.objectCount; i++)
+		{
+			float center[3] = { 0.0f, 0.0f, i * spacing };
+			float diameter = EstimateScreenDiameter(center, radius, position, forward, 1.732f, 720.0f);
+			if (diameter > 0.0f)
+				streamer.Request(i, 1.0f, diameter);
+		}
+
+		commands.clear();
+		auto start = Clock::now();
+		streamer.Update(commands);
+		updateSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+		for (auto& c : commands)
+		{
+			if (c.type == TextureStreamCommandType::Load)
+			{
+				PendingLoad load = { c.texture, c.mip, f + settings.loadLatencyFrames };
+				pending.push_back(load);
+			}
+		}
+
+		TextureStreamStats stats = streamer.GetStats();
+		result.peakResidentBytes = (std::max)(result.peakResidentBytes, stats.residentBytes);
+		if (stats.residentBytes > settings.budgetBytes)
+			result.overBudgetFrames++;
+
+		// How far from what they want the close ones are
+		for (unsigned int i = 0; i < settings.objectCount; i++)
+		{
+			float center[3] = { 0.0f, 0.0f, i * spacing };
+			float diameter = EstimateScreenDiameter(center, radius, position, forward, 1.732f, 720.0f);
+			if (diameter < 32.0f)
+				continue;
+
+			unsigned int desired = (std::min)(
+				ComputeDesiredMip(sizes[i], sizes[i], 1.0f, diameter),
+				TextureBaseMip(sizes[i], sizes[i]));
+			unsigned int resident = streamer.GetResidentMip(i);
+			if (resident == TEXTURE_STREAM_NOT_RESIDENT)
+				resident = TextureMipCount(sizes[i], sizes[i]);
+
+			deficit += resident > desired ? resident - desired : 0;
+			deficitSamples++;
+		}
+	}
+
+	TextureStreamStats stats = streamer.GetStats();
+	result.loads = stats.loads;
+	result.evictions = stats.evictions;
+	result.averageMipDeficit = deficitSamples > 0 ? (float)(deficit / deficitSamples) : 0.0f;
+	result.updateMS = settings.frames > 0 ? (float)(updateSeconds * 1000.0 / settings.frames) : 0.0f;
+	return result;
+}
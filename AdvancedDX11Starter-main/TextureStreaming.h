@@ -0,0 +1,183 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Decide which mips of which textures are resident.
+//			Textures start with nothing loaded, get their small
+//			base mips the first time something using them is
+//			seen and finer mips as they take up more of the
+//			screen. A memory budget is kept by dropping mips of
+//			the least recently used textures. The policy only
+//			hands out loads and evictions for the caller to
+//			carry out, so it can be run without any textures.
+
+#include <vector>
+#include <stddef.h>
+
+// Largest side of the mip every texture is first loaded at
+#define TEXTURE_STREAM_BASE_SIZE 64
+
+// Loads handed out that have not come back yet
+#define TEXTURE_STREAM_MAX_IN_FLIGHT 4
+
+// Resident mip of a texture with nothing loaded
+#define TEXTURE_STREAM_NOT_RESIDENT 0xFFFFFFFF
+
+// Mip of a first load, before the texture's size is known
+#define TEXTURE_STREAM_BASE_MIP 0xFFFFFFFE
+
+// Streamed textures are always RGBA8
+#define TEXTURE_STREAM_TEXEL_BYTES 4
+
+enum class TextureStreamCommandType
+{
+	Load,	// Make mip and everything smaller resident
+	Evict	// Drop everything finer than mip
+};
+
+struct TextureStreamCommand
+{
+	TextureStreamCommandType type;
+	unsigned int texture;
+	unsigned int mip;
+};
+
+struct TextureStreamStats
+{
+	unsigned int textureCount;
+	unsigned int residentCount;
+	unsigned int pendingCount;
+	size_t budgetBytes;
+	size_t residentBytes;
+	size_t pendingBytes;
+	size_t fullBytes;			// Every texture seen so far at full size
+	unsigned long long loads;
+	unsigned long long evictions;
+};
+
+// Mip sizes, counts and bytes of an RGBA8 chain
+unsigned int TextureMipCount(unsigned int width, unsigned int height);
+unsigned int TextureBaseMip(unsigned int width, unsigned int height);
+size_t TextureMipChainBytes(unsigned int width, unsigned int height, unsigned int firstMip);
+
+/// <summary>
+/// Rough diameter in pixels of a bounding sphere on screen.
+/// projScaleY is the projection's y scale, 1 / tan(fov / 2).
+/// Zero when the sphere is entirely behind the camera
+/// </summary>
+float EstimateScreenDiameter(
+	const float center[3],
+	float radius,
+	const float cameraPosition[3],
+	const float cameraForward[3],
+	float projScaleY,
+	float screenHeight);
+
+/// <summary>
+/// Finest mip worth having when the texture is repeated
+/// uvScale times across something screenDiameter pixels wide
+/// </summary>
+unsigned int ComputeDesiredMip(
+	unsigned int width,
+	unsigned int height,
+	float uvScale,
+	float screenDiameter);
+
+/// <summary>
+/// Box filters an RGBA8 image down to 1x1. Levels are packed
+/// one after another, starting with the image itself
+/// </summary>
+void BuildMipChain(
+	const unsigned char* rgba,
+	unsigned int width,
+	unsigned int height,
+	std::vector<unsigned char>& levels,
+	std::vector<size_t>& levelOffsets);
+
+/// <summary>
+/// Residency of every streamed texture. Requests come in every
+/// frame, Update turns them into loads and evictions, and the
+/// loads are reported back as they finish
+/// </summary>
+class TextureStreamer
+{
+public:
+	TextureStreamer();
+
+	// Size is learned from the first load
+	unsigned int Register();
+	void SetBudget(size_t bytes) { budgetBytes = bytes; }
+	size_t GetBudget() const { return budgetBytes; }
+
+	// Requests are only kept for the frame they were made in
+	void BeginFrame();
+	void Request(unsigned int texture, float uvScale, float screenDiameter);
+
+	// Loads that fit, most needed first, and whatever has to
+	// be evicted to make them fit. Evictions take effect now
+	void Update(std::vector<TextureStreamCommand>& commands);
+
+	// Mip is what was actually loaded. A failed load is
+	// never tried again
+	void CompleteLoad(unsigned int texture, unsigned int mip, unsigned int width, unsigned int height);
+	void FailLoad(unsigned int texture);
+
+	unsigned int GetResidentMip(unsigned int texture) const { return textures[texture].residentMip; }
+	unsigned int GetDesiredMip(unsigned int texture) const { return textures[texture].desiredMip; }
+	bool IsPending(unsigned int texture) const { return textures[texture].pendingMip != TEXTURE_STREAM_NOT_RESIDENT; }
+	TextureStreamStats GetStats() const;
+
+private:
+	struct Texture
+	{
+		unsigned int width;
+		unsigned int height;
+		unsigned int baseMip;
+		unsigned int residentMip;
+		unsigned int desiredMip;
+		unsigned int pendingMip;
+		size_t pendingBytes;
+		float priority;
+		unsigned long long lastUsedFrame;
+		bool failed;
+	};
+
+	size_t ResidentBytes(const Texture& texture) const;
+
+	// Evicts until extraBytes more fit in the budget
+	bool MakeRoom(size_t extraBytes, unsigned int except, std::vector<TextureStreamCommand>& commands);
+
+	std::vector<Texture> textures;
+	std::vector<unsigned int> candidates;
+	size_t budgetBytes;
+	size_t residentBytes;
+	size_t pendingBytes;
+	unsigned long long frame;
+	unsigned long long loads;
+	unsigned long long evictions;
+};
+
+/// <summary>
+/// A camera walking down a corridor of textured objects and
+/// back, with loads that take a few frames to come back
+/// </summary>
+struct TextureStreamingSimSettings
+{
+	unsigned int objectCount;
+	unsigned int textureSize;
+	size_t budgetBytes;
+	unsigned int frames;
+	unsigned int loadLatencyFrames;
+};
+
+struct TextureStreamingSimResult
+{
+	size_t fullBytes;			// Everything at full size, no streaming
+	size_t peakResidentBytes;
+	unsigned int overBudgetFrames;
+	unsigned long long loads;
+	unsigned long long evictions;
+	float averageMipDeficit;	// Resident minus desired mip of what is seen
+	float updateMS;				// Average Update per frame
+};
+
+TextureStreamingSimResult SimulateTextureStreaming(const TextureStreamingSimSettings& settings);
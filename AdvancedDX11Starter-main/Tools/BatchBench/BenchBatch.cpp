@@ -0,0 +1,47 @@
+// Developer: Narai
+// Purpose: Headless check of static batching. Scatters boxes
+//			sharing a handful of materials, merges them into
+//			chunk batches and checks every merged vertex landed
+//			where its instance put it, inside its batch's
+//			bounds, reporting how many draws are left.
+//
+// Build and run on Linux, from this folder:
+//
+//		g++ -O2 -std=c++14 -I../.. BenchBatch.cpp ../../StaticBatch.cpp -o BenchBatch
+//		./BenchBatch
+//
+// Options: -k <keys>, the materials boxes are spread over,
+// 4 by default.
+
+#include "StaticBatch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char** argv)
+{
+	unsigned int keys = 4;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-k") == 0 && i + 1 < argc)
+			keys = (unsigned int)atoi(argv[++i]);
+		else
+		{
+			printf("Usage: %s [-k keys]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	int failures = 0;
+	const unsigned int counts[] = { 1000, 10000, 100000 };
+	for (unsigned int instances : counts)
+	{
+		StaticBatchBenchmark b = BenchmarkStaticBatching(instances, keys);
+		printf("%6u instances, %u keys: %5u batches, %6u draws instead of %6u, %8u vertices, %8.3f ms, %u mismatched\n",
+			b.instanceCount, b.keyCount, b.batchCount, b.drawsAfter, b.drawsBefore, b.vertexCount, b.buildMS, b.mismatches);
+		if (b.mismatches > 0)
+			failures++;
+	}
+	return failures == 0 ? 0 : 1;
+}
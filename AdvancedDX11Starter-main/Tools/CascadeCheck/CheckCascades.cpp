@@ -0,0 +1,496 @@
+// Developer: Narai
+// Purpose: Headless check of the shadow cascade fitting. For
+//			random cameras, lights and settings it works out
+//			the smallest sphere around each slice of the view
+//			on its own and checks the fitted cascade against
+//			it: every corner of the slice inside the sphere,
+//			the sphere inside the cascade's box wherever
+//			snapping put it, and the box on whole shadow
+//			texels, so a moving camera moves what is drawn
+//			into it by whole texels. Then walks a camera along
+//			to check the static caster cache is reused exactly
+//			while a cascade stands still, and never once it
+//			moved or the static casters changed.
+//
+// Build and run on Linux, from this folder:
+//
+//		g++ -O2 -std=c++14 -I../.. CheckCascades.cpp ../../ShadowCascades.cpp -o CheckCascades
+//		./CheckCascades
+//
+// Options: -c <cameras> to fit, 2000 by default, and -f
+// <frames> to walk each camera for, 3000 by default.
+
+#include "ShadowCascades.h"
+
+#include <cmath>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+	struct Vector
+	{
+		double x, y, z;
+	};
+
+	Vector operator-(const Vector& a, const Vector& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	Vector operator+(const Vector& a, const Vector& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	Vector operator*(const Vector& a, double s) { return { a.x * s, a.y * s, a.z * s }; }
+	double Dot(const Vector& a, const Vector& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	double Length(const Vector& v) { return std::sqrt(Dot(v, v)); }
+	Vector FromFloats(const float v[3]) { return { v[0], v[1], v[2] }; }
+
+	// Steps rounding can leave between a value and a whole
+	// number of them
+	double OffWhole(double value)
+	{
+		return std::fabs(value - std::floor(value + 0.5));
+	}
+
+	// How far off whole steps a float light space center can
+	// be. Far from the origin a tiny cascade's steps are not
+	// much bigger than the center's last bit
+	double StepTolerance(const float center[3], double step)
+	{
+		double lastBit = (std::max)(std::fabs(center[0]), std::fabs(center[1])) * 1.2e-7;
+		return 1e-2 + 4.0 * lastBit / step;
+	}
+
+	struct Failures
+	{
+		unsigned int cornersOutside;	// A slice corner outside the smallest sphere the cascade was padded for
+		unsigned int sphereTooBig;		// Fitted a good way wider than the smallest sphere
+		unsigned int centerOff;			// Snapped somewhere other than the step below the sphere's center
+		unsigned int sphereClipped;		// The sphere doesn't fit in the box where snapping put it
+		unsigned int offTexel;			// The box doesn't start on a whole texel or step
+		unsigned int splitsWrong;
+	};
+
+	// A camera looking somewhere random from somewhere random
+	ShadowCascadeCamera RandomCamera(std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		ShadowCascadeCamera camera = {};
+		for (int a = 0; a < 3; a++)
+			camera.position[a] = (unit(random) * 2.0f - 1.0f) * 200.0f;
+
+		float yaw = unit(random) * 6.2831853f;
+		float pitch = (unit(random) * 2.0f - 1.0f) * 1.5f;
+		float forward[3] = { std::sin(yaw) * std::cos(pitch), std::sin(pitch), std::cos(yaw) * std::cos(pitch) };
+		float right[3] = { std::cos(yaw), 0.0f, -std::sin(yaw) };
+
+		// Left handed, so up is forward cross right
+		float up[3] = {
+			forward[1] * right[2] - forward[2] * right[1],
+			forward[2] * right[0] - forward[0] * right[2],
+			forward[0] * right[1] - forward[1] * right[0] };
+		memcpy(camera.forward, forward, sizeof(forward));
+		memcpy(camera.right, right, sizeof(right));
+		memcpy(camera.up, up, sizeof(up));
+
+		camera.fieldOfView = 0.6f + unit(random) * 1.0f;
+		camera.aspectRatio = 1.0f + unit(random) * 1.4f;
+		camera.nearClip = 0.01f + unit(random) * 0.5f;
+		camera.farClip = 20.0f + unit(random) * 180.0f;
+		camera.orthographic = unit(random) < 0.15f;
+		camera.orthographicWidth = 10.0f + unit(random) * 30.0f;
+		return camera;
+	}
+
+	void RandomLight(std::mt19937& random, float direction[3])
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+		// Now and then straight down, or nearly, where the light
+		// view has to pick another up
+		if (random() % 8 == 0)
+		{
+			direction[0] = unit(random) * 0.01f;
+			direction[1] = -1.0f;
+			direction[2] = unit(random) * 0.01f;
+			return;
+		}
+		do
+		{
+			direction[0] = unit(random);
+			direction[1] = unit(random);
+			direction[2] = unit(random);
+		} while (direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2] < 0.01f);
+	}
+
+	// Corners of the part of the view between two depths
+	void SliceCorners(const ShadowCascadeCamera& camera, double sliceNear, double sliceFar, Vector corners[8])
+	{
+		Vector position = FromFloats(camera.position);
+		Vector right = FromFloats(camera.right);
+		Vector up = FromFloats(camera.up);
+		Vector forward = FromFloats(camera.forward);
+		for (int i = 0; i < 8; i++)
+		{
+			double depth = (i & 4) ? sliceFar : sliceNear;
+			double halfHeight = camera.orthographic ?
+				camera.orthographicWidth * 0.5 / camera.aspectRatio :
+				depth * std::tan(camera.fieldOfView * 0.5);
+			double halfWidth = camera.orthographic ? camera.orthographicWidth * 0.5 : halfHeight * camera.aspectRatio;
+			corners[i] = position + forward * depth +
+				right * ((i & 1) ? halfWidth : -halfWidth) +
+				up * ((i & 2) ? halfHeight : -halfHeight);
+		}
+	}
+
+	double FarthestCorner(const Vector corners[8], const Vector& center)
+	{
+		double farthest = 0;
+		for (int i = 0; i < 8; i++)
+			farthest = (std::max)(farthest, Length(corners[i] - center));
+		return farthest;
+	}
+
+	// Smallest sphere around a slice with its center on the
+	// view's axis, found by narrowing in on the depth. How far
+	// the farthest corner is only ever falls then rises along it
+	Vector SmallestSphere(const ShadowCascadeCamera& camera, double sliceNear, double sliceFar, const Vector corners[8], double* radius)
+	{
+		Vector position = FromFloats(camera.position);
+		Vector forward = FromFloats(camera.forward);
+		double lo = sliceNear;
+		double hi = sliceFar;
+		for (int i = 0; i < 200; i++)
+		{
+			double a = lo + (hi - lo) / 3.0;
+			double b = hi - (hi - lo) / 3.0;
+			if (FarthestCorner(corners, position + forward * a) < FarthestCorner(corners, position + forward * b))
+				hi = b;
+			else
+				lo = a;
+		}
+
+		Vector center = position + forward * ((lo + hi) * 0.5);
+		*radius = FarthestCorner(corners, center);
+		return center;
+	}
+
+	// Light space axes are the view matrix's columns
+	Vector ToLight(const ShadowCascade& cascade, const Vector& v)
+	{
+		return {
+			v.x * cascade.view[0][0] + v.y * cascade.view[1][0] + v.z * cascade.view[2][0],
+			v.x * cascade.view[0][1] + v.y * cascade.view[1][1] + v.z * cascade.view[2][1],
+			v.x * cascade.view[0][2] + v.y * cascade.view[1][2] + v.z * cascade.view[2][2] };
+	}
+
+	void CheckCascade(
+		const ShadowCascadeCamera& camera,
+		const ShadowCascadeSettings& settings,
+		const ShadowCascade& cascade,
+		Failures* failures)
+	{
+		// Float math over a couple of hundred meters
+		double tolerance = 1e-5 * (Length(FromFloats(camera.position)) + cascade.splitFar + 1.0);
+
+		Vector corners[8];
+		SliceCorners(camera, cascade.splitNear, cascade.splitFar, corners);
+		double smallest;
+		Vector sphereCenter = SmallestSphere(camera, cascade.splitNear, cascade.splitFar, corners, &smallest);
+
+		// The sphere the box was padded around, before padding
+		unsigned int snapTexels = (std::max)(1u, (std::min)(settings.snapTexels, settings.resolution / 4));
+		double fitted = cascade.radius * (settings.resolution - 2.0 * snapTexels) / settings.resolution;
+		double step = cascade.texelSize * snapTexels;
+
+		for (int i = 0; i < 8; i++)
+		{
+			if (Length(corners[i] - sphereCenter) > fitted + tolerance)
+				failures->cornersOutside++;
+		}
+
+		// Rounded up to a sixteenth, no more
+		if (fitted > smallest + 1.0 / 16.0 + tolerance)
+			failures->sphereTooBig++;
+
+		// Snapping only ever moves the center down to the step
+		// below it, and the padding keeps the whole sphere in
+		Vector lightCenter = ToLight(cascade, sphereCenter);
+		double offsets[3] = {
+			lightCenter.x - cascade.center[0],
+			lightCenter.y - cascade.center[1],
+			lightCenter.z - cascade.center[2] };
+		for (double offset : offsets)
+		{
+			if (offset < -tolerance || offset > step + tolerance)
+				failures->centerOff++;
+		}
+		if (std::fabs(offsets[0]) + fitted > cascade.radius + tolerance ||
+			std::fabs(offsets[1]) + fitted > cascade.radius + tolerance ||
+			lightCenter.z - fitted < cascade.nearZ - tolerance ||
+			lightCenter.z + fitted > cascade.farZ + tolerance)
+			failures->sphereClipped++;
+
+		// Every corner lands in the shadow map
+		for (int i = 0; i < 8; i++)
+		{
+			const Vector& c = corners[i];
+			double ndc[3];
+			for (int a = 0; a < 3; a++)
+				ndc[a] = c.x * cascade.viewProjection[0][a] + c.y * cascade.viewProjection[1][a] + c.z * cascade.viewProjection[2][a] + cascade.viewProjection[3][a];
+			if (std::fabs(ndc[0]) > 1.0 + 1e-4 || std::fabs(ndc[1]) > 1.0 + 1e-4 || ndc[2] < -1e-4 || ndc[2] > 1.0 + 1e-4)
+				failures->sphereClipped++;
+		}
+
+		// The center is a whole number of steps from the world
+		// origin, so the box's edge is a whole number of texels
+		// from it
+		double offWhole = StepTolerance(cascade.center, step);
+		if (OffWhole(cascade.center[0] / step) > offWhole || OffWhole(cascade.center[1] / step) > offWhole)
+			failures->offTexel++;
+	}
+
+	// Where a world point lands in a cascade's map, in texels
+	void ToTexels(const ShadowCascade& cascade, unsigned int resolution, const Vector& p, double texels[2])
+	{
+		double ndc[2];
+		for (int a = 0; a < 2; a++)
+			ndc[a] = p.x * cascade.viewProjection[0][a] + p.y * cascade.viewProjection[1][a] + p.z * cascade.viewProjection[2][a] + cascade.viewProjection[3][a];
+		texels[0] = (ndc[0] + 1.0) * 0.5 * resolution;
+		texels[1] = (1.0 - ndc[1]) * 0.5 * resolution;
+	}
+
+	// After the camera moves, a point still in the cascade
+	// should have moved by whole texels, so it is drawn the
+	// same
+	bool MovesWholeTexels(const ShadowCascade& before, const ShadowCascade& after, unsigned int resolution, const Vector& p)
+	{
+		double a[2], b[2];
+		ToTexels(before, resolution, p, a);
+		ToTexels(after, resolution, p, b);
+		for (int i = 0; i < 2; i++)
+		{
+			if (b[i] < 0 || b[i] > resolution)
+				return true;
+		}
+
+		double tolerance = StepTolerance(after.center, after.texelSize) + 1e-2;
+		return OffWhole(b[0] - a[0]) < tolerance && OffWhole(b[1] - a[1]) < tolerance;
+	}
+
+	// Splits run from the near clip to the shadowed far clip,
+	// evenly at 0 and at a constant ratio at 1
+	unsigned int CheckSplits()
+	{
+		unsigned int wrong = 0;
+		float splits[SHADOW_CASCADE_MAX_COUNT + 1];
+		for (int count = 1; count <= SHADOW_CASCADE_MAX_COUNT; count++)
+		{
+			ComputeCascadeSplits(0.1f, 60.0f, count, 0.0f, splits);
+			for (int i = 0; i <= count; i++)
+			{
+				if (std::fabs(splits[i] - (0.1 + (60.0 - 0.1) * i / count)) > 1e-4)
+					wrong++;
+			}
+
+			ComputeCascadeSplits(0.1f, 60.0f, count, 1.0f, splits);
+			for (int i = 0; i < count; i++)
+			{
+				if (std::fabs(splits[i + 1] / splits[i] - std::pow(600.0, 1.0 / count)) > 1e-3)
+					wrong++;
+			}
+		}
+		return wrong;
+	}
+
+	struct Walk
+	{
+		unsigned int hits;
+		unsigned int misses;
+		unsigned int stale;			// Reused after the cascade moved
+		unsigned int wasted;		// Redrawn while it stood still
+	};
+
+	// Moves a camera a centimeter a frame, turning a little, and
+	// checks every cascade's cache against whether the box
+	// it was drawn for moved
+	Walk WalkCamera(ShadowCascadeCamera camera, const float lightDirection[3], const ShadowCascadeSettings& settings, unsigned int frames)
+	{
+		Walk walk = {};
+		ShadowCascadeCache caches[SHADOW_CASCADE_MAX_COUNT] = {};
+		ShadowCascade drawn[SHADOW_CASCADE_MAX_COUNT] = {};
+		unsigned long long staticKey = SHADOW_STATIC_KEY_SEED;
+
+		for (unsigned int f = 0; f < frames; f++)
+		{
+			for (int a = 0; a < 3; a++)
+				camera.position[a] += camera.forward[a] * 0.01f;
+
+			ShadowCascade cascades[SHADOW_CASCADE_MAX_COUNT];
+			int count = FitShadowCascades(camera, lightDirection, settings, cascades);
+			for (int i = 0; i < count; i++)
+			{
+				const ShadowCascade& c = cascades[i];
+				bool moved = !caches[i].valid ||
+					memcmp(c.center, drawn[i].center, sizeof(c.center)) != 0 ||
+					c.radius != drawn[i].radius || c.nearZ != drawn[i].nearZ || c.farZ != drawn[i].farZ;
+
+				bool hit = ShadowCacheMatches(caches[i], c, staticKey);
+				if (hit && moved)
+					walk.stale++;
+				if (!hit && !moved)
+					walk.wasted++;
+
+				if (hit)
+					walk.hits++;
+				else
+				{
+					walk.misses++;
+					StoreShadowCache(&caches[i], c, staticKey);
+					drawn[i] = c;
+				}
+			}
+		}
+		return walk;
+	}
+
+	// What each change does to a cache that would otherwise hit
+	unsigned int CheckCacheKeys(const ShadowCascadeCamera& camera, const float lightDirection[3], const ShadowCascadeSettings& settings)
+	{
+		unsigned int wrong = 0;
+		ShadowCascade cascades[SHADOW_CASCADE_MAX_COUNT];
+		int count = FitShadowCascades(camera, lightDirection, settings, cascades);
+
+		unsigned long long meshes[2] = { 3, 7 };
+		unsigned long long key = HashShadowCaster(HashShadowCaster(SHADOW_STATIC_KEY_SEED, &meshes[0], 8), &meshes[1], 8);
+		unsigned long long swapped = HashShadowCaster(HashShadowCaster(SHADOW_STATIC_KEY_SEED, &meshes[1], 8), &meshes[0], 8);
+		unsigned long long fewer = HashShadowCaster(SHADOW_STATIC_KEY_SEED, &meshes[0], 8);
+		if (key == swapped || key == fewer)
+			wrong++;
+
+		ShadowCascadeCache empty = {};
+		if (ShadowCacheMatches(empty, cascades[0], SHADOW_STATIC_KEY_SEED))
+			wrong++;
+
+		ShadowCascadeCache cache = {};
+		StoreShadowCache(&cache, cascades[0], key);
+		if (!ShadowCacheMatches(cache, cascades[0], key))
+			wrong++;
+		if (ShadowCacheMatches(cache, cascades[0], swapped) || ShadowCacheMatches(cache, cascades[0], fewer))
+			wrong++;
+		if (count > 1 && ShadowCacheMatches(cache, cascades[1], key))
+			wrong++;
+
+		// The light turning a hair moves every cascade
+		float turned[3] = { lightDirection[0] + 1e-3f, lightDirection[1], lightDirection[2] };
+		ShadowCascade after[SHADOW_CASCADE_MAX_COUNT];
+		FitShadowCascades(camera, turned, settings, after);
+		if (ShadowCacheMatches(cache, after[0], key))
+			wrong++;
+		return wrong;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int cameras = 2000;
+	unsigned int frames = 3000;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+			cameras = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+			frames = (unsigned int)atoi(argv[++i]);
+		else
+		{
+			printf("Usage: %s [-c cameras] [-f frames]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	int failures = 0;
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const unsigned int snaps[] = { 1, 8, 32 };
+
+	Failures fit = {};
+	fit.splitsWrong = CheckSplits();
+	unsigned int cascadesChecked = 0;
+	for (unsigned int c = 0; c < cameras; c++)
+	{
+		ShadowCascadeCamera camera = RandomCamera(random);
+		float light[3];
+		RandomLight(random, light);
+
+		ShadowCascadeSettings settings = {};
+		settings.count = 1 + (int)(random() % SHADOW_CASCADE_MAX_COUNT);
+		settings.splitLambda = unit(random);
+		settings.shadowDistance = 5.0f + unit(random) * 95.0f;
+		settings.resolution = (random() % 2) ? 2048 : 1024;
+		settings.casterDistance = 50.0f;
+		settings.snapTexels = snaps[random() % 3];
+
+		ShadowCascade cascades[SHADOW_CASCADE_MAX_COUNT];
+		int count = FitShadowCascades(camera, light, settings, cascades);
+
+		float farClip = (std::max)((std::min)(camera.farClip, settings.shadowDistance), camera.nearClip + 0.01f);
+		if (count != settings.count || cascades[0].splitNear != camera.nearClip || cascades[count - 1].splitFar != farClip)
+			fit.splitsWrong++;
+		for (int i = 0; i < count; i++)
+		{
+			if (cascades[i].splitFar <= cascades[i].splitNear || (i > 0 && cascades[i].splitNear != cascades[i - 1].splitFar))
+				fit.splitsWrong++;
+			CheckCascade(camera, settings, cascades[i], &fit);
+			cascadesChecked++;
+		}
+
+		// Moved a little, the light turned the same way
+		ShadowCascadeCamera moved = camera;
+		for (int a = 0; a < 3; a++)
+			moved.position[a] += (unit(random) * 2.0f - 1.0f) * 3.0f;
+		ShadowCascade after[SHADOW_CASCADE_MAX_COUNT];
+		FitShadowCascades(moved, light, settings, after);
+		for (int i = 0; i < count; i++)
+		{
+			float depth = (cascades[i].splitNear + cascades[i].splitFar) * 0.5f;
+			Vector inside = FromFloats(camera.position) + FromFloats(camera.forward) * depth;
+			if (!MovesWholeTexels(cascades[i], after[i], settings.resolution, inside))
+				fit.offTexel++;
+		}
+	}
+
+	printf("%u cascades: %u corners outside, %u spheres too big, %u centers off, %u spheres clipped, %u off a texel, %u splits wrong\n",
+		cascadesChecked, fit.cornersOutside, fit.sphereTooBig, fit.centerOff, fit.sphereClipped, fit.offTexel, fit.splitsWrong);
+	if (fit.cornersOutside > 0 || fit.sphereTooBig > 0 || fit.centerOff > 0 || fit.sphereClipped > 0 || fit.offTexel > 0 || fit.splitsWrong > 0)
+		failures++;
+
+	// Walks as the game fits them, with and without the cache's
+	// coarser steps
+	ShadowCascadeCamera camera = RandomCamera(random);
+	camera.orthographic = false;
+	camera.farClip = 100.0f;
+	float light[3] = { 0.3f, -1.0f, 0.4f };
+	for (unsigned int snap : { 1u, 32u })
+	{
+		ShadowCascadeSettings settings = {};
+		settings.count = SHADOW_CASCADE_MAX_COUNT;
+		settings.splitLambda = 0.75f;
+		settings.shadowDistance = 60.0f;
+		settings.resolution = 2048;
+		settings.casterDistance = 50.0f;
+		settings.snapTexels = snap;
+
+		Walk walk = WalkCamera(camera, light, settings, frames);
+		printf("Walking %u frames, steps of %2u texels: %u reused, %u redrawn, %u reused after moving, %u redrawn standing still\n",
+			frames, snap, walk.hits, walk.misses, walk.stale, walk.wasted);
+		if (walk.stale > 0 || walk.wasted > 0 || walk.hits == 0)
+			failures++;
+
+		unsigned int wrongKeys = CheckCacheKeys(camera, light, settings);
+		if (wrongKeys > 0)
+		{
+			printf("  %u cache key checks wrong\n", wrongKeys);
+			failures++;
+		}
+	}
+
+	printf("%s\n", failures == 0 ? "All passed" : "Failures above");
+	return failures == 0 ? 0 : 1;
+}
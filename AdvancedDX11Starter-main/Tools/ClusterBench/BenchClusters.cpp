@@ -0,0 +1,466 @@
+// Developer: Narai
+// Purpose: Headless check of the light clusters. Bins lights
+//			scattered in and around a perspective camera, a
+//			turned and moved one, and an orthographic one, on
+//			one thread and across a job graph, and compares
+//			every cluster against each light's sphere measured
+//			against that cluster's corners. No light may be
+//			missing from a cluster its sphere reaches, nor be
+//			in one whose six planes it is wholly behind any of.
+//			Then times the binning against the measuring.
+//
+// Build and run on Linux, from this folder:
+//
+//		g++ -O2 -std=c++14 -pthread -I../.. BenchClusters.cpp ../../LightClusters.cpp ../../RenderJobGraph.cpp -o BenchClusters
+//		./BenchClusters
+//
+// Options: -w <workers> for the job graph, 4 by default, -l
+// <lights> to time, 4096 by default, and -i <iterations> to
+// average the times over, 32 by default.
+
+#include "LightClusters.h"
+
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	// How far from a plane, in meters, a sphere can be while
+	// float and double disagree on which side of it it is
+	const double SLACK = 2e-3;
+
+	struct Camera
+	{
+		double eye[3];
+		double yaw;
+		bool orthographic;
+		double scaleX, scaleY;	// Projection _11 and _22
+		double nearClip, farClip;
+	};
+
+	// A light in view space, what it is measured from
+	struct ViewLight
+	{
+		double x, y, z;
+		double range;
+	};
+
+	// Right, up and forward of a camera turned by its yaw
+	void Axes(const Camera& camera, double axes[3][3])
+	{
+		double s = std::sin(camera.yaw);
+		double c = std::cos(camera.yaw);
+		double right[3] = { c, 0, -s };
+		double up[3] = { 0, 1, 0 };
+		double forward[3] = { s, 0, c };
+		memcpy(axes[0], right, sizeof(right));
+		memcpy(axes[1], up, sizeof(up));
+		memcpy(axes[2], forward, sizeof(forward));
+	}
+
+	ClusterFrustum MakeFrustum(const Camera& camera)
+	{
+		double axes[3][3];
+		Axes(camera, axes);
+
+		// Row vectors times the matrix, so its columns are the
+		// camera's axes
+		ClusterFrustum frustum = {};
+		for (int j = 0; j < 3; j++)
+		{
+			for (int i = 0; i < 3; i++)
+				frustum.view[i][j] = (float)axes[j][i];
+			frustum.view[3][j] = (float)-(camera.eye[0] * axes[j][0] + camera.eye[1] * axes[j][1] + camera.eye[2] * axes[j][2]);
+		}
+		frustum.view[3][3] = 1.0f;
+		frustum.projScaleX = (float)camera.scaleX;
+		frustum.projScaleY = (float)camera.scaleY;
+		frustum.nearClip = (float)camera.nearClip;
+		frustum.farClip = (float)camera.farClip;
+		frustum.orthographic = camera.orthographic;
+		return frustum;
+	}
+
+	// Lights scattered over a box in view space that holds the
+	// whole frustum and some way past it on every side, and
+	// the same lights moved into the world
+	void MakeLights(const Camera& camera, unsigned int count, double maxRange, unsigned int seed,
+		std::vector<ViewLight>* viewLights, std::vector<ClusterLight>* lights)
+	{
+		double axes[3][3];
+		Axes(camera, axes);
+
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<double> unit(0.0, 1.0);
+		double halfX = camera.orthographic ? 1.0 / camera.scaleX : camera.farClip / camera.scaleX;
+		double halfY = camera.orthographic ? 1.0 / camera.scaleY : camera.farClip / camera.scaleY;
+
+		viewLights->resize(count);
+		lights->resize(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			ViewLight& v = (*viewLights)[i];
+			v.z = -0.1 * camera.farClip + unit(random) * 1.2 * camera.farClip;
+			double spreadX = camera.orthographic ? halfX : (std::max)(std::fabs(v.z), 1.0) / camera.scaleX;
+			double spreadY = camera.orthographic ? halfY : (std::max)(std::fabs(v.z), 1.0) / camera.scaleY;
+			v.x = (unit(random) * 2.4 - 1.2) * spreadX;
+			v.y = (unit(random) * 2.4 - 1.2) * spreadY;
+			v.range = 0.25 + unit(random) * maxRange;
+
+			// Floats, which is all the binning gets, so it is
+			// measured from the same lights
+			ClusterLight& l = (*lights)[i];
+			l.x = (float)(camera.eye[0] + v.x * axes[0][0] + v.y * axes[1][0] + v.z * axes[2][0]);
+			l.y = (float)(camera.eye[1] + v.x * axes[0][1] + v.y * axes[1][1] + v.z * axes[2][1]);
+			l.z = (float)(camera.eye[2] + v.x * axes[0][2] + v.y * axes[1][2] + v.z * axes[2][2]);
+			l.range = (float)v.range;
+			l.lightIndex = i * 3 + 1;
+
+			double back[3] = { l.x - camera.eye[0], l.y - camera.eye[1], l.z - camera.eye[2] };
+			v.x = back[0] * axes[0][0] + back[1] * axes[0][1] + back[2] * axes[0][2];
+			v.y = back[0] * axes[1][0] + back[1] * axes[1][1] + back[2] * axes[1][2];
+			v.z = back[0] * axes[2][0] + back[1] * axes[2][1] + back[2] * axes[2][2];
+			v.range = l.range;
+		}
+	}
+
+	// Distance from a tile edge at an NDC coordinate, positive
+	// towards larger NDC, for a point at v along the axis and
+	// z deep
+	double EdgeDistance(const Camera& camera, double scale, double ndc, double v, double z)
+	{
+		if (camera.orthographic)
+			return v - ndc / scale;
+		return (v * scale - ndc * z) / std::sqrt(scale * scale + ndc * ndc);
+	}
+
+	// Whether a sphere may reach a cluster, tested plane by
+	// plane: it is out only when wholly behind one of the six.
+	// Near the camera a sphere can straddle two planes behind
+	// it and still miss the cluster between them
+	bool PlanesTouch(const Camera& camera, const ViewLight& light, double range, int x, int y, int z)
+	{
+		// Nothing is binned in front of the near clip or past the far clip
+		if (light.z + range < camera.nearClip || light.z - range > camera.farClip)
+			return false;
+
+		double left = -1.0 + 2.0 * x / LIGHT_CLUSTERS_X;
+		double right = -1.0 + 2.0 * (x + 1) / LIGHT_CLUSTERS_X;
+		if (EdgeDistance(camera, camera.scaleX, left, light.x, light.z) < -range ||
+			-EdgeDistance(camera, camera.scaleX, right, light.x, light.z) < -range)
+			return false;
+
+		// Rows count down from the top
+		double top = 1.0 - 2.0 * y / LIGHT_CLUSTERS_Y;
+		double bottom = 1.0 - 2.0 * (y + 1) / LIGHT_CLUSTERS_Y;
+		if (EdgeDistance(camera, camera.scaleY, bottom, light.y, light.z) < -range ||
+			-EdgeDistance(camera, camera.scaleY, top, light.y, light.z) < -range)
+			return false;
+
+		// Slices are spaced evenly in log depth, the first running
+		// all the way to the camera and the last out to infinity
+		double nearZ = (std::max)(camera.nearClip, (double)LIGHT_CLUSTER_NEAR);
+		double farZ = (std::max)(camera.farClip, nearZ + 1.0);
+		double sliceNear = nearZ * std::pow(farZ / nearZ, (double)z / LIGHT_CLUSTERS_Z);
+		double sliceFar = nearZ * std::pow(farZ / nearZ, (double)(z + 1) / LIGHT_CLUSTERS_Z);
+		if (z > 0 && light.z + range < sliceNear)
+			return false;
+		if (z < LIGHT_CLUSTERS_Z - 1 && light.z - range > sliceFar)
+			return false;
+		return true;
+	}
+
+	struct Vector
+	{
+		double x, y, z;
+	};
+
+	Vector operator-(const Vector& a, const Vector& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	Vector operator+(const Vector& a, const Vector& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	Vector operator*(const Vector& a, double s) { return { a.x * s, a.y * s, a.z * s }; }
+	double Dot(const Vector& a, const Vector& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	Vector Cross(const Vector& a, const Vector& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+
+	double SegmentDistance(const Vector& p, const Vector& a, const Vector& b)
+	{
+		Vector ab = b - a;
+		double t = Dot(p - a, ab) / Dot(ab, ab);
+		t = (std::max)(0.0, (std::min)(1.0, t));
+		Vector d = p - (a + ab * t);
+		return std::sqrt(Dot(d, d));
+	}
+
+	// Corners of a cluster by x + 2y + 4z, the first of each
+	// being the smaller. The first slice starts at the near
+	// clip and the last ends at the far clip, as nothing past
+	// either is binned
+	void ClusterCorners(const Camera& camera, int x, int y, int z, Vector corners[8])
+	{
+		double nearZ = (std::max)(camera.nearClip, (double)LIGHT_CLUSTER_NEAR);
+		double farZ = (std::max)(camera.farClip, nearZ + 1.0);
+		double depths[2] = {
+			z == 0 ? camera.nearClip : nearZ * std::pow(farZ / nearZ, (double)z / LIGHT_CLUSTERS_Z),
+			z == LIGHT_CLUSTERS_Z - 1 ? camera.farClip : nearZ * std::pow(farZ / nearZ, (double)(z + 1) / LIGHT_CLUSTERS_Z) };
+		double ndcX[2] = { -1.0 + 2.0 * x / LIGHT_CLUSTERS_X, -1.0 + 2.0 * (x + 1) / LIGHT_CLUSTERS_X };
+		double ndcY[2] = { 1.0 - 2.0 * (y + 1) / LIGHT_CLUSTERS_Y, 1.0 - 2.0 * y / LIGHT_CLUSTERS_Y };
+
+		for (int i = 0; i < 8; i++)
+		{
+			double depth = depths[i >> 2];
+			double spread = camera.orthographic ? 1.0 : depth;
+			corners[i] = { ndcX[i & 1] * spread / camera.scaleX, ndcY[(i >> 1) & 1] * spread / camera.scaleY, depth };
+		}
+	}
+
+	// Distance from a point to the solid a cluster's corners
+	// bound, 0 inside it. Outside, the nearest point is on one
+	// of its faces
+	double ClusterDistance(const Vector corners[8], const Vector& p)
+	{
+		static const int faces[6][4] = {
+			{ 0, 2, 6, 4 }, { 1, 3, 7, 5 },
+			{ 0, 1, 5, 4 }, { 2, 3, 7, 6 },
+			{ 0, 1, 3, 2 }, { 4, 5, 7, 6 } };
+
+		Vector center = { 0, 0, 0 };
+		for (int i = 0; i < 8; i++)
+			center = center + corners[i] * 0.125;
+
+		bool inside = true;
+		double nearest = 1e30;
+		for (const int* f : faces)
+		{
+			const Vector& a = corners[f[0]];
+			Vector n = Cross(corners[f[1]] - a, corners[f[3]] - a);
+			n = n * (1.0 / std::sqrt(Dot(n, n)));
+			if (Dot(n, center - a) > 0)
+				n = n * -1.0;
+
+			double height = Dot(n, p - a);
+			if (height <= 0)
+				continue;
+			inside = false;
+
+			// Over the face itself, or nearest one of its edges
+			Vector q = p - n * height;
+			bool over = true;
+			for (int e = 0; e < 4; e++)
+			{
+				const Vector& from = corners[f[e]];
+				const Vector& to = corners[f[(e + 1) % 4]];
+				if (Dot(Cross(to - from, q - from), n) * Dot(Cross(to - from, corners[f[(e + 2) % 4]] - from), n) < 0)
+					over = false;
+			}
+			if (over)
+				nearest = (std::min)(nearest, height);
+			else
+			{
+				for (int e = 0; e < 4; e++)
+					nearest = (std::min)(nearest, SegmentDistance(p, corners[f[e]], corners[f[(e + 1) % 4]]));
+			}
+		}
+		return inside ? 0.0 : nearest;
+	}
+
+	// Whether a sphere really reaches a cluster
+	bool Touches(const Camera& camera, const ViewLight& light, double range, int x, int y, int z)
+	{
+		if (!PlanesTouch(camera, light, range, x, y, z))
+			return false;
+
+		Vector corners[8];
+		ClusterCorners(camera, x, y, z, corners);
+		return ClusterDistance(corners, { light.x, light.y, light.z }) <= range;
+	}
+
+	struct Comparison
+	{
+		unsigned int missed;		// Surely reaches a cluster it isn't in
+		unsigned int extra;			// In a cluster wholly behind one of its planes
+		unsigned int loose;			// In a cluster it doesn't reach, which only costs time
+		unsigned int unordered;		// A cluster's lights not lowest first
+		unsigned int badOverflow;	// A full cluster not holding exactly the most it can
+		unsigned int badLayout;		// Ranges that don't follow on from each other
+		unsigned int overflowing;
+		unsigned int indices;
+	};
+
+	Comparison Compare(LightClusters& clusters, const Camera& camera, const std::vector<ViewLight>& viewLights)
+	{
+		Comparison result = {};
+		const std::vector<LightClusterRange>& ranges = clusters.GetClusterRanges();
+		const std::vector<unsigned int>& indices = clusters.GetLightIndices();
+
+		std::vector<char> surely(viewLights.size());
+		std::vector<char> maybe(viewLights.size());		// 2 when only by its planes
+		std::vector<char> binned(viewLights.size());
+		unsigned int offset = 0;
+		for (int z = 0; z < LIGHT_CLUSTERS_Z; z++)
+			for (int y = 0; y < LIGHT_CLUSTERS_Y; y++)
+				for (int x = 0; x < LIGHT_CLUSTERS_X; x++)
+				{
+					unsigned int c = (z * LIGHT_CLUSTERS_Y + y) * LIGHT_CLUSTERS_X + x;
+					const LightClusterRange& range = ranges[c];
+					if (range.offset != offset)
+						result.badLayout++;
+					offset = range.offset + range.count;
+
+					unsigned int surelyCount = 0;
+					unsigned int maybeCount = 0;
+					for (size_t i = 0; i < viewLights.size(); i++)
+					{
+						const ViewLight& light = viewLights[i];
+						surely[i] = Touches(camera, light, light.range - SLACK, x, y, z);
+						maybe[i] = PlanesTouch(camera, light, light.range + SLACK, x, y, z);
+						if (maybe[i] && !surely[i] && !Touches(camera, light, light.range + SLACK, x, y, z))
+							maybe[i] = 2;
+						surelyCount += surely[i];
+						maybeCount += maybe[i] != 0;
+						binned[i] = 0;
+					}
+
+					int previous = -1;
+					for (unsigned int k = 0; k < range.count; k++)
+					{
+						int i = (int)(indices[range.offset + k] - 1) / 3;
+						binned[i] = 1;
+						if (!maybe[i])
+							result.extra++;
+						else if (maybe[i] == 2)
+							result.loose++;
+						if (i <= previous)
+							result.unordered++;
+						previous = i;
+					}
+
+					// A full cluster keeps its lowest lights, so only
+					// those below its last can be checked as missing
+					bool full = range.count == LIGHT_CLUSTER_MAX_LIGHTS;
+					if (full)
+						result.overflowing++;
+					if (surelyCount > LIGHT_CLUSTER_MAX_LIGHTS && !full)
+						result.badOverflow++;
+					if (range.count > LIGHT_CLUSTER_MAX_LIGHTS || (full && maybeCount < LIGHT_CLUSTER_MAX_LIGHTS))
+						result.badOverflow++;
+					for (int i = 0; i < (full ? previous : (int)viewLights.size()); i++)
+					{
+						if (surely[i] && !binned[i])
+							result.missed++;
+					}
+				}
+
+		if (offset != clusters.GetIndexCount())
+			result.badLayout++;
+		result.indices = clusters.GetIndexCount();
+		return result;
+	}
+
+	bool SameResults(LightClusters& a, LightClusters& b)
+	{
+		if (a.GetIndexCount() != b.GetIndexCount() || a.GetOverflowCount() != b.GetOverflowCount())
+			return false;
+		for (unsigned int c = 0; c < LIGHT_CLUSTER_COUNT; c++)
+		{
+			if (a.GetClusterRanges()[c].offset != b.GetClusterRanges()[c].offset ||
+				a.GetClusterRanges()[c].count != b.GetClusterRanges()[c].count)
+				return false;
+		}
+		return memcmp(a.GetLightIndices().data(), b.GetLightIndices().data(), sizeof(unsigned int) * a.GetIndexCount()) == 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int workers = 4;
+	unsigned int lightCount = 4096;
+	unsigned int iterations = 32;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+			workers = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+			lightCount = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+			iterations = (unsigned int)atoi(argv[++i]);
+		else
+		{
+			printf("Usage: %s [-w workers] [-l lights] [-i iterations]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	// 60 degrees up and down at 16:9, and 40 by 22.5 meters
+	const double perspectiveY = 1.0 / std::tan(3.14159265358979 / 6.0);
+	struct Scene
+	{
+		const char* name;
+		Camera camera;
+		unsigned int lights;
+		double maxRange;
+	};
+	const Scene scenes[] = {
+		{ "Perspective", { { 0, 0, 0 }, 0.0, false, perspectiveY / (16.0 / 9.0), perspectiveY, 0.01, 100.0 }, 512, 6.0 },
+		{ "Turned", { { 12.0, 3.0, -40.0 }, 2.3, false, perspectiveY / (16.0 / 9.0), perspectiveY, 0.1, 60.0 }, 512, 6.0 },
+		{ "Crowded", { { 0, 0, 0 }, 0.0, false, perspectiveY / (16.0 / 9.0), perspectiveY, 0.01, 20.0 }, 1024, 8.0 },
+		{ "Orthographic", { { -5.0, 10.0, 5.0 }, -0.7, true, 2.0 / 40.0, 2.0 / 22.5, 0.1, 60.0 }, 512, 4.0 },
+	};
+
+	int failures = 0;
+	RenderJobGraph graph(workers);
+	unsigned int seed = 1;
+	for (const Scene& scene : scenes)
+	{
+		std::vector<ViewLight> viewLights;
+		std::vector<ClusterLight> lights;
+		MakeLights(scene.camera, scene.lights, scene.maxRange, seed++, &viewLights, &lights);
+		ClusterFrustum frustum = MakeFrustum(scene.camera);
+
+		LightClusters serial;
+		serial.Prepare(frustum, lights.data(), (unsigned int)lights.size());
+		serial.Build();
+
+		LightClusters parallel;
+		parallel.Prepare(frustum, lights.data(), (unsigned int)lights.size());
+		graph.Reset();
+		parallel.AddJobs(&graph, workers + 1);
+		graph.Run(true);
+
+		Comparison c = Compare(serial, scene.camera, viewLights);
+		bool same = SameResults(serial, parallel);
+		bool overflowCounted = serial.GetOverflowCount() <= c.overflowing;
+		printf("%-12s %4u lights, %6u indices, %4u full: %u missed, %u extra, %u loose, %u out of order, %u overflowed wrong, %u laid out wrong, workers %s\n",
+			scene.name, scene.lights, c.indices, c.overflowing, c.missed, c.extra, c.loose, c.unordered, c.badOverflow, c.badLayout,
+			same ? "match" : "DON'T match");
+		if (c.missed > 0 || c.extra > 0 || c.unordered > 0 || c.badOverflow > 0 || c.badLayout > 0 || !same || !overflowCounted)
+			failures++;
+	}
+
+	// Against measuring every light against every cluster, on
+	// the benchmark's camera
+	LightClusterBenchmark b = BenchmarkLightClusters(lightCount, iterations, workers);
+	printf("%u lights: %.3f ms serial, %.3f ms over %u workers, %u indices\n",
+		b.lightCount, b.serialMS, b.parallelMS, b.workerCount, b.indexCount);
+
+	Camera camera = scenes[0].camera;
+	std::vector<ViewLight> viewLights;
+	std::vector<ClusterLight> lights;
+	MakeLights(camera, lightCount, 4.0, 1234, &viewLights, &lights);
+	unsigned int touches = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int z = 0; z < LIGHT_CLUSTERS_Z; z++)
+		for (int y = 0; y < LIGHT_CLUSTERS_Y; y++)
+			for (int x = 0; x < LIGHT_CLUSTERS_X; x++)
+				for (const ViewLight& light : viewLights)
+					touches += Touches(camera, light, light.range, x, y, z);
+	auto end = std::chrono::high_resolution_clock::now();
+	printf("%u lights: %.3f ms measuring every cluster, %u touches\n",
+		lightCount, std::chrono::duration<float, std::milli>(end - start).count(), touches);
+
+	printf("%s\n", failures == 0 ? "All passed" : "Failures above");
+	return failures == 0 ? 0 : 1;
+}
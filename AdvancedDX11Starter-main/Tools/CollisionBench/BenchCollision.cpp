@@ -0,0 +1,74 @@
+// Developer: Narai
+// Purpose: Headless check of level collision. Builds the
+//			hierarchy over a level's .obj and runs crowds of
+//			players around it, reporting how long a tick of
+//			moves takes and whether anyone fell through.
+//
+// Build and run on Linux, from this folder:
+//
+//		g++ -O2 -std=c++14 -I../.. BenchCollision.cpp ../../Collision.cpp -o BenchCollision
+//		./BenchCollision ../../Assets/Models/SampleLevel.obj
+//
+// Options: -t <ticks> to run each crowd for, 120 by default.
+
+#include "Collision.h"
+
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+	const char* path = nullptr;
+	unsigned int ticks = 120;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			ticks = (unsigned int)atoi(argv[++i]);
+		else
+			path = argv[i];
+	}
+	if (!path)
+	{
+		printf("Usage: %s [-t ticks] level.obj\n", argv[0]);
+		return 1;
+	}
+
+	std::ifstream obj(path);
+	std::vector<float> soup;
+	if (!LoadCollisionOBJ(obj, soup))
+	{
+		printf("Couldn't read %s\n", path);
+		return 1;
+	}
+
+	const float identity[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+	LevelCollision level;
+	level.AddTriangles(soup.data(), soup.size() / 9, identity);
+	level.Build();
+	if (!level.GetBoundsMin())
+	{
+		printf("%s has no triangles\n", path);
+		return 1;
+	}
+
+	const float* lo = level.GetBoundsMin();
+	const float* hi = level.GetBoundsMax();
+	printf("%u triangles, %u nodes, built in %.3f ms\n", level.GetTriangleCount(), level.GetNodeCount(), level.GetBuildMS());
+	printf("Bounds (%.2f, %.2f, %.2f) to (%.2f, %.2f, %.2f)\n", lo[0], lo[1], lo[2], hi[0], hi[1], hi[2]);
+
+	int failures = 0;
+	const unsigned int crowds[] = { 1000, 4000, 16000 };
+	for (unsigned int players : crowds)
+	{
+		CollisionBenchmark b = BenchmarkCapsuleMoves(level, players, ticks);
+		printf("%6u players: %7.3f ms a tick, %7.0f moves/ms, %u grounded, %u escaped\n",
+			b.playerCount, b.tickMS, b.movesPerMS, b.groundedPlayers, b.escapedPlayers);
+		if (b.escapedPlayers > 0)
+			failures++;
+	}
+
+	return failures == 0 ? 0 : 1;
+}
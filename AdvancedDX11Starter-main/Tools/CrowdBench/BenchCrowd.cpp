@@ -0,0 +1,49 @@
+// Developer: Narai
+// Purpose: Headless check of crowd steering. Two blocks of
+//			agents swap sides through each other, timed a tick
+//			at a time on one thread and across a job graph,
+//			reporting whether anyone ended up inside anyone.
+//
+// Build and run on Linux, from this folder:
+//
+//		g++ -O2 -std=c++14 -pthread -I../.. BenchCrowd.cpp ../../Crowd.cpp ../../NavMesh.cpp ../../EntityStore.cpp ../../RenderJobGraph.cpp -o BenchCrowd
+//		./BenchCrowd
+//
+// Options: -w <workers> for the job graph, 4 by default, and
+// -t <ticks> to run each crowd for, 120 by default.
+
+#include "Crowd.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char** argv)
+{
+	unsigned int workers = 4;
+	unsigned int ticks = 120;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+			workers = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			ticks = (unsigned int)atoi(argv[++i]);
+		else
+		{
+			printf("Usage: %s [-w workers] [-t ticks]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	int failures = 0;
+	const unsigned int crowds[] = { 1000, 5000, 20000 };
+	for (unsigned int agents : crowds)
+	{
+		CrowdBenchmark b = BenchmarkCrowd(agents, ticks, workers);
+		printf("%6u agents: %7.3f ms a tick serial, %7.3f ms over %u workers, %u overlapping, %.2f m/s\n",
+			b.agentCount, b.serialTickMS, b.parallelTickMS, b.workerCount, b.overlaps, b.averageSpeed);
+		if (b.overlaps > 0)
+			failures++;
+	}
+	return failures == 0 ? 0 : 1;
+}
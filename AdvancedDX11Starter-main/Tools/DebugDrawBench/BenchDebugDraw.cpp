@@ -0,0 +1,577 @@
+// Developer: Narai
+// Purpose: Headless check of debug drawing. Adds every shape
+//			to a line batch and checks how many lines each
+//			came out as, that the ones drawn as loops close,
+//			that boxes have twelve edges meeting three at each
+//			corner, and that circles stay on their circle.
+//			Then steps frames of uneven length adding items
+//			that last from no time at all to several laps of
+//			the bucket ring, checking each is drawn in exactly
+//			the frames before the tick it expires on. Then
+//			lays out a known string with a made up font and
+//			checks where every glyph lands, across advances,
+//			offsets, newlines and unknown characters, and how
+//			labels are placed and kept. Then times filling a
+//			frame's batch with single lines and with spheres,
+//			expiring timed items, and labeling with the game's
+//			font.
+//
+// Build and run on Linux, from this folder:
+//
+//		g++ -O2 -std=c++14 -I../.. BenchDebugDraw.cpp ../../DebugGeometry.cpp ../../DebugText.cpp -o BenchDebugDraw
+//		./BenchDebugDraw
+//
+// Options: -l <lines> a frame to time, 100000 by default, -i
+// <iterations> to average over, 32 by default, and -f <frames>
+// to step timed items through, 4000 by default.
+
+#include "DebugGeometry.h"
+#include "DebugText.h"
+
+#include <cmath>
+#include <map>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tuple>
+
+namespace
+{
+	const float RED[4] = { 1, 0, 0, 1 };
+
+	int failures = 0;
+
+	void Expect(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			printf("  FAILED: %s\n", what);
+			failures++;
+		}
+	}
+
+	float Distance(const float a[3], const float b[3])
+	{
+		float d[3] = { a[0] - b[0], a[1] - b[1], a[2] - b[2] };
+		return std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+	}
+
+	// How many line ends meet at each point of a run of lines,
+	// points closer than a hundredth of a millimeter being one
+	std::map<std::tuple<long, long, long>, int> Ends(const std::vector<DebugVertex>& vertices, size_t first, size_t count)
+	{
+		std::map<std::tuple<long, long, long>, int> ends;
+		for (size_t v = first; v < first + count; v++)
+		{
+			const float* p = vertices[v].position;
+			ends[std::make_tuple(std::lround(p[0] * 1e5f), std::lround(p[1] * 1e5f), std::lround(p[2] * 1e5f))]++;
+		}
+		return ends;
+	}
+
+	// Every point of a loop has exactly two ends on it, and
+	// each line starts where the one before it ended
+	bool IsClosedLoop(const std::vector<DebugVertex>& vertices, size_t first, size_t count)
+	{
+		if (count < 6 || count % 2 != 0)
+			return false;
+		for (auto& end : Ends(vertices, first, count))
+		{
+			if (end.second != 2)
+				return false;
+		}
+		for (size_t v = first + 2; v < first + count; v += 2)
+		{
+			if (Distance(vertices[v].position, vertices[v - 1].position) > 1e-4f)
+				return false;
+		}
+		return Distance(vertices[first].position, vertices[first + count - 1].position) <= 1e-4f;
+	}
+
+	// Eight corners, three edges meeting at each
+	bool IsBox(const std::vector<DebugVertex>& vertices, size_t first)
+	{
+		auto ends = Ends(vertices, first, 24);
+		if (ends.size() != 8)
+			return false;
+		for (auto& end : ends)
+		{
+			if (end.second != 3)
+				return false;
+		}
+		return true;
+	}
+
+	// Every point the given distance from the center, and
+	// square to the normal
+	bool OnCircle(const std::vector<DebugVertex>& vertices, size_t first, size_t count, const float center[3], const float normal[3], float radius)
+	{
+		float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		for (size_t v = first; v < first + count; v++)
+		{
+			const float* p = vertices[v].position;
+			float d[3] = { p[0] - center[0], p[1] - center[1], p[2] - center[2] };
+			if (std::fabs(Distance(p, center) - radius) > radius * 1e-5f + 1e-5f ||
+				std::fabs(d[0] * normal[0] + d[1] * normal[1] + d[2] * normal[2]) / length > radius * 1e-5f + 1e-5f)
+				return false;
+		}
+		return true;
+	}
+
+	void CheckShapes()
+	{
+		DebugLineBatch batch;
+		const std::vector<DebugVertex>& v = batch.GetVertices();
+		const float center[3] = { 3.0f, -2.0f, 7.5f };
+
+		const float a[3] = { 1, 2, 3 };
+		const float b[3] = { -4, 5, 6 };
+		batch.AddLine(a, b, RED);
+		Expect(batch.GetLineCount() == 1 && memcmp(v[0].position, a, sizeof(a)) == 0 && memcmp(v[1].position, b, sizeof(b)) == 0 &&
+			memcmp(v[1].color, RED, sizeof(RED)) == 0, "a line is its two ends in its color");
+
+		batch.Clear();
+		batch.AddCross(center, 2.0f, RED);
+		bool crossed = batch.GetLineCount() == 3;
+		for (int axis = 0; axis < 3 && crossed; axis++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				float expected = c == axis ? 2.0f : 0.0f;
+				if (std::fabs(v[axis * 2 + 1].position[c] - v[axis * 2].position[c] - expected) > 1e-5f ||
+					std::fabs((v[axis * 2 + 1].position[c] + v[axis * 2].position[c]) * 0.5f - center[c]) > 1e-5f)
+					crossed = false;
+			}
+		}
+		Expect(crossed, "a cross is three lines of its size, one along each axis, through its center");
+
+		// Circles around every axis, a diagonal, and normals
+		// nearly along an axis, at a few segment counts
+		const float normals[][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 }, { 1, 1, 1 }, { 0.001f, 1, 0 }, { -3, 0.2f, 0.1f } };
+		const unsigned int segmentCounts[] = { 3, 4, 7, DEBUG_CIRCLE_SEGMENTS, 200 };
+		unsigned int circles = 0;
+		unsigned int goodCircles = 0;
+		for (auto& normal : normals)
+		{
+			for (unsigned int segments : segmentCounts)
+			{
+				batch.Clear();
+				batch.AddCircle(center, normal, 1.5f, RED, segments);
+				circles++;
+				if (batch.GetLineCount() == segments && IsClosedLoop(v, 0, v.size()) && OnCircle(v, 0, v.size(), center, normal, 1.5f))
+					goodCircles++;
+			}
+		}
+		Expect(goodCircles == circles, "a circle is a closed loop of as many lines as segments, on the circle");
+
+		batch.Clear();
+		batch.AddCircle(center, normals[0], 1.0f, RED, 1);
+		Expect(batch.GetLineCount() == 3, "a circle has at least three segments");
+		batch.Clear();
+		const float zero[3] = { 0, 0, 0 };
+		batch.AddCircle(center, zero, 1.0f, RED);
+		Expect(batch.GetLineCount() == 0, "a circle with no normal draws nothing");
+
+		batch.Clear();
+		batch.AddSphere(center, 2.0f, RED);
+		const size_t ring = DEBUG_CIRCLE_SEGMENTS * 2;
+		bool sphere = batch.GetLineCount() == 3 * DEBUG_CIRCLE_SEGMENTS;
+		for (int axis = 0; axis < 3 && sphere; axis++)
+		{
+			float normal[3] = { 0, 0, 0 };
+			normal[axis] = 1.0f;
+			sphere = IsClosedLoop(v, axis * ring, ring) && OnCircle(v, axis * ring, ring, center, normal, 2.0f);
+		}
+		Expect(sphere, "a sphere is three closed circles, one around each axis");
+
+		batch.Clear();
+		const float transform[4][4] = { { 0, 1, 0, 0 }, { -1, 0, 0, 0 }, { 0, 0, 1, 0 }, { 5, 6, 7, 1 } };
+		batch.AddAxes(transform, 2.0f);
+		const float origin[3] = { 5, 6, 7 };
+		const float ends[3][3] = { { 5, 8, 7 }, { 3, 6, 7 }, { 5, 6, 9 } };
+		bool axes = batch.GetLineCount() == 3;
+		for (int axis = 0; axis < 3 && axes; axis++)
+		{
+			axes = Distance(v[axis * 2].position, origin) < 1e-5f && Distance(v[axis * 2 + 1].position, ends[axis]) < 1e-5f &&
+				v[axis * 2].color[axis] == 1.0f && v[axis * 2].color[(axis + 1) % 3] == 0.0f;
+		}
+		Expect(axes, "axes are red, green and blue lines along the transformed x, y and z");
+
+		batch.Clear();
+		const float c[3] = { 0, 0, 1 };
+		batch.AddTriangle(a, b, c, RED);
+		Expect(batch.GetLineCount() == 3 && IsClosedLoop(v, 0, v.size()), "a triangle is a closed loop of three lines");
+
+		batch.Clear();
+		const float minCoords[3] = { -1, 2, 0 };
+		const float maxCoords[3] = { 4, 3, 0.5f };
+		batch.AddAABB(minCoords, maxCoords, RED);
+		bool aabb = batch.GetLineCount() == 12 && IsBox(v, 0);
+		for (size_t e = 0; e < 12 && aabb; e++)
+		{
+			// Each edge runs the box's full size along one axis
+			int moved = 0;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float d = std::fabs(v[e * 2 + 1].position[axis] - v[e * 2].position[axis]);
+				if (d > 0.0f)
+				{
+					moved++;
+					aabb = aabb && d == maxCoords[axis] - minCoords[axis];
+				}
+			}
+			aabb = aabb && moved == 1;
+		}
+		Expect(aabb, "an AABB is twelve axis aligned edges the length of its sides");
+
+		batch.Clear();
+		const float size[3] = { 2, 4, 6 };
+		batch.AddOBB(transform, size, RED);
+		unsigned int lengths[3] = { 0, 0, 0 };
+		for (size_t e = 0; e < batch.GetLineCount(); e++)
+		{
+			float length = Distance(v[e * 2].position, v[e * 2 + 1].position);
+			for (int axis = 0; axis < 3; axis++)
+			{
+				if (std::fabs(length - size[axis]) < 1e-5f)
+					lengths[axis]++;
+			}
+		}
+		Expect(batch.GetLineCount() == 12 && IsBox(v, 0) && lengths[0] == 4 && lengths[1] == 4 && lengths[2] == 4,
+			"an OBB is twelve edges, four of each side's length");
+
+		// An orthographic view projection that is its own
+		// inverse, so the frustum is clip space itself
+		batch.Clear();
+		const float identity[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+		batch.AddFrustum(identity, RED);
+		bool frustum = batch.GetLineCount() == 12 && IsBox(v, 0);
+		for (size_t i = 0; i < v.size() && frustum; i++)
+		{
+			const float* p = v[i].position;
+			frustum = std::fabs(p[0]) == 1.0f && std::fabs(p[1]) == 1.0f && (p[2] == 0.0f || p[2] == 1.0f);
+		}
+		Expect(frustum, "a frustum is a box between the clip space corners, depth 0 to 1");
+
+		DebugLineBatch other;
+		other.AddSphere(center, 1.0f, RED);
+		size_t before = batch.GetLineCount();
+		batch.Append(other);
+		Expect(batch.GetLineCount() == before + other.GetLineCount() &&
+			memcmp(&v[before * 2], other.GetVertices().data(), other.GetVertices().size() * sizeof(DebugVertex)) == 0,
+			"appending copies every line on the end");
+	}
+
+	// An item added during the expiry check, found again in
+	// the frame's lines by the id in its color
+	struct TrackedItem
+	{
+		unsigned int id;
+		unsigned int lines;
+		bool frameOnly;						// No duration, drawn only in the frame it was added in
+		unsigned long long expiry;			// Its tick, or for one lasting a frame its frame
+	};
+
+	// Ticks an item lasts, at least one
+	unsigned long long LifetimeTicks(float duration)
+	{
+		unsigned long long ticks = (unsigned long long)std::ceil(duration / DEBUG_LIFETIME_TICK);
+		return ticks < 1 ? 1 : ticks;
+	}
+
+	// Frames the way the game runs them: time moves on, items
+	// are added, then the frame's lines and every live timed
+	// item's are collected and the frame batch emptied
+	void CheckExpiry(unsigned int frames)
+	{
+		printf("Expiry:\n");
+		std::mt19937 random(7);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		const float frameTimes[] = { 1.0f / 60.0f, 1.0f / 144.0f, 1.0f / 30.0f, 0.05f, DEBUG_LIFETIME_TICK };
+		const float durations[] = { 0.0f, 0.001f, DEBUG_LIFETIME_TICK, 2.0f * DEBUG_LIFETIME_TICK, 0.5f, 1.0f,
+			DEBUG_LIFETIME_BUCKETS * DEBUG_LIFETIME_TICK, -1.0f };
+
+		DebugLineBatch frame;
+		DebugLineLifetimes timed;
+		std::vector<TrackedItem> tracked;
+		std::vector<unsigned int> seen;
+		double time = 0;
+		unsigned long long tick = 0;
+		unsigned int nextId = 0;
+
+		unsigned int early = 0;			// Gone before its tick
+		unsigned int late = 0;			// Still drawn on or after its tick
+		unsigned int partial = 0;		// Drawn with lines missing or doubled
+		unsigned int miscounted = 0;	// Item or line counts off
+		unsigned int frameOnly = 0;
+		unsigned int laps = 0;			// Outlived the ring at least once
+		for (unsigned int f = 0; f < frames; f++)
+		{
+			// Every so often a hitch longer than the whole ring
+			float deltaTime = f % 997 == 996 ? 3.0f : frameTimes[random() % 5];
+			timed.Advance(deltaTime);
+			time += deltaTime;
+			tick = (std::max)(tick, (unsigned long long)(time / DEBUG_LIFETIME_TICK));
+
+			unsigned int items = 1 + random() % 12;
+			for (unsigned int i = 0; i < items; i++)
+			{
+				float duration = durations[random() % 8];
+				if (duration < 0.0f)
+					duration = unit(random) * 6.0f;
+
+				TrackedItem item = { nextId++, 0, duration <= 0.0f, 0 };
+				item.expiry = item.frameOnly ? f : tick + LifetimeTicks(duration);
+				frameOnly += item.frameOnly;
+				laps += !item.frameOnly && item.expiry - tick > DEBUG_LIFETIME_BUCKETS;
+
+				// As BeginDebugItem and EndDebugItem do
+				DebugLineBatch& lines = item.frameOnly ? frame : timed.BeginItem(duration);
+				float color[4] = { (float)item.id, 0, 0, 1 };
+				if (random() % 4 == 0)
+				{
+					lines.AddSphere(RED, 1.0f, color, 4);
+					item.lines = 12;
+				}
+				else
+				{
+					item.lines = 1 + random() % 3;
+					for (unsigned int l = 0; l < item.lines; l++)
+						lines.AddLine(RED, color, color);
+				}
+				if (!item.frameOnly)
+					timed.EndItem();
+				tracked.push_back(item);
+			}
+
+			// As CollectDebugLines does
+			timed.AppendTo(frame);
+			seen.assign(nextId, 0);
+			for (const DebugVertex& vertex : frame.GetVertices())
+				seen[(unsigned int)vertex.color[0]]++;
+			frame.Clear();
+
+			size_t liveItems = 0;
+			size_t liveLines = 0;
+			size_t kept = 0;
+			for (const TrackedItem& item : tracked)
+			{
+				unsigned int drawn = seen[item.id];
+				bool live = item.frameOnly ? item.expiry == f : item.expiry > tick;
+				if (live && drawn == 0)
+					early++;
+				else if (!live && drawn > 0)
+					late++;
+				else if (drawn > 0 && drawn != item.lines * 2)
+					partial++;
+
+				if (live && !item.frameOnly)
+				{
+					liveItems++;
+					liveLines += item.lines;
+				}
+
+				// Checked gone once, then forgotten
+				if (live)
+					tracked[kept++] = item;
+			}
+			tracked.resize(kept);
+
+			if (timed.GetItemCount() != liveItems || timed.GetLineCount() != liveLines)
+				miscounted++;
+		}
+
+		printf("%u items over %u frames, %u lasting one frame, %u going around the ring: %u early, %u late, %u partial, %u frames miscounted\n",
+			nextId, frames, frameOnly, laps, early, late, partial, miscounted);
+		Expect(early == 0 && late == 0 && partial == 0 && miscounted == 0, "every item is drawn in exactly the frames before its tick");
+
+		timed.Clear();
+		timed.AppendTo(frame);
+		Expect(timed.GetItemCount() == 0 && timed.GetLineCount() == 0 && frame.GetLineCount() == 0, "clearing drops every timed item");
+	}
+
+	template <typename T>
+	void Put(std::vector<unsigned char>& data, const T& value)
+	{
+		const unsigned char* bytes = (const unsigned char*)&value;
+		data.insert(data.end(), bytes, bytes + sizeof(T));
+	}
+
+	// A .spritefont with a handful of glyphs whose metrics are
+	// easy to follow by hand, on a 32 x 16 atlas
+	std::vector<unsigned char> MakeFont()
+	{
+		const DebugGlyph glyphs[] =
+		{
+			{ ' ', 0, 0, 4, 10, 0.0f, 0.0f, 1.0f },
+			{ '?', 19, 0, 25, 10, 0.0f, 1.0f, 0.0f },
+			{ 'A', 4, 0, 12, 10, -1.0f, 2.0f, 1.0f },
+			{ 'B', 12, 0, 19, 12, 0.0f, 0.0f, 2.0f },
+			{ 0xE9, 25, 0, 30, 10, 0.5f, 0.0f, 1.0f },
+		};
+
+		std::vector<unsigned char> data;
+		data.insert(data.end(), "DXTKfont", "DXTKfont" + 8);
+		Put(data, (unsigned int)(sizeof(glyphs) / sizeof(glyphs[0])));
+		for (const DebugGlyph& glyph : glyphs)
+			Put(data, glyph);
+		Put(data, 16.0f);
+		Put(data, (unsigned int)'?');
+
+		// Width, height, format, pitch and rows, then the pixels
+		Put(data, 32u);
+		Put(data, 16u);
+		Put(data, 28u);
+		Put(data, 128u);
+		Put(data, 16u);
+		data.resize(data.size() + 128 * 16, 0xFF);
+		return data;
+	}
+
+	bool SameRect(const float a[4], float x0, float y0, float x1, float y1)
+	{
+		return std::fabs(a[0] - x0) < 1e-5f && std::fabs(a[1] - y0) < 1e-5f &&
+			std::fabs(a[2] - x1) < 1e-5f && std::fabs(a[3] - y1) < 1e-5f;
+	}
+
+	void CheckText()
+	{
+		printf("Text:\n");
+		std::vector<unsigned char> data = MakeFont();
+		DebugFont font;
+		Expect(!font.Parse(data.data(), data.size() - 1), "a cut short font doesn't load");
+		Expect(!font.IsLoaded(), "nor is left half loaded");
+		data[0] = 'X';
+		Expect(!font.Parse(data.data(), data.size()), "a font without its magic doesn't load");
+		data[0] = 'D';
+		Expect(font.Parse(data.data(), data.size()) && font.GetAtlasWidth() == 32 && font.GetAtlasHeight() == 16 &&
+			font.GetAtlasData().size() == 128 * 16 && font.GetLineSpacing() == 16.0f, "the made up font loads");
+
+		// 'A' pulls left past the start and is held there, the
+		// space only advances, "\r" is skipped, 'z' isn't in the
+		// font so '?' stands in, and the last is past ASCII
+		std::shared_ptr<const DebugTextLayout> layout = font.Layout("AB A\r\nBz\xE9");
+		const std::vector<DebugTextQuad>& q = layout->quads;
+		Expect(q.size() == 6, "a quad for every glyph but the space");
+		if (q.size() == 6)
+		{
+			Expect(SameRect(q[0].rect, 0, 2, 8, 12) && SameRect(q[1].rect, 9, 0, 16, 12) && SameRect(q[2].rect, 22, 2, 30, 12),
+				"each glyph advances by its width, offset and advance");
+			Expect(SameRect(q[3].rect, 0, 16, 7, 28), "a newline starts again at the left a line lower");
+			Expect(SameRect(q[4].rect, 9, 17, 15, 27), "an unknown character is the default glyph");
+			Expect(SameRect(q[5].rect, 15.5f, 16, 20.5f, 26), "a character past ASCII is found");
+			Expect(SameRect(q[0].uv, 4.0f / 32, 0, 12.0f / 32, 10.0f / 16) && SameRect(q[4].uv, 19.0f / 32, 0, 25.0f / 32, 10.0f / 16),
+				"uvs are the glyph's rect over the atlas size");
+		}
+		Expect(layout->width == 31.0f && layout->height == 32.0f, "the size covers the widest line and every line");
+
+		Expect(font.Layout("AB A\r\nBz\xE9") == layout && font.GetCacheHits() == 1 && font.GetCacheMisses() == 1,
+			"a string seen before is laid out once");
+		Expect(font.Layout("   ")->quads.empty() && font.Layout("")->quads.empty(), "blank strings have no quads");
+
+		// Straight through to clip space, so a point at the
+		// origin lands in the middle of a 100 x 100 screen
+		const float identity[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+		const float middle[3] = { 0, 0, 0.5f };
+		const float beyond[3] = { 0, 0, 2.0f };
+		const float offScreen[3] = { 4.0f, 0, 0.5f };
+		DebugTextBatch batch;
+		std::vector<DebugGlyphInstance> out;
+		batch.Add(middle, font.Layout("   "), RED, 1.0f, 0.0f);
+		Expect(batch.GetLabelCount() == 0, "a label with nothing to draw isn't kept");
+
+		batch.Add(middle, layout, RED, 2.0f, 0.0f);
+		batch.Add(beyond, layout, RED, 1.0f, 0.0f);
+		batch.Add(offScreen, layout, RED, 1.0f, 0.0f);
+		batch.Build(identity, 100.0f, 100.0f, out);
+		Expect(out.size() == 6, "labels past the far plane or off screen are skipped");
+		if (out.size() == 6)
+		{
+			// Centered on the point and sitting on it, scaled
+			Expect(SameRect(out[0].rect, 19, -10, 35, 10) && SameRect(out[3].rect, 19, 18, 33, 42) &&
+				memcmp(out[0].color, RED, sizeof(RED)) == 0, "a label is centered above its point at its scale");
+		}
+		Expect(batch.GetLabelCount() == 0, "labels without a duration last one build");
+
+		batch.Add(middle, layout, RED, 1.0f, 0.25f);
+		batch.Add(middle, layout, RED, 1.0f, 0.5f);
+		for (int build = 0; build < 2; build++)
+		{
+			out.clear();
+			batch.Build(identity, 100.0f, 100.0f, out);
+		}
+		Expect(batch.GetTimedLabelCount() == 2 && out.size() == 12, "timed labels last across builds");
+		batch.Advance(0.25f);
+		Expect(batch.GetTimedLabelCount() == 1, "a timed label is gone once its time is up");
+		batch.Advance(0.25f);
+		Expect(batch.GetLabelCount() == 0, "and so is the last");
+	}
+
+	// The font the game draws with, if it's where the game
+	// keeps it
+	bool LoadGameFont(DebugFont& font)
+	{
+		FILE* file = fopen("../../Assets/Textures/arial.spritefont", "rb");
+		if (!file)
+			return false;
+
+		std::vector<unsigned char> data;
+		unsigned char buffer[4096];
+		size_t read;
+		while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			data.insert(data.end(), buffer, buffer + read);
+		fclose(file);
+		return font.Parse(data.data(), data.size());
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int lines = 100000;
+	unsigned int iterations = 32;
+	unsigned int frames = 4000;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+			lines = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+			iterations = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+			frames = (unsigned int)atoi(argv[++i]);
+		else
+		{
+			printf("Usage: %s [-l lines] [-i iterations] [-f frames]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	printf("Shapes:\n");
+	CheckShapes();
+	CheckExpiry(frames);
+	CheckText();
+
+	DebugLineBenchmark b = BenchmarkDebugLines(lines, iterations);
+	printf("%u lines a frame: %.3f ms as single lines, %.3f ms as spheres\n", b.lineCount, b.linesMS, b.spheresMS);
+
+	// As the Inspector runs it
+	DebugLifetimeBenchmark l = BenchmarkDebugLifetimes(lines, 2.0f);
+	printf("%u timed items up to 2 s: %.3f ms adding, %u frames to expire, %.3f ms advancing, %.3f ms the slowest frame\n",
+		l.itemCount, l.addMS, l.frames, l.advanceMS, l.worstAdvanceMS);
+	Expect(l.frames <= 2 * 60 + 1, "every benchmark item expired by its last tick");
+
+	DebugFont font;
+	if (LoadGameFont(font))
+	{
+		std::shared_ptr<const DebugTextLayout> name = font.Layout("Entity 37");
+		Expect(name->quads.size() == 8 && name->height == font.GetLineSpacing(), "a name in the game's font is a quad a letter on one line");
+
+		DebugTextBenchmark t = BenchmarkDebugText(font, 5000, iterations);
+		printf("%u labels a frame: %.3f ms adding, %.3f ms building %u glyphs\n", t.labelCount, t.addMS, t.buildMS, t.glyphCount);
+	}
+	else
+		printf("No game font in ../../Assets/Textures, not timing labels\n");
+
+	printf("%s\n", failures == 0 ? "All passed" : "Failures above");
+	return failures == 0 ? 0 : 1;
+}
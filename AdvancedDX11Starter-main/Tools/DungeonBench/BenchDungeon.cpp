@@ -0,0 +1,98 @@
+// Developer: Narai
+// Purpose: Headless check of the dungeon generator. Lays out
+//			maps of growing size from one seed and builds their
+//			chunks on one thread and across a job graph, which
+//			must come out byte for byte the same. The smallest
+//			is then given a navigation mesh built from its
+//			collision, and every room must be reachable from
+//			the first.
+//
+// Build and run on Linux, from this folder:
+//
+//		g++ -O2 -std=c++14 -pthread -I../.. BenchDungeon.cpp ../../Dungeon.cpp ../../NavMesh.cpp ../../RenderJobGraph.cpp -o BenchDungeon
+//		./BenchDungeon
+//
+// Options: -w <workers> for the job graph, 4 by default, and
+// -s <seed>, 1 by default.
+
+#include "Dungeon.h"
+#include "NavMesh.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+	unsigned int workers = 4;
+	unsigned int seed = 1;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+			workers = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seed = (unsigned int)strtoul(argv[++i], nullptr, 10);
+		else
+		{
+			printf("Usage: %s [-w workers] [-s seed]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	int failures = 0;
+	const unsigned int sizes[] = { 64, 256, 1024 };
+	for (unsigned int tiles : sizes)
+	{
+		DungeonBenchmark b = BenchmarkDungeon(tiles, seed, workers);
+		printf("%4u tiles: %5u rooms, %8u triangles in %5u chunks, layout %7.2f ms, chunks %8.2f ms serial, %8.2f ms over %u workers, %s (%016llx)\n",
+			b.tiles, b.rooms, b.triangles, b.chunks, b.layoutMS, b.serialChunksMS, b.parallelChunksMS, b.workerCount,
+			b.deterministic ? "same" : "DIFFERENT", (unsigned long long)b.hash);
+		if (!b.deterministic)
+			failures++;
+	}
+
+	// Nav data comes from the same triangles as collision
+	DungeonSettings settings = DefaultDungeonSettings();
+	settings.seed = seed;
+	settings.width = settings.depth = sizes[0];
+	Dungeon dungeon;
+	dungeon.Generate(settings);
+	dungeon.BuildChunks();
+
+	std::vector<float> triangles;
+	for (unsigned int c = 0; c < dungeon.GetChunkCount(); c++)
+	{
+		const std::vector<float>& collision = dungeon.GetChunk(c).collision;
+		triangles.insert(triangles.end(), collision.begin(), collision.end());
+	}
+
+	NavMesh mesh;
+	mesh.Build(triangles.data(), triangles.size() / 9, DefaultNavBuildSettings());
+
+	NavQuery query;
+	query.Init(&mesh);
+	unsigned int unreached = 0;
+	float start[3];
+	const DungeonRoom& first = dungeon.GetRoom(0);
+	dungeon.GetTileCenter(first.x + first.width / 2, first.z + first.depth / 2, start);
+	for (unsigned int r = 1; r < dungeon.GetRoomCount(); r++)
+	{
+		const DungeonRoom& room = dungeon.GetRoom(r);
+		float end[3];
+		dungeon.GetTileCenter(room.x + room.width / 2, room.z + room.depth / 2, end);
+
+		unsigned int steps = 0;
+		NavPathStatus status = query.Begin(start, end);
+		while (status == NavPathStatus::Searching)
+			status = query.Step(1024, &steps);
+		if (status != NavPathStatus::Found)
+			unreached++;
+	}
+	printf("%4u tiles: %u nav polygons built in %.2f ms, %u of %u rooms unreachable from the first\n",
+		sizes[0], mesh.GetPolyCount(), mesh.GetBuildMS(), unreached, dungeon.GetRoomCount() - 1);
+	if (unreached > 0)
+		failures++;
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,335 @@
+// Developer: Narai
+// Purpose: Headless check of the entity store's deferred
+//			changes. By hand: an ID handed out by Create names
+//			nothing until ApplyChanges, destroying entities from
+//			inside ForEachChunk moves no rows until ApplyChanges,
+//			and a slot that is used again comes back on a new
+//			generation so old IDs to it stay dead. Then runs
+//			random creates, destroys and component changes
+//			against a copy kept on the side, checking after
+//			every ApplyChanges that each entity is where its
+//			slot says, with the components it should have.
+//
+// Build and run on Linux, from this folder:
+//
+//		g++ -O2 -std=c++14 -I../.. CheckEntities.cpp ../../EntityStore.cpp -o CheckEntities
+//		./CheckEntities
+//
+// Options: -r <rounds> of random changes, 2000 by default.
+
+#include "EntityStore.h"
+
+#include <map>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	const unsigned int TRANSFORM = COMPONENT_BIT(TransformComponent);
+	const unsigned int GAMEPLAY = COMPONENT_BIT(GameplayComponent);
+
+	int failures = 0;
+
+	void Expect(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			printf("  FAILED: %s\n", what);
+			failures++;
+		}
+	}
+
+	// Every entity tagged through its x position, which every
+	// mask used here keeps
+	EntityDesc Tagged(unsigned int mask, float tag)
+	{
+		EntityDesc desc = {};
+		desc.mask = mask;
+		desc.transform = DefaultTransform();
+		desc.transform.position[0] = tag;
+		desc.gameplay.health = tag;
+		return desc;
+	}
+
+	// Which ID sits in every row of every chunk right now
+	std::map<std::pair<const EntityChunk*, unsigned int>, EntityId> Rows(EntityStore& store)
+	{
+		std::map<std::pair<const EntityChunk*, unsigned int>, EntityId> rows;
+		store.ForEachChunk(0, [&](EntityChunk& chunk)
+		{
+			for (unsigned int row = 0; row < chunk.count; row++)
+				rows[std::make_pair((const EntityChunk*)&chunk, row)] = chunk.ids[row];
+		});
+		return rows;
+	}
+
+	void CheckByHand()
+	{
+		printf("By hand:\n");
+		EntityStore store;
+
+		// Named but not there until the frame boundary
+		EntityId first = store.Create(Tagged(TRANSFORM | GAMEPLAY, 1.0f));
+		unsigned int visited = 0;
+		store.ForEachChunk(0, [&](EntityChunk& chunk) { visited += chunk.count; });
+		Expect(store.IsValid(first) && !store.IsAlive(first), "a new ID is valid but not alive before ApplyChanges");
+		Expect(store.Get<TransformComponent>(first) == nullptr && store.GetComponentMask(first) == 0 &&
+			visited == 0 && store.GetEntityCount() == 0, "and has no components and isn't visited");
+
+		store.ApplyChanges();
+		Expect(store.IsAlive(first) && store.Get<GameplayComponent>(first) && store.Get<GameplayComponent>(first)->health == 1.0f,
+			"ApplyChanges places it with what it was made with");
+
+		// Destroyed before it was ever placed, the slot is let go
+		// at once and the ID is dead for good
+		EntityId never = store.Create(Tagged(TRANSFORM, 2.0f));
+		store.Destroy(never);
+		Expect(!store.IsValid(never), "an entity destroyed before ApplyChanges is invalid at once");
+		store.ApplyChanges();
+		Expect(!store.IsAlive(never) && store.GetEntityCount() == 1, "and never placed");
+
+		// A few chunks' worth, then every other one destroyed
+		// while walking them. Nothing moves until the boundary
+		std::vector<EntityId> ids;
+		ids.push_back(first);
+		for (unsigned int i = 0; i < ENTITY_CHUNK_CAPACITY * 3; i++)
+			ids.push_back(store.Create(Tagged(TRANSFORM, 100.0f + i)));
+		store.ApplyChanges();
+
+		auto before = Rows(store);
+		bool stayed = true;
+		unsigned int destroyed = 0;
+		store.ForEachChunk(TRANSFORM, [&](EntityChunk& chunk)
+		{
+			for (unsigned int row = 0; row < chunk.count; row++)
+			{
+				if (before[std::make_pair((const EntityChunk*)&chunk, row)] != chunk.ids[row])
+					stayed = false;
+				if (chunk.ids[row].index % 2 == 0)
+				{
+					store.Destroy(chunk.ids[row]);
+					destroyed++;
+				}
+			}
+		});
+		Expect(stayed && Rows(store) == before, "destroying inside ForEachChunk moves no rows");
+
+		bool aliveUntilApplied = true;
+		for (EntityId id : ids)
+			aliveUntilApplied = aliveUntilApplied && store.IsAlive(id);
+		Expect(aliveUntilApplied && store.GetPendingChangeCount() == destroyed, "destroyed entities stay alive until ApplyChanges");
+
+		store.ApplyChanges();
+		unsigned int alive = 0;
+		for (EntityId id : ids)
+			alive += store.IsAlive(id);
+		Expect(alive == ids.size() - destroyed, "ApplyChanges removes exactly those");
+
+		// The freed slots are handed out again on a newer
+		// generation, so the old IDs don't name the new entities
+		std::vector<EntityId> reused;
+		for (unsigned int i = 0; i < destroyed; i++)
+			reused.push_back(store.Create(Tagged(TRANSFORM, -1.0f)));
+		store.ApplyChanges();
+		bool newer = true;
+		bool oldDead = true;
+		for (EntityId id : ids)
+		{
+			if (id.index % 2 != 0)
+				continue;
+			oldDead = oldDead && !store.IsValid(id) && store.Get<TransformComponent>(id) == nullptr;
+		}
+		for (EntityId id : reused)
+		{
+			bool found = false;
+			for (EntityId old : ids)
+			{
+				if (old.index == id.index)
+				{
+					found = true;
+					newer = newer && id.generation > old.generation;
+				}
+			}
+			newer = newer && found;
+		}
+		Expect(newer, "a reused slot comes back on a newer generation");
+		Expect(oldDead, "and the old IDs to it stay dead");
+	}
+
+	// The side copy of one entity
+	struct Expected
+	{
+		unsigned int mask;
+		float tag;
+		bool hasHealth;			// Gameplay since it was made, not added later zeroed
+	};
+
+	void CheckRandom(unsigned int rounds)
+	{
+		printf("Random:\n");
+		std::mt19937 random(5);
+		const unsigned int masks[] = { TRANSFORM, TRANSFORM | GAMEPLAY, COMPONENTS_RENDERABLE, COMPONENTS_RENDERABLE | GAMEPLAY };
+
+		EntityStore store;
+		std::map<unsigned int, std::pair<EntityId, Expected>> live;		// By slot index
+		std::vector<std::pair<EntityId, Expected>> pending;
+		std::vector<EntityId> dead;
+		std::vector<unsigned int> generations;							// Latest seen for every slot
+		float nextTag = 1.0f;
+
+		unsigned int early = 0;			// Alive or visited before ApplyChanges
+		unsigned int moved = 0;			// Rows moved by a destroy inside ForEachChunk
+		unsigned int stale = 0;			// A slot reused without a newer generation
+		unsigned int lost = 0;			// Missing, in the wrong place or with the wrong components
+		unsigned int resurrected = 0;	// A destroyed ID alive again
+		unsigned int miscounted = 0;
+		unsigned int peak = 0;
+		for (unsigned int r = 0; r < rounds; r++)
+		{
+			// Grow for a while, then shrink, then grow again
+			bool growing = (r / 200) % 2 == 0;
+			unsigned int creates = random() % (growing ? 300 : 60);
+			for (unsigned int i = 0; i < creates; i++)
+			{
+				Expected e = { masks[random() % 4], nextTag++, false };
+				e.hasHealth = (e.mask & GAMEPLAY) != 0;
+				EntityId id = store.Create(Tagged(e.mask, e.tag));
+				if (id.index >= generations.size())
+					generations.resize(id.index + 1, 0);
+				if (id.generation <= generations[id.index])
+					stale++;
+				generations[id.index] = id.generation;
+				if (store.IsAlive(id) || store.Get<TransformComponent>(id))
+					early++;
+
+				// Some are destroyed again before they are placed
+				if (random() % 10 == 0)
+				{
+					store.Destroy(id);
+					dead.push_back(id);
+				}
+				else
+					pending.push_back(std::make_pair(id, e));
+			}
+
+			// Destroys from inside the walk, as gameplay would
+			auto before = Rows(store);
+			unsigned int visitedNew = 0;
+			std::vector<EntityId> destroyed;
+			unsigned int odds = growing ? 8 : 2;
+			store.ForEachChunk(TRANSFORM, [&](EntityChunk& chunk)
+			{
+				for (unsigned int row = 0; row < chunk.count; row++)
+				{
+					if (before[std::make_pair((const EntityChunk*)&chunk, row)] != chunk.ids[row])
+						moved++;
+					if (live.find(chunk.ids[row].index) == live.end())
+						visitedNew++;
+					if (random() % odds == 0)
+					{
+						store.Destroy(chunk.ids[row]);
+						destroyed.push_back(chunk.ids[row]);
+					}
+				}
+			});
+			if (Rows(store) != before)
+				moved++;
+			early += visitedNew;
+
+			// Component changes, all keeping the transform
+			for (auto& entry : live)
+			{
+				if (random() % 16 != 0)
+					continue;
+				unsigned int mask = masks[random() % 4];
+				store.SetComponentMask(entry.second.first, mask);
+				if (!(mask & GAMEPLAY) || !(entry.second.second.mask & GAMEPLAY))
+					entry.second.second.hasHealth = false;
+				entry.second.second.mask = mask;
+			}
+
+			store.ApplyChanges();
+
+			// Destroys win over component changes made the same frame
+			for (EntityId id : destroyed)
+			{
+				if (live.erase(id.index) > 0)
+					dead.push_back(id);
+			}
+			for (auto& p : pending)
+				live[p.first.index] = p;
+			pending.clear();
+
+			for (auto& entry : live)
+			{
+				EntityId id = entry.second.first;
+				const Expected& e = entry.second.second;
+				TransformComponent* transform = store.Get<TransformComponent>(id);
+				GameplayComponent* gameplay = store.Get<GameplayComponent>(id);
+				if (!store.IsAlive(id) || store.GetComponentMask(id) != e.mask || !transform || transform->position[0] != e.tag ||
+					((e.mask & GAMEPLAY) != 0) != (gameplay != nullptr) ||
+					(gameplay && gameplay->health != (e.hasHealth ? e.tag : 0.0f)))
+					lost++;
+			}
+
+			// Every row's ID points back at that row
+			unsigned int visited = 0;
+			store.ForEachChunk(0, [&](EntityChunk& chunk)
+			{
+				TransformComponent* transforms = chunk.Get<TransformComponent>();
+				for (unsigned int row = 0; row < chunk.count; row++)
+				{
+					visited++;
+					EntityId id = chunk.ids[row];
+					if (live.find(id.index) == live.end() || live[id.index].first != id || store.Get<TransformComponent>(id) != transforms + row)
+						lost++;
+				}
+			});
+
+			for (EntityId id : dead)
+			{
+				if (store.IsValid(id) || store.IsAlive(id))
+					resurrected++;
+			}
+			if (dead.size() > 4096)
+				dead.erase(dead.begin(), dead.begin() + dead.size() / 2);
+
+			if (visited != live.size() || store.GetEntityCount() != live.size() || store.GetPendingChangeCount() != 0)
+				miscounted++;
+			if (live.size() > peak)
+				peak = (unsigned int)live.size();
+		}
+
+		printf("%u rounds, up to %u entities in %u chunks: %u early, %u moved, %u stale, %u lost, %u resurrected, %u miscounted\n",
+			rounds, peak, store.GetChunkCount(), early, moved, stale, lost, resurrected, miscounted);
+		Expect(early == 0, "nothing is alive or visited before ApplyChanges");
+		Expect(moved == 0, "destroying inside ForEachChunk moves no rows");
+		Expect(stale == 0 && resurrected == 0, "reused slots come back on a newer generation");
+		Expect(lost == 0 && miscounted == 0, "every entity is where its slot says, with its components");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int rounds = 2000;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+			rounds = (unsigned int)atoi(argv[++i]);
+		else
+		{
+			printf("Usage: %s [-r rounds]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	CheckByHand();
+	CheckRandom(rounds);
+
+	printf("%s\n", failures == 0 ? "All passed" : "Failures above");
+	return failures == 0 ? 0 : 1;
+}
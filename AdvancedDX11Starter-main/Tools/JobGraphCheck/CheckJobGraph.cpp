@@ -0,0 +1,225 @@
+// Developer: Narai
+// Purpose: Headless check of the render job graph. Records a
+//			diamond of jobs, plus a few with nothing to wait
+//			on, into stand-in contexts serially and on workers,
+//			and checks that no job started before what it
+//			depends on finished, that no context was recorded
+//			into from two threads, and that the command lists
+//			are played back in the order the jobs were added.
+//			Also checks that depending on a job not yet added
+//			aborts.
+//
+// Build and run on Linux, from this folder:
+//
+//		g++ -O2 -std=c++14 -pthread -I../.. CheckJobGraph.cpp ../../RenderJobGraph.cpp -o CheckJobGraph
+//		./CheckJobGraph
+//
+// Options: -r <rounds> of each, 500 by default.
+
+#include "RenderJobGraph.h"
+
+#include <atomic>
+#include <chrono>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+	// Stands in for a deferred context. Commands pile up until
+	// FinishCommandList() hands them over as a list, and two
+	// threads recording into it at once is noticed
+	struct StubContext
+	{
+		std::atomic<int> recorders;
+		bool overlapped;
+		std::vector<int> commands;
+
+		void Begin()
+		{
+			if (recorders.fetch_add(1) != 0)
+				overlapped = true;
+		}
+
+		void Draw(int command) { commands.push_back(command); }
+
+		void FinishCommandList(std::vector<int>* list)
+		{
+			list->swap(commands);
+			commands.clear();
+			recorders.fetch_sub(1);
+		}
+	};
+
+	// Sleeps a little, more for some jobs than others, so
+	// workers finish in a different order from round to round
+	void Work(unsigned int job, unsigned int round)
+	{
+		unsigned int micros = ((job * 7919 + round * 104729) % 5) * 40;
+		if (micros > 0)
+			std::this_thread::sleep_for(std::chrono::microseconds(micros));
+	}
+
+	struct Round
+	{
+		unsigned int orderFailures;		// A job started before one it depends on finished
+		unsigned int overlaps;			// A context was recorded into from two threads at once
+		unsigned int submitFailures;	// Played back out of order or with the wrong commands
+		unsigned int slotsUsed;
+	};
+
+	// A -> (B, C) -> D, with E, F and G on their own, G waiting
+	// on E
+	Round RunRound(RenderJobGraph& graph, bool parallel, unsigned int round)
+	{
+		const unsigned int jobCount = 7;
+		const unsigned int commandsPerJob = 3;
+
+		StubContext contexts[jobCount];
+		for (StubContext& c : contexts)
+		{
+			c.recorders = 0;
+			c.overlapped = false;
+		}
+		std::vector<int> commandLists[jobCount];
+
+		// Every job stamps when it started and finished
+		std::atomic<unsigned int> clock(0);
+		unsigned int started[jobCount];
+		unsigned int finished[jobCount];
+
+		graph.Reset();
+		auto add = [&](const char* name, std::vector<unsigned int> dependencies)
+		{
+			unsigned int index = graph.GetJobCount();
+			return graph.AddJob(name, [&, index](unsigned int)
+			{
+				started[index] = clock++;
+				StubContext& c = contexts[index];
+				c.Begin();
+				for (unsigned int k = 0; k < commandsPerJob; k++)
+				{
+					c.Draw((int)(index * 100 + k));
+					Work(index + k, round);
+				}
+				c.FinishCommandList(&commandLists[index]);
+				finished[index] = clock++;
+			}, Span<const unsigned int>(dependencies));
+		};
+
+		unsigned int a = add("A", {});
+		unsigned int e = add("E", {});
+		unsigned int b = add("B", { a });
+		unsigned int c = add("C", { a });
+		add("F", {});
+		add("D", { b, c });
+		add("G", { e });
+
+		graph.Run(parallel);
+
+		Round result = {};
+		for (unsigned int j = 0; j < graph.GetJobCount(); j++)
+		{
+			const RenderJob& job = graph.GetJob(j);
+			for (unsigned int d : job.dependencies)
+			{
+				if (finished[d] >= started[j])
+					result.orderFailures++;
+			}
+			if (contexts[j].overlapped)
+				result.overlaps++;
+			result.slotsUsed |= 1u << job.recordedBySlot;
+
+			// Serially everything is recorded in order on slot 0
+			if (!parallel && (job.recordedBySlot != 0 || (j > 0 && started[j] < finished[j - 1])))
+				result.orderFailures++;
+		}
+
+		// Played back on the "immediate context" in job order
+		std::vector<int> executed;
+		graph.Submit([&](unsigned int jobIndex)
+		{
+			executed.insert(executed.end(), commandLists[jobIndex].begin(), commandLists[jobIndex].end());
+		});
+		if (executed.size() != jobCount * commandsPerJob)
+			result.submitFailures++;
+		for (unsigned int i = 0; i < executed.size(); i++)
+		{
+			if (executed[i] != (int)((i / commandsPerJob) * 100 + i % commandsPerJob))
+			{
+				result.submitFailures++;
+				break;
+			}
+		}
+		return result;
+	}
+
+	// Adding a job that waits on one not added yet should stop
+	// the program, so it is tried in a child
+	bool AbortsOnLaterDependency()
+	{
+		pid_t child = fork();
+		if (child == 0)
+		{
+			if (!freopen("/dev/null", "w", stderr))
+				_exit(2);
+			RenderJobGraph graph(0);
+			unsigned int later = 1;
+			graph.AddJob("Early", [](unsigned int) {}, Span<const unsigned int>(&later, 1));
+			_exit(0);
+		}
+
+		int status = 0;
+		waitpid(child, &status, 0);
+		return WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int rounds = 500;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+			rounds = (unsigned int)atoi(argv[++i]);
+		else
+		{
+			printf("Usage: %s [-r rounds]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	int failures = 0;
+	RenderJobGraph graph(3);
+	for (int parallel = 0; parallel < 2; parallel++)
+	{
+		Round total = {};
+		for (unsigned int r = 0; r < rounds; r++)
+		{
+			Round round = RunRound(graph, parallel != 0, r);
+			total.orderFailures += round.orderFailures;
+			total.overlaps += round.overlaps;
+			total.submitFailures += round.submitFailures;
+			total.slotsUsed |= round.slotsUsed;
+		}
+
+		unsigned int slots = 0;
+		for (unsigned int s = total.slotsUsed; s; s >>= 1)
+			slots += s & 1;
+		printf("%-8s %u rounds: %u out of order, %u contexts shared, %u played back wrong, %u slots used\n",
+			parallel ? "Parallel" : "Serial", rounds, total.orderFailures, total.overlaps, total.submitFailures, slots);
+		if (total.orderFailures > 0 || total.overlaps > 0 || total.submitFailures > 0)
+			failures++;
+	}
+
+	bool aborted = AbortsOnLaterDependency();
+	printf("Depending on a later job %s\n", aborted ? "aborts" : "DOESN'T abort");
+	if (!aborted)
+		failures++;
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,71 @@
+// Developer: Narai
+// Purpose: Headless check of the navigation mesh. Builds it
+//			over a level's .obj, reporting how long that takes
+//			and what came out, then has crowds of agents ask
+//			for paths across it, worked through on one thread
+//			and through the path queue's slices on a job graph.
+//
+// Build and run on Linux, from this folder:
+//
+//		g++ -O2 -std=c++14 -pthread -I../.. BenchNav.cpp ../../NavMesh.cpp ../../Collision.cpp ../../RenderJobGraph.cpp -o BenchNav
+//		./BenchNav ../../Assets/Models/SampleLevel.obj
+//
+// Options: -w <workers> for the job graph, 4 by default, and
+// -r <rounds> of paths each agent asks for, 8 by default.
+
+#include "Collision.h"
+#include "NavMesh.h"
+
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+	const char* path = nullptr;
+	unsigned int workers = 4;
+	unsigned int rounds = 8;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+			workers = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+			rounds = (unsigned int)atoi(argv[++i]);
+		else
+			path = argv[i];
+	}
+	if (!path)
+	{
+		printf("Usage: %s [-w workers] [-r rounds] level.obj\n", argv[0]);
+		return 1;
+	}
+
+	std::ifstream obj(path);
+	std::vector<float> soup;
+	if (!LoadCollisionOBJ(obj, soup))
+	{
+		printf("Couldn't read %s\n", path);
+		return 1;
+	}
+
+	NavMesh mesh;
+	mesh.Build(soup.data(), soup.size() / 9, DefaultNavBuildSettings());
+	printf("%zu triangles: %u spans, %u walkable cells, %u polygons, %u links, built in %.3f ms\n",
+		soup.size() / 9, mesh.GetSpanCount(), mesh.GetWalkableCellCount(),
+		mesh.GetPolyCount(), mesh.GetLinkCount(), mesh.GetBuildMS());
+	if (mesh.GetPolyCount() == 0)
+		return 1;
+
+	const unsigned int crowds[] = { 100, 400, 1600 };
+	for (unsigned int agents : crowds)
+	{
+		NavBenchmark b = BenchmarkNavigation(soup.data(), soup.size() / 9, agents, rounds, workers);
+		printf("%5u agents, %6u paths: %9.0f paths/s serial, %9.0f paths/s over %u workers in %u ticks\n",
+			b.agentCount, b.pathCount, b.serialPathsPerSecond, b.parallelPathsPerSecond, b.workerCount, b.parallelTicks);
+		printf("      %u corners and %u polygons visited a path, %u unreached\n",
+			b.averageCorners, b.averagePolysVisited, b.unreachedPaths);
+	}
+	return 0;
+}
@@ -0,0 +1,112 @@
+// Developer: Narai
+// Purpose: Headless player server. By default runs the server
+//			and a crowd of bots over loopback, reporting the
+//			bytes each client costs a tick, the server's time
+//			per player and whether every bot read the same
+//			players the server has. With -serve it is a real
+//			server instead, ticking over a level's .obj until
+//			stopped.
+//
+// Build and run on Linux, from this folder:
+//
+//		g++ -O2 -std=c++14 -I../.. BenchNet.cpp ../../NetPlayers.cpp ../../Network.cpp ../../PlayerMotion.cpp ../../Collision.cpp ../../EntityStore.cpp -o BenchNet
+//		./BenchNet
+//		./BenchNet -serve 27020 ../../Assets/Models/SampleLevel.obj
+//
+// Options: -t <ticks> to run each crowd for, 300 by default.
+
+#include "NetPlayers.h"
+
+#include <chrono>
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// Ticks forever at NET_TICK_RATE, with the level where the
+	// game puts it and players starting where it starts its own
+	int Serve(uint16_t port, const char* path)
+	{
+		std::ifstream obj(path);
+		std::vector<float> soup;
+		if (!LoadCollisionOBJ(obj, soup))
+		{
+			printf("Couldn't read %s\n", path);
+			return 1;
+		}
+
+		const float world[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0.0f, -1.02f, 14.0f, 1 } };
+		LevelCollision level;
+		level.AddTriangles(soup.data(), soup.size() / 9, world);
+		level.Build();
+
+		NetServerSettings settings = DefaultNetServerSettings();
+		settings.port = port;
+		settings.spawn[0] = 0.0f;
+		settings.spawn[1] = 0.0f;
+		settings.spawn[2] = -10.0f;
+
+		NetServer server;
+		if (!server.Start(settings, &level))
+		{
+			printf("Couldn't listen on port %u\n", port);
+			return 1;
+		}
+		printf("Serving %u triangles on port %u at %d ticks a second\n", level.GetTriangleCount(), server.GetPort(), NET_TICK_RATE);
+		fflush(stdout);
+
+		typedef std::chrono::steady_clock Clock;
+		const Clock::duration tickLength = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / NET_TICK_RATE));
+		Clock::time_point next = Clock::now();
+		uint64_t lastSent = 0;
+		while (true)
+		{
+			server.Tick();
+			if (server.GetTick() % (NET_TICK_RATE * 5) == 0)
+			{
+				uint64_t sent = server.GetBytesSent();
+				printf("Tick %u: %u clients, %.0f bytes a second out\n",
+					server.GetTick(), server.GetClientCount(), (sent - lastSent) / 5.0);
+				lastSent = sent;
+				fflush(stdout);
+			}
+
+			next += tickLength;
+			std::this_thread::sleep_until(next);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int ticks = 300;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			ticks = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-serve") == 0 && i + 2 < argc)
+			return Serve((uint16_t)atoi(argv[i + 1]), argv[i + 2]);
+		else
+		{
+			printf("Usage: %s [-t ticks] | -serve port level.obj\n", argv[0]);
+			return 1;
+		}
+	}
+
+	int failures = 0;
+	const unsigned int crowds[] = { 8, 24, 64, 128 };
+	for (unsigned int clients : crowds)
+	{
+		NetBenchmark b = BenchmarkNetServer(clients, ticks);
+		printf("%4u clients (%u connected): %6.1f bytes a client a tick (%6.1f whole), %5.1f input bytes, %7.3f ms a tick, %6.2f us a player, %u mismatched\n",
+			b.clientCount, b.connected, b.snapshotBytesPerClientTick, b.wholeSnapshotBytesPerClientTick,
+			b.inputBytesPerClientTick, b.serverTickMS, b.serverMicrosecondsPerPlayer, b.mismatches);
+		if (b.connected < clients || b.mismatches > 0)
+			failures++;
+	}
+	return failures == 0 ? 0 : 1;
+}
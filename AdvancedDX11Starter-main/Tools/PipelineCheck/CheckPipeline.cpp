@@ -0,0 +1,251 @@
+// Developer: Narai
+// Purpose: Headless check of the snapshot ring between the
+//			update and render threads. First steps one ring by
+//			hand to check that a full ring overwrites its
+//			oldest ready snapshot, and only that one, when
+//			stale snapshots may be dropped, and refuses to
+//			when they may not. Then runs a writer thread
+//			against a reader thread with every slot count and
+//			policy, checking no snapshot is read torn or twice,
+//			or out of order.
+//
+// Build and run on Linux, from this folder:
+//
+//		g++ -O2 -std=c++14 -pthread -I../.. CheckPipeline.cpp -o CheckPipeline
+//		./CheckPipeline
+//
+// Options: -f <frames> the writer publishes a run, 50000 by
+// default.
+
+#include "FramePipeline.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+namespace
+{
+	// Big enough that writing or reading one takes a while, so
+	// a slot shared by both would show up as a mix of frames
+	struct Snapshot
+	{
+		uint64_t frame;
+		uint64_t words[256];
+	};
+
+	void Fill(Snapshot* snapshot, uint64_t frame)
+	{
+		snapshot->frame = frame;
+		for (uint64_t& w : snapshot->words)
+			w = frame;
+	}
+
+	bool Torn(const Snapshot* snapshot)
+	{
+		for (uint64_t w : snapshot->words)
+		{
+			if (w != snapshot->frame)
+				return true;
+		}
+		return false;
+	}
+
+	// Busy for a while that changes frame to frame, so which
+	// side is ahead keeps changing too
+	void Work(uint64_t frame, unsigned int salt)
+	{
+		volatile unsigned int sink = 0;
+		unsigned int spins = (unsigned int)((frame * 2654435761u + salt) % 4000);
+		for (unsigned int i = 0; i < spins; i++)
+			sink += i;
+	}
+
+	int failures = 0;
+
+	void Expect(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			printf("  FAILED: %s\n", what);
+			failures++;
+		}
+	}
+
+	// Publishes the next frame, whose number is also the
+	// sequence the ring should give it
+	bool Publish(SnapshotRing<Snapshot>& ring, uint64_t* frame, uint64_t* overwritten = nullptr)
+	{
+		Snapshot* s = ring.BeginWrite();
+		if (!s)
+			return false;
+		if (overwritten)
+			*overwritten = s->frame;
+		Fill(s, ++*frame);
+		return ring.EndWrite(s) == *frame;
+	}
+
+	void CheckByHand()
+	{
+		printf("By hand:\n");
+		static SnapshotRing<Snapshot> ring;
+		uint64_t frame = 0;
+		uint64_t overwritten = 0;
+		unsigned long long sequence = 0;
+
+		// Keeping every snapshot, a full ring turns the writer away
+		// and hands them out oldest first
+		ring.Configure(3, false);
+		Expect(Publish(ring, &frame) && Publish(ring, &frame) && Publish(ring, &frame), "three fit in three slots");
+		Expect(ring.BeginWrite() == nullptr, "a fourth is refused while keeping every snapshot");
+		Snapshot* read = ring.BeginRead(&sequence);
+		Expect(read && read->frame == 1 && sequence == 1, "the oldest is read first");
+		Expect(ring.BeginWrite() == nullptr, "the slot being read isn't written");
+		ring.EndRead(read);
+		Expect(Publish(ring, &frame), "a read slot is written again");
+
+		// Dropping stale snapshots, a full ring overwrites its
+		// oldest ready one
+		ring.Configure(3, true);
+		frame = ring.GetPublishedCount();
+		Expect(Publish(ring, &frame) && Publish(ring, &frame) && Publish(ring, &frame), "three fit in three slots");
+		uint64_t oldest = frame - 2;
+		Expect(Publish(ring, &frame, &overwritten) && overwritten == oldest, "a full ring overwrites its oldest ready snapshot");
+		Expect(ring.GetDroppedCount() == 1, "that counts as one dropped");
+
+		// The newest is read and the rest are thrown away, then
+		// with one slot being read only the oldest of the others
+		// is overwritten
+		read = ring.BeginRead(&sequence);
+		Expect(read && read->frame == frame && sequence == frame, "the newest is read");
+		Expect(ring.GetDroppedCount() == 3, "everything older is dropped");
+		Expect(Publish(ring, &frame) && Publish(ring, &frame), "two fit beside the one being read");
+		oldest = frame - 1;
+		Expect(Publish(ring, &frame, &overwritten) && overwritten == oldest, "the oldest ready is overwritten, not the one being read");
+		Expect(!Torn(read) && read->frame == sequence, "the one being read is untouched");
+		ring.EndRead(read);
+
+		// Two slots: with one being read the other is always the
+		// one overwritten
+		ring.Configure(2, true);
+		frame = ring.GetPublishedCount();
+		Expect(Publish(ring, &frame), "one published");
+		read = ring.BeginRead(&sequence);
+		for (int i = 0; i < 3; i++)
+			Expect(Publish(ring, &frame), "the other slot keeps being overwritten");
+		Expect(!Torn(read) && read->frame == sequence, "the one being read is untouched");
+		ring.EndRead(read);
+		read = ring.BeginRead(&sequence);
+		Expect(read && read->frame == frame, "the last published is read next");
+		ring.EndRead(read);
+	}
+
+	void CheckThreads(int slotCount, bool dropStale, uint64_t frames)
+	{
+		static SnapshotRing<Snapshot> ring;
+		ring.Configure(slotCount, dropStale);
+		uint64_t first = ring.GetPublishedCount() + 1;
+		uint64_t last = first + frames - 1;
+
+		unsigned long long droppedBefore = ring.GetDroppedCount();
+		unsigned long long refused = 0;
+		std::atomic<bool> go(false);
+		std::thread writer([&]()
+		{
+			while (!go)
+				std::this_thread::yield();
+
+			uint64_t frame = first - 1;
+			while (frame < last)
+			{
+				Work(frame, 1);
+				if (!Publish(ring, &frame))
+				{
+					refused++;
+					std::this_thread::yield();
+				}
+
+				// Gives way now and then the way a frame boundary
+				// would, so the two interleave even on one core
+				else if (frame % 8 == 0)
+					std::this_thread::yield();
+			}
+		});
+		go = true;
+
+		// Reads until the last frame comes through, checking each
+		// against the one before
+		uint64_t reads = 0;
+		uint64_t torn = 0;
+		uint64_t wrongSequence = 0;
+		uint64_t backwards = 0;
+		uint64_t skipped = 0;
+		unsigned long long previous = first - 1;
+		while (previous < last)
+		{
+			unsigned long long sequence = 0;
+			Snapshot* s = ring.BeginRead(&sequence);
+			if (!s)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			reads++;
+			if (Torn(s))
+				torn++;
+			if (s->frame != sequence)
+				wrongSequence++;
+			if (sequence <= previous)
+				backwards++;
+			else if (sequence != previous + 1)
+				skipped += sequence - previous - 1;
+			previous = sequence;
+			Work(sequence, 2);
+			ring.EndRead(s);
+		}
+		writer.join();
+
+		printf("%d slots, %s: %llu read of %llu, %llu torn, %llu wrong, %llu repeated or backwards, %llu skipped, %llu dropped, %llu refused\n",
+			slotCount, dropStale ? "dropping stale" : "keeping every", (unsigned long long)reads, (unsigned long long)frames,
+			(unsigned long long)torn, (unsigned long long)wrongSequence, (unsigned long long)backwards,
+			(unsigned long long)skipped, ring.GetDroppedCount() - droppedBefore, refused);
+
+		Expect(torn == 0 && wrongSequence == 0, "every snapshot is read whole and matches its sequence");
+		Expect(backwards == 0, "sequences only go up");
+		if (!dropStale)
+			Expect(skipped == 0 && refused > 0, "keeping every snapshot skips none, the writer waiting instead");
+		else
+		{
+			Expect(refused == 0, "dropping stale snapshots never makes the writer wait");
+			Expect(reads + ring.GetDroppedCount() - droppedBefore == frames, "every snapshot is either read or dropped");
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t frames = 50000;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+			frames = (uint64_t)atoll(argv[++i]);
+		else
+		{
+			printf("Usage: %s [-f frames]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	CheckByHand();
+	for (int slots = 2; slots <= FRAME_PIPELINE_MAX_SNAPSHOTS; slots++)
+	{
+		CheckThreads(slots, false, frames);
+		CheckThreads(slots, true, frames);
+	}
+
+	printf("%s\n", failures == 0 ? "All passed" : "Failures above");
+	return failures == 0 ? 0 : 1;
+}
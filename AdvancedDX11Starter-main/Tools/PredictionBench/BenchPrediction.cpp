@@ -0,0 +1,71 @@
+// Developer: Narai
+// Purpose: Headless check of client prediction. Runs a server
+//			and one predicting bot through a simulated link on
+//			loopback, from a clean one to a bad one, and reports
+//			how often and how far the server corrected the bot
+//			and how far the smoothing moved it in one frame.
+//
+// Build and run on Linux, from this folder:
+//
+//		g++ -O2 -std=c++14 -I../.. BenchPrediction.cpp ../../NetPrediction.cpp ../../NetPlayers.cpp ../../Network.cpp ../../PlayerMotion.cpp ../../Collision.cpp ../../EntityStore.cpp -o BenchPrediction
+//		./BenchPrediction
+//
+// Options: -t <ticks> to run each link for, 900 by default,
+// or -l <latency ms> -j <jitter ms> -p <loss %> to run only
+// that link.
+
+#include "NetPrediction.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+	unsigned int ticks = 900;
+	NetLinkSettings custom = {};
+	bool useCustom = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			ticks = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+			custom.latency = (float)atof(argv[++i]) / 1000.0f, useCustom = true;
+		else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+			custom.jitter = (float)atof(argv[++i]) / 1000.0f, useCustom = true;
+		else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+			custom.loss = (float)atof(argv[++i]) / 100.0f, useCustom = true;
+		else
+		{
+			printf("Usage: %s [-t ticks] [-l latency ms] [-j jitter ms] [-p loss %%]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	// Latency, jitter and loss, each way
+	std::vector<NetLinkSettings> links;
+	if (useCustom)
+		links.push_back(custom);
+	else
+	{
+		links.push_back({ 0.005f, 0.0f, 0.0f, 1 });
+		links.push_back({ 0.05f, 0.01f, 0.01f, 2 });
+		links.push_back({ 0.1f, 0.03f, 0.05f, 3 });
+		links.push_back({ 0.2f, 0.06f, 0.2f, 4 });
+	}
+
+	int failures = 0;
+	for (const NetLinkSettings& link : links)
+	{
+		NetPredictionBenchmark b = BenchmarkPrediction(link, ticks);
+		const NetCorrectionStats& c = b.corrections;
+		printf("%3.0f ms +-%2.0f ms, %4.1f%% lost: %4u snapshots, %4.1f inputs ahead, %3u corrections (%u shoves, %u snaps), %.3f m average, %.3f m largest, %.3f m largest frame step\n",
+			link.latency * 1000.0f, link.jitter * 1000.0f, link.loss * 100.0f,
+			c.checks, b.averageReplaySteps, c.corrections, b.pushes, c.snaps,
+			c.corrections > 0 ? c.total / c.corrections : 0.0f, c.largest, b.largestDisplayStep);
+		if (!b.connected)
+			failures++;
+	}
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,412 @@
+// Developer: Narai
+// Purpose: Offline sky bake. Bakes every sky under
+//			Assets/Skies into the same cache the engine reads,
+//			Assets/Cooked/Skies/<sky>/, and checks the bake
+//			against brute force integration so the numbers
+//			can be trusted without running the game.
+//
+// Build and run on Linux, from this folder:
+//
+//		g++ -O2 -std=c++14 -pthread -I../.. -I../TextureCooker BakeSky.cpp ../TextureCooker/PngDecoder.cpp ../../SkyBake.cpp ../../TextureCooker.cpp -o BakeSky
+//		./BakeSky ../../Assets
+//
+// Options: -j <threads>, and -f to bake skies that are
+// already up to date.
+
+#include "PngDecoder.h"
+#include "SkyBake.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// Same order as the cube's faces
+static const char* FaceNames[6] = { "right", "left", "up", "down", "front", "back" };
+
+static bool ReadFile(const std::string& path, std::vector<unsigned char>& data)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+		return false;
+
+	data.resize((size_t)file.tellg());
+	file.seekg(0);
+	return (bool)file.read((char*)data.data(), data.size());
+}
+
+static bool WriteFile(const std::string& path, const void* data, size_t size)
+{
+	for (size_t slash = path.find('/'); slash != std::string::npos; slash = path.find('/', slash + 1))
+		mkdir(path.substr(0, slash).c_str(), 0755);
+
+	std::ofstream file(path, std::ios::binary);
+	return file.is_open() && (bool)file.write((const char*)data, size);
+}
+
+static long long ModifiedTime(const std::string& path)
+{
+	struct stat info;
+	return stat(path.c_str(), &info) == 0 ? (long long)info.st_mtime : -1;
+}
+
+// Evenly spread directions for the checks
+static void FibonacciDirection(unsigned int i, unsigned int count, float dir[3])
+{
+	float y = 1.0f - 2.0f * (i + 0.5f) / count;
+	float radius = sqrtf(1.0f - y * y);
+	float phi = i * 2.39996323f;
+	dir[0] = cosf(phi) * radius;
+	dir[1] = y;
+	dir[2] = sinf(phi) * radius;
+}
+
+static float Luminance(const float color[3])
+{
+	return 0.2126f * color[0] + 0.7152f * color[1] + 0.0722f * color[2];
+}
+
+// --------------------------------------------------------
+// Brute force references
+// --------------------------------------------------------
+
+/// <summary>
+/// Diffuse light from every texel, cosine weighted and
+/// divided by pi, which the harmonics approximate
+/// </summary>
+static void BruteIrradiance(const SkyCube& cube, const float normal[3], float out[3])
+{
+	double sum[3] = {};
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		for (unsigned int y = 0; y < cube.size; y++)
+		{
+			for (unsigned int x = 0; x < cube.size; x++)
+			{
+				float dir[3];
+				SkyCubeDirection(face, (x + 0.5f) * 2.0f / cube.size - 1.0f, (y + 0.5f) * 2.0f / cube.size - 1.0f, dir);
+				float cosine = normal[0] * dir[0] + normal[1] * dir[1] + normal[2] * dir[2];
+				if (cosine <= 0.0f)
+					continue;
+
+				float weight = cosine * SkyTexelSolidAngle(cube.size, x, y);
+				const float* texel = cube.Texel(face, x, y);
+				for (int c = 0; c < 3; c++)
+					sum[c] += texel[c] * weight;
+			}
+		}
+	}
+
+	for (int c = 0; c < 3; c++)
+		out[c] = (float)(sum[c] / 3.14159265);
+}
+
+/// <summary>
+/// The integral the prefilter estimates: every texel weighted
+/// by D(h) and N dot L, with the view along the normal
+/// </summary>
+static void BrutePrefilter(const SkyCube& cube, const float normal[3], float roughness, float out[3])
+{
+	float alpha2 = roughness * roughness * roughness * roughness;
+
+	double sum[3] = {};
+	double weight = 0.0;
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		for (unsigned int y = 0; y < cube.size; y++)
+		{
+			for (unsigned int x = 0; x < cube.size; x++)
+			{
+				float dir[3];
+				SkyCubeDirection(face, (x + 0.5f) * 2.0f / cube.size - 1.0f, (y + 0.5f) * 2.0f / cube.size - 1.0f, dir);
+				float nDotL = normal[0] * dir[0] + normal[1] * dir[1] + normal[2] * dir[2];
+				if (nDotL <= 0.0f)
+					continue;
+
+				float half[3] = { normal[0] + dir[0], normal[1] + dir[1], normal[2] + dir[2] };
+				float length = sqrtf(half[0] * half[0] + half[1] * half[1] + half[2] * half[2]);
+				float nDotH = (normal[0] * half[0] + normal[1] * half[1] + normal[2] * half[2]) / length;
+				float denominator = nDotH * nDotH * (alpha2 - 1.0f) + 1.0f;
+				double w = alpha2 / (denominator * denominator) * nDotL * SkyTexelSolidAngle(cube.size, x, y);
+
+				const float* texel = cube.Texel(face, x, y);
+				for (int c = 0; c < 3; c++)
+					sum[c] += texel[c] * w;
+				weight += w;
+			}
+		}
+	}
+
+	for (int c = 0; c < 3; c++)
+		out[c] = (float)(sum[c] / weight);
+}
+
+// Solid angle weighted mean luminance of a cube
+static float MeanLuminance(const SkyCube& cube)
+{
+	double sum = 0.0;
+	for (unsigned int face = 0; face < 6; face++)
+		for (unsigned int y = 0; y < cube.size; y++)
+			for (unsigned int x = 0; x < cube.size; x++)
+				sum += Luminance(cube.Texel(face, x, y)) * SkyTexelSolidAngle(cube.size, x, y);
+	return (float)(sum / (4.0 * 3.14159265));
+}
+
+// --------------------------------------------------------
+// Checks
+// --------------------------------------------------------
+
+/// <summary>
+/// A sky of one color has to come out as that color from
+/// every part of the bake
+/// </summary>
+static bool CheckUniformSky(unsigned int threadCount)
+{
+	const unsigned int size = 32;
+	std::vector<unsigned char> face((size_t)size * size * 4, 200);
+	const unsigned char* faces[6] = { face.data(), face.data(), face.data(), face.data(), face.data(), face.data() };
+
+	SkyCube cube;
+	SkyCubeFromFaces(faces, size, size, &cube);
+	float expected = cube.texels[0];
+
+	SkyBakeResult bake;
+	BakeSkyLighting(cube, threadCount, &bake);
+
+	float shError = 0.0f;
+	float specularError = 0.0f;
+	for (unsigned int i = 0; i < 256; i++)
+	{
+		float dir[3], color[3];
+		FibonacciDirection(i, 256, dir);
+		EvaluateIrradianceSH9(bake.irradiance, dir, color);
+		shError = std::max(shError, fabsf(color[0] - expected) / expected);
+
+		for (auto& mip : bake.specular)
+		{
+			SampleSkyCube(mip, dir, color);
+			specularError = std::max(specularError, fabsf(color[0] - expected) / expected);
+		}
+	}
+
+	bool passed = shError < 1e-3f && specularError < 1e-3f;
+	printf("  Uniform sky: SH max error %.5f%%, specular max error %.5f%%  %s\n",
+		shError * 100.0f, specularError * 100.0f, passed ? "ok" : "FAILED");
+	return passed;
+}
+
+/// <summary>
+/// Compares a real bake against brute force integration
+/// </summary>
+static bool CheckAgainstBruteForce(const SkyCube& source, const SkyBakeResult& bake)
+{
+	bool passed = true;
+
+	// Same cube the harmonics were projected from
+	SkyCube small = source;
+	while (small.size > SKY_BAKE_SH_SIZE)
+	{
+		SkyCube next;
+		DownsampleSkyCube(small, &next);
+		small = next;
+	}
+
+	const unsigned int directionCount = 64;
+	float shSum = 0.0f;
+	float shMax = 0.0f;
+	for (unsigned int i = 0; i < directionCount; i++)
+	{
+		float dir[3], fromSH[3], reference[3];
+		FibonacciDirection(i, directionCount, dir);
+		EvaluateIrradianceSH9(bake.irradiance, dir, fromSH);
+		BruteIrradiance(small, dir, reference);
+
+		float error = fabsf(Luminance(fromSH) - Luminance(reference)) / Luminance(reference);
+		shSum += error;
+		shMax = std::max(shMax, error);
+	}
+
+	// Three bands cannot hold everything, a few percent is
+	// what they are expected to miss on a real sky
+	bool shPassed = shSum / directionCount < 0.05f;
+	passed &= shPassed;
+	printf("  SH9 irradiance vs brute force: mean error %.2f%%, max %.2f%%  %s\n",
+		shSum / directionCount * 100.0f, shMax * 100.0f, shPassed ? "ok" : "FAILED");
+
+	// The prefilter is checked on a smaller cube so the
+	// reference stays quick, against a bake of that cube
+	SkyCube reference = source;
+	while (reference.size > 64)
+	{
+		SkyCube next;
+		DownsampleSkyCube(reference, &next);
+		reference = next;
+	}
+	std::vector<SkyCube> levels(1, reference);
+	while (levels.back().size > 1)
+	{
+		SkyCube next;
+		DownsampleSkyCube(levels.back(), &next);
+		levels.push_back(next);
+	}
+
+	const unsigned int prefilterDirections = 24;
+	for (unsigned int m = 1; m < SKY_BAKE_SPECULAR_MIPS; m++)
+	{
+		float roughness = SkySpecularRoughness(m);
+		float sum = 0.0f;
+		float worst = 0.0f;
+		for (unsigned int i = 0; i < prefilterDirections; i++)
+		{
+			float dir[3], baked[3], brute[3];
+			FibonacciDirection(i, prefilterDirections, dir);
+			PrefilterSkyDirection(levels, dir, roughness, SKY_BAKE_SAMPLES, baked);
+			BrutePrefilter(reference, dir, roughness, brute);
+
+			float error = fabsf(Luminance(baked) - Luminance(brute)) / Luminance(brute);
+			sum += error;
+			worst = std::max(worst, error);
+		}
+
+		bool mipPassed = sum / prefilterDirections < 0.03f;
+		passed &= mipPassed;
+		printf("  Specular mip %u (roughness %.1f) vs brute force: mean error %.2f%%, max %.2f%%  %s\n",
+			m, roughness, sum / prefilterDirections * 100.0f, worst * 100.0f, mipPassed ? "ok" : "FAILED");
+	}
+
+	// Filtering spreads light around but should not add or
+	// lose any of it
+	float sourceMean = MeanLuminance(source);
+	float worstEnergy = 0.0f;
+	for (auto& mip : bake.specular)
+		worstEnergy = std::max(worstEnergy, fabsf(MeanLuminance(mip) - sourceMean) / sourceMean);
+
+	bool energyPassed = worstEnergy < 0.02f;
+	passed &= energyPassed;
+	printf("  Specular mean brightness vs sky: max difference %.2f%%  %s\n",
+		worstEnergy * 100.0f, energyPassed ? "ok" : "FAILED");
+
+	return passed;
+}
+
+// --------------------------------------------------------
+
+static bool BakeSky(const std::string& assets, const std::string& name, unsigned int threadCount, bool force)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	std::string folder = assets + "/Skies/" + name + "/";
+	std::string cache = assets + "/Cooked/Skies/" + name + "/";
+	printf("%s\n", name.c_str());
+
+	long long newestFace = -1;
+	std::vector<unsigned char> faces[6];
+	unsigned int faceSize = 0;
+	for (int f = 0; f < 6; f++)
+	{
+		std::string path = folder + FaceNames[f] + ".png";
+		std::vector<unsigned char> file;
+		std::string error;
+		unsigned int width, height;
+		if (!ReadFile(path, file) || !DecodePng(file.data(), file.size(), faces[f], &width, &height, &error))
+		{
+			printf("  FAILED: could not read %s %s\n", path.c_str(), error.c_str());
+			return false;
+		}
+
+		if (width != height || (f > 0 && width != faceSize))
+		{
+			printf("  FAILED: faces have to be square and the same size\n");
+			return false;
+		}
+		faceSize = width;
+		newestFace = std::max(newestFace, ModifiedTime(path));
+	}
+
+	SkyCube source;
+	const unsigned char* facePointers[6] = { faces[0].data(), faces[1].data(), faces[2].data(), faces[3].data(), faces[4].data(), faces[5].data() };
+	SkyCubeFromFaces(facePointers, faceSize, SKY_BAKE_SOURCE_SIZE, &source);
+
+	auto start = Clock::now();
+	SkyBakeResult bake;
+	BakeSkyLighting(source, threadCount, &bake);
+	float bakeMS = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+	printf("  %u faces of %u, baked from %u on %u thread(s) in %.0f ms\n",
+		6, faceSize, source.size, threadCount, bakeMS);
+
+	bool upToDate =
+		ModifiedTime(cache + "specular.dds") >= newestFace &&
+		ModifiedTime(cache + "irradiance.txt") >= newestFace;
+	if (force || !upToDate)
+	{
+		std::vector<unsigned char> specular;
+		WriteSkySpecular(bake, specular);
+		std::string irradiance = WriteSkyIrradiance(bake);
+		if (!WriteFile(cache + "specular.dds", specular.data(), specular.size()) ||
+			!WriteFile(cache + "irradiance.txt", irradiance.data(), irradiance.size()))
+		{
+			printf("  FAILED: could not write to %s\n", cache.c_str());
+			return false;
+		}
+		printf("  Wrote %s (%.1f KB)\n", cache.c_str(), (specular.size() + irradiance.size()) / 1024.0f);
+	}
+	else
+	{
+		printf("  Cache is up to date\n");
+	}
+
+	return CheckAgainstBruteForce(source, bake);
+}
+
+int main(int argc, char** argv)
+{
+	std::string assets;
+	unsigned int threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	bool force = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-f") == 0)
+			force = true;
+		else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+			threadCount = std::max(atoi(argv[++i]), 1);
+		else
+			assets = argv[i];
+	}
+
+	if (assets.empty())
+	{
+		printf("Usage: BakeSky <Assets folder> [-j threads] [-f]\n");
+		return 1;
+	}
+
+	bool passed = CheckUniformSky(threadCount);
+
+	std::vector<std::string> skies;
+	if (DIR* dir = opendir((assets + "/Skies").c_str()))
+	{
+		while (dirent* entry = readdir(dir))
+		{
+			std::string name = entry->d_name;
+			struct stat info;
+			if (name != "." && name != ".." &&
+				stat((assets + "/Skies/" + name).c_str(), &info) == 0 && S_ISDIR(info.st_mode))
+				skies.push_back(name);
+		}
+		closedir(dir);
+	}
+	std::sort(skies.begin(), skies.end());
+
+	for (auto& sky : skies)
+		passed &= BakeSky(assets, sky, threadCount, force);
+
+	printf("\n%s\n", passed ? "All checks passed" : "Some checks FAILED");
+	return passed ? 0 : 1;
+}
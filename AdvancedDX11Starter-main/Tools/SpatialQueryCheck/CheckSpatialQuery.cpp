@@ -0,0 +1,496 @@
+// Developer: Narai
+// Purpose: Headless check of the spatial index's SIMD queries
+//			against a plain scalar reference. By hand: tangent
+//			rays and sweeps, hits at exactly the max distance,
+//			layers, the ignored entity and leaves that aren't
+//			full. Then random scenes of clustered spheres in
+//			random layers, asked random rays, sweeps and cones,
+//			where every query has to come back with the nearest
+//			hits the reference finds testing every sphere one
+//			by one, and the same again across the job graph.
+//
+// Build and run on Linux, from this folder:
+//
+//		g++ -O2 -std=c++14 -pthread -I../.. CheckSpatialQuery.cpp ../../SpatialQuery.cpp ../../EntityStore.cpp ../../Collision.cpp ../../RenderJobGraph.cpp -o CheckSpatialQuery
+//		./CheckSpatialQuery
+//
+// Options: -r <rounds> of random scenes, 200 by default.
+
+#include "SpatialQuery.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	int failures = 0;
+
+	void Expect(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			printf("  FAILED: %s\n", what);
+			failures++;
+		}
+	}
+
+	// One entity's bounds as the reference sees them
+	struct Sphere
+	{
+		EntityId id;
+		float center[3];
+		float radius;
+		unsigned int layers;
+	};
+
+	struct Scene
+	{
+		EntityStore store;
+		std::vector<Sphere> spheres;
+		SpatialIndex index;
+
+		void Add(float x, float y, float z, float radius, unsigned int layers)
+		{
+			EntityDesc desc = {};
+			desc.mask = COMPONENT_BIT(BoundsComponent);
+			desc.bounds.center[0] = x;
+			desc.bounds.center[1] = y;
+			desc.bounds.center[2] = z;
+			desc.bounds.radius = radius;
+			desc.bounds.queryLayers = layers;
+
+			Sphere sphere = { store.Create(desc), { x, y, z }, radius, layers };
+			spheres.push_back(sphere);
+		}
+
+		void Build()
+		{
+			store.ApplyChanges();
+			index.Rebuild(&store);
+		}
+	};
+
+	SpatialQuery MakeQuery(QueryShape shape, float ox, float oy, float oz, float dx, float dy, float dz, float maxDistance)
+	{
+		SpatialQuery query = {};
+		query.shape = shape;
+		query.origin[0] = ox;
+		query.origin[1] = oy;
+		query.origin[2] = oz;
+		query.direction[0] = dx;
+		query.direction[1] = dy;
+		query.direction[2] = dz;
+		query.maxDistance = maxDistance;
+		query.flags = QUERY_ENTITIES;
+		query.layers = ENTITY_LAYER_DEFAULT;
+		query.maxHits = QUERY_MAX_HITS;
+		return query;
+	}
+
+	// The tree's answer to a single query
+	std::vector<QueryHit> Ask(const Scene& scene, const SpatialQuery& query)
+	{
+		QueryBatch batch;
+		batch.Add(query);
+		scene.index.Run(&batch);
+		Span<const QueryHit> hits = batch.GetHits(0);
+		return std::vector<QueryHit>(hits.begin(), hits.end());
+	}
+
+	/// <summary>
+	/// Whether a query touches a sphere, and how far away, one
+	/// sphere at a time. Written out from what the header says
+	/// a query is, in the same order of operations as the SIMD
+	/// lanes so the two agree to the bit on x86
+	/// </summary>
+	bool Touches(const SpatialQuery& query, const Sphere& sphere, float* distance)
+	{
+		const float* o = query.origin;
+		const float* d = query.direction;
+		const float* center = sphere.center;
+		float radius = sphere.radius;
+
+		if (query.shape == QueryShape::Cone)
+		{
+			float sinAngle = sqrtf(1.0f - query.coneCosine * query.coneCosine);
+			float vx = center[0] - o[0];
+			float vy = center[1] - o[1];
+			float vz = center[2] - o[2];
+			float along = vx * d[0] + vy * d[1] + vz * d[2];
+			float lengthSq = vx * vx + vy * vy + vz * vz;
+			float perp = sqrtf((std::max)(lengthSq - along * along, 0.0f));
+			if (along < -radius || perp * query.coneCosine - along * sinAngle > radius)
+				return false;
+
+			*distance = (std::max)(sqrtf(lengthSq) - radius, 0.0f);
+			return *distance <= query.maxDistance;
+		}
+
+		float grown = radius + (query.shape == QueryShape::SphereSweep ? query.radius : 0.0f);
+		float mx = o[0] - center[0];
+		float my = o[1] - center[1];
+		float mz = o[2] - center[2];
+		float b = mx * d[0] + my * d[1] + mz * d[2];
+		float c = mx * mx + my * my + mz * mz - grown * grown;
+		float discriminant = b * b - c;
+		if ((c > 0.0f && b > 0.0f) || discriminant < 0.0f)
+			return false;
+
+		*distance = (std::max)(-b - sqrtf((std::max)(discriminant, 0.0f)), 0.0f);
+		return *distance <= query.maxDistance;
+	}
+
+	struct Touch
+	{
+		float distance;
+		const Sphere* sphere;
+	};
+
+	// Every sphere the query should see, nearest first
+	std::vector<Touch> Reference(const std::vector<Sphere>& spheres, const SpatialQuery& query)
+	{
+		std::vector<Touch> touches;
+		if (!(query.flags & QUERY_ENTITIES) || query.maxHits == 0)
+			return touches;
+
+		for (const Sphere& sphere : spheres)
+		{
+			Touch touch = { 0.0f, &sphere };
+			if ((sphere.layers & query.layers) && sphere.id != query.ignore && Touches(query, sphere, &touch.distance))
+				touches.push_back(touch);
+		}
+		std::stable_sort(touches.begin(), touches.end(), [](const Touch& a, const Touch& b) { return a.distance < b.distance; });
+		return touches;
+	}
+
+	bool Near(float a, float b)
+	{
+		return fabsf(a - b) <= 1e-4f * (std::max)(1.0f, fabsf(b));
+	}
+
+	// Where on the sphere the hit should say it was
+	bool SameSurface(const SpatialQuery& query, const Sphere& sphere, const QueryHit& hit)
+	{
+		float n[3];
+		for (int c = 0; c < 3; c++)
+		{
+			n[c] = query.origin[c] - sphere.center[c];
+			if (query.shape != QueryShape::Cone)
+				n[c] += query.direction[c] * hit.distance;
+		}
+		float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		for (int c = 0; c < 3; c++)
+		{
+			float normal = length > 1e-6f ? n[c] / length : -query.direction[c];
+			if (!Near(hit.normal[c], normal) || !Near(hit.point[c], sphere.center[c] + normal * sphere.radius))
+				return false;
+		}
+		return true;
+	}
+
+	// What went wrong across every query compared
+	struct Differences
+	{
+		unsigned int queries;
+		unsigned int hits;
+		unsigned int miscounted;	// More or fewer hits than the reference
+		unsigned int misplaced;		// Not the reference's distances, or out of order
+		unsigned int wrong;			// An entity the query shouldn't have seen, or seen twice
+		unsigned int surface;		// Point or normal off the sphere
+	};
+
+	/// <summary>
+	/// Compares one answer with the reference. Spheres the same
+	/// distance away may come back in either order, and either
+	/// may be the one dropped when there are too many, so the
+	/// distances are compared in order and each entity only has
+	/// to be one the reference touches at its distance
+	/// </summary>
+	void Compare(const Scene& scene, const SpatialQuery& query, Span<const QueryHit> hits, Differences* differences)
+	{
+		std::vector<Touch> touches = Reference(scene.spheres, query);
+		size_t expected = (std::min)(touches.size(), (size_t)(std::min)(query.maxHits, (unsigned int)QUERY_MAX_HITS));
+
+		differences->queries++;
+		differences->hits += (unsigned int)hits.size();
+		if (hits.size() != expected)
+		{
+			differences->miscounted++;
+			return;
+		}
+
+		bool placed = true;
+		bool right = true;
+		bool surface = true;
+		for (size_t h = 0; h < hits.size(); h++)
+		{
+			const QueryHit& hit = hits[h];
+			placed = placed && Near(hit.distance, touches[h].distance) && (h == 0 || hits[h - 1].distance <= hit.distance);
+
+			const Touch* touch = nullptr;
+			for (const Touch& t : touches)
+			{
+				if (t.sphere->id == hit.entity)
+					touch = &t;
+			}
+			for (size_t other = 0; other < h; other++)
+				right = right && hits[other].entity != hit.entity;
+			right = right && touch && !hit.level && Near(hit.distance, touch->distance);
+			surface = surface && touch && SameSurface(query, *touch->sphere, hit);
+		}
+		differences->misplaced += !placed;
+		differences->wrong += !right;
+		differences->surface += !surface;
+	}
+
+	void CheckByHand()
+	{
+		printf("By hand:\n");
+
+		// Spheres along the z axis, five so the last leaf isn't
+		// full, one further on grazing it and one just clear
+		Scene scene;
+		for (int i = 1; i <= 5; i++)
+			scene.Add(0.0f, 0.0f, 4.0f * i, 1.0f, ENTITY_LAYER_DEFAULT);
+		scene.Add(1.0f, 0.0f, 30.0f, 1.0f, ENTITY_LAYER_DEFAULT);
+		scene.Add(-1.125f, 0.0f, 40.0f, 1.0f, ENTITY_LAYER_DEFAULT);
+		scene.Add(0.0f, 0.0f, -8.0f, 1.0f, ENTITY_LAYER_PROJECTILE);
+		scene.Add(0.0f, 50.0f, 0.0f, 1.0f, 0);
+		scene.Build();
+		Expect(scene.index.GetEntityCount() == 8, "entities in no layer are left out of the tree");
+
+		SpatialQuery ray = MakeQuery(QueryShape::Ray, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 100.0f);
+		std::vector<QueryHit> hits = Ask(scene, ray);
+		bool inOrder = hits.size() == 6 && hits[5].entity == scene.spheres[5].id;
+		for (size_t h = 0; inOrder && h < 5; h++)
+			inOrder = hits[h].entity == scene.spheres[h].id && hits[h].distance == 4.0f * (h + 1) - 1.0f;
+		Expect(inOrder, "a ray down a row of spheres hits each, nearest first");
+
+		ray.maxHits = 3;
+		hits = Ask(scene, ray);
+		Expect(hits.size() == 3 && hits[2].entity == scene.spheres[2].id, "and keeps only the nearest when asked for fewer");
+
+		// Down the axis a ray grazes the side of the sphere at
+		// x = 1, and misses the one an eighth further out
+		SpatialQuery graze = MakeQuery(QueryShape::Ray, 0.0f, 0.0f, 25.0f, 0.0f, 0.0f, 1.0f, 100.0f);
+		hits = Ask(scene, graze);
+		Expect(hits.size() == 1 && hits[0].entity == scene.spheres[5].id && hits[0].distance == 5.0f, "a ray tangent to a sphere touches it");
+
+		SpatialQuery sweep = graze;
+		sweep.shape = QueryShape::SphereSweep;
+		sweep.radius = 0.125f;
+		hits = Ask(scene, sweep);
+		Expect(hits.size() == 2 && hits[1].entity == scene.spheres[6].id && hits[1].distance == 15.0f,
+			"a sweep an eighth wide touches the sphere an eighth further out");
+
+		// The second sphere's near side is exactly 7 away
+		ray.maxHits = QUERY_MAX_HITS;
+		ray.maxDistance = 7.0f;
+		hits = Ask(scene, ray);
+		Expect(hits.size() == 2 && hits[1].distance == 7.0f, "a sphere at exactly the max distance is hit");
+		ray.maxDistance = 6.99f;
+		Expect(Ask(scene, ray).size() == 1, "and one just past it isn't");
+
+		ray.maxDistance = 100.0f;
+		ray.ignore = scene.spheres[0].id;
+		hits = Ask(scene, ray);
+		Expect(hits.size() == 5 && hits[0].entity == scene.spheres[1].id, "the ignored entity isn't hit");
+
+		SpatialQuery back = MakeQuery(QueryShape::Ray, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 100.0f);
+		Expect(Ask(scene, back).empty(), "a query doesn't see entities outside its layers");
+		back.layers = ENTITY_LAYER_DEFAULT | ENTITY_LAYER_PROJECTILE;
+		hits = Ask(scene, back);
+		Expect(hits.size() == 1 && hits[0].entity == scene.spheres[7].id, "but does once it shares a layer");
+
+		SpatialQuery inside = MakeQuery(QueryShape::Ray, 0.0f, 0.0f, 4.5f, 0.0f, 0.0f, 1.0f, 100.0f);
+		hits = Ask(scene, inside);
+		Expect(!hits.empty() && hits[0].entity == scene.spheres[0].id && hits[0].distance == 0.0f, "a ray starting inside a sphere hits it at 0");
+
+		// Straight ahead, at the edge of a 45 degree cone, and
+		// behind it
+		Scene cones;
+		cones.Add(0.0f, 0.0f, 5.0f, 0.5f, ENTITY_LAYER_DEFAULT);
+		cones.Add(3.0f, 0.0f, 3.0f, 0.5f, ENTITY_LAYER_DEFAULT);
+		cones.Add(0.0f, 0.0f, -3.0f, 0.5f, ENTITY_LAYER_DEFAULT);
+		cones.Add(4.0f, 0.0f, 1.0f, 0.5f, ENTITY_LAYER_DEFAULT);
+		cones.Build();
+		SpatialQuery cone = MakeQuery(QueryShape::Cone, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 10.0f);
+		cone.coneCosine = 0.70710678f;
+		hits = Ask(cones, cone);
+		Expect(hits.size() == 2 && hits[0].entity == cones.spheres[1].id && hits[1].entity == cones.spheres[0].id,
+			"a cone touches what is inside it, nearest first, and nothing behind or beside it");
+
+		// A short cone with its tip just beside a big sphere that
+		// reaches into its side further along. The sphere's box is
+		// further off the cone's line than the cone is wide
+		Scene beside;
+		beside.Add(-10.25f, 0.0f, 0.0f, 10.0f, ENTITY_LAYER_DEFAULT);
+		beside.Build();
+		SpatialQuery tip = MakeQuery(QueryShape::Cone, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.5f);
+		tip.coneCosine = 0.9f;
+		hits = Ask(beside, tip);
+		Expect(hits.size() == 1 && hits[0].distance == 0.25f, "a short cone touches a big sphere beside its tip");
+
+		// Starting on the face of the sphere's box and running
+		// along it, where the slab test meets 0 times infinity
+		Scene face;
+		face.Add(1.0f, 0.0f, 10.0f, 1.0f, ENTITY_LAYER_DEFAULT);
+		face.Build();
+		hits = Ask(face, MakeQuery(QueryShape::Ray, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 100.0f));
+		Expect(hits.size() == 1 && hits[0].distance == 10.0f, "a ray along the face of a box still reaches what is in it");
+
+		SpatialQuery none = ray;
+		none.flags = QUERY_LEVEL;
+		Expect(Ask(scene, none).empty(), "a query not asking for entities gets none");
+	}
+
+	void CheckRandom(unsigned int rounds)
+	{
+		printf("Random:\n");
+		std::mt19937 random(44);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		const unsigned int entityLayers[] = { 0, ENTITY_LAYER_DEFAULT, ENTITY_LAYER_PROJECTILE, ENTITY_LAYER_DEFAULT | ENTITY_LAYER_PROJECTILE, 1u << 5 };
+		const unsigned int queryLayers[] = { ENTITY_LAYER_DEFAULT, ENTITY_LAYER_PROJECTILE, ENTITY_LAYER_DEFAULT | ENTITY_LAYER_PROJECTILE, 1u << 5, ~0u, 0 };
+
+		RenderJobGraph graph(3);
+		Differences serial = {};
+		unsigned int parallelMismatches = 0;
+		unsigned int entities = 0;
+		for (unsigned int r = 0; r < rounds; r++)
+		{
+			// Mostly small scenes, whose counts are rarely a multiple
+			// of four, and now and then a big one
+			unsigned int count = r % 10 == 0 ? 2000 + random() % 2000 : random() % 64;
+			float side = 4.0f + sqrtf((float)count) * 3.0f;
+
+			// Clustered so spheres touch and overlap, some sharing
+			// a center so distances tie. Every third scene is full of
+			// spheres bigger than a short cone is wide, which only
+			// the padding for the largest radius finds
+			bool big = r % 3 == 1;
+			Scene scene;
+			float cluster[3] = {};
+			for (unsigned int i = 0; i < count; i++)
+			{
+				if (i % 8 == 0)
+				{
+					for (int c = 0; c < 3; c++)
+						cluster[c] = (unit(random) - 0.5f) * side;
+				}
+				float spread = unit(random) * 3.0f;
+				float radius = random() % (big ? 3 : 50) == 0 ? 2.0f + unit(random) * 14.0f : unit(random) * 1.5f;
+				unsigned int layers = entityLayers[random() % 5];
+				if (random() % 10 == 0 && !scene.spheres.empty())
+				{
+					const Sphere& twin = scene.spheres.back();
+					scene.Add(twin.center[0], twin.center[1], twin.center[2], twin.radius, layers);
+					continue;
+				}
+				scene.Add(
+					cluster[0] + (unit(random) - 0.5f) * spread,
+					cluster[1] + (unit(random) - 0.5f) * spread,
+					cluster[2] + (unit(random) - 0.5f) * spread,
+					radius, layers);
+			}
+			scene.Build();
+			entities += scene.index.GetEntityCount();
+
+			QueryBatch batch;
+			for (unsigned int q = 0; q < 64; q++)
+			{
+				SpatialQuery query = {};
+				query.shape = (QueryShape)(random() % 3);
+				for (int c = 0; c < 3; c++)
+					query.origin[c] = (unit(random) - 0.5f) * side * 1.5f;
+
+				// Some straight down an axis, so the inverse direction
+				// the boxes are tested with is infinite on the others
+				if (random() % 8 == 0)
+					query.direction[random() % 3] = random() % 2 ? 1.0f : -1.0f;
+				else
+				{
+					float yaw = unit(random) * 6.2831853f;
+					float pitch = (unit(random) - 0.5f) * 3.1415927f;
+					query.direction[0] = cosf(pitch) * sinf(yaw);
+					query.direction[1] = sinf(pitch);
+					query.direction[2] = cosf(pitch) * cosf(yaw);
+				}
+
+				// Some as short as a sword's reach, where the spheres
+				// are bigger than the cone is wide
+				switch (random() % 8)
+				{
+				case 0: query.maxDistance = 0.0f; break;
+				case 1: query.maxDistance = unit(random); break;
+				case 2: query.maxDistance = unit(random) * 3.0f; break;
+				default: query.maxDistance = unit(random) * side * 1.5f; break;
+				}
+				query.radius = unit(random) * 2.0f;
+				query.coneCosine = 0.1f + unit(random) * 0.895f;
+				query.flags = random() % 16 == 0 ? QUERY_LEVEL : QUERY_ENTITIES | (random() % 2 ? QUERY_LEVEL : 0);
+				query.layers = queryLayers[random() % 6];
+				query.maxHits = random() % 40;
+				if (random() % 4 == 0 && !scene.spheres.empty())
+					query.ignore = scene.spheres[random() % scene.spheres.size()].id;
+				batch.Add(query);
+			}
+
+			scene.index.Run(&batch);
+			std::vector<std::vector<QueryHit>> answers;
+			for (unsigned int q = 0; q < batch.GetQueryCount(); q++)
+			{
+				Span<const QueryHit> hits = batch.GetHits(q);
+				Compare(scene, batch.GetQuery(q), hits, &serial);
+				answers.push_back(std::vector<QueryHit>(hits.begin(), hits.end()));
+			}
+
+			// Split across workers the answers are the same to the bit
+			graph.Reset();
+			scene.index.AddJobs(&graph, &batch, 7);
+			graph.Run(true);
+			for (unsigned int q = 0; q < batch.GetQueryCount(); q++)
+			{
+				Span<const QueryHit> hits = batch.GetHits(q);
+				bool same = hits.size() == answers[q].size();
+				for (size_t h = 0; same && h < hits.size(); h++)
+					same = hits[h].entity == answers[q][h].entity && hits[h].distance == answers[q][h].distance;
+				parallelMismatches += !same;
+			}
+		}
+
+		printf("%u rounds, %u entities indexed, %u queries, %u hits: %u miscounted, %u misplaced, %u wrong, %u off the surface, %u differ across workers\n",
+			rounds, entities, serial.queries, serial.hits, serial.miscounted, serial.misplaced, serial.wrong, serial.surface, parallelMismatches);
+		Expect(serial.hits > 0, "random queries hit something");
+		Expect(serial.miscounted == 0, "every query finds as many hits as the reference");
+		Expect(serial.misplaced == 0, "at the reference's distances, nearest first");
+		Expect(serial.wrong == 0, "only entities in the query's layers, not ignored, each once");
+		Expect(serial.surface == 0, "with points and normals on the sphere hit");
+		Expect(parallelMismatches == 0, "and the same answers across workers");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int rounds = 200;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+			rounds = (unsigned int)atoi(argv[++i]);
+		else
+		{
+			printf("Usage: %s [-r rounds]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	CheckByHand();
+	CheckRandom(rounds);
+
+	printf("%s\n", failures == 0 ? "All passed" : "Failures above");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+// Developer: Narai
+// Purpose: Headless run of the entity spawn stress test the
+//			Inspector has a button for. Spawns thousands of
+//			one second projectiles a second from a pool for a
+//			few seconds at a few rates, and fails if anything
+//			is allocated on the heap once the pool has seen its
+//			busiest frame. The counter is checked first, so a
+//			counter that sees nothing can't pass for no
+//			allocations.
+//
+// Build and run on Linux, from this folder:
+//
+//		g++ -O2 -std=c++14 -I../.. BenchSpawning.cpp ../../AllocationCounter.cpp ../../EntityPool.cpp ../../EntityStore.cpp -o BenchSpawning
+//		./BenchSpawning
+//
+// Options: -s <seconds> to run each rate for, 5 by default.
+// Anything counted is counted after the first two.
+
+#include "AllocationCounter.h"
+#include "EntityPool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	int failures = 0;
+
+	void Expect(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			printf("  FAILED: %s\n", what);
+			failures++;
+		}
+	}
+
+	// Somewhere the optimizer has to assume is read, or it may
+	// leave out a new and delete that cancel out
+	void* volatile escaped;
+
+	// Every form of new goes through the counter, on this
+	// thread and in the total
+	void CheckCounter()
+	{
+		unsigned long long thread = GetThreadHeapAllocationCount();
+		unsigned long long total = GetHeapAllocationCount();
+
+		int* one = new int(1);
+		escaped = one;
+		int* many = new int[16];
+		escaped = many;
+		std::vector<int>* grown = new std::vector<int>(100);
+		escaped = grown->data();
+		delete grown;
+		delete[] many;
+		delete one;
+
+		Expect(GetThreadHeapAllocationCount() - thread == 4 && GetHeapAllocationCount() - total == 4,
+			"the counter sees new, new[] and a container's allocation");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	float seconds = 5.0f;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seconds = (float)atof(argv[++i]);
+		else
+		{
+			printf("Usage: %s [-s seconds]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	// Shorter runs never get past the warmup to be counted
+	if (seconds <= 2.5f)
+	{
+		printf("Runs need to be longer than the two second warmup\n");
+		return 1;
+	}
+
+	CheckCounter();
+
+	// The Inspector runs 10k, a slower and a much busier rate
+	// either side of it
+	const unsigned int rates[] = { 1000, 10000, 50000 };
+	for (unsigned int rate : rates)
+	{
+		EntitySpawnBenchmark b = BenchmarkEntitySpawning(rate, seconds);
+		printf("%6u spawns/s: %u frames, %u alive, %.3f ms a frame (worst %.3f ms), %llu heap allocations after warmup\n",
+			b.spawnsPerSecond, b.frames, b.liveEntities, b.frameMS, b.worstFrameMS, b.steadyAllocations);
+
+		Expect(b.steadyAllocations == 0, "nothing is allocated once the pool has warmed up");
+
+		// Everything lives a second, so about a second's worth
+		// is alive at any time
+		Expect(b.liveEntities >= rate * 9 / 10 && b.liveEntities <= rate * 11 / 10 + 1, "about a second of spawns is alive");
+	}
+
+	printf("%s\n", failures == 0 ? "All passed" : "Failures above");
+	return failures == 0 ? 0 : 1;
+}
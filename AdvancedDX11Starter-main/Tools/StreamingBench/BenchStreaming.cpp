@@ -0,0 +1,315 @@
+// Developer: Narai
+// Purpose: Headless check of texture streaming. First steps a
+//			streamer by hand through a first load, a finer one,
+//			a failed one and a lowered budget. Then runs many
+//			textures of different sizes through random requests,
+//			budgets and load times, keeping its own copy of what
+//			is resident from the commands handed out, and checks
+//			every eviction drops one mip of a texture that can
+//			spare it, every load fits the budget, and the
+//			streamer's totals match. Then walks the corridor the
+//			Inspector simulates at a few budgets.
+//
+// Build and run on Linux, from this folder:
+//
+//		g++ -O2 -std=c++14 -I../.. BenchStreaming.cpp ../../TextureStreaming.cpp -o BenchStreaming
+//		./BenchStreaming
+//
+// Options: -f <frames> of random requests, 5000 by default,
+// and -t <textures> to stream, 200 by default.
+
+#include "TextureStreaming.h"
+
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	const size_t MB = 1024 * 1024;
+
+	int failures = 0;
+
+	void Expect(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			printf("  FAILED: %s\n", what);
+			failures++;
+		}
+	}
+
+	// The only command of a type handed out, or null
+	const TextureStreamCommand* Only(const std::vector<TextureStreamCommand>& commands, TextureStreamCommandType type)
+	{
+		const TextureStreamCommand* found = nullptr;
+		for (auto& c : commands)
+		{
+			if (c.type != type)
+				continue;
+			if (found)
+				return nullptr;
+			found = &c;
+		}
+		return found;
+	}
+
+	void CheckByHand()
+	{
+		printf("By hand:\n");
+		TextureStreamer streamer;
+		std::vector<TextureStreamCommand> commands;
+		streamer.SetBudget(64 * MB);
+		unsigned int big = streamer.Register();
+		unsigned int small = streamer.Register();
+		unsigned int broken = streamer.Register();
+
+		// Nothing is loaded before it is asked for
+		streamer.BeginFrame();
+		streamer.Update(commands);
+		Expect(commands.empty(), "nothing asked for, nothing loaded");
+
+		// A first load is of the base mip, whatever the size
+		streamer.BeginFrame();
+		streamer.Request(big, 1.0f, 2000.0f);
+		streamer.Request(broken, 1.0f, 10.0f);
+		commands.clear();
+		streamer.Update(commands);
+		Expect(commands.size() == 2 && commands[0].mip == TEXTURE_STREAM_BASE_MIP && commands[1].mip == TEXTURE_STREAM_BASE_MIP,
+			"first loads are of the base mip");
+		Expect(streamer.IsPending(big) && streamer.IsPending(broken), "and pending until they come back");
+
+		streamer.CompleteLoad(big, TextureBaseMip(2048, 2048), 2048, 2048);
+		streamer.FailLoad(broken);
+		Expect(streamer.GetStats().residentBytes == TextureMipChainBytes(2048, 2048, TextureBaseMip(2048, 2048)),
+			"the base mip's bytes are resident");
+
+		// Close up, the finer mips follow, and a failed load
+		// isn't tried again
+		streamer.BeginFrame();
+		streamer.Request(big, 1.0f, 2000.0f);
+		streamer.Request(broken, 1.0f, 2000.0f);
+		commands.clear();
+		streamer.Update(commands);
+		const TextureStreamCommand* load = Only(commands, TextureStreamCommandType::Load);
+		Expect(load && load->texture == big && load->mip == ComputeDesiredMip(2048, 2048, 1.0f, 2000.0f), "up close the mip it needs is loaded");
+		if (load)
+			streamer.CompleteLoad(big, load->mip, 2048, 2048);
+
+		// A second texture that only fits if the first gives up
+		// its finest mip. It isn't seen this frame, so it goes
+		streamer.BeginFrame();
+		streamer.Request(small, 1.0f, 10.0f);
+		commands.clear();
+		streamer.Update(commands);
+		load = Only(commands, TextureStreamCommandType::Load);
+		Expect(load && load->texture == small, "another texture is loaded");
+		if (load)
+			streamer.CompleteLoad(small, TextureBaseMip(512, 512), 512, 512);
+
+		size_t withBoth = streamer.GetStats().residentBytes;
+		unsigned int bigMip = streamer.GetResidentMip(big);
+		streamer.SetBudget(withBoth - 1);
+		streamer.BeginFrame();
+		streamer.Request(small, 1.0f, 10.0f);
+		commands.clear();
+		streamer.Update(commands);
+		const TextureStreamCommand* evict = Only(commands, TextureStreamCommandType::Evict);
+		Expect(evict && evict->texture == big && evict->mip == bigMip + 1, "a lowered budget drops one mip of the texture not seen");
+		Expect(streamer.GetStats().residentBytes <= withBoth - 1, "and is kept");
+
+		// Down to nothing but base mips, which are never evicted
+		streamer.SetBudget(1);
+		streamer.BeginFrame();
+		commands.clear();
+		streamer.Update(commands);
+		Expect(streamer.GetResidentMip(big) <= TextureBaseMip(2048, 2048) && streamer.GetResidentMip(small) == TextureBaseMip(512, 512),
+			"base mips stay however low the budget");
+	}
+
+	// What the streamer was told, tracked from the outside
+	struct Model
+	{
+		unsigned int width;
+		unsigned int height;
+		unsigned int residentMip;
+		unsigned int pendingMip;
+		unsigned int dueFrame;
+		bool failed;
+		bool willFail;
+	};
+
+	size_t ModelBytes(const Model& m)
+	{
+		return m.residentMip == TEXTURE_STREAM_NOT_RESIDENT ? 0 : TextureMipChainBytes(m.width, m.height, m.residentMip);
+	}
+
+	void CheckRandom(unsigned int frames, unsigned int textureCount)
+	{
+		printf("Random:\n");
+		std::mt19937 random(11);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		const size_t budgets[] = { 4 * MB, 16 * MB, 64 * MB, 256 * MB, 4096 * MB };
+
+		TextureStreamer streamer;
+		std::vector<Model> models(textureCount);
+		for (auto& m : models)
+		{
+			streamer.Register();
+			m.width = 16u << (random() % 9);
+			m.height = random() % 4 == 0 ? m.width / 2 : m.width;
+			m.residentMip = TEXTURE_STREAM_NOT_RESIDENT;
+			m.pendingMip = TEXTURE_STREAM_NOT_RESIDENT;
+			m.failed = false;
+			m.willFail = random() % 50 == 0;
+		}
+
+		unsigned int badEvictions = 0;		// Not one mip, past the base, on a pending texture or below what it needs
+		unsigned int badLoads = 0;			// Not asked for, not finer, already pending or failed before
+		unsigned int overBudgetLoads = 0;	// Frames handing out loads that don't fit
+		unsigned int tooManyInFlight = 0;
+		unsigned int miscounted = 0;
+		unsigned int overBudgetFrames = 0;
+		unsigned long long loads = 0;
+		unsigned long long evictions = 0;
+		std::vector<TextureStreamCommand> commands;
+		std::vector<bool> seen(textureCount);
+		size_t budget = 64 * MB;
+		for (unsigned int f = 0; f < frames; f++)
+		{
+			for (unsigned int i = 0; i < textureCount; i++)
+			{
+				Model& m = models[i];
+				if (m.pendingMip == TEXTURE_STREAM_NOT_RESIDENT || m.dueFrame > f)
+					continue;
+
+				if (m.willFail)
+				{
+					streamer.FailLoad(i);
+					m.failed = true;
+				}
+				else
+				{
+					m.residentMip = m.pendingMip == TEXTURE_STREAM_BASE_MIP ? TextureBaseMip(m.width, m.height) : m.pendingMip;
+					streamer.CompleteLoad(i, m.residentMip, m.width, m.height);
+				}
+				m.pendingMip = TEXTURE_STREAM_NOT_RESIDENT;
+			}
+
+			if (f % 200 == 0)
+			{
+				budget = budgets[random() % 5];
+				streamer.SetBudget(budget);
+			}
+
+			// A third of them on screen at any size, some tiled
+			streamer.BeginFrame();
+			for (unsigned int i = 0; i < textureCount; i++)
+			{
+				seen[i] = random() % 3 == 0;
+				if (seen[i])
+					streamer.Request(i, 1.0f + (random() % 4), unit(random) * unit(random) * 2000.0f);
+			}
+
+			commands.clear();
+			streamer.Update(commands);
+
+			bool loaded = false;
+			for (auto& c : commands)
+			{
+				Model& m = models[c.texture];
+				if (c.type == TextureStreamCommandType::Evict)
+				{
+					evictions++;
+					if (m.pendingMip != TEXTURE_STREAM_NOT_RESIDENT || m.residentMip == TEXTURE_STREAM_NOT_RESIDENT ||
+						c.mip != m.residentMip + 1 || c.mip > TextureBaseMip(m.width, m.height) ||
+						(seen[c.texture] && c.mip > streamer.GetDesiredMip(c.texture)))
+						badEvictions++;
+					m.residentMip = c.mip;
+					continue;
+				}
+
+				loads++;
+				loaded = true;
+				bool finer = m.residentMip == TEXTURE_STREAM_NOT_RESIDENT ? c.mip == TEXTURE_STREAM_BASE_MIP : c.mip < m.residentMip;
+				if (!seen[c.texture] || !finer || m.pendingMip != TEXTURE_STREAM_NOT_RESIDENT || m.failed)
+					badLoads++;
+				m.pendingMip = c.mip;
+				m.dueFrame = f + 1 + random() % 6;
+			}
+
+			unsigned int inFlight = 0;
+			size_t resident = 0;
+			for (auto& m : models)
+			{
+				inFlight += m.pendingMip != TEXTURE_STREAM_NOT_RESIDENT;
+				resident += ModelBytes(m);
+			}
+
+			TextureStreamStats stats = streamer.GetStats();
+			if (inFlight > TEXTURE_STREAM_MAX_IN_FLIGHT)
+				tooManyInFlight++;
+			if (stats.residentBytes != resident)
+				miscounted++;
+			if (loaded && stats.residentBytes + stats.pendingBytes > budget)
+				overBudgetLoads++;
+
+			// Can happen, base mips are never evicted and a first
+			// load's size is only a guess
+			if (stats.residentBytes > budget)
+				overBudgetFrames++;
+		}
+
+		printf("%u textures over %u frames: %llu loads, %llu evictions, %u bad evictions, %u bad loads, %u frames loading past the budget, %u with too many in flight, %u miscounted, %u over budget\n",
+			textureCount, frames, loads, evictions, badEvictions, badLoads, overBudgetLoads, tooManyInFlight, miscounted, overBudgetFrames);
+		Expect(badEvictions == 0, "evictions drop one mip at a time of textures that can spare it");
+		Expect(badLoads == 0 && tooManyInFlight == 0, "loads are only of finer mips asked for, a few at a time");
+		Expect(overBudgetLoads == 0, "loads are only handed out when they fit the budget");
+		Expect(miscounted == 0, "resident bytes match the mips handed out");
+		Expect(loads > 0 && evictions > 0, "both loads and evictions happened");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int frames = 5000;
+	unsigned int textures = 200;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+			frames = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			textures = (unsigned int)atoi(argv[++i]);
+		else
+		{
+			printf("Usage: %s [-f frames] [-t textures]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	CheckByHand();
+	CheckRandom(frames, textures);
+
+	// The Inspector's corridor, 40 textures of 2048 and 1024
+	printf("Corridor:\n");
+	const unsigned int budgetsMB[] = { 16, 32, 64, 128, 512, 1024 };
+	for (unsigned int budgetMB : budgetsMB)
+	{
+		TextureStreamingSimSettings settings = { 40, 2048, (size_t)budgetMB * MB, 1200, 3 };
+		TextureStreamingSimResult r = SimulateTextureStreaming(settings);
+		printf("%4u MB: peak %.1f MB of %.1f MB, %u frames over budget, %llu loads, %llu evictions, mip deficit %.2f, update %.4f ms\n",
+			budgetMB, r.peakResidentBytes / (float)MB, r.fullBytes / (float)MB, r.overBudgetFrames,
+			r.loads, r.evictions, r.averageMipDeficit, r.updateMS);
+
+		Expect(r.overBudgetFrames == 0 && r.peakResidentBytes <= settings.budgetBytes, "the corridor stays within its budget");
+		if (settings.budgetBytes < r.fullBytes / 4)
+			Expect(r.evictions > 0, "a budget well short of everything evicts");
+		else if (settings.budgetBytes >= r.fullBytes)
+			Expect(r.evictions == 0, "a budget bigger than everything never evicts");
+	}
+
+	printf("%s\n", failures == 0 ? "All passed" : "Failures above");
+	return failures == 0 ? 0 : 1;
+}
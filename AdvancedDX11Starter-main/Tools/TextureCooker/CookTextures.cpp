@@ -0,0 +1,387 @@
+// Developer: Narai
+// Purpose: Offline texture cooker. Reads every PNG under
+//			Assets/Textures and writes a block compressed .dds
+//			with its whole mip chain to Assets/Cooked/Textures,
+//			which the engine loads in place of the PNG. Single
+//			channel maps (_ao, _roughness, _metal, _height) are
+//			packed into one _orm texture per material instead.
+//			Files are cooked on as many threads as there are cores.
+//
+// Build and run on Linux, from this folder:
+//
+//		g++ -O2 -std=c++14 -pthread -I../.. CookTextures.cpp PngDecoder.cpp ../../TextureCooker.cpp -o CookTextures
+//		./CookTextures ../../Assets
+//
+// Options: -j <threads>, and -f to cook files that are
+// already up to date.
+
+#include "PngDecoder.h"
+#include "TextureCooker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+struct CookJob
+{
+	std::string source;		// Relative to the Assets folder, an _orm is packed from its maps
+	unsigned int width;
+	unsigned int height;
+	unsigned int format;
+	TextureMapType type;
+	size_t uncompressedBytes;	// RGBA8 with mips, as loaded without cooking, summed over packed maps
+	size_t cookedBytes;
+	float psnr;
+	float cookMS;
+	bool skipped;
+	std::string error;
+};
+
+static const char* FormatName(unsigned int format)
+{
+	switch (format)
+	{
+	case COOKED_FORMAT_BC1: return "BC1";
+	case COOKED_FORMAT_BC4: return "BC4";
+	case COOKED_FORMAT_BC5: return "BC5";
+	case COOKED_FORMAT_BC7: return "BC7";
+	default: return "RGBA8";
+	}
+}
+
+static const char* TypeName(TextureMapType type)
+{
+	switch (type)
+	{
+	case TextureMapType::Albedo: return "albedo";
+	case TextureMapType::Normal: return "normal";
+	case TextureMapType::Mask: return "mask";
+	case TextureMapType::Packed: return "orm";
+	default: return "color";
+	}
+}
+
+static bool ReadFile(const std::string& path, std::vector<unsigned char>& data)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+		return false;
+
+	data.resize((size_t)file.tellg());
+	file.seekg(0);
+	return (bool)file.read((char*)data.data(), data.size());
+}
+
+static bool WriteFile(const std::string& path, const std::vector<unsigned char>& data)
+{
+	// Every folder on the way has to exist first
+	for (size_t slash = path.find('/'); slash != std::string::npos; slash = path.find('/', slash + 1))
+		mkdir(path.substr(0, slash).c_str(), 0755);
+
+	std::ofstream file(path, std::ios::binary);
+	return file.is_open() && (bool)file.write((const char*)data.data(), data.size());
+}
+
+static long long ModifiedTime(const std::string& path)
+{
+	struct stat info;
+	return stat(path.c_str(), &info) == 0 ? (long long)info.st_mtime : -1;
+}
+
+/// <summary>
+/// Every PNG under a folder, relative to the Assets folder
+/// </summary>
+static void FindPngs(const std::string& assets, const std::string& folder, std::vector<std::string>& found)
+{
+	DIR* dir = opendir((assets + "/" + folder).c_str());
+	if (!dir)
+		return;
+
+	while (dirent* entry = readdir(dir))
+	{
+		std::string name = entry->d_name;
+		if (name == "." || name == "..")
+			continue;
+
+		std::string path = folder + "/" + name;
+		struct stat info;
+		if (stat((assets + "/" + path).c_str(), &info) != 0)
+			continue;
+
+		std::string lower = name;
+		std::transform(lower.begin(), lower.end(), lower.begin(), [](char c) { return (char)tolower(c); });
+		if (S_ISDIR(info.st_mode))
+			FindPngs(assets, path, found);
+		else if (lower.size() > 4 && lower.compare(lower.size() - 4, 4, ".png") == 0)
+			found.push_back(path);
+	}
+
+	closedir(dir);
+	std::sort(found.begin(), found.end());
+}
+
+/// <summary>
+/// The PNGs a job reads, which for a packed texture are the
+/// channel maps that exist
+/// </summary>
+static std::vector<std::string> SourcesOf(const std::string& assets, const std::string& source)
+{
+	if (!IsOrmTexture(source))
+		return std::vector<std::string>(1, source);
+
+	std::vector<std::string> sources;
+	for (unsigned int c = 0; c < ORM_CHANNEL_COUNT; c++)
+	{
+		std::string channel = OrmChannelSource(source, c);
+		struct stat info;
+		if (stat((assets + "/" + channel).c_str(), &info) == 0)
+			sources.push_back(channel);
+	}
+	return sources;
+}
+
+static size_t UncompressedBytes(unsigned int width, unsigned int height)
+{
+	size_t bytes = 0;
+	while (true)
+	{
+		bytes += (size_t)width * height * 4;
+		if (width == 1 && height == 1)
+			return bytes;
+		width = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+	}
+}
+
+/// <summary>
+/// Decodes a PNG, adding what it would take as RGBA8 with
+/// mips to the job
+/// </summary>
+static bool DecodeSource(const std::string& assets, const std::string& source, CookJob& job, std::vector<unsigned char>& rgba, unsigned int* width, unsigned int* height)
+{
+	std::vector<unsigned char> file;
+	if (!ReadFile(assets + "/" + source, file))
+	{
+		job.error = "could not read " + source;
+		return false;
+	}
+
+	if (!DecodePng(file.data(), file.size(), rgba, width, height, &job.error))
+		return false;
+
+	job.uncompressedBytes += UncompressedBytes(*width, *height);
+	return true;
+}
+
+static void Cook(const std::string& assets, CookJob& job, bool force)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	std::string cookedPath = assets + "/" + CookedTexturePath(job.source);
+	job.type = ClassifyTexture(job.source.substr(job.source.find_last_of('/') + 1));
+
+	// Packed textures take each map in its own channel
+	std::vector<unsigned char> rgba;
+	long long newestSource = -1;
+	if (job.type == TextureMapType::Packed)
+	{
+		std::vector<unsigned char> maps[ORM_CHANNEL_COUNT];
+		const unsigned char* sources[ORM_CHANNEL_COUNT] = {};
+		unsigned int widths[ORM_CHANNEL_COUNT] = {};
+		unsigned int heights[ORM_CHANNEL_COUNT] = {};
+		for (unsigned int c = 0; c < ORM_CHANNEL_COUNT; c++)
+		{
+			std::string source = OrmChannelSource(job.source, c);
+			long long modified = ModifiedTime(assets + "/" + source);
+			if (modified < 0)
+				continue;
+
+			if (!DecodeSource(assets, source, job, maps[c], &widths[c], &heights[c]))
+				return;
+			sources[c] = maps[c].data();
+			newestSource = std::max(newestSource, modified);
+		}
+		PackOrmTexture(sources, widths, heights, rgba, &job.width, &job.height);
+	}
+	else
+	{
+		if (!DecodeSource(assets, job.source, job, rgba, &job.width, &job.height))
+			return;
+		newestSource = ModifiedTime(assets + "/" + job.source);
+	}
+
+	// Up to date files are still measured from their header
+	if (!force && ModifiedTime(cookedPath) >= newestSource)
+	{
+		std::vector<unsigned char> cooked;
+		CookedTextureInfo info;
+		if (ReadFile(cookedPath, cooked) && ReadCookedTextureHeader(cooked.data(), cooked.size(), &info))
+		{
+			job.format = info.format;
+			job.cookedBytes = info.fileSize - COOKED_TEXTURE_HEADER_SIZE;
+			job.skipped = true;
+			return;
+		}
+	}
+
+	auto start = Clock::now();
+	CookedTexture texture;
+	CookTexture(rgba.data(), job.width, job.height, job.type, &texture);
+	job.cookMS = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+
+	job.format = texture.format;
+	job.psnr = texture.topLevelPSNR;
+	job.cookedBytes = texture.data.size();
+
+	std::vector<unsigned char> dds;
+	WriteCookedTexture(texture, dds);
+	if (!WriteFile(cookedPath, dds))
+		job.error = "could not write " + cookedPath;
+}
+
+int main(int argc, char** argv)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	std::string assets;
+	unsigned int threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	bool force = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-f") == 0)
+			force = true;
+		else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+			threadCount = std::max(atoi(argv[++i]), 1);
+		else
+			assets = argv[i];
+	}
+
+	if (assets.empty())
+	{
+		printf("Usage: CookTextures <Assets folder> [-j threads] [-f]\n");
+		return 1;
+	}
+
+	std::vector<std::string> sources;
+	FindPngs(assets, "Textures", sources);
+	if (sources.empty())
+	{
+		printf("No PNGs found under %s/Textures\n", assets.c_str());
+		return 1;
+	}
+
+	// Channel maps are only cooked as part of their _orm
+	std::vector<std::string> cooked;
+	for (auto& source : sources)
+	{
+		unsigned int channel;
+		std::string packed = OrmTextureOf(source, &channel);
+		cooked.push_back(packed.empty() ? source : packed);
+	}
+	std::sort(cooked.begin(), cooked.end());
+	cooked.erase(std::unique(cooked.begin(), cooked.end()), cooked.end());
+
+	std::vector<CookJob> jobs(cooked.size());
+	for (size_t i = 0; i < cooked.size(); i++)
+	{
+		jobs[i] = CookJob();
+		jobs[i].source = cooked[i];
+	}
+
+	// Largest files first so one big texture is not
+	// left running alone at the end
+	std::vector<size_t> order(jobs.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::vector<long long> sizes(jobs.size());
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		sizes[i] = 0;
+		for (auto& source : SourcesOf(assets, jobs[i].source))
+		{
+			struct stat info;
+			if (stat((assets + "/" + source).c_str(), &info) == 0)
+				sizes[i] += (long long)info.st_size;
+		}
+	}
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+	auto start = Clock::now();
+	std::atomic<size_t> next(0);
+	std::vector<std::thread> threads;
+	threadCount = (unsigned int)std::min<size_t>(threadCount, jobs.size());
+	for (unsigned int t = 0; t < threadCount; t++)
+	{
+		threads.push_back(std::thread([&]()
+		{
+			for (size_t i = next++; i < order.size(); i = next++)
+				Cook(assets, jobs[order[i]], force);
+		}));
+	}
+	for (auto& thread : threads)
+		thread.join();
+	float totalSeconds = std::chrono::duration<float>(Clock::now() - start).count();
+
+	// Report
+	size_t uncompressedBytes = 0;
+	size_t cookedBytes = 0;
+	size_t cookedTexels = 0;
+	unsigned int cookedCount = 0;
+	unsigned int failedCount = 0;
+	for (auto& job : jobs)
+	{
+		if (!job.error.empty())
+		{
+			printf("  %-40s FAILED: %s\n", job.source.c_str(), job.error.c_str());
+			failedCount++;
+			continue;
+		}
+
+		std::string psnr = job.skipped ? "" : std::to_string((int)job.psnr) + " dB";
+		printf("  %-40s %5u x %-5u %-6s %-5s %8.1f KB -> %7.1f KB %6s  %s\n",
+			job.source.c_str(),
+			job.width,
+			job.height,
+			TypeName(job.type),
+			FormatName(job.format),
+			job.uncompressedBytes / 1024.0f,
+			job.cookedBytes / 1024.0f,
+			psnr.c_str(),
+			job.skipped ? "up to date" : (std::to_string((int)job.cookMS) + " ms").c_str());
+
+		uncompressedBytes += job.uncompressedBytes;
+		cookedBytes += job.cookedBytes;
+		if (!job.skipped)
+		{
+			cookedTexels += (size_t)job.width * job.height;
+			cookedCount++;
+		}
+	}
+
+	printf("\n%u cooked, %u up to date, %u failed, on %u thread(s)\n",
+		cookedCount, (unsigned int)jobs.size() - cookedCount - failedCount, failedCount, threadCount);
+	if (cookedCount > 0)
+	{
+		printf("Cook time: %.2f s, %.2f Mtexels/s\n",
+			totalSeconds, cookedTexels / 1000000.0f / totalSeconds);
+	}
+	if (uncompressedBytes > 0)
+	{
+		printf("GPU memory: %.1f MB as RGBA8 with mips -> %.1f MB cooked (%.1f%% saved)\n",
+			uncompressedBytes / 1048576.0f,
+			cookedBytes / 1048576.0f,
+			100.0f * (1.0f - (float)cookedBytes / uncompressedBytes));
+	}
+
+	return failedCount > 0 ? 1 : 0;
+}
@@ -0,0 +1,505 @@
+#include "PngDecoder.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// --------------------------------------------------------
+// Inflate
+//
+// Canonical Huffman codes are decoded one bit at a time by
+// walking the count of codes of each length, which is slow
+// next to a table but short and plenty for a few files.
+// --------------------------------------------------------
+
+#define INFLATE_MAX_BITS		15
+#define INFLATE_MAX_LITERALS	288
+#define INFLATE_MAX_DISTANCES	30
+
+struct InflateState
+{
+	const unsigned char* data;
+	size_t size;
+	size_t position;
+	unsigned int bitBuffer;
+	unsigned int bitCount;
+	bool overrun;
+	std::vector<unsigned char>* out;
+};
+
+struct Huffman
+{
+	unsigned short counts[INFLATE_MAX_BITS + 1];
+	unsigned short symbols[INFLATE_MAX_LITERALS];
+};
+
+static unsigned int ReadBits(InflateState& s, unsigned int count)
+{
+	unsigned int value = s.bitBuffer;
+	while (s.bitCount < count)
+	{
+		if (s.position >= s.size)
+		{
+			s.overrun = true;
+			return 0;
+		}
+		value |= (unsigned int)s.data[s.position++] << s.bitCount;
+		s.bitCount += 8;
+	}
+
+	s.bitBuffer = value >> count;
+	s.bitCount -= count;
+	return value & ((1u << count) - 1);
+}
+
+static bool BuildHuffman(Huffman& h, const unsigned short* lengths, unsigned int count)
+{
+	memset(h.counts, 0, sizeof(h.counts));
+	for (unsigned int i = 0; i < count; i++)
+		h.counts[lengths[i]]++;
+
+	// Over subscribed codes can never decode properly
+	int left = 1;
+	for (int bits = 1; bits <= INFLATE_MAX_BITS; bits++)
+	{
+		left <<= 1;
+		left -= h.counts[bits];
+		if (left < 0)
+			return false;
+	}
+
+	unsigned short offsets[INFLATE_MAX_BITS + 1];
+	offsets[1] = 0;
+	for (int bits = 1; bits < INFLATE_MAX_BITS; bits++)
+		offsets[bits + 1] = offsets[bits] + h.counts[bits];
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (lengths[i] != 0)
+			h.symbols[offsets[lengths[i]]++] = (unsigned short)i;
+	}
+	return true;
+}
+
+static int DecodeSymbol(InflateState& s, const Huffman& h)
+{
+	int code = 0;
+	int first = 0;
+	int index = 0;
+	for (int bits = 1; bits <= INFLATE_MAX_BITS; bits++)
+	{
+		code |= (int)ReadBits(s, 1);
+		int count = h.counts[bits];
+		if (code - count < first)
+			return h.symbols[index + (code - first)];
+
+		index += count;
+		first += count;
+		first <<= 1;
+		code <<= 1;
+	}
+	return -1;
+}
+
+static bool InflateCodes(InflateState& s, const Huffman& literals, const Huffman& distances)
+{
+	static const unsigned short lengthBase[29] = {
+		3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	static const unsigned short lengthExtra[29] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	static const unsigned short distanceBase[30] = {
+		1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+		8193, 12289, 16385, 24577 };
+	static const unsigned short distanceExtra[30] = {
+		0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+		7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	std::vector<unsigned char>& out = *s.out;
+	while (true)
+	{
+		int symbol = DecodeSymbol(s, literals);
+		if (symbol < 0 || s.overrun)
+			return false;
+
+		if (symbol < 256)
+		{
+			out.push_back((unsigned char)symbol);
+			continue;
+		}
+		if (symbol == 256)
+			return true;
+
+		symbol -= 257;
+		if (symbol >= 29)
+			return false;
+		unsigned int length = lengthBase[symbol] + ReadBits(s, lengthExtra[symbol]);
+
+		int distanceSymbol = DecodeSymbol(s, distances);
+		if (distanceSymbol < 0 || distanceSymbol >= 30)
+			return false;
+		size_t distance = distanceBase[distanceSymbol] + ReadBits(s, distanceExtra[distanceSymbol]);
+		if (distance > out.size() || s.overrun)
+			return false;
+
+		// Copies may overlap what they are writing
+		size_t from = out.size() - distance;
+		for (unsigned int i = 0; i < length; i++)
+			out.push_back(out[from + i]);
+	}
+}
+
+static bool InflateStored(InflateState& s)
+{
+	// Stored blocks start on a byte
+	s.bitBuffer = 0;
+	s.bitCount = 0;
+	if (s.position + 4 > s.size)
+		return false;
+
+	unsigned int length = s.data[s.position] | (s.data[s.position + 1] << 8);
+	unsigned int check = s.data[s.position + 2] | (s.data[s.position + 3] << 8);
+	s.position += 4;
+	if (length != (~check & 0xFFFF) || s.position + length > s.size)
+		return false;
+
+	s.out->insert(s.out->end(), s.data + s.position, s.data + s.position + length);
+	s.position += length;
+	return true;
+}
+
+static bool InflateFixed(InflateState& s)
+{
+	unsigned short lengths[INFLATE_MAX_LITERALS];
+	int i = 0;
+	for (; i < 144; i++) lengths[i] = 8;
+	for (; i < 256; i++) lengths[i] = 9;
+	for (; i < 280; i++) lengths[i] = 7;
+	for (; i < INFLATE_MAX_LITERALS; i++) lengths[i] = 8;
+
+	Huffman literals, distances;
+	BuildHuffman(literals, lengths, INFLATE_MAX_LITERALS);
+
+	for (i = 0; i < INFLATE_MAX_DISTANCES; i++)
+		lengths[i] = 5;
+	BuildHuffman(distances, lengths, INFLATE_MAX_DISTANCES);
+
+	return InflateCodes(s, literals, distances);
+}
+
+static bool InflateDynamic(InflateState& s)
+{
+	static const unsigned char order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	unsigned int literalCount = ReadBits(s, 5) + 257;
+	unsigned int distanceCount = ReadBits(s, 5) + 1;
+	unsigned int codeCount = ReadBits(s, 4) + 4;
+	if (literalCount > INFLATE_MAX_LITERALS || distanceCount > INFLATE_MAX_DISTANCES)
+		return false;
+
+	// Lengths of the code that the other two codes'
+	// lengths are written with
+	unsigned short lengths[INFLATE_MAX_LITERALS + INFLATE_MAX_DISTANCES] = {};
+	for (unsigned int i = 0; i < codeCount; i++)
+		lengths[order[i]] = (unsigned short)ReadBits(s, 3);
+
+	Huffman lengthCode;
+	if (!BuildHuffman(lengthCode, lengths, 19))
+		return false;
+
+	unsigned int index = 0;
+	while (index < literalCount + distanceCount)
+	{
+		int symbol = DecodeSymbol(s, lengthCode);
+		if (symbol < 0 || s.overrun)
+			return false;
+
+		if (symbol < 16)
+		{
+			lengths[index++] = (unsigned short)symbol;
+			continue;
+		}
+
+		unsigned short repeat = 0;
+		unsigned int times;
+		if (symbol == 16)
+		{
+			if (index == 0)
+				return false;
+			repeat = lengths[index - 1];
+			times = 3 + ReadBits(s, 2);
+		}
+		else if (symbol == 17)
+			times = 3 + ReadBits(s, 3);
+		else
+			times = 11 + ReadBits(s, 7);
+
+		if (index + times > literalCount + distanceCount)
+			return false;
+		while (times--)
+			lengths[index++] = repeat;
+	}
+
+	// Without an end of block code nothing could ever end
+	if (lengths[256] == 0)
+		return false;
+
+	Huffman literals, distances;
+	if (!BuildHuffman(literals, lengths, literalCount) ||
+		!BuildHuffman(distances, lengths + literalCount, distanceCount))
+		return false;
+
+	return InflateCodes(s, literals, distances);
+}
+
+bool InflateZlib(const unsigned char* data, size_t size, std::vector<unsigned char>& out)
+{
+	// Deflate, no preset dictionary
+	if (size < 2 || (data[0] & 0x0F) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20))
+		return false;
+
+	InflateState s = {};
+	s.data = data + 2;
+	s.size = size - 2;
+	s.out = &out;
+
+	bool last = false;
+	while (!last)
+	{
+		last = ReadBits(s, 1) != 0;
+		unsigned int type = ReadBits(s, 2);
+
+		bool ok = false;
+		switch (type)
+		{
+		case 0: ok = InflateStored(s); break;
+		case 1: ok = InflateFixed(s); break;
+		case 2: ok = InflateDynamic(s); break;
+		}
+
+		if (!ok || s.overrun)
+			return false;
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// PNG
+// --------------------------------------------------------
+
+static unsigned int ReadBigEndian(const unsigned char* data)
+{
+	return ((unsigned int)data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+}
+
+static unsigned char Paeth(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = abs(p - a);
+	int pb = abs(p - b);
+	int pc = abs(p - c);
+	if (pa <= pb && pa <= pc) return (unsigned char)a;
+	if (pb <= pc) return (unsigned char)b;
+	return (unsigned char)c;
+}
+
+/// <summary>
+/// Undoes the per row filters in place, rows each starting
+/// with their filter type byte
+/// </summary>
+static bool Unfilter(std::vector<unsigned char>& rows, unsigned int height, size_t stride, unsigned int pixelBytes)
+{
+	if (rows.size() < (stride + 1) * height)
+		return false;
+
+	const unsigned char* previous = 0;
+	for (unsigned int y = 0; y < height; y++)
+	{
+		unsigned char filter = rows[y * (stride + 1)];
+		unsigned char* row = &rows[y * (stride + 1) + 1];
+		for (size_t x = 0; x < stride; x++)
+		{
+			int left = x >= pixelBytes ? row[x - pixelBytes] : 0;
+			int up = previous ? previous[x] : 0;
+			int upLeft = previous && x >= pixelBytes ? previous[x - pixelBytes] : 0;
+			switch (filter)
+			{
+			case 0: break;
+			case 1: row[x] = (unsigned char)(row[x] + left); break;
+			case 2: row[x] = (unsigned char)(row[x] + up); break;
+			case 3: row[x] = (unsigned char)(row[x] + ((left + up) >> 1)); break;
+			case 4: row[x] = (unsigned char)(row[x] + Paeth(left, up, upLeft)); break;
+			default: return false;
+			}
+		}
+		previous = row;
+	}
+	return true;
+}
+
+bool DecodePng(
+	const unsigned char* data,
+	size_t size,
+	std::vector<unsigned char>& rgba,
+	unsigned int* width,
+	unsigned int* height,
+	std::string* error)
+{
+	static const unsigned char signature[8] = { 137, 'P', 'N', 'G', 13, 10, 26, 10 };
+	if (size < 8 || memcmp(data, signature, 8) != 0)
+	{
+		*error = "not a PNG";
+		return false;
+	}
+
+	unsigned int w = 0, h = 0;
+	unsigned int bitDepth = 0, colorType = 0, interlace = 0;
+	unsigned char palette[256][4];
+	memset(palette, 255, sizeof(palette));
+	int transparentGrey = -1;
+	int transparentRGB[3] = { -1, -1, -1 };
+	std::vector<unsigned char> compressed;
+
+	size_t offset = 8;
+	while (offset + 12 <= size)
+	{
+		unsigned int length = ReadBigEndian(data + offset);
+		const unsigned char* type = data + offset + 4;
+		const unsigned char* chunk = data + offset + 8;
+		if (length > size - offset - 12)
+		{
+			*error = "truncated chunk";
+			return false;
+		}
+
+		if (memcmp(type, "IHDR", 4) == 0 && length >= 13)
+		{
+			w = ReadBigEndian(chunk);
+			h = ReadBigEndian(chunk + 4);
+			bitDepth = chunk[8];
+			colorType = chunk[9];
+			interlace = chunk[12];
+		}
+		else if (memcmp(type, "PLTE", 4) == 0)
+		{
+			for (unsigned int i = 0; i < length / 3 && i < 256; i++)
+			{
+				palette[i][0] = chunk[i * 3 + 0];
+				palette[i][1] = chunk[i * 3 + 1];
+				palette[i][2] = chunk[i * 3 + 2];
+			}
+		}
+		else if (memcmp(type, "tRNS", 4) == 0)
+		{
+			if (colorType == 3)
+			{
+				for (unsigned int i = 0; i < length && i < 256; i++)
+					palette[i][3] = chunk[i];
+			}
+			else if (colorType == 0 && length >= 2)
+				transparentGrey = (chunk[0] << 8) | chunk[1];
+			else if (colorType == 2 && length >= 6)
+			{
+				for (int c = 0; c < 3; c++)
+					transparentRGB[c] = (chunk[c * 2] << 8) | chunk[c * 2 + 1];
+			}
+		}
+		else if (memcmp(type, "IDAT", 4) == 0)
+			compressed.insert(compressed.end(), chunk, chunk + length);
+		else if (memcmp(type, "IEND", 4) == 0)
+			break;
+
+		offset += 12 + (size_t)length;
+	}
+
+	unsigned int channels = 0;
+	switch (colorType)
+	{
+	case 0: channels = 1; break;	// Grey
+	case 2: channels = 3; break;	// RGB
+	case 3: channels = 1; break;	// Palette
+	case 4: channels = 2; break;	// Grey alpha
+	case 6: channels = 4; break;	// RGBA
+	}
+
+	if (w == 0 || h == 0 || channels == 0 ||
+		(bitDepth != 1 && bitDepth != 2 && bitDepth != 4 && bitDepth != 8 && bitDepth != 16))
+	{
+		*error = "unsupported header";
+		return false;
+	}
+	if (interlace != 0)
+	{
+		*error = "interlaced PNGs are not supported";
+		return false;
+	}
+
+	std::vector<unsigned char> rows;
+	rows.reserve(((size_t)w * channels * bitDepth + 15) / 8 * h);
+	if (!InflateZlib(compressed.data(), compressed.size(), rows))
+	{
+		*error = "bad image data";
+		return false;
+	}
+
+	size_t stride = ((size_t)w * channels * bitDepth + 7) / 8;
+	unsigned int pixelBytes = (channels * bitDepth + 7) / 8;
+	if (!Unfilter(rows, h, stride, pixelBytes))
+	{
+		*error = "bad row filter";
+		return false;
+	}
+
+	// Samples scaled to 8 bits, 16 bit ones keep the high byte
+	rgba.resize((size_t)w * h * 4);
+	unsigned int maxValue = (1u << bitDepth) - 1;
+	for (unsigned int y = 0; y < h; y++)
+	{
+		const unsigned char* row = &rows[y * (stride + 1) + 1];
+		for (unsigned int x = 0; x < w; x++)
+		{
+			unsigned int samples[4];
+			for (unsigned int c = 0; c < channels; c++)
+			{
+				size_t bit = ((size_t)x * channels + c) * bitDepth;
+				if (bitDepth == 16)
+					samples[c] = (row[bit / 8] << 8) | row[bit / 8 + 1];
+				else
+					samples[c] = (row[bit / 8] >> (8 - bitDepth - bit % 8)) & maxValue;
+			}
+
+			unsigned char* out = &rgba[((size_t)y * w + x) * 4];
+			if (colorType == 3)
+			{
+				memcpy(out, palette[samples[0] & 255], 4);
+				continue;
+			}
+
+			unsigned char scaled[4];
+			for (unsigned int c = 0; c < channels; c++)
+				scaled[c] = bitDepth == 16 ? (unsigned char)(samples[c] >> 8) : (unsigned char)(samples[c] * 255 / maxValue);
+
+			if (channels <= 2)
+			{
+				out[0] = out[1] = out[2] = scaled[0];
+				out[3] = channels == 2 ? scaled[1] : ((int)samples[0] == transparentGrey ? 0 : 255);
+			}
+			else
+			{
+				out[0] = scaled[0];
+				out[1] = scaled[1];
+				out[2] = scaled[2];
+				out[3] = channels == 4 ? scaled[3] :
+					((int)samples[0] == transparentRGB[0] &&
+					 (int)samples[1] == transparentRGB[1] &&
+					 (int)samples[2] == transparentRGB[2] ? 0 : 255);
+			}
+		}
+	}
+
+	*width = w;
+	*height = h;
+	return true;
+}
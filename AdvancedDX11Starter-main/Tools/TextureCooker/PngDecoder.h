@@ -0,0 +1,28 @@
+#pragma once
+
+// Developer: Narai
+// Purpose: Read PNG files into RGBA8 for the texture cooker,
+//			which runs where WIC does not. Covers what the
+//			asset folder uses: every color type and bit depth,
+//			palettes and tRNS, but not interlacing.
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+/// <summary>
+/// Decompresses a zlib stream (deflate with its 2 byte header)
+/// </summary>
+bool InflateZlib(const unsigned char* data, size_t size, std::vector<unsigned char>& out);
+
+/// <summary>
+/// Decodes a whole PNG file in memory to tightly packed RGBA8.
+/// On failure error says why
+/// </summary>
+bool DecodePng(
+	const unsigned char* data,
+	size_t size,
+	std::vector<unsigned char>& rgba,
+	unsigned int* width,
+	unsigned int* height,
+	std::string* error);
@@ -1,6 +1,7 @@
 #include "Lighting.hlsli"
 #include "Triplanar.hlsli"
 #include "Common.hlsli"
+#include "Shadows.hlsli"
 
 // Data that can change per material
 cbuffer perMaterial : register(b0)
@@ -21,6 +22,12 @@ cbuffer perFrame : register(b1)
 
 	// Needed for specular (reflection) calculation
     float3 cameraPosition;
+
+	// Directional light shadow cascades
+    matrix cascadeViewProj[SHADOW_CASCADE_MAX_COUNT];
+    float4 cascadeSplits;
+    float4 shadowDepthRow;
+    int cascadeCount;
 };
 
 Texture2D Albedo : register(t0);
@@ -28,7 +35,7 @@ Texture2D AlbedoFront : register(t1);
 Texture2D AlbedoSide : register(t2);
 Texture2D AlbedoTop : register(t3);
 
-Texture2D ShadowMap : register(t4);
+Texture2DArray ShadowMap : register(t4);
 
 SamplerState BasicSampler : register(s0);
 SamplerComparisonState ShadowSampler : register(s1);
@@ -61,22 +68,15 @@ float4 main(VertexToPixel input) : SV_TARGET
     if (surfaceColor.w <= 0.1f)
         discard;
     
-    // Perform the perspective divide (divide by W) ourselves
-    input.shadowMapPos /= input.shadowMapPos.w;
-    
-    // Convert the normalized device coordinates to UVs for sampling
-    float2 shadowUV = input.shadowMapPos.xy * 0.5f + 0.5f;
-    shadowUV.y = 1 - shadowUV.y; // Flip the Y
-    
-    // Grab the distances we need: light-to-pixel and closest-surface
-    float distToLight = input.shadowMapPos.z;
-    float distShadowMap = ShadowMap.Sample(BasicSampler, shadowUV).r;
-    
-    // Get a ratio of comparison results using SampleCmpLevelZero()
-    float shadowAmount = ShadowMap.SampleCmpLevelZero(
+    // Compare against whichever cascade covers this pixel
+    float shadowAmount = CascadedShadow(
+        ShadowMap,
         ShadowSampler,
-        shadowUV,
-        distToLight).r;
+        cascadeViewProj,
+        cascadeSplits,
+        shadowDepthRow,
+        cascadeCount,
+        input.worldPos);
     //shadowAmount = ShadowTexture.Sample(BasicSampler, input.uv);
     shadowAmount = max(0.01f, shadowAmount);
     